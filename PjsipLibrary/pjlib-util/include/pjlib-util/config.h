@@ -131,6 +131,43 @@
 #   define PJ_DNS_RESOLVER_INVALID_TTL              60
 #endif
 
+/**
+ * Number of Active nameservers which each query is sent to at the same
+ * time. The nameservers with the best smoothed response time are chosen,
+ * and the first valid answer completes the query, so one slow or failing
+ * nameserver does not delay the queries as long as another one answers.
+ * Setting this to 2 or more trades extra DNS traffic for lower latency.
+ *
+ * Default: 1 (send to the best nameserver only)
+ */
+#ifndef PJ_DNS_RESOLVER_RACE_NS_COUNT
+#   define PJ_DNS_RESOLVER_RACE_NS_COUNT            1
+#endif
+
+/**
+ * Maximum number of responses kept in the resolver response cache. When
+ * the cache is full, the least recently used response is removed to make
+ * room for the new one. Zero means the cache is not bounded.
+ *
+ * Default: 256
+ */
+#ifndef PJ_DNS_RESOLVER_MAX_CACHE_ENTRIES
+#   define PJ_DNS_RESOLVER_MAX_CACHE_ENTRIES        256
+#endif
+
+/**
+ * When a cached response is picked up by a query and it will expire within
+ * this many seconds, the resolver sends a new query in the background to
+ * refresh the entry, so that the following queries do not have to wait
+ * for the nameserver after the entry expires. Responses whose TTL is not
+ * longer than this value are not refreshed. Zero disables this feature.
+ *
+ * Default: 10
+ */
+#ifndef PJ_DNS_RESOLVER_PREFETCH_TIME
+#   define PJ_DNS_RESOLVER_PREFETCH_TIME            10
+#endif
+
 /**
  * The interval on which nameservers which are known to be good to be 
  * probed again to determine whether they are still good. Note that
@@ -209,6 +246,27 @@
 #  define PJ_SCANNER_USE_BITWISE                    1
 #endif
 
+/**
+ * Use vector (SSSE3 or AVX2) instructions to find the end of a run of
+ * characters matching (or not matching) a character input specification,
+ * e.g. in pj_scan_get() and pj_scan_get_until(). This keeps an extra 32
+ * byte bitmap in each #pj_cis_t. Only runs longer than 16 bytes use the
+ * vector code, as the byte loop is faster for short tokens. The
+ * instruction set is selected at run time, and the byte loop is used on
+ * CPUs (or compilers) without them.
+ *
+ * Default: 1 with GCC or Clang on x86, 0 elsewhere
+ */
+#ifndef PJ_SCANNER_USE_SIMD
+#  if defined(__GNUC__) && !defined(__INTEL_COMPILER) && \
+      (__GNUC__ >= 5 || defined(__clang__)) && \
+      (defined(__x86_64__) || defined(__i386__))
+#    define PJ_SCANNER_USE_SIMD                     1
+#  else
+#    define PJ_SCANNER_USE_SIMD                     0
+#  endif
+#endif
+
 
 
 /* **************************************************************************
@@ -289,6 +289,45 @@ typedef struct pj_dns_parsed_packet
 } pj_dns_parsed_packet;
 
 
+/**
+ * This structure describes a Resource Record in a DNS packet view (see
+ * #pj_dns_parse_packet_view()). Instead of copying the record, it refers
+ * to the position of the record in the packet buffer. All integral values
+ * are in host byte order.
+ */
+typedef struct pj_dns_rr_view
+{
+    unsigned     name_off;  /**< Offset of the name in the packet.          */
+    pj_uint16_t  type;      /**< RR type code.                              */
+    pj_uint16_t  dnsclass;  /**< Class of data (PJ_DNS_CLASS_IN=1).         */
+    pj_uint32_t  ttl;       /**< Time to live.                              */
+    pj_uint16_t  rdlength;  /**< Resource data length.                      */
+    unsigned     rdata_off; /**< Offset of the resource data in the packet. */
+} pj_dns_rr_view;
+
+
+/**
+ * This structure describes a DNS packet which is parsed without copying,
+ * with #pj_dns_parse_packet_view(). The view refers to the packet buffer,
+ * so the buffer must remain valid while the view is used. Names are
+ * decompressed only when they are retrieved with #pj_dns_view_get_name()
+ * or #pj_dns_view_get_rr().
+ */
+typedef struct pj_dns_packet_view
+{
+    const pj_uint8_t    *pkt;       /**< The packet buffer.                 */
+    unsigned             size;      /**< Size of the packet.                */
+    pj_dns_hdr           hdr;       /**< DNS header, in host byte order.    */
+    unsigned             q_name_off;/**< Offset of the name of the first
+                                         query, or zero if there is none.   */
+    pj_uint16_t          q_type;    /**< Type of the first query.           */
+    pj_uint16_t          q_class;   /**< Class of the first query.          */
+    unsigned             rr_cnt;    /**< Number of records in rr.           */
+    pj_dns_rr_view      *rr;        /**< The answer, NS and additional
+                                         records, in this order.            */
+} pj_dns_packet_view;
+
+
 /**
  * Option flags to be specified when calling #pj_dns_packet_dup() function.
  * These flags can be combined with bitwise OR operation.
@@ -360,6 +399,69 @@ PJ_DECL(void) pj_dns_packet_dup(pj_pool_t *pool,
                                 unsigned options,
                                 pj_dns_parsed_packet **p_dst);
 
+/**
+ * Parse raw DNS packet without copying it. The function validates the
+ * packet structure and records the position of the query and of each
+ * resource record in the packet, without allocating memory or
+ * decompressing the names. Use #pj_dns_view_get_name() and
+ * #pj_dns_view_get_rr() to retrieve the names and records that are
+ * actually needed.
+ *
+ * @param packet        Pointer to the DNS packet (the TCP/UDP payload of
+ *                      the raw packet). It must remain valid while the
+ *                      view is used.
+ * @param size          The size of the DNS packet.
+ * @param rr            Array to store the resource records, or NULL to
+ *                      only parse the header and the query section.
+ * @param max_rr        Number of elements in the rr array. Only the first
+ *                      max_rr records of the packet are parsed.
+ * @param view          The packet view to be initialized.
+ *
+ * @return              PJ_SUCCESS on success, or the appropriate error code.
+ */
+PJ_DECL(pj_status_t) pj_dns_parse_packet_view(const void *packet,
+                                              unsigned size,
+                                              pj_dns_rr_view rr[],
+                                              unsigned max_rr,
+                                              pj_dns_packet_view *view);
+
+/**
+ * Get a name from the packet view, decompressing it into the buffer.
+ *
+ * @param view          The packet view.
+ * @param offset        Offset of the name in the packet, e.g. the
+ *                      name_off field of #pj_dns_rr_view, or the rdata_off
+ *                      field of a CNAME record.
+ * @param buf           Buffer to store the name. The name will be NULL
+ *                      terminated.
+ * @param size          Size of the buffer.
+ * @param name          Pointer to receive the name, which points to buf.
+ *
+ * @return              PJ_SUCCESS on success, PJ_ETOOSMALL if the buffer is
+ *                      too small, or the appropriate error code.
+ */
+PJ_DECL(pj_status_t) pj_dns_view_get_name(const pj_dns_packet_view *view,
+                                          unsigned offset,
+                                          char *buf,
+                                          unsigned size,
+                                          pj_str_t *name);
+
+/**
+ * Fully parse a resource record of the packet view, as it would have been
+ * parsed by #pj_dns_parse_packet().
+ *
+ * @param pool          Pool to allocate memory for the names and data.
+ * @param view          The packet view.
+ * @param rr            The resource record in the view.
+ * @param prr           The parsed resource record.
+ *
+ * @return              PJ_SUCCESS on success, or the appropriate error code.
+ */
+PJ_DECL(pj_status_t) pj_dns_view_get_rr(pj_pool_t *pool,
+                                        const pj_dns_packet_view *view,
+                                        const pj_dns_rr_view *rr,
+                                        pj_dns_parsed_rr *prr);
+
 
 /**
  * Utility function to get the type name string of the specified DNS type.
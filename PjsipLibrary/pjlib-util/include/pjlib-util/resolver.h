@@ -74,7 +74,10 @@ PJ_BEGIN_DECL
  * queries will be issued to multiple name servers simultaneously to probe
  * which servers are not active. Once the probing stage is done, subsequent 
  * queries will be directed to only one ACTIVE server which provides the best
- * response time.
+ * response time. The response time of each server is smoothed with an
+ * exponentially weighted moving average. Optionally, the queries can be
+ * sent to several of the best ACTIVE servers at once, in which case the
+ * first valid answer is used (see #PJ_DNS_RESOLVER_RACE_NS_COUNT).
  *
  * Name servers are probed periodically to see which nameservers are active
  * and which are down. This probing is done when a query is sent, thus no
@@ -124,26 +127,17 @@ PJ_BEGIN_DECL
  *
  * \section PJ_DNS_RESOLVER_LIMITATIONS Resolver Limitations
  *
- * Current implementation mainly suffers from a growing memory problem,
- * which mainly is caused by the response caching. Although there is only
- * one cache entry per {query, name} combination, these cache entry will
- * never get deleted since there is no timer is created to invalidate these
- * entries. So the more unique names being queried by application, there more
- * enties will be created in the response cache.
+ * There is one cache entry per {query, name} combination, and expired
+ * entries are only removed when the same resource is queried again. To
+ * keep the memory usage bounded, the number of entries in the response
+ * cache is limited by \a cache_max_entries setting (see
+ * #PJ_DNS_RESOLVER_MAX_CACHE_ENTRIES), and the least recently used entry
+ * is removed when the cache is full.
  *
  * Note that a single response entry will occupy about 600-700 bytes of 
  * pool memory (the PJ_DNS_RESOLVER_RES_BUF_SIZE value plus internal
  * structure). 
  *
- * Application can work around this problem by doing one of these:
- *  - disable caching by setting PJ_DNS_RESOLVER_MAX_TTL and 
- *    PJ_DNS_RESOLVER_INVALID_TTL to zero.
- *  - periodically query #pj_dns_resolver_get_cached_count() and destroy-
- *    recreate the resolver to recycle the memory used by the resolver.
- *
- * Note that future improvement may solve this problem by introducing 
- * expiration timer to the cached entries.
- *
  *
  * \section PJ_DNS_RESOLVER_REFERENCE Reference
  *
@@ -195,6 +189,13 @@ typedef struct pj_dns_settings
                                      value is zero, caching is disabled.    */
     unsigned    good_ns_ttl;    /**< See #PJ_DNS_RESOLVER_GOOD_NS_TTL       */
     unsigned    bad_ns_ttl;     /**< See #PJ_DNS_RESOLVER_BAD_NS_TTL        */
+    unsigned    cache_neg_ttl;  /**< TTL for cached negative responses, see
+                                     #PJ_DNS_RESOLVER_INVALID_TTL. If the
+                                     value is zero, negative responses are
+                                     not cached.                            */
+    unsigned    cache_max_entries;/**< See #PJ_DNS_RESOLVER_MAX_CACHE_ENTRIES*/
+    unsigned    prefetch_time;  /**< See #PJ_DNS_RESOLVER_PREFETCH_TIME     */
+    unsigned    race_ns_count;  /**< See #PJ_DNS_RESOLVER_RACE_NS_COUNT     */
 } pj_dns_settings;
 
 
@@ -402,7 +403,8 @@ PJ_DECL(pj_status_t) pj_dns_resolver_destroy(pj_dns_resolver *resolver,
  * @param type      The type of resource (see #pj_dns_type constants).
  * @param options   Optional options, must be zero for now.
  * @param cb        Callback to be called when the query completes,
- *                  either successfully or with failure.
+ *                  either successfully or with failure. This may be NULL
+ *                  to only fill the response cache.
  * @param user_data Arbitrary user data to be associated with the query,
  *                  and which will be given back in the callback.
  * @param p_query   Optional pointer to receive the query object, if one
@@ -495,7 +497,9 @@ PJ_DECL(unsigned) pj_dns_resolver_get_cached_count(pj_dns_resolver *resolver);
 
 
 /**
- * Dump resolver state to the log.
+ * Dump resolver state to the log. This includes the nameserver response
+ * time statistics and the response cache hit, miss, eviction and prefetch
+ * counters.
  *
  * @param resolver  The resolver instance.
  * @param detail    Will print detailed entries.
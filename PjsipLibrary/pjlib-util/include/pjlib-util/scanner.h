@@ -37,6 +37,26 @@ PJ_BEGIN_DECL
  *
  * @{
  */
+
+/*
+ * With PJ_SCANNER_USE_SIMD, each cis also keeps a copy of its members in
+ * simd_map, laid out for a 16 entry table lookup: character c is bit
+ * ((c >> 4) & 7) of byte ((c >> 7) * 16 + (c & 15)).
+ */
+#if PJ_SCANNER_USE_SIMD
+#  define PJ_CIS_MAP_IDX(c) ((((pj_uint8_t)(c)) >> 7 << 4) | ((c) & 15))
+#  define PJ_CIS_MAP_BIT(c) \
+            ((pj_uint8_t)(1 << ((((pj_uint8_t)(c)) >> 4) & 7)))
+#  define PJ_CIS_MAP_SET(cis,c) \
+            ((cis)->simd_map[PJ_CIS_MAP_IDX(c)] |= PJ_CIS_MAP_BIT(c))
+#  define PJ_CIS_MAP_CLR(cis,c) \
+            ((cis)->simd_map[PJ_CIS_MAP_IDX(c)] &= \
+             (pj_uint8_t)~PJ_CIS_MAP_BIT(c))
+#else
+#  define PJ_CIS_MAP_SET(cis,c) ((void)0)
+#  define PJ_CIS_MAP_CLR(cis,c) ((void)0)
+#endif
+
 #if defined(PJ_SCANNER_USE_BITWISE) && PJ_SCANNER_USE_BITWISE != 0
 #  include <pjlib-util/scanner_cis_bitwise.h>
 #else
@@ -20,6 +20,7 @@
 #define __PJLIB_UTIL_SCANNER_CIS_BIT_H__
 
 #include <pj/types.h>
+#include <pjlib-util/config.h>
 
 PJ_BEGIN_DECL
 
@@ -59,6 +60,9 @@ typedef struct pj_cis_t
 {
     pj_cis_elem_t   *cis_buf;       /**< Pointer to buffer.     */
     int              cis_id;        /**< Id.                    */
+#if PJ_SCANNER_USE_SIMD
+    pj_uint8_t       simd_map[32];  /**< Bitmap for vector scan. */
+#endif
 } pj_cis_t;
 
 
@@ -69,7 +73,8 @@ typedef struct pj_cis_t
  * @param cis       Pointer to character input specification.
  * @param c         The character.
  */
-#define PJ_CIS_SET(cis,c)   ((cis)->cis_buf[(int)(c)] |= (1 << (cis)->cis_id))
+#define PJ_CIS_SET(cis,c)   (PJ_CIS_MAP_SET(cis,c), \
+                             (cis)->cis_buf[(int)(c)] |= (1 << (cis)->cis_id))
 
 /**
  * Remove the membership of the specified character.
@@ -78,7 +83,8 @@ typedef struct pj_cis_t
  * @param cis       Pointer to character input specification.
  * @param c         The character to be removed from the membership.
  */
-#define PJ_CIS_CLR(cis,c)   ((cis)->cis_buf[(int)c] &= ~(1 << (cis)->cis_id))
+#define PJ_CIS_CLR(cis,c)   (PJ_CIS_MAP_CLR(cis,c), \
+                             (cis)->cis_buf[(int)c] &= ~(1 << (cis)->cis_id))
 
 /**
  * Check the membership of the specified character.
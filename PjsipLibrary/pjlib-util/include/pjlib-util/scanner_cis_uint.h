@@ -20,6 +20,7 @@
 #define __PJLIB_UTIL_SCANNER_CIS_BIT_H__
 
 #include <pj/types.h>
+#include <pjlib-util/config.h>
 
 PJ_BEGIN_DECL
 
@@ -46,6 +47,9 @@ typedef int pj_cis_buf_t;
 typedef struct pj_cis_t
 {
     PJ_CIS_ELEM_TYPE    cis_buf[256];   /**< Internal buffer.   */
+#if PJ_SCANNER_USE_SIMD
+    pj_uint8_t          simd_map[32];   /**< For vector scan.   */
+#endif
 } pj_cis_t;
 
 
@@ -56,7 +60,8 @@ typedef struct pj_cis_t
  * @param cis       Pointer to character input specification.
  * @param c         The character.
  */
-#define PJ_CIS_SET(cis,c)   ((cis)->cis_buf[(int)(c)] = 1)
+#define PJ_CIS_SET(cis,c)   (PJ_CIS_MAP_SET(cis,c), \
+                             (cis)->cis_buf[(int)(c)] = 1)
 
 /**
  * Remove the membership of the specified character.
@@ -65,7 +70,8 @@ typedef struct pj_cis_t
  * @param cis       Pointer to character input specification.
  * @param c         The character to be removed from the membership.
  */
-#define PJ_CIS_CLR(cis,c)   ((cis)->cis_buf[(int)c] = 0)
+#define PJ_CIS_CLR(cis,c)   (PJ_CIS_MAP_CLR(cis,c), \
+                             (cis)->cis_buf[(int)c] = 0)
 
 /**
  * Check the membership of the specified character.
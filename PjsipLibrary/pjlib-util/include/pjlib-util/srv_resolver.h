@@ -110,7 +110,18 @@ typedef enum pj_dns_srv_option
      * resolution only (i.e: without DNS A resolution) for each targets
      * in the DNS SRV record.
      */
-    PJ_DNS_SRV_RESOLVE_AAAA_ONLY = 8
+    PJ_DNS_SRV_RESOLVE_AAAA_ONLY = 8,
+
+    /**
+     * Specify if the fallback DNS A and/or AAAA queries (see
+     * PJ_DNS_SRV_FALLBACK_A and PJ_DNS_SRV_FALLBACK_AAAA) should be sent
+     * together with the DNS SRV query, instead of after the DNS SRV
+     * resolution has failed. This saves one round-trip when the domain
+     * does not have SRV records, at the cost of extra DNS queries when
+     * it does. The answers are only used to fill the resolver cache, and
+     * the fallback is not tried again for the queries that have failed.
+     */
+    PJ_DNS_SRV_PARALLEL_FALLBACK = 16
 
 } pj_dns_srv_option;
 
@@ -52,6 +52,9 @@ static struct server_t
      */
     int             action;
 
+    /* Simulated network RTT, in msec */
+    unsigned        delay;
+
     pj_dns_parsed_packet    resp;
     void                  (*action_cb)(const pj_dns_parsed_packet *pkt,
                                        pj_dns_parsed_packet **p_res);
@@ -68,6 +71,8 @@ static pj_ioqueue_t *ioqueue;
 static pj_thread_t *poll_thread;
 static pj_sem_t *sem;
 static pj_dns_settings set;
+static pj_str_t nameservers[2];
+static pj_uint16_t ports[2];
 
 #define MAX_LABEL   32
 
@@ -389,7 +394,7 @@ static int server_thread(void *p)
         }
 
         /* Simulate network RTT */
-        pj_thread_sleep(50);
+        pj_thread_sleep(srv->delay);
 
         if (srv->action == ACTION_IGNORE) {
             continue;
@@ -431,8 +436,6 @@ static void destroy(void);
 static int init(pj_bool_t use_ipv6)
 {
     pj_status_t status;
-    pj_str_t nameservers[2];
-    pj_uint16_t ports[2];
     int i;
 
     if (use_ipv6) {
@@ -447,6 +450,8 @@ static int init(pj_bool_t use_ipv6)
 
     g_server[0].port = ports[0];
     g_server[1].port = ports[1];
+    g_server[0].delay = 50;
+    g_server[1].delay = 50;
 
     pool = pj_pool_create(mem, NULL, 2000, 2000, NULL);
 
@@ -935,6 +940,271 @@ static int addr_parser_test(void)
 }
 
 
+////////////////////////////////////////////////////////////////////////////
+/* Packet view tests */
+#define VIEW_SRV_CNT    8
+
+/* Build a SRV response with the A records of the targets in the additional
+ * records, using name compression.
+ */
+static int build_srv_packet(pj_pool_t *pool, pj_uint8_t *pkt, int size)
+{
+    pj_dns_parsed_packet res;
+    unsigned i;
+
+    pj_bzero(&res, sizeof(res));
+    res.hdr.id = 1234;
+    res.hdr.flags = PJ_DNS_SET_QR(1);
+    res.hdr.qdcount = 1;
+    res.hdr.anscount = VIEW_SRV_CNT;
+    res.hdr.arcount = VIEW_SRV_CNT;
+
+    res.q = PJ_POOL_ZALLOC_T(pool, pj_dns_parsed_query);
+    res.q[0].name = pj_str("_sip._udp.example.com");
+    res.q[0].type = PJ_DNS_TYPE_SRV;
+    res.q[0].dnsclass = 1;
+
+    res.ans = (pj_dns_parsed_rr*)
+              pj_pool_calloc(pool, VIEW_SRV_CNT, sizeof(pj_dns_parsed_rr));
+    res.arr = (pj_dns_parsed_rr*)
+              pj_pool_calloc(pool, VIEW_SRV_CNT, sizeof(pj_dns_parsed_rr));
+
+    for (i=0; i<VIEW_SRV_CNT; ++i) {
+        char *target = (char*) pj_pool_alloc(pool, 32);
+
+        pj_ansi_snprintf(target, 32, "sip%u.example.com", i);
+
+        res.ans[i].name = res.q[0].name;
+        res.ans[i].type = PJ_DNS_TYPE_SRV;
+        res.ans[i].dnsclass = 1;
+        res.ans[i].ttl = 100 + i;
+        res.ans[i].rdata.srv.prio = (pj_uint16_t)i;
+        res.ans[i].rdata.srv.weight = 10;
+        res.ans[i].rdata.srv.port = 5060;
+        res.ans[i].rdata.srv.target = pj_str(target);
+
+        res.arr[i].name = res.ans[i].rdata.srv.target;
+        res.arr[i].type = PJ_DNS_TYPE_A;
+        res.arr[i].dnsclass = 1;
+        res.arr[i].ttl = 100;
+        res.arr[i].rdata.a.ip_addr.s_addr = pj_htonl(0x0a000001 + i);
+    }
+
+    return print_packet(&res, pkt, size);
+}
+
+static int packet_view_test(void)
+{
+    pj_uint8_t pkt[1024];
+    pj_dns_parsed_packet *parsed;
+    pj_dns_packet_view view;
+    pj_dns_rr_view rr[VIEW_SRV_CNT * 2];
+    pj_dns_parsed_rr prr;
+    char buf[PJ_MAX_HOSTNAME];
+    pj_str_t name;
+    unsigned i;
+    int len;
+    pj_status_t rc;
+
+    PJ_LOG(3,(THIS_FILE, "  DNS packet view tests"));
+
+    len = build_srv_packet(pool, pkt, sizeof(pkt));
+    if (len < 0)
+        return -1000;
+
+    rc = pj_dns_parse_packet(pool, pkt, len, &parsed);
+    if (rc != PJ_SUCCESS)
+        return -1010;
+
+    /* Header and query only */
+    rc = pj_dns_parse_packet_view(pkt, len, NULL, 0, &view);
+    if (rc != PJ_SUCCESS || view.hdr.id != 1234 ||
+        view.hdr.anscount != VIEW_SRV_CNT || view.rr_cnt != 0 ||
+        view.q_type != PJ_DNS_TYPE_SRV)
+    {
+        return -1020;
+    }
+
+    rc = pj_dns_view_get_name(&view, view.q_name_off, buf, sizeof(buf),
+                              &name);
+    if (rc != PJ_SUCCESS || pj_strcmp(&name, &parsed->q[0].name) != 0)
+        return -1030;
+
+    /* All records, compared with the full parser */
+    rc = pj_dns_parse_packet_view(pkt, len, rr, PJ_ARRAY_SIZE(rr), &view);
+    if (rc != PJ_SUCCESS || view.rr_cnt != VIEW_SRV_CNT * 2)
+        return -1040;
+
+    for (i=0; i<view.rr_cnt; ++i) {
+        const pj_dns_parsed_rr *ref = (i < VIEW_SRV_CNT) ? &parsed->ans[i] :
+                                      &parsed->arr[i - VIEW_SRV_CNT];
+
+        if (rr[i].type != ref->type || rr[i].ttl != ref->ttl ||
+            rr[i].rdlength != ref->rdlength)
+        {
+            return -1050;
+        }
+
+        rc = pj_dns_view_get_name(&view, rr[i].name_off, buf, sizeof(buf),
+                                  &name);
+        if (rc != PJ_SUCCESS || pj_strcmp(&name, &ref->name) != 0)
+            return -1060;
+
+        rc = pj_dns_view_get_rr(pool, &view, &rr[i], &prr);
+        if (rc != PJ_SUCCESS || pj_strcmp(&prr.name, &ref->name) != 0)
+            return -1070;
+
+        if (ref->type == PJ_DNS_TYPE_SRV) {
+            /* The SRV target follows priority, weight and port */
+            rc = pj_dns_view_get_name(&view, rr[i].rdata_off + 6, buf,
+                                      sizeof(buf), &name);
+            if (rc != PJ_SUCCESS ||
+                pj_strcmp(&name, &ref->rdata.srv.target) != 0 ||
+                pj_strcmp(&prr.rdata.srv.target, &ref->rdata.srv.target) ||
+                prr.rdata.srv.prio != ref->rdata.srv.prio)
+            {
+                return -1080;
+            }
+        } else if (prr.rdata.a.ip_addr.s_addr != ref->rdata.a.ip_addr.s_addr) {
+            return -1090;
+        }
+    }
+
+    /* Only the first records fit in the array */
+    rc = pj_dns_parse_packet_view(pkt, len, rr, 3, &view);
+    if (rc != PJ_SUCCESS || view.rr_cnt != 3)
+        return -1100;
+
+    /* Buffer too small for the name */
+    rc = pj_dns_view_get_name(&view, rr[0].name_off, buf, 8, &name);
+    if (rc != PJ_ETOOSMALL)
+        return -1110;
+
+    /* Truncated packet */
+    rc = pj_dns_parse_packet_view(pkt, len - 3, rr, PJ_ARRAY_SIZE(rr),
+                                  &view);
+    if (rc == PJ_SUCCESS)
+        return -1120;
+
+    /* Compressed name, pointing to the query name */
+    {
+        pj_uint8_t cpkt[] = {
+            0x00, 0x01, 0x80, 0x00, 0x00, 0x01, 0x00, 0x01,
+            0x00, 0x00, 0x00, 0x00,
+            5, 'a', 'h', 'o', 's', 't', 3, 'c', 'o', 'm', 0,
+            0x00, 0x01, 0x00, 0x01,
+            0xc0, 0x0c, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00, 0x00, 0x3c,
+            0x00, 0x04, 1, 2, 3, 4
+        };
+
+        rc = pj_dns_parse_packet_view(cpkt, sizeof(cpkt), rr,
+                                      PJ_ARRAY_SIZE(rr), &view);
+        if (rc != PJ_SUCCESS || view.rr_cnt != 1 || rr[0].ttl != 60)
+            return -1130;
+
+        rc = pj_dns_view_get_name(&view, rr[0].name_off, buf, sizeof(buf),
+                                  &name);
+        if (rc != PJ_SUCCESS || pj_strcmp2(&name, "ahost.com") != 0)
+            return -1140;
+
+        /* Invalid pointer is only detected when the name is retrieved */
+        cpkt[rr[0].name_off + 1] = 0xff;
+        rc = pj_dns_parse_packet_view(cpkt, sizeof(cpkt), rr,
+                                      PJ_ARRAY_SIZE(rr), &view);
+        if (rc != PJ_SUCCESS)
+            return -1150;
+        rc = pj_dns_view_get_name(&view, rr[0].name_off, buf, sizeof(buf),
+                                  &name);
+        if (rc != PJLIB_UTIL_EDNSINNAMEPTR)
+            return -1160;
+    }
+
+    return 0;
+}
+
+
+#if WITH_BENCHMARK
+/* Compare the cost of receiving a SRV response with the full parser (and
+ * duplicating it as the resolver does when caching it) with the packet
+ * view, where only the SRV targets are retrieved.
+ */
+int dns_benchmark(void)
+{
+#if defined(PJ_DEBUG) && PJ_DEBUG!=0
+    enum { LOOP = 10000 };
+#else
+    enum { LOOP = 100000 };
+#endif
+    pj_pool_t *pool1, *pool2;
+    pj_uint8_t pkt[1024];
+    pj_dns_parsed_packet *parsed, *dup;
+    pj_dns_packet_view view;
+    pj_dns_rr_view rr[VIEW_SRV_CNT * 2];
+    char buf[PJ_MAX_HOSTNAME];
+    pj_str_t name;
+    pj_timestamp t1, t2;
+    pj_uint32_t t_parse, t_dup, t_view;
+    unsigned i, j;
+    int len;
+
+    pool1 = pj_pool_create(mem, "dnsbench", 4000, 4000, NULL);
+    pool2 = pj_pool_create(mem, "dnsbench", 4000, 4000, NULL);
+    if (!pool1 || !pool2)
+        return PJ_ENOMEM;
+
+    len = build_srv_packet(pool1, pkt, sizeof(pkt));
+    if (len < 0) {
+        pj_pool_release(pool1);
+        pj_pool_release(pool2);
+        return -10;
+    }
+
+    PJ_LOG(3,(THIS_FILE, "  parsing %d times a %d bytes SRV response with "
+              "%d records", LOOP, len, VIEW_SRV_CNT * 2));
+
+    /* Full parser */
+    pj_get_timestamp(&t1);
+    for (i=0; i<LOOP; ++i) {
+        pj_pool_reset(pool1);
+        pj_dns_parse_packet(pool1, pkt, len, &parsed);
+    }
+    pj_get_timestamp(&t2);
+    t_parse = pj_elapsed_usec(&t1, &t2);
+
+    /* Full parser followed by packet duplication */
+    pj_get_timestamp(&t1);
+    for (i=0; i<LOOP; ++i) {
+        pj_pool_reset(pool1);
+        pj_pool_reset(pool2);
+        pj_dns_parse_packet(pool1, pkt, len, &parsed);
+        pj_dns_packet_dup(pool2, parsed, PJ_DNS_NO_NS | PJ_DNS_NO_AR, &dup);
+    }
+    pj_get_timestamp(&t2);
+    t_dup = pj_elapsed_usec(&t1, &t2);
+
+    /* Packet view, getting the SRV targets */
+    pj_get_timestamp(&t1);
+    for (i=0; i<LOOP; ++i) {
+        pj_dns_parse_packet_view(pkt, len, rr, PJ_ARRAY_SIZE(rr), &view);
+        for (j=0; j<view.hdr.anscount; ++j) {
+            pj_dns_view_get_name(&view, rr[j].rdata_off + 6, buf,
+                                 sizeof(buf), &name);
+        }
+    }
+    pj_get_timestamp(&t2);
+    t_view = pj_elapsed_usec(&t1, &t2);
+
+    PJ_LOG(3,(THIS_FILE, "    parse       :%8u usec", t_parse));
+    PJ_LOG(3,(THIS_FILE, "    parse + dup :%8u usec", t_dup));
+    PJ_LOG(3,(THIS_FILE, "    view        :%8u usec", t_view));
+
+    pj_pool_release(pool1);
+    pj_pool_release(pool2);
+    return 0;
+}
+#endif  /* WITH_BENCHMARK */
+
+
 ////////////////////////////////////////////////////////////////////////////
 /* Simple DNS test */
 #define IP_ADDR0    0x00010203
@@ -1890,6 +2160,341 @@ static int srv_resolver_many_test(void)
 }
 
 
+////////////////////////////////////////////////////////////////////////////
+/* Response cache test */
+
+#define IP_ADDR4    0x04050607
+
+static pj_status_t cache_cb_status;
+
+static void cache_cb(void *user_data,
+                     pj_status_t status,
+                     pj_dns_parsed_packet *resp)
+{
+    PJ_UNUSED_ARG(user_data);
+    PJ_UNUSED_ARG(resp);
+
+    cache_cb_status = status;
+    pj_sem_post(sem);
+}
+
+static void init_a_response(pj_dns_parsed_packet *r, const pj_str_t *name,
+                            unsigned ttl)
+{
+    pj_bzero(r, sizeof(*r));
+    r->hdr.flags = PJ_DNS_SET_QR(1);
+    r->hdr.qdcount = 1;
+    r->hdr.anscount = 1;
+    r->q = PJ_POOL_ZALLOC_T(pool, pj_dns_parsed_query);
+    r->q[0].type = PJ_DNS_TYPE_A;
+    r->q[0].dnsclass = 1;
+    r->q[0].name = *name;
+    r->ans = PJ_POOL_ZALLOC_T(pool, pj_dns_parsed_rr);
+    r->ans[0].type = PJ_DNS_TYPE_A;
+    r->ans[0].dnsclass = 1;
+    r->ans[0].name = *name;
+    r->ans[0].ttl = ttl;
+    r->ans[0].rdata.a.ip_addr.s_addr = IP_ADDR4;
+}
+
+/* Returns 1 if the answer is from the cache, 0 if from the server */
+static int cache_query(const pj_str_t *name, pj_status_t *status)
+{
+    pj_dns_async_query *q = NULL;
+
+    if (pj_dns_resolver_start_query(resolver, name, PJ_DNS_TYPE_A, 0,
+                                    &cache_cb, NULL, &q) != PJ_SUCCESS)
+    {
+        return -1;
+    }
+
+    pj_sem_wait(sem);
+    if (status)
+        *status = cache_cb_status;
+
+    return (q == NULL) ? 1 : 0;
+}
+
+static int cache_test(void)
+{
+    pj_str_t name[4] = { {"cache0", 6}, {"cache1", 6}, {"cache2", 6},
+                         {"cache3", 6} };
+    pj_str_t neg_name = pj_str("cacheneg");
+    pj_str_t pf_name = pj_str("cacheprefetch");
+    pj_status_t nxdomain = PJ_STATUS_FROM_DNS_RCODE(PJ_DNS_RCODE_NXDOMAIN);
+    pj_dns_parsed_packet pkt;
+    pj_dns_settings st;
+    pj_status_t status;
+    unsigned i;
+    int rc = 0;
+
+    PJ_LOG(3,(THIS_FILE, "  response cache test"));
+
+    pj_memcpy(&st, &set, sizeof(st));
+    st.cache_max_entries = 3;
+    st.cache_neg_ttl = 60;
+    st.prefetch_time = 2;
+    pj_dns_resolver_set_settings(resolver, &st);
+
+    g_server[0].action = PJ_DNS_RCODE_NXDOMAIN;
+    g_server[1].action = PJ_DNS_RCODE_NXDOMAIN;
+
+    /* Least recently used entry is removed when the cache is full */
+    for (i=0; i<3; ++i) {
+        init_a_response(&pkt, &name[i], 60);
+        pj_dns_resolver_add_entry(resolver, &pkt, PJ_TRUE);
+    }
+    if (cache_query(&name[0], NULL) != 1) {
+        rc = -10;
+        goto on_return;
+    }
+
+    init_a_response(&pkt, &name[3], 60);
+    pj_dns_resolver_add_entry(resolver, &pkt, PJ_TRUE);
+    if (pj_dns_resolver_get_cached_count(resolver) != 3) {
+        rc = -20;
+        goto on_return;
+    }
+
+    if (cache_query(&name[0], NULL) != 1 ||
+        cache_query(&name[2], NULL) != 1 ||
+        cache_query(&name[3], NULL) != 1)
+    {
+        rc = -30;
+        goto on_return;
+    }
+
+    /* Negative answer is cached */
+    if (cache_query(&name[1], &status) != 0 || status != nxdomain) {
+        rc = -40;
+        goto on_return;
+    }
+    if (cache_query(&name[1], &status) != 1 || status != nxdomain) {
+        rc = -50;
+        goto on_return;
+    }
+
+    /* ..unless its TTL is zero */
+    st.cache_neg_ttl = 0;
+    pj_dns_resolver_set_settings(resolver, &st);
+
+    if (cache_query(&neg_name, &status) != 0 || status != nxdomain ||
+        cache_query(&neg_name, &status) != 0)
+    {
+        rc = -60;
+        goto on_return;
+    }
+
+    /* Entry which is about to expire is refreshed in the background */
+    g_server[0].action = ACTION_REPLY;
+    g_server[1].action = ACTION_REPLY;
+    init_a_response(&g_server[0].resp, &pf_name, 60);
+    init_a_response(&g_server[1].resp, &pf_name, 60);
+
+    init_a_response(&pkt, &pf_name, 3);
+    pj_dns_resolver_add_entry(resolver, &pkt, PJ_TRUE);
+
+    g_server[0].pkt_count = 0;
+    g_server[1].pkt_count = 0;
+
+    if (cache_query(&pf_name, NULL) != 1) {
+        rc = -70;
+        goto on_return;
+    }
+    pj_thread_sleep(200);
+    if (g_server[0].pkt_count + g_server[1].pkt_count != 0) {
+        PJ_LOG(3,("test", "   entry refreshed too early"));
+        rc = -80;
+        goto on_return;
+    }
+
+    pj_thread_sleep(1500);
+    if (cache_query(&pf_name, NULL) != 1) {
+        rc = -90;
+        goto on_return;
+    }
+    pj_thread_sleep(300);
+    if (g_server[0].pkt_count + g_server[1].pkt_count == 0) {
+        PJ_LOG(3,("test", "   entry not refreshed"));
+        rc = -100;
+        goto on_return;
+    }
+
+    /* The original entry would have expired by now */
+    pj_thread_sleep(1500);
+    if (cache_query(&pf_name, NULL) != 1) {
+        rc = -110;
+        goto on_return;
+    }
+
+    pj_dns_resolver_dump(resolver, PJ_FALSE);
+
+on_return:
+    pj_dns_resolver_set_settings(resolver, &set);
+    return rc;
+}
+
+
+////////////////////////////////////////////////////////////////////////////
+/* Parallel nameservers test */
+
+#define FAST_DELAY  10
+#define SLOW_DELAY  300
+
+static pj_timestamp race_start;
+static pj_status_t race_status;
+static unsigned race_msec;
+
+static void race_cb(void *user_data,
+                    pj_status_t status,
+                    pj_dns_parsed_packet *resp)
+{
+    pj_timestamp now;
+
+    PJ_UNUSED_ARG(user_data);
+    PJ_UNUSED_ARG(resp);
+
+    pj_get_timestamp(&now);
+    race_msec = pj_elapsed_msec(&race_start, &now);
+    race_status = status;
+    pj_sem_post(sem);
+}
+
+static int race_query(const pj_str_t *name)
+{
+    g_server[0].pkt_count = 0;
+    g_server[1].pkt_count = 0;
+
+    pj_get_timestamp(&race_start);
+    if (pj_dns_resolver_start_query(resolver, name, PJ_DNS_TYPE_A, 0,
+                                    &race_cb, NULL, NULL) != PJ_SUCCESS)
+    {
+        return -1;
+    }
+    pj_sem_wait(sem);
+
+    /* Let the slow server answer too, so its response time is known */
+    pj_thread_sleep(SLOW_DELAY + 100);
+    return 0;
+}
+
+static int race_test(void)
+{
+    pj_str_t name = pj_str("racename");
+    pj_dns_settings st;
+    int rc = 0;
+
+    PJ_LOG(3,(THIS_FILE, "  parallel nameservers test"));
+
+    g_server[0].action = ACTION_REPLY;
+    g_server[1].action = ACTION_REPLY;
+    g_server[0].delay = SLOW_DELAY;
+    g_server[1].delay = FAST_DELAY;
+    init_a_response(&g_server[0].resp, &name, 0);
+    init_a_response(&g_server[1].resp, &name, 0);
+
+    pj_memcpy(&st, &set, sizeof(st));
+    st.race_ns_count = 2;
+    pj_dns_resolver_set_settings(resolver, &st);
+
+    /* Start with fresh nameserver states */
+    pj_dns_resolver_set_ns(resolver, 2, nameservers, ports);
+
+    /* Both servers are probed, the fast one answers */
+    if (race_query(&name) != 0 || race_status != PJ_SUCCESS ||
+        race_msec >= SLOW_DELAY)
+    {
+        rc = -10;
+        goto on_return;
+    }
+
+    /* Both servers are active, and both get the query */
+    if (race_query(&name) != 0 || race_status != PJ_SUCCESS ||
+        race_msec >= SLOW_DELAY ||
+        g_server[0].pkt_count != 1 || g_server[1].pkt_count != 1)
+    {
+        PJ_LOG(3,("test", "   query not sent to both servers (%d, %d)",
+                  g_server[0].pkt_count, g_server[1].pkt_count));
+        rc = -20;
+        goto on_return;
+    }
+
+    /* Without racing, only the fastest server gets the query */
+    st.race_ns_count = 1;
+    pj_dns_resolver_set_settings(resolver, &st);
+
+    if (race_query(&name) != 0 || race_status != PJ_SUCCESS ||
+        g_server[0].pkt_count != 0 || g_server[1].pkt_count != 1)
+    {
+        PJ_LOG(3,("test", "   query not sent to the fastest server"));
+        rc = -30;
+        goto on_return;
+    }
+
+    /* Error response from the fast server is not used while the slow
+     * server has not answered.
+     */
+    st.race_ns_count = 2;
+    pj_dns_resolver_set_settings(resolver, &st);
+    g_server[1].action = PJ_DNS_RCODE_REFUSED;
+
+    if (race_query(&name) != 0 || race_status != PJ_SUCCESS ||
+        race_msec < SLOW_DELAY)
+    {
+        PJ_LOG(3,("test", "   error response used, status=%d",
+                  race_status));
+        rc = -40;
+        goto on_return;
+    }
+
+    /* The error response is reported when the other server never
+     * answers.
+     */
+    st.qretr_delay = 100;
+    st.qretr_count = 2;
+    pj_dns_resolver_set_settings(resolver, &st);
+    pj_dns_resolver_set_ns(resolver, 2, nameservers, ports);
+    g_server[0].action = ACTION_IGNORE;
+
+    if (race_query(&name) != 0 ||
+        race_status != PJ_STATUS_FROM_DNS_RCODE(PJ_DNS_RCODE_REFUSED))
+    {
+        PJ_LOG(3,("test", "   error response not reported, status=%d",
+                  race_status));
+        rc = -50;
+        goto on_return;
+    }
+
+    /* Without racing, the error response from one server completes the
+     * query even when the other server is being probed too.
+     */
+    st.race_ns_count = 1;
+    pj_dns_resolver_set_settings(resolver, &st);
+    pj_dns_resolver_set_ns(resolver, 2, nameservers, ports);
+
+    if (race_query(&name) != 0 ||
+        race_status != PJ_STATUS_FROM_DNS_RCODE(PJ_DNS_RCODE_REFUSED) ||
+        race_msec >= st.qretr_delay)
+    {
+        PJ_LOG(3,("test", "   error response not used, status=%d, "
+                  "%u msec", race_status, race_msec));
+        rc = -60;
+        goto on_return;
+    }
+
+    pj_dns_resolver_dump(resolver, PJ_FALSE);
+
+on_return:
+    g_server[0].action = ACTION_REPLY;
+    g_server[1].action = ACTION_REPLY;
+    g_server[0].delay = 50;
+    g_server[1].delay = 50;
+    pj_dns_resolver_set_settings(resolver, &set);
+    pj_dns_resolver_set_ns(resolver, 2, nameservers, ports);
+    return rc;
+}
+
+
 ////////////////////////////////////////////////////////////////////////////
 
 
@@ -1909,6 +2514,10 @@ int resolver_test(void)
     if (rc != 0)
         goto on_error;
 
+    rc = packet_view_test();
+    if (rc != 0)
+        goto on_error;
+
     rc = simple_test();
     if (rc != 0)
         goto on_error;
@@ -1929,6 +2538,14 @@ int resolver_test(void)
     if (rc != 0)
         goto on_error;
 
+    rc = cache_test();
+    if (rc != 0)
+        goto on_error;
+
+    rc = race_test();
+    if (rc != 0)
+        goto on_error;
+
     destroy();
 
 
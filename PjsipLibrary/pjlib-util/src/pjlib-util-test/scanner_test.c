@@ -0,0 +1,303 @@
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include "test.h"
+
+#define THIS_FILE       "scanner_test.c"
+
+#if INCLUDE_SCANNER_TEST
+
+#include <pjlib-util/scanner.h>
+#include <pj/log.h>
+#include <pj/os.h>
+#include <pj/rand.h>
+#include <pj/string.h>
+
+/*
+ * pj_scan_peek() and pj_scan_peek_until() find the end of a run with the
+ * vector code (see PJ_SCANNER_USE_SIMD) once the run is longer than the
+ * first few bytes, and with the byte loop otherwise. The results are
+ * checked against a plain pj_cis_match() loop, for runs ending on and
+ * around the 16 and 32 byte block boundaries, at every alignment, and
+ * for runs that reach the end of the input.
+ */
+
+/* Longest run, and the extra runs for the multi block cases. */
+#define MAX_RUN         200
+#define BUF_LEN         1200
+
+static const int long_runs[] = { 255, 256, 257, 511, 512, 513, 1000 };
+
+/* Members and non-members of a cis. */
+struct cis_chars
+{
+    char        in[256];
+    unsigned    in_cnt;
+    char        out[256];
+    unsigned    out_cnt;
+};
+
+static void on_syntax_error(pj_scanner *scanner)
+{
+    PJ_UNUSED_ARG(scanner);
+}
+
+static void get_chars(const pj_cis_t *cis, struct cis_chars *chars)
+{
+    unsigned c;
+
+    chars->in_cnt = chars->out_cnt = 0;
+
+    /* Zero terminates the input in the real users, leave it out. */
+    for (c=1; c<256; ++c) {
+        if (pj_cis_match(cis, c))
+            chars->in[chars->in_cnt++] = (char)c;
+        else
+            chars->out[chars->out_cnt++] = (char)c;
+    }
+}
+
+static pj_size_t scalar_span(const pj_cis_t *cis, const char *s,
+                             const char *end, int member)
+{
+    const char *start = s;
+
+    if (member) {
+        while (s != end && pj_cis_match(cis, *s))
+            ++s;
+    } else {
+        while (s != end && !pj_cis_match(cis, *s))
+            ++s;
+    }
+    return s - start;
+}
+
+/* Build a run of run_len bytes at buf, followed by a stop byte and some
+ * random input when has_stop is set, then scan it.
+ */
+static int check_run(const pj_cis_t *cis, const struct cis_chars *chars,
+                     char *buf, int run_len, int has_stop, int member,
+                     unsigned *stop_idx)
+{
+    const char *run_chars = member ? chars->in : chars->out;
+    unsigned run_cnt = member ? chars->in_cnt : chars->out_cnt;
+    const char *stop_chars = member ? chars->out : chars->in;
+    unsigned stop_cnt = member ? chars->out_cnt : chars->in_cnt;
+    pj_scanner scanner;
+    pj_str_t out;
+    pj_size_t len, expected;
+    int i;
+
+    for (i=0; i<run_len; ++i)
+        buf[i] = run_chars[pj_rand() % run_cnt];
+
+    len = run_len;
+    if (has_stop) {
+        /* Go through every stop byte in turn. */
+        buf[len++] = stop_chars[(*stop_idx)++ % stop_cnt];
+        for (i=0; i<32; ++i)
+            buf[len++] = (char)(pj_rand() % 255 + 1);
+    }
+    buf[len] = '\0';
+
+    expected = scalar_span(cis, buf, buf+len, member);
+    if (expected != (pj_size_t)run_len) {
+        PJ_LOG(1,(THIS_FILE, "  error: bad test input"));
+        return -10;
+    }
+
+    pj_scan_init(&scanner, buf, len, 0, &on_syntax_error);
+    if (member)
+        pj_scan_peek(&scanner, cis, &out);
+    else
+        pj_scan_peek_until(&scanner, cis, &out);
+    pj_scan_fini(&scanner);
+
+    if (out.ptr != buf || (pj_size_t)out.slen != expected) {
+        PJ_LOG(1,(THIS_FILE, "  error: %s run of %d bytes at offset %d "
+                  "%s: got %ld bytes",
+                  (member ? "member" : "non-member"), run_len,
+                  (int)((pj_size_t)buf % 32),
+                  (has_stop ? "with stop byte" : "at end of input"),
+                  (long)out.slen));
+        return -20;
+    }
+
+    return 0;
+}
+
+static int check_cis(const pj_cis_t *cis)
+{
+    struct cis_chars chars;
+    char buf[BUF_LEN + 64];
+    unsigned stop_idx = 0;
+    int member;
+
+    get_chars(cis, &chars);
+    if (chars.in_cnt == 0 || chars.out_cnt == 0) {
+        PJ_LOG(1,(THIS_FILE, "  error: bad cis for the test"));
+        return -1;
+    }
+
+    for (member=0; member<2; ++member) {
+        unsigned offset;
+
+        for (offset=0; offset<32; ++offset) {
+            int run_len, has_stop, rc;
+            unsigned i;
+
+            for (has_stop=0; has_stop<2; ++has_stop) {
+                /* An empty input is a syntax error for the scanner. */
+                for (run_len=(has_stop ? 0 : 1); run_len<=MAX_RUN;
+                     ++run_len)
+                {
+                    rc = check_run(cis, &chars, buf+offset, run_len,
+                                   has_stop, member, &stop_idx);
+                    if (rc != 0)
+                        return rc;
+                }
+
+                for (i=0; i<PJ_ARRAY_SIZE(long_runs); ++i) {
+                    rc = check_run(cis, &chars, buf+offset, long_runs[i],
+                                   has_stop, member, &stop_idx);
+                    if (rc != 0)
+                        return rc;
+                }
+            }
+        }
+    }
+
+    return 0;
+}
+
+static int span_test(void)
+{
+    pj_cis_buf_t cis_buf;
+    pj_cis_t cis;
+    unsigned c;
+    int rc;
+
+    pj_cis_buf_init(&cis_buf);
+
+    /* SIP token */
+    PJ_LOG(3,(THIS_FILE, "  token"));
+    pj_cis_init(&cis_buf, &cis);
+    pj_cis_add_alpha(&cis);
+    pj_cis_add_num(&cis);
+    pj_cis_add_str(&cis, "-.!%*_+`'~");
+    rc = check_cis(&cis);
+    if (rc != 0)
+        return rc - 100;
+
+    /* Everything but newline, as for header values. This includes all
+     * the bytes >= 0x80.
+     */
+    PJ_LOG(3,(THIS_FILE, "  not newline"));
+    pj_cis_init(&cis_buf, &cis);
+    pj_cis_add_str(&cis, "\r\n");
+    pj_cis_invert(&cis);
+    rc = check_cis(&cis);
+    if (rc != 0)
+        return rc - 200;
+
+    /* Some of the bytes >= 0x80 and some ASCII, so that both halves of
+     * the map are needed to tell members from non-members.
+     */
+    PJ_LOG(3,(THIS_FILE, "  mixed high bytes"));
+    pj_cis_init(&cis_buf, &cis);
+    for (c=0x80; c<256; c+=3)
+        PJ_CIS_SET(&cis, c);
+    for (c=0x8F; c<256; c+=16)
+        PJ_CIS_SET(&cis, c);
+    pj_cis_add_str(&cis, "aZ09/\x7F");
+    rc = check_cis(&cis);
+    if (rc != 0)
+        return rc - 300;
+
+    return 0;
+}
+
+#if WITH_BENCHMARK
+/* Time pj_scan_get() on a header value of len bytes. */
+static int span_benchmark(unsigned len)
+{
+    enum { LOOP = 100000 };
+    pj_cis_buf_t cis_buf;
+    pj_cis_t cis;
+    char buf[1024];
+    pj_scanner scanner;
+    pj_str_t out;
+    pj_timestamp t1, t2;
+    pj_uint32_t nsec;
+    unsigned i;
+
+    pj_cis_buf_init(&cis_buf);
+    pj_cis_init(&cis_buf, &cis);
+    pj_cis_add_str(&cis, "\r\n");
+    pj_cis_invert(&cis);
+
+    for (i=0; i<len; ++i)
+        buf[i] = (char)('a' + i % 26);
+    buf[len] = '\r';
+    buf[len+1] = '\0';
+
+    pj_get_timestamp(&t1);
+    for (i=0; i<LOOP; ++i) {
+        pj_scan_init(&scanner, buf, len+1, 0, &on_syntax_error);
+        pj_scan_get(&scanner, &cis, &out);
+        pj_scan_fini(&scanner);
+    }
+    pj_get_timestamp(&t2);
+
+    if ((unsigned)out.slen != len) {
+        PJ_LOG(1,(THIS_FILE, "  error: got %ld bytes", (long)out.slen));
+        return -400;
+    }
+
+    nsec = pj_elapsed_nanosec(&t1, &t2) / LOOP;
+    PJ_LOG(3,(THIS_FILE, "  pj_scan_get() on %u bytes: %u nsec",
+              len, nsec));
+    return 0;
+}
+#endif
+
+int scanner_test(void)
+{
+    int rc;
+
+    rc = span_test();
+    if (rc != 0)
+        return rc;
+
+#if WITH_BENCHMARK
+    rc = span_benchmark(80);
+    if (rc != 0)
+        return rc;
+
+    rc = span_benchmark(1000);
+    if (rc != 0)
+        return rc;
+#endif
+
+    return 0;
+}
+
+
+#else
+int scanner_test_dummy;
+#endif
@@ -75,6 +75,10 @@ static int test_inner(void)
     DO_TEST(json_test());
 #endif
 
+#if INCLUDE_SCANNER_TEST
+    DO_TEST(scanner_test());
+#endif
+
 #if INCLUDE_ENCRYPTION_TEST
     DO_TEST(encryption_test());
 #   if WITH_BENCHMARK
@@ -88,6 +92,9 @@ static int test_inner(void)
 
 #if INCLUDE_RESOLVER_TEST
     DO_TEST(resolver_test());
+#   if WITH_BENCHMARK
+    DO_TEST(dns_benchmark());
+#   endif
 #endif
 
 #if INCLUDE_HTTP_CLIENT_TEST
@@ -26,6 +26,7 @@
 
 #define INCLUDE_XML_TEST            1
 #define INCLUDE_JSON_TEST           1
+#define INCLUDE_SCANNER_TEST        1
 #define INCLUDE_ENCRYPTION_TEST     1
 #define INCLUDE_STUN_TEST           1
 #define INCLUDE_RESOLVER_TEST       1
@@ -33,11 +34,13 @@
 
 extern int xml_test(void);
 extern int json_test(void);
+extern int scanner_test(void);
 extern int encryption_test();
 extern int encryption_benchmark();
 extern int stun_test();
 extern int test_main(void);
 extern int resolver_test(void);
+extern int dns_benchmark(void);
 extern int http_client_test();
 
 extern void app_perror(const char *title, pj_status_t rc);
@@ -559,6 +559,189 @@ PJ_DEF(pj_status_t) pj_dns_parse_packet( pj_pool_t *pool,
 }
 
 
+/* Get the length of a name in the packet, without following the
+ * compression pointer.
+ */
+static pj_status_t skip_name(const pj_uint8_t *start, const pj_uint8_t *max,
+                             int *parsed_len)
+{
+    const pj_uint8_t *p = start;
+
+    while (p < max && *p) {
+        if ((*p & 0xc0) == 0xc0) {
+            /* Compression pointer ends the name */
+            if (p + 2 > max)
+                return PJLIB_UTIL_EDNSINNAMEPTR;
+
+            *parsed_len = (int)(p + 2 - start);
+            return PJ_SUCCESS;
+        }
+        p += *p + 1;
+    }
+
+    if (p >= max)
+        return PJLIB_UTIL_EDNSINNAMEPTR;
+
+    *parsed_len = (int)(p + 1 - start);
+    return PJ_SUCCESS;
+}
+
+
+/*
+ * Parse raw DNS packet without copying.
+ */
+PJ_DEF(pj_status_t) pj_dns_parse_packet_view(const void *packet,
+                                             unsigned size,
+                                             pj_dns_rr_view rr[],
+                                             unsigned max_rr,
+                                             pj_dns_packet_view *view)
+{
+    const pj_uint8_t *pkt = (const pj_uint8_t*)packet;
+    const pj_uint8_t *p, *end;
+    unsigned i, rr_total;
+    int len;
+    pj_status_t status;
+
+    /* Sanity checks */
+    PJ_ASSERT_RETURN(packet && size && view, PJ_EINVAL);
+
+    /* Packet size must be at least as big as the header */
+    if (size < sizeof(pj_dns_hdr))
+        return PJLIB_UTIL_EDNSINSIZE;
+
+    pj_bzero(view, sizeof(*view));
+    view->pkt = pkt;
+    view->size = size;
+    view->rr = rr;
+
+    /* Copy the DNS header, and convert endianness to host byte order */
+    pj_memcpy(&view->hdr, packet, sizeof(pj_dns_hdr));
+    view->hdr.id       = pj_ntohs(view->hdr.id);
+    view->hdr.flags    = pj_ntohs(view->hdr.flags);
+    view->hdr.qdcount  = pj_ntohs(view->hdr.qdcount);
+    view->hdr.anscount = pj_ntohs(view->hdr.anscount);
+    view->hdr.nscount  = pj_ntohs(view->hdr.nscount);
+    view->hdr.arcount  = pj_ntohs(view->hdr.arcount);
+
+    p = pkt + sizeof(pj_dns_hdr);
+    end = pkt + size;
+
+    /* Query records */
+    for (i=0; i<view->hdr.qdcount; ++i) {
+        status = skip_name(p, end, &len);
+        if (status != PJ_SUCCESS)
+            return status;
+
+        if (p + len + 4 > end)
+            return PJLIB_UTIL_EDNSINSIZE;
+
+        if (i == 0) {
+            view->q_name_off = (unsigned)(p - pkt);
+            view->q_type = (pj_uint16_t)((p[len] << 8) | p[len+1]);
+            view->q_class = (pj_uint16_t)((p[len+2] << 8) | p[len+3]);
+        }
+        p += len + 4;
+    }
+
+    if (!rr)
+        return PJ_SUCCESS;
+
+    /* Answer, NS and additional records */
+    rr_total = view->hdr.anscount + view->hdr.nscount + view->hdr.arcount;
+    for (i=0; i<rr_total && i<max_rr; ++i) {
+        pj_dns_rr_view *r = &rr[i];
+
+        status = skip_name(p, end, &len);
+        if (status != PJ_SUCCESS)
+            return status;
+
+        if (p + len + 10 > end)
+            return PJLIB_UTIL_EDNSINSIZE;
+
+        r->name_off = (unsigned)(p - pkt);
+        p += len;
+
+        r->type = (pj_uint16_t)((p[0] << 8) | p[1]);
+        r->dnsclass = (pj_uint16_t)((p[2] << 8) | p[3]);
+        r->ttl = ((pj_uint32_t)p[4] << 24) | ((pj_uint32_t)p[5] << 16) |
+                 ((pj_uint32_t)p[6] << 8) | p[7];
+        r->rdlength = (pj_uint16_t)((p[8] << 8) | p[9]);
+        p += 10;
+
+        if (p + r->rdlength > end)
+            return PJLIB_UTIL_EDNSINSIZE;
+
+        r->rdata_off = (unsigned)(p - pkt);
+        p += r->rdlength;
+
+        ++view->rr_cnt;
+    }
+
+    return PJ_SUCCESS;
+}
+
+
+/*
+ * Get a name from the packet view.
+ */
+PJ_DEF(pj_status_t) pj_dns_view_get_name(const pj_dns_packet_view *view,
+                                         unsigned offset,
+                                         char *buf,
+                                         unsigned size,
+                                         pj_str_t *name)
+{
+    const pj_uint8_t *end;
+    int name_len, name_part_len;
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(view && buf && size && name, PJ_EINVAL);
+
+    if (offset >= view->size)
+        return PJLIB_UTIL_EDNSINNAMEPTR;
+
+    end = view->pkt + view->size;
+
+    /* Get the length of the name */
+    status = get_name_len(0, view->pkt, view->pkt + offset, end,
+                          &name_part_len, &name_len);
+    if (status != PJ_SUCCESS)
+        return status;
+
+    if ((unsigned)name_len >= size)
+        return PJ_ETOOSMALL;
+
+    /* Get the name */
+    name->ptr = buf;
+    name->slen = 0;
+    status = get_name(0, view->pkt, view->pkt + offset, end, name);
+    if (status != PJ_SUCCESS)
+        return status;
+
+    buf[name->slen] = '\0';
+
+    return PJ_SUCCESS;
+}
+
+
+/*
+ * Fully parse a resource record of the packet view.
+ */
+PJ_DEF(pj_status_t) pj_dns_view_get_rr(pj_pool_t *pool,
+                                       const pj_dns_packet_view *view,
+                                       const pj_dns_rr_view *rr,
+                                       pj_dns_parsed_rr *prr)
+{
+    int parsed_len;
+
+    PJ_ASSERT_RETURN(pool && view && rr && prr, PJ_EINVAL);
+    PJ_ASSERT_RETURN(rr->name_off < view->size, PJ_EINVAL);
+
+    pj_bzero(prr, sizeof(*prr));
+    return parse_rr(prr, pool, view->pkt, view->pkt + rr->name_off,
+                    view->pkt + view->size, &parsed_len);
+}
+
+
 /* Perform name compression scheme.
  * If a name is already in the nametable, when no need to duplicate
  * the string with the pool, but rather just use the pointer there.
@@ -627,11 +810,14 @@ static void copy_rr(pj_pool_t *pool, pj_dns_parsed_rr *dst,
         pj_memcpy(&dst->rdata.aaaa.ip_addr, &src->rdata.aaaa.ip_addr,
                   sizeof(pj_in6_addr));
     } else if (src->type == PJ_DNS_TYPE_CNAME) {
-        pj_strdup(pool, &dst->rdata.cname.name, &src->rdata.cname.name);
+        apply_name_table(nametable_count, nametable, &src->rdata.cname.name,
+                         pool, &dst->rdata.cname.name);
     } else if (src->type == PJ_DNS_TYPE_NS) {
-        pj_strdup(pool, &dst->rdata.ns.name, &src->rdata.ns.name);
+        apply_name_table(nametable_count, nametable, &src->rdata.ns.name,
+                         pool, &dst->rdata.ns.name);
     } else if (src->type == PJ_DNS_TYPE_PTR) {
-        pj_strdup(pool, &dst->rdata.ptr.name, &src->rdata.ptr.name);
+        apply_name_table(nametable_count, nametable, &src->rdata.ptr.name,
+                         pool, &dst->rdata.ptr.name);
     }
 }
 
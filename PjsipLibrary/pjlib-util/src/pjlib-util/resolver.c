@@ -84,7 +84,13 @@ struct nameserver
     enum ns_state   state;              /**< Nameserver state.              */
     pj_time_val     state_expiry;       /**< Time set next state.           */
     pj_time_val     rt_delay;           /**< Response time.                 */
-    
+    unsigned        srtt;               /**< Smoothed response time, msec.  */
+    unsigned        rtt_cnt;            /**< Number of rt_delay samples.    */
+
+    /* Statistics */
+    unsigned        sent_cnt;           /**< Number of packets sent.        */
+    unsigned        resp_cnt;           /**< Number of responses received.  */
+    unsigned        win_cnt;            /**< Responses that completed query.*/
 
     /* For calculating rt_delay: */
     pj_uint16_t     q_id;               /**< Query ID.                      */
@@ -133,6 +139,8 @@ struct pj_dns_async_query
     pj_uint16_t          id;            /**< Transaction ID.                */
 
     unsigned             transmit_cnt;  /**< Number of transmissions.       */
+    unsigned             pending_ns_cnt;/**< NS yet to answer this round.   */
+    pj_status_t          last_err;      /**< Error answer not yet reported. */
 
     struct res_key       key;           /**< Key to index this query.       */
     pj_hash_entry_buf    hbufid;        /**< Hash buffer 1                  */
@@ -146,7 +154,9 @@ struct pj_dns_async_query
 
 
 /* This structure is used to keep cached response entry.
- * The cache is a hash table keyed on "res_key" structure above.
+ * The cache is a hash table keyed on "res_key" structure above. The entries
+ * are also kept in a list ordered by last use, to find the least recently
+ * used entry when the cache is full.
  */
 struct cached_res
 {
@@ -156,11 +166,20 @@ struct cached_res
     struct res_key           key;           /**< Resource key.              */
     pj_hash_entry_buf        hbuf;          /**< Hash buffer                */
     pj_time_val              expiry_time;   /**< Expiration time.           */
+    unsigned                 ttl;           /**< Original TTL, in seconds.  */
+    pj_bool_t                prefetched;    /**< Refresh query was sent.    */
     pj_dns_parsed_packet    *pkt;           /**< The response packet.       */
     unsigned                 ref_cnt;       /**< Reference counter.         */
 };
 
 
+/* Cached response LRU list head */
+struct cache_head
+{
+    PJ_DECL_LIST_MEMBER(struct cached_res);
+};
+
+
 /* Resolver entry */
 struct pj_dns_resolver
 {
@@ -210,6 +229,15 @@ struct pj_dns_resolver
     /* Hash table for cached response */
     pj_hash_table_t     *hrescache;     /**< Cached response in hash table  */
 
+    /* Cached response, least recently used first */
+    struct cache_head    cache_lru;
+
+    /* Response cache statistics */
+    unsigned             cache_hits;    /**< Answered from the cache.       */
+    unsigned             cache_misses;  /**< Not found or expired.          */
+    unsigned             cache_evictions;/**< Removed to keep the limit.    */
+    unsigned             cache_prefetches;/**< Refresh queries sent.        */
+
     /* Pending asynchronous query, hashed by transaction ID. */
     pj_hash_table_t     *hquerybyid;
 
@@ -235,6 +263,9 @@ static pj_status_t select_nameservers(pj_dns_resolver *resolver,
                                       unsigned *count,
                                       unsigned servers[]);
 
+/* Add response time sample for the nameserver */
+static void update_ns_rtt(struct nameserver *ns, const pj_time_val *rt);
+
 /* Destructor */
 static void dns_resolver_on_destroy(void *member);
 
@@ -369,6 +400,10 @@ PJ_DEF(void) pj_dns_settings_default(pj_dns_settings *s)
     s->cache_max_ttl = PJ_DNS_RESOLVER_MAX_TTL;
     s->good_ns_ttl = PJ_DNS_RESOLVER_GOOD_NS_TTL;
     s->bad_ns_ttl = PJ_DNS_RESOLVER_BAD_NS_TTL;
+    s->cache_neg_ttl = PJ_DNS_RESOLVER_INVALID_TTL;
+    s->cache_max_entries = PJ_DNS_RESOLVER_MAX_CACHE_ENTRIES;
+    s->prefetch_time = PJ_DNS_RESOLVER_PREFETCH_TIME;
+    s->race_ns_count = PJ_DNS_RESOLVER_RACE_NS_COUNT;
 }
 
 
@@ -437,7 +472,8 @@ PJ_DEF(pj_status_t) pj_dns_resolver_create( pj_pool_factory *pf,
     }
 
     /* Response cache hash table */
-    resv->hrescache = pj_hash_create(pool, RES_HASH_TABLE_SIZE);
+    resv->hrescache = pj_hash_create_oa(pool, RES_HASH_TABLE_SIZE);
+    pj_list_init(&resv->cache_lru);
 
     /* Query hash table and free list. */
     resv->hquerybyid = pj_hash_create(pool, Q_HASH_TABLE_SIZE);
@@ -505,6 +541,7 @@ PJ_DEF(pj_status_t) pj_dns_resolver_destroy( pj_dns_resolver *resolver,
         cache = (struct cached_res*) pj_hash_this(resolver->hrescache, it);
         pj_hash_set(NULL, resolver->hrescache, &cache->key, 
                     sizeof(cache->key), 0, NULL);
+        pj_list_erase(cache);
         pj_pool_release(cache->pool);
 
         it = pj_hash_first(resolver->hrescache, &it_buf);
@@ -760,6 +797,9 @@ static pj_status_t transmit_query(pj_dns_resolver *resolver,
             continue;
         }
 
+        if (status == PJ_SUCCESS || status == PJ_EPENDING)
+            ns->sent_cnt++;
+
         PJ_PERROR(4,(resolver->name.ptr, status,
                   "%s %d bytes to NS %d (%s:%d): DNS %s query for %s",
                   (q->transmit_cnt==0? "Transmitting":"Re-transmitting"),
@@ -769,6 +809,19 @@ static pj_status_t transmit_query(pj_dns_resolver *resolver,
                   pj_dns_get_type_name(q->key.qtype), 
                   q->key.name));
 
+        /* The previous query whose response time is being measured may
+         * have been answered by another nameserver, and this one has not
+         * answered it within the retransmit delay.
+         */
+        if (ns->q_id != 0) {
+            pj_time_val rt = now;
+            PJ_TIME_VAL_SUB(rt, ns->sent_time);
+            if (PJ_TIME_VAL_MSEC(rt) > (long)resolver->settings.qretr_delay) {
+                update_ns_rtt(ns, &rt);
+                ns->q_id = 0;
+            }
+        }
+
         if (ns->q_id == 0) {
             ns->q_id = q->id;
             ns->sent_time = now;
@@ -781,6 +834,7 @@ static pj_status_t transmit_query(pj_dns_resolver *resolver,
     }
 
     ++q->transmit_cnt;
+    q->pending_ns_cnt = send_cnt;
 
     return PJ_SUCCESS;
 }
@@ -849,6 +903,122 @@ static void free_entry(pj_dns_resolver *resolver, struct cached_res *cache)
     pj_pool_release(cache->pool);
 }
 
+/* Remove cache entry from the hash table and the LRU list, and release
+ * it if it is not being used by callback.
+ */
+static void remove_entry(pj_dns_resolver *resolver, struct cached_res *cache,
+                         pj_uint32_t hval)
+{
+    /* Remove the entry before releasing its pool (see ticket #1710) */
+    pj_hash_set(NULL, resolver->hrescache, &cache->key, sizeof(cache->key),
+                hval, NULL);
+    pj_list_erase(cache);
+
+    if (--cache->ref_cnt <= 0)
+        free_entry(resolver, cache);
+}
+
+/* Remove least recently used entries until the cache is within its limit */
+static void evict_entries(pj_dns_resolver *resolver)
+{
+    unsigned max_cnt = resolver->settings.cache_max_entries;
+
+    if (max_cnt == 0)
+        return;
+
+    while (pj_hash_count(resolver->hrescache) > max_cnt &&
+           !pj_list_empty(&resolver->cache_lru))
+    {
+        struct cached_res *cache = resolver->cache_lru.next;
+
+        PJ_LOG(5,(resolver->name.ptr,
+                  "Cache full, removing DNS %s record for %s",
+                  pj_dns_get_type_name(cache->key.qtype), cache->key.name));
+
+        remove_entry(resolver, cache, 0);
+        resolver->cache_evictions++;
+    }
+}
+
+
+/* Create and send a new query, and register it in the hash tables */
+static pj_status_t send_new_query(pj_dns_resolver *resolver,
+                                  const struct res_key *key,
+                                  unsigned options,
+                                  pj_dns_callback *cb,
+                                  void *user_data,
+                                  pj_dns_async_query **p_q)
+{
+    pj_dns_async_query *q;
+    pj_status_t status;
+
+    q = alloc_qnode(resolver, options, user_data, cb);
+
+    /* Save the ID and key */
+    /* TODO: dnsext-forgery-resilient: randomize id for security */
+    q->id = resolver->last_id++;
+    if (resolver->last_id == 0)
+        resolver->last_id = 1;
+    pj_memcpy(&q->key, key, sizeof(struct res_key));
+
+    /* Send the query */
+    status = transmit_query(resolver, q);
+    if (status != PJ_SUCCESS) {
+        pj_list_push_back(&resolver->query_free_nodes, q);
+        return status;
+    }
+
+    /* Add query entry to the hash tables */
+    pj_hash_set_np(resolver->hquerybyid, &q->id, sizeof(q->id), 
+                   0, q->hbufid, q);
+    pj_hash_set_np(resolver->hquerybyres, &q->key, sizeof(q->key),
+                   0, q->hbufkey, q);
+
+    if (p_q)
+        *p_q = q;
+    return PJ_SUCCESS;
+}
+
+
+/* Refresh a cached positive response which is about to expire. The
+ * response of the query will replace the cached entry.
+ */
+static void prefetch_entry(pj_dns_resolver *resolver,
+                           struct cached_res *cache,
+                           const pj_time_val *now)
+{
+    unsigned prefetch_time = resolver->settings.prefetch_time;
+
+    if (prefetch_time == 0 || cache->prefetched ||
+        cache->ttl <= prefetch_time ||
+        cache->expiry_time.sec - now->sec > (long)prefetch_time ||
+        cache->pkt->hdr.anscount == 0 ||
+        PJ_DNS_GET_RCODE(cache->pkt->hdr.flags) != 0)
+    {
+        return;
+    }
+
+    /* There may already be a query for this resource */
+    if (pj_hash_get(resolver->hquerybyres, &cache->key, sizeof(cache->key),
+                    NULL))
+    {
+        return;
+    }
+
+    /* Only try once, even if the query fails */
+    cache->prefetched = PJ_TRUE;
+
+    if (send_new_query(resolver, &cache->key, 0, NULL, NULL, NULL) ==
+        PJ_SUCCESS)
+    {
+        PJ_LOG(5,(resolver->name.ptr,
+                  "Refreshing DNS %s record for %s in the cache, ttl=%d",
+                  pj_dns_get_type_name(cache->key.qtype), cache->key.name,
+                  (int)(cache->expiry_time.sec - now->sec)));
+        resolver->cache_prefetches++;
+    }
+}
+
 
 /*
  * Create and start asynchronous DNS query for a single resource.
@@ -910,6 +1080,14 @@ PJ_DEF(pj_status_t) pj_dns_resolver_start_query( pj_dns_resolver *resolver,
             status = PJ_DNS_GET_RCODE(cache->pkt->hdr.flags);
             status = PJ_STATUS_FROM_DNS_RCODE(status);
 
+            /* Mark the entry as most recently used */
+            pj_list_erase(cache);
+            pj_list_push_back(&resolver->cache_lru, cache);
+            resolver->cache_hits++;
+
+            /* Refresh the entry in the background if it expires soon */
+            prefetch_entry(resolver, cache, &now);
+
             /* Workaround for deadlock problem. Need to increment the cache's
              * ref counter first before releasing mutex, so the cache won't be
              * destroyed by other thread while in callback.
@@ -953,18 +1131,16 @@ PJ_DEF(pj_status_t) pj_dns_resolver_start_query( pj_dns_resolver *resolver,
         }
 
         /* At this point, we have a cached entry, but this entry has expired.
-         * Remove this entry from the cached list.
+         * Remove this entry from the cached list, and also free the cache
+         * if it is not being used (by callback).
          */
-        pj_hash_set(NULL, resolver->hrescache, &key, sizeof(key), 0, NULL);
-
-        /* Also free the cache, if it is not being used (by callback). */
-        cache->ref_cnt--;
-        if (cache->ref_cnt <= 0)
-            free_entry(resolver, cache);
+        remove_entry(resolver, cache, hval);
 
         /* Must continue with creating a query now */
     }
 
+    resolver->cache_misses++;
+
     /* Next, check if we have pending query on the same resource */
     q = (pj_dns_async_query *) pj_hash_get(resolver->hquerybyres, &key, 
                                            sizeof(key), NULL);
@@ -987,29 +1163,7 @@ PJ_DEF(pj_status_t) pj_dns_resolver_start_query( pj_dns_resolver *resolver,
     } 
 
     /* There's no pending query to the same key, initiate a new one. */
-    q = alloc_qnode(resolver, options, user_data, cb);
-
-    /* Save the ID and key */
-    /* TODO: dnsext-forgery-resilient: randomize id for security */
-    q->id = resolver->last_id++;
-    if (resolver->last_id == 0)
-        resolver->last_id = 1;
-    pj_memcpy(&q->key, &key, sizeof(struct res_key));
-
-    /* Send the query */
-    status = transmit_query(resolver, q);
-    if (status != PJ_SUCCESS) {
-        pj_list_push_back(&resolver->query_free_nodes, q);
-        goto on_return;
-    }
-
-    /* Add query entry to the hash tables */
-    pj_hash_set_np(resolver->hquerybyid, &q->id, sizeof(q->id), 
-                   0, q->hbufid, q);
-    pj_hash_set_np(resolver->hquerybyres, &q->key, sizeof(q->key),
-                   0, q->hbufkey, q);
-
-    p_q = q;
+    status = send_new_query(resolver, &key, options, cb, user_data, &p_q);
 
 on_return:
     if (p_query)
@@ -1026,24 +1180,41 @@ on_return:
 PJ_DEF(pj_status_t) pj_dns_resolver_cancel_query(pj_dns_async_query *query,
                                                  pj_bool_t notify)
 {
+    pj_dns_resolver *resolver;
     pj_dns_callback *cb;
+    void *user_data;
 
     PJ_ASSERT_RETURN(query, PJ_EINVAL);
 
-    pj_grp_lock_acquire(query->resolver->grp_lock);
-
-    if (query->timer_entry.id == 1) {
-        pj_timer_heap_cancel_if_active(query->resolver->timer,
-                                       &query->timer_entry, 0);
-    }
+    resolver = query->resolver;
+    pj_grp_lock_acquire(resolver->grp_lock);
 
     cb = query->cb;
+    user_data = query->user_data;
     query->cb = NULL;
 
-    if (notify)
-        (*cb)(query->user_data, PJ_ECANCELLED, NULL);
+    /* A pending query that other queries for the same resource have
+     * joined must keep running for them. Otherwise remove it, so that
+     * later queries for the resource don't join a query whose timer
+     * has been cancelled and which may never complete.
+     */
+    if (query->timer_entry.id == 1 && pj_list_empty(&query->child_head) &&
+        pj_hash_get(resolver->hquerybyid, &query->id, sizeof(query->id),
+                    NULL) == query)
+    {
+        pj_timer_heap_cancel_if_active(resolver->timer,
+                                       &query->timer_entry, 0);
+        pj_hash_set(NULL, resolver->hquerybyid, &query->id,
+                    sizeof(query->id), 0, NULL);
+        pj_hash_set(NULL, resolver->hquerybyres, &query->key,
+                    sizeof(query->key), 0, NULL);
+        pj_list_push_back(&resolver->query_free_nodes, query);
+    }
+
+    if (notify && cb)
+        (*cb)(user_data, PJ_ECANCELLED, NULL);
 
-    pj_grp_lock_release(query->resolver->grp_lock);
+    pj_grp_lock_release(resolver->grp_lock);
     return PJ_SUCCESS;
 }
 
@@ -1315,11 +1486,39 @@ static void set_nameserver_state(pj_dns_resolver *resolver,
 }
 
 
+/* Check if the nameserver index is in the array */
+static pj_bool_t is_selected(const unsigned servers[], unsigned count,
+                             unsigned index)
+{
+    unsigned i;
+
+    for (i=0; i<count; ++i) {
+        if (servers[i] == index)
+            return PJ_TRUE;
+    }
+    return PJ_FALSE;
+}
+
+/* Compare smoothed response time. Nameserver without response time
+ * sample is ranked last.
+ */
+static pj_bool_t is_faster(const struct nameserver *ns1,
+                           const struct nameserver *ns2)
+{
+    if (ns1->rtt_cnt == 0)
+        return PJ_FALSE;
+    if (ns2->rtt_cnt == 0)
+        return PJ_TRUE;
+    return ns1->srtt < ns2->srtt;
+}
+
+
 /* Select which nameserver(s) to use. Note this may return multiple
  * name servers. The algorithm to select which nameservers to be
  * sent the request to is as follows:
- *  - select the first nameserver that is known to be good for the
- *    last PJ_DNS_RESOLVER_GOOD_NS_TTL interval.
+ *  - select the race_ns_count nameservers with the best smoothed response
+ *    time among those known to be good for the last
+ *    PJ_DNS_RESOLVER_GOOD_NS_TTL interval.
  *  - for all NSes, if last_known_good >= PJ_DNS_RESOLVER_GOOD_NS_TTL, 
  *    include the NS to re-check again that the server is still good,
  *    unless the NS is known to be bad in the last PJ_DNS_RESOLVER_BAD_NS_TTL
@@ -1331,7 +1530,7 @@ static pj_status_t select_nameservers(pj_dns_resolver *resolver,
                                       unsigned *count,
                                       unsigned servers[])
 {
-    unsigned i, max_count=*count;
+    unsigned i, max_count=*count, race_cnt, active_cnt;
     int min;
     pj_time_val now;
 
@@ -1346,22 +1545,30 @@ static pj_status_t select_nameservers(pj_dns_resolver *resolver,
 
     pj_gettimeofday(&now);
 
-    /* Select one Active nameserver with best response time. */
-    for (min=-1, i=0; i<resolver->ns_count; ++i) {
-        struct nameserver *ns = &resolver->ns[i];
+    race_cnt = resolver->settings.race_ns_count;
+    if (race_cnt == 0)
+        race_cnt = 1;
+    if (race_cnt > max_count)
+        race_cnt = max_count;
 
-        if (ns->state != STATE_ACTIVE)
-            continue;
+    /* Select Active nameserver(s) with best response time. */
+    while (*count < race_cnt) {
+        for (min=-1, i=0; i<resolver->ns_count; ++i) {
+            struct nameserver *ns = &resolver->ns[i];
 
+            if (ns->state != STATE_ACTIVE || is_selected(servers, *count, i))
+                continue;
+
+            if (min == -1 || is_faster(ns, &resolver->ns[min]))
+                min = i;
+        }
         if (min == -1)
-            min = i;
-        else if (PJ_TIME_VAL_LT(ns->rt_delay, resolver->ns[min].rt_delay))
-            min = i;
-    }
-    if (min != -1) {
-        servers[0] = min;
+            break;
+
+        servers[*count] = min;
         ++(*count);
     }
+    active_cnt = *count;
 
     /* Scan nameservers. */
     for (i=0; i<resolver->ns_count && *count < max_count; ++i) {
@@ -1372,12 +1579,14 @@ static pj_status_t select_nameservers(pj_dns_resolver *resolver,
                 set_nameserver_state(resolver, i, STATE_BAD, &now);
             } else {
                 set_nameserver_state(resolver, i, STATE_PROBING, &now);
-                if ((int)i != min) {
+                if (!is_selected(servers, active_cnt, i)) {
                     servers[*count] = i;
                     ++(*count);
                 }
             }
-        } else if (ns->state == STATE_PROBING && (int)i != min) {
+        } else if (ns->state == STATE_PROBING &&
+                   !is_selected(servers, active_cnt, i))
+        {
             servers[*count] = i;
             ++(*count);
         }
@@ -1387,10 +1596,28 @@ static pj_status_t select_nameservers(pj_dns_resolver *resolver,
 }
 
 
-/* Update name server status */
-static void report_nameserver_status(pj_dns_resolver *resolver,
-                                     const pj_sockaddr *ns_addr,
-                                     const pj_dns_parsed_packet *pkt)
+/* Add response time sample for the nameserver */
+static void update_ns_rtt(struct nameserver *ns, const pj_time_val *rt)
+{
+    unsigned msec = (unsigned)PJ_TIME_VAL_MSEC(*rt);
+
+    ns->rt_delay = *rt;
+
+    /* Exponentially weighted moving average with 1/8 gain */
+    if (ns->rtt_cnt++ == 0)
+        ns->srtt = msec;
+    else
+        ns->srtt = (ns->srtt * 7 + msec) / 8;
+}
+
+
+/* Update name server status, and return the nameserver which sent the
+ * packet.
+ */
+static struct nameserver *report_nameserver_status(
+                                        pj_dns_resolver *resolver,
+                                        const pj_sockaddr *ns_addr,
+                                        const pj_dns_hdr *hdr)
 {
     unsigned i;
     int rcode;
@@ -1401,9 +1628,9 @@ static void report_nameserver_status(pj_dns_resolver *resolver,
     /* Only mark nameserver as "bad" if it returned non-parseable response or
      * it returned the following status codes
      */
-    if (pkt) {
-        rcode = PJ_DNS_GET_RCODE(pkt->hdr.flags);
-        q_id = pkt->hdr.id;
+    if (hdr) {
+        rcode = PJ_DNS_GET_RCODE(hdr->flags);
+        q_id = hdr->id;
     } else {
         rcode = 0;
         q_id = (pj_uint32_t)-1;
@@ -1414,7 +1641,7 @@ static void report_nameserver_status(pj_dns_resolver *resolver,
      * SERVFAIL should prevent the server to be contacted again for other
      * queries. So let's not mark nameserver as bad for SERVFAIL response.
      */
-    if (!pkt || /* rcode == PJ_DNS_RCODE_SERVFAIL || */
+    if (!hdr || /* rcode == PJ_DNS_RCODE_SERVFAIL || */
                 rcode == PJ_DNS_RCODE_REFUSED ||
                 rcode == PJ_DNS_RCODE_NOTAUTH) 
     {
@@ -1432,18 +1659,21 @@ static void report_nameserver_status(pj_dns_resolver *resolver,
         struct nameserver *ns = &resolver->ns[i];
 
         if (pj_sockaddr_cmp(&ns->addr, ns_addr) == 0) {
+            ns->resp_cnt++;
             if (q_id == ns->q_id) {
                 /* Calculate response time */
                 pj_time_val rt = now;
                 PJ_TIME_VAL_SUB(rt, ns->sent_time);
-                ns->rt_delay = rt;
+                update_ns_rtt(ns, &rt);
                 ns->q_id = 0;
             }
             set_nameserver_state(resolver, i, 
                                  (is_good ? STATE_ACTIVE : STATE_BAD), &now);
-            break;
+            return ns;
         }
     }
+
+    return NULL;
 }
 
 
@@ -1461,12 +1691,8 @@ static void update_res_cache(pj_dns_resolver *resolver,
     if (status != PJ_SUCCESS) {
         cache = (struct cached_res *) pj_hash_get(resolver->hrescache, key, 
                                                   sizeof(*key), &hval);
-        /* Remove the entry before releasing its pool (see ticket #1710) */
-        pj_hash_set(NULL, resolver->hrescache, key, sizeof(*key), hval, NULL);
-        
-        /* Free the entry */
-        if (cache && --cache->ref_cnt <= 0)
-            free_entry(resolver, cache);
+        if (cache)
+            remove_entry(resolver, cache, hval);
     }
 
 
@@ -1474,10 +1700,10 @@ static void update_res_cache(pj_dns_resolver *resolver,
     if (set_expiry) {
         if (pkt->hdr.anscount == 0 || status != PJ_SUCCESS) {
             /* If we don't have answers for the name, then give a different
-             * ttl value (note: PJ_DNS_RESOLVER_INVALID_TTL may be zero, 
-             * which means that invalid names won't be kept in the cache)
+             * ttl value (note: cache_neg_ttl may be zero, which means that
+             * invalid names won't be kept in the cache)
              */
-            ttl = PJ_DNS_RESOLVER_INVALID_TTL;
+            ttl = resolver->settings.cache_neg_ttl;
 
         } else {
             /* Otherwise get the minimum TTL from the answers */
@@ -1502,12 +1728,8 @@ static void update_res_cache(pj_dns_resolver *resolver,
 
     /* If TTL is zero, clear the same entry in the hash table */
     if (ttl == 0) {
-        /* Remove the entry before releasing its pool (see ticket #1710) */
-        pj_hash_set(NULL, resolver->hrescache, key, sizeof(*key), hval, NULL);
-
-        /* Free the entry */
-        if (cache && --cache->ref_cnt <= 0)
-            free_entry(resolver, cache);
+        if (cache)
+            remove_entry(resolver, cache, hval);
         return;
     }
 
@@ -1516,6 +1738,7 @@ static void update_res_cache(pj_dns_resolver *resolver,
     } else {
         /* Remove the entry before resetting its pool (see ticket #1710) */
         pj_hash_set(NULL, resolver->hrescache, key, sizeof(*key), hval, NULL);
+        pj_list_erase(cache);
 
         if (cache->ref_cnt > 1) {
             /* When cache entry is being used by callback (to app),
@@ -1544,6 +1767,7 @@ static void update_res_cache(pj_dns_resolver *resolver,
     if (set_expiry) {
         pj_gettimeofday(&cache->expiry_time);
         cache->expiry_time.sec += ttl;
+        cache->ttl = ttl;
     } else {
         cache->expiry_time.sec = 0x7FFFFFFFL;
         cache->expiry_time.msec = 0;
@@ -1555,7 +1779,10 @@ static void update_res_cache(pj_dns_resolver *resolver,
     /* Update the hash table */
     pj_hash_set_np(resolver->hrescache, &cache->key, sizeof(*key), hval,
                    cache->hbuf, cache);
+    pj_list_push_back(&resolver->cache_lru, cache);
 
+    /* Keep the cache within its size limit */
+    evict_entries(resolver);
 }
 
 
@@ -1566,6 +1793,7 @@ static void on_timeout( pj_timer_heap_t *timer_heap,
     pj_dns_resolver *resolver;
     pj_dns_async_query *q, *cq;
     pj_status_t status;
+    unsigned i;
 
     PJ_UNUSED_ARG(timer_heap);
 
@@ -1587,6 +1815,22 @@ static void on_timeout( pj_timer_heap_t *timer_heap,
     /* Invalidate id. */
     q->timer_entry.id = 0;
 
+    /* Nameservers which have not answered count the elapsed time as their
+     * response time, so that they are ranked lower.
+     */
+    for (i=0; i<resolver->ns_count; ++i) {
+        struct nameserver *ns = &resolver->ns[i];
+
+        if (ns->q_id == q->id) {
+            pj_time_val rt;
+
+            pj_gettimeofday(&rt);
+            PJ_TIME_VAL_SUB(rt, ns->sent_time);
+            update_ns_rtt(ns, &rt);
+            ns->q_id = 0;
+        }
+    }
+
     /* Check to see if we should retransmit instead of time out */
     if (q->transmit_cnt < resolver->settings.qretr_count) {
         status = transmit_query(resolver, q);
@@ -1606,18 +1850,23 @@ static void on_timeout( pj_timer_heap_t *timer_heap,
     pj_hash_set(NULL, resolver->hquerybyid, &q->id, sizeof(q->id), 0, NULL);
     pj_hash_set(NULL, resolver->hquerybyres, &q->key, sizeof(q->key), 0, NULL);
 
+    /* Report the error answer received while waiting for the other
+     * nameservers, if any, rather than the timeout.
+     */
+    status = (q->last_err != PJ_SUCCESS) ? q->last_err : PJ_ETIMEDOUT;
+
     /* Workaround for deadlock problem in #1565 (similar to #1108) */
     pj_grp_lock_release(resolver->grp_lock);
 
     /* Call application callback, if any. */
     if (q->cb)
-        (*q->cb)(q->user_data, PJ_ETIMEDOUT, NULL);
+        (*q->cb)(q->user_data, status, NULL);
 
     /* Call application callback for child queries. */
     cq = q->child_head.next;
     while (cq != (void*)&q->child_head) {
         if (cq->cb)
-            (*cq->cb)(cq->user_data, PJ_ETIMEDOUT, NULL);
+            (*cq->cb)(cq->user_data, status, NULL);
         cq = cq->next;
     }
 
@@ -1650,9 +1899,12 @@ static void on_read_complete(pj_ioqueue_key_t *key,
 {
     pj_dns_resolver *resolver;
     pj_pool_t *pool = NULL;
+    pj_dns_packet_view view;
     pj_dns_parsed_packet *dns_pkt;
     pj_dns_async_query *q;
+    struct nameserver *ns;
     char addr[PJ_INET6_ADDRSTRLEN];
+    int rcode;
     pj_sockaddr *src_addr;
     int *src_addr_len;
     unsigned char *rx_pkt;
@@ -1701,23 +1953,49 @@ static void on_read_complete(pj_ioqueue_key_t *key,
     if (bytes_read == 0)
         goto read_next_packet;
 
-    /* Create temporary pool from a fixed buffer */
-    pool = pj_pool_create_on_buf("restmp", resolver->tmp_pool, 
-                                 sizeof(resolver->tmp_pool));
-
-    /* Parse DNS response */
+    /* Parse the header first, so that responses which don't belong to
+     * any pending query (such as the late answers when the query was sent
+     * to several nameservers) don't need to be parsed in full.
+     */
     dns_pkt = NULL;
-    PJ_TRY {
-        status = pj_dns_parse_packet(pool, rx_pkt, 
-                                     (unsigned)bytes_read, &dns_pkt);
+    q = NULL;
+    rcode = 0;
+    status = pj_dns_parse_packet_view(rx_pkt, (unsigned)bytes_read,
+                                      NULL, 0, &view);
+    if (status == PJ_SUCCESS) {
+        q = (pj_dns_async_query*)
+            pj_hash_get(resolver->hquerybyid, &view.hdr.id,
+                        sizeof(view.hdr.id), NULL);
+        rcode = PJ_DNS_GET_RCODE(view.hdr.flags);
     }
-    PJ_CATCH_ANY {
-        status = PJ_ENOMEM;
+
+    /* When the query was raced on several nameservers (race_ns_count > 1),
+     * an error response only completes it if it is the last nameserver to
+     * answer, so it doesn't need to be parsed either. Otherwise any
+     * response completes the query, as it always has.
+     */
+    if (q && (rcode == 0 || rcode == PJ_DNS_RCODE_NXDOMAIN ||
+              resolver->settings.race_ns_count <= 1 ||
+              q->pending_ns_cnt <= 1))
+    {
+        /* Create temporary pool from a fixed buffer */
+        pool = pj_pool_create_on_buf("restmp", resolver->tmp_pool, 
+                                     sizeof(resolver->tmp_pool));
+
+        /* Parse DNS response */
+        PJ_TRY {
+            status = pj_dns_parse_packet(pool, rx_pkt, 
+                                         (unsigned)bytes_read, &dns_pkt);
+        }
+        PJ_CATCH_ANY {
+            status = PJ_ENOMEM;
+        }
+        PJ_END;
     }
-    PJ_END;
 
     /* Update nameserver status */
-    report_nameserver_status(resolver, src_addr, dns_pkt);
+    ns = report_nameserver_status(resolver, src_addr,
+                                  (status == PJ_SUCCESS ? &view.hdr : NULL));
 
     /* Handle parse error */
     if (status != PJ_SUCCESS) {
@@ -1728,21 +2006,34 @@ static void on_read_complete(pj_ioqueue_key_t *key,
         goto read_next_packet;
     }
 
-    /* Find the query based on the transaction ID */
-    q = (pj_dns_async_query*) 
-        pj_hash_get(resolver->hquerybyid, &dns_pkt->hdr.id,
-                    sizeof(dns_pkt->hdr.id), NULL);
+    /* The query was looked up from the transaction ID above */
     if (!q) {
         PJ_LOG(5,(resolver->name.ptr, 
                   "DNS response from %s:%d id=%d discarded",
                   pj_sockaddr_print(src_addr, addr, sizeof(addr), 2),
                   pj_sockaddr_get_port(src_addr),
-                  (unsigned)dns_pkt->hdr.id));
+                  (unsigned)view.hdr.id));
         goto read_next_packet;
     }
 
+    /* Error response while other nameservers may still answer */
+    if (!dns_pkt) {
+        --q->pending_ns_cnt;
+        q->last_err = PJ_STATUS_FROM_DNS_RCODE(rcode);
+        PJ_LOG(5,(resolver->name.ptr,
+                  "DNS %s response for %s from %s:%d has rcode %d, waiting "
+                  "for other nameservers",
+                  pj_dns_get_type_name(q->key.qtype), q->key.name,
+                  pj_sockaddr_print(src_addr, addr, sizeof(addr), 2),
+                  pj_sockaddr_get_port(src_addr), rcode));
+        goto read_next_packet;
+    }
+
+    if (ns)
+        ns->win_cnt++;
+
     /* Map DNS Rcode in the response into PJLIB status name space */
-    status = PJ_STATUS_FROM_DNS_RCODE(PJ_DNS_GET_RCODE(dns_pkt->hdr.flags));
+    status = PJ_STATUS_FROM_DNS_RCODE(rcode);
 
     /* Cancel query timeout timer. */
     pj_assert(q->timer_entry.id != 0);
@@ -1753,12 +2044,20 @@ static void on_read_complete(pj_ioqueue_key_t *key,
     pj_hash_set(NULL, resolver->hquerybyid, &q->id, sizeof(q->id), 0, NULL);
     pj_hash_set(NULL, resolver->hquerybyres, &q->key, sizeof(q->key), 0, NULL);
 
+    /* Save the response to the cache before notifying applications, so
+     * that a query started from (or right after) the callback is answered
+     * from the cache instead of being sent to the nameserver again.
+     * Truncated responses MUST NOT be saved (cached).
+     */
+    if (PJ_DNS_GET_TC(dns_pkt->hdr.flags) == 0) {
+        /* Save/update response cache. */
+        update_res_cache(resolver, &q->key, status, PJ_TRUE, dns_pkt);
+    }
+
     /* Workaround for deadlock problem in #1108 */
     pj_grp_lock_release(resolver->grp_lock);
 
-    /* Notify applications first, to allow application to modify the 
-     * record before it is saved to the hash table.
-     */
+    /* Notify applications */
     if (q->cb)
         (*q->cb)(q->user_data, status, dns_pkt);
 
@@ -1777,12 +2076,6 @@ static void on_read_complete(pj_ioqueue_key_t *key,
     /* Workaround for deadlock problem in #1108 */
     pj_grp_lock_acquire(resolver->grp_lock);
 
-    /* Truncated responses MUST NOT be saved (cached). */
-    if (PJ_DNS_GET_TC(dns_pkt->hdr.flags) == 0) {
-        /* Save/update response cache. */
-        update_res_cache(resolver, &q->key, status, PJ_TRUE, dns_pkt);
-    }
-
     /* Recycle query objects, starting with the child queries */
     if (!pj_list_empty(&q->child_head)) {
         pj_dns_async_query *child_q;
@@ -1907,17 +2200,27 @@ PJ_DEF(void) pj_dns_resolver_dump(pj_dns_resolver *resolver,
         struct nameserver *ns = &resolver->ns[i];
 
         PJ_LOG(3,(resolver->name.ptr,
-                  "   NS %d: %s:%d (state=%s until %lds, rtt=%ld ms)",
+                  "   NS %d: %s:%d (state=%s until %lds, rtt=%ld ms, "
+                  "srtt=%u ms)",
                   i,
                   pj_sockaddr_print(&ns->addr, addr, sizeof(addr), 2),
                   pj_sockaddr_get_port(&ns->addr),
                   state_names[ns->state],
                   ns->state_expiry.sec - now.sec,
-                  PJ_TIME_VAL_MSEC(ns->rt_delay)));
+                  PJ_TIME_VAL_MSEC(ns->rt_delay),
+                  ns->srtt));
+        PJ_LOG(3,(resolver->name.ptr,
+                  "         sent=%u, responses=%u, answers used=%u",
+                  ns->sent_cnt, ns->resp_cnt, ns->win_cnt));
     }
 
-    PJ_LOG(3,(resolver->name.ptr, "  Nb. of cached responses: %u",
-              pj_hash_count(resolver->hrescache)));
+    PJ_LOG(3,(resolver->name.ptr, "  Nb. of cached responses: %u (max %u)",
+              pj_hash_count(resolver->hrescache),
+              resolver->settings.cache_max_entries));
+    PJ_LOG(3,(resolver->name.ptr,
+              "  Cache hits: %u, misses: %u, evictions: %u, prefetches: %u",
+              resolver->cache_hits, resolver->cache_misses,
+              resolver->cache_evictions, resolver->cache_prefetches));
     if (detail) {
         pj_hash_iterator_t itbuf, *it;
         it = pj_hash_first(resolver->hrescache, &itbuf);
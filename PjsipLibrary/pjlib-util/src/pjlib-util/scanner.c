@@ -40,6 +40,181 @@
 #endif
 
 
+#if PJ_SCANNER_USE_SIMD
+#  include <immintrin.h>
+
+/*
+ * Vector scanning.
+ *
+ * Each byte of a block is tested against the cis with three table
+ * lookups (pshufb): the low nibble selects a byte of simd_map, from the
+ * upper half for bytes >= 0x80, and the high nibble selects the bit in
+ * that byte. This gives the mask of the bytes which are members, and the
+ * run ends at the first byte whose membership differs from "member".
+ *
+ * The functions below only check whole blocks. They return the end of
+ * the run, or where less than a block of input is left, and the caller
+ * finishes with the byte loop.
+ */
+enum
+{
+    SCAN_SIMD_UNKNOWN = -1,
+    SCAN_SIMD_NONE,
+    SCAN_SIMD_SSSE3,
+    SCAN_SIMD_AVX2
+};
+
+static int scan_simd = SCAN_SIMD_UNKNOWN;
+
+/* Number of bytes checked one at a time before using the vector code */
+#ifndef PJ_SCAN_SIMD_MIN_LEN
+#  define PJ_SCAN_SIMD_MIN_LEN  16
+#endif
+
+#define SSSE3_FUNC  __attribute__((target("ssse3")))
+#define AVX2_FUNC   __attribute__((target("avx2")))
+
+SSSE3_FUNC
+static char *ssse3_span(const pj_cis_t *spec, char *s, const char *end,
+                        int member)
+{
+    const __m128i map_lo = _mm_loadu_si128((const __m128i*)spec->simd_map);
+    const __m128i map_hi = _mm_loadu_si128((const __m128i*)
+                                           (spec->simd_map+16));
+    const __m128i bits = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128,
+                                       1, 2, 4, 8, 16, 32, 64, -128);
+    const __m128i idx_mask = _mm_set1_epi8((char)0x8F);
+    const __m128i hi_bit = _mm_set1_epi8((char)0x80);
+    const __m128i nibble = _mm_set1_epi8(0x0F);
+    const unsigned flip = member ? 0xFFFF : 0;
+
+    for (; end - s >= 16; s += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)s);
+        __m128i idx = _mm_and_si128(v, idx_mask);
+        __m128i row, bit;
+        unsigned stop;
+
+        row = _mm_or_si128(_mm_shuffle_epi8(map_lo, idx),
+                           _mm_shuffle_epi8(map_hi,
+                                            _mm_xor_si128(idx, hi_bit)));
+        bit = _mm_shuffle_epi8(bits,
+                               _mm_and_si128(_mm_srli_epi16(v, 4), nibble));
+        stop = (unsigned)_mm_movemask_epi8(
+                    _mm_cmpeq_epi8(_mm_and_si128(row, bit), bit)) ^ flip;
+        if (stop)
+            return s + __builtin_ctz(stop);
+    }
+    return s;
+}
+
+AVX2_FUNC
+static char *avx2_span(const pj_cis_t *spec, char *s, const char *end,
+                       int member)
+{
+    const __m256i map_lo = _mm256_broadcastsi128_si256(
+                    _mm_loadu_si128((const __m128i*)spec->simd_map));
+    const __m256i map_hi = _mm256_broadcastsi128_si256(
+                    _mm_loadu_si128((const __m128i*)(spec->simd_map+16)));
+    const __m256i bits = _mm256_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128,
+                                          1, 2, 4, 8, 16, 32, 64, -128,
+                                          1, 2, 4, 8, 16, 32, 64, -128,
+                                          1, 2, 4, 8, 16, 32, 64, -128);
+    const __m256i idx_mask = _mm256_set1_epi8((char)0x8F);
+    const __m256i hi_bit = _mm256_set1_epi8((char)0x80);
+    const __m256i nibble = _mm256_set1_epi8(0x0F);
+    const unsigned flip = member ? 0xFFFFFFFF : 0;
+
+    for (; end - s >= 32; s += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)s);
+        __m256i idx = _mm256_and_si256(v, idx_mask);
+        __m256i row, bit;
+        unsigned stop;
+
+        row = _mm256_or_si256(_mm256_shuffle_epi8(map_lo, idx),
+                              _mm256_shuffle_epi8(map_hi,
+                                        _mm256_xor_si256(idx, hi_bit)));
+        bit = _mm256_shuffle_epi8(bits,
+                        _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble));
+        stop = (unsigned)_mm256_movemask_epi8(
+                    _mm256_cmpeq_epi8(_mm256_and_si256(row, bit), bit)) ^
+               flip;
+        if (stop)
+            return s + __builtin_ctz(stop);
+    }
+
+    /* One more half block */
+    return ssse3_span(spec, s, end, member);
+}
+
+/* Select the instruction set for the CPU we are running on. */
+static int get_scan_simd(void)
+{
+    int simd = scan_simd;
+
+    if (simd != SCAN_SIMD_UNKNOWN)
+        return simd;
+
+    if (__builtin_cpu_supports("avx2"))
+        simd = SCAN_SIMD_AVX2;
+    else if (__builtin_cpu_supports("ssse3"))
+        simd = SCAN_SIMD_SSSE3;
+    else
+        simd = SCAN_SIMD_NONE;
+
+    /* Setting the value more than once is harmless */
+    scan_simd = simd;
+    return simd;
+}
+
+#endif  /* PJ_SCANNER_USE_SIMD */
+
+
+/* Find the end of the run of characters starting at s which are members
+ * of spec (member is non-zero) or which are not (member is zero).
+ */
+static char *cis_span(const pj_cis_t *spec, char *s, const char *end,
+                      int member)
+{
+#if PJ_SCANNER_USE_SIMD
+    /* Most runs (tokens, parameter names) are short, for which the byte
+     * loop is faster. The vector code is only used for the rest of a run
+     * longer than PJ_SCAN_SIMD_MIN_LEN bytes.
+     */
+    if (end - s > PJ_SCAN_SIMD_MIN_LEN + 16) {
+        const char *limit = s + PJ_SCAN_SIMD_MIN_LEN;
+
+        if (member) {
+            while (s != limit && pj_cis_match(spec, *s))
+                ++s;
+        } else {
+            while (s != limit && !pj_cis_match(spec, *s))
+                ++s;
+        }
+        if (s != limit)
+            return s;
+
+        switch (get_scan_simd()) {
+        case SCAN_SIMD_AVX2:
+            s = avx2_span(spec, s, end, member);
+            break;
+        case SCAN_SIMD_SSSE3:
+            s = ssse3_span(spec, s, end, member);
+            break;
+        }
+    }
+#endif
+
+    if (member) {
+        while (s != end && pj_cis_match(spec, *s))
+            ++s;
+    } else {
+        while (s != end && !pj_cis_match(spec, *s))
+            ++s;
+    }
+    return s;
+}
+
+
 /* coverity[+kill] */
 static void pj_scan_syntax_err(pj_scanner *scanner)
 {
@@ -226,8 +401,7 @@ PJ_DEF(int) pj_scan_peek( pj_scanner *scanner,
         return -1;
     }
 
-    while (PJ_SCAN_CHECK_EOF(s) && pj_cis_match(spec, *s))
-        ++s;
+    s = cis_span(spec, s, scanner->end, 1);
 
     pj_strset3(out, scanner->curptr, s);
     return *s;
@@ -260,8 +434,7 @@ PJ_DEF(int) pj_scan_peek_until( pj_scanner *scanner,
         return -1;
     }
 
-    while (PJ_SCAN_CHECK_EOF(s) && !pj_cis_match( spec, *s))
-        ++s;
+    s = cis_span(spec, s, scanner->end, 0);
 
     pj_strset3(out, scanner->curptr, s);
     return *s;
@@ -280,9 +453,7 @@ PJ_DEF(void) pj_scan_get( pj_scanner *scanner,
         return;
     }
 
-    do {
-        ++s;
-    } while (PJ_SCAN_CHECK_EOF(s) && pj_cis_match(spec, *s));
+    s = cis_span(spec, s+1, scanner->end, 1);
 
     pj_strset3(out, scanner->curptr, s);
 
@@ -331,9 +502,7 @@ PJ_DEF(void) pj_scan_get_unescape( pj_scanner *scanner,
         
         if (pj_cis_match(spec, *s)) {
             char *start = s;
-            do {
-                ++s;
-            } while (PJ_SCAN_CHECK_EOF(s) && pj_cis_match(spec, *s));
+            s = cis_span(spec, s+1, scanner->end, 1);
 
             if (dst != start) pj_memmove(dst, start, s-start);
             dst += (s-start);
@@ -526,9 +695,7 @@ PJ_DEF(void) pj_scan_get_until( pj_scanner *scanner,
         return;
     }
 
-    while (PJ_SCAN_CHECK_EOF(s) && !pj_cis_match(spec, *s)) {
-        ++s;
-    }
+    s = cis_span(spec, s, scanner->end, 0);
 
     pj_strset3(out, scanner->curptr, s);
 
@@ -33,6 +33,9 @@ PJ_DEF(pj_status_t) pj_cis_init(pj_cis_buf_t *cis_buf, pj_cis_t *cis)
     unsigned i;
 
     cis->cis_buf = cis_buf->cis_buf;
+#if PJ_SCANNER_USE_SIMD
+    pj_bzero(cis->simd_map, sizeof(cis->simd_map));
+#endif
 
     for (i=0; i<PJ_CIS_MAX_INDEX; ++i) {
         if ((cis_buf->use_mask & (1 << i)) == 0) {
@@ -69,6 +69,13 @@ struct pj_dns_srv_async_query
     pj_dns_srv_resolver_cb  *cb;
     pj_status_t              last_error;
 
+    /* Parallel fallback queries (PJ_DNS_SRV_PARALLEL_FALLBACK), and the
+     * PJ_DNS_SRV_FALLBACK_A/AAAA flags of those that have failed.
+     */
+    pj_dns_async_query      *q_fallback_a;
+    pj_dns_async_query      *q_fallback_aaaa;
+    unsigned                 fallback_failed;
+
     /* Original request: */
     unsigned                 option;
     pj_str_t                 full_name;
@@ -90,6 +97,49 @@ static void dns_callback(void *user_data,
                          pj_status_t status,
                          pj_dns_parsed_packet *pkt);
 
+/* Callbacks of the parallel fallback queries. Successful answers are in
+ * the resolver cache by now, so only remember the failures, so that the
+ * fallback doesn't send the failed queries again.
+ */
+static void fallback_a_callback(void *user_data,
+                                pj_status_t status,
+                                pj_dns_parsed_packet *pkt)
+{
+    pj_dns_srv_async_query *query_job = (pj_dns_srv_async_query*)user_data;
+
+    PJ_UNUSED_ARG(pkt);
+
+    query_job->q_fallback_a = NULL;
+    if (status != PJ_SUCCESS)
+        query_job->fallback_failed |= PJ_DNS_SRV_FALLBACK_A;
+}
+
+static void fallback_aaaa_callback(void *user_data,
+                                   pj_status_t status,
+                                   pj_dns_parsed_packet *pkt)
+{
+    pj_dns_srv_async_query *query_job = (pj_dns_srv_async_query*)user_data;
+
+    PJ_UNUSED_ARG(pkt);
+
+    query_job->q_fallback_aaaa = NULL;
+    if (status != PJ_SUCCESS)
+        query_job->fallback_failed |= PJ_DNS_SRV_FALLBACK_AAAA;
+}
+
+/* Detach the pending parallel fallback queries from the query job */
+static void cancel_fallback(pj_dns_srv_async_query *query_job)
+{
+    if (query_job->q_fallback_a) {
+        pj_dns_resolver_cancel_query(query_job->q_fallback_a, PJ_FALSE);
+        query_job->q_fallback_a = NULL;
+    }
+    if (query_job->q_fallback_aaaa) {
+        pj_dns_resolver_cancel_query(query_job->q_fallback_aaaa, PJ_FALSE);
+        query_job->q_fallback_aaaa = NULL;
+    }
+}
+
 
 
 /*
@@ -159,6 +209,32 @@ PJ_DEF(pj_status_t) pj_dns_srv_resolve( const pj_str_t *domain_name,
     if (query_job->q_srv)
         p_q = query_job;
 
+    /* Start the fallback queries now if the SRV query is pending, so that
+     * their answers are already in the cache (or in progress) when the
+     * SRV resolution fails.
+     */
+    if (p_q && (query_job->option & PJ_DNS_SRV_PARALLEL_FALLBACK) &&
+        query_job->domain_part.slen > 0)
+    {
+        PJ_LOG(5, (query_job->objname,
+                   "Starting parallel fallback query_job for %.*s",
+                   (int)query_job->domain_part.slen,
+                   query_job->domain_part.ptr));
+
+        if (query_job->option & PJ_DNS_SRV_FALLBACK_A) {
+            pj_dns_resolver_start_query(resolver, &query_job->domain_part,
+                                        PJ_DNS_TYPE_A, 0,
+                                        &fallback_a_callback, query_job,
+                                        &query_job->q_fallback_a);
+        }
+        if (query_job->option & PJ_DNS_SRV_FALLBACK_AAAA) {
+            pj_dns_resolver_start_query(resolver, &query_job->domain_part,
+                                        PJ_DNS_TYPE_AAAA, 0,
+                                        &fallback_aaaa_callback, query_job,
+                                        &query_job->q_fallback_aaaa);
+        }
+    }
+
     if (status==PJ_SUCCESS && p_query)
         *p_query = p_q;
 
@@ -175,6 +251,8 @@ PJ_DEF(pj_status_t) pj_dns_srv_cancel_query(pj_dns_srv_async_query *query,
     pj_bool_t has_pending = PJ_FALSE;
     unsigned i;
 
+    cancel_fallback(query);
+
     if (query->q_srv) {
         pj_dns_resolver_cancel_query(query->q_srv, PJ_FALSE);
         query->q_srv = NULL;
@@ -626,6 +704,11 @@ static void dns_callback(void *user_data,
                       query_job->full_name.ptr,
                       errmsg));
 
+            /* Don't fall back to the parallel fallback queries that have
+             * failed already.
+             */
+            query_job->option &= ~query_job->fallback_failed;
+
             /* Trigger error when fallback is disabled */
             if ((query_job->option &
                  (PJ_DNS_SRV_FALLBACK_A | PJ_DNS_SRV_FALLBACK_AAAA)) == 0) 
@@ -849,6 +932,7 @@ static void dns_callback(void *user_data,
         }
 
         /* Call the callback */
+        cancel_fallback(query_job);
         (*query_job->cb)(query_job->token, status, &srv_rec);
     }
 
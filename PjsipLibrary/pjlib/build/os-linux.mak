@@ -16,6 +16,8 @@ export PJLIB_OBJS += 	addr_resolv_sock.o file_access_unistd.o \
 
 ifeq (epoll,$(LINUX_POLL))
 export PJLIB_OBJS += ioqueue_epoll.o
+else ifeq (uring,$(LINUX_POLL))
+export PJLIB_OBJS += ioqueue_uring.o
 else
 export PJLIB_OBJS += ioqueue_select.o 
 endif
@@ -188,6 +188,27 @@ typedef struct pj_activesock_cb
     pj_bool_t (*on_connect_complete)(pj_activesock_t *asock,
                                      pj_status_t status);
 
+    /**
+     * This callback is called when one or more packets arrive as the
+     * result of pj_activesock_start_recvfrom_batch(). Receive errors are
+     * still reported with \a on_data_recvfrom(). If this callback is not
+     * set, \a on_data_recvfrom() will be called once for every packet.
+     *
+     * @param asock     The active socket.
+     * @param pkts      Array of received packets. Only the \a buf,
+     *                  \a len, \a addr, and \a addr_len fields are
+     *                  meaningful.
+     * @param count     Number of packets in the array.
+     *
+     * @return          PJ_TRUE if further read is desired, and PJ_FALSE 
+     *                  when application no longer wants to receive data.
+     *                  Application may destroy the active socket in the
+     *                  callback and return PJ_FALSE here.
+     */
+    pj_bool_t (*on_data_recvfrom_batch)(pj_activesock_t *asock,
+                                        const pj_sock_mmsg pkts[],
+                                        unsigned count);
+
 } pj_activesock_cb;
 
 
@@ -485,6 +506,31 @@ PJ_DECL(pj_status_t) pj_activesock_start_recvfrom2(pj_activesock_t *asock,
                                                    void *readbuf[],
                                                    pj_uint32_t flags);
 
+/**
+ * Same as #pj_activesock_start_recvfrom() except that every time the
+ * socket becomes readable, up to \a batch_cnt packets will be drained
+ * from the socket with #pj_sock_recvmmsg() and delivered together in the
+ * \a on_data_recvfrom_batch() callback. This reduces the number of
+ * system calls and callbacks per packet under high packet rate.
+ *
+ * @param asock     The active socket.
+ * @param pool      Pool used to allocate buffers for incoming data.
+ * @param buff_size The size of each buffer, in bytes.
+ * @param batch_cnt Maximum number of packets to be delivered in one
+ *                  callback. For each pending read operation, this
+ *                  many buffers will be allocated.
+ * @param flags     Flags to be given to pj_ioqueue_recvfrom().
+ *
+ * @return          PJ_SUCCESS if the operation has been successful,
+ *                  or the appropriate error code on failure.
+ */
+PJ_DECL(pj_status_t) pj_activesock_start_recvfrom_batch(
+                                                pj_activesock_t *asock,
+                                                pj_pool_t *pool,
+                                                unsigned buff_size,
+                                                unsigned batch_cnt,
+                                                pj_uint32_t flags);
+
 /**
  * Send data using the socket.
  *
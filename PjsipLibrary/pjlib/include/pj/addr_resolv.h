@@ -180,6 +180,75 @@ PJ_DECL(pj_status_t) pj_getaddrinfo(int af, const pj_str_t *name,
                                     unsigned *count, pj_addrinfo ai[]);
 
 
+/**
+ * Opaque data type for asynchronous host name resolution query.
+ */
+typedef struct pj_getaddrinfo_query pj_getaddrinfo_query;
+
+/**
+ * Callback to receive the result of #pj_getaddrinfo_async().
+ *
+ * @param user_data The user data specified when starting the query.
+ * @param status    PJ_SUCCESS if the name was resolved, or the
+ *                  appropriate error code.
+ * @param count     Number of entries in \a ai.
+ * @param ai        The address information of the host. It is only valid
+ *                  during the callback.
+ */
+typedef void pj_getaddrinfo_cb(void *user_data,
+                               pj_status_t status,
+                               unsigned count,
+                               const pj_addrinfo ai[]);
+
+/**
+ * Asynchronous version of #pj_getaddrinfo(). The name is resolved by a
+ * small pool of resolver threads (see #PJ_GETADDRINFO_ASYNC_THREAD_CNT),
+ * so the calling thread is never blocked by the system resolver, and the
+ * results are kept in a cache (see #PJ_GETADDRINFO_CACHE_SIZE).
+ *
+ * The callback is called from one of the resolver threads. When the name
+ * is an IP address or the result is found in the cache, the callback is
+ * called before this function returns and \a p_query is set to NULL.
+ *
+ * Queries that are still pending when PJLIB is shut down are discarded
+ * without calling their callback.
+ *
+ * @param af        The desired address family to query. Valid values
+ *                  are pj_AF_INET(), pj_AF_INET6(), or pj_AF_UNSPEC().
+ * @param name      Descriptive name or an address string, such as host
+ *                  name.
+ * @param max_count Maximum number of addresses to return. It is capped at
+ *                  #PJ_GETADDRINFO_ASYNC_MAX_CNT.
+ * @param user_data Arbitrary data to be passed to the callback.
+ * @param cb        The callback to receive the result.
+ * @param p_query   Optional pointer to receive the query object, which
+ *                  can be used to cancel the query. It is only valid
+ *                  until the callback is called.
+ *
+ * @return          PJ_SUCCESS if the query has been started or completed,
+ *                  or the appropriate error code. The callback is not
+ *                  called when an error is returned.
+ */
+PJ_DECL(pj_status_t) pj_getaddrinfo_async(int af, const pj_str_t *name,
+                                          unsigned max_count,
+                                          void *user_data,
+                                          pj_getaddrinfo_cb *cb,
+                                          pj_getaddrinfo_query **p_query);
+
+/**
+ * Cancel a pending query started with #pj_getaddrinfo_async(). The
+ * query object must not be used once its callback has returned.
+ *
+ * @param query     The query.
+ *
+ * @return          PJ_SUCCESS if the query was cancelled and the callback
+ *                  will not be called, or PJ_EBUSY if the callback is
+ *                  being called.
+ */
+PJ_DECL(pj_status_t) pj_getaddrinfo_cancel(pj_getaddrinfo_query *query);
+
+
+
 
 /** @} */
 
@@ -121,8 +121,14 @@
 
 #define PJ_ATOMIC_VALUE_TYPE            long
 
-/* If 1, use Read/Write mutex emulation for platforms that don't support it */
-#define PJ_EMULATE_RWMUTEX              1
+/* If 1, use Read/Write mutex emulation for platforms that don't support it.
+ * Define it to 0 in the compiler flags to use slim reader/writer lock
+ * instead (requires Windows Vista). Note that a slim reader/writer lock
+ * must not be acquired recursively for reading.
+ */
+#ifndef PJ_EMULATE_RWMUTEX
+#   define PJ_EMULATE_RWMUTEX           1
+#endif
 
 /* If 1, pj_thread_create() should enforce the stack size when creating 
  * threads.
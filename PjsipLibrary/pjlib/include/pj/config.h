@@ -496,6 +496,27 @@
 #   define PJ_LOG_THREAD_WIDTH      12
 #endif
 
+/**
+ * Default size of the message queue of the asynchronous logging, in
+ * bytes (see #pj_log_async_start()). It must be at least twice
+ * PJ_LOG_MAX_SIZE.
+ *
+ * Default: 262144
+ */
+#ifndef PJ_LOG_ASYNC_BUF_SIZE
+#   define PJ_LOG_ASYNC_BUF_SIZE    262144
+#endif
+
+/**
+ * Default maximum number of bytes the asynchronous logging passes to the
+ * log writer function in one call.
+ *
+ * Default: 16384
+ */
+#ifndef PJ_LOG_ASYNC_BATCH_SIZE
+#   define PJ_LOG_ASYNC_BATCH_SIZE  16384
+#endif
+
 /**
  * Colorfull terminal (for logging etc).
  *
@@ -605,6 +626,27 @@
 #  define PJ_TIMER_USE_LINKED_LIST    0
 #endif
 
+/**
+ * The default timer heap implementation used by pj_timer_heap_create(),
+ * see #pj_timer_heap_type for the possible values.
+ *
+ * Default: PJ_TIMER_HEAP_TYPE_HEAP
+ */
+#ifndef PJ_TIMER_HEAP_DEFAULT_TYPE
+#  define PJ_TIMER_HEAP_DEFAULT_TYPE    PJ_TIMER_HEAP_TYPE_HEAP
+#endif
+
+
+/**
+ * The default tick granularity of the timing wheel timer heap, in
+ * milliseconds.
+ *
+ * Default: 10
+ */
+#ifndef PJ_TIMER_WHEEL_RESOLUTION
+#  define PJ_TIMER_WHEEL_RESOLUTION     10
+#endif
+
 /**
  * Set this to 1 to enable debugging on the group lock. Default: 0
  */
@@ -635,6 +677,178 @@
 #       define PJ_OS_HAS_CHECK_STACK            0
 #endif
 
+/**
+ * Implement pj_atomic_t with the compiler's lock-free __atomic builtins
+ * instead of protecting the value with a mutex. This is currently used
+ * by the pthread based OS implementation; Windows always uses the
+ * Interlocked API. It also enables lock-free readers in #pj_seqlock_t.
+ *
+ * Default: 1 if the compiler provides __atomic builtins (GCC 4.7 or
+ * later, clang), otherwise 0.
+ */
+#ifndef PJ_ATOMIC_USE_INTRINSICS
+#   if defined(__ATOMIC_SEQ_CST)
+#       define PJ_ATOMIC_USE_INTRINSICS     1
+#   else
+#       define PJ_ATOMIC_USE_INTRINSICS     0
+#   endif
+#endif
+
+/**
+ * Number of free pools of each size that a per-thread cache of the
+ * caching pool may hold. With per-thread caches, pj_pool_create() and
+ * pj_pool_release() only take the caching pool's global lock when a
+ * thread's cache runs empty or overflows, in which case about half of
+ * this number of pools is moved from/to the shared free list. There is
+ * no other rebalancing between the caches. Set to non-zero (e.g. 8) to
+ * enable per-thread caches. This requires thread support and
+ * #PJ_ATOMIC_USE_INTRINSICS.
+ *
+ * Per-thread caches only pay off when many threads create and release
+ * pools at the same time on a multi-core host. Otherwise the single lock
+ * is faster.
+ *
+ * Default: 0 (disabled)
+ */
+#ifndef PJ_CACHING_POOL_TLS_CACHE_SIZE
+#   define PJ_CACHING_POOL_TLS_CACHE_SIZE       0
+#endif
+
+/**
+ * Number of per-thread caches created by each caching pool. Threads are
+ * assigned to the caches round-robin on their first pool operation, so
+ * with more threads than this several threads share a cache.
+ *
+ * Default: 16
+ */
+#ifndef PJ_CACHING_POOL_TLS_CACHE_CNT
+#   define PJ_CACHING_POOL_TLS_CACHE_CNT    16
+#endif
+
+/**
+ * Maximum number of size classes of a slab allocator (see pj_slab_create()).
+ *
+ * Default: 8
+ */
+#ifndef PJ_SLAB_MAX_CLASS
+#   define PJ_SLAB_MAX_CLASS                8
+#endif
+
+/**
+ * Number of free objects of each size class that a per-thread cache of
+ * the slab allocator may hold. About half of this number of objects is
+ * moved from/to the slab's shared free list, under the slab lock, when
+ * a cache runs empty or overflows. Set to zero to disable per-thread
+ * caches, in which case every allocation takes the slab lock.
+ *
+ * Default: 16 if threads are enabled, otherwise 0.
+ */
+#ifndef PJ_SLAB_CACHE_SIZE
+#   if PJ_HAS_THREADS
+#       define PJ_SLAB_CACHE_SIZE           16
+#   else
+#       define PJ_SLAB_CACHE_SIZE           0
+#   endif
+#endif
+
+/**
+ * Number of per-thread caches created by each slab allocator. Threads are
+ * assigned to the caches round-robin on their first use of the slab.
+ *
+ * Default: 8
+ */
+#ifndef PJ_SLAB_CACHE_CNT
+#   define PJ_SLAB_CACHE_CNT                8
+#endif
+
+/**
+ * Enable lock contention profiling (see @ref PJ_LOCK_PROF). Mutexes
+ * (pthread implementation) and group locks then record acquisition,
+ * contention, wait and hold time statistics, at the cost of reading the
+ * timestamp on every acquisition and release.
+ *
+ * Default: 0
+ */
+#ifndef PJ_LOCK_PROFILING
+#   define PJ_LOCK_PROFILING                0
+#endif
+
+/**
+ * Maximum number of distinct lock names recorded by the lock profiler.
+ *
+ * Default: 128
+ */
+#ifndef PJ_LOCK_PROF_MAX_ENTRY
+#   define PJ_LOCK_PROF_MAX_ENTRY           128
+#endif
+
+/**
+ * Compile in the binary event tracing (see @ref PJ_TRACE). When enabled,
+ * the trace points in the library cost one test of a global flag while
+ * tracing is not started with #pj_trace_start(). When disabled, the trace
+ * points compile to nothing.
+ *
+ * Default: 1
+ */
+#ifndef PJ_HAS_TRACE
+#   define PJ_HAS_TRACE                     1
+#endif
+
+/**
+ * Maximum number of threads that can record trace events. Events from
+ * further threads are dropped.
+ *
+ * Default: 64
+ */
+#ifndef PJ_TRACE_MAX_THREADS
+#   define PJ_TRACE_MAX_THREADS             64
+#endif
+
+/**
+ * Size of a CPU cache line, in bytes. Data structures which are written
+ * by different threads, such as the producer and consumer indices of
+ * #pj_ringbuf_t, are padded to this size so that they do not share a
+ * cache line.
+ *
+ * Default: 64
+ */
+#ifndef PJ_CACHE_LINE_SIZE
+#   define PJ_CACHE_LINE_SIZE               64
+#endif
+
+/**
+ * Select the hash function used by pj_hash_calc(), pj_hash_calc_tolower()
+ * and the hash tables. When set, keys are hashed eight bytes at a time
+ * with a multiplicative mix, and the case folding of the lower case
+ * variants is done on whole words (only ASCII letters are folded). When
+ * zero, the classic byte at a time "hash * 33 + c" function is used.
+ *
+ * Note that the two functions give different hash values, so this must
+ * be set the same way for all code that stores or compares hash values
+ * calculated by pj_hash_calc().
+ *
+ * Default: 1
+ */
+#ifndef PJ_HASH_USE_WORD_HASH
+#   define PJ_HASH_USE_WORD_HASH    1
+#endif
+
+/**
+ * Use vector (SSE2, AVX2 or NEON) instructions for case-insensitive
+ * comparison (pj_stricmp() and friends) and substring search
+ * (pj_strstr(), pj_stristr()) when the target supports them. AVX2 is
+ * used only if the CPU supports it, which is checked at run time. On
+ * other targets a portable word at a time implementation is used.
+ * Letters are compared ignoring ASCII case, as in the "C" locale. With
+ * glibc on x86, the C library strncasecmp() is already vectorized and is
+ * used for the comparison instead.
+ *
+ * Default: 1
+ */
+#ifndef PJ_STRING_USE_SIMD
+#   define PJ_STRING_USE_SIMD       1
+#endif
+
 /**
  * Do we have alternate pool implementation?
  *
@@ -680,6 +894,58 @@
 #  define PJ_MAX_HOSTNAME           (254)
 #endif
 
+/**
+ * Number of threads that resolve host names for #pj_getaddrinfo_async().
+ * The threads are started on the first asynchronous query. Each thread
+ * can be blocked by the system resolver for as long as its timeout, so
+ * this is the number of names that can be resolved at the same time.
+ *
+ * Default: 2
+ */
+#ifndef PJ_GETADDRINFO_ASYNC_THREAD_CNT
+#   define PJ_GETADDRINFO_ASYNC_THREAD_CNT  2
+#endif
+
+/**
+ * Maximum number of addresses returned by #pj_getaddrinfo_async().
+ *
+ * Default: 8
+ */
+#ifndef PJ_GETADDRINFO_ASYNC_MAX_CNT
+#   define PJ_GETADDRINFO_ASYNC_MAX_CNT     8
+#endif
+
+/**
+ * Number of host names whose results are cached by
+ * #pj_getaddrinfo_async(). Set to zero to disable the cache.
+ *
+ * Default: 16
+ */
+#ifndef PJ_GETADDRINFO_CACHE_SIZE
+#   define PJ_GETADDRINFO_CACHE_SIZE        16
+#endif
+
+/**
+ * Time, in seconds, that a successful #pj_getaddrinfo_async() result is
+ * kept in the cache.
+ *
+ * Default: 60
+ */
+#ifndef PJ_GETADDRINFO_CACHE_TTL
+#   define PJ_GETADDRINFO_CACHE_TTL         60
+#endif
+
+/**
+ * Time, in seconds, that a failed #pj_getaddrinfo_async() result is kept
+ * in the cache, so that a name that can not be resolved does not keep
+ * the resolver threads busy.
+ *
+ * Default: 5
+ */
+#ifndef PJ_GETADDRINFO_CACHE_NEG_TTL
+#   define PJ_GETADDRINFO_CACHE_NEG_TTL     5
+#endif
+
 /**
  * Maximum consecutive identical error for accept() operation before
  * activesock stops calling the next ioqueue accept.
@@ -774,6 +1040,19 @@
 #endif
 
 
+/**
+ * Number of submission queue entries of the ring used by the io_uring
+ * ioqueue backend (ioqueue_uring.c). The completion queue is twice as
+ * large. Operations beyond this number are still accepted, they are
+ * just submitted in more than one batch.
+ *
+ * Default: 256
+ */
+#ifndef PJ_IOQUEUE_URING_ENTRIES
+#   define PJ_IOQUEUE_URING_ENTRIES     256
+#endif
+
+
 /**
  * Determine if FD_SETSIZE is changeable/set-able. If so, then we will
  * set it to PJ_IOQUEUE_MAX_HANDLES. Currently we detect this by checking
@@ -1129,6 +1408,29 @@
 #  define PJ_SSL_SOCK_MAX_CURVES   32
 #endif
 
+/**
+ * Maximum number of client TLS sessions kept for resumption (see
+ * \a enable_session_reuse in #pj_ssl_sock_param). There is one session
+ * per server name and address; when the cache is full, the least recently
+ * used session is dropped. Set to zero to disable client session reuse.
+ *
+ * Default: 32
+ */
+#ifndef PJ_SSL_SOCK_SESSION_CACHE_SIZE
+#  define PJ_SSL_SOCK_SESSION_CACHE_SIZE   32
+#endif
+
+/**
+ * Number of worker threads that run the TLS handshake steps of secure
+ * sockets with \a handshake_offload enabled in #pj_ssl_sock_param. The
+ * threads are shared by all sockets and started on first use.
+ *
+ * Default: 2
+ */
+#ifndef PJ_SSL_SOCK_HANDSHAKE_THREAD_CNT
+#  define PJ_SSL_SOCK_HANDSHAKE_THREAD_CNT   2
+#endif
+
 /**
  * Use OpenSSL thread locking callback. This is only applicable for OpenSSL
  * version prior to 1.1.0
@@ -1153,6 +1455,23 @@
 #endif
 
 
+/**
+ * Enable the use of recvmmsg()/sendmmsg() system calls to receive or
+ * send several datagrams with a single system call in
+ * #pj_sock_recvmmsg(). When disabled (or not supported by the platform),
+ * these functions fall back to one recvfrom()/sendto() call per datagram.
+ *
+ * Default: 1 on Linux, 0 otherwise
+ */
+#ifndef PJ_SOCK_HAS_MMSG
+#   if defined(__linux__) && !defined(__ANDROID__)
+#       define PJ_SOCK_HAS_MMSG             1
+#   else
+#       define PJ_SOCK_HAS_MMSG             0
+#   endif
+#endif
+
+
 /**
  * Maximum number of socket options in pj_sockopt_params.
  *
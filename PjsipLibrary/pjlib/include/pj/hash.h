@@ -36,6 +36,10 @@ PJ_BEGIN_DECL
  * hash functions. Having the keys of more than one item map to the same 
  * position is called a collision. In this library, we will chain the nodes
  * that have the same key in a list.
+ *
+ * Alternatively, a table created with #pj_hash_create_oa() resolves
+ * collisions with open addressing, keeping the entries in a flat array
+ * which grows as needed. Both kinds of table are used with the same API.
  */
 
 /**
@@ -64,6 +68,8 @@ typedef void *pj_hash_entry_buf[(PJ_HASH_ENTRY_BUF_SIZE+sizeof(void*)-1)/(sizeof
  *                  the key as null terminated string.
  *
  * @return          the hash value.
+ *
+ * The hash function is selected with #PJ_HASH_USE_WORD_HASH.
  */
 PJ_DECL(pj_uint32_t) pj_hash_calc(pj_uint32_t hval, 
                                   const void *key, unsigned keylen);
@@ -71,7 +77,8 @@ PJ_DECL(pj_uint32_t) pj_hash_calc(pj_uint32_t hval,
 
 /**
  * Convert the key to lowercase and calculate the hash value. The resulting
- * string is stored in \c result.
+ * string is stored in \c result. The hash value is the same as the value
+ * returned by #pj_hash_calc() for the lowercase string.
  *
  * @param hval      The initial hash value, normally zero.
  * @param result    Optional. Buffer to store the result, which must be enough
@@ -95,6 +102,37 @@ PJ_DECL(pj_uint32_t) pj_hash_calc_tolower(pj_uint32_t hval,
 PJ_DECL(pj_hash_table_t*) pj_hash_create(pj_pool_t *pool, unsigned size);
 
 
+/**
+ * Create an open addressing hash table. The entries are stored directly
+ * in an array of slots, with one byte of metadata per slot holding a few
+ * bits of the hash value, so a lookup checks a group of eight slots at
+ * once and normally touches only one or two cache lines, instead of
+ * following a linked list.
+ *
+ * The table grows (doubling its size) when it is 7/8 full. The memory for
+ * the new array is allocated from the pool given here, and the old array
+ * is only freed when the pool is released, so the pool should be one that
+ * lives as long as the table. Removing the deleted slots left by erased
+ * entries reuses one spare array, so inserting and erasing entries does
+ * not use more memory as long as the number of entries does not grow.
+ *
+ * The table is used with the same functions as tables created with
+ * #pj_hash_create(), with these differences:
+ *  - the entry buffer given to #pj_hash_set_np() and
+ *    #pj_hash_set_np_lower() is not used (the key is still not copied).
+ *  - adding an entry may move the other entries, so entries must not be
+ *    added while iterating the table. Removing entries while iterating is
+ *    allowed.
+ *
+ * @param pool  the pool from which the hash table will be allocated from.
+ * @param size  the number of entries that the table can hold before it
+ *              needs to grow.
+ *
+ * @return the hash table.
+ */
+PJ_DECL(pj_hash_table_t*) pj_hash_create_oa(pj_pool_t *pool, unsigned size);
+
+
 /**
  * Get the value associated with the specified key.
  *
@@ -25,6 +25,7 @@
  */
 
 #include <pj/types.h>
+#include <pj/sock.h>
 
 PJ_BEGIN_DECL
 
@@ -92,6 +93,10 @@ PJ_BEGIN_DECL
  *  - <tt><b>/dev/epoll</b></tt> on Linux (user mode and kernel mode),
  *    a much faster replacement for select() on Linux (and more importantly
  *    doesn't have limitation on number of descriptors).
+ *  - <tt><b>io_uring</b></tt> on Linux 6.0 or later, which submits the
+ *    socket operations themselves to the kernel and reaps their completions
+ *    in batches, saving the readiness wakeup per operation. Select it by
+ *    building with LINUX_POLL=uring.
  *  - <b>I/O Completion ports</b> on Windows NT/2000/XP, which is the most
  *    efficient way to dispatch events in Windows NT based OSes, and most
  *    importantly, it doesn't have the limit on how many handles to monitor.
@@ -930,6 +935,32 @@ PJ_DECL(pj_status_t) pj_ioqueue_sendto( pj_ioqueue_key_t *key,
                                         const pj_sockaddr_t *addr,
                                         int addrlen);
 
+/**
+ * Send several datagrams at once with #pj_sock_sendmmsg(), i.e. with a
+ * single sendmmsg() system call where supported. Unlike
+ * #pj_ioqueue_sendto(), this function never schedules an asynchronous
+ * operation: it only sends the datagrams that can be sent immediately
+ * and reports how many have been sent. The caller should send the rest
+ * with #pj_ioqueue_sendto(). Nothing is sent while the key has pending
+ * write operations, to preserve the packet order.
+ *
+ * @param key       the key that identifies the handle.
+ * @param msgs      Array of datagrams to send. The \a buf, \a size,
+ *                  \a addr, and \a addr_len fields must be set.
+ * @param count     On input, the number of datagrams in \a msgs. On
+ *                  return, the number of datagrams that have been sent.
+ * @param flags     send flags. PJ_IOQUEUE_ALWAYS_ASYNC is ignored.
+ *
+ * @return
+ *  - PJ_SUCCESS    If at least one datagram has been sent.
+ *  - PJ_EBUSY      If there is pending write operation on the key.
+ *  - non-zero      The return value indicates the error code.
+ */
+PJ_DECL(pj_status_t) pj_ioqueue_sendto_batch( pj_ioqueue_key_t *key,
+                                              pj_sock_mmsg msgs[],
+                                              unsigned *count,
+                                              pj_uint32_t flags);
+
 
 /**
  * Get the underlying OS handle associated with an ioqueue instance.
@@ -937,8 +968,8 @@ PJ_DECL(pj_status_t) pj_ioqueue_sendto( pj_ioqueue_key_t *key,
  * @param ioqueue        The ioqueue instance.
  *
  * @return          The OS handle associated with the instance.
- *                  For epoll/kqueue this will be a pointer to the file
- *                  descriptor. For all other platforms, this will be a pointer
+ *                  For epoll/kqueue/io_uring this will be a pointer to
+ *                  the file descriptor (of the ring for io_uring). For all other platforms, this will be a pointer
  *                  to a platform-specific handle.
  *                  If no handle is available, NULL will be returned.
  */
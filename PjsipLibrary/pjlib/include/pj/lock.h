@@ -448,6 +448,236 @@ PJ_DECL(pj_status_t) pj_grp_lock_unchain_lock(pj_grp_lock_t *grp_lock,
 /** @} */
 
 
+/**
+ * @defgroup PJ_SEQLOCK Sequence Lock
+ * @ingroup PJ_LOCK
+ * @{
+ *
+ * Sequence lock protects a small, read-mostly record (for example a few
+ * counters or an address) without making the readers take any lock.
+ * Writers are serialized with a mutex and bump a sequence counter before
+ * and after modifying the record. Readers copy the record and retry when
+ * the counter shows that a writer was active in the meantime:
+ *
+ * \code
+    unsigned seq;
+    do {
+        seq = pj_seqlock_read_begin(lock);
+        copy = shared_record;
+    } while (pj_seqlock_read_retry(lock, seq));
+ * \endcode
+ *
+ * Because a reader may observe a record that is being modified, the read
+ * section must only copy plain data and must not follow pointers read
+ * from the record or have any side effects.
+ *
+ * When the compiler does not provide the __atomic builtins (see
+ * #PJ_ATOMIC_USE_INTRINSICS), readers fall back to taking the writer
+ * mutex, so the usage above stays correct.
+ */
+
+/**
+ * Create a sequence lock.
+ *
+ * @param pool          The pool.
+ * @param name          Optional name.
+ * @param p_lock        Pointer to receive the sequence lock.
+ *
+ * @return              PJ_SUCCESS or the appropriate error code.
+ */
+PJ_DECL(pj_status_t) pj_seqlock_create(pj_pool_t *pool,
+                                       const char *name,
+                                       pj_seqlock_t **p_lock);
+
+/**
+ * Destroy the sequence lock.
+ *
+ * @param lock          The sequence lock.
+ *
+ * @return              PJ_SUCCESS or the appropriate error code.
+ */
+PJ_DECL(pj_status_t) pj_seqlock_destroy(pj_seqlock_t *lock);
+
+/**
+ * Start a read section. This waits until no writer is active and
+ * returns the sequence number to be passed to #pj_seqlock_read_retry().
+ *
+ * @param lock          The sequence lock.
+ *
+ * @return              The sequence number.
+ */
+PJ_DECL(unsigned) pj_seqlock_read_begin(pj_seqlock_t *lock);
+
+/**
+ * End a read section started with #pj_seqlock_read_begin().
+ *
+ * @param lock          The sequence lock.
+ * @param seq           The sequence number returned by
+ *                      #pj_seqlock_read_begin().
+ *
+ * @return              PJ_TRUE if a writer modified the record during the
+ *                      read section, in which case the data that was read
+ *                      must be discarded and the read repeated.
+ */
+PJ_DECL(pj_bool_t) pj_seqlock_read_retry(pj_seqlock_t *lock, unsigned seq);
+
+/**
+ * Start modifying the record protected by the sequence lock.
+ *
+ * @param lock          The sequence lock.
+ *
+ * @return              PJ_SUCCESS or the appropriate error code.
+ */
+PJ_DECL(pj_status_t) pj_seqlock_write_lock(pj_seqlock_t *lock);
+
+/**
+ * Finish modifying the record protected by the sequence lock.
+ *
+ * @param lock          The sequence lock.
+ *
+ * @return              PJ_SUCCESS or the appropriate error code.
+ */
+PJ_DECL(pj_status_t) pj_seqlock_write_unlock(pj_seqlock_t *lock);
+
+
+/** @} */
+
+
+/**
+ * @defgroup PJ_LOCK_PROF Lock Contention Profiling
+ * @ingroup PJ_LOCK
+ * @{
+ *
+ * When #PJ_LOCK_PROFILING is enabled, every mutex created with
+ * #pj_mutex_create() (pthread implementation) and every group lock
+ * records how often it is acquired, how often an acquisition had to wait
+ * for another thread, the total and maximum waiting time, and the total,
+ * maximum and distribution of the time the lock is held.
+ *
+ * Statistics are kept per lock name rather than per lock instance: the
+ * name template (e.g. "tsx%p"), or the name with its trailing pointer
+ * value removed (e.g. "tsx0x7f2c10" becomes "tsx"), is used as the key,
+ * so all locks of the same kind are counted together. Group locks are
+ * recorded with a "grp:" prefix and the name of the pool given to
+ * #pj_grp_lock_create(). The counters are updated without locking and
+ * may be slightly off when read while the locks are in use.
+ */
+
+/**
+ * Number of buckets of the hold time histogram. Bucket 0 counts holds
+ * shorter than 1 usec, bucket n (0 < n < PJ_LOCK_PROF_HIST_CNT-1) counts
+ * holds from 4^(n-1) up to 4^n usec, and the last bucket counts longer
+ * holds.
+ */
+#define PJ_LOCK_PROF_HIST_CNT   10
+
+/**
+ * Profiling statistics of one lock name.
+ */
+typedef struct pj_lock_prof_stat
+{
+    char        name[PJ_MAX_OBJ_NAME];  /**< Lock name (key).           */
+    pj_uint32_t acq_cnt;                /**< Number of acquisitions.    */
+    pj_uint32_t contended_cnt;          /**< Acquisitions that waited.  */
+    pj_uint64_t wait_total_nsec;        /**< Total waiting time.        */
+    pj_uint64_t wait_max_nsec;          /**< Longest wait.              */
+    pj_uint64_t hold_total_nsec;        /**< Total holding time.        */
+    pj_uint64_t hold_max_nsec;          /**< Longest hold.              */
+    pj_uint32_t hold_hist[PJ_LOCK_PROF_HIST_CNT]; /**< Hold time
+                                                       histogram.       */
+} pj_lock_prof_stat;
+
+/**
+ * Opaque profiling record of one lock name.
+ */
+typedef struct pj_lock_prof_entry pj_lock_prof_entry;
+
+/**
+ * Get the profiling record for the specified lock name, creating it if
+ * needed. This is used by the lock implementations, and may be used to
+ * profile other synchronization objects. When the table is full (see
+ * #PJ_LOCK_PROF_MAX_ENTRY), the record named "(other)" is returned.
+ *
+ * @param name          The lock name or name template.
+ *
+ * @return              The profiling record.
+ */
+PJ_DECL(pj_lock_prof_entry*) pj_lock_prof_register(const char *name);
+
+/**
+ * Record an acquisition. This must be called right after the lock is
+ * acquired, and only for the outermost acquisition of a recursive lock.
+ *
+ * @param entry         The profiling record.
+ * @param wait_start    The time the thread started waiting for the lock,
+ *                      or NULL if the lock was acquired without waiting.
+ * @param acq_time      Receives the acquisition time, to be passed to
+ *                      #pj_lock_prof_on_release().
+ */
+PJ_DECL(void) pj_lock_prof_on_acquire(pj_lock_prof_entry *entry,
+                                      const pj_timestamp *wait_start,
+                                      pj_timestamp *acq_time);
+
+/**
+ * Record a release. This must be called right before the lock is
+ * released, and only for the outermost release of a recursive lock.
+ *
+ * @param entry         The profiling record.
+ * @param acq_time      The acquisition time.
+ */
+PJ_DECL(void) pj_lock_prof_on_release(pj_lock_prof_entry *entry,
+                                      const pj_timestamp *acq_time);
+
+/**
+ * Get the profiling statistics.
+ *
+ * @param stat          Array to receive the statistics.
+ * @param count         On input, the number of elements in the array. On
+ *                      output, the number of elements filled.
+ *
+ * @return              PJ_SUCCESS, or PJ_ETOOSMALL if there are more
+ *                      records than elements in the array (the array is
+ *                      still filled).
+ */
+PJ_DECL(pj_status_t) pj_lock_prof_get_stat(pj_lock_prof_stat stat[],
+                                           unsigned *count);
+
+/**
+ * Clear the statistics of all records.
+ */
+PJ_DECL(void) pj_lock_prof_reset(void);
+
+/**
+ * Dump the profiling statistics to the log, with level 3.
+ *
+ * @param detail        Also dump the hold time histograms.
+ */
+PJ_DECL(void) pj_lock_prof_dump(pj_bool_t detail);
+
+/**
+ * Export the profiling statistics as a JSON document, for example to be
+ * charted or compared between releases. The document has this layout:
+ *
+ * \verbatim
+   {"hist_bound_usec":[1,4,...],
+    "locks":[{"name":"tsx%p","acq":100,"contended":2,
+              "wait_total_ns":1500,"wait_max_ns":1000,
+              "hold_total_ns":90000,"hold_max_ns":4000,
+              "hold_hist":[20,70,...]}, ...]}
+   \endverbatim
+ *
+ * @param buf           Buffer to receive the NULL terminated document.
+ * @param size          Size of the buffer.
+ *
+ * @return              The length of the document, or -1 if the buffer
+ *                      is too small.
+ */
+PJ_DECL(pj_ssize_t) pj_lock_prof_export(char *buf, pj_size_t size);
+
+
+/** @} */
+
+
 PJ_END_DECL
 
 
@@ -131,6 +131,43 @@ typedef void pj_log_func(int level, const char *data, int len);
  */
 PJ_DECL(void) pj_log_write(int level, const char *buffer, int len);
 
+/**
+ * Settings of the asynchronous logging, see #pj_log_async_start().
+ */
+typedef struct pj_log_async_param
+{
+    /**
+     * Size of the message queue, in bytes. Messages that are logged while
+     * the queue is full are dropped.
+     *
+     * Default: #PJ_LOG_ASYNC_BUF_SIZE
+     */
+    unsigned    buf_size;
+
+    /**
+     * Maximum number of bytes passed to the log writer function in one
+     * call. Consecutive messages of the same level are joined up to this
+     * size, so the writer may receive several lines at once. Set to zero
+     * to call the writer once for every message.
+     *
+     * Default: #PJ_LOG_ASYNC_BATCH_SIZE
+     */
+    unsigned    batch_size;
+
+} pj_log_async_param;
+
+/**
+ * Statistics of the asynchronous logging.
+ */
+typedef struct pj_log_async_stat
+{
+    pj_uint32_t queued;     /**< Messages put in the queue.             */
+    pj_uint32_t written;    /**< Messages passed to the log writer.     */
+    pj_uint32_t dropped;    /**< Messages dropped, queue was full.      */
+    pj_uint32_t write_cnt;  /**< Number of calls to the log writer.     */
+    pj_uint32_t max_used;   /**< Highest queue usage, in bytes.         */
+} pj_log_async_stat;
+
 
 #if PJ_LOG_MAX_LEVEL >= 1
 
@@ -255,6 +292,67 @@ PJ_DECL(void) pj_log_set_color(int level, pj_color_t color);
  */
 PJ_DECL(pj_color_t) pj_log_get_color(int level);
 
+/**
+ * Initialize the asynchronous logging settings with the default values.
+ *
+ * @param prm       The settings to be initialized.
+ */
+PJ_DECL(void) pj_log_async_param_default(pj_log_async_param *prm);
+
+/**
+ * Start the asynchronous logging. The messages are still formatted by the
+ * thread that logs them, but instead of calling the log writer function
+ * (see #pj_log_set_log_func()), the thread copies the message into a
+ * bounded lock-free queue and returns. A dedicated thread takes the
+ * messages from the queue and passes them to the log writer in batches,
+ * so threads that log are not stalled by slow output devices.
+ *
+ * Messages logged while the queue is full are dropped and counted, and
+ * the number of dropped messages is written to the log when there is room
+ * again. The queue is flushed by #pj_log_async_stop(), which is also
+ * called when PJLIB is shut down.
+ *
+ * The pool factory must remain valid until the asynchronous logging is
+ * stopped, so application that destroys the pool factory before calling
+ * #pj_shutdown() must call #pj_log_async_stop() first. PJSUA does this
+ * in pjsua_destroy().
+ *
+ * This requires PJ_HAS_THREADS.
+ *
+ * @param pf        Pool factory to allocate the queue. It must outlive
+ *                  the asynchronous logging.
+ * @param prm       The settings, or NULL to use the default settings.
+ *
+ * @return          PJ_SUCCESS on success, or the appropriate error code.
+ */
+PJ_DECL(pj_status_t) pj_log_async_start(pj_pool_factory *pf,
+                                        const pj_log_async_param *prm);
+
+/**
+ * Write all the queued messages and stop the asynchronous logging. The
+ * messages are written by the calling thread afterwards.
+ *
+ * @return          PJ_SUCCESS on success, or the appropriate error code.
+ */
+PJ_DECL(pj_status_t) pj_log_async_stop(void);
+
+/**
+ * Wait until the messages that were queued before this call are passed to
+ * the log writer. It returns immediately when the asynchronous logging is
+ * not running or when it is called by the log writer.
+ */
+PJ_DECL(void) pj_log_async_flush(void);
+
+/**
+ * Get the statistics of the asynchronous logging. The statistics are
+ * reset by #pj_log_async_start().
+ *
+ * @param stat      Pointer to receive the statistics.
+ *
+ * @return          PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pj_log_async_get_stat(pj_log_async_stat *stat);
+
 /**
  * Internal function to be called by pj_init()
  */
@@ -376,6 +474,31 @@ pj_status_t pj_log_init(void);
  */
 #   define pj_log_init()        PJ_SUCCESS
 
+/**
+ * Initialize the asynchronous logging settings.
+ */
+#   define pj_log_async_param_default(prm)
+
+/**
+ * Start the asynchronous logging.
+ */
+#   define pj_log_async_start(pf, prm)     PJ_SUCCESS
+
+/**
+ * Stop the asynchronous logging.
+ */
+#   define pj_log_async_stop()             PJ_SUCCESS
+
+/**
+ * Flush the asynchronous logging.
+ */
+#   define pj_log_async_flush()
+
+/**
+ * Get the statistics of the asynchronous logging.
+ */
+#   define pj_log_async_get_stat(stat)     PJ_SUCCESS
+
 #endif  /* #if PJ_LOG_MAX_LEVEL >= 1 */
 
 /** 
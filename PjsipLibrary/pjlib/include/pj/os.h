@@ -273,6 +273,29 @@ PJ_DECL(int) pj_thread_get_prio_min(pj_thread_t *thread);
 PJ_DECL(int) pj_thread_get_prio_max(pj_thread_t *thread);
 
 
+/**
+ * Restrict the thread to run only on the specified CPU core. This is
+ * currently supported on Linux (except Android) and Windows.
+ *
+ * @param thread        Thread handle.
+ * @param cpu           Zero based index of the CPU core.
+ *
+ * @return              PJ_SUCCESS on success, PJ_ENOTSUP if the platform
+ *                      does not support it, or the error code.
+ */
+PJ_DECL(pj_status_t) pj_thread_set_affinity(pj_thread_t *thread,
+                                            unsigned cpu);
+
+/**
+ * Get the number of CPU cores that are currently online, e.g. to wrap
+ * the core index given to #pj_thread_set_affinity().
+ *
+ * @return              The number of CPU cores, or 1 if it can't be
+ *                      determined.
+ */
+PJ_DECL(unsigned) pj_get_cpu_count(void);
+
+
 /**
  * Return native handle from pj_thread_t for manipulation using native
  * OS APIs.
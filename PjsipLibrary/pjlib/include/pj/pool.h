@@ -881,6 +881,32 @@ struct pj_caching_pool
      * Mutex.
      */
     pj_lock_t      *lock;
+
+    /**
+     * Per-thread caches, or NULL if they are disabled. See
+     * #PJ_CACHING_POOL_TLS_CACHE_SIZE.
+     */
+    struct pj_cpool_tls_cache *tls_cache;
+
+    /**
+     * Number of per-thread caches.
+     */
+    unsigned        tls_cache_cnt;
+
+    /**
+     * Index of the per-thread cache to be assigned to the next thread.
+     */
+    unsigned        tls_cache_next;
+
+    /**
+     * Thread local storage index holding the thread's cache.
+     */
+    long            tls_id;
+
+    /**
+     * Pool for the per-thread caches.
+     */
+    pj_pool_t      *tls_pool;
 };
 
 
@@ -0,0 +1,156 @@
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef __PJ_RINGBUF_H__
+#define __PJ_RINGBUF_H__
+
+/**
+ * @file ringbuf.h
+ * @brief Single producer single consumer ring buffer.
+ */
+#include <pj/types.h>
+
+PJ_BEGIN_DECL
+
+/**
+ * @defgroup PJ_RINGBUF Single Producer Single Consumer Ring Buffer
+ * @ingroup PJ_DS
+ * @{
+ * The ring buffer passes fixed-size elements from exactly one producer
+ * thread to exactly one consumer thread without locking, which makes it
+ * suitable for handing data to or from threads that must not block, such
+ * as the audio device callbacks.
+ *
+ * The capacity is rounded up to a power of two so the read and write
+ * positions are free running counters that are simply masked to find the
+ * slot. The producer and consumer positions live on separate cache lines
+ * (see #PJ_CACHE_LINE_SIZE), and each side keeps a cached copy of the
+ * other side's position so that it only reads the shared one when the
+ * cached value says the buffer is full (or empty). Reads and writes of
+ * several elements are done with at most two memory copies and one
+ * position update.
+ *
+ * Only #pj_ringbuf_write() and #pj_ringbuf_write_avail() may be called by
+ * the producer, and only #pj_ringbuf_read(), #pj_ringbuf_skip() and
+ * #pj_ringbuf_read_avail() may be called by the consumer. When the
+ * compiler does not provide atomic builtins (see
+ * #PJ_ATOMIC_USE_INTRINSICS), the positions are protected with a mutex
+ * instead.
+ */
+
+/**
+ * Create a ring buffer.
+ *
+ * @param pool          Pool to allocate the ring buffer and its storage.
+ * @param elem_size     Size of each element, in bytes.
+ * @param capacity      Minimum number of elements the buffer can hold. It
+ *                      is rounded up to the next power of two.
+ * @param p_rb          Pointer to receive the ring buffer.
+ *
+ * @return              PJ_SUCCESS on success, or the appropriate error code.
+ */
+PJ_DECL(pj_status_t) pj_ringbuf_create(pj_pool_t *pool,
+                                       unsigned elem_size,
+                                       unsigned capacity,
+                                       pj_ringbuf_t **p_rb);
+
+/**
+ * Destroy the ring buffer. The memory is released with the pool.
+ *
+ * @param rb            The ring buffer.
+ *
+ * @return              PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pj_ringbuf_destroy(pj_ringbuf_t *rb);
+
+/**
+ * Get the number of elements the ring buffer can hold.
+ *
+ * @param rb            The ring buffer.
+ *
+ * @return              The capacity, in elements.
+ */
+PJ_DECL(unsigned) pj_ringbuf_get_capacity(const pj_ringbuf_t *rb);
+
+/**
+ * Get the number of elements that can currently be written. Must only be
+ * called by the producer.
+ *
+ * @param rb            The ring buffer.
+ *
+ * @return              Number of free slots.
+ */
+PJ_DECL(unsigned) pj_ringbuf_write_avail(pj_ringbuf_t *rb);
+
+/**
+ * Get the number of elements that can currently be read. Must only be
+ * called by the consumer.
+ *
+ * @param rb            The ring buffer.
+ *
+ * @return              Number of elements in the buffer.
+ */
+PJ_DECL(unsigned) pj_ringbuf_read_avail(pj_ringbuf_t *rb);
+
+/**
+ * Append elements to the ring buffer. If there is not enough room for
+ * all of them, only the elements that fit are written. Must only be
+ * called by the producer.
+ *
+ * @param rb            The ring buffer.
+ * @param elems         The elements to write.
+ * @param count         Number of elements to write.
+ *
+ * @return              Number of elements written.
+ */
+PJ_DECL(unsigned) pj_ringbuf_write(pj_ringbuf_t *rb,
+                                   const void *elems,
+                                   unsigned count);
+
+/**
+ * Take the oldest elements out of the ring buffer. Must only be called
+ * by the consumer.
+ *
+ * @param rb            The ring buffer.
+ * @param elems         Buffer to receive the elements.
+ * @param count         Maximum number of elements to read.
+ *
+ * @return              Number of elements read.
+ */
+PJ_DECL(unsigned) pj_ringbuf_read(pj_ringbuf_t *rb,
+                                  void *elems,
+                                  unsigned count);
+
+/**
+ * Discard the oldest elements of the ring buffer. Must only be called by
+ * the consumer.
+ *
+ * @param rb            The ring buffer.
+ * @param count         Maximum number of elements to discard.
+ *
+ * @return              Number of elements discarded.
+ */
+PJ_DECL(unsigned) pj_ringbuf_skip(pj_ringbuf_t *rb, unsigned count);
+
+/**
+ * @}
+ */
+
+PJ_END_DECL
+
+#endif  /* __PJ_RINGBUF_H__ */
@@ -0,0 +1,192 @@
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef __PJ_SLAB_H__
+#define __PJ_SLAB_H__
+
+/**
+ * @file slab.h
+ * @brief Fixed-size object (slab) allocator.
+ */
+#include <pj/pool.h>
+
+PJ_BEGIN_DECL
+
+/**
+ * @defgroup PJ_SLAB Fixed-Size Object (Slab) Allocator
+ * @ingroup PJ_POOL_GROUP
+ * @brief Allocator for objects of a few fixed sizes.
+ *
+ * The slab allocator hands out objects from a small number of size
+ * classes. Objects of each class are carved out of larger chunks taken
+ * from a pool, and freed objects are kept on per-class free lists to be
+ * reused by the next allocation of the same class, so that frequently
+ * created and destroyed objects do not go through the system allocator.
+ * Memory taken by the chunks is only returned when the slab is destroyed.
+ *
+ * When threads are enabled, each thread is assigned one of
+ * #PJ_SLAB_CACHE_CNT caches, each keeping up to #PJ_SLAB_CACHE_SIZE free
+ * objects per class, so that most allocations and releases only contend
+ * with the few threads sharing the same cache. Objects may be freed by a
+ * different thread than the one that allocated them.
+ *
+ * The slab can also be used as the memory backend of a pool factory
+ * (see #pj_slab_pool_factory), so that pools of a known size can be
+ * created and destroyed cheaply while still allowing them to grow beyond
+ * the slab object size.
+ *
+ * @{
+ */
+
+/**
+ * Statistics of one slab size class.
+ */
+typedef struct pj_slab_class_stat
+{
+    pj_size_t       obj_size;       /**< Object size of this class.     */
+    unsigned        chunk_cnt;      /**< Number of chunks allocated.    */
+    unsigned        obj_cnt;        /**< Total objects in the chunks.   */
+    unsigned        used_cnt;       /**< Objects currently allocated.   */
+    pj_uint32_t     alloc_cnt;      /**< Total number of allocations.   */
+} pj_slab_class_stat;
+
+/**
+ * Slab allocator statistics.
+ */
+typedef struct pj_slab_stat
+{
+    unsigned            class_cnt;  /**< Number of size classes.        */
+    pj_slab_class_stat  cls[PJ_SLAB_MAX_CLASS]; /**< Per class stat.    */
+    pj_uint32_t         oversize_cnt; /**< Allocations rejected because
+                                           they are larger than the
+                                           largest class.               */
+} pj_slab_stat;
+
+/**
+ * Create a slab allocator.
+ *
+ * @param pf            Pool factory to allocate the chunks from.
+ * @param name          Name for the slab, used for logging. It may
+ *                      contain "%p" to be replaced with the slab pointer.
+ * @param class_cnt     Number of size classes, up to #PJ_SLAB_MAX_CLASS.
+ * @param obj_size      Array of object sizes of each class. The sizes
+ *                      will be sorted and rounded up to the alignment
+ *                      of the pool.
+ * @param objs_per_chunk Number of objects to allocate at once when a
+ *                      class runs out of free objects.
+ * @param p_slab        Pointer to receive the slab.
+ *
+ * @return              PJ_SUCCESS on success, or the appropriate error.
+ */
+PJ_DECL(pj_status_t) pj_slab_create(pj_pool_factory *pf,
+                                    const char *name,
+                                    unsigned class_cnt,
+                                    const pj_size_t obj_size[],
+                                    unsigned objs_per_chunk,
+                                    pj_slab_t **p_slab);
+
+/**
+ * Allocate an object from the smallest size class that can hold the
+ * requested size. The memory is not initialized.
+ *
+ * @param slab          The slab.
+ * @param size          Requested size.
+ *
+ * @return              The object, or NULL if the size is larger than
+ *                      the largest size class or memory is exhausted.
+ */
+PJ_DECL(void*) pj_slab_alloc(pj_slab_t *slab, pj_size_t size);
+
+/**
+ * Return an object to the slab.
+ *
+ * @param slab          The slab.
+ * @param obj           Object previously returned by pj_slab_alloc().
+ * @param size          The size that was given to pj_slab_alloc().
+ */
+PJ_DECL(void) pj_slab_free(pj_slab_t *slab, void *obj, pj_size_t size);
+
+/**
+ * Get the statistics of the slab.
+ *
+ * @param slab          The slab.
+ * @param stat          Structure to receive the statistics.
+ *
+ * @return              PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pj_slab_get_stat(pj_slab_t *slab, pj_slab_stat *stat);
+
+/**
+ * Dump the slab statistics to log.
+ *
+ * @param slab          The slab.
+ */
+PJ_DECL(void) pj_slab_dump(pj_slab_t *slab);
+
+/**
+ * Destroy the slab and release all memory used by it. All objects
+ * allocated from the slab become invalid.
+ *
+ * @param slab          The slab.
+ *
+ * @return              PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pj_slab_destroy(pj_slab_t *slab);
+
+
+/**
+ * Pool factory which allocates the memory blocks of its pools from a
+ * slab. Blocks which are larger than the largest size class of the slab
+ * are allocated with the policy of the parent factory instead, so pools
+ * created by this factory may grow like any other pool. Pools are
+ * destroyed (and their blocks returned to the slab) when released.
+ */
+typedef struct pj_slab_pool_factory
+{
+    /** The pool factory interface. Must be the first member. */
+    pj_pool_factory      factory;
+
+    /** The slab to allocate memory blocks from. */
+    pj_slab_t           *slab;
+
+    /** Factory whose policy is used for blocks that do not fit the slab. */
+    pj_pool_factory     *parent;
+
+} pj_slab_pool_factory;
+
+/**
+ * Initialize a slab pool factory.
+ *
+ * @param spf           The slab pool factory to initialize.
+ * @param slab          The slab to allocate memory blocks from.
+ * @param parent        Parent factory. Its policy is used to allocate
+ *                      blocks that do not fit in the slab and its
+ *                      callback is used when pools are created without
+ *                      a callback.
+ */
+PJ_DECL(void) pj_slab_pool_factory_init(pj_slab_pool_factory *spf,
+                                        pj_slab_t *slab,
+                                        pj_pool_factory *parent);
+
+/**
+ * @}
+ */
+
+PJ_END_DECL
+
+#endif  /* __PJ_SLAB_H__ */
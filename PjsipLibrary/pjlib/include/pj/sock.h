@@ -317,6 +317,12 @@ extern const pj_uint16_t PJ_TCP_NODELAY;
  *  @see pj_SO_REUSEADDR */
 extern const pj_uint16_t PJ_SO_REUSEADDR;
 
+/** Allows multiple sockets to be bound to the same address and have the
+ *  incoming traffic load balanced among them. The value will be 0xFFFF
+ *  if the option is not supported by the platform.
+ *  @see pj_SO_REUSEPORT */
+extern const pj_uint16_t PJ_SO_REUSEPORT;
+
 /** Do not generate SIGPIPE. @see pj_SO_NOSIGPIPE */
 extern const pj_uint16_t PJ_SO_NOSIGPIPE;
 
@@ -356,6 +362,9 @@ extern const pj_uint16_t PJ_IP_DROP_MEMBERSHIP;
     /** Get #PJ_SO_REUSEADDR constant */
     PJ_DECL(pj_uint16_t) pj_SO_REUSEADDR(void);
 
+    /** Get #PJ_SO_REUSEPORT constant */
+    PJ_DECL(pj_uint16_t) pj_SO_REUSEPORT(void);
+
     /** Get #PJ_SO_NOSIGPIPE constant */
     PJ_DECL(pj_uint16_t) pj_SO_NOSIGPIPE(void);
 
@@ -392,6 +401,9 @@ extern const pj_uint16_t PJ_IP_DROP_MEMBERSHIP;
     /** Get #PJ_SO_REUSEADDR constant */
 #   define pj_SO_REUSEADDR() PJ_SO_REUSEADDR
 
+    /** Get #PJ_SO_REUSEPORT constant */
+#   define pj_SO_REUSEPORT() PJ_SO_REUSEPORT
+
     /** Get #PJ_SO_NOSIGPIPE constant */
 #   define pj_SO_NOSIGPIPE() PJ_SO_NOSIGPIPE
 
@@ -1493,6 +1505,78 @@ PJ_DECL(pj_status_t) pj_sock_sendto(pj_sock_t sockfd,
                                     const pj_sockaddr_t *to,
                                     int tolen);
 
+/**
+ * Describes one datagram in #pj_sock_recvmmsg() and #pj_sock_sendmmsg().
+ */
+typedef struct pj_sock_mmsg
+{
+    /** Packet buffer. */
+    void           *buf;
+
+    /** Size of the buffer (receive), or length of the packet (send). */
+    pj_size_t       size;
+
+    /** On return, the length of the datagram received or sent. */
+    pj_ssize_t      len;
+
+    /** Source address (receive), or destination address (send). */
+    pj_sockaddr     addr;
+
+    /** Length of the address. Filled upon return for receive, must be
+     *  set by caller for send. */
+    int             addr_len;
+
+} pj_sock_mmsg;
+
+/**
+ * Receive several datagrams from a datagram socket at once. When
+ * PJ_SOCK_HAS_MMSG is enabled this uses a single recvmmsg() system call
+ * for a batch of datagrams, otherwise only one datagram is received with
+ * #pj_sock_recvfrom(). The function does not block after the first
+ * datagram has been received, so it is suitable to drain a non-blocking
+ * socket after a read readiness event.
+ *
+ * @param sockfd        The socket descriptor.
+ * @param msgs          Array of datagram descriptors. The \a buf and
+ *                      \a size fields must be set by the caller, the
+ *                      other fields will be filled upon return.
+ * @param count         On input, the number of elements in \a msgs.
+ *                      Upon return, the number of datagrams received.
+ * @param flags         Flags (such as pj_MSG_PEEK()).
+ *
+ * @return              PJ_SUCCESS if at least one datagram has been
+ *                      received, or the error code of the first
+ *                      receive operation.
+ */
+PJ_DECL(pj_status_t) pj_sock_recvmmsg(pj_sock_t sockfd,
+                                      pj_sock_mmsg msgs[],
+                                      unsigned *count,
+                                      unsigned flags);
+
+/**
+ * Send several datagrams, possibly to different destinations, at once.
+ * When PJ_SOCK_HAS_MMSG is enabled this uses a single sendmmsg() system
+ * call for a batch of datagrams, otherwise #pj_sock_sendto() is called
+ * for each datagram. Sending stops at the first datagram that could not
+ * be sent (for example because the socket buffer is full).
+ *
+ * @param sockfd        The socket descriptor.
+ * @param msgs          Array of datagrams. The \a buf, \a size, \a addr,
+ *                      and \a addr_len fields must be set by the caller,
+ *                      \a len will be filled upon return.
+ * @param count         On input, the number of elements in \a msgs.
+ *                      Upon return, the number of datagrams sent.
+ * @param flags         Flags (such as pj_MSG_DONTROUTE()).
+ *
+ * @return              PJ_SUCCESS if at least one datagram has been
+ *                      sent, or the error code of the first send
+ *                      operation.
+ */
+PJ_DECL(pj_status_t) pj_sock_sendmmsg(pj_sock_t sockfd,
+                                      pj_sock_mmsg msgs[],
+                                      unsigned *count,
+                                      unsigned flags);
+
 #if PJ_HAS_TCP
 /**
  * The shutdown call causes all or part of a full-duplex connection on the
@@ -901,9 +901,54 @@ typedef struct pj_ssl_sock_info
      */
     void *native_ssl;
 
+    /**
+     * Specify whether the handshake resumed an earlier TLS session instead
+     * of doing a full handshake. Currently only set by OpenSSL backend.
+     */
+    pj_bool_t session_reused;
+
+    /**
+     * Duration of the handshake, in milliseconds.
+     */
+    unsigned handshake_msec;
+
 } pj_ssl_sock_info;
 
 
+/**
+ * Handshake statistics of all secure sockets, see
+ * #pj_ssl_sock_get_handshake_stat().
+ */
+typedef struct pj_ssl_sock_handshake_stat
+{
+    /**
+     * Number of successful full handshakes.
+     */
+    unsigned full_cnt;
+
+    /**
+     * Number of successful handshakes that resumed an earlier session.
+     */
+    unsigned resumed_cnt;
+
+    /**
+     * Number of failed handshakes.
+     */
+    unsigned failed_cnt;
+
+    /**
+     * Average and maximum duration of full handshakes, in milliseconds.
+     */
+    unsigned full_avg_msec, full_max_msec;
+
+    /**
+     * Average and maximum duration of resumed handshakes, in milliseconds.
+     */
+    unsigned resumed_avg_msec, resumed_max_msec;
+
+} pj_ssl_sock_handshake_stat;
+
+
 /**
  * Definition of secure socket creation parameters.
  */
@@ -1189,6 +1234,54 @@ typedef struct pj_ssl_sock_param
      */
     pj_bool_t enable_renegotiation;
 
+    /**
+     * Client only: specify if the socket should try to resume a session of
+     * an earlier connection to the same server name and address, to avoid
+     * a full handshake. Depending on the server and the protocol version,
+     * the session is resumed with session ID, session ticket, or TLSv1.3
+     * PSK. Sessions are only kept when the server certificate was verified
+     * successfully, in a process wide cache of
+     * #PJ_SSL_SOCK_SESSION_CACHE_SIZE entries. Currently only supported by
+     * OpenSSL backend.
+     *
+     * Default: PJ_TRUE
+     */
+    pj_bool_t enable_session_reuse;
+
+    /**
+     * Server only: specify if session tickets (and TLSv1.3 PSK tickets)
+     * should be issued to clients. Without tickets, TLSv1.2 or earlier
+     * clients can still resume with session ID from the server session
+     * cache, which is shared by all sockets accepted by the same listener.
+     *
+     * Default: PJ_FALSE
+     */
+    pj_bool_t enable_session_tickets;
+
+    /**
+     * Server only: lifetime of resumable sessions, in seconds. Value zero
+     * means to use the default of 300 seconds.
+     *
+     * Default: 0
+     */
+    unsigned session_timeout;
+
+    /**
+     * Specify if the handshake steps that follow the receipt of handshake
+     * data, which include the expensive public key operations, should run
+     * on the handshake worker threads (see
+     * #PJ_SSL_SOCK_HANDSHAKE_THREAD_CNT) instead of the ioqueue thread,
+     * so that the ioqueue thread is not blocked by many handshakes at
+     * once, e.g: when many clients reconnect. The handshake completion
+     * callback is then called from the timer heap polling thread.
+     *
+     * This requires \a grp_lock and \a timer_heap to be set, otherwise
+     * the handshake runs on the ioqueue thread.
+     *
+     * Default: PJ_FALSE
+     */
+    pj_bool_t handshake_offload;
+
 } pj_ssl_sock_param;
 
 
@@ -1581,6 +1674,23 @@ PJ_DECL(pj_status_t) pj_ssl_sock_start_connect2(
  */
 PJ_DECL(pj_status_t) pj_ssl_sock_renegotiate(pj_ssl_sock_t *ssock);
 
+
+/**
+ * Get the handshake statistics of all secure sockets, i.e: the number of
+ * full and resumed handshakes and their duration.
+ *
+ * @param stat          Structure to receive the statistics.
+ *
+ * @return              PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t)
+pj_ssl_sock_get_handshake_stat(pj_ssl_sock_handshake_stat *stat);
+
+/**
+ * Reset the handshake statistics of all secure sockets.
+ */
+PJ_DECL(void) pj_ssl_sock_reset_handshake_stat(void);
+
 /**
  * @}
  */
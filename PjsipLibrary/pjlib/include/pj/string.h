@@ -351,6 +351,25 @@ PJ_IDECL(int) pj_strncmp( const pj_str_t *str1, const pj_str_t *str2,
 PJ_IDECL(int) pj_strncmp2( const pj_str_t *str1, const char *str2, 
                            pj_size_t len);
 
+/**
+ * Perform case-insensitive comparison of at most len characters of two
+ * character arrays. The result is the same as pj_ansi_strnicmp(), i.e.
+ * the comparison stops at a NUL character, but long strings are compared
+ * using vector instructions where available (see #PJ_STRING_USE_SIMD).
+ * This is used by pj_stricmp() and friends.
+ *
+ * @param s1        The first character array.
+ * @param s2        The second character array.
+ * @param len       The maximum number of characters to compare.
+ *
+ * @return 
+ *      - < 0 if s1 is less than s2
+ *      - 0   if s1 is equal to s2
+ *      - > 0 if s1 is greater than s2
+ */
+PJ_DECL(int) pj_ansi_strnicmp_fast(const char *s1, const char *s2,
+                                   pj_size_t len);
+
 /**
  * Perform case-insensitive comparison to the strings.
  *
@@ -243,7 +243,7 @@ PJ_IDEF(int) pj_stricmp( const pj_str_t *str1, const pj_str_t *str2)
         return 1;
     } else {
         pj_size_t min = (str1->slen < str2->slen)? str1->slen : str2->slen;
-        int res = pj_ansi_strnicmp(str1->ptr, str2->ptr, min);
+        int res = pj_ansi_strnicmp_fast(str1->ptr, str2->ptr, min);
         if (res == 0) {
             return (str1->slen < str2->slen) ? -1 :
                     (str1->slen == str2->slen ? 0 : 1);
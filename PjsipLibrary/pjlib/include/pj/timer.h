@@ -55,6 +55,10 @@ PJ_BEGIN_DECL
  *
  * ACE is Copyright (C)1993-2006 Douglas C. Schmidt <d.schmidt@vanderbilt.edu>
  *
+ * Alternatively, the timer heap can be created with #pj_timer_heap_create2()
+ * to use a hierarchical timing wheel, where scheduling and cancelling are
+ * O(1) at the expense of rounding the expiration up to the wheel tick.
+ *
  * @{
  *
  * \section pj_timer_examples_sec Examples
@@ -148,6 +152,63 @@ typedef struct pj_timer_entry
 } pj_timer_entry;
 
 
+/**
+ * The data structure used by a timer heap to keep its scheduled entries.
+ */
+typedef enum pj_timer_heap_type
+{
+    /**
+     * Binary heap (or sorted linked list if PJ_TIMER_USE_LINKED_LIST is
+     * enabled). Entries expire at the exact millisecond, scheduling and
+     * cancelling are O(log N).
+     */
+    PJ_TIMER_HEAP_TYPE_HEAP,
+
+    /**
+     * Hierarchical timing wheel. Scheduling and cancelling are O(1), with
+     * the expiration rounded up to the wheel resolution (see
+     * #pj_timer_heap_cfg.wheel_resolution). This is suitable for timer
+     * heaps holding a very large number of entries.
+     */
+    PJ_TIMER_HEAP_TYPE_WHEEL
+
+} pj_timer_heap_type;
+
+
+/**
+ * Additional settings that can be given during timer heap creation.
+ * Application MUST initialize this structure with
+ * #pj_timer_heap_cfg_default().
+ */
+typedef struct pj_timer_heap_cfg
+{
+    /**
+     * The timer heap implementation to use.
+     *
+     * Default: PJ_TIMER_HEAP_DEFAULT_TYPE
+     */
+    pj_timer_heap_type  type;
+
+    /**
+     * The tick granularity of the timing wheel, in milliseconds. Entries
+     * never expire earlier than requested, but may expire up to this much
+     * later. This setting is ignored for other timer heap types.
+     *
+     * Default: PJ_TIMER_WHEEL_RESOLUTION
+     */
+    unsigned            wheel_resolution;
+
+} pj_timer_heap_cfg;
+
+
+/**
+ * Initialize the timer heap configuration with the default values.
+ *
+ * @param cfg       The configuration to be initialized.
+ */
+PJ_DECL(void) pj_timer_heap_cfg_default(pj_timer_heap_cfg *cfg);
+
+
 /**
  * Calculate memory size required to create a timer heap.
  *
@@ -175,6 +236,27 @@ PJ_DECL(pj_status_t) pj_timer_heap_create( pj_pool_t *pool,
                                            pj_size_t count,
                                            pj_timer_heap_t **ht);
 
+/**
+ * Create a timer heap with the specified settings.
+ *
+ * @param pool      The pool where allocations in the timer heap will be 
+ *                  allocated, see #pj_timer_heap_create().
+ * @param count     The maximum number of timer entries to be supported 
+ *                  initially. If the application registers more entries 
+ *                  during runtime, then the timer heap will resize.
+ * @param cfg       Optional timer heap configuration. Application must
+ *                  initialize this structure with pj_timer_heap_cfg_default()
+ *                  first. If this is not specified, default config values
+ *                  as set by pj_timer_heap_cfg_default() will be used.
+ * @param ht        Pointer to receive the created timer heap.
+ *
+ * @return          PJ_SUCCESS, or the appropriate error code.
+ */
+PJ_DECL(pj_status_t) pj_timer_heap_create2( pj_pool_t *pool,
+                                            pj_size_t count,
+                                            const pj_timer_heap_cfg *cfg,
+                                            pj_timer_heap_t **ht);
+
 /**
  * Destroy the timer heap.
  *
@@ -0,0 +1,209 @@
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef __PJ_TRACE_H__
+#define __PJ_TRACE_H__
+
+/**
+ * @file trace.h
+ * @brief Binary event tracing.
+ */
+#include <pj/types.h>
+
+PJ_BEGIN_DECL
+
+/**
+ * @defgroup PJ_TRACE Binary Event Tracing
+ * @ingroup PJ_MISC
+ * @{
+ * The event tracing records begin, end and instant events into per-thread
+ * ring buffers, without formatting any text, so that it is cheap enough to
+ * be left running in production (unlike logging at level 5 or 6). Each
+ * event is a timestamp (see #pj_get_timestamp()), a category and a name,
+ * which must both be static strings, and an optional integer argument.
+ *
+ * Each thread writes only to its own buffer, which is created on the
+ * thread's first event, so recording an event takes no lock. When the
+ * buffer is full, the oldest events are overwritten, so the buffers always
+ * hold the latest events of each thread.
+ *
+ * The recorded events can be exported with #pj_trace_export() to the
+ * Chrome trace event JSON format, which can be opened with Perfetto
+ * (https://ui.perfetto.dev) or chrome://tracing.
+ *
+ * The trace points are placed with #PJ_TRACE_BEGIN(), #PJ_TRACE_END() and
+ * #PJ_TRACE_INSTANT(). They compile to nothing when #PJ_HAS_TRACE is
+ * disabled, and otherwise only test #pj_trace_enabled until tracing is
+ * started.
+ *
+ * Threading: the trace points may be hit by any thread at any time, also
+ * while tracing is being started or stopped. #pj_trace_start(),
+ * #pj_trace_stop(), #pj_trace_shutdown() and the export functions must
+ * not be called concurrently with each other, e.g. only from one control
+ * thread. A thread may still write an event shortly after tracing is
+ * stopped, so the thread buffers are never released while pjlib is
+ * running; they are released by #pj_shutdown().
+ */
+
+/**
+ * Trace event types.
+ */
+typedef enum pj_trace_event_type
+{
+    PJ_TRACE_EV_BEGIN,      /**< Start of a duration.                   */
+    PJ_TRACE_EV_END,        /**< End of a duration.                     */
+    PJ_TRACE_EV_INSTANT     /**< Event without duration.                */
+} pj_trace_event_type;
+
+/**
+ * Non-zero while tracing is started. Do not modify directly.
+ */
+PJ_DECL_DATA(int) pj_trace_enabled;
+
+#if defined(PJ_HAS_TRACE) && PJ_HAS_TRACE != 0
+
+/**
+ * Record the start of a duration in the calling thread. It must be
+ * followed by #PJ_TRACE_END() with the same category and name in the
+ * same thread.
+ *
+ * @param cat           Category, a static string.
+ * @param name          Event name, a static string.
+ */
+#   define PJ_TRACE_BEGIN(cat, name) \
+            do { \
+                if (pj_trace_enabled) \
+                    pj_trace_event(PJ_TRACE_EV_BEGIN, cat, name, 0); \
+            } while (0)
+
+/**
+ * Record the end of a duration started with #PJ_TRACE_BEGIN().
+ *
+ * @param cat           Category, a static string.
+ * @param name          Event name, a static string.
+ */
+#   define PJ_TRACE_END(cat, name) \
+            do { \
+                if (pj_trace_enabled) \
+                    pj_trace_event(PJ_TRACE_EV_END, cat, name, 0); \
+            } while (0)
+
+/**
+ * Record an instant event in the calling thread.
+ *
+ * @param cat           Category, a static string.
+ * @param name          Event name, a static string.
+ * @param arg           Integer argument of the event.
+ */
+#   define PJ_TRACE_INSTANT(cat, name, arg) \
+            do { \
+                if (pj_trace_enabled) \
+                    pj_trace_event(PJ_TRACE_EV_INSTANT, cat, name, \
+                                   (int)(arg)); \
+            } while (0)
+
+#else
+#   define PJ_TRACE_BEGIN(cat, name)
+#   define PJ_TRACE_END(cat, name)
+#   define PJ_TRACE_INSTANT(cat, name, arg)
+#endif  /* PJ_HAS_TRACE */
+
+/**
+ * Start tracing. The first call allocates the trace pool from a private
+ * pool factory; subsequent calls after #pj_trace_stop() leave out the
+ * previously recorded events and reuse the buffers.
+ *
+ * @param pf            Pool factory for the temporary memory of the
+ *                      export. It must be valid while exporting.
+ * @param max_events    Number of events kept per thread. It is rounded up
+ *                      to a power of two, and is only used by the first
+ *                      call after #pj_init().
+ *
+ * @return              PJ_SUCCESS on success, or the appropriate error code.
+ */
+PJ_DECL(pj_status_t) pj_trace_start(pj_pool_factory *pf,
+                                    unsigned max_events);
+
+/**
+ * Stop recording events. The recorded events are kept and can be
+ * exported.
+ */
+PJ_DECL(void) pj_trace_stop(void);
+
+/**
+ * Stop tracing when the application is done with it. The buffers are not
+ * released here, since other threads may still be writing an event, but
+ * by #pj_shutdown(), and the next #pj_trace_start() reuses them.
+ */
+PJ_DECL(void) pj_trace_shutdown(void);
+
+/**
+ * Record an event in the calling thread's buffer. Application should use
+ * the #PJ_TRACE_BEGIN(), #PJ_TRACE_END() and #PJ_TRACE_INSTANT() macros
+ * instead.
+ *
+ * @param type          The event type.
+ * @param cat           Category, a static string.
+ * @param name          Event name, a static string.
+ * @param arg           Integer argument, only used by instant events.
+ */
+PJ_DECL(void) pj_trace_event(pj_trace_event_type type,
+                             const char *cat,
+                             const char *name,
+                             int arg);
+
+/**
+ * Get the number of events that were dropped because the maximum number
+ * of threads (#PJ_TRACE_MAX_THREADS) was reached or the thread buffer
+ * could not be allocated.
+ *
+ * @return              Number of dropped events.
+ */
+PJ_DECL(unsigned) pj_trace_get_dropped(void);
+
+/**
+ * Export the recorded events in the Chrome trace event JSON format. It
+ * may be called while tracing is running, in which case the events that
+ * are overwritten during the export are left out.
+ *
+ * @param buf           Buffer to receive the JSON document. It is null
+ *                      terminated.
+ * @param size          Size of the buffer.
+ *
+ * @return              Length of the document, or -1 if the buffer is too
+ *                      small.
+ */
+PJ_DECL(pj_ssize_t) pj_trace_export(char *buf, pj_size_t size);
+
+/**
+ * Export the recorded events in the Chrome trace event JSON format to a
+ * file.
+ *
+ * @param path          The file name.
+ *
+ * @return              PJ_SUCCESS on success, or the appropriate error code.
+ */
+PJ_DECL(pj_status_t) pj_trace_export_file(const char *path);
+
+/**
+ * @}
+ */
+
+PJ_END_DECL
+
+#endif  /* __PJ_TRACE_H__ */
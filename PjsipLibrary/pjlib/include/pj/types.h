@@ -254,6 +254,15 @@ typedef struct pj_lock_t pj_lock_t;
 /** Group lock */
 typedef struct pj_grp_lock_t pj_grp_lock_t;
 
+/** Sequence lock */
+typedef struct pj_seqlock_t pj_seqlock_t;
+
+/** Fixed-size object (slab) allocator */
+typedef struct pj_slab_t pj_slab_t;
+
+/** Single producer single consumer ring buffer */
+typedef struct pj_ringbuf_t pj_ringbuf_t;
+
 /** Mutex handle. */
 typedef struct pj_mutex_t pj_mutex_t;
 
@@ -0,0 +1,151 @@
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef __PJ_WORK_QUEUE_H__
+#define __PJ_WORK_QUEUE_H__
+
+/**
+ * @file work_queue.h
+ * @brief Worker threads running queued jobs.
+ */
+#include <pj/list.h>
+
+PJ_BEGIN_DECL
+
+/**
+ * @defgroup PJ_WORK_QUEUE Work Queue
+ * @ingroup PJ_OS
+ * @{
+ * A work queue runs jobs on a small pool of worker threads, in the order
+ * they were posted. It is meant for work that must not block the ioqueue
+ * or timer thread, such as the system host name resolver or the TLS
+ * handshake crypto. The job records are owned by the caller, so posting
+ * a job does not allocate memory.
+ *
+ * The work queue needs #PJ_HAS_THREADS.
+ */
+
+/**
+ * Opaque data type for the work queue.
+ */
+typedef struct pj_work_queue pj_work_queue;
+
+/**
+ * Forward declaration of the job.
+ */
+typedef struct pj_work_job pj_work_job;
+
+/**
+ * Callback to run a job.
+ *
+ * @param job       The job.
+ * @param status    PJ_SUCCESS when the job is run by a worker thread, or
+ *                  PJ_ECANCELLED when the queue is destroyed while the job
+ *                  is still queued, in which case the callback is called by
+ *                  the thread destroying the queue so that the job can
+ *                  release its resources.
+ */
+typedef void pj_work_job_cb(pj_work_job *job, pj_status_t status);
+
+/**
+ * A job. It must stay valid while it is queued.
+ */
+struct pj_work_job
+{
+    /** List member, used by the work queue. */
+    PJ_DECL_LIST_MEMBER(struct pj_work_job);
+
+    /** The callback to run the job. */
+    pj_work_job_cb      *cb;
+
+    /** Application data. */
+    void                *user_data;
+
+    /** Non-zero while the job is queued, used by the work queue. */
+    pj_bool_t            queued;
+};
+
+/**
+ * Initialize a job.
+ *
+ * @param job       The job.
+ * @param cb        The callback to run the job.
+ * @param user_data Application data.
+ */
+PJ_DECL(void) pj_work_job_init(pj_work_job *job, pj_work_job_cb *cb,
+                               void *user_data);
+
+/**
+ * Create a work queue and start its worker threads.
+ *
+ * @param pool      Pool to allocate the queue, which must stay valid
+ *                  until the queue is destroyed.
+ * @param name      Name of the queue and its threads, which may contain
+ *                  "%p" (see #pj_thread_create()).
+ * @param thread_cnt Number of worker threads.
+ * @param p_wq      Pointer to receive the queue.
+ *
+ * @return          PJ_SUCCESS on success, or the appropriate error code.
+ */
+PJ_DECL(pj_status_t) pj_work_queue_create(pj_pool_t *pool,
+                                          const char *name,
+                                          unsigned thread_cnt,
+                                          pj_work_queue **p_wq);
+
+/**
+ * Queue a job to be run by one of the worker threads.
+ *
+ * @param wq        The work queue.
+ * @param job       The job, which must not be queued already.
+ *
+ * @return          PJ_SUCCESS if the job has been queued, PJ_EBUSY if it
+ *                  is queued already, or PJ_EINVALIDOP if the queue is
+ *                  being destroyed.
+ */
+PJ_DECL(pj_status_t) pj_work_queue_post(pj_work_queue *wq,
+                                        pj_work_job *job);
+
+/**
+ * Remove a job that has not been picked up by a worker thread yet.
+ *
+ * @param wq        The work queue.
+ * @param job       The job.
+ *
+ * @return          PJ_SUCCESS if the job was removed and its callback will
+ *                  not be called, or PJ_ENOTFOUND if it is not queued,
+ *                  e.g. because it is already running.
+ */
+PJ_DECL(pj_status_t) pj_work_queue_cancel(pj_work_queue *wq,
+                                          pj_work_job *job);
+
+/**
+ * Stop the worker threads, waiting for the running jobs to return, and
+ * call the callback of the jobs that are still queued with PJ_ECANCELLED.
+ * It must not be called by a worker thread.
+ *
+ * @param wq        The work queue.
+ */
+PJ_DECL(void) pj_work_queue_destroy(pj_work_queue *wq);
+
+/**
+ * @}
+ */
+
+PJ_END_DECL
+
+#endif  /* __PJ_WORK_QUEUE_H__ */
@@ -48,13 +48,17 @@
 #include <pj/pool_buf.h>
 #include <pj/rand.h>
 #include <pj/rbtree.h>
+#include <pj/ringbuf.h>
+#include <pj/slab.h>
 #include <pj/sock.h>
 #include <pj/sock_qos.h>
 #include <pj/sock_select.h>
 #include <pj/ssl_sock.h>
 #include <pj/string.h>
 #include <pj/timer.h>
+#include <pj/trace.h>
 #include <pj/unicode.h>
+#include <pj/work_queue.h>
 
 #include <pj/compat/high_precision.h>
 
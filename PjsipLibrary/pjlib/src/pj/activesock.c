@@ -57,6 +57,7 @@ struct read_op
     pj_size_t            size;
     pj_sockaddr          src_addr;
     int                  src_addr_len;
+    pj_sock_mmsg        *batch;
 };
 
 struct accept_op
@@ -86,10 +87,10 @@ struct pj_activesock_t
     unsigned             shutdown;
     unsigned             max_loop;
     pj_activesock_cb     cb;
+    pj_sock_t            sock;
 #if defined(PJ_IPHONE_OS_HAS_MULTITASKING_SUPPORT) && \
     PJ_IPHONE_OS_HAS_MULTITASKING_SUPPORT!=0
     int                  bg_setting;
-    pj_sock_t            sock;
     CFReadStreamRef      readStream;
 #endif
     
@@ -101,6 +102,7 @@ struct pj_activesock_t
     struct read_op      *read_op;
     pj_uint32_t          read_flags;
     enum read_type       read_type;
+    unsigned             batch_cnt;
 
     struct accept_op    *accept_op;
 };
@@ -209,6 +211,7 @@ PJ_DEF(pj_status_t) pj_activesock_create( pj_pool_t *pool,
 
     asock = PJ_POOL_ZALLOC_T(pool, pj_activesock_t);
     asock->ioqueue = ioqueue;
+    asock->sock = sock;
     asock->stream_oriented = ((sock_type & 0xF) == pj_SOCK_STREAM());
     asock->async_count = (opt? opt->async_cnt : 1);
     asock->whole_data = (opt? opt->whole_data : 1);
@@ -241,7 +244,6 @@ PJ_DEF(pj_status_t) pj_activesock_create( pj_pool_t *pool,
 
 #if defined(PJ_IPHONE_OS_HAS_MULTITASKING_SUPPORT) && \
     PJ_IPHONE_OS_HAS_MULTITASKING_SUPPORT!=0
-    asock->sock = sock;
     asock->bg_setting = PJ_ACTIVESOCK_TCP_IPHONE_OS_BG;
 #endif
 
@@ -429,6 +431,59 @@ PJ_DEF(pj_status_t) pj_activesock_start_recvfrom(pj_activesock_t *asock,
 }
 
 
+PJ_DEF(pj_status_t) pj_activesock_start_recvfrom_batch(
+                                                pj_activesock_t *asock,
+                                                pj_pool_t *pool,
+                                                unsigned buff_size,
+                                                unsigned batch_cnt,
+                                                pj_uint32_t flags)
+{
+    PJ_ASSERT_RETURN(asock && pool && buff_size && batch_cnt, PJ_EINVAL);
+    PJ_ASSERT_RETURN(!asock->stream_oriented, PJ_EINVALIDOP);
+    PJ_ASSERT_RETURN(asock->read_type == TYPE_NONE, PJ_EINVALIDOP);
+
+    asock->batch_cnt = batch_cnt;
+    return pj_activesock_start_recvfrom(asock, pool, buff_size, flags);
+}
+
+
+/* Deliver the packet in the read op, plus any other packets that are
+ * already queued in the socket, to the batch callback. Returns PJ_FALSE
+ * if the active socket has been destroyed in the callback. On return,
+ * drained is set if the socket has no more queued packets.
+ */
+static pj_bool_t deliver_batch(pj_activesock_t *asock, struct read_op *r,
+                               pj_bool_t *drained)
+{
+    pj_sock_mmsg *pkts = r->batch;
+    unsigned cnt, i;
+    pj_bool_t ret = PJ_TRUE;
+
+    pkts[0].len = r->size;
+    pj_sockaddr_cp(&pkts[0].addr, &r->src_addr);
+    pkts[0].addr_len = r->src_addr_len;
+
+    cnt = asock->batch_cnt - 1;
+    if (pj_sock_recvmmsg(asock->sock, &pkts[1], &cnt, 0) != PJ_SUCCESS)
+        cnt = 0;
+    *drained = (cnt < asock->batch_cnt - 1);
+    ++cnt;
+
+    if (asock->cb.on_data_recvfrom_batch) {
+        ret = (*asock->cb.on_data_recvfrom_batch)(asock, pkts, cnt);
+    } else if (asock->cb.on_data_recvfrom) {
+        for (i=0; i<cnt && ret; ++i) {
+            ret = (*asock->cb.on_data_recvfrom)(asock, pkts[i].buf,
+                                                pkts[i].len, &pkts[i].addr,
+                                                pkts[i].addr_len,
+                                                PJ_SUCCESS);
+        }
+    }
+
+    return ret;
+}
+
+
 PJ_DEF(pj_status_t) pj_activesock_start_recvfrom2( pj_activesock_t *asock,
                                                    pj_pool_t *pool,
                                                    unsigned buff_size,
@@ -455,6 +510,23 @@ PJ_DEF(pj_status_t) pj_activesock_start_recvfrom2( pj_activesock_t *asock,
         size_to_read = r->max_size = buff_size;
         r->src_addr_len = sizeof(r->src_addr);
 
+        if (asock->batch_cnt > 1) {
+            unsigned j;
+
+            /* The first entry refers to the packet received by ioqueue,
+             * the rest are filled by pj_sock_recvmmsg().
+             */
+            r->batch = (pj_sock_mmsg*)
+                       pj_pool_calloc(pool, asock->batch_cnt,
+                                      sizeof(pj_sock_mmsg));
+            r->batch[0].buf = r->pkt;
+            r->batch[0].size = buff_size;
+            for (j=1; j<asock->batch_cnt; ++j) {
+                r->batch[j].buf = pj_pool_alloc(pool, buff_size);
+                r->batch[j].size = buff_size;
+            }
+        }
+
         status = pj_ioqueue_recvfrom(asock->key, &r->op_key, r->pkt,
                                      &size_to_read, 
                                      PJ_IOQUEUE_ALWAYS_ASYNC | flags,
@@ -476,6 +548,7 @@ static void ioqueue_on_read_complete(pj_ioqueue_key_t *key,
     pj_activesock_t *asock;
     struct read_op *r = (struct read_op*)op_key;
     unsigned loop = 0;
+    pj_bool_t drained = PJ_FALSE;
     pj_status_t status;
 
     asock = (pj_activesock_t*) pj_ioqueue_get_user_data(key);
@@ -520,6 +593,8 @@ static void ioqueue_on_read_complete(pj_ioqueue_key_t *key,
                                    "activesock on_data_read()."));
                         remainder = 0;
                     });
+            } else if (asock->read_type == TYPE_RECV_FROM && r->batch) {
+                ret = deliver_batch(asock, r, &drained);
             } else if (asock->read_type == TYPE_RECV_FROM && 
                        asock->cb.on_data_recvfrom) 
             {
@@ -640,7 +715,7 @@ static void ioqueue_on_read_complete(pj_ioqueue_key_t *key,
          */
         bytes_read = r->max_size - r->size;
         flags = asock->read_flags;
-        if (++loop >= asock->max_loop)
+        if (++loop >= asock->max_loop || drained)
             flags |= PJ_IOQUEUE_ALWAYS_ASYNC;
 
         if (asock->read_type == TYPE_RECV) {
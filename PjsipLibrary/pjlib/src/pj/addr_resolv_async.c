@@ -0,0 +1,449 @@
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include <pj/addr_resolv.h>
+#include <pj/assert.h>
+#include <pj/errno.h>
+#include <pj/list.h>
+#include <pj/log.h>
+#include <pj/os.h>
+#include <pj/pool.h>
+#include <pj/sock.h>
+#include <pj/string.h>
+#include <pj/work_queue.h>
+
+#define THIS_FILE       "addr_resolv_async.c"
+
+/* Resolve an IP address string, which does not block */
+static pj_bool_t resolve_ip_addr(int af, const pj_str_t *name,
+                                 unsigned max_count,
+                                 void *user_data,
+                                 pj_getaddrinfo_cb *cb)
+{
+    pj_addrinfo ai[PJ_GETADDRINFO_ASYNC_MAX_CNT];
+    pj_in6_addr tmp;
+    unsigned cnt = max_count;
+    pj_status_t status;
+
+    if (pj_inet_pton(pj_AF_INET(), name, &tmp) != PJ_SUCCESS &&
+        pj_inet_pton(pj_AF_INET6(), name, &tmp) != PJ_SUCCESS)
+    {
+        return PJ_FALSE;
+    }
+
+    status = pj_getaddrinfo(af, name, &cnt, ai);
+    (*cb)(user_data, status, (status == PJ_SUCCESS ? cnt : 0), ai);
+    return PJ_TRUE;
+}
+
+
+#if PJ_HAS_THREADS
+
+/* Query state */
+enum query_state
+{
+    QUERY_QUEUED,
+    QUERY_RESOLVING,
+    QUERY_NOTIFYING,
+    QUERY_FREE
+};
+
+struct pj_getaddrinfo_query
+{
+    PJ_DECL_LIST_MEMBER(struct pj_getaddrinfo_query);
+
+    pj_work_job          job;
+    enum query_state     state;
+    pj_bool_t            cancelled;
+    int                  af;
+    char                 name_buf[PJ_MAX_HOSTNAME];
+    pj_str_t             name;
+    unsigned             max_count;
+    void                *user_data;
+    pj_getaddrinfo_cb   *cb;
+    pj_addrinfo          ai[PJ_GETADDRINFO_ASYNC_MAX_CNT];
+};
+
+/* Cached result */
+typedef struct cache_entry
+{
+    int                  af;
+    char                 name_buf[PJ_MAX_HOSTNAME];
+    pj_str_t             name;
+    pj_uint32_t          expiry;        /* In msec tick count           */
+    pj_status_t          status;
+    unsigned             count;
+    pj_addrinfo          ai[PJ_GETADDRINFO_ASYNC_MAX_CNT];
+} cache_entry;
+
+static struct async_resolver
+{
+    pj_caching_pool      cp;
+    pj_pool_t           *pool;
+    pj_mutex_t          *mutex;
+    pj_work_queue       *wq;
+    pj_bool_t            quit;
+
+    pj_getaddrinfo_query free_list;
+
+#if PJ_GETADDRINFO_CACHE_SIZE > 0
+    cache_entry          cache[PJ_GETADDRINFO_CACHE_SIZE];
+    unsigned             cache_cnt;
+#endif
+} ar;
+
+
+#if PJ_GETADDRINFO_CACHE_SIZE > 0
+static pj_uint32_t now_msec(void)
+{
+    pj_time_val now;
+
+    pj_gettickcount(&now);
+    return (pj_uint32_t)PJ_TIME_VAL_MSEC(now);
+}
+
+/* Find a cached result. Must be called with the mutex held. */
+static cache_entry *cache_find(int af, const pj_str_t *name)
+{
+    pj_uint32_t now = now_msec();
+    unsigned i;
+
+    for (i=0; i<ar.cache_cnt; ++i) {
+        cache_entry *e = &ar.cache[i];
+
+        if (e->af == af && pj_stricmp(&e->name, name) == 0) {
+            if ((pj_int32_t)(e->expiry - now) <= 0) {
+                /* Expired, remove it */
+                if (i != ar.cache_cnt - 1)
+                    pj_memcpy(e, &ar.cache[ar.cache_cnt-1], sizeof(*e));
+                e->name.ptr = e->name_buf;
+                --ar.cache_cnt;
+                return NULL;
+            }
+            return e;
+        }
+    }
+    return NULL;
+}
+
+/* Store a result, replacing the entry that expires first when the cache
+ * is full. Must be called with the mutex held.
+ */
+static void cache_put(int af, const pj_str_t *name, pj_status_t status,
+                      unsigned count, const pj_addrinfo ai[])
+{
+    cache_entry *e;
+    unsigned ttl;
+
+    e = cache_find(af, name);
+    if (!e) {
+        if (ar.cache_cnt < PJ_GETADDRINFO_CACHE_SIZE) {
+            e = &ar.cache[ar.cache_cnt++];
+        } else {
+            unsigned i;
+
+            e = &ar.cache[0];
+            for (i=1; i<ar.cache_cnt; ++i) {
+                if ((pj_int32_t)(ar.cache[i].expiry - e->expiry) < 0)
+                    e = &ar.cache[i];
+            }
+        }
+        e->af = af;
+        e->name.ptr = e->name_buf;
+        pj_strcpy(&e->name, name);
+    }
+
+    ttl = (status == PJ_SUCCESS) ? PJ_GETADDRINFO_CACHE_TTL :
+                                   PJ_GETADDRINFO_CACHE_NEG_TTL;
+    e->expiry = now_msec() + ttl * 1000;
+    e->status = status;
+    e->count = count;
+    if (count)
+        pj_memcpy(e->ai, ai, count * sizeof(pj_addrinfo));
+}
+#endif  /* PJ_GETADDRINFO_CACHE_SIZE */
+
+/* Put the query back to the free list. Must be called with the mutex
+ * held.
+ */
+static void release_query(pj_getaddrinfo_query *q)
+{
+    q->state = QUERY_FREE;
+    q->cb = NULL;
+    q->user_data = NULL;
+    pj_list_push_back(&ar.free_list, q);
+}
+
+/* Resolve a query on one of the work queue threads */
+static void resolve_job(pj_work_job *job, pj_status_t status)
+{
+    pj_getaddrinfo_query *q = (pj_getaddrinfo_query*)job->user_data;
+    unsigned cnt;
+    pj_bool_t notify;
+
+    /* Discarded at shutdown, the query goes with the pool */
+    if (status != PJ_SUCCESS)
+        return;
+
+    pj_mutex_lock(ar.mutex);
+    if (q->cancelled) {
+        /* Cancelled after the job was taken from the queue */
+        release_query(q);
+        pj_mutex_unlock(ar.mutex);
+        return;
+    }
+    q->state = QUERY_RESOLVING;
+    pj_mutex_unlock(ar.mutex);
+
+    /* The query is not released while it is being resolved, so it can be
+     * used without the mutex.
+     */
+    cnt = PJ_GETADDRINFO_ASYNC_MAX_CNT;
+    status = pj_getaddrinfo(q->af, &q->name, &cnt, q->ai);
+    if (status != PJ_SUCCESS)
+        cnt = 0;
+
+    pj_mutex_lock(ar.mutex);
+#if PJ_GETADDRINFO_CACHE_SIZE > 0
+    cache_put(q->af, &q->name, status, cnt, q->ai);
+#endif
+    if (ar.quit) {
+        pj_mutex_unlock(ar.mutex);
+        return;
+    }
+    notify = !q->cancelled;
+    q->state = QUERY_NOTIFYING;
+    pj_mutex_unlock(ar.mutex);
+
+    if (notify) {
+        if (cnt > q->max_count)
+            cnt = q->max_count;
+        (*q->cb)(q->user_data, status, cnt, q->ai);
+    }
+
+    pj_mutex_lock(ar.mutex);
+    release_query(q);
+    pj_mutex_unlock(ar.mutex);
+}
+
+static void resolver_shutdown(void)
+{
+    if (!ar.pool)
+        return;
+
+    pj_mutex_lock(ar.mutex);
+    ar.quit = PJ_TRUE;
+    pj_mutex_unlock(ar.mutex);
+
+    pj_work_queue_destroy(ar.wq);
+    pj_mutex_destroy(ar.mutex);
+    pj_pool_release(ar.pool);
+    pj_caching_pool_destroy(&ar.cp);
+    pj_bzero(&ar, sizeof(ar));
+}
+
+static pj_status_t resolver_init(void)
+{
+    pj_status_t status;
+
+    pj_bzero(&ar, sizeof(ar));
+    pj_list_init(&ar.free_list);
+
+    pj_caching_pool_init(&ar.cp, NULL, 0);
+    ar.pool = pj_pool_create(&ar.cp.factory, "gai%p", 1000, 1000, NULL);
+    if (!ar.pool) {
+        pj_caching_pool_destroy(&ar.cp);
+        return PJ_ENOMEM;
+    }
+
+    status = pj_mutex_create_simple(ar.pool, "gai%p", &ar.mutex);
+    if (status != PJ_SUCCESS)
+        goto on_error;
+
+    status = pj_work_queue_create(ar.pool, "gai%p",
+                                  PJ_GETADDRINFO_ASYNC_THREAD_CNT, &ar.wq);
+    if (status != PJ_SUCCESS)
+        goto on_error;
+
+    pj_atexit(&resolver_shutdown);
+    return PJ_SUCCESS;
+
+on_error:
+    PJ_PERROR(2,(THIS_FILE, status, "Error starting resolver threads"));
+    if (ar.mutex)
+        pj_mutex_destroy(ar.mutex);
+    pj_pool_release(ar.pool);
+    pj_caching_pool_destroy(&ar.cp);
+    pj_bzero(&ar, sizeof(ar));
+    return status;
+}
+
+PJ_DEF(pj_status_t) pj_getaddrinfo_async(int af, const pj_str_t *name,
+                                         unsigned max_count,
+                                         void *user_data,
+                                         pj_getaddrinfo_cb *cb,
+                                         pj_getaddrinfo_query **p_query)
+{
+    pj_getaddrinfo_query *q;
+    pj_status_t status = PJ_SUCCESS;
+
+    PJ_ASSERT_RETURN(name && max_count && cb, PJ_EINVAL);
+
+    if (p_query)
+        *p_query = NULL;
+
+    if (name->slen >= PJ_MAX_HOSTNAME)
+        return PJ_ENAMETOOLONG;
+
+    if (max_count > PJ_GETADDRINFO_ASYNC_MAX_CNT)
+        max_count = PJ_GETADDRINFO_ASYNC_MAX_CNT;
+
+    if (resolve_ip_addr(af, name, max_count, user_data, cb))
+        return PJ_SUCCESS;
+
+    pj_enter_critical_section();
+    if (!ar.pool)
+        status = resolver_init();
+    pj_leave_critical_section();
+    if (status != PJ_SUCCESS)
+        return status;
+
+    pj_mutex_lock(ar.mutex);
+
+#if PJ_GETADDRINFO_CACHE_SIZE > 0
+    {
+        cache_entry *e = cache_find(af, name);
+
+        if (e) {
+            pj_addrinfo ai[PJ_GETADDRINFO_ASYNC_MAX_CNT];
+            unsigned cnt = (e->count < max_count) ? e->count : max_count;
+
+            status = e->status;
+            if (cnt)
+                pj_memcpy(ai, e->ai, cnt * sizeof(pj_addrinfo));
+            pj_mutex_unlock(ar.mutex);
+
+            (*cb)(user_data, status, cnt, ai);
+            return PJ_SUCCESS;
+        }
+    }
+#endif
+
+    if (!pj_list_empty(&ar.free_list)) {
+        q = ar.free_list.next;
+        pj_list_erase(q);
+    } else {
+        q = PJ_POOL_ALLOC_T(ar.pool, pj_getaddrinfo_query);
+    }
+
+    pj_work_job_init(&q->job, &resolve_job, q);
+    q->state = QUERY_QUEUED;
+    q->cancelled = PJ_FALSE;
+    q->af = af;
+    q->name.ptr = q->name_buf;
+    pj_strcpy(&q->name, name);
+    q->name_buf[q->name.slen] = '\0';
+    q->max_count = max_count;
+    q->user_data = user_data;
+    q->cb = cb;
+
+    status = pj_work_queue_post(ar.wq, &q->job);
+    if (status != PJ_SUCCESS) {
+        release_query(q);
+        pj_mutex_unlock(ar.mutex);
+        return status;
+    }
+
+    if (p_query)
+        *p_query = q;
+
+    pj_mutex_unlock(ar.mutex);
+    return PJ_SUCCESS;
+}
+
+PJ_DEF(pj_status_t) pj_getaddrinfo_cancel(pj_getaddrinfo_query *query)
+{
+    pj_status_t status = PJ_SUCCESS;
+
+    PJ_ASSERT_RETURN(query, PJ_EINVAL);
+    PJ_ASSERT_RETURN(ar.pool, PJ_EINVALIDOP);
+
+    pj_mutex_lock(ar.mutex);
+    switch (query->state) {
+    case QUERY_QUEUED:
+        if (pj_work_queue_cancel(ar.wq, &query->job) == PJ_SUCCESS) {
+            release_query(query);
+            break;
+        }
+        /* Taken by a thread which is waiting for the mutex */
+        query->cancelled = PJ_TRUE;
+        break;
+    case QUERY_RESOLVING:
+        /* The resolver thread releases it */
+        query->cancelled = PJ_TRUE;
+        break;
+    case QUERY_NOTIFYING:
+        status = PJ_EBUSY;
+        break;
+    default:
+        pj_assert(!"Query has completed");
+        status = PJ_EINVALIDOP;
+        break;
+    }
+    pj_mutex_unlock(ar.mutex);
+
+    return status;
+}
+
+#else   /* PJ_HAS_THREADS */
+
+PJ_DEF(pj_status_t) pj_getaddrinfo_async(int af, const pj_str_t *name,
+                                         unsigned max_count,
+                                         void *user_data,
+                                         pj_getaddrinfo_cb *cb,
+                                         pj_getaddrinfo_query **p_query)
+{
+    pj_addrinfo ai[PJ_GETADDRINFO_ASYNC_MAX_CNT];
+    unsigned cnt;
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(name && max_count && cb, PJ_EINVAL);
+
+    if (p_query)
+        *p_query = NULL;
+
+    if (max_count > PJ_GETADDRINFO_ASYNC_MAX_CNT)
+        max_count = PJ_GETADDRINFO_ASYNC_MAX_CNT;
+
+    if (resolve_ip_addr(af, name, max_count, user_data, cb))
+        return PJ_SUCCESS;
+
+    /* Without threads the name can only be resolved synchronously */
+    cnt = max_count;
+    status = pj_getaddrinfo(af, name, &cnt, ai);
+    (*cb)(user_data, status, (status == PJ_SUCCESS ? cnt : 0), ai);
+    return PJ_SUCCESS;
+}
+
+PJ_DEF(pj_status_t) pj_getaddrinfo_cancel(pj_getaddrinfo_query *query)
+{
+    PJ_UNUSED_ARG(query);
+    return PJ_EINVALIDOP;
+}
+
+#endif  /* PJ_HAS_THREADS */
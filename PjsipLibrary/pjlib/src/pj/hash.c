@@ -45,45 +45,208 @@ struct pj_hash_table_t
     pj_hash_entry     **table;
     unsigned            count, rows;
     pj_hash_iterator_t  iterator;
+
+    /* Open addressing table (see pj_hash_create_oa()). When ctrl is not
+     * NULL, rows is the slot count minus one and table is not used.
+     */
+    pj_pool_t          *pool;
+    pj_uint8_t         *ctrl;
+    pj_hash_entry      *slots;
+    unsigned            growth_left;
+
+    /* Arrays of the same capacity left over from the last rehash which
+     * only removed deleted slots, reused by the next one.
+     */
+    pj_uint8_t         *spare_ctrl;
+    pj_hash_entry      *spare_slots;
 };
 
+/*
+ * Open addressing table.
+ *
+ * Slots are arranged in groups of OA_GROUP. Each slot has a control byte,
+ * which is either OA_EMPTY, OA_DELETED, or the low 7 bits of the mixed
+ * hash of the entry in the slot. A lookup starts at the group selected by
+ * the rest of the mixed hash and compares the control bytes of the whole
+ * group at once against the 7-bit hash, so that only slots with matching
+ * control byte need to be compared with the key. The probe continues to
+ * the next group (triangular probing over groups) until a group with an
+ * empty slot is found.
+ */
+#define OA_GROUP        8
+#define OA_EMPTY        0x80
+#define OA_DELETED      0xFE
+#define OA_MIN_SIZE     16
 
+/* Maximum load is 7/8 of the slots, including deleted slots. */
+#define OA_MAX_LOAD(cap)    ((cap) - (cap) / 8)
 
-PJ_DEF(pj_uint32_t) pj_hash_calc(pj_uint32_t hash, const void *key, 
-                                 unsigned keylen)
+#define OA_LSBS         ((((pj_uint64_t)0x01010101) << 32) | 0x01010101)
+#define OA_MSBS         (OA_LSBS << 7)
+
+#if defined(__GNUC__)
+#   define OA_CTZ(x)    ((unsigned)__builtin_ctzll(x))
+#else
+static unsigned oa_ctz(pj_uint64_t x)
 {
-    PJ_CHECK_STACK();
+    unsigned n = 0;
+    while ((x & 1) == 0) {
+        x >>= 1;
+        ++n;
+    }
+    return n;
+}
+#   define OA_CTZ(x)    oa_ctz(x)
+#endif
+
+/* Index of the lowest matching slot in group mask */
+#define OA_FIRST(mask)  (OA_CTZ(mask) >> 3)
+
+
+
+#if PJ_HASH_USE_WORD_HASH
+
+/*
+ * Word at a time hash. The key is consumed in little-endian 64-bit words
+ * (the last one zero padded), each mixed into the state with a multiply,
+ * and the state is finalized so that all bits of the result depend on
+ * all bits of the key. Case folding of the lower case variant is done on
+ * the whole word, so lower case and upper case keys give the same words.
+ */
+#define HASH_K1         ((((pj_uint64_t)0x9E3779B9) << 32) | 0x7F4A7C15)
+#define HASH_K2         ((((pj_uint64_t)0xC2B2AE3D) << 32) | 0x27D4EB4F)
+#define HASH_LSBS       ((((pj_uint64_t)0x01010101) << 32) | 0x01010101)
+#define HASH_MSBS       (HASH_LSBS << 7)
+
+/* Load len (up to 8) bytes of the key as a little-endian word. */
+static pj_uint64_t hash_load(const pj_uint8_t *p, unsigned len)
+{
+    pj_uint64_t w = 0;
+
+#if defined(PJ_IS_LITTLE_ENDIAN) && PJ_IS_LITTLE_ENDIAN!=0
+    if (len == 8) {
+        pj_memcpy(&w, p, sizeof(w));
+        return w;
+    }
+#endif
+    while (len) {
+        --len;
+        w = (w << 8) | p[len];
+    }
+    return w;
+}
+
+/* Store len (up to 8) bytes of a word loaded with hash_load(). */
+static void hash_store(pj_uint8_t *p, pj_uint64_t w, unsigned len)
+{
+    unsigned i;
+
+#if defined(PJ_IS_LITTLE_ENDIAN) && PJ_IS_LITTLE_ENDIAN!=0
+    if (len == 8) {
+        pj_memcpy(p, &w, sizeof(w));
+        return;
+    }
+#endif
+    for (i=0; i<len; ++i) {
+        p[i] = (pj_uint8_t)w;
+        w >>= 8;
+    }
+}
+
+/* Convert the ASCII upper case letters in the word to lower case. A byte
+ * is an upper case letter if its high bit is clear and its value is at
+ * least 'A' and not more than 'Z'. The additions below can not carry into
+ * the next byte since the high bits are masked off first.
+ */
+static pj_uint64_t hash_fold(pj_uint64_t w)
+{
+    pj_uint64_t low = w & ~HASH_MSBS;
+    pj_uint64_t ge_a = low + HASH_LSBS * (0x80 - 'A');
+    pj_uint64_t gt_z = low + HASH_LSBS * (0x80 - 'Z' - 1);
+
+    return w | ((ge_a & ~gt_z & ~w & HASH_MSBS) >> 2);
+}
+
+static pj_uint32_t calc_hash(pj_uint32_t hval, const pj_uint8_t *p,
+                             pj_size_t len, pj_bool_t lower,
+                             pj_uint8_t *result)
+{
+    pj_uint64_t h = hval ^ ((pj_uint64_t)len * HASH_K1);
+    pj_uint64_t w;
+
+    for (; len >= 8; len -= 8, p += 8) {
+        w = hash_load(p, 8);
+        if (lower) {
+            w = hash_fold(w);
+            if (result) {
+                hash_store(result, w, 8);
+                result += 8;
+            }
+        }
+        h = (h ^ w) * HASH_K2;
+        h ^= h >> 32;
+    }
+
+    if (len) {
+        w = hash_load(p, (unsigned)len);
+        if (lower) {
+            w = hash_fold(w);
+            if (result)
+                hash_store(result, w, (unsigned)len);
+        }
+        h = (h ^ w) * HASH_K2;
+        h ^= h >> 32;
+    }
+
+    h ^= h >> 29;
+    h *= HASH_K1;
+    h ^= h >> 32;
+    return (pj_uint32_t)h;
+}
 
-    if (keylen==PJ_HASH_KEY_STRING) {
-        const pj_uint8_t *p = (const pj_uint8_t*)key;
-        for ( ; *p; ++p ) {
+#else   /* PJ_HASH_USE_WORD_HASH */
+
+static pj_uint32_t calc_hash(pj_uint32_t hash, const pj_uint8_t *p,
+                             pj_size_t len, pj_bool_t lower,
+                             pj_uint8_t *result)
+{
+    const pj_uint8_t *end = p + len;
+
+    if (!lower) {
+        for ( ; p!=end; ++p) {
             hash = (hash * PJ_HASH_MULTIPLIER) + *p;
         }
     } else {
-        const pj_uint8_t *p = (const pj_uint8_t*)key,
-                              *end = p + keylen;
         for ( ; p!=end; ++p) {
-            hash = (hash * PJ_HASH_MULTIPLIER) + *p;
+            int c = pj_tolower(*p);
+            if (result)
+                *result++ = (pj_uint8_t)c;
+            hash = (hash * PJ_HASH_MULTIPLIER) + c;
         }
     }
     return hash;
 }
 
-PJ_DEF(pj_uint32_t) pj_hash_calc_tolower( pj_uint32_t hval,
-                                          char *result,
-                                          const pj_str_t *key)
+#endif  /* PJ_HASH_USE_WORD_HASH */
+
+
+PJ_DEF(pj_uint32_t) pj_hash_calc(pj_uint32_t hash, const void *key, 
+                                 unsigned keylen)
 {
-    long i;
+    PJ_CHECK_STACK();
 
-    for (i=0; i<key->slen; ++i) {
-        int lower = pj_tolower(key->ptr[i]);
-        if (result)
-            result[i] = (char)lower;
+    if (keylen==PJ_HASH_KEY_STRING)
+        keylen = (unsigned)pj_ansi_strlen((const char*)key);
 
-        hval = hval * PJ_HASH_MULTIPLIER + lower;
-    }
+    return calc_hash(hash, (const pj_uint8_t*)key, keylen, PJ_FALSE, NULL);
+}
 
-    return hval;
+PJ_DEF(pj_uint32_t) pj_hash_calc_tolower( pj_uint32_t hval,
+                                          char *result,
+                                          const pj_str_t *key)
+{
+    return calc_hash(hval, (const pj_uint8_t*)key->ptr, key->slen, PJ_TRUE,
+                     (pj_uint8_t*)result);
 }
 
 
@@ -95,7 +258,7 @@ PJ_DEF(pj_hash_table_t*) pj_hash_create(pj_pool_t *pool, unsigned size)
     /* Check that PJ_HASH_ENTRY_BUF_SIZE is correct. */
     PJ_ASSERT_RETURN(sizeof(pj_hash_entry)<=PJ_HASH_ENTRY_BUF_SIZE, NULL);
 
-    h = PJ_POOL_ALLOC_T(pool, pj_hash_table_t);
+    h = PJ_POOL_ZALLOC_T(pool, pj_hash_table_t);
     h->count = 0;
 
     PJ_LOG( 6, ("hashtbl", "hash table %p created from pool %s", h, pj_pool_getobjname(pool)));
@@ -116,61 +279,58 @@ PJ_DEF(pj_hash_table_t*) pj_hash_create(pj_pool_t *pool, unsigned size)
     return h;
 }
 
-static pj_hash_entry **find_entry( pj_pool_t *pool, pj_hash_table_t *ht, 
-                                   const void *key, unsigned keylen,
-                                   void *val, pj_uint32_t *hval,
-                                   void *entry_buf, pj_bool_t lower)
+/* Get the hash value of the key, using the value in hval if it is
+ * given and not zero, and resolve PJ_HASH_KEY_STRING key length.
+ */
+static pj_uint32_t get_hash( const void *key, unsigned *keylen,
+                             pj_uint32_t *hval, pj_bool_t lower)
 {
     pj_uint32_t hash;
-    pj_hash_entry **p_entry, *entry;
+
+    if (*keylen==PJ_HASH_KEY_STRING) {
+        *keylen = (unsigned)pj_ansi_strlen((const char*)key);
+    }
 
     if (hval && *hval != 0) {
         hash = *hval;
-        if (keylen==PJ_HASH_KEY_STRING) {
-            keylen = (unsigned)pj_ansi_strlen((const char*)key);
-        }
     } else {
-        /* This slightly differs with pj_hash_calc() because we need 
-         * to get the keylen when keylen is PJ_HASH_KEY_STRING.
-         */
-        hash=0;
-        if (keylen==PJ_HASH_KEY_STRING) {
-            const pj_uint8_t *p = (const pj_uint8_t*)key;
-            for ( ; *p; ++p ) {
-                if (lower)
-                    hash = hash * PJ_HASH_MULTIPLIER + pj_tolower(*p);
-                else 
-                    hash = hash * PJ_HASH_MULTIPLIER + *p;
-            }
-            keylen = (unsigned)(p - (const unsigned char*)key);
-        } else {
-            const pj_uint8_t *p = (const pj_uint8_t*)key,
-                                  *end = p + keylen;
-            for ( ; p!=end; ++p) {
-                if (lower)
-                    hash = hash * PJ_HASH_MULTIPLIER + pj_tolower(*p);
-                else
-                    hash = hash * PJ_HASH_MULTIPLIER + *p;
-            }
-        }
+        hash = calc_hash(0, (const pj_uint8_t*)key, *keylen, lower, NULL);
 
         /* Report back the computed hash. */
         if (hval)
             *hval = hash;
     }
 
+    return hash;
+}
+
+static pj_bool_t key_equal( const pj_hash_entry *entry,
+                            const void *key, unsigned keylen,
+                            pj_uint32_t hash, pj_bool_t lower)
+{
+    return entry->hash==hash && entry->keylen==keylen &&
+           ((lower && pj_ansi_strnicmp((const char*)entry->key,
+                                       (const char*)key, keylen)==0) ||
+            (!lower && pj_memcmp(entry->key, key, keylen)==0));
+}
+
+static pj_hash_entry **find_entry( pj_pool_t *pool, pj_hash_table_t *ht, 
+                                   const void *key, unsigned keylen,
+                                   void *val, pj_uint32_t *hval,
+                                   void *entry_buf, pj_bool_t lower)
+{
+    pj_uint32_t hash;
+    pj_hash_entry **p_entry, *entry;
+
+    hash = get_hash(key, &keylen, hval, lower);
+
     /* scan the linked list */
     for (p_entry = &ht->table[hash & ht->rows], entry=*p_entry; 
          entry; 
          p_entry = &entry->next, entry = *p_entry)
     {
-        if (entry->hash==hash && entry->keylen==keylen &&
-            ((lower && pj_ansi_strnicmp((const char*)entry->key,
-                                        (const char*)key, keylen)==0) ||
-             (!lower && pj_memcmp(entry->key, key, keylen)==0)))
-        {
+        if (key_equal(entry, key, keylen, hash, lower))
             break;
-        }
     }
 
     if (entry || val==NULL)
@@ -208,11 +368,290 @@ static pj_hash_entry **find_entry( pj_pool_t *pool, pj_hash_table_t *ht,
     return p_entry;
 }
 
+/* Spread the bits of the hash value, since the classic pj_hash_calc()
+ * (and hash values supplied by the application) may leave the high bits
+ * of short keys mostly unused.
+ */
+static pj_uint32_t oa_mix(pj_uint32_t h)
+{
+    h ^= h >> 16;
+    h *= 0x85EBCA6B;
+    h ^= h >> 13;
+    h *= 0xC2B2AE35;
+    h ^= h >> 16;
+    return h;
+}
+
+/* Load the control bytes of a group, first slot in the lowest byte. */
+static pj_uint64_t oa_load_group(const pj_uint8_t *ctrl)
+{
+    pj_uint64_t g;
+
+#if defined(PJ_IS_LITTLE_ENDIAN) && PJ_IS_LITTLE_ENDIAN!=0
+    pj_memcpy(&g, ctrl, sizeof(g));
+#else
+    int i;
+
+    for (g=0, i=OA_GROUP-1; i>=0; --i)
+        g = (g << 8) | ctrl[i];
+#endif
+    return g;
+}
+
+/* Slots in the group whose control byte may be h2. There may be false
+ * positives, so the control byte must still be checked.
+ */
+static pj_uint64_t oa_match(pj_uint64_t g, pj_uint8_t h2)
+{
+    pj_uint64_t x = g ^ (OA_LSBS * h2);
+    return (x - OA_LSBS) & ~x & OA_MSBS;
+}
+
+/* Slots in the group which are empty */
+static pj_uint64_t oa_match_empty(pj_uint64_t g)
+{
+    return g & ~(g << 6) & OA_MSBS;
+}
+
+/* Find the slot of the key, or return -1. */
+static int oa_find( const pj_hash_table_t *ht,
+                    const void *key, unsigned keylen,
+                    pj_uint32_t hash, pj_bool_t lower)
+{
+    pj_uint32_t mix = oa_mix(hash);
+    pj_uint8_t h2 = (pj_uint8_t)(mix & 0x7F);
+    unsigned gmask = ht->rows / OA_GROUP;
+    unsigned g = (mix >> 7) & gmask;
+    unsigned step = 0;
+
+    for (;;) {
+        pj_uint64_t grp = oa_load_group(ht->ctrl + g * OA_GROUP);
+        pj_uint64_t m;
+
+        for (m = oa_match(grp, h2); m; m &= m - 1) {
+            unsigned i = g * OA_GROUP + OA_FIRST(m);
+            if (ht->ctrl[i] == h2 &&
+                key_equal(&ht->slots[i], key, keylen, hash, lower))
+            {
+                return (int)i;
+            }
+        }
+
+        if (oa_match_empty(grp) || step > gmask)
+            return -1;
+
+        g = (g + ++step) & gmask;
+    }
+}
+
+/* Find the first empty or deleted slot for the hash. */
+static unsigned oa_find_free(const pj_uint8_t *ctrl, unsigned gmask,
+                             pj_uint32_t mix)
+{
+    unsigned g = (mix >> 7) & gmask;
+    unsigned step = 0;
+
+    for (;;) {
+        pj_uint64_t m = oa_load_group(ctrl + g * OA_GROUP) & OA_MSBS;
+        if (m)
+            return g * OA_GROUP + OA_FIRST(m);
+
+        g = (g + ++step) & gmask;
+    }
+}
+
+/* Reinsert all entries into new arrays of the capacity. When the table
+ * grows, the old arrays stay in the pool until the pool is released; the
+ * doubling keeps their total below the size of the current arrays. A
+ * rehash which only removes deleted slots (same capacity) keeps the old
+ * arrays as spare and uses them for the next such rehash, so that insert
+ * and erase churn does not use more memory from the pool.
+ */
+static pj_bool_t oa_resize(pj_hash_table_t *ht, unsigned capacity)
+{
+    pj_uint8_t *ctrl;
+    pj_hash_entry *slots;
+    pj_bool_t same = ht->ctrl && capacity == ht->rows + 1;
+    unsigned i, gmask = capacity / OA_GROUP - 1;
+
+    if (same && ht->spare_ctrl) {
+        ctrl = ht->spare_ctrl;
+        slots = ht->spare_slots;
+    } else {
+        ctrl = (pj_uint8_t*) pj_pool_alloc(ht->pool, capacity);
+        slots = (pj_hash_entry*)
+                pj_pool_alloc(ht->pool, capacity * sizeof(pj_hash_entry));
+        if (!ctrl || !slots)
+            return PJ_FALSE;
+    }
+
+    pj_memset(ctrl, OA_EMPTY, capacity);
+
+    if (ht->ctrl) {
+        for (i=0; i<=ht->rows; ++i) {
+            if (ht->ctrl[i] < OA_EMPTY) {
+                pj_uint32_t mix = oa_mix(ht->slots[i].hash);
+                unsigned idx = oa_find_free(ctrl, gmask, mix);
+
+                ctrl[idx] = (pj_uint8_t)(mix & 0x7F);
+                slots[idx] = ht->slots[i];
+            }
+        }
+    }
+
+    PJ_LOG(6, ("hashtbl", "%p: resized from %u to %u slots, count=%u", ht,
+               ht->ctrl ? ht->rows+1 : 0, capacity, ht->count));
+
+    if (same) {
+        ht->spare_ctrl = ht->ctrl;
+        ht->spare_slots = ht->slots;
+    } else {
+        ht->spare_ctrl = NULL;
+        ht->spare_slots = NULL;
+    }
+
+    ht->ctrl = ctrl;
+    ht->slots = slots;
+    ht->rows = capacity - 1;
+    ht->growth_left = OA_MAX_LOAD(capacity) - ht->count;
+
+    return PJ_TRUE;
+}
+
+/* Claim a slot for a new entry with the hash, growing the table if needed */
+static pj_hash_entry *oa_insert(pj_hash_table_t *ht, pj_uint32_t hash)
+{
+    pj_uint32_t mix = oa_mix(hash);
+    unsigned idx;
+
+    idx = oa_find_free(ht->ctrl, ht->rows / OA_GROUP, mix);
+    if (ht->ctrl[idx] == OA_EMPTY && ht->growth_left == 0) {
+        unsigned capacity = ht->rows + 1;
+
+        /* Only grow if the load is not mostly deleted slots */
+        if (ht->count >= OA_MAX_LOAD(capacity) / 2)
+            capacity *= 2;
+
+        if (!oa_resize(ht, capacity))
+            return NULL;
+
+        idx = oa_find_free(ht->ctrl, ht->rows / OA_GROUP, mix);
+    }
+
+    if (ht->ctrl[idx] == OA_EMPTY)
+        --ht->growth_left;
+    ht->ctrl[idx] = (pj_uint8_t)(mix & 0x7F);
+
+    return &ht->slots[idx];
+}
+
+static void oa_erase(pj_hash_table_t *ht, unsigned idx)
+{
+    unsigned g = idx / OA_GROUP;
+
+    /* A probe never continues past a group which has an empty slot, so
+     * if the group already has one the slot can be made empty again.
+     */
+    if (oa_match_empty(oa_load_group(ht->ctrl + g * OA_GROUP))) {
+        ht->ctrl[idx] = OA_EMPTY;
+        ++ht->growth_left;
+    } else {
+        ht->ctrl[idx] = OA_DELETED;
+    }
+    --ht->count;
+}
+
+static void *oa_get( pj_hash_table_t *ht, const void *key, unsigned keylen,
+                     pj_uint32_t *hval, pj_bool_t lower)
+{
+    pj_uint32_t hash;
+    int idx;
+
+    hash = get_hash(key, &keylen, hval, lower);
+    idx = oa_find(ht, key, keylen, hash, lower);
+    return idx < 0 ? NULL : ht->slots[idx].value;
+}
+
+static void oa_set( pj_pool_t *pool, pj_hash_table_t *ht,
+                    const void *key, unsigned keylen, pj_uint32_t hval,
+                    void *value, pj_bool_t lower )
+{
+    pj_hash_entry *entry;
+    pj_uint32_t hash;
+    int idx;
+
+    hash = get_hash(key, &keylen, &hval, lower);
+    idx = oa_find(ht, key, keylen, hash, lower);
+
+    if (idx >= 0) {
+        if (value == NULL) {
+            PJ_LOG(6, ("hashtbl", "%p: slot %d deleted", ht, idx));
+            oa_erase(ht, idx);
+        } else {
+            ht->slots[idx].value = value;
+            PJ_LOG(6, ("hashtbl", "%p: slot %d value set to %p", ht, idx,
+                       value));
+        }
+        return;
+    }
+
+    if (value == NULL)
+        return;
+
+    entry = oa_insert(ht, hash);
+    if (!entry) {
+        PJ_LOG(2, ("hashtbl", "%p: unable to grow hash table, count=%u",
+                   ht, ht->count));
+        pj_assert(!"Unable to grow hash table");
+        return;
+    }
+
+    entry->next = NULL;
+    entry->hash = hash;
+    if (pool) {
+        entry->key = pj_pool_alloc(pool, keylen);
+        pj_memcpy(entry->key, key, keylen);
+    } else {
+        entry->key = (void*)key;
+    }
+    entry->keylen = keylen;
+    entry->value = value;
+
+    ++ht->count;
+}
+
+PJ_DEF(pj_hash_table_t*) pj_hash_create_oa(pj_pool_t *pool, unsigned size)
+{
+    pj_hash_table_t *h;
+    unsigned capacity;
+
+    PJ_ASSERT_RETURN(pool, NULL);
+
+    h = PJ_POOL_ZALLOC_T(pool, pj_hash_table_t);
+    h->pool = pool;
+
+    /* Make room for size entries without growing */
+    capacity = OA_MIN_SIZE;
+    while (OA_MAX_LOAD(capacity) < size)
+        capacity <<= 1;
+
+    if (!oa_resize(h, capacity))
+        return NULL;
+
+    PJ_LOG( 6, ("hashtbl", "open addressing hash table %p created from "
+                "pool %s", h, pj_pool_getobjname(pool)));
+    return h;
+}
+
 PJ_DEF(void *) pj_hash_get( pj_hash_table_t *ht,
                             const void *key, unsigned keylen,
                             pj_uint32_t *hval)
 {
     pj_hash_entry *entry;
+
+    if (ht->ctrl)
+        return oa_get(ht, key, keylen, hval, PJ_FALSE);
+
     entry = *find_entry( NULL, ht, key, keylen, NULL, hval, NULL, PJ_FALSE);
     return entry ? entry->value : NULL;
 }
@@ -222,6 +661,10 @@ PJ_DEF(void *) pj_hash_get_lower( pj_hash_table_t *ht,
                                   pj_uint32_t *hval)
 {
     pj_hash_entry *entry;
+
+    if (ht->ctrl)
+        return oa_get(ht, key, keylen, hval, PJ_TRUE);
+
     entry = *find_entry( NULL, ht, key, keylen, NULL, hval, NULL, PJ_TRUE);
     return entry ? entry->value : NULL;
 }
@@ -232,6 +675,11 @@ static void hash_set( pj_pool_t *pool, pj_hash_table_t *ht,
 {
     pj_hash_entry **p_entry;
 
+    if (ht->ctrl) {
+        oa_set(pool, ht, key, keylen, hval, value, lower);
+        return;
+    }
+
     p_entry = find_entry( pool, ht, key, keylen, value, &hval, entry_buf,
                           lower);
     if (*p_entry) {
@@ -286,12 +734,30 @@ PJ_DEF(unsigned) pj_hash_count( pj_hash_table_t *ht )
     return ht->count;
 }
 
+/* Find the next used slot starting from it->index */
+static pj_hash_iterator_t *oa_iterate( pj_hash_table_t *ht,
+                                       pj_hash_iterator_t *it )
+{
+    for (; it->index <= ht->rows; ++it->index) {
+        if (ht->ctrl[it->index] < OA_EMPTY) {
+            it->entry = &ht->slots[it->index];
+            return it;
+        }
+    }
+
+    it->entry = NULL;
+    return NULL;
+}
+
 PJ_DEF(pj_hash_iterator_t*) pj_hash_first( pj_hash_table_t *ht,
                                            pj_hash_iterator_t *it )
 {
     it->index = 0;
     it->entry = NULL;
 
+    if (ht->ctrl)
+        return oa_iterate(ht, it);
+
     for (; it->index <= ht->rows; ++it->index) {
         it->entry = ht->table[it->index];
         if (it->entry) {
@@ -305,6 +771,11 @@ PJ_DEF(pj_hash_iterator_t*) pj_hash_first( pj_hash_table_t *ht,
 PJ_DEF(pj_hash_iterator_t*) pj_hash_next( pj_hash_table_t *ht, 
                                           pj_hash_iterator_t *it )
 {
+    if (ht->ctrl) {
+        ++it->index;
+        return oa_iterate(ht, it);
+    }
+
     it->entry = it->entry->next;
     if (it->entry) {
         return it;
@@ -1114,6 +1114,36 @@ retry_on_restart:
     return PJ_EPENDING;
 }
 
+/*
+ * pj_ioqueue_sendto_batch()
+ *
+ * Send several datagrams immediately.
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_sendto_batch( pj_ioqueue_key_t *key,
+                                             pj_sock_mmsg msgs[],
+                                             unsigned *count,
+                                             pj_uint32_t flags)
+{
+    PJ_ASSERT_RETURN(key && msgs && count && *count, PJ_EINVAL);
+    PJ_CHECK_STACK();
+
+    /* Check if key is closing. */
+    if (IS_CLOSING(key))
+        return PJ_ECANCELLED;
+
+    flags &= ~(PJ_IOQUEUE_ALWAYS_ASYNC);
+
+    /* Don't overtake pending writes (see the note in pj_ioqueue_sendto()
+     * about checking the list without the lock).
+     */
+    if (!pj_list_empty(&key->write_list)) {
+        *count = 0;
+        return PJ_EBUSY;
+    }
+
+    return pj_sock_sendmmsg(key->fd, msgs, count, flags);
+}
+
 #if PJ_HAS_TCP
 /*
  * Initiate overlapped accept() operation.
@@ -35,6 +35,7 @@
 #include <pj/sock.h>
 #include <pj/compat/socket.h>
 #include <pj/rand.h>
+#include <pj/trace.h>
 
 #include <sys/epoll.h>
 #include <sys/eventfd.h>
@@ -992,6 +993,7 @@ PJ_DEF(int) pj_ioqueue_poll( pj_ioqueue_t *ioqueue, const pj_time_val *timeout)
     processed_cnt = 0;
 
     /* Now process the events. */
+    PJ_TRACE_BEGIN("ioqueue", "dispatch");
     for (i=0; i<event_cnt; ++i) {
         /* Just do not exceed PJ_IOQUEUE_MAX_EVENTS_IN_SINGLE_POLL */
         if (processed_cnt < PJ_IOQUEUE_MAX_EVENTS_IN_SINGLE_POLL) {
@@ -1047,6 +1049,7 @@ PJ_DEF(int) pj_ioqueue_poll( pj_ioqueue_t *ioqueue, const pj_time_val *timeout)
             pj_grp_lock_dec_ref_dbg(queue[i].key->grp_lock,
                                     "ioqueue", 0);
     }
+    PJ_TRACE_END("ioqueue", "dispatch");
 
     /* Special case:
      * When epoll returns > 0 but event_cnt, the number of events
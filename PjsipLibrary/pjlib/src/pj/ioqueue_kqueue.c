@@ -31,6 +31,7 @@
 #include <pj/pool.h>
 #include <pj/sock.h>
 #include <pj/string.h>
+#include <pj/trace.h>
 
 #include <sys/event.h>
 
@@ -676,6 +677,7 @@ PJ_DEF(int) pj_ioqueue_poll(pj_ioqueue_t *ioqueue, const pj_time_val *timeout)
     processed_cnt = 0;
 
     /* Now process the events. */
+    PJ_TRACE_BEGIN("ioqueue", "dispatch");
     for (i = 0; i < event_cnt; ++i) {
 
         /* Just do not exceed PJ_IOQUEUE_MAX_EVENTS_IN_SINGLE_POLL */
@@ -705,6 +707,7 @@ PJ_DEF(int) pj_ioqueue_poll(pj_ioqueue_t *ioqueue, const pj_time_val *timeout)
         if (queue[i].key->grp_lock)
             pj_grp_lock_dec_ref_dbg(queue[i].key->grp_lock, "ioqueue", 0);
     }
+    PJ_TRACE_END("ioqueue", "dispatch");
 
     if (!event_cnt) {
         /* We need to sleep in order to avoid busy polling.
@@ -39,6 +39,7 @@
 #include <pj/sock_qos.h>
 #include <pj/errno.h>
 #include <pj/rand.h>
+#include <pj/trace.h>
 
 /* Now that we have access to OS'es <sys/select>, lets check again that
  * PJ_IOQUEUE_MAX_HANDLES is not greater than FD_SETSIZE
@@ -1099,6 +1100,7 @@ PJ_DEF(int) pj_ioqueue_poll( pj_ioqueue_t *ioqueue, const pj_time_val *timeout)
     /* Now process all events. The dispatch functions will take care
      * of locking in each of the key
      */
+    PJ_TRACE_BEGIN("ioqueue", "dispatch");
     for (i=0; i<event_cnt; ++i) {
 
         /* Just do not exceed PJ_IOQUEUE_MAX_EVENTS_IN_SINGLE_POLL */
@@ -1130,6 +1132,7 @@ PJ_DEF(int) pj_ioqueue_poll( pj_ioqueue_t *ioqueue, const pj_time_val *timeout)
             pj_grp_lock_dec_ref_dbg(event[i].key->grp_lock,
                                     "ioqueue", 0);
     }
+    PJ_TRACE_END("ioqueue", "dispatch");
 
     TRACE__((THIS_FILE, "     poll: count=%d events=%d processed=%d",
              count, event_cnt, processed_cnt));
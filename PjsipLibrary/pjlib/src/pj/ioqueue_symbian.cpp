@@ -841,6 +841,33 @@ PJ_DEF(pj_status_t) pj_ioqueue_sendto( pj_ioqueue_key_t *key,
     return PJ_SUCCESS;
 }
 
+/*
+ * Send several datagrams immediately.
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_sendto_batch( pj_ioqueue_key_t *key,
+                                             pj_sock_mmsg msgs[],
+                                             unsigned *count,
+                                             pj_uint32_t flags)
+{
+    unsigned i;
+    pj_status_t status = PJ_SUCCESS;
+
+    PJ_ASSERT_RETURN(key && msgs && count && *count, PJ_EINVAL);
+
+    flags &= ~PJ_IOQUEUE_ALWAYS_ASYNC;
+
+    for (i=0; i<*count; ++i) {
+        msgs[i].len = (pj_ssize_t)msgs[i].size;
+        status = pj_ioqueue_sendto(key, NULL, msgs[i].buf, &msgs[i].len,
+                                   flags, &msgs[i].addr, msgs[i].addr_len);
+        if (status != PJ_SUCCESS)
+            break;
+    }
+
+    *count = i;
+    return (i > 0) ? PJ_SUCCESS : status;
+}
+
 PJ_DEF(pj_status_t) pj_ioqueue_set_concurrency(pj_ioqueue_key_t *key,
                                                                                            pj_bool_t allow)
 {
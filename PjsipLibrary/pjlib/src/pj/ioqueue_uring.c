@@ -0,0 +1,2242 @@
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+/*
+ * ioqueue_uring.c
+ *
+ * This is the implementation of IOQueue framework using Linux io_uring.
+ *
+ * Unlike the select/epoll backends, which emulate the proactor pattern on
+ * top of readiness notification (see ioqueue_common_abs.c), this backend
+ * is a true proactor: the socket operations themselves are submitted to
+ * the kernel and the ioqueue only reaps their completions. Submissions
+ * queued by callbacks are flushed together with the next wait, and many
+ * completions are reaped per io_uring_enter() call, so in steady state a
+ * received packet does not cost a readiness wakeup plus a recvfrom()
+ * syscall of its own.
+ *
+ * The ring is driven with raw syscalls, so liburing is not needed. Kernel
+ * 6.0 or later is required (IORING_FEAT_EXT_ARG for the timed wait, and
+ * IORING_REGISTER_SYNC_CANCEL for unregistering a key while the kernel
+ * still has operations on the application's buffers).
+ */
+
+#include <pj/ioqueue.h>
+#include <pj/os.h>
+#include <pj/lock.h>
+#include <pj/log.h>
+#include <pj/list.h>
+#include <pj/pool.h>
+#include <pj/string.h>
+#include <pj/assert.h>
+#include <pj/errno.h>
+#include <pj/sock.h>
+#include <pj/compat/socket.h>
+#include <pj/trace.h>
+
+#include <linux/io_uring.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <poll.h>
+#include <signal.h>
+#include <errno.h>
+#include <unistd.h>
+
+#define THIS_FILE   "ioq_uring"
+
+//#define TRACE_(expr) PJ_LOG(3,expr)
+#define TRACE_(expr)
+
+#if PJ_RETURN_OS_ERROR(100) != PJ_STATUS_FROM_OS(100)
+#   error "Proper error reporting must be enabled for ioqueue to work!"
+#endif
+
+#if !defined(IORING_FEAT_EXT_ARG) || !defined(IORING_ASYNC_CANCEL_FD_FIXED)
+#   error "io_uring ioqueue requires Linux 6.0 or newer kernel headers"
+#endif
+
+#ifndef __NR_io_uring_setup
+#   define __NR_io_uring_setup  425
+#endif
+#ifndef __NR_io_uring_enter
+#   define __NR_io_uring_enter  426
+#endif
+#ifndef __NR_io_uring_register
+#   define __NR_io_uring_register 427
+#endif
+
+#ifdef MSG_NOSIGNAL
+#   define SEND_FLAGS   MSG_NOSIGNAL
+#else
+#   define SEND_FLAGS   0
+#endif
+
+#define PENDING_RETRY   2
+
+/*
+ * One asynchronous operation in flight (or waiting to be submitted).
+ * The records are owned by the ioqueue rather than overlaid on the
+ * application's pj_ioqueue_op_key_t, because the kernel may still post a
+ * completion for an operation after its key has been unregistered.
+ */
+struct uring_op
+{
+    PJ_DECL_LIST_MEMBER(struct uring_op);
+    pj_ioqueue_operation_e  op;
+
+    pj_ioqueue_key_t       *key;        /* NULL when detached.           */
+    pj_ioqueue_op_key_t    *op_key;
+    pj_bool_t               submitted;
+
+    char                   *buf;
+    pj_size_t               size;
+    pj_size_t               written;
+    unsigned                flags;
+
+    pj_sockaddr_t          *rmt_addr;   /* recvfrom()/accept() storage.  */
+    int                    *rmt_addrlen;
+    pj_sock_t              *accept_fd;
+    pj_sockaddr_t          *local_addr;
+    socklen_t               sock_addrlen;
+    pj_sockaddr             dst_addr;   /* sendto() destination copy.    */
+
+    struct msghdr           msg;
+    struct iovec            iov;
+};
+
+#if PJ_IOQUEUE_HAS_SAFE_UNREG
+#   define IS_CLOSING(key)  (key->closing)
+#else
+#   define IS_CLOSING(key)  (0)
+#endif
+
+/*
+ * This describes each key.
+ */
+struct pj_ioqueue_key_t
+{
+    PJ_DECL_LIST_MEMBER(struct pj_ioqueue_key_t);
+    pj_ioqueue_t           *ioqueue;
+    pj_grp_lock_t          *grp_lock;
+    pj_lock_t              *lock;
+    pj_bool_t               allow_concurrent;
+    pj_sock_t               fd;
+    int                     fd_type;
+    void                   *user_data;
+    pj_ioqueue_callback     cb;
+
+    struct uring_op         inflight;       /* Submitted to the kernel.   */
+    struct uring_op         read_queue;     /* Stream reads waiting.      */
+    struct uring_op         write_queue;    /* Writes waiting.            */
+    pj_bool_t               read_busy;      /* Stream read in flight.     */
+    unsigned                write_cnt;      /* Writes in flight.          */
+    unsigned                accept_cnt;     /* Accepts in flight.         */
+    struct uring_op        *connect_op;
+
+#if PJ_IOQUEUE_HAS_SAFE_UNREG
+    unsigned                ref_count;
+    pj_bool_t               closing;
+    pj_time_val             free_time;
+#endif
+};
+
+/*
+ * Submission queue.
+ */
+struct uring_sq
+{
+    unsigned               *khead;
+    unsigned               *ktail;
+    unsigned               *array;
+    struct io_uring_sqe    *sqes;
+    unsigned                tail;
+    unsigned                mask;
+    unsigned                entries;
+    void                   *ring_ptr;
+    pj_size_t               ring_sz;
+    pj_size_t               sqes_sz;
+};
+
+/*
+ * Completion queue.
+ */
+struct uring_cq
+{
+    unsigned               *khead;
+    unsigned               *ktail;
+    struct io_uring_cqe    *cqes;
+    unsigned                mask;
+    void                   *ring_ptr;
+    pj_size_t               ring_sz;
+};
+
+/*
+ * This describes the I/O queue.
+ */
+struct pj_ioqueue_t
+{
+    pj_lock_t          *lock;
+    pj_bool_t           auto_delete_lock;
+    pj_ioqueue_cfg      cfg;
+
+    unsigned            max, count;
+    pj_ioqueue_key_t    active_list;
+
+    int                 ring_fd;
+    struct uring_sq     sq;
+    struct uring_cq     cq;
+
+    pj_pool_t          *op_pool;
+    struct uring_op     free_ops;
+    long                dispatch_tls;
+
+#if PJ_IOQUEUE_HAS_SAFE_UNREG
+    pj_ioqueue_key_t    closing_list;
+    pj_ioqueue_key_t    free_list;
+#endif
+};
+
+/*
+ * Completion reaped from the ring, to be reported to application after
+ * ioqueue's lock is released.
+ */
+struct uring_event
+{
+    pj_ioqueue_key_t       *key;
+    pj_ioqueue_op_key_t    *op_key;
+    pj_ioqueue_operation_e  op;
+    pj_ssize_t              bytes;
+    pj_sock_t               new_sock;
+    pj_status_t             status;
+};
+
+#if PJ_IOQUEUE_HAS_SAFE_UNREG
+/* Scan closing keys to be put to free list again */
+static void scan_closing_keys(pj_ioqueue_t *ioqueue);
+#endif
+
+
+static int sys_io_uring_setup(unsigned entries, struct io_uring_params *p)
+{
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int sys_io_uring_enter(int fd, unsigned to_submit,
+                              unsigned min_complete, unsigned flags,
+                              void *arg, pj_size_t argsz)
+{
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete,
+                        flags, arg, argsz);
+}
+
+static int sys_io_uring_register(int fd, unsigned opcode, void *arg,
+                                 unsigned nr_args)
+{
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+/*
+ * Create the ring and map its queues.
+ */
+static pj_status_t ring_create(pj_ioqueue_t *ioqueue, unsigned entries)
+{
+    struct io_uring_params p;
+    struct uring_sq *sq = &ioqueue->sq;
+    struct uring_cq *cq = &ioqueue->cq;
+    char *sq_ptr, *cq_ptr;
+    pj_status_t status;
+
+    pj_bzero(&p, sizeof(p));
+    ioqueue->ring_fd = sys_io_uring_setup(entries, &p);
+    if (ioqueue->ring_fd < 0) {
+        ioqueue->ring_fd = -1;
+        return PJ_RETURN_OS_ERROR(errno);
+    }
+
+    /* The timed wait in pj_ioqueue_poll() needs IORING_ENTER_EXT_ARG,
+     * and we may have more operations in flight than CQ entries.
+     */
+    if ((p.features & IORING_FEAT_EXT_ARG) == 0 ||
+        (p.features & IORING_FEAT_NODROP) == 0)
+    {
+        status = PJ_ENOTSUP;
+        goto on_error;
+    }
+
+    /* Unregistration needs the synchronous cancel, which finds nothing
+     * to cancel here rather than failing with EINVAL.
+     */
+    {
+        struct io_uring_sync_cancel_reg reg;
+
+        pj_bzero(&reg, sizeof(reg));
+        reg.fd = -1;
+        reg.timeout.tv_sec = -1;
+        reg.timeout.tv_nsec = -1;
+        if (sys_io_uring_register(ioqueue->ring_fd,
+                                  IORING_REGISTER_SYNC_CANCEL,
+                                  &reg, 1) < 0 && errno != ENOENT)
+        {
+            status = PJ_ENOTSUP;
+            goto on_error;
+        }
+    }
+
+    sq->ring_sz = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    cq->ring_sz = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        if (cq->ring_sz > sq->ring_sz)
+            sq->ring_sz = cq->ring_sz;
+        cq->ring_sz = 0;
+    }
+
+    sq->ring_ptr = mmap(NULL, sq->ring_sz, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, ioqueue->ring_fd,
+                        IORING_OFF_SQ_RING);
+    if (sq->ring_ptr == MAP_FAILED) {
+        sq->ring_ptr = NULL;
+        status = PJ_RETURN_OS_ERROR(errno);
+        goto on_error;
+    }
+
+    if (cq->ring_sz) {
+        cq->ring_ptr = mmap(NULL, cq->ring_sz, PROT_READ | PROT_WRITE,
+                            MAP_SHARED | MAP_POPULATE, ioqueue->ring_fd,
+                            IORING_OFF_CQ_RING);
+        if (cq->ring_ptr == MAP_FAILED) {
+            cq->ring_ptr = NULL;
+            status = PJ_RETURN_OS_ERROR(errno);
+            goto on_error;
+        }
+    } else {
+        cq->ring_ptr = sq->ring_ptr;
+    }
+
+    sq->sqes_sz = p.sq_entries * sizeof(struct io_uring_sqe);
+    sq->sqes = (struct io_uring_sqe*)
+               mmap(NULL, sq->sqes_sz, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, ioqueue->ring_fd,
+                    IORING_OFF_SQES);
+    if (sq->sqes == MAP_FAILED) {
+        sq->sqes = NULL;
+        status = PJ_RETURN_OS_ERROR(errno);
+        goto on_error;
+    }
+
+    sq_ptr = (char*)sq->ring_ptr;
+    sq->khead = (unsigned*)(sq_ptr + p.sq_off.head);
+    sq->ktail = (unsigned*)(sq_ptr + p.sq_off.tail);
+    sq->array = (unsigned*)(sq_ptr + p.sq_off.array);
+    sq->mask = *(unsigned*)(sq_ptr + p.sq_off.ring_mask);
+    sq->entries = *(unsigned*)(sq_ptr + p.sq_off.ring_entries);
+    sq->tail = *sq->ktail;
+
+    cq_ptr = (char*)cq->ring_ptr;
+    cq->khead = (unsigned*)(cq_ptr + p.cq_off.head);
+    cq->ktail = (unsigned*)(cq_ptr + p.cq_off.tail);
+    cq->cqes = (struct io_uring_cqe*)(cq_ptr + p.cq_off.cqes);
+    cq->mask = *(unsigned*)(cq_ptr + p.cq_off.ring_mask);
+
+    return PJ_SUCCESS;
+
+on_error:
+    if (sq->sqes)
+        munmap(sq->sqes, sq->sqes_sz);
+    if (cq->ring_ptr && cq->ring_ptr != sq->ring_ptr)
+        munmap(cq->ring_ptr, cq->ring_sz);
+    if (sq->ring_ptr)
+        munmap(sq->ring_ptr, sq->ring_sz);
+    close(ioqueue->ring_fd);
+    ioqueue->ring_fd = -1;
+    return status;
+}
+
+static void ring_destroy(pj_ioqueue_t *ioqueue)
+{
+    struct uring_sq *sq = &ioqueue->sq;
+    struct uring_cq *cq = &ioqueue->cq;
+
+    munmap(sq->sqes, sq->sqes_sz);
+    if (cq->ring_ptr != sq->ring_ptr)
+        munmap(cq->ring_ptr, cq->ring_sz);
+    munmap(sq->ring_ptr, sq->ring_sz);
+    close(ioqueue->ring_fd);
+    ioqueue->ring_fd = -1;
+}
+
+/*
+ * Hand the queued SQEs to the kernel. Must be called with ioqueue's lock.
+ */
+static void ring_submit(pj_ioqueue_t *ioqueue)
+{
+    unsigned pending;
+    int rc;
+
+    pending = ioqueue->sq.tail - __atomic_load_n(ioqueue->sq.khead,
+                                                 __ATOMIC_ACQUIRE);
+    while (pending) {
+        rc = sys_io_uring_enter(ioqueue->ring_fd, pending, 0, 0, NULL, 0);
+        if (rc < 0) {
+            if (errno == EINTR)
+                continue;
+            /* EBUSY/EAGAIN: the kernel is short of resources; the
+             * entries stay in the ring and will be submitted on the
+             * next attempt.
+             */
+            TRACE_((THIS_FILE, "io_uring_enter() submit error %d", errno));
+            break;
+        }
+        if ((unsigned)rc >= pending)
+            break;
+        pending -= rc;
+    }
+}
+
+/*
+ * Get a free SQE. Must be called with ioqueue's lock. The entry is
+ * published to the kernel by ring_commit().
+ */
+static struct io_uring_sqe *ring_get_sqe(pj_ioqueue_t *ioqueue)
+{
+    struct uring_sq *sq = &ioqueue->sq;
+    struct io_uring_sqe *sqe;
+
+    if (sq->tail - __atomic_load_n(sq->khead, __ATOMIC_ACQUIRE) >=
+        sq->entries)
+    {
+        ring_submit(ioqueue);
+        if (sq->tail - __atomic_load_n(sq->khead, __ATOMIC_ACQUIRE) >=
+            sq->entries)
+        {
+            return NULL;
+        }
+    }
+
+    sqe = &sq->sqes[sq->tail & sq->mask];
+    pj_bzero(sqe, sizeof(*sqe));
+    return sqe;
+}
+
+static void ring_commit(pj_ioqueue_t *ioqueue)
+{
+    struct uring_sq *sq = &ioqueue->sq;
+
+    sq->array[sq->tail & sq->mask] = sq->tail & sq->mask;
+    ++sq->tail;
+    __atomic_store_n(sq->ktail, sq->tail, __ATOMIC_RELEASE);
+}
+
+/* Are we inside pj_ioqueue_poll() callback dispatching? If so, the
+ * submission is left in the ring and flushed when the dispatch is done.
+ */
+static pj_bool_t is_dispatching(pj_ioqueue_t *ioqueue)
+{
+    return pj_thread_local_get(ioqueue->dispatch_tls) == ioqueue;
+}
+
+/*
+ * Get operation record. Must be called with ioqueue's lock.
+ */
+static struct uring_op *alloc_op(pj_ioqueue_t *ioqueue)
+{
+    struct uring_op *op;
+
+    if (!pj_list_empty(&ioqueue->free_ops)) {
+        op = ioqueue->free_ops.next;
+        pj_list_erase(op);
+    } else {
+        op = PJ_POOL_ALLOC_T(ioqueue->op_pool, struct uring_op);
+    }
+    pj_bzero(op, sizeof(*op));
+    return op;
+}
+
+static void free_op(pj_ioqueue_t *ioqueue, struct uring_op *op)
+{
+    op->key = NULL;
+    op->op_key = NULL;
+    op->op = PJ_IOQUEUE_OP_NONE;
+    pj_list_push_back(&ioqueue->free_ops, op);
+}
+
+/*
+ * Submit the operation to the kernel. Must be called with ioqueue's lock.
+ */
+static pj_status_t submit_op(pj_ioqueue_key_t *key, struct uring_op *op)
+{
+    pj_ioqueue_t *ioqueue = key->ioqueue;
+    struct io_uring_sqe *sqe;
+
+    sqe = ring_get_sqe(ioqueue);
+    if (!sqe)
+        return PJ_ETOOMANY;
+
+    sqe->fd = key->fd;
+    sqe->user_data = (__u64)(pj_size_t)op;
+
+    switch (op->op) {
+    case PJ_IOQUEUE_OP_RECV:
+    case PJ_IOQUEUE_OP_RECV_FROM:
+        op->iov.iov_base = op->buf;
+        op->iov.iov_len = op->size;
+        op->msg.msg_iov = &op->iov;
+        op->msg.msg_iovlen = 1;
+        if (op->op == PJ_IOQUEUE_OP_RECV_FROM && op->rmt_addr &&
+            op->rmt_addrlen)
+        {
+            op->msg.msg_name = op->rmt_addr;
+            op->msg.msg_namelen = *op->rmt_addrlen;
+        }
+        sqe->opcode = IORING_OP_RECVMSG;
+        sqe->addr = (__u64)(pj_size_t)&op->msg;
+        sqe->len = 1;
+        sqe->msg_flags = op->flags;
+        break;
+
+    case PJ_IOQUEUE_OP_SEND:
+    case PJ_IOQUEUE_OP_SEND_TO:
+        op->iov.iov_base = op->buf + op->written;
+        op->iov.iov_len = op->size - op->written;
+        op->msg.msg_iov = &op->iov;
+        op->msg.msg_iovlen = 1;
+        if (op->op == PJ_IOQUEUE_OP_SEND_TO) {
+            op->msg.msg_name = &op->dst_addr;
+            op->msg.msg_namelen = op->sock_addrlen;
+        }
+        sqe->opcode = IORING_OP_SENDMSG;
+        sqe->addr = (__u64)(pj_size_t)&op->msg;
+        sqe->len = 1;
+        sqe->msg_flags = op->flags | SEND_FLAGS;
+        break;
+
+#if PJ_HAS_TCP
+    case PJ_IOQUEUE_OP_ACCEPT:
+        sqe->opcode = IORING_OP_ACCEPT;
+        if (op->rmt_addr && op->rmt_addrlen) {
+            op->sock_addrlen = *op->rmt_addrlen;
+            sqe->addr = (__u64)(pj_size_t)op->rmt_addr;
+            sqe->addr2 = (__u64)(pj_size_t)&op->sock_addrlen;
+        }
+        break;
+
+    case PJ_IOQUEUE_OP_CONNECT:
+        /* There is no need for IORING_OP_CONNECT since connect() has
+         * been initiated already; just wait until it is writable.
+         */
+        sqe->opcode = IORING_OP_POLL_ADD;
+        sqe->poll_events = POLLOUT;
+        break;
+#endif
+
+    default:
+        pj_assert(!"Invalid operation");
+        return PJ_EBUG;
+    }
+
+    ring_commit(ioqueue);
+    op->submitted = PJ_TRUE;
+    pj_list_push_back(&key->inflight, op);
+
+    if (!is_dispatching(ioqueue))
+        ring_submit(ioqueue);
+
+    return PJ_SUCCESS;
+}
+
+/*
+ * Turn the SQE of a detached operation that the kernel has not taken from
+ * the ring yet into a no-op, which completes without touching the socket
+ * or the buffers. The SQ is only consumed by ring_submit(), so the entries
+ * are stable under ioqueue's lock. Returns PJ_FALSE if the operation is
+ * with the kernel already.
+ */
+static pj_bool_t ring_drop_unsubmitted(pj_ioqueue_t *ioqueue,
+                                       struct uring_op *op)
+{
+    struct uring_sq *sq = &ioqueue->sq;
+    unsigned head;
+
+    head = __atomic_load_n(sq->khead, __ATOMIC_ACQUIRE);
+    for (; head != sq->tail; ++head) {
+        struct io_uring_sqe *sqe = &sq->sqes[head & sq->mask];
+
+        if (sqe->user_data == (__u64)(pj_size_t)op) {
+            pj_bzero(sqe, sizeof(*sqe));
+            sqe->opcode = IORING_OP_NOP;
+            sqe->fd = -1;
+            sqe->user_data = (__u64)(pj_size_t)op;
+            return PJ_TRUE;
+        }
+    }
+
+    return PJ_FALSE;
+}
+
+/*
+ * Cancel the operations with the kernel and wait until the kernel is done
+ * with them, so that the application may free the buffers and the key as
+ * soon as we return. Their completions are still posted to the CQ, and
+ * discarded by pj_ioqueue_poll(). With op set, only that operation is
+ * cancelled, otherwise all operations on the fd. Must be called with
+ * ioqueue's lock.
+ */
+static void ring_sync_cancel(pj_ioqueue_t *ioqueue, struct uring_op *op,
+                             pj_sock_t fd)
+{
+    struct io_uring_sync_cancel_reg reg;
+    int rc;
+
+    pj_bzero(&reg, sizeof(reg));
+    if (op) {
+        reg.addr = (__u64)(pj_size_t)op;
+        reg.fd = -1;
+    } else {
+        reg.fd = (__s32)fd;
+        reg.flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+    }
+    reg.timeout.tv_sec = -1;
+    reg.timeout.tv_nsec = -1;
+
+    do {
+        rc = sys_io_uring_register(ioqueue->ring_fd,
+                                   IORING_REGISTER_SYNC_CANCEL, &reg, 1);
+    } while (rc < 0 && errno == EINTR);
+
+    /* ENOENT: the operations have completed already */
+    if (rc < 0 && errno != ENOENT) {
+        PJ_PERROR(2,(THIS_FILE, PJ_RETURN_OS_ERROR(errno),
+                     "io_uring sync cancel error"));
+    }
+}
+
+/*
+ * Detach an operation from its key and cancel it. Its completion will
+ * just be discarded. Must be called with ioqueue's lock.
+ */
+static void cancel_op(pj_ioqueue_t *ioqueue, struct uring_op *op)
+{
+    pj_list_erase(op);
+    pj_list_init(op);
+    op->key = NULL;
+    op->op_key = NULL;
+
+    if (!ring_drop_unsubmitted(ioqueue, op))
+        ring_sync_cancel(ioqueue, op, PJ_INVALID_SOCKET);
+}
+
+/*
+ * Find the pending operation of the op_key. The op_key is not used to
+ * remember it, since application may use an op_key that has not been
+ * initialized with pj_ioqueue_op_key_init(). Must be called with
+ * ioqueue's lock.
+ */
+static struct uring_op *find_op(pj_ioqueue_key_t *key,
+                                const pj_ioqueue_op_key_t *op_key)
+{
+    struct uring_op *lists[3];
+    unsigned i;
+
+    lists[0] = &key->inflight;
+    lists[1] = &key->read_queue;
+    lists[2] = &key->write_queue;
+
+    for (i = 0; i < PJ_ARRAY_SIZE(lists); ++i) {
+        struct uring_op *op = lists[i]->next;
+
+        while (op != lists[i]) {
+            if (op->op_key == op_key)
+                return op;
+            op = op->next;
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * Detach and cancel all operations of the key. Must be called with
+ * ioqueue's lock.
+ */
+static void key_cancel_all(pj_ioqueue_key_t *key)
+{
+    pj_ioqueue_t *ioqueue = key->ioqueue;
+    pj_bool_t with_kernel = PJ_FALSE;
+
+    /* Cancel the operations with the kernel with one call */
+    while (!pj_list_empty(&key->inflight)) {
+        struct uring_op *op = key->inflight.next;
+
+        pj_list_erase(op);
+        pj_list_init(op);
+        op->key = NULL;
+        op->op_key = NULL;
+
+        if (!ring_drop_unsubmitted(ioqueue, op))
+            with_kernel = PJ_TRUE;
+    }
+
+    if (with_kernel)
+        ring_sync_cancel(ioqueue, NULL, key->fd);
+
+    while (!pj_list_empty(&key->read_queue)) {
+        struct uring_op *op = key->read_queue.next;
+        pj_list_erase(op);
+        free_op(ioqueue, op);
+    }
+
+    while (!pj_list_empty(&key->write_queue)) {
+        struct uring_op *op = key->write_queue.next;
+        pj_list_erase(op);
+        free_op(ioqueue, op);
+    }
+
+    key->read_busy = PJ_FALSE;
+    key->write_cnt = 0;
+    key->accept_cnt = 0;
+    key->connect_op = NULL;
+
+    ring_submit(ioqueue);
+}
+
+/*
+ * Submit the next stream read and the writes waiting in the key's queues.
+ * Must be called with ioqueue's lock.
+ */
+static void key_kick_queues(pj_ioqueue_key_t *key)
+{
+    struct uring_op *op;
+
+    while (!pj_list_empty(&key->write_queue) &&
+           (key->write_cnt == 0 || key->fd_type == pj_SOCK_DGRAM()))
+    {
+        op = key->write_queue.next;
+        pj_list_erase(op);
+        if (submit_op(key, op) != PJ_SUCCESS) {
+            /* Ring is full, retry on the next completion */
+            pj_list_insert_after(&key->write_queue, op);
+            break;
+        }
+        ++key->write_cnt;
+    }
+
+    if (!key->read_busy && !pj_list_empty(&key->read_queue)) {
+        op = key->read_queue.next;
+        pj_list_erase(op);
+        if (submit_op(key, op) == PJ_SUCCESS) {
+            key->read_busy = PJ_TRUE;
+        } else {
+            pj_list_insert_after(&key->read_queue, op);
+        }
+    }
+}
+
+
+/*
+ * pj_ioqueue_name()
+ */
+PJ_DEF(const char*) pj_ioqueue_name(void)
+{
+    return "io_uring";
+}
+
+PJ_DEF(void) pj_ioqueue_cfg_default(pj_ioqueue_cfg *cfg)
+{
+    pj_bzero(cfg, sizeof(*cfg));
+    cfg->epoll_flags = PJ_IOQUEUE_DEFAULT_EPOLL_FLAGS;
+    cfg->default_concurrency = PJ_IOQUEUE_DEFAULT_ALLOW_CONCURRENCY;
+}
+
+/*
+ * pj_ioqueue_create()
+ *
+ * Create io_uring ioqueue.
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_create( pj_pool_t *pool,
+                                       pj_size_t max_fd,
+                                       pj_ioqueue_t **p_ioqueue)
+{
+    return pj_ioqueue_create2(pool, max_fd, NULL, p_ioqueue);
+}
+
+/*
+ * pj_ioqueue_create2()
+ *
+ * Create io_uring ioqueue.
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_create2(pj_pool_t *pool,
+                                       pj_size_t max_fd,
+                                       const pj_ioqueue_cfg *cfg,
+                                       pj_ioqueue_t **p_ioqueue)
+{
+    pj_ioqueue_t *ioqueue;
+    pj_status_t rc;
+    pj_lock_t *lock;
+    pj_size_t i;
+
+    /* Check that arguments are valid. */
+    PJ_ASSERT_RETURN(pool != NULL && p_ioqueue != NULL &&
+                     max_fd > 0, PJ_EINVAL);
+
+    ioqueue = PJ_POOL_ZALLOC_T(pool, pj_ioqueue_t);
+    ioqueue->ring_fd = -1;
+    ioqueue->dispatch_tls = -1;
+
+    if (cfg)
+        pj_memcpy(&ioqueue->cfg, cfg, sizeof(*cfg));
+    else
+        pj_ioqueue_cfg_default(&ioqueue->cfg);
+    ioqueue->max = (unsigned)max_fd;
+    ioqueue->count = 0;
+    pj_list_init(&ioqueue->active_list);
+    pj_list_init(&ioqueue->free_ops);
+
+#if PJ_IOQUEUE_HAS_SAFE_UNREG
+    /* When safe unregistration is used (the default), we pre-create
+     * all keys and put them in the free list.
+     */
+    pj_list_init(&ioqueue->free_list);
+    pj_list_init(&ioqueue->closing_list);
+
+    for ( i=0; i<max_fd; ++i) {
+        pj_ioqueue_key_t *key;
+
+        key = PJ_POOL_ZALLOC_T(pool, pj_ioqueue_key_t);
+        rc = pj_lock_create_recursive_mutex(pool, NULL, &key->lock);
+        if (rc != PJ_SUCCESS) {
+            key = ioqueue->free_list.next;
+            while (key != &ioqueue->free_list) {
+                pj_lock_destroy(key->lock);
+                key = key->next;
+            }
+            return rc;
+        }
+
+        pj_list_push_back(&ioqueue->free_list, key);
+    }
+#else
+    PJ_UNUSED_ARG(i);
+#endif
+
+    rc = pj_lock_create_simple_mutex(pool, "ioq%p", &lock);
+    if (rc != PJ_SUCCESS)
+        goto on_error;
+
+    rc = pj_ioqueue_set_lock(ioqueue, lock, PJ_TRUE);
+    if (rc != PJ_SUCCESS)
+        goto on_error;
+
+    rc = pj_thread_local_alloc(&ioqueue->dispatch_tls);
+    if (rc != PJ_SUCCESS)
+        goto on_error;
+
+    /* Operation records are allocated on demand from a private pool, since
+     * the application's pool is not protected by our lock.
+     */
+    ioqueue->op_pool = pj_pool_create(pool->factory, "ioqop%p", 512, 512,
+                                      NULL);
+    if (!ioqueue->op_pool) {
+        rc = PJ_ENOMEM;
+        goto on_error;
+    }
+
+    rc = ring_create(ioqueue, PJ_IOQUEUE_URING_ENTRIES);
+    if (rc != PJ_SUCCESS) {
+        PJ_PERROR(1,(THIS_FILE, rc, "io_uring_setup() error"));
+        goto on_error;
+    }
+
+    PJ_LOG(4, ("pjlib", "io_uring I/O Queue created (entries:%u, ptr=%p)",
+               ioqueue->sq.entries, ioqueue));
+
+    *p_ioqueue = ioqueue;
+    return PJ_SUCCESS;
+
+on_error:
+    if (ioqueue->op_pool)
+        pj_pool_release(ioqueue->op_pool);
+    if (ioqueue->dispatch_tls != -1)
+        pj_thread_local_free(ioqueue->dispatch_tls);
+#if PJ_IOQUEUE_HAS_SAFE_UNREG
+    {
+        pj_ioqueue_key_t *key = ioqueue->free_list.next;
+        while (key != &ioqueue->free_list) {
+            pj_lock_destroy(key->lock);
+            key = key->next;
+        }
+    }
+#endif
+    if (ioqueue->auto_delete_lock && ioqueue->lock)
+        pj_lock_destroy(ioqueue->lock);
+    return rc;
+}
+
+/*
+ * pj_ioqueue_destroy()
+ *
+ * Destroy ioqueue.
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_destroy(pj_ioqueue_t *ioqueue)
+{
+#if PJ_IOQUEUE_HAS_SAFE_UNREG
+    pj_ioqueue_key_t *key;
+#endif
+
+    PJ_ASSERT_RETURN(ioqueue, PJ_EINVAL);
+    PJ_ASSERT_RETURN(ioqueue->ring_fd >= 0, PJ_EINVALIDOP);
+
+    pj_lock_acquire(ioqueue->lock);
+    ring_destroy(ioqueue);
+    pj_thread_local_free(ioqueue->dispatch_tls);
+    pj_pool_release(ioqueue->op_pool);
+    ioqueue->op_pool = NULL;
+
+#if PJ_IOQUEUE_HAS_SAFE_UNREG
+    key = ioqueue->active_list.next;
+    while (key != &ioqueue->active_list) {
+        pj_lock_destroy(key->lock);
+        key = key->next;
+    }
+
+    key = ioqueue->closing_list.next;
+    while (key != &ioqueue->closing_list) {
+        pj_lock_destroy(key->lock);
+        key = key->next;
+    }
+
+    key = ioqueue->free_list.next;
+    while (key != &ioqueue->free_list) {
+        pj_lock_destroy(key->lock);
+        key = key->next;
+    }
+#endif
+
+    if (ioqueue->auto_delete_lock && ioqueue->lock ) {
+        pj_lock_release(ioqueue->lock);
+        return pj_lock_destroy(ioqueue->lock);
+    }
+
+    pj_lock_release(ioqueue->lock);
+    return PJ_SUCCESS;
+}
+
+/*
+ * pj_ioqueue_set_lock()
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_set_lock( pj_ioqueue_t *ioqueue,
+                                         pj_lock_t *lock,
+                                         pj_bool_t auto_delete )
+{
+    PJ_ASSERT_RETURN(ioqueue && lock, PJ_EINVAL);
+
+    if (ioqueue->auto_delete_lock && ioqueue->lock) {
+        pj_lock_destroy(ioqueue->lock);
+    }
+
+    ioqueue->lock = lock;
+    ioqueue->auto_delete_lock = auto_delete;
+
+    return PJ_SUCCESS;
+}
+
+/*
+ * pj_ioqueue_register_sock()
+ *
+ * Register a socket to ioqueue.
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_register_sock2(pj_pool_t *pool,
+                                              pj_ioqueue_t *ioqueue,
+                                              pj_sock_t sock,
+                                              pj_grp_lock_t *grp_lock,
+                                              void *user_data,
+                                              const pj_ioqueue_callback *cb,
+                                              pj_ioqueue_key_t **p_key)
+{
+    pj_ioqueue_key_t *key = NULL;
+    pj_uint32_t value;
+    int optlen;
+    pj_status_t status = PJ_SUCCESS;
+
+    PJ_ASSERT_RETURN(pool && ioqueue && sock != PJ_INVALID_SOCKET &&
+                     cb && p_key, PJ_EINVAL);
+
+    pj_lock_acquire(ioqueue->lock);
+
+    if (ioqueue->count >= ioqueue->max) {
+        status = PJ_ETOOMANY;
+        TRACE_((THIS_FILE, "pj_ioqueue_register_sock error: too many files"));
+        goto on_return;
+    }
+
+    /* Set socket to nonblocking, for the immediate operations. */
+    value = 1;
+    if (ioctl(sock, FIONBIO, (unsigned long)&value)) {
+        status = pj_get_netos_error();
+        goto on_return;
+    }
+
+    /* If safe unregistration (PJ_IOQUEUE_HAS_SAFE_UNREG) is used, get
+     * the key from the free list. Otherwise allocate a new one.
+     */
+#if PJ_IOQUEUE_HAS_SAFE_UNREG
+
+    /* Scan closing_keys first to let them come back to free_list */
+    scan_closing_keys(ioqueue);
+
+    pj_assert(!pj_list_empty(&ioqueue->free_list));
+    if (pj_list_empty(&ioqueue->free_list)) {
+        status = PJ_ETOOMANY;
+        goto on_return;
+    }
+
+    key = ioqueue->free_list.next;
+    pj_list_erase(key);
+
+    /* Set initial reference count to 1 */
+    pj_assert(key->ref_count == 0);
+    key->ref_count = 1;
+    key->closing = 0;
+#else
+    key = (pj_ioqueue_key_t*)pj_pool_zalloc(pool, sizeof(pj_ioqueue_key_t));
+    status = pj_lock_create_simple_mutex(pool, NULL, &key->lock);
+    if (status != PJ_SUCCESS) {
+        key = NULL;
+        goto on_return;
+    }
+#endif
+
+    key->ioqueue = ioqueue;
+    key->fd = sock;
+    key->user_data = user_data;
+    pj_memcpy(&key->cb, cb, sizeof(pj_ioqueue_callback));
+    pj_list_init(&key->inflight);
+    pj_list_init(&key->read_queue);
+    pj_list_init(&key->write_queue);
+    key->read_busy = PJ_FALSE;
+    key->write_cnt = 0;
+    key->accept_cnt = 0;
+    key->connect_op = NULL;
+
+    status = pj_ioqueue_set_concurrency(key, ioqueue->cfg.default_concurrency);
+    if (status != PJ_SUCCESS)
+        goto on_return;
+
+    /* Get socket type. Stream sockets keep only one read and one write
+     * in flight, to preserve the ordering of the data. Datagram sockets
+     * may have several of each.
+     */
+    optlen = sizeof(key->fd_type);
+    status = pj_sock_getsockopt(sock, pj_SOL_SOCKET(), pj_SO_TYPE(),
+                                &key->fd_type, &optlen);
+    if (status != PJ_SUCCESS) {
+        key->fd_type = pj_SOCK_STREAM();
+        status = PJ_SUCCESS;
+    }
+
+    key->grp_lock = grp_lock;
+    if (key->grp_lock) {
+        pj_grp_lock_add_ref_dbg(key->grp_lock, "ioqueue", 0);
+    }
+
+    /* Register */
+    pj_list_insert_before(&ioqueue->active_list, key);
+    ++ioqueue->count;
+
+on_return:
+    if (status != PJ_SUCCESS) {
+#if PJ_IOQUEUE_HAS_SAFE_UNREG
+        if (key) {
+            key->ref_count = 0;
+            pj_list_push_back(&ioqueue->free_list, key);
+        }
+#endif
+        key = NULL;
+    }
+    *p_key = key;
+    pj_lock_release(ioqueue->lock);
+
+    return status;
+}
+
+PJ_DEF(pj_status_t) pj_ioqueue_register_sock( pj_pool_t *pool,
+                                              pj_ioqueue_t *ioqueue,
+                                              pj_sock_t sock,
+                                              void *user_data,
+                                              const pj_ioqueue_callback *cb,
+                                              pj_ioqueue_key_t **p_key)
+{
+    return pj_ioqueue_register_sock2(pool, ioqueue, sock, NULL, user_data,
+                                     cb, p_key);
+}
+
+/*
+ * pj_ioqueue_get_user_data()
+ *
+ * Obtain value associated with a key.
+ */
+PJ_DEF(void*) pj_ioqueue_get_user_data( pj_ioqueue_key_t *key )
+{
+    PJ_ASSERT_RETURN(key != NULL, NULL);
+    return key->user_data;
+}
+
+/*
+ * pj_ioqueue_set_user_data()
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_set_user_data( pj_ioqueue_key_t *key,
+                                              void *user_data,
+                                              void **old_data)
+{
+    PJ_ASSERT_RETURN(key, PJ_EINVAL);
+
+    if (old_data)
+        *old_data = key->user_data;
+    key->user_data = user_data;
+
+    return PJ_SUCCESS;
+}
+
+#if PJ_IOQUEUE_HAS_SAFE_UNREG
+/* Increment key's reference counter. Must be called with ioqueue's lock. */
+static void increment_counter(pj_ioqueue_key_t *key)
+{
+    ++key->ref_count;
+}
+
+/* Decrement the key's reference counter, and when the counter reach zero,
+ * destroy the key.
+ *
+ * Note: MUST NOT CALL THIS FUNCTION WHILE HOLDING ioqueue's LOCK.
+ */
+static void decrement_counter(pj_ioqueue_key_t *key)
+{
+    pj_lock_acquire(key->ioqueue->lock);
+    --key->ref_count;
+    if (key->ref_count == 0) {
+
+        pj_assert(key->closing == 1);
+        pj_gettickcount(&key->free_time);
+        key->free_time.msec += PJ_IOQUEUE_KEY_FREE_DELAY;
+        pj_time_val_normalize(&key->free_time);
+
+        pj_list_erase(key);
+        pj_list_push_back(&key->ioqueue->closing_list, key);
+
+    }
+    pj_lock_release(key->ioqueue->lock);
+}
+#endif
+
+/*
+ * pj_ioqueue_unregister()
+ *
+ * Unregister handle from ioqueue.
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_unregister( pj_ioqueue_key_t *key)
+{
+    pj_ioqueue_t *ioqueue;
+
+    PJ_ASSERT_RETURN(key != NULL, PJ_EINVAL);
+
+    ioqueue = key->ioqueue;
+
+    /* Lock the key to make sure no callback is simultaneously modifying
+     * the key. We need to lock the key before ioqueue here to prevent
+     * deadlock.
+     */
+    pj_ioqueue_lock_key(key);
+
+    /* Best effort to avoid double key-unregistration */
+    if (IS_CLOSING(key)) {
+        pj_ioqueue_unlock_key(key);
+        return PJ_SUCCESS;
+    }
+
+    /* Also lock ioqueue */
+    pj_lock_acquire(ioqueue->lock);
+
+    /* Avoid "negative" ioqueue count */
+    if (ioqueue->count > 0) {
+        --ioqueue->count;
+    } else {
+        /* If this happens, very likely there is double unregistration
+         * of a key.
+         */
+        pj_assert(!"Bad ioqueue count in key unregistration!");
+        PJ_LOG(1,(THIS_FILE, "Bad ioqueue count in key unregistration!"));
+    }
+
+#if !PJ_IOQUEUE_HAS_SAFE_UNREG
+    pj_list_erase(key);
+#endif
+
+    /* Cancel everything that is still in flight, and wait until the
+     * kernel no longer uses the buffers. The completions of cancelled
+     * operations are discarded by pj_ioqueue_poll().
+     */
+    key_cancel_all(key);
+
+    /* Destroy the key. */
+    pj_sock_close(key->fd);
+
+#if PJ_IOQUEUE_HAS_SAFE_UNREG
+    /* Mark key is closing. */
+    key->closing = 1;
+#endif
+
+    pj_lock_release(ioqueue->lock);
+
+
+#if PJ_IOQUEUE_HAS_SAFE_UNREG
+    /* Decrement counter. */
+    decrement_counter(key);
+#endif
+
+    if (key->grp_lock) {
+        /* just dec_ref and unlock. we will set grp_lock to NULL
+         * elsewhere */
+        pj_grp_lock_t *grp_lock = key->grp_lock;
+        // Don't set grp_lock to NULL otherwise the other thread
+        // will crash. Just leave it as dangling pointer, but this
+        // should be safe
+        //key->grp_lock = NULL;
+        pj_grp_lock_dec_ref_dbg(grp_lock, "ioqueue", 0);
+        pj_grp_lock_release(grp_lock);
+    } else {
+        pj_ioqueue_unlock_key(key);
+    }
+
+#if !PJ_IOQUEUE_HAS_SAFE_UNREG
+    pj_lock_destroy(key->lock);
+#endif
+
+    return PJ_SUCCESS;
+}
+
+
+#if PJ_IOQUEUE_HAS_SAFE_UNREG
+/* Scan closing keys to be put to free list again */
+static void scan_closing_keys(pj_ioqueue_t *ioqueue)
+{
+    pj_time_val now;
+    pj_ioqueue_key_t *h;
+
+    pj_gettickcount(&now);
+    h = ioqueue->closing_list.next;
+    while (h != &ioqueue->closing_list) {
+        pj_ioqueue_key_t *next = h->next;
+
+        pj_assert(h->closing != 0);
+
+        if (PJ_TIME_VAL_GTE(now, h->free_time)) {
+            pj_list_erase(h);
+            // Don't set grp_lock to NULL otherwise the other thread
+            // will crash. Just leave it as dangling pointer, but this
+            // should be safe
+            //h->grp_lock = NULL;
+            pj_list_push_back(&ioqueue->free_list, h);
+        }
+        h = next;
+    }
+}
+#endif
+
+
+/*
+ * Process one CQE. Must be called with ioqueue's lock. Returns PJ_TRUE
+ * if the completion must be reported to application in the event.
+ */
+static pj_bool_t complete_op(pj_ioqueue_t *ioqueue, struct uring_op *op,
+                             int res, struct uring_event *event)
+{
+    pj_ioqueue_key_t *key = op->key;
+
+    if (key == NULL) {
+        /* Detached (cancelled) operation */
+        pj_list_erase(op);
+        free_op(ioqueue, op);
+        return PJ_FALSE;
+    }
+
+    /* Operation was interrupted before anything happened, restart it */
+    if (res == -EINTR || res == -EAGAIN) {
+        pj_list_erase(op);
+        if (submit_op(key, op) == PJ_SUCCESS)
+            return PJ_FALSE;
+        res = -EAGAIN;
+    } else {
+        pj_list_erase(op);
+    }
+
+    event->key = key;
+    event->op_key = op->op_key;
+    event->op = op->op;
+    event->bytes = 0;
+    event->new_sock = PJ_INVALID_SOCKET;
+    event->status = PJ_SUCCESS;
+
+    switch (op->op) {
+    case PJ_IOQUEUE_OP_RECV:
+    case PJ_IOQUEUE_OP_RECV_FROM:
+        if (key->fd_type != pj_SOCK_DGRAM())
+            key->read_busy = PJ_FALSE;
+        if (res >= 0) {
+            event->bytes = res;
+            if (op->op == PJ_IOQUEUE_OP_RECV_FROM && op->rmt_addrlen)
+                *op->rmt_addrlen = op->msg.msg_namelen;
+        } else {
+            event->bytes = -PJ_STATUS_FROM_OS(-res);
+        }
+        break;
+
+    case PJ_IOQUEUE_OP_SEND:
+    case PJ_IOQUEUE_OP_SEND_TO:
+        if (res >= 0) {
+            op->written += res;
+            /* Stream sockets may accept only part of the data, send the
+             * remaining before reporting the completion.
+             */
+            if (op->written < op->size && res > 0 &&
+                key->fd_type != pj_SOCK_DGRAM() &&
+                submit_op(key, op) == PJ_SUCCESS)
+            {
+                return PJ_FALSE;
+            }
+            event->bytes = op->written;
+        } else {
+            event->bytes = -PJ_STATUS_FROM_OS(-res);
+        }
+        --key->write_cnt;
+        break;
+
+#if PJ_HAS_TCP
+    case PJ_IOQUEUE_OP_ACCEPT:
+        --key->accept_cnt;
+        if (res >= 0) {
+            event->new_sock = res;
+            if (op->rmt_addrlen)
+                *op->rmt_addrlen = op->sock_addrlen;
+            if (op->local_addr && op->rmt_addrlen) {
+                event->status = pj_sock_getsockname(res, op->local_addr,
+                                                    op->rmt_addrlen);
+                if (event->status != PJ_SUCCESS) {
+                    pj_sock_close(res);
+                    event->new_sock = PJ_INVALID_SOCKET;
+                }
+            }
+        } else {
+            event->status = PJ_STATUS_FROM_OS(-res);
+        }
+        if (op->accept_fd)
+            *op->accept_fd = event->new_sock;
+        break;
+
+    case PJ_IOQUEUE_OP_CONNECT:
+        key->connect_op = NULL;
+        if (res >= 0) {
+            /* from connect(2):
+             * On Linux, use getsockopt to read the SO_ERROR option at
+             * level SOL_SOCKET to determine whether connect() completed
+             * successfully (if SO_ERROR is zero).
+             */
+            int value;
+            int vallen = sizeof(value);
+            if (pj_sock_getsockopt(key->fd, SOL_SOCKET, SO_ERROR,
+                                   &value, &vallen) == PJ_SUCCESS)
+            {
+                event->status = PJ_STATUS_FROM_OS(value);
+            }
+        } else {
+            event->status = PJ_STATUS_FROM_OS(-res);
+        }
+        break;
+#endif
+
+    default:
+        pj_assert(!"Invalid operation");
+        break;
+    }
+
+    free_op(ioqueue, op);
+    return PJ_TRUE;
+}
+
+/*
+ * Report the completion to application.
+ */
+static void dispatch_event(pj_ioqueue_t *ioqueue, struct uring_event *event)
+{
+    pj_ioqueue_key_t *h = event->key;
+    pj_bool_t has_lock;
+
+    /* Unless concurrency is disabled, we don't need to hold key's mutex
+     * while calling the callback.
+     */
+    if (h->allow_concurrent) {
+        has_lock = PJ_FALSE;
+    } else {
+        has_lock = PJ_TRUE;
+        pj_ioqueue_lock_key(h);
+    }
+
+    if (!IS_CLOSING(h)) {
+        switch (event->op) {
+        case PJ_IOQUEUE_OP_RECV:
+        case PJ_IOQUEUE_OP_RECV_FROM:
+            if (h->cb.on_read_complete)
+                (*h->cb.on_read_complete)(h, event->op_key, event->bytes);
+            break;
+        case PJ_IOQUEUE_OP_SEND:
+        case PJ_IOQUEUE_OP_SEND_TO:
+            if (h->cb.on_write_complete)
+                (*h->cb.on_write_complete)(h, event->op_key, event->bytes);
+            break;
+#if PJ_HAS_TCP
+        case PJ_IOQUEUE_OP_ACCEPT:
+            if (h->cb.on_accept_complete)
+                (*h->cb.on_accept_complete)(h, event->op_key,
+                                            event->new_sock, event->status);
+            break;
+        case PJ_IOQUEUE_OP_CONNECT:
+            if (h->cb.on_connect_complete)
+                (*h->cb.on_connect_complete)(h, event->status);
+            break;
+#endif
+        default:
+            break;
+        }
+    }
+#if PJ_HAS_TCP
+    else if (event->op == PJ_IOQUEUE_OP_ACCEPT &&
+             event->new_sock != PJ_INVALID_SOCKET)
+    {
+        pj_sock_close(event->new_sock);
+    }
+#endif
+
+    /* Submit the next queued stream operation only now, so that its
+     * completion can't be reported before this one.
+     */
+    pj_lock_acquire(ioqueue->lock);
+    if (!IS_CLOSING(h))
+        key_kick_queues(h);
+    pj_lock_release(ioqueue->lock);
+
+    if (has_lock)
+        pj_ioqueue_unlock_key(h);
+}
+
+/*
+ * pj_ioqueue_poll()
+ *
+ */
+PJ_DEF(int) pj_ioqueue_poll( pj_ioqueue_t *ioqueue, const pj_time_val *timeout)
+{
+    enum { MAX_EVENTS = PJ_IOQUEUE_MAX_CAND_EVENTS };
+    struct uring_event events[MAX_EVENTS];
+    struct uring_cq *cq = &ioqueue->cq;
+    unsigned head, tail;
+    int i, count, event_cnt;
+    int msec;
+    void *prev_tls;
+
+    PJ_CHECK_STACK();
+
+    msec = timeout ? PJ_TIME_VAL_MSEC(*timeout) : 9000;
+
+    /* Flush pending submissions and see if there's anything to reap
+     * already, before going to sleep.
+     */
+    pj_lock_acquire(ioqueue->lock);
+    ring_submit(ioqueue);
+    tail = __atomic_load_n(cq->ktail, __ATOMIC_ACQUIRE);
+    pj_lock_release(ioqueue->lock);
+
+    if (tail == *cq->khead && msec > 0) {
+        struct io_uring_getevents_arg arg;
+        struct __kernel_timespec ts;
+        int rc;
+
+        ts.tv_sec = msec / 1000;
+        ts.tv_nsec = (msec % 1000) * 1000000;
+        pj_bzero(&arg, sizeof(arg));
+        arg.sigmask_sz = _NSIG / 8;
+        arg.ts = (__u64)(pj_size_t)&ts;
+
+        TRACE_((THIS_FILE, "start io_uring_enter, msec=%d", msec));
+        rc = sys_io_uring_enter(ioqueue->ring_fd, 0, 1,
+                                IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG,
+                                &arg, sizeof(arg));
+        if (rc < 0 && errno != ETIME && errno != EINTR) {
+            TRACE_((THIS_FILE, "  io_uring_enter error"));
+            return -pj_get_os_error();
+        }
+    }
+
+    /* Reap the completions. */
+    pj_lock_acquire(ioqueue->lock);
+
+    head = *cq->khead;
+    tail = __atomic_load_n(cq->ktail, __ATOMIC_ACQUIRE);
+    for (count=0, event_cnt=0; head != tail && event_cnt < MAX_EVENTS;
+         ++head)
+    {
+        struct io_uring_cqe *cqe = &cq->cqes[head & cq->mask];
+        struct uring_op *op = (struct uring_op*)(pj_size_t)cqe->user_data;
+
+        ++count;
+
+        if (complete_op(ioqueue, op, cqe->res, &events[event_cnt])) {
+#if PJ_IOQUEUE_HAS_SAFE_UNREG
+            increment_counter(events[event_cnt].key);
+#endif
+            if (events[event_cnt].key->grp_lock)
+                pj_grp_lock_add_ref_dbg(events[event_cnt].key->grp_lock,
+                                        "ioqueue", 0);
+            ++event_cnt;
+        }
+    }
+    __atomic_store_n(cq->khead, head, __ATOMIC_RELEASE);
+
+#if PJ_IOQUEUE_HAS_SAFE_UNREG
+    /* Check the closing keys only when there's no activity and when there are
+     * pending closing keys.
+     */
+    if (count == 0 && !pj_list_empty(&ioqueue->closing_list)) {
+        scan_closing_keys(ioqueue);
+    }
+#endif
+
+    pj_lock_release(ioqueue->lock);
+
+    if (event_cnt == 0) {
+        TRACE_((THIS_FILE, "  poll: count=%d, no event", count));
+        return 0;
+    }
+
+    /* Now process the events. Submissions made by the callbacks are
+     * batched and flushed when we're done.
+     */
+    prev_tls = pj_thread_local_get(ioqueue->dispatch_tls);
+    pj_thread_local_set(ioqueue->dispatch_tls, ioqueue);
+
+    PJ_TRACE_BEGIN("ioqueue", "dispatch");
+    for (i=0; i<event_cnt; ++i) {
+        pj_ioqueue_key_t *h = events[i].key;
+
+        dispatch_event(ioqueue, &events[i]);
+
+#if PJ_IOQUEUE_HAS_SAFE_UNREG
+        decrement_counter(h);
+#endif
+
+        if (h->grp_lock)
+            pj_grp_lock_dec_ref_dbg(h->grp_lock, "ioqueue", 0);
+    }
+    PJ_TRACE_END("ioqueue", "dispatch");
+
+    pj_thread_local_set(ioqueue->dispatch_tls, prev_tls);
+    if (prev_tls != ioqueue) {
+        pj_lock_acquire(ioqueue->lock);
+        ring_submit(ioqueue);
+        pj_lock_release(ioqueue->lock);
+    }
+
+    TRACE_((THIS_FILE, "     poll: count=%d events=%d", count, event_cnt));
+
+    return event_cnt;
+}
+
+
+/*
+ * Check the key and op_key before starting an operation, and grab the
+ * ioqueue's lock.
+ */
+static pj_status_t start_op(pj_ioqueue_key_t *key, struct uring_op **p_op,
+                            pj_ioqueue_operation_e op_type,
+                            pj_ioqueue_op_key_t *op_key)
+{
+    struct uring_op *op;
+
+    pj_lock_acquire(key->ioqueue->lock);
+
+    /* Check again. Handle may have been closed after the previous check
+     * in multithreaded app.
+     */
+    if (IS_CLOSING(key)) {
+        pj_lock_release(key->ioqueue->lock);
+        return PJ_ECANCELLED;
+    }
+
+    /* The op_key must not have another operation pending */
+    if (op_key && find_op(key, op_key) != NULL) {
+        pj_lock_release(key->ioqueue->lock);
+        pj_assert(op_type & (PJ_IOQUEUE_OP_SEND | PJ_IOQUEUE_OP_SEND_TO));
+        return PJ_EBUSY;
+    }
+
+    op = alloc_op(key->ioqueue);
+    op->op = op_type;
+    op->key = key;
+    op->op_key = op_key;
+
+    *p_op = op;
+    return PJ_SUCCESS;
+}
+
+/*
+ * Submit a read operation, or queue it behind the one in flight for
+ * stream sockets.
+ */
+static pj_status_t start_read(pj_ioqueue_key_t *key, struct uring_op *op)
+{
+    pj_status_t status;
+
+    if (key->fd_type != pj_SOCK_DGRAM()) {
+        if (key->read_busy || !pj_list_empty(&key->read_queue)) {
+            pj_list_push_back(&key->read_queue, op);
+            status = PJ_EPENDING;
+        } else {
+            status = submit_op(key, op);
+            if (status == PJ_SUCCESS) {
+                key->read_busy = PJ_TRUE;
+                status = PJ_EPENDING;
+            }
+        }
+    } else {
+        status = submit_op(key, op);
+        if (status == PJ_SUCCESS)
+            status = PJ_EPENDING;
+    }
+
+    if (status != PJ_EPENDING)
+        free_op(key->ioqueue, op);
+
+    pj_lock_release(key->ioqueue->lock);
+    return status;
+}
+
+/*
+ * Submit a write operation, or queue it behind the one in flight for
+ * stream sockets. Datagram sockets may have several writes in flight.
+ */
+static pj_status_t start_write(pj_ioqueue_key_t *key, struct uring_op *op)
+{
+    pj_status_t status;
+
+    if (!pj_list_empty(&key->write_queue) ||
+        (key->write_cnt && key->fd_type != pj_SOCK_DGRAM()))
+    {
+        pj_list_push_back(&key->write_queue, op);
+        status = PJ_EPENDING;
+    } else {
+        status = submit_op(key, op);
+        if (status == PJ_SUCCESS) {
+            ++key->write_cnt;
+            status = PJ_EPENDING;
+        } else {
+            free_op(key->ioqueue, op);
+        }
+    }
+
+    pj_lock_release(key->ioqueue->lock);
+    return status;
+}
+
+/*
+ * pj_ioqueue_recv()
+ *
+ * Start asynchronous recv() from the socket.
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_recv(  pj_ioqueue_key_t *key,
+                                      pj_ioqueue_op_key_t *op_key,
+                                      void *buffer,
+                                      pj_ssize_t *length,
+                                      unsigned flags )
+{
+    struct uring_op *op;
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(key && op_key && buffer && length, PJ_EINVAL);
+    PJ_CHECK_STACK();
+
+    /* Check if key is closing (need to do this first before accessing
+     * other variables, since they might have been destroyed. See ticket
+     * #469).
+     */
+    if (IS_CLOSING(key))
+        return PJ_ECANCELLED;
+
+    flags &= ~(PJ_IOQUEUE_ALWAYS_ASYNC);
+
+    /*
+     * Always schedule asynchronous operation. Unlike the readiness based
+     * backends, trying recv() first would only cost an extra system call,
+     * since the kernel completes the read as soon as data arrives.
+     */
+    status = start_op(key, &op, PJ_IOQUEUE_OP_RECV, op_key);
+    if (status != PJ_SUCCESS)
+        return status;
+
+    op->buf = (char*)buffer;
+    op->size = *length;
+    op->flags = flags;
+
+    return start_read(key, op);
+}
+
+/*
+ * pj_ioqueue_recvfrom()
+ *
+ * Start asynchronous recvfrom() from the socket.
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_recvfrom( pj_ioqueue_key_t *key,
+                                         pj_ioqueue_op_key_t *op_key,
+                                         void *buffer,
+                                         pj_ssize_t *length,
+                                         unsigned flags,
+                                         pj_sockaddr_t *addr,
+                                         int *addrlen)
+{
+    struct uring_op *op;
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(key && op_key && buffer && length, PJ_EINVAL);
+    PJ_CHECK_STACK();
+
+    /* Check if key is closing. */
+    if (IS_CLOSING(key))
+        return PJ_ECANCELLED;
+
+    flags &= ~(PJ_IOQUEUE_ALWAYS_ASYNC);
+
+    /*
+     * Always schedule asynchronous operation (see pj_ioqueue_recv()).
+     */
+    status = start_op(key, &op, PJ_IOQUEUE_OP_RECV_FROM, op_key);
+    if (status != PJ_SUCCESS)
+        return status;
+
+    op->buf = (char*)buffer;
+    op->size = *length;
+    op->flags = flags;
+    op->rmt_addr = addr;
+    op->rmt_addrlen = addrlen;
+
+    return start_read(key, op);
+}
+
+/*
+ * Check if the op_key has a pending operation.
+ */
+static pj_bool_t op_key_busy(pj_ioqueue_key_t *key,
+                             pj_ioqueue_op_key_t *op_key)
+{
+    pj_bool_t busy;
+
+    pj_lock_acquire(key->ioqueue->lock);
+    busy = (find_op(key, op_key) != NULL);
+    pj_lock_release(key->ioqueue->lock);
+
+    return busy;
+}
+
+/*
+ * Wait a bit if the op_key still has a pending write.
+ */
+static pj_bool_t write_op_key_busy(pj_ioqueue_key_t *key,
+                                   pj_ioqueue_op_key_t *op_key)
+{
+    unsigned retry;
+
+    /* Spin if op_key has pending operation */
+    for (retry=0; op_key_busy(key, op_key) && retry<PENDING_RETRY; ++retry)
+        pj_thread_sleep(0);
+
+    /* Unable to send packet because there is already pending write in
+     * the op_key, and sending directly would break the order of the
+     * packets. Application should use multiple write operation keys in
+     * this case.
+     */
+    return op_key_busy(key, op_key);
+}
+
+/*
+ * pj_ioqueue_send()
+ *
+ * Start asynchronous send() to the descriptor.
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_send( pj_ioqueue_key_t *key,
+                                     pj_ioqueue_op_key_t *op_key,
+                                     const void *data,
+                                     pj_ssize_t *length,
+                                     unsigned flags)
+{
+    struct uring_op *op;
+    pj_status_t status;
+    pj_ssize_t sent;
+
+    PJ_ASSERT_RETURN(key && op_key && data && length, PJ_EINVAL);
+    PJ_CHECK_STACK();
+
+    /* Check if key is closing. */
+    if (IS_CLOSING(key))
+        return PJ_ECANCELLED;
+
+    /* We can not use PJ_IOQUEUE_ALWAYS_ASYNC for socket write. */
+    flags &= ~(PJ_IOQUEUE_ALWAYS_ASYNC);
+
+    /* Fast track:
+     *   Try to send data immediately, only if there's no pending write!
+     *   As with the other backends, this is checked without acquiring
+     *   the lock on purpose.
+     */
+    if (key->write_cnt == 0 && pj_list_empty(&key->write_queue)) {
+        /*
+         * See if data can be sent immediately.
+         */
+        sent = *length;
+        status = pj_sock_send(key->fd, data, &sent, flags);
+        if (status == PJ_SUCCESS) {
+            /* Success! */
+            *length = sent;
+            return PJ_SUCCESS;
+        } else {
+            /* If error is not EWOULDBLOCK (or EAGAIN on Linux), report
+             * the error to caller.
+             */
+            if (status != PJ_STATUS_FROM_OS(PJ_BLOCKING_ERROR_VAL)) {
+                return status;
+            }
+        }
+    }
+
+    /*
+     * Schedule asynchronous send.
+     */
+    if (write_op_key_busy(key, op_key))
+        return PJ_EBUSY;
+
+    status = start_op(key, &op, PJ_IOQUEUE_OP_SEND, op_key);
+    if (status != PJ_SUCCESS)
+        return status;
+
+    op->buf = (char*)data;
+    op->size = *length;
+    op->written = 0;
+    op->flags = flags;
+
+    return start_write(key, op);
+}
+
+
+/*
+ * pj_ioqueue_sendto()
+ *
+ * Start asynchronous write() to the descriptor.
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_sendto( pj_ioqueue_key_t *key,
+                                       pj_ioqueue_op_key_t *op_key,
+                                       const void *data,
+                                       pj_ssize_t *length,
+                                       pj_uint32_t flags,
+                                       const pj_sockaddr_t *addr,
+                                       int addrlen)
+{
+    struct uring_op *op;
+    pj_status_t status;
+    pj_ssize_t sent;
+
+    PJ_ASSERT_RETURN(key && op_key && data && length, PJ_EINVAL);
+    PJ_CHECK_STACK();
+
+    /* Check if key is closing. */
+    if (IS_CLOSING(key))
+        return PJ_ECANCELLED;
+
+    /* We can not use PJ_IOQUEUE_ALWAYS_ASYNC for socket write */
+    flags &= ~(PJ_IOQUEUE_ALWAYS_ASYNC);
+
+    /* Fast track:
+     *   Try to send data immediately, only if there's no pending write!
+     */
+    if (key->write_cnt == 0 && pj_list_empty(&key->write_queue)) {
+        /*
+         * See if data can be sent immediately.
+         */
+        sent = *length;
+        status = pj_sock_sendto(key->fd, data, &sent, flags, addr, addrlen);
+        if (status == PJ_SUCCESS) {
+            /* Success! */
+            *length = sent;
+            return PJ_SUCCESS;
+        } else {
+            /* If error is not EWOULDBLOCK (or EAGAIN on Linux), report
+             * the error to caller.
+             */
+            if (status != PJ_STATUS_FROM_OS(PJ_BLOCKING_ERROR_VAL)) {
+                return status;
+            }
+        }
+    }
+
+    /*
+     * Check that address storage can hold the address parameter.
+     */
+    PJ_ASSERT_RETURN(addrlen <= (int)sizeof(pj_sockaddr), PJ_EBUG);
+
+    /*
+     * Schedule asynchronous send.
+     */
+    if (write_op_key_busy(key, op_key))
+        return PJ_EBUSY;
+
+    status = start_op(key, &op, PJ_IOQUEUE_OP_SEND_TO, op_key);
+    if (status != PJ_SUCCESS)
+        return status;
+
+    op->buf = (char*)data;
+    op->size = *length;
+    op->written = 0;
+    op->flags = flags;
+    pj_memcpy(&op->dst_addr, addr, addrlen);
+    op->sock_addrlen = addrlen;
+
+    return start_write(key, op);
+}
+
+/*
+ * pj_ioqueue_sendto_batch()
+ *
+ * Send several datagrams immediately.
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_sendto_batch( pj_ioqueue_key_t *key,
+                                             pj_sock_mmsg msgs[],
+                                             unsigned *count,
+                                             pj_uint32_t flags)
+{
+    PJ_ASSERT_RETURN(key && msgs && count && *count, PJ_EINVAL);
+    PJ_CHECK_STACK();
+
+    /* Check if key is closing. */
+    if (IS_CLOSING(key))
+        return PJ_ECANCELLED;
+
+    flags &= ~(PJ_IOQUEUE_ALWAYS_ASYNC);
+
+    /* Don't overtake pending writes (see the note in pj_ioqueue_sendto()
+     * about checking the list without the lock).
+     */
+    if (key->write_cnt || !pj_list_empty(&key->write_queue)) {
+        *count = 0;
+        return PJ_EBUSY;
+    }
+
+    return pj_sock_sendmmsg(key->fd, msgs, count, flags);
+}
+
+#if PJ_HAS_TCP
+/*
+ * Initiate overlapped accept() operation.
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_accept( pj_ioqueue_key_t *key,
+                                       pj_ioqueue_op_key_t *op_key,
+                                       pj_sock_t *new_sock,
+                                       pj_sockaddr_t *local,
+                                       pj_sockaddr_t *remote,
+                                       int *addrlen)
+{
+    struct uring_op *op;
+    pj_status_t status;
+
+    /* check parameters. All must be specified! */
+    PJ_ASSERT_RETURN(key && op_key && new_sock, PJ_EINVAL);
+
+    /* Check if key is closing. */
+    if (IS_CLOSING(key))
+        return PJ_ECANCELLED;
+
+    PJ_ASSERT_RETURN(!op_key_busy(key, op_key), PJ_EPENDING);
+
+    /* Fast track:
+     *  See if there's new connection available immediately.
+     */
+    if (key->accept_cnt == 0) {
+        status = pj_sock_accept(key->fd, new_sock, remote, addrlen);
+        if (status == PJ_SUCCESS) {
+            /* Yes! New connection is available! */
+            if (local && addrlen) {
+                status = pj_sock_getsockname(*new_sock, local, addrlen);
+                if (status != PJ_SUCCESS) {
+                    pj_sock_close(*new_sock);
+                    *new_sock = PJ_INVALID_SOCKET;
+                    return status;
+                }
+            }
+            return PJ_SUCCESS;
+        } else {
+            /* If error is not EWOULDBLOCK (or EAGAIN on Linux), report
+             * the error to caller.
+             */
+            if (status != PJ_STATUS_FROM_OS(PJ_BLOCKING_ERROR_VAL)) {
+                return status;
+            }
+        }
+    }
+
+    /*
+     * No connection is available immediately.
+     * Schedule accept() operation to be completed when there is incoming
+     * connection available.
+     */
+    status = start_op(key, &op, PJ_IOQUEUE_OP_ACCEPT, op_key);
+    if (status != PJ_SUCCESS)
+        return status;
+
+    op->accept_fd = new_sock;
+    op->rmt_addr = remote;
+    op->rmt_addrlen = addrlen;
+    op->local_addr = local;
+
+    status = submit_op(key, op);
+    if (status == PJ_SUCCESS) {
+        ++key->accept_cnt;
+        status = PJ_EPENDING;
+    } else {
+        free_op(key->ioqueue, op);
+    }
+    pj_lock_release(key->ioqueue->lock);
+
+    return status;
+}
+
+/*
+ * Initiate overlapped connect() operation (well, it's non-blocking actually,
+ * we only wait for the socket to become writable in the ring).
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_connect( pj_ioqueue_key_t *key,
+                                        const pj_sockaddr_t *addr,
+                                        int addrlen )
+{
+    struct uring_op *op;
+    pj_status_t status;
+
+    /* check parameters. All must be specified! */
+    PJ_ASSERT_RETURN(key && addr && addrlen, PJ_EINVAL);
+
+    /* Check if key is closing. */
+    if (IS_CLOSING(key))
+        return PJ_ECANCELLED;
+
+    /* Check if socket has not been marked for connecting */
+    if (key->connect_op != NULL)
+        return PJ_EPENDING;
+
+    status = pj_sock_connect(key->fd, addr, addrlen);
+    if (status == PJ_SUCCESS) {
+        /* Connected! */
+        return PJ_SUCCESS;
+    } else if (status != PJ_STATUS_FROM_OS(PJ_BLOCKING_CONNECT_ERROR_VAL)) {
+        /* Error! */
+        return status;
+    }
+
+    /* Pending! */
+    status = start_op(key, &op, PJ_IOQUEUE_OP_CONNECT, NULL);
+    if (status != PJ_SUCCESS)
+        return status;
+
+    status = submit_op(key, op);
+    if (status == PJ_SUCCESS) {
+        key->connect_op = op;
+        status = PJ_EPENDING;
+    } else {
+        free_op(key->ioqueue, op);
+    }
+    pj_lock_release(key->ioqueue->lock);
+
+    return status;
+}
+#endif  /* PJ_HAS_TCP */
+
+
+PJ_DEF(void) pj_ioqueue_op_key_init( pj_ioqueue_op_key_t *op_key,
+                                     pj_size_t size )
+{
+    pj_bzero(op_key, size);
+}
+
+
+/*
+ * pj_ioqueue_is_pending()
+ */
+PJ_DEF(pj_bool_t) pj_ioqueue_is_pending( pj_ioqueue_key_t *key,
+                                         pj_ioqueue_op_key_t *op_key )
+{
+    return op_key_busy(key, op_key);
+}
+
+
+/*
+ * pj_ioqueue_post_completion()
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_post_completion( pj_ioqueue_key_t *key,
+                                                pj_ioqueue_op_key_t *op_key,
+                                                pj_ssize_t bytes_status )
+{
+    pj_ioqueue_t *ioqueue = key->ioqueue;
+    struct uring_op *op;
+    pj_ioqueue_operation_e op_type;
+
+    pj_ioqueue_lock_key(key);
+    pj_lock_acquire(ioqueue->lock);
+
+    /* Make sure that the operation is still pending on this key. */
+    op = find_op(key, op_key);
+    if (op == NULL) {
+#if PJ_HAS_TCP
+        /* Clear connecting operation. */
+        if (key->connect_op)
+            cancel_op(ioqueue, key->connect_op);
+        key->connect_op = NULL;
+        ring_submit(ioqueue);
+#endif
+        pj_lock_release(ioqueue->lock);
+        pj_ioqueue_unlock_key(key);
+        return PJ_EINVALIDOP;
+    }
+
+    op_type = op->op;
+    if (!op->submitted) {
+        /* Still waiting in the key's queue */
+        pj_list_erase(op);
+        free_op(ioqueue, op);
+    } else {
+        /* Already with the kernel */
+        cancel_op(ioqueue, op);
+        if (op_type & (PJ_IOQUEUE_OP_SEND | PJ_IOQUEUE_OP_SEND_TO))
+            --key->write_cnt;
+        else if (op_type & (PJ_IOQUEUE_OP_RECV | PJ_IOQUEUE_OP_RECV_FROM))
+            key->read_busy = PJ_FALSE;
+#if PJ_HAS_TCP
+        else if (op_type == PJ_IOQUEUE_OP_ACCEPT)
+            --key->accept_cnt;
+#endif
+        key_kick_queues(key);
+        ring_submit(ioqueue);
+    }
+
+    pj_lock_release(ioqueue->lock);
+    pj_ioqueue_unlock_key(key);
+
+    switch (op_type) {
+    case PJ_IOQUEUE_OP_RECV:
+    case PJ_IOQUEUE_OP_RECV_FROM:
+        if (key->cb.on_read_complete)
+            (*key->cb.on_read_complete)(key, op_key, bytes_status);
+        break;
+    case PJ_IOQUEUE_OP_SEND:
+    case PJ_IOQUEUE_OP_SEND_TO:
+        if (key->cb.on_write_complete)
+            (*key->cb.on_write_complete)(key, op_key, bytes_status);
+        break;
+#if PJ_HAS_TCP
+    case PJ_IOQUEUE_OP_ACCEPT:
+        if (key->cb.on_accept_complete) {
+            (*key->cb.on_accept_complete)(key, op_key,
+                                          PJ_INVALID_SOCKET,
+                                          (pj_status_t)bytes_status);
+        }
+        break;
+#endif
+    default:
+        break;
+    }
+
+    return PJ_SUCCESS;
+}
+
+
+PJ_DEF(pj_status_t) pj_ioqueue_clear_key( pj_ioqueue_key_t *key )
+{
+    PJ_ASSERT_RETURN(key, PJ_EINVAL);
+
+    pj_ioqueue_lock_key(key);
+    pj_lock_acquire(key->ioqueue->lock);
+
+    /* Cancel and forget all pending operations */
+    key_cancel_all(key);
+
+    pj_lock_release(key->ioqueue->lock);
+    pj_ioqueue_unlock_key(key);
+
+    return PJ_SUCCESS;
+}
+
+
+PJ_DEF(pj_status_t) pj_ioqueue_set_default_concurrency( pj_ioqueue_t *ioqueue,
+                                                        pj_bool_t allow)
+{
+    PJ_ASSERT_RETURN(ioqueue != NULL, PJ_EINVAL);
+    ioqueue->cfg.default_concurrency = allow;
+    return PJ_SUCCESS;
+}
+
+
+PJ_DEF(pj_status_t) pj_ioqueue_set_concurrency(pj_ioqueue_key_t *key,
+                                               pj_bool_t allow)
+{
+    PJ_ASSERT_RETURN(key, PJ_EINVAL);
+
+    /* PJ_IOQUEUE_HAS_SAFE_UNREG must be enabled if concurrency is
+     * disabled.
+     */
+    PJ_ASSERT_RETURN(allow || PJ_IOQUEUE_HAS_SAFE_UNREG, PJ_EINVAL);
+
+    key->allow_concurrent = allow;
+    return PJ_SUCCESS;
+}
+
+PJ_DEF(pj_status_t) pj_ioqueue_lock_key(pj_ioqueue_key_t *key)
+{
+    if (key->grp_lock)
+        return pj_grp_lock_acquire(key->grp_lock);
+    else
+        return pj_lock_acquire(key->lock);
+}
+
+PJ_DEF(pj_status_t) pj_ioqueue_trylock_key(pj_ioqueue_key_t *key)
+{
+    if (key->grp_lock)
+        return pj_grp_lock_tryacquire(key->grp_lock);
+    else
+        return pj_lock_tryacquire(key->lock);
+}
+
+PJ_DEF(pj_status_t) pj_ioqueue_unlock_key(pj_ioqueue_key_t *key)
+{
+    if (key->grp_lock)
+        return pj_grp_lock_release(key->grp_lock);
+    else
+        return pj_lock_release(key->lock);
+}
+
+PJ_DEF(pj_oshandle_t) pj_ioqueue_get_os_handle( pj_ioqueue_t *ioqueue )
+{
+    return ioqueue ? (pj_oshandle_t)&ioqueue->ring_fd : NULL;
+}
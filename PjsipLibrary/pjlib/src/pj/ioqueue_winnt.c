@@ -121,6 +121,9 @@ struct pj_ioqueue_key_t
     int                 connecting;
 #endif
 
+    /* Number of overlapped writes not completed yet */
+    volatile LONG       write_pending;
+
 #if PJ_IOQUEUE_HAS_SAFE_UNREG
     pj_atomic_t        *ref_count;
     pj_bool_t           closing;
@@ -595,6 +598,7 @@ PJ_DEF(pj_status_t) pj_ioqueue_register_sock2(pj_pool_t *pool,
 
 #if PJ_HAS_TCP
     rec->connecting = 0;
+    rec->write_pending = 0;
 #endif
 
     /* Set socket to nonblocking. */
@@ -734,6 +738,13 @@ static pj_bool_t poll_iocp( HANDLE hIocp, DWORD dwTimeout,
         if (p_key)
             *p_key = key;
 
+        if (pOv->operation == PJ_IOQUEUE_OP_WRITE ||
+            pOv->operation == PJ_IOQUEUE_OP_SEND ||
+            pOv->operation == PJ_IOQUEUE_OP_SEND_TO)
+        {
+            InterlockedDecrement(&key->write_pending);
+        }
+
 #if PJ_IOQUEUE_HAS_SAFE_UNREG
         /* We shouldn't call callbacks if key is quitting. */
         if (key->closing)
@@ -1240,19 +1251,53 @@ PJ_DEF(pj_status_t) pj_ioqueue_sendto( pj_ioqueue_key_t *key,
               sizeof(op_key_rec->overlapped.overlapped));
     op_key_rec->overlapped.operation = PJ_IOQUEUE_OP_SEND;
 
+    InterlockedIncrement(&key->write_pending);
     rc = WSASendTo((SOCKET)key->hnd, &op_key_rec->overlapped.wsabuf, 1,
                    &bytesWritten,  dwFlags, addr, addrlen,
                    &op_key_rec->overlapped.overlapped, NULL);
     if (rc == SOCKET_ERROR) {
         DWORD dwStatus = WSAGetLastError();
-        if (dwStatus!=WSA_IO_PENDING)
+        if (dwStatus!=WSA_IO_PENDING) {
+            op_key_rec->overlapped.operation = 0;
+            InterlockedDecrement(&key->write_pending);
             return PJ_STATUS_FROM_OS(dwStatus);
+        }
     }
 
     /* Asynchronous operation successfully submitted. */
     return PJ_EPENDING;
 }
 
+/*
+ * pj_ioqueue_sendto_batch()
+ *
+ * Send several datagrams immediately.
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_sendto_batch( pj_ioqueue_key_t *key,
+                                             pj_sock_mmsg msgs[],
+                                             unsigned *count,
+                                             pj_uint32_t flags)
+{
+    PJ_CHECK_STACK();
+    PJ_ASSERT_RETURN(key && msgs && count && *count, PJ_EINVAL);
+
+#if PJ_IOQUEUE_HAS_SAFE_UNREG
+    /* Check key is not closing */
+    if (key->closing)
+        return PJ_ECANCELLED;
+#endif
+
+    flags &= ~(PJ_IOQUEUE_ALWAYS_ASYNC);
+
+    /* Don't overtake overlapped writes that haven't completed yet */
+    if (key->write_pending > 0) {
+        *count = 0;
+        return PJ_EBUSY;
+    }
+
+    return pj_sock_sendmmsg((pj_sock_t)key->hnd, msgs, count, flags);
+}
+
 #if PJ_HAS_TCP
 
 /*
@@ -23,6 +23,7 @@
 #include <pj/pool.h>
 #include <pj/string.h>
 #include <pj/errno.h>
+#include <pj/compat/stdarg.h>
 
 #define THIS_FILE       "lock.c"
 
@@ -248,6 +249,11 @@ struct pj_grp_lock_t
     grp_lock_ref         ref_list;
     grp_lock_ref         ref_free_list;
 #endif
+
+#if PJ_LOCK_PROFILING
+    pj_lock_prof_entry  *prof;
+    pj_timestamp         prof_acq_time;
+#endif
 };
 
 
@@ -285,30 +291,21 @@ static void grp_lock_unset_owner_thread(pj_grp_lock_t *glock)
     }
 }
 
-static pj_status_t grp_lock_acquire(LOCK_OBJ *p)
+static void grp_lock_lock_all(pj_grp_lock_t *glock)
 {
-    pj_grp_lock_t *glock = (pj_grp_lock_t*)p;
     grp_lock_item *lck;
 
-    pj_assert(pj_atomic_get(glock->ref_cnt) > 0);
-
     lck = glock->lock_list.next;
     while (lck != &glock->lock_list) {
         pj_lock_acquire(lck->lock);
         lck = lck->next;
     }
-    grp_lock_set_owner_thread(glock);
-    pj_grp_lock_add_ref(glock);
-    return PJ_SUCCESS;
 }
 
-static pj_status_t grp_lock_tryacquire(LOCK_OBJ *p)
+static pj_status_t grp_lock_trylock_all(pj_grp_lock_t *glock)
 {
-    pj_grp_lock_t *glock = (pj_grp_lock_t*)p;
     grp_lock_item *lck;
 
-    pj_assert(pj_atomic_get(glock->ref_cnt) > 0);
-
     lck = glock->lock_list.next;
     while (lck != &glock->lock_list) {
         pj_status_t status = pj_lock_tryacquire(lck->lock);
@@ -322,7 +319,58 @@ static pj_status_t grp_lock_tryacquire(LOCK_OBJ *p)
         }
         lck = lck->next;
     }
+    return PJ_SUCCESS;
+}
+
+static pj_status_t grp_lock_acquire(LOCK_OBJ *p)
+{
+    pj_grp_lock_t *glock = (pj_grp_lock_t*)p;
+
+    pj_assert(pj_atomic_get(glock->ref_cnt) > 0);
+
+#if PJ_LOCK_PROFILING
+    {
+        pj_timestamp wait_start;
+        pj_bool_t waited = PJ_FALSE;
+
+        /* Try first to find out whether we have to wait */
+        if (grp_lock_trylock_all(glock) != PJ_SUCCESS) {
+            pj_get_timestamp(&wait_start);
+            grp_lock_lock_all(glock);
+            waited = PJ_TRUE;
+        }
+        grp_lock_set_owner_thread(glock);
+        if (glock->owner_cnt == 1) {
+            pj_lock_prof_on_acquire(glock->prof,
+                                    (waited ? &wait_start : NULL),
+                                    &glock->prof_acq_time);
+        }
+    }
+#else
+    grp_lock_lock_all(glock);
+    grp_lock_set_owner_thread(glock);
+#endif
+
+    pj_grp_lock_add_ref(glock);
+    return PJ_SUCCESS;
+}
+
+static pj_status_t grp_lock_tryacquire(LOCK_OBJ *p)
+{
+    pj_grp_lock_t *glock = (pj_grp_lock_t*)p;
+    pj_status_t status;
+
+    pj_assert(pj_atomic_get(glock->ref_cnt) > 0);
+
+    status = grp_lock_trylock_all(glock);
+    if (status != PJ_SUCCESS)
+        return status;
+
     grp_lock_set_owner_thread(glock);
+#if PJ_LOCK_PROFILING
+    if (glock->owner_cnt == 1)
+        pj_lock_prof_on_acquire(glock->prof, NULL, &glock->prof_acq_time);
+#endif
     pj_grp_lock_add_ref(glock);
     return PJ_SUCCESS;
 }
@@ -332,6 +380,10 @@ static pj_status_t grp_lock_release(LOCK_OBJ *p)
     pj_grp_lock_t *glock = (pj_grp_lock_t*)p;
     grp_lock_item *lck;
 
+#if PJ_LOCK_PROFILING
+    if (glock->owner_cnt == 1)
+        pj_lock_prof_on_release(glock->prof, &glock->prof_acq_time);
+#endif
     grp_lock_unset_owner_thread(glock);
 
     lck = glock->lock_list.prev;
@@ -414,16 +466,28 @@ PJ_DEF(pj_status_t) pj_grp_lock_create( pj_pool_t *pool,
     pj_grp_lock_t *glock;
     grp_lock_item *own_lock;
     pj_status_t status;
+#if PJ_LOCK_PROFILING
+    char prof_name[PJ_MAX_OBJ_NAME];
+#endif
 
     PJ_ASSERT_RETURN(pool && p_grp_lock, PJ_EINVAL);
 
     PJ_UNUSED_ARG(cfg);
 
+#if PJ_LOCK_PROFILING
+    /* Group locks are profiled by the name of the owner's pool */
+    pj_ansi_strxcpy(prof_name, "grp:", sizeof(prof_name));
+    pj_ansi_strxcat(prof_name, pool->obj_name, sizeof(prof_name));
+#endif
+
     pool = pj_pool_create(pool->factory, "glck%p", 512, 512, NULL);
     if (!pool)
         return PJ_ENOMEM;
 
     glock = PJ_POOL_ZALLOC_T(pool, pj_grp_lock_t);
+#if PJ_LOCK_PROFILING
+    glock->prof = pj_lock_prof_register(prof_name);
+#endif
     glock->base.lock_object = glock;
     glock->base.acquire = &grp_lock_acquire;
     glock->base.tryacquire = &grp_lock_tryacquire;
@@ -767,3 +831,471 @@ PJ_DEF(void) pj_grp_lock_dump(pj_grp_lock_t *grp_lock)
                grp_lock, pj_grp_lock_get_ref(grp_lock)));
 #endif
 }
+
+
+/******************************************************************************
+ * Sequence lock.
+ */
+
+/* Number of times a reader spins on an active writer before yielding */
+#define SEQLOCK_SPIN_CNT        100
+
+struct pj_seqlock_t
+{
+    pj_mutex_t          *mutex;
+    unsigned             seq;
+};
+
+PJ_DEF(pj_status_t) pj_seqlock_create(pj_pool_t *pool,
+                                      const char *name,
+                                      pj_seqlock_t **p_lock)
+{
+    pj_seqlock_t *lock;
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(pool && p_lock, PJ_EINVAL);
+
+    lock = PJ_POOL_ZALLOC_T(pool, pj_seqlock_t);
+    PJ_ASSERT_RETURN(lock, PJ_ENOMEM);
+
+    status = pj_mutex_create_simple(pool, (name? name : "seql%p"),
+                                    &lock->mutex);
+    if (status != PJ_SUCCESS)
+        return status;
+
+    *p_lock = lock;
+    return PJ_SUCCESS;
+}
+
+PJ_DEF(pj_status_t) pj_seqlock_destroy(pj_seqlock_t *lock)
+{
+    PJ_ASSERT_RETURN(lock, PJ_EINVAL);
+    return pj_mutex_destroy(lock->mutex);
+}
+
+#if PJ_ATOMIC_USE_INTRINSICS
+
+PJ_DEF(unsigned) pj_seqlock_read_begin(pj_seqlock_t *lock)
+{
+    unsigned seq, spin = 0;
+
+    /* An odd sequence number means a writer is in progress */
+    while ((seq = __atomic_load_n(&lock->seq, __ATOMIC_ACQUIRE)) & 1) {
+        if (++spin == SEQLOCK_SPIN_CNT) {
+            pj_thread_sleep(0);
+            spin = 0;
+        }
+    }
+    return seq;
+}
+
+PJ_DEF(pj_bool_t) pj_seqlock_read_retry(pj_seqlock_t *lock, unsigned seq)
+{
+    /* Make sure the reads of the record complete before the sequence
+     * number is checked again.
+     */
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&lock->seq, __ATOMIC_RELAXED) != seq;
+}
+
+PJ_DEF(pj_status_t) pj_seqlock_write_lock(pj_seqlock_t *lock)
+{
+    pj_status_t status;
+
+    status = pj_mutex_lock(lock->mutex);
+    if (status != PJ_SUCCESS)
+        return status;
+
+    __atomic_store_n(&lock->seq, lock->seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    return PJ_SUCCESS;
+}
+
+PJ_DEF(pj_status_t) pj_seqlock_write_unlock(pj_seqlock_t *lock)
+{
+    __atomic_store_n(&lock->seq, lock->seq + 1, __ATOMIC_RELEASE);
+    return pj_mutex_unlock(lock->mutex);
+}
+
+#else   /* PJ_ATOMIC_USE_INTRINSICS */
+
+/* Without memory ordering primitives readers simply take the mutex for
+ * the duration of the read section.
+ */
+PJ_DEF(unsigned) pj_seqlock_read_begin(pj_seqlock_t *lock)
+{
+    pj_mutex_lock(lock->mutex);
+    return lock->seq;
+}
+
+PJ_DEF(pj_bool_t) pj_seqlock_read_retry(pj_seqlock_t *lock, unsigned seq)
+{
+    PJ_UNUSED_ARG(seq);
+    pj_mutex_unlock(lock->mutex);
+    return PJ_FALSE;
+}
+
+PJ_DEF(pj_status_t) pj_seqlock_write_lock(pj_seqlock_t *lock)
+{
+    pj_status_t status;
+
+    status = pj_mutex_lock(lock->mutex);
+    if (status == PJ_SUCCESS)
+        ++lock->seq;
+    return status;
+}
+
+PJ_DEF(pj_status_t) pj_seqlock_write_unlock(pj_seqlock_t *lock)
+{
+    ++lock->seq;
+    return pj_mutex_unlock(lock->mutex);
+}
+
+#endif  /* PJ_ATOMIC_USE_INTRINSICS */
+
+
+/******************************************************************************
+ * Lock profiling.
+ */
+
+/* Profiling record. Times are in timestamp ticks. */
+struct pj_lock_prof_entry
+{
+    char                 name[PJ_MAX_OBJ_NAME];
+    pj_uint32_t          acq_cnt;
+    pj_uint32_t          contended_cnt;
+    pj_uint64_t          wait_total;
+    pj_uint64_t          wait_max;
+    pj_uint64_t          hold_total;
+    pj_uint64_t          hold_max;
+    pj_uint32_t          hold_hist[PJ_LOCK_PROF_HIST_CNT];
+};
+
+static pj_lock_prof_entry prof_entry[PJ_LOCK_PROF_MAX_ENTRY];
+static unsigned prof_cnt;
+static pj_uint64_t prof_freq;
+static pj_uint64_t prof_hist_bound[PJ_LOCK_PROF_HIST_CNT-1];
+
+#if PJ_LOCK_PROFILING && PJ_ATOMIC_USE_INTRINSICS
+
+#define PROF_ADD(var, val)  __atomic_fetch_add(&(var), val, __ATOMIC_RELAXED)
+
+static void prof_max(pj_uint64_t *var, pj_uint64_t val)
+{
+    pj_uint64_t cur = __atomic_load_n(var, __ATOMIC_RELAXED);
+
+    while (val > cur &&
+           !__atomic_compare_exchange_n(var, &cur, val, PJ_TRUE,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+    {
+    }
+}
+
+#else
+
+#define PROF_ADD(var, val)  ((var) += (val))
+
+static void prof_max(pj_uint64_t *var, pj_uint64_t val)
+{
+    if (val > *var)
+        *var = val;
+}
+
+#endif
+
+static pj_bool_t is_hex(char c)
+{
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') ||
+           (c >= 'A' && c <= 'F');
+}
+
+/* Make the record key from a lock name: name templates are used as is,
+ * otherwise the pointer value printed at the end of the name is removed.
+ */
+static void prof_make_key(const char *name, char key[PJ_MAX_OBJ_NAME])
+{
+    pj_size_t len = pj_ansi_strlen(name);
+
+    if (!pj_ansi_strchr(name, '%')) {
+        pj_size_t hex = len;
+
+        while (hex > 0 && is_hex(name[hex-1]))
+            --hex;
+
+        if (hex >= 2 && hex < len && name[hex-2] == '0' &&
+            (name[hex-1] == 'x' || name[hex-1] == 'X'))
+        {
+            /* "0x" followed by hex digits */
+            len = hex - 2;
+        } else if (hex > 0 && hex < len && len - hex >= 8) {
+            /* Pointer printed without the "0x" prefix */
+            len = hex;
+        }
+    }
+
+    if (len == 0)
+        len = pj_ansi_strlen(name);
+    if (len >= PJ_MAX_OBJ_NAME)
+        len = PJ_MAX_OBJ_NAME - 1;
+
+    pj_memcpy(key, name, len);
+    key[len] = '\0';
+}
+
+PJ_DEF(pj_lock_prof_entry*) pj_lock_prof_register(const char *name)
+{
+    char key[PJ_MAX_OBJ_NAME];
+    pj_lock_prof_entry *entry = NULL;
+    unsigned i;
+
+    prof_make_key(name ? name : "(noname)", key);
+
+    pj_enter_critical_section();
+
+    if (prof_freq == 0) {
+        pj_timestamp freq;
+        pj_uint64_t usec = 1;
+
+        pj_get_timestamp_freq(&freq);
+        prof_freq = freq.u64;
+        for (i=0; i<PJ_ARRAY_SIZE(prof_hist_bound); ++i) {
+            prof_hist_bound[i] = prof_freq * usec / 1000000;
+            usec *= 4;
+        }
+    }
+
+    for (i=0; i<prof_cnt; ++i) {
+        if (pj_ansi_strcmp(prof_entry[i].name, key) == 0) {
+            entry = &prof_entry[i];
+            break;
+        }
+    }
+
+    if (!entry) {
+        if (prof_cnt < PJ_LOCK_PROF_MAX_ENTRY - 1) {
+            entry = &prof_entry[prof_cnt++];
+            pj_ansi_strxcpy(entry->name, key, sizeof(entry->name));
+        } else {
+            /* Table is full, the last record takes the rest */
+            entry = &prof_entry[PJ_LOCK_PROF_MAX_ENTRY - 1];
+            if (prof_cnt < PJ_LOCK_PROF_MAX_ENTRY) {
+                pj_ansi_strxcpy(entry->name, "(other)", sizeof(entry->name));
+                prof_cnt = PJ_LOCK_PROF_MAX_ENTRY;
+            }
+        }
+    }
+
+    pj_leave_critical_section();
+
+    return entry;
+}
+
+PJ_DEF(void) pj_lock_prof_on_acquire(pj_lock_prof_entry *entry,
+                                     const pj_timestamp *wait_start,
+                                     pj_timestamp *acq_time)
+{
+    pj_get_timestamp(acq_time);
+
+    PROF_ADD(entry->acq_cnt, 1);
+    if (wait_start) {
+        pj_uint64_t wait = acq_time->u64 - wait_start->u64;
+
+        PROF_ADD(entry->contended_cnt, 1);
+        PROF_ADD(entry->wait_total, wait);
+        prof_max(&entry->wait_max, wait);
+    }
+}
+
+PJ_DEF(void) pj_lock_prof_on_release(pj_lock_prof_entry *entry,
+                                     const pj_timestamp *acq_time)
+{
+    pj_timestamp now;
+    pj_uint64_t hold;
+    unsigned i = 0;
+
+    pj_get_timestamp(&now);
+    hold = now.u64 - acq_time->u64;
+
+    PROF_ADD(entry->hold_total, hold);
+    prof_max(&entry->hold_max, hold);
+
+    while (i < PJ_ARRAY_SIZE(prof_hist_bound) && hold >= prof_hist_bound[i])
+        ++i;
+    PROF_ADD(entry->hold_hist[i], 1);
+}
+
+/* Convert timestamp ticks to nanoseconds without overflowing */
+static pj_uint64_t prof_nsec(pj_uint64_t ticks)
+{
+    if (prof_freq == 0)
+        return 0;
+    return (ticks / prof_freq) * 1000000000 +
+           (ticks % prof_freq) * 1000000000 / prof_freq;
+}
+
+static void prof_get_entry_stat(const pj_lock_prof_entry *e,
+                                pj_lock_prof_stat *st)
+{
+    pj_ansi_strxcpy(st->name, e->name, sizeof(st->name));
+    st->acq_cnt = e->acq_cnt;
+    st->contended_cnt = e->contended_cnt;
+    st->wait_total_nsec = prof_nsec(e->wait_total);
+    st->wait_max_nsec = prof_nsec(e->wait_max);
+    st->hold_total_nsec = prof_nsec(e->hold_total);
+    st->hold_max_nsec = prof_nsec(e->hold_max);
+    pj_memcpy(st->hold_hist, e->hold_hist, sizeof(st->hold_hist));
+}
+
+PJ_DEF(pj_status_t) pj_lock_prof_get_stat(pj_lock_prof_stat stat[],
+                                          unsigned *count)
+{
+    unsigned i, cnt;
+
+    PJ_ASSERT_RETURN(stat && count, PJ_EINVAL);
+
+    pj_enter_critical_section();
+
+    cnt = (*count < prof_cnt) ? *count : prof_cnt;
+    for (i=0; i<cnt; ++i)
+        prof_get_entry_stat(&prof_entry[i], &stat[i]);
+
+    *count = cnt;
+    cnt = prof_cnt;
+
+    pj_leave_critical_section();
+
+    return (cnt > *count) ? PJ_ETOOSMALL : PJ_SUCCESS;
+}
+
+PJ_DEF(void) pj_lock_prof_reset(void)
+{
+    unsigned i;
+
+    pj_enter_critical_section();
+    for (i=0; i<prof_cnt; ++i) {
+        pj_lock_prof_entry *e = &prof_entry[i];
+
+        e->acq_cnt = e->contended_cnt = 0;
+        e->wait_total = e->wait_max = 0;
+        e->hold_total = e->hold_max = 0;
+        pj_bzero(e->hold_hist, sizeof(e->hold_hist));
+    }
+    pj_leave_critical_section();
+}
+
+PJ_DEF(void) pj_lock_prof_dump(pj_bool_t detail)
+{
+    unsigned i, j;
+
+#if !PJ_LOCK_PROFILING
+    PJ_LOG(3,(THIS_FILE, "Lock profiling is disabled (PJ_LOCK_PROFILING)"));
+#endif
+
+    pj_enter_critical_section();
+
+    PJ_LOG(3,(THIS_FILE, "Lock profile, %d lock names:", prof_cnt));
+    PJ_LOG(3,(THIS_FILE, "  %-16s %10s %8s %10s %9s %10s %9s",
+              "name", "acquired", "waited", "wait avg", "wait max",
+              "hold avg", "hold max"));
+
+    for (i=0; i<prof_cnt; ++i) {
+        pj_lock_prof_stat st;
+
+        prof_get_entry_stat(&prof_entry[i], &st);
+        if (st.acq_cnt == 0)
+            continue;
+
+        PJ_LOG(3,(THIS_FILE,
+                  "  %-16s %10u %8u %8uus %7uus %8uus %7uus",
+                  st.name, st.acq_cnt, st.contended_cnt,
+                  (unsigned)(st.contended_cnt ?
+                             st.wait_total_nsec/st.contended_cnt/1000 : 0),
+                  (unsigned)(st.wait_max_nsec / 1000),
+                  (unsigned)(st.hold_total_nsec / st.acq_cnt / 1000),
+                  (unsigned)(st.hold_max_nsec / 1000)));
+
+        if (detail) {
+            char line[160];
+            int len = 0;
+
+            for (j=0; j<PJ_LOCK_PROF_HIST_CNT && len>=0 &&
+                      len < (int)sizeof(line); ++j)
+            {
+                len += pj_ansi_snprintf(line+len, sizeof(line)-len, " %u",
+                                        st.hold_hist[j]);
+            }
+            PJ_LOG(3,(THIS_FILE, "    hold histogram (<1us, x4 ...):%s",
+                      line));
+        }
+    }
+
+    pj_leave_critical_section();
+}
+
+/* Append to the export buffer, returns PJ_FALSE when it is full */
+static pj_bool_t prof_append(char *buf, pj_size_t size, pj_size_t *len,
+                             const char *fmt, ...)
+{
+    va_list arg;
+    int n;
+
+    va_start(arg, fmt);
+    n = pj_ansi_vsnprintf(buf + *len, size - *len, fmt, arg);
+    va_end(arg);
+
+    if (n < 0 || (pj_size_t)n >= size - *len)
+        return PJ_FALSE;
+
+    *len += n;
+    return PJ_TRUE;
+}
+
+PJ_DEF(pj_ssize_t) pj_lock_prof_export(char *buf, pj_size_t size)
+{
+    pj_size_t len = 0;
+    pj_bool_t ok;
+    unsigned i, j;
+    pj_uint32_t bound = 1;
+
+    PJ_ASSERT_RETURN(buf && size, -1);
+
+    ok = prof_append(buf, size, &len, "{\"hist_bound_usec\":[");
+    for (j=0; ok && j<PJ_LOCK_PROF_HIST_CNT-1; ++j) {
+        ok = prof_append(buf, size, &len, "%s%u", (j ? "," : ""), bound);
+        bound *= 4;
+    }
+    if (ok)
+        ok = prof_append(buf, size, &len, "],\"locks\":[");
+
+    pj_enter_critical_section();
+
+    for (i=0; ok && i<prof_cnt; ++i) {
+        pj_lock_prof_stat st;
+
+        prof_get_entry_stat(&prof_entry[i], &st);
+        ok = prof_append(buf, size, &len,
+                         "%s{\"name\":\"%s\",\"acq\":%u,\"contended\":%u,"
+                         "\"wait_total_ns\":%" PJ_INT64_FMT "u,"
+                         "\"wait_max_ns\":%" PJ_INT64_FMT "u,"
+                         "\"hold_total_ns\":%" PJ_INT64_FMT "u,"
+                         "\"hold_max_ns\":%" PJ_INT64_FMT "u,"
+                         "\"hold_hist\":[",
+                         (i ? "," : ""), st.name, st.acq_cnt,
+                         st.contended_cnt, st.wait_total_nsec,
+                         st.wait_max_nsec, st.hold_total_nsec,
+                         st.hold_max_nsec);
+        for (j=0; ok && j<PJ_LOCK_PROF_HIST_CNT; ++j) {
+            ok = prof_append(buf, size, &len, "%s%u", (j ? "," : ""),
+                             st.hold_hist[j]);
+        }
+        if (ok)
+            ok = prof_append(buf, size, &len, "]}");
+    }
+
+    pj_leave_critical_section();
+
+    if (ok)
+        ok = prof_append(buf, size, &len, "]}");
+
+    return ok ? (pj_ssize_t)len : -1;
+}
@@ -18,6 +18,9 @@
  */
 #include <pj/types.h>
 #include <pj/log.h>
+#include <pj/assert.h>
+#include <pj/errno.h>
+#include <pj/pool.h>
 #include <pj/string.h>
 #include <pj/os.h>
 #include <pj/compat/stdarg.h>
@@ -83,9 +86,472 @@ static char log_buffer[PJ_LOG_MAX_SIZE];
 
 #define LOG_MAX_INDENT          80
 
+#if PJ_HAS_THREADS
+/*
+ * Asynchronous logging.
+ *
+ * The queue is an array of slots, each with a sequence number, that the
+ * logging threads fill and the log thread drains. A message takes as
+ * many consecutive slots as it needs. A logging thread claims the slots
+ * by advancing enq_pos with compare-and-swap once it sees that the last
+ * of them has been released by the log thread (the log thread releases
+ * the slots in order, so then all of them are free). It then copies the
+ * message and publishes it by setting the sequence number of the first
+ * slot to its position plus one. The log thread releases each slot by
+ * setting its sequence number to its position plus the queue size.
+ */
+
+#define ASYNC_SLOT_SIZE         128
+#define ASYNC_MIN_SLOTS         (2 * PJ_LOG_MAX_SIZE / ASYNC_SLOT_SIZE)
+
+/* Header of a message in the first slot */
+typedef struct async_hdr
+{
+    int                  level;
+    int                  len;
+} async_hdr;
+
+#define ASYNC_SLOT_CNT(len) \
+            ((unsigned)(sizeof(async_hdr) + (len) + ASYNC_SLOT_SIZE - 1) / \
+             ASYNC_SLOT_SIZE)
+
+static struct async_log
+{
+    pj_pool_t           *pool;
+    pj_thread_t         *thread;
+    pj_sem_t            *sem;
+
+    unsigned             sleeping;
+    pj_bool_t            quit;
+
+    unsigned             capacity;      /* Number of slots              */
+    unsigned             mask;
+    unsigned            *seq;
+    char                *buf;
+    unsigned             enq_pos;
+    unsigned             deq_pos;       /* Owned by the log thread      */
+    unsigned             done_pos;      /* Passed to the writer         */
+
+    char                *batch;
+    unsigned             batch_size;
+    unsigned             batch_len;
+    int                  batch_level;
+
+    pj_log_async_stat    stat;
+    pj_uint32_t          dropped_reported;
+} async_log;
+
+/* Kept out of async_log as they are accessed by the logging threads
+ * before they know whether the queue exists.
+ */
+static unsigned async_running;
+static unsigned async_users;
+
+#if PJ_ATOMIC_USE_INTRINSICS
+
+#   define AL_LOAD(p)           __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#   define AL_STORE(p, v)       __atomic_store_n(p, v, __ATOMIC_RELEASE)
+#   define AL_ADD(p, v)         __atomic_add_fetch(p, v, __ATOMIC_SEQ_CST)
+#   define AL_XCHG(p, v)        __atomic_exchange_n(p, v, __ATOMIC_SEQ_CST)
+#   define AL_CAS(p, old, v)    __atomic_compare_exchange_n(p, old, v, 0, \
+                                                __ATOMIC_ACQ_REL, \
+                                                __ATOMIC_ACQUIRE)
+#   define AL_FENCE()           __atomic_thread_fence(__ATOMIC_SEQ_CST)
+
+#else   /* PJ_ATOMIC_USE_INTRINSICS */
+
+/* Without atomics, the queue positions are protected with the PJLIB
+ * critical section.
+ */
+static unsigned al_rmw(unsigned *p, unsigned v, int op)
+{
+    unsigned old;
+
+    pj_enter_critical_section();
+    old = *p;
+    if (op == 0)
+        *p = v;
+    else if (op == 1)
+        *p = old + v;
+    pj_leave_critical_section();
+    return old;
+}
+
+static unsigned al_add(unsigned *p, unsigned v)
+{
+    return al_rmw(p, v, 1) + v;
+}
+
+static pj_bool_t al_cas(unsigned *p, unsigned *old, unsigned v)
+{
+    pj_bool_t ok;
+
+    pj_enter_critical_section();
+    ok = (*p == *old);
+    if (ok)
+        *p = v;
+    else
+        *old = *p;
+    pj_leave_critical_section();
+    return ok;
+}
+
+#   define AL_LOAD(p)           al_rmw(p, 0, 2)
+#   define AL_STORE(p, v)       al_rmw(p, v, 0)
+#   define AL_ADD(p, v)         al_add(p, v)
+#   define AL_XCHG(p, v)        al_rmw(p, v, 0)
+#   define AL_CAS(p, old, v)    al_cas(p, old, v)
+#   define AL_FENCE()
+
+#endif  /* PJ_ATOMIC_USE_INTRINSICS */
+
+/* Copy between the message and the slots, wrapping at the end of the
+ * queue.
+ */
+static void async_copy(unsigned pos, unsigned offset, void *data,
+                       unsigned len, pj_bool_t to_queue)
+{
+    pj_size_t total = (pj_size_t)async_log.capacity * ASYNC_SLOT_SIZE;
+    pj_size_t start = ((pos & async_log.mask) * ASYNC_SLOT_SIZE + offset) %
+                      total;
+    pj_size_t first = total - start;
+
+    if (first > len)
+        first = len;
+
+    if (to_queue) {
+        pj_memcpy(async_log.buf + start, data, first);
+        pj_memcpy(async_log.buf, (char*)data + first, len - first);
+    } else {
+        pj_memcpy(data, async_log.buf + start, first);
+        pj_memcpy((char*)data + first, async_log.buf, len - first);
+    }
+}
+
+static void async_wake(void)
+{
+    AL_FENCE();
+    if (AL_LOAD(&async_log.sleeping) && AL_XCHG(&async_log.sleeping, 0))
+        pj_sem_post(async_log.sem);
+}
+
+/* Put a message in the queue. Returns PJ_FALSE when the asynchronous
+ * logging is not running and the message must be written directly.
+ */
+static pj_bool_t async_push(int level, const char *data, int len)
+{
+    async_hdr hdr;
+    unsigned cnt, pos, last, seq;
+    pj_bool_t queued = PJ_FALSE;
+
+    if (!async_running)
+        return PJ_FALSE;
+
+    /* Stopping waits until no thread is in here */
+    AL_ADD(&async_users, 1);
+    if (!AL_ADD(&async_running, 0)) {
+        AL_ADD(&async_users, -1);
+        return PJ_FALSE;
+    }
+
+    cnt = ASYNC_SLOT_CNT(len);
+    pos = AL_LOAD(&async_log.enq_pos);
+    for (;;) {
+        int diff;
+
+        last = pos + cnt - 1;
+        seq = AL_LOAD(&async_log.seq[last & async_log.mask]);
+        diff = (int)(seq - last);
+        if (diff == 0) {
+            if (AL_CAS(&async_log.enq_pos, &pos, pos + cnt)) {
+                queued = PJ_TRUE;
+                break;
+            }
+        } else if (diff < 0) {
+            /* Full */
+            break;
+        } else {
+            pos = AL_LOAD(&async_log.enq_pos);
+        }
+    }
+
+    if (queued) {
+        hdr.level = level;
+        hdr.len = len;
+        async_copy(pos, 0, &hdr, sizeof(hdr), PJ_TRUE);
+        async_copy(pos, sizeof(hdr), (void*)data, len, PJ_TRUE);
+        AL_STORE(&async_log.seq[pos & async_log.mask], pos + 1);
+        AL_ADD(&async_log.stat.queued, 1);
+        async_wake();
+    } else {
+        AL_ADD(&async_log.stat.dropped, 1);
+    }
+
+    AL_ADD(&async_users, -1);
+    return PJ_TRUE;
+}
+
+/* Pass the batched messages to the writer */
+static void async_write_batch(void)
+{
+    if (async_log.batch_len) {
+        async_log.batch[async_log.batch_len] = '\0';
+        if (log_writer) {
+            (*log_writer)(async_log.batch_level, async_log.batch,
+                          (int)async_log.batch_len);
+        }
+        async_log.batch_len = 0;
+        ++async_log.stat.write_cnt;
+    }
+    AL_STORE(&async_log.done_pos, async_log.deq_pos);
+}
+
+/* Take the available messages from the queue. Returns the number of
+ * messages taken.
+ */
+static unsigned async_drain(void)
+{
+    unsigned taken = 0;
+    pj_uint32_t dropped;
+
+    for (;;) {
+        unsigned pos = async_log.deq_pos;
+        unsigned i, cnt, used;
+        async_hdr hdr;
+
+        if (AL_LOAD(&async_log.seq[pos & async_log.mask]) != pos + 1)
+            break;
+
+        used = AL_LOAD(&async_log.enq_pos) - pos;
+        if (used * ASYNC_SLOT_SIZE > async_log.stat.max_used)
+            async_log.stat.max_used = used * ASYNC_SLOT_SIZE;
+
+        async_copy(pos, 0, &hdr, sizeof(hdr), PJ_FALSE);
+        if (async_log.batch_len &&
+            (hdr.level != async_log.batch_level ||
+             async_log.batch_len + hdr.len > async_log.batch_size))
+        {
+            async_write_batch();
+        }
+        async_copy(pos, sizeof(hdr), async_log.batch + async_log.batch_len,
+                   hdr.len, PJ_FALSE);
+        async_log.batch_len += hdr.len;
+        async_log.batch_level = hdr.level;
+
+        /* Release the slots */
+        cnt = ASYNC_SLOT_CNT(hdr.len);
+        for (i=0; i<cnt; ++i) {
+            AL_STORE(&async_log.seq[(pos + i) & async_log.mask],
+                     pos + i + async_log.capacity);
+        }
+        async_log.deq_pos = pos + cnt;
+        ++async_log.stat.written;
+        ++taken;
+    }
+
+    async_write_batch();
+
+    /* Report the messages dropped since the last report */
+    dropped = AL_ADD(&async_log.stat.dropped, 0);
+    if (dropped != async_log.dropped_reported && log_writer) {
+        char msg[80];
+        int len;
+
+        len = pj_ansi_snprintf(msg, sizeof(msg),
+                               "<%u log messages dropped>%s",
+                               dropped - async_log.dropped_reported,
+                               (log_decor & PJ_LOG_HAS_NEWLINE) ? "\n" : "");
+        async_log.dropped_reported = dropped;
+        (*log_writer)(2, msg, len);
+    }
+
+    return taken;
+}
+
+static int async_log_thread(void *arg)
+{
+    PJ_UNUSED_ARG(arg);
+
+    for (;;) {
+        async_drain();
+
+        AL_XCHG(&async_log.sleeping, 1);
+        AL_FENCE();
+        if (async_log.quit ||
+            AL_LOAD(&async_log.seq[async_log.deq_pos & async_log.mask]) ==
+                async_log.deq_pos + 1)
+        {
+            AL_XCHG(&async_log.sleeping, 0);
+            if (async_log.quit) {
+                /* Writers may have been in the middle of queueing */
+                while (AL_ADD(&async_users, 0))
+                    pj_thread_sleep(0);
+                async_drain();
+                break;
+            }
+            continue;
+        }
+
+        pj_sem_wait(async_log.sem);
+    }
+
+    return 0;
+}
+
+PJ_DEF(void) pj_log_async_param_default(pj_log_async_param *prm)
+{
+    pj_bzero(prm, sizeof(*prm));
+    prm->buf_size = PJ_LOG_ASYNC_BUF_SIZE;
+    prm->batch_size = PJ_LOG_ASYNC_BATCH_SIZE;
+}
+
+PJ_DEF(pj_status_t) pj_log_async_start(pj_pool_factory *pf,
+                                       const pj_log_async_param *prm)
+{
+    pj_log_async_param def_prm;
+    pj_pool_t *pool;
+    unsigned i, cap, slots;
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(pf, PJ_EINVAL);
+    PJ_ASSERT_RETURN(async_log.pool == NULL, PJ_EINVALIDOP);
+
+    if (!prm) {
+        pj_log_async_param_default(&def_prm);
+        prm = &def_prm;
+    }
+
+    slots = prm->buf_size / ASYNC_SLOT_SIZE;
+    PJ_ASSERT_RETURN(slots >= ASYNC_MIN_SLOTS, PJ_ETOOSMALL);
+    for (cap = 1; cap < slots; cap <<= 1)
+        ;
+
+    pool = pj_pool_create(pf, "asynclog", 4000, 4000, NULL);
+    if (!pool)
+        return PJ_ENOMEM;
+
+    pj_bzero(&async_log, sizeof(async_log));
+    async_log.pool = pool;
+    async_log.capacity = cap;
+    async_log.mask = cap - 1;
+    async_log.seq = (unsigned*) pj_pool_alloc(pool, cap * sizeof(unsigned));
+    async_log.buf = (char*) pj_pool_alloc(pool, cap * ASYNC_SLOT_SIZE);
+    async_log.batch_size = prm->batch_size;
+    i = (prm->batch_size > PJ_LOG_MAX_SIZE) ? prm->batch_size :
+                                               PJ_LOG_MAX_SIZE;
+    async_log.batch = (char*) pj_pool_alloc(pool, i + 1);
+    for (i=0; i<cap; ++i)
+        async_log.seq[i] = i;
+
+    status = pj_sem_create(pool, "asynclog", 0, 1, &async_log.sem);
+    if (status != PJ_SUCCESS)
+        goto on_error;
+
+    status = pj_thread_create(pool, "asynclog", &async_log_thread, NULL,
+                              0, 0, &async_log.thread);
+    if (status != PJ_SUCCESS)
+        goto on_error;
+
+    AL_XCHG(&async_running, 1);
+    return PJ_SUCCESS;
+
+on_error:
+    if (async_log.sem)
+        pj_sem_destroy(async_log.sem);
+    pj_pool_release(pool);
+    pj_bzero(&async_log, sizeof(async_log));
+    return status;
+}
+
+PJ_DEF(pj_status_t) pj_log_async_stop(void)
+{
+    if (async_log.pool == NULL)
+        return PJ_SUCCESS;
+
+    /* New messages are written directly from now */
+    AL_XCHG(&async_running, 0);
+
+    async_log.quit = PJ_TRUE;
+    AL_XCHG(&async_log.sleeping, 0);
+    pj_sem_post(async_log.sem);
+
+    pj_thread_join(async_log.thread);
+    pj_thread_destroy(async_log.thread);
+    pj_sem_destroy(async_log.sem);
+    pj_pool_release(async_log.pool);
+    async_log.pool = NULL;
+
+    return PJ_SUCCESS;
+}
+
+PJ_DEF(void) pj_log_async_flush(void)
+{
+    unsigned target;
+
+    if (!async_running ||
+        (pj_thread_is_registered() && pj_thread_this() == async_log.thread))
+    {
+        return;
+    }
+
+    target = AL_LOAD(&async_log.enq_pos);
+    while (AL_LOAD(&async_running) &&
+           (int)(target - AL_LOAD(&async_log.done_pos)) > 0)
+    {
+        if (AL_XCHG(&async_log.sleeping, 0))
+            pj_sem_post(async_log.sem);
+        pj_thread_sleep(1);
+    }
+}
+
+PJ_DEF(pj_status_t) pj_log_async_get_stat(pj_log_async_stat *stat)
+{
+    PJ_ASSERT_RETURN(stat, PJ_EINVAL);
+
+    pj_memcpy(stat, &async_log.stat, sizeof(*stat));
+    return PJ_SUCCESS;
+}
+
+#else   /* PJ_HAS_THREADS */
+
+PJ_DEF(void) pj_log_async_param_default(pj_log_async_param *prm)
+{
+    pj_bzero(prm, sizeof(*prm));
+    prm->buf_size = PJ_LOG_ASYNC_BUF_SIZE;
+    prm->batch_size = PJ_LOG_ASYNC_BATCH_SIZE;
+}
+
+PJ_DEF(pj_status_t) pj_log_async_start(pj_pool_factory *pf,
+                                       const pj_log_async_param *prm)
+{
+    PJ_UNUSED_ARG(pf);
+    PJ_UNUSED_ARG(prm);
+    return PJ_ENOTSUP;
+}
+
+PJ_DEF(pj_status_t) pj_log_async_stop(void)
+{
+    return PJ_SUCCESS;
+}
+
+PJ_DEF(void) pj_log_async_flush(void)
+{
+}
+
+PJ_DEF(pj_status_t) pj_log_async_get_stat(pj_log_async_stat *stat)
+{
+    PJ_ASSERT_RETURN(stat, PJ_EINVAL);
+    pj_bzero(stat, sizeof(*stat));
+    return PJ_SUCCESS;
+}
+
+#endif  /* PJ_HAS_THREADS */
+
 #if PJ_HAS_THREADS
 static void logging_shutdown(void)
 {
+    pj_log_async_stop();
+
     if (thread_suspended_tls_id != -1) {
         pj_thread_local_free(thread_suspended_tls_id);
         thread_suspended_tls_id = -1;
@@ -496,8 +962,13 @@ PJ_DEF(void) pj_log( const char *sender, int level,
      */
     resume_logging(&saved_level);
 
-    if (log_writer)
+    if (log_writer) {
+#if PJ_HAS_THREADS
+        if (async_push(level, log_buffer, len))
+            return;
+#endif
         (*log_writer)(level, log_buffer, len);
+    }
 }
 
 /*
@@ -543,6 +543,26 @@ PJ_DEF(pj_status_t) pj_thread_set_prio(pj_thread_t *thread,  int prio)
 }
 
 
+/*
+ * Pin the thread to a CPU core.
+ */
+PJ_DEF(pj_status_t) pj_thread_set_affinity(pj_thread_t *thread, unsigned cpu)
+{
+    PJ_UNUSED_ARG(thread);
+    PJ_UNUSED_ARG(cpu);
+    return PJ_ENOTSUP;
+}
+
+
+/*
+ * Get the number of online CPU cores.
+ */
+PJ_DEF(unsigned) pj_get_cpu_count(void)
+{
+    return 1;
+}
+
+
 /*
  * Get the lowest priority value available on this system.
  */
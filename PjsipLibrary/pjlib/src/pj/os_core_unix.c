@@ -33,6 +33,7 @@
 #include <pj/guid.h>
 #include <pj/except.h>
 #include <pj/errno.h>
+#include <pj/lock.h>
 
 #if defined(PJ_HAS_SEMAPHORE_H) && PJ_HAS_SEMAPHORE_H != 0
 #  include <semaphore.h>
@@ -101,7 +102,9 @@ struct pj_thread_t
 
 struct pj_atomic_t
 {
+#if PJ_HAS_THREADS && !PJ_ATOMIC_USE_INTRINSICS
     pj_mutex_t         *mutex;
+#endif
     pj_atomic_value_t   value;
 };
 
@@ -114,6 +117,11 @@ struct pj_mutex_t
     pj_thread_t        *owner;
     char                owner_name[PJ_MAX_OBJ_NAME];
 #endif
+#if PJ_LOCK_PROFILING
+    pj_lock_prof_entry *prof;
+    int                 prof_nesting;
+    pj_timestamp        prof_acq_time;
+#endif
 };
 
 #if defined(PJ_HAS_SEMAPHORE) && PJ_HAS_SEMAPHORE != 0
@@ -473,6 +481,51 @@ PJ_DEF(pj_status_t) pj_thread_set_prio(pj_thread_t *thread,  int prio)
 }
 
 
+/*
+ * Pin the thread to a CPU core.
+ */
+PJ_DEF(pj_status_t) pj_thread_set_affinity(pj_thread_t *thread, unsigned cpu)
+{
+#if PJ_HAS_THREADS && defined(__linux__) && \
+    !(defined(PJ_ANDROID) && PJ_ANDROID != 0)
+
+    cpu_set_t cpuset;
+    int rc;
+
+    PJ_ASSERT_RETURN(thread, PJ_EINVAL);
+    PJ_ASSERT_RETURN(cpu < CPU_SETSIZE, PJ_EINVAL);
+
+    CPU_ZERO(&cpuset);
+    CPU_SET(cpu, &cpuset);
+
+    rc = pthread_setaffinity_np(thread->thread, sizeof(cpuset), &cpuset);
+    if (rc != 0)
+        return PJ_RETURN_OS_ERROR(rc);
+
+    return PJ_SUCCESS;
+
+#else
+    PJ_UNUSED_ARG(thread);
+    PJ_UNUSED_ARG(cpu);
+    return PJ_ENOTSUP;
+#endif
+}
+
+
+/*
+ * Get the number of online CPU cores.
+ */
+PJ_DEF(unsigned) pj_get_cpu_count(void)
+{
+#if defined(_SC_NPROCESSORS_ONLN)
+    long cnt = sysconf(_SC_NPROCESSORS_ONLN);
+    return (cnt > 0) ? (unsigned)cnt : 1;
+#else
+    return 1;
+#endif
+}
+
+
 /*
  * Get the lowest priority value available on this system.
  */
@@ -1016,6 +1069,93 @@ PJ_DEF(pj_status_t) pj_thread_get_stack_info( pj_thread_t *thread,
 #endif  /* PJ_OS_HAS_CHECK_STACK */
 
 ///////////////////////////////////////////////////////////////////////////////
+#if PJ_HAS_THREADS && PJ_ATOMIC_USE_INTRINSICS
+/*
+ * Lock-free atomic variables using the compiler's __atomic builtins.
+ * All operations are sequentially consistent, which gives the same
+ * ordering guarantees as the mutex based implementation below.
+ */
+
+/*
+ * pj_atomic_create()
+ */
+PJ_DEF(pj_status_t) pj_atomic_create( pj_pool_t *pool,
+                                      pj_atomic_value_t initial,
+                                      pj_atomic_t **ptr_atomic)
+{
+    pj_atomic_t *atomic_var;
+
+    atomic_var = PJ_POOL_ZALLOC_T(pool, pj_atomic_t);
+
+    PJ_ASSERT_RETURN(atomic_var, PJ_ENOMEM);
+
+    __atomic_store_n(&atomic_var->value, initial, __ATOMIC_SEQ_CST);
+
+    *ptr_atomic = atomic_var;
+    return PJ_SUCCESS;
+}
+
+/*
+ * pj_atomic_destroy()
+ */
+PJ_DEF(pj_status_t) pj_atomic_destroy( pj_atomic_t *atomic_var )
+{
+    PJ_ASSERT_RETURN(atomic_var, PJ_EINVAL);
+    return PJ_SUCCESS;
+}
+
+/*
+ * pj_atomic_set()
+ */
+PJ_DEF(void) pj_atomic_set(pj_atomic_t *atomic_var, pj_atomic_value_t value)
+{
+    PJ_CHECK_STACK();
+    PJ_ASSERT_ON_FAIL(atomic_var, return);
+
+    __atomic_store_n(&atomic_var->value, value, __ATOMIC_SEQ_CST);
+}
+
+/*
+ * pj_atomic_get()
+ */
+PJ_DEF(pj_atomic_value_t) pj_atomic_get(pj_atomic_t *atomic_var)
+{
+    PJ_CHECK_STACK();
+
+    return __atomic_load_n(&atomic_var->value, __ATOMIC_SEQ_CST);
+}
+
+/*
+ * pj_atomic_inc_and_get()
+ */
+PJ_DEF(pj_atomic_value_t) pj_atomic_inc_and_get(pj_atomic_t *atomic_var)
+{
+    PJ_CHECK_STACK();
+
+    return __atomic_add_fetch(&atomic_var->value, 1, __ATOMIC_SEQ_CST);
+}
+
+/*
+ * pj_atomic_dec_and_get()
+ */
+PJ_DEF(pj_atomic_value_t) pj_atomic_dec_and_get(pj_atomic_t *atomic_var)
+{
+    PJ_CHECK_STACK();
+
+    return __atomic_sub_fetch(&atomic_var->value, 1, __ATOMIC_SEQ_CST);
+}
+
+/*
+ * pj_atomic_add_and_get()
+ */
+PJ_DEF(pj_atomic_value_t) pj_atomic_add_and_get( pj_atomic_t *atomic_var,
+                                                 pj_atomic_value_t value )
+{
+    return __atomic_add_fetch(&atomic_var->value, value, __ATOMIC_SEQ_CST);
+}
+
+#else   /* PJ_HAS_THREADS && PJ_ATOMIC_USE_INTRINSICS */
+
 /*
  * pj_atomic_create()
  */
@@ -1121,15 +1261,6 @@ PJ_DEF(pj_atomic_value_t) pj_atomic_inc_and_get(pj_atomic_t *atomic_var)
 
     return new_value;
 }
-/*
- * pj_atomic_inc()
- */
-PJ_DEF(void) pj_atomic_inc(pj_atomic_t *atomic_var)
-{
-    PJ_ASSERT_ON_FAIL(atomic_var, return);
-    pj_atomic_inc_and_get(atomic_var);
-}
-
 /*
  * pj_atomic_dec_and_get()
  */
@@ -1150,15 +1281,6 @@ PJ_DEF(pj_atomic_value_t) pj_atomic_dec_and_get(pj_atomic_t *atomic_var)
     return new_value;
 }
 
-/*
- * pj_atomic_dec()
- */
-PJ_DEF(void) pj_atomic_dec(pj_atomic_t *atomic_var)
-{
-    PJ_ASSERT_ON_FAIL(atomic_var, return);
-    pj_atomic_dec_and_get(atomic_var);
-}
-
 /*
  * pj_atomic_add_and_get()
  */
@@ -1181,6 +1303,26 @@ PJ_DEF(pj_atomic_value_t) pj_atomic_add_and_get( pj_atomic_t *atomic_var,
     return new_value;
 }
 
+#endif  /* PJ_HAS_THREADS && PJ_ATOMIC_USE_INTRINSICS */
+
+/*
+ * pj_atomic_inc()
+ */
+PJ_DEF(void) pj_atomic_inc(pj_atomic_t *atomic_var)
+{
+    PJ_ASSERT_ON_FAIL(atomic_var, return);
+    pj_atomic_inc_and_get(atomic_var);
+}
+
+/*
+ * pj_atomic_dec()
+ */
+PJ_DEF(void) pj_atomic_dec(pj_atomic_t *atomic_var)
+{
+    PJ_ASSERT_ON_FAIL(atomic_var, return);
+    pj_atomic_dec_and_get(atomic_var);
+}
+
 /*
  * pj_atomic_add()
  */
@@ -1359,6 +1501,12 @@ static pj_status_t init_mutex(pj_mutex_t *mutex, const char *name, int type)
     mutex->owner_name[0] = '\0';
 #endif
 
+#if PJ_LOCK_PROFILING
+    /* Only mutexes created with pj_mutex_create() are profiled */
+    mutex->prof = NULL;
+    mutex->prof_nesting = 0;
+#endif
+
     /* Set name. */
     if (!name) {
         name = "mtx%p";
@@ -1396,6 +1544,10 @@ PJ_DEF(pj_status_t) pj_mutex_create(pj_pool_t *pool,
     if ((rc=init_mutex(mutex, name, type)) != PJ_SUCCESS)
         return rc;
 
+#if PJ_LOCK_PROFILING
+    mutex->prof = pj_lock_prof_register(name ? name : "mtx%p");
+#endif
+
     *ptr_mutex = mutex;
     return PJ_SUCCESS;
 #else /* PJ_HAS_THREADS */
@@ -1424,6 +1576,32 @@ PJ_DEF(pj_status_t) pj_mutex_create_recursive( pj_pool_t *pool,
     return pj_mutex_create(pool, name, PJ_MUTEX_RECURSE, mutex);
 }
 
+#if PJ_HAS_THREADS && PJ_LOCK_PROFILING
+/*
+ * Lock a profiled mutex, recording whether it had to wait.
+ */
+static int prof_mutex_lock(pj_mutex_t *mutex)
+{
+    pj_timestamp wait_start;
+    pj_bool_t waited = PJ_FALSE;
+    int status;
+
+    status = pthread_mutex_trylock( &mutex->mutex );
+    if (status == EBUSY) {
+        pj_get_timestamp(&wait_start);
+        status = pthread_mutex_lock( &mutex->mutex );
+        waited = PJ_TRUE;
+    }
+
+    if (status == 0 && mutex->prof_nesting++ == 0) {
+        pj_lock_prof_on_acquire(mutex->prof, (waited ? &wait_start : NULL),
+                                &mutex->prof_acq_time);
+    }
+
+    return status;
+}
+#endif
+
 /*
  * pj_mutex_lock()
  */
@@ -1444,6 +1622,11 @@ PJ_DEF(pj_status_t) pj_mutex_lock(pj_mutex_t *mutex)
                                 pj_thread_this()->obj_name));
 #endif
 
+#if PJ_LOCK_PROFILING
+    if (mutex->prof)
+        status = prof_mutex_lock(mutex);
+    else
+#endif
     status = pthread_mutex_lock( &mutex->mutex );
 
 
@@ -1503,6 +1686,11 @@ PJ_DEF(pj_status_t) pj_mutex_unlock(pj_mutex_t *mutex)
                                 pj_thread_this()->obj_name));
 #endif
 
+#if PJ_LOCK_PROFILING
+    if (mutex->prof && --mutex->prof_nesting == 0)
+        pj_lock_prof_on_release(mutex->prof, &mutex->prof_acq_time);
+#endif
+
     status = pthread_mutex_unlock( &mutex->mutex );
     if (status == 0)
         return PJ_SUCCESS;
@@ -1532,6 +1720,10 @@ PJ_DEF(pj_status_t) pj_mutex_trylock(pj_mutex_t *mutex)
     status = pthread_mutex_trylock( &mutex->mutex );
 
     if (status==0) {
+#if PJ_LOCK_PROFILING
+        if (mutex->prof && mutex->prof_nesting++ == 0)
+            pj_lock_prof_on_acquire(mutex->prof, NULL, &mutex->prof_acq_time);
+#endif
 #if PJ_DEBUG
         mutex->owner = pj_thread_this();
         pj_ansi_strxcpy(mutex->owner_name, mutex->owner->obj_name,
@@ -341,6 +341,40 @@ PJ_DEF(pj_status_t) pj_thread_set_prio(pj_thread_t *thread,  int prio)
 }
 
 
+/*
+ * Pin the thread to a CPU core.
+ */
+PJ_DEF(pj_status_t) pj_thread_set_affinity(pj_thread_t *thread, unsigned cpu)
+{
+#if PJ_HAS_THREADS && !(defined(PJ_WIN32_WINPHONE8) && PJ_WIN32_WINPHONE8)
+    PJ_ASSERT_RETURN(thread, PJ_EINVAL);
+    PJ_ASSERT_RETURN(cpu < sizeof(DWORD_PTR) * 8, PJ_EINVAL);
+
+    if (SetThreadAffinityMask(thread->hthread, ((DWORD_PTR)1) << cpu) == 0)
+        return PJ_RETURN_OS_ERROR(GetLastError());
+
+    return PJ_SUCCESS;
+
+#else
+    PJ_UNUSED_ARG(thread);
+    PJ_UNUSED_ARG(cpu);
+    return PJ_ENOTSUP;
+#endif
+}
+
+
+/*
+ * Get the number of online CPU cores.
+ */
+PJ_DEF(unsigned) pj_get_cpu_count(void)
+{
+    SYSTEM_INFO si;
+
+    GetSystemInfo(&si);
+    return si.dwNumberOfProcessors ? si.dwNumberOfProcessors : 1;
+}
+
+
 /*
  * Get the lowest priority value available on this system.
  */
@@ -1208,9 +1242,94 @@ PJ_DEF(pj_bool_t) pj_mutex_is_locked(pj_mutex_t *mutex)
 
 ///////////////////////////////////////////////////////////////////////////////
 /*
- * Win32 lacks Read/Write mutex, so include the emulation.
+ * Include the Read/Write mutex emulation unless slim reader/writer lock
+ * is enabled (see PJ_EMULATE_RWMUTEX in os_win32.h).
+ */
+#if defined(PJ_EMULATE_RWMUTEX) && PJ_EMULATE_RWMUTEX!=0
+#   include "os_rwmutex.c"
+#else
+struct pj_rwmutex_t
+{
+    SRWLOCK     lock;
+};
+
+/*
+ * Create reader/writer mutex.
+ *
+ */
+PJ_DEF(pj_status_t) pj_rwmutex_create(pj_pool_t *pool, const char *name,
+                                      pj_rwmutex_t **p_mutex)
+{
+    pj_rwmutex_t *rwm;
+
+    PJ_ASSERT_RETURN(pool && p_mutex, PJ_EINVAL);
+    PJ_UNUSED_ARG(name);
+
+    rwm = PJ_POOL_ALLOC_T(pool, pj_rwmutex_t);
+    PJ_ASSERT_RETURN(rwm, PJ_ENOMEM);
+
+    InitializeSRWLock(&rwm->lock);
+
+    *p_mutex = rwm;
+    return PJ_SUCCESS;
+}
+
+/*
+ * Lock the mutex for reading.
+ *
+ */
+PJ_DEF(pj_status_t) pj_rwmutex_lock_read(pj_rwmutex_t *mutex)
+{
+    PJ_ASSERT_RETURN(mutex, PJ_EINVAL);
+    AcquireSRWLockShared(&mutex->lock);
+    return PJ_SUCCESS;
+}
+
+/*
+ * Lock the mutex for writing.
+ *
+ */
+PJ_DEF(pj_status_t) pj_rwmutex_lock_write(pj_rwmutex_t *mutex)
+{
+    PJ_ASSERT_RETURN(mutex, PJ_EINVAL);
+    AcquireSRWLockExclusive(&mutex->lock);
+    return PJ_SUCCESS;
+}
+
+/*
+ * Release read lock.
+ *
  */
-#include "os_rwmutex.c"
+PJ_DEF(pj_status_t) pj_rwmutex_unlock_read(pj_rwmutex_t *mutex)
+{
+    PJ_ASSERT_RETURN(mutex, PJ_EINVAL);
+    ReleaseSRWLockShared(&mutex->lock);
+    return PJ_SUCCESS;
+}
+
+/*
+ * Release write lock.
+ *
+ */
+PJ_DEF(pj_status_t) pj_rwmutex_unlock_write(pj_rwmutex_t *mutex)
+{
+    PJ_ASSERT_RETURN(mutex, PJ_EINVAL);
+    ReleaseSRWLockExclusive(&mutex->lock);
+    return PJ_SUCCESS;
+}
+
+/*
+ * Destroy reader/writer mutex.
+ *
+ */
+PJ_DEF(pj_status_t) pj_rwmutex_destroy(pj_rwmutex_t *mutex)
+{
+    /* SRW lock doesn't need to be destroyed */
+    PJ_ASSERT_RETURN(mutex, PJ_EINVAL);
+    return PJ_SUCCESS;
+}
+
+#endif  /* PJ_EMULATE_RWMUTEX */
 
 ///////////////////////////////////////////////////////////////////////////////
 /*
@@ -37,6 +37,35 @@ static void cpool_dump_status(pj_pool_factory *factory, pj_bool_t detail );
 static pj_bool_t cpool_on_block_alloc(pj_pool_factory *f, pj_size_t sz);
 static void cpool_on_block_free(pj_pool_factory *f, pj_size_t sz);
 
+#if PJ_CACHING_POOL_TLS_CACHE_SIZE
+#   if !PJ_HAS_THREADS || !PJ_ATOMIC_USE_INTRINSICS
+#       error "Per-thread pool caches need threads and atomic builtins"
+#   endif
+
+/* Per-thread cache of free pools. Each cache also keeps the list of pools
+ * created through it, so that pools can be tracked without the global
+ * lock. The mutex is normally only taken by the thread(s) owning the
+ * cache, except when a pool is released by another thread.
+ */
+struct pj_cpool_tls_cache
+{
+    pj_mutex_t     *mutex;
+    pj_list         free_list[PJ_CACHING_POOL_ARRAY_SIZE];
+    unsigned        free_cnt[PJ_CACHING_POOL_ARRAY_SIZE];
+    pj_list         used_list;
+};
+
+static void tls_cache_init(pj_caching_pool *cp);
+static void tls_cache_destroy(pj_caching_pool *cp);
+static pj_pool_t* tls_create_pool(pj_caching_pool *cp,
+                                  const char *name,
+                                  int idx,
+                                  pj_size_t initial_size,
+                                  pj_size_t increment_sz,
+                                  pj_pool_callback *callback);
+static void tls_release_pool(pj_caching_pool *cp, pj_pool_t *pool);
+#endif
+
 
 static pj_size_t pool_sizes[PJ_CACHING_POOL_ARRAY_SIZE] = 
 {
@@ -87,6 +116,10 @@ PJ_DEF(void) pj_caching_pool_init( pj_caching_pool *cp,
     /* This mostly serves to silent coverity warning about unchecked 
      * return value. There's not much we can do if it fails. */
     PJ_ASSERT_ON_FAIL(status==PJ_SUCCESS, return);
+
+#if PJ_CACHING_POOL_TLS_CACHE_SIZE
+    tls_cache_init(cp);
+#endif
 }
 
 PJ_DEF(void) pj_caching_pool_destroy( pj_caching_pool *cp )
@@ -96,6 +129,10 @@ PJ_DEF(void) pj_caching_pool_destroy( pj_caching_pool *cp )
 
     PJ_CHECK_STACK();
 
+#if PJ_CACHING_POOL_TLS_CACHE_SIZE
+    tls_cache_destroy(cp);
+#endif
+
     /* Delete all pool in free list */
     for (i=0; i < PJ_CACHING_POOL_ARRAY_SIZE; ++i) {
         pj_pool_t *next;
@@ -124,25 +161,13 @@ PJ_DEF(void) pj_caching_pool_destroy( pj_caching_pool *cp )
     }
 }
 
-static pj_pool_t* cpool_create_pool(pj_pool_factory *pf, 
-                                              const char *name, 
-                                              pj_size_t initial_size, 
-                                              pj_size_t increment_sz, 
-                                              pj_pool_callback *callback)
+/* Get the index of the free list for the pool size. Returns
+ * PJ_CACHING_POOL_ARRAY_SIZE if the size is larger than any of the lists.
+ */
+static int get_size_idx(pj_size_t initial_size)
 {
-    pj_caching_pool *cp = (pj_caching_pool*)pf;
-    pj_pool_t *pool;
     int idx;
 
-    PJ_CHECK_STACK();
-
-    pj_lock_acquire(cp->lock);
-
-    /* Use pool factory's policy when callback is NULL */
-    if (callback == NULL) {
-        callback = pf->policy.callback;
-    }
-
     /* Search the suitable size for the pool. 
      * We'll just do linear search to the size array, as the array size itself
      * is only a few elements. Binary search I suspect will be less efficient
@@ -162,6 +187,37 @@ static pj_pool_t* cpool_create_pool(pj_pool_factory *pf,
             ;
     }
 
+    return idx;
+}
+
+static pj_pool_t* cpool_create_pool(pj_pool_factory *pf, 
+                                              const char *name, 
+                                              pj_size_t initial_size, 
+                                              pj_size_t increment_sz, 
+                                              pj_pool_callback *callback)
+{
+    pj_caching_pool *cp = (pj_caching_pool*)pf;
+    pj_pool_t *pool;
+    int idx;
+
+    PJ_CHECK_STACK();
+
+    /* Use pool factory's policy when callback is NULL */
+    if (callback == NULL) {
+        callback = pf->policy.callback;
+    }
+
+    idx = get_size_idx(initial_size);
+
+#if PJ_CACHING_POOL_TLS_CACHE_SIZE
+    if (cp->tls_cache) {
+        return tls_create_pool(cp, name, idx, initial_size, increment_sz,
+                               callback);
+    }
+#endif
+
+    pj_lock_acquire(cp->lock);
+
     /* Check whether there's a pool in the list. */
     if (idx==PJ_CACHING_POOL_ARRAY_SIZE || pj_list_empty(&cp->free_list[idx])) {
         /* No pool is available. */
@@ -219,6 +275,13 @@ static void cpool_release_pool( pj_pool_factory *pf, pj_pool_t *pool)
 
     PJ_ASSERT_ON_FAIL(pf && pool, return);
 
+#if PJ_CACHING_POOL_TLS_CACHE_SIZE
+    if (cp->tls_cache) {
+        tls_release_pool(cp, pool);
+        return;
+    }
+#endif
+
     pj_lock_acquire(cp->lock);
 
 #if PJ_SAFE_POOL
@@ -279,10 +342,57 @@ static void cpool_release_pool( pj_pool_factory *pf, pj_pool_t *pool)
     pj_lock_release(cp->lock);
 }
 
+#if PJ_LOG_MAX_LEVEL >= 3
+static void dump_pool_list(pj_list *list, pj_size_t *total_used,
+                           pj_size_t *total_capacity)
+{
+    pj_pool_t *pool = (pj_pool_t*) list->next;
+
+    while (pool != (void*)list) {
+        pj_size_t pool_capacity = pj_pool_get_capacity(pool);
+        pj_pool_block *block = pool->block_list.next;
+        unsigned nblocks = 0;
+
+        while (block != &pool->block_list) {
+#if 0
+            PJ_LOG(6, ("cachpool", "   %16s block %u, size %ld",
+                                   pj_pool_getobjname(pool), nblocks,
+                                   (long)(block->end - block->buf + 1)));
+#endif
+            nblocks++;
+            block = block->next;
+        }
+
+        PJ_LOG(3,("cachpool", "   %16s: %8lu of %8lu (%lu%%) used, "
+                              "nblocks: %d",
+                              pj_pool_getobjname(pool), 
+                              (unsigned long)pj_pool_get_used_size(pool), 
+                              (unsigned long)pool_capacity,
+                              (unsigned long)(pj_pool_get_used_size(pool)*
+                                              100/pool_capacity),
+                              nblocks));
+
+#if PJ_POOL_MAX_SEARCH_BLOCK_COUNT == 0
+        if (nblocks >= 10) {
+            PJ_LOG(3,("cachpool", "   %16s has too many blocks (%d), "
+                                  "consider increasing its initial and/or "
+                                  "increment size for better performance",
+                                  pj_pool_getobjname(pool), nblocks));
+        }
+#endif
+
+        *total_used += pj_pool_get_used_size(pool);
+        *total_capacity += pool_capacity;
+        pool = pool->next;
+    }
+}
+#endif
+
 static void cpool_dump_status(pj_pool_factory *factory, pj_bool_t detail )
 {
 #if PJ_LOG_MAX_LEVEL >= 3
     pj_caching_pool *cp = (pj_caching_pool*)factory;
+    pj_size_t total_used = 0, total_capacity = 0;
 
     pj_lock_acquire(cp->lock);
 
@@ -291,56 +401,36 @@ static void cpool_dump_status(pj_pool_factory *factory, pj_bool_t detail )
               (unsigned long)cp->capacity, (unsigned long)cp->max_capacity,
               (unsigned long)cp->used_count));
     if (detail) {
-        pj_pool_t *pool = (pj_pool_t*) cp->used_list.next;
-        pj_size_t total_used = 0, total_capacity = 0;
         PJ_LOG(3,("cachpool", "  Dumping all active pools:"));
-        while (pool != (void*)&cp->used_list) {
-            pj_size_t pool_capacity = pj_pool_get_capacity(pool);
-            pj_pool_block *block = pool->block_list.next;
-            unsigned nblocks = 0;
-
-            while (block != &pool->block_list) {
-#if 0
-                PJ_LOG(6, ("cachpool", "   %16s block %u, size %ld",
-                                       pj_pool_getobjname(pool), nblocks,
-                                       (long)(block->end - block->buf + 1)));
-#endif
-                nblocks++;
-                block = block->next;
-            }
-
-            PJ_LOG(3,("cachpool", "   %16s: %8lu of %8lu (%lu%%) used, "
-                                  "nblocks: %d",
-                                  pj_pool_getobjname(pool), 
-                                  (unsigned long)pj_pool_get_used_size(pool), 
-                                  (unsigned long)pool_capacity,
-                                  (unsigned long)(pj_pool_get_used_size(pool)*
-                                                  100/pool_capacity),
-                                  nblocks));
+        dump_pool_list(&cp->used_list, &total_used, &total_capacity);
+    }
 
-#if PJ_POOL_MAX_SEARCH_BLOCK_COUNT == 0
-            if (nblocks >= 10) {
-                PJ_LOG(3,("cachpool", "   %16s has too many blocks (%d), "
-                                      "consider increasing its initial and/or "
-                                      "increment size for better performance",
-                                      pj_pool_getobjname(pool), nblocks));
-            }
-#endif
+    pj_lock_release(cp->lock);
 
-            total_used += pj_pool_get_used_size(pool);
-            total_capacity += pool_capacity;
-            pool = pool->next;
-        }
-        if (total_capacity) {
-            PJ_LOG(3,("cachpool", "  Total %9lu of %9lu (%lu %%) used!",
-                                  (unsigned long)total_used,
-                                  (unsigned long)total_capacity,
-                                  (unsigned long)(total_used * 100 /
-                                                  total_capacity)));
+#if PJ_CACHING_POOL_TLS_CACHE_SIZE
+    /* The per-thread caches take the caching pool lock while holding
+     * their own mutex, so they must be dumped without the former.
+     */
+    if (detail && cp->tls_cache) {
+        unsigned i;
+        for (i=0; i<cp->tls_cache_cnt; ++i) {
+            struct pj_cpool_tls_cache *cache = &cp->tls_cache[i];
+
+            pj_mutex_lock(cache->mutex);
+            dump_pool_list(&cache->used_list, &total_used,
+                           &total_capacity);
+            pj_mutex_unlock(cache->mutex);
         }
     }
+#endif
 
-    pj_lock_release(cp->lock);
+    if (detail && total_capacity) {
+        PJ_LOG(3,("cachpool", "  Total %9lu of %9lu (%lu %%) used!",
+                              (unsigned long)total_used,
+                              (unsigned long)total_capacity,
+                              (unsigned long)(total_used * 100 /
+                                              total_capacity)));
+    }
 #else
     PJ_UNUSED_ARG(factory);
     PJ_UNUSED_ARG(detail);
@@ -375,5 +465,297 @@ static void cpool_on_block_free(pj_pool_factory *f, pj_size_t sz)
 }
 
 
+
+#if PJ_CACHING_POOL_TLS_CACHE_SIZE
+
+/* Number of pools moved between a thread's cache and the shared free list
+ * when the thread's cache runs empty or overflows.
+ */
+#define TLS_CACHE_BATCH     ((PJ_CACHING_POOL_TLS_CACHE_SIZE + 1) / 2)
+
+static void tls_cache_init(pj_caching_pool *cp)
+{
+    unsigned i, j, cnt = PJ_CACHING_POOL_TLS_CACHE_CNT;
+    struct pj_cpool_tls_cache *cache;
+    pj_pool_t *pool;
+    pj_status_t status;
+
+    if (cnt == 0)
+        return;
+
+    status = pj_thread_local_alloc(&cp->tls_id);
+    if (status != PJ_SUCCESS)
+        return;
+
+    pool = pj_pool_create_int(&cp->factory, "cpool_tls",
+                              cnt * sizeof(*cache) + 1024, 1024, NULL);
+    if (!pool) {
+        pj_thread_local_free(cp->tls_id);
+        return;
+    }
+
+    cache = (struct pj_cpool_tls_cache*)
+            pj_pool_calloc(pool, cnt, sizeof(*cache));
+    for (i=0; i<cnt; ++i) {
+        status = pj_mutex_create_simple(pool, "cpool_tls", &cache[i].mutex);
+        if (status != PJ_SUCCESS) {
+            while (i > 0)
+                pj_mutex_destroy(cache[--i].mutex);
+            pj_pool_destroy_int(pool);
+            pj_thread_local_free(cp->tls_id);
+            return;
+        }
+
+        for (j=0; j<PJ_CACHING_POOL_ARRAY_SIZE; ++j)
+            pj_list_init(&cache[i].free_list[j]);
+        pj_list_init(&cache[i].used_list);
+    }
+
+    cp->tls_pool = pool;
+    cp->tls_cache_cnt = cnt;
+    cp->tls_cache = cache;
+}
+
+static void tls_cache_destroy(pj_caching_pool *cp)
+{
+    unsigned i, j;
+
+    if (!cp->tls_cache)
+        return;
+
+    for (i=0; i<cp->tls_cache_cnt; ++i) {
+        struct pj_cpool_tls_cache *cache = &cp->tls_cache[i];
+        pj_pool_t *pool, *next;
+
+        for (j=0; j<PJ_CACHING_POOL_ARRAY_SIZE; ++j) {
+            pool = (pj_pool_t*) cache->free_list[j].next;
+            for (; pool != (void*)&cache->free_list[j]; pool = next) {
+                next = pool->next;
+                pj_list_erase(pool);
+                pj_pool_destroy_int(pool);
+            }
+        }
+
+        pool = (pj_pool_t*) cache->used_list.next;
+        for (; pool != (void*)&cache->used_list; pool = next) {
+            next = pool->next;
+            pj_list_erase(pool);
+            PJ_LOG(4,(pool->obj_name, 
+                      "Pool is not released by application, releasing now"));
+            pj_pool_destroy_int(pool);
+        }
+
+        pj_mutex_destroy(cache->mutex);
+    }
+
+    pj_thread_local_free(cp->tls_id);
+    pj_pool_destroy_int(cp->tls_pool);
+    cp->tls_pool = NULL;
+    cp->tls_cache = NULL;
+    cp->tls_cache_cnt = 0;
+}
+
+/* Get the cache of the calling thread, assigning one if needed. */
+static struct pj_cpool_tls_cache* get_tls_cache(pj_caching_pool *cp)
+{
+    struct pj_cpool_tls_cache *cache;
+
+    cache = (struct pj_cpool_tls_cache*) pj_thread_local_get(cp->tls_id);
+    if (!cache) {
+        unsigned i = __atomic_fetch_add(&cp->tls_cache_next, 1,
+                                        __ATOMIC_RELAXED);
+        cache = &cp->tls_cache[i % cp->tls_cache_cnt];
+        pj_thread_local_set(cp->tls_id, cache);
+    }
+    return cache;
+}
+
+/* Move free pools of size idx from the shared free list into the cache.
+ * Cache mutex must be held.
+ */
+static void tls_cache_refill(pj_caching_pool *cp,
+                             struct pj_cpool_tls_cache *cache,
+                             int idx)
+{
+    unsigned n;
+
+    pj_lock_acquire(cp->lock);
+    for (n=0; n<TLS_CACHE_BATCH && !pj_list_empty(&cp->free_list[idx]); ++n) {
+        pj_pool_t *pool = (pj_pool_t*) cp->free_list[idx].next;
+        pj_list_erase(pool);
+        pj_list_insert_after(&cache->free_list[idx], pool);
+        ++cache->free_cnt[idx];
+    }
+    pj_lock_release(cp->lock);
+}
+
+/* Return the least recently used free pools of size idx from the cache
+ * to the shared free list. Cache mutex must be held.
+ */
+static void tls_cache_flush(pj_caching_pool *cp,
+                            struct pj_cpool_tls_cache *cache,
+                            int idx)
+{
+    unsigned n;
+
+    pj_lock_acquire(cp->lock);
+    for (n=0; n<TLS_CACHE_BATCH && !pj_list_empty(&cache->free_list[idx]);
+         ++n)
+    {
+        pj_pool_t *pool = (pj_pool_t*) cache->free_list[idx].prev;
+        pj_list_erase(pool);
+        pj_list_insert_after(&cp->free_list[idx], pool);
+        --cache->free_cnt[idx];
+    }
+    pj_lock_release(cp->lock);
+}
+
+static pj_pool_t* tls_create_pool(pj_caching_pool *cp,
+                                  const char *name,
+                                  int idx,
+                                  pj_size_t initial_size,
+                                  pj_size_t increment_sz,
+                                  pj_pool_callback *callback)
+{
+    struct pj_cpool_tls_cache *cache = get_tls_cache(cp);
+    pj_pool_t *pool = NULL;
+
+    pj_mutex_lock(cache->mutex);
+
+    if (idx < PJ_CACHING_POOL_ARRAY_SIZE) {
+        if (pj_list_empty(&cache->free_list[idx]))
+            tls_cache_refill(cp, cache, idx);
+
+        if (!pj_list_empty(&cache->free_list[idx])) {
+            pool = (pj_pool_t*) cache->free_list[idx].next;
+            pj_list_erase(pool);
+            --cache->free_cnt[idx];
+        }
+    }
+
+    if (pool) {
+        /* Initialize the pool. */
+        pj_pool_init_int(pool, name, increment_sz, callback);
+
+        /* Update pool manager's free capacity. */
+        __atomic_sub_fetch(&cp->capacity, pj_pool_get_capacity(pool),
+                           __ATOMIC_RELAXED);
+
+        PJ_LOG(6, (pool->obj_name, "pool reused, size=%lu",
+                   (unsigned long)pool->capacity));
+    } else {
+        /* No pool is available, create new pool outside the lock. */
+        pj_mutex_unlock(cache->mutex);
+
+        if (idx < PJ_CACHING_POOL_ARRAY_SIZE)
+            initial_size = pool_sizes[idx];
+
+        pool = pj_pool_create_int(&cp->factory, name, initial_size,
+                                  increment_sz, callback);
+        if (!pool)
+            return NULL;
+
+        pj_mutex_lock(cache->mutex);
+    }
+
+    /* Put in used list of this cache and mark the owner. */
+    pj_list_insert_before(&cache->used_list, pool);
+    pool->factory_data = cache;
+
+    pj_mutex_unlock(cache->mutex);
+
+    /* Increment used count. */
+    __atomic_add_fetch(&cp->used_count, 1, __ATOMIC_RELAXED);
+
+    return pool;
+}
+
+static void tls_release_pool(pj_caching_pool *cp, pj_pool_t *pool)
+{
+    struct pj_cpool_tls_cache *cache;
+    pj_size_t pool_capacity, reset_capacity, old_capacity;
+    int idx;
+
+    /* Erase from the used list of the cache that created the pool, which
+     * may belong to another thread.
+     */
+    cache = (struct pj_cpool_tls_cache*) pool->factory_data;
+    pj_mutex_lock(cache->mutex);
+
+#if PJ_SAFE_POOL
+    /* Make sure pool is still in our used list */
+    if (pj_list_find_node(&cache->used_list, pool) != pool) {
+        pj_mutex_unlock(cache->mutex);
+        pj_assert(!"Attempt to destroy pool that has been destroyed before");
+        return;
+    }
+#endif
+
+    pj_list_erase(pool);
+    pj_mutex_unlock(cache->mutex);
+
+    /* Decrement used count. */
+    __atomic_sub_fetch(&cp->used_count, 1, __ATOMIC_RELAXED);
+
+    /* Destroy the pool if the size is greater than our size. */
+    pool_capacity = pj_pool_get_capacity(pool);
+    if (pool_capacity > pool_sizes[PJ_CACHING_POOL_ARRAY_SIZE-1]) {
+        pj_pool_destroy_int(pool);
+        return;
+    }
+
+    /* Reset pool. */
+    PJ_LOG(6, (pool->obj_name, "recycle(): cap=%lu, used=%lu(%lu%%)", 
+               (unsigned long)pool_capacity,
+               (unsigned long)pj_pool_get_used_size(pool), 
+               (unsigned long)(pj_pool_get_used_size(pool)*100/
+                               pool_capacity)));
+    pj_pool_reset(pool);
+
+    /* After reset only the initial block remains, whose size is one of
+     * pool_sizes.
+     */
+    reset_capacity = pj_pool_get_capacity(pool);
+    for (idx=0; idx<PJ_CACHING_POOL_ARRAY_SIZE; ++idx) {
+        if (pool_sizes[idx] == reset_capacity)
+            break;
+    }
+    if (idx == PJ_CACHING_POOL_ARRAY_SIZE) {
+        /* Something has gone wrong with the pool. */
+        pj_assert(!"Unexpected pool size");
+        pj_pool_destroy_int(pool);
+        return;
+    }
+
+    /* Add the pool to the factory's capacity, or destroy the pool if the
+     * total capacity in the recycle lists (plus the size of the pool)
+     * exceeds maximum capacity.
+     */
+    old_capacity = __atomic_load_n(&cp->capacity, __ATOMIC_RELAXED);
+    do {
+        if (old_capacity + pool_capacity > cp->max_capacity) {
+            pj_pool_destroy_int(pool);
+            return;
+        }
+    } while (!__atomic_compare_exchange_n(&cp->capacity, &old_capacity,
+                                          old_capacity + reset_capacity,
+                                          PJ_TRUE, __ATOMIC_RELAXED,
+                                          __ATOMIC_RELAXED));
+
+    /* Put the pool in the calling thread's cache, and return some pools
+     * to the shared free list when the cache is full.
+     */
+    cache = get_tls_cache(cp);
+    pj_mutex_lock(cache->mutex);
+
+    pj_list_insert_after(&cache->free_list[idx], pool);
+    if (++cache->free_cnt[idx] > PJ_CACHING_POOL_TLS_CACHE_SIZE)
+        tls_cache_flush(cp, cache, idx);
+
+    pj_mutex_unlock(cache->mutex);
+}
+
+#endif  /* PJ_CACHING_POOL_TLS_CACHE_SIZE */
+
 #endif  /* PJ_HAS_POOL_ALT_API */
 
@@ -0,0 +1,242 @@
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include <pj/ringbuf.h>
+#include <pj/assert.h>
+#include <pj/errno.h>
+#include <pj/os.h>
+#include <pj/pool.h>
+#include <pj/string.h>
+
+/* Largest capacity, so that the free running positions never get more
+ * than the capacity apart when they wrap around.
+ */
+#define MAX_CAPACITY    0x40000000U
+
+/* Position owned by one side, with that side's copy of the other side's
+ * position, padded to a cache line.
+ */
+typedef union rb_side
+{
+    struct {
+        unsigned     pos;
+        unsigned     other;
+    } v;
+    char             pad[PJ_CACHE_LINE_SIZE];
+} rb_side;
+
+struct pj_ringbuf_t
+{
+    rb_side          prod;          /* pos: write, other: cached read   */
+    rb_side          cons;          /* pos: read, other: cached write   */
+
+    unsigned         elem_size;
+    unsigned         capacity;
+    unsigned         mask;
+    pj_uint8_t      *buf;
+#if !PJ_ATOMIC_USE_INTRINSICS
+    pj_mutex_t      *mutex;
+#endif
+};
+
+#if PJ_ATOMIC_USE_INTRINSICS
+
+#define LOAD_POS(rb, p)         __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define STORE_POS(rb, p, v)     __atomic_store_n(p, v, __ATOMIC_RELEASE)
+
+#else   /* PJ_ATOMIC_USE_INTRINSICS */
+
+static unsigned load_pos(pj_ringbuf_t *rb, unsigned *p)
+{
+    unsigned v;
+
+    pj_mutex_lock(rb->mutex);
+    v = *p;
+    pj_mutex_unlock(rb->mutex);
+    return v;
+}
+
+static void store_pos(pj_ringbuf_t *rb, unsigned *p, unsigned v)
+{
+    pj_mutex_lock(rb->mutex);
+    *p = v;
+    pj_mutex_unlock(rb->mutex);
+}
+
+#define LOAD_POS(rb, p)         load_pos(rb, p)
+#define STORE_POS(rb, p, v)     store_pos(rb, p, v)
+
+#endif  /* PJ_ATOMIC_USE_INTRINSICS */
+
+
+PJ_DEF(pj_status_t) pj_ringbuf_create(pj_pool_t *pool,
+                                      unsigned elem_size,
+                                      unsigned capacity,
+                                      pj_ringbuf_t **p_rb)
+{
+    pj_ringbuf_t *rb;
+    unsigned cap;
+    void *mem;
+
+    PJ_ASSERT_RETURN(pool && elem_size && capacity && p_rb, PJ_EINVAL);
+    PJ_ASSERT_RETURN(capacity <= MAX_CAPACITY, PJ_ETOOBIG);
+
+    for (cap = 1; cap < capacity; cap <<= 1)
+        ;
+
+    /* Align the structure so the positions sit on their own cache lines */
+    mem = pj_pool_alloc(pool, sizeof(pj_ringbuf_t) + PJ_CACHE_LINE_SIZE);
+    PJ_ASSERT_RETURN(mem, PJ_ENOMEM);
+    rb = (pj_ringbuf_t*)
+         (((pj_size_t)mem + PJ_CACHE_LINE_SIZE - 1) &
+          ~((pj_size_t)PJ_CACHE_LINE_SIZE - 1));
+    pj_bzero(rb, sizeof(*rb));
+
+    rb->elem_size = elem_size;
+    rb->capacity = cap;
+    rb->mask = cap - 1;
+    rb->buf = (pj_uint8_t*) pj_pool_alloc(pool, (pj_size_t)cap * elem_size);
+    PJ_ASSERT_RETURN(rb->buf, PJ_ENOMEM);
+
+#if !PJ_ATOMIC_USE_INTRINSICS
+    {
+        pj_status_t status;
+
+        status = pj_mutex_create_simple(pool, "ringbuf%p", &rb->mutex);
+        if (status != PJ_SUCCESS)
+            return status;
+    }
+#endif
+
+    *p_rb = rb;
+    return PJ_SUCCESS;
+}
+
+PJ_DEF(pj_status_t) pj_ringbuf_destroy(pj_ringbuf_t *rb)
+{
+    PJ_ASSERT_RETURN(rb, PJ_EINVAL);
+#if !PJ_ATOMIC_USE_INTRINSICS
+    if (rb->mutex) {
+        pj_mutex_destroy(rb->mutex);
+        rb->mutex = NULL;
+    }
+#endif
+    return PJ_SUCCESS;
+}
+
+PJ_DEF(unsigned) pj_ringbuf_get_capacity(const pj_ringbuf_t *rb)
+{
+    return rb->capacity;
+}
+
+PJ_DEF(unsigned) pj_ringbuf_write_avail(pj_ringbuf_t *rb)
+{
+    rb->prod.v.other = LOAD_POS(rb, &rb->cons.v.pos);
+    return rb->capacity - (rb->prod.v.pos - rb->prod.v.other);
+}
+
+PJ_DEF(unsigned) pj_ringbuf_read_avail(pj_ringbuf_t *rb)
+{
+    rb->cons.v.other = LOAD_POS(rb, &rb->prod.v.pos);
+    return rb->cons.v.other - rb->cons.v.pos;
+}
+
+PJ_DEF(unsigned) pj_ringbuf_write(pj_ringbuf_t *rb,
+                                  const void *elems,
+                                  unsigned count)
+{
+    unsigned pos = rb->prod.v.pos;
+    unsigned avail, idx, first;
+    const pj_uint8_t *src = (const pj_uint8_t*)elems;
+
+    /* Only look at the consumer's position when the cached one says
+     * there is not enough room.
+     */
+    avail = rb->capacity - (pos - rb->prod.v.other);
+    if (avail < count) {
+        rb->prod.v.other = LOAD_POS(rb, &rb->cons.v.pos);
+        avail = rb->capacity - (pos - rb->prod.v.other);
+    }
+    if (count > avail)
+        count = avail;
+    if (count == 0)
+        return 0;
+
+    idx = pos & rb->mask;
+    first = rb->capacity - idx;
+    if (first > count)
+        first = count;
+
+    pj_memcpy(rb->buf + idx * rb->elem_size, src, first * rb->elem_size);
+    if (count > first) {
+        pj_memcpy(rb->buf, src + first * rb->elem_size,
+                  (count - first) * rb->elem_size);
+    }
+
+    STORE_POS(rb, &rb->prod.v.pos, pos + count);
+    return count;
+}
+
+/* Consumer side: get number of elements to take, at most count */
+static unsigned get_read_cnt(pj_ringbuf_t *rb, unsigned count)
+{
+    unsigned pos = rb->cons.v.pos;
+    unsigned avail;
+
+    avail = rb->cons.v.other - pos;
+    if (avail < count) {
+        rb->cons.v.other = LOAD_POS(rb, &rb->prod.v.pos);
+        avail = rb->cons.v.other - pos;
+    }
+    return (count > avail) ? avail : count;
+}
+
+PJ_DEF(unsigned) pj_ringbuf_read(pj_ringbuf_t *rb,
+                                 void *elems,
+                                 unsigned count)
+{
+    unsigned pos = rb->cons.v.pos;
+    unsigned idx, first;
+    pj_uint8_t *dst = (pj_uint8_t*)elems;
+
+    count = get_read_cnt(rb, count);
+    if (count == 0)
+        return 0;
+
+    idx = pos & rb->mask;
+    first = rb->capacity - idx;
+    if (first > count)
+        first = count;
+
+    pj_memcpy(dst, rb->buf + idx * rb->elem_size, first * rb->elem_size);
+    if (count > first) {
+        pj_memcpy(dst + first * rb->elem_size, rb->buf,
+                  (count - first) * rb->elem_size);
+    }
+
+    STORE_POS(rb, &rb->cons.v.pos, pos + count);
+    return count;
+}
+
+PJ_DEF(unsigned) pj_ringbuf_skip(pj_ringbuf_t *rb, unsigned count)
+{
+    count = get_read_cnt(rb, count);
+    if (count)
+        STORE_POS(rb, &rb->cons.v.pos, rb->cons.v.pos + count);
+    return count;
+}
@@ -0,0 +1,567 @@
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include <pj/slab.h>
+#include <pj/assert.h>
+#include <pj/errno.h>
+#include <pj/lock.h>
+#include <pj/log.h>
+#include <pj/os.h>
+#include <pj/string.h>
+
+#define THIS_FILE   "slab.c"
+
+/* Objects must be able to hold the free list link, and are aligned at
+ * least as strictly as pool memory.
+ */
+#define SLAB_ALIGN  (PJ_POOL_ALIGNMENT > sizeof(void*) ? \
+                     PJ_POOL_ALIGNMENT : sizeof(void*))
+
+#define ALIGN_SIZE(sz)  (((sz) + SLAB_ALIGN - 1) & ~(SLAB_ALIGN - 1))
+
+/* Number of objects moved between a cache and the shared free list */
+#define CACHE_BATCH     ((PJ_SLAB_CACHE_SIZE + 1) / 2)
+
+/* Free objects are linked through their first word. */
+typedef struct slab_obj
+{
+    struct slab_obj *next;
+} slab_obj;
+
+struct slab_class
+{
+    pj_size_t        obj_size;
+    slab_obj        *free_list;
+    unsigned         chunk_cnt;
+    unsigned         obj_cnt;
+
+    /* Allocations and releases that did not go through a cache */
+    pj_uint32_t      alloc_cnt;
+    pj_uint32_t      release_cnt;
+};
+
+#if PJ_SLAB_CACHE_SIZE
+/* Per-thread cache of free objects */
+struct slab_cache
+{
+    pj_mutex_t      *mutex;
+    slab_obj        *free_list[PJ_SLAB_MAX_CLASS];
+    unsigned         free_cnt[PJ_SLAB_MAX_CLASS];
+    pj_uint32_t      alloc_cnt[PJ_SLAB_MAX_CLASS];
+    pj_uint32_t      release_cnt[PJ_SLAB_MAX_CLASS];
+};
+#endif
+
+struct pj_slab_t
+{
+    char             obj_name[PJ_MAX_OBJ_NAME];
+    pj_pool_t       *pool;
+    pj_lock_t       *lock;
+    unsigned         objs_per_chunk;
+    unsigned         class_cnt;
+    struct slab_class cls[PJ_SLAB_MAX_CLASS];
+    pj_uint32_t      oversize_cnt;
+
+#if PJ_SLAB_CACHE_SIZE
+    long             tls_id;
+    unsigned         cache_cnt;
+    unsigned         cache_next;
+    struct slab_cache *cache;
+#endif
+};
+
+
+/* Chunk allocation failure must not throw, we just return NULL. */
+static void slab_pool_callback(pj_pool_t *pool, pj_size_t size)
+{
+    PJ_UNUSED_ARG(pool);
+    PJ_UNUSED_ARG(size);
+}
+
+/* Get the smallest class that fits the size, or -1. */
+static int find_class(const pj_slab_t *slab, pj_size_t size)
+{
+    unsigned i;
+
+    for (i=0; i<slab->class_cnt; ++i) {
+        if (slab->cls[i].obj_size >= size)
+            return (int)i;
+    }
+    return -1;
+}
+
+/* Carve a new chunk into free objects. Slab lock must be held. */
+static pj_bool_t grow_class(pj_slab_t *slab, struct slab_class *cls)
+{
+    pj_uint8_t *chunk;
+    unsigned i;
+
+    chunk = (pj_uint8_t*) pj_pool_alloc(slab->pool,
+                                        cls->obj_size * slab->objs_per_chunk +
+                                        SLAB_ALIGN);
+    if (!chunk) {
+        PJ_LOG(4,(slab->obj_name, "Unable to allocate chunk for %lu bytes "
+                  "objects", (unsigned long)cls->obj_size));
+        return PJ_FALSE;
+    }
+
+    chunk = (pj_uint8_t*)(((pj_size_t)chunk + SLAB_ALIGN - 1) &
+                          ~(SLAB_ALIGN - 1));
+
+    /* Push in reverse so that objects are handed out in address order */
+    for (i=slab->objs_per_chunk; i>0; --i) {
+        slab_obj *obj = (slab_obj*)(chunk + (i-1) * cls->obj_size);
+        obj->next = cls->free_list;
+        cls->free_list = obj;
+    }
+
+    ++cls->chunk_cnt;
+    cls->obj_cnt += slab->objs_per_chunk;
+    return PJ_TRUE;
+}
+
+#if PJ_SLAB_CACHE_SIZE
+static void cache_init(pj_slab_t *slab)
+{
+    unsigned i, cnt = PJ_SLAB_CACHE_CNT;
+    struct slab_cache *cache;
+    pj_status_t status;
+
+    if (cnt == 0)
+        return;
+
+    status = pj_thread_local_alloc(&slab->tls_id);
+    if (status != PJ_SUCCESS)
+        return;
+
+    cache = (struct slab_cache*) pj_pool_calloc(slab->pool, cnt,
+                                                sizeof(*cache));
+    if (!cache) {
+        pj_thread_local_free(slab->tls_id);
+        return;
+    }
+
+    for (i=0; i<cnt; ++i) {
+        status = pj_mutex_create_simple(slab->pool, slab->obj_name,
+                                        &cache[i].mutex);
+        if (status != PJ_SUCCESS) {
+            while (i > 0)
+                pj_mutex_destroy(cache[--i].mutex);
+            pj_thread_local_free(slab->tls_id);
+            return;
+        }
+    }
+
+    slab->cache_cnt = cnt;
+    slab->cache = cache;
+}
+
+static void cache_destroy(pj_slab_t *slab)
+{
+    unsigned i;
+
+    if (!slab->cache)
+        return;
+
+    for (i=0; i<slab->cache_cnt; ++i)
+        pj_mutex_destroy(slab->cache[i].mutex);
+
+    pj_thread_local_free(slab->tls_id);
+    slab->cache = NULL;
+    slab->cache_cnt = 0;
+}
+
+/* Get the cache of the calling thread, assigning one if needed. */
+static struct slab_cache* get_cache(pj_slab_t *slab)
+{
+    struct slab_cache *cache;
+
+    cache = (struct slab_cache*) pj_thread_local_get(slab->tls_id);
+    if (!cache) {
+        pj_lock_acquire(slab->lock);
+        cache = &slab->cache[slab->cache_next++ % slab->cache_cnt];
+        pj_lock_release(slab->lock);
+        pj_thread_local_set(slab->tls_id, cache);
+    }
+    return cache;
+}
+
+/* Move free objects of class idx from the shared free list into the cache.
+ * Cache mutex must be held.
+ */
+static void cache_refill(pj_slab_t *slab, struct slab_cache *cache, int idx)
+{
+    struct slab_class *cls = &slab->cls[idx];
+    unsigned n;
+
+    pj_lock_acquire(slab->lock);
+    for (n=0; n<CACHE_BATCH; ++n) {
+        slab_obj *obj;
+
+        if (!cls->free_list && !grow_class(slab, cls))
+            break;
+
+        obj = cls->free_list;
+        cls->free_list = obj->next;
+        obj->next = cache->free_list[idx];
+        cache->free_list[idx] = obj;
+        ++cache->free_cnt[idx];
+    }
+    pj_lock_release(slab->lock);
+}
+
+/* Return free objects of class idx from the cache to the shared free list.
+ * Cache mutex must be held.
+ */
+static void cache_flush(pj_slab_t *slab, struct slab_cache *cache, int idx)
+{
+    struct slab_class *cls = &slab->cls[idx];
+    unsigned n;
+
+    pj_lock_acquire(slab->lock);
+    for (n=0; n<CACHE_BATCH && cache->free_list[idx]; ++n) {
+        slab_obj *obj = cache->free_list[idx];
+        cache->free_list[idx] = obj->next;
+        obj->next = cls->free_list;
+        cls->free_list = obj;
+        --cache->free_cnt[idx];
+    }
+    pj_lock_release(slab->lock);
+}
+#endif  /* PJ_SLAB_CACHE_SIZE */
+
+
+PJ_DEF(pj_status_t) pj_slab_create(pj_pool_factory *pf,
+                                   const char *name,
+                                   unsigned class_cnt,
+                                   const pj_size_t obj_size[],
+                                   unsigned objs_per_chunk,
+                                   pj_slab_t **p_slab)
+{
+    pj_pool_t *pool;
+    pj_slab_t *slab;
+    pj_size_t max_size = 0;
+    unsigned i, j;
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(pf && obj_size && objs_per_chunk && p_slab, PJ_EINVAL);
+    PJ_ASSERT_RETURN(class_cnt > 0 && class_cnt <= PJ_SLAB_MAX_CLASS,
+                     PJ_ETOOMANY);
+
+    for (i=0; i<class_cnt; ++i) {
+        PJ_ASSERT_RETURN(obj_size[i] > 0, PJ_EINVAL);
+        if (obj_size[i] > max_size)
+            max_size = obj_size[i];
+    }
+
+    if (name == NULL)
+        name = "slab%p";
+
+    pool = pj_pool_create(pf, name, sizeof(pj_slab_t) + 512,
+                          ALIGN_SIZE(max_size) * objs_per_chunk + SLAB_ALIGN +
+                          64, &slab_pool_callback);
+    if (!pool)
+        return PJ_ENOMEM;
+
+    slab = PJ_POOL_ZALLOC_T(pool, pj_slab_t);
+    slab->pool = pool;
+    slab->objs_per_chunk = objs_per_chunk;
+    pj_ansi_snprintf(slab->obj_name, sizeof(slab->obj_name), name, slab);
+
+    /* Insert the sizes in ascending order, ignoring duplicates */
+    for (i=0; i<class_cnt; ++i) {
+        pj_size_t size = ALIGN_SIZE(obj_size[i]);
+
+        for (j=0; j<slab->class_cnt && slab->cls[j].obj_size < size; ++j)
+            ;
+        if (j < slab->class_cnt && slab->cls[j].obj_size == size)
+            continue;
+
+        pj_memmove(&slab->cls[j+1], &slab->cls[j],
+                   (slab->class_cnt - j) * sizeof(slab->cls[0]));
+        slab->cls[j].obj_size = size;
+        ++slab->class_cnt;
+    }
+
+    status = pj_lock_create_simple_mutex(pool, slab->obj_name, &slab->lock);
+    if (status != PJ_SUCCESS) {
+        pj_pool_release(pool);
+        return status;
+    }
+
+#if PJ_SLAB_CACHE_SIZE
+    cache_init(slab);
+#endif
+
+    PJ_LOG(5,(slab->obj_name, "Slab created, %u classes, %lu..%lu bytes",
+              slab->class_cnt, (unsigned long)slab->cls[0].obj_size,
+              (unsigned long)slab->cls[slab->class_cnt-1].obj_size));
+
+    *p_slab = slab;
+    return PJ_SUCCESS;
+}
+
+PJ_DEF(void*) pj_slab_alloc(pj_slab_t *slab, pj_size_t size)
+{
+    struct slab_class *cls;
+    slab_obj *obj;
+    int idx;
+
+    PJ_ASSERT_RETURN(slab, NULL);
+
+    idx = find_class(slab, size);
+    if (idx < 0) {
+        pj_lock_acquire(slab->lock);
+        ++slab->oversize_cnt;
+        pj_lock_release(slab->lock);
+        return NULL;
+    }
+
+#if PJ_SLAB_CACHE_SIZE
+    if (slab->cache) {
+        struct slab_cache *cache = get_cache(slab);
+
+        pj_mutex_lock(cache->mutex);
+        if (!cache->free_list[idx])
+            cache_refill(slab, cache, idx);
+
+        obj = cache->free_list[idx];
+        if (obj) {
+            cache->free_list[idx] = obj->next;
+            --cache->free_cnt[idx];
+            ++cache->alloc_cnt[idx];
+        }
+        pj_mutex_unlock(cache->mutex);
+
+        return obj;
+    }
+#endif
+
+    cls = &slab->cls[idx];
+
+    pj_lock_acquire(slab->lock);
+    if (!cls->free_list)
+        grow_class(slab, cls);
+
+    obj = cls->free_list;
+    if (obj) {
+        cls->free_list = obj->next;
+        ++cls->alloc_cnt;
+    }
+    pj_lock_release(slab->lock);
+
+    return obj;
+}
+
+PJ_DEF(void) pj_slab_free(pj_slab_t *slab, void *mem, pj_size_t size)
+{
+    struct slab_class *cls;
+    slab_obj *obj = (slab_obj*)mem;
+    int idx;
+
+    PJ_ASSERT_ON_FAIL(slab && mem, return);
+
+    idx = find_class(slab, size);
+    PJ_ASSERT_ON_FAIL(idx >= 0, return);
+
+#if PJ_SLAB_CACHE_SIZE
+    if (slab->cache) {
+        struct slab_cache *cache = get_cache(slab);
+
+        pj_mutex_lock(cache->mutex);
+        obj->next = cache->free_list[idx];
+        cache->free_list[idx] = obj;
+        ++cache->release_cnt[idx];
+        if (++cache->free_cnt[idx] > PJ_SLAB_CACHE_SIZE)
+            cache_flush(slab, cache, idx);
+        pj_mutex_unlock(cache->mutex);
+
+        return;
+    }
+#endif
+
+    cls = &slab->cls[idx];
+
+    pj_lock_acquire(slab->lock);
+    obj->next = cls->free_list;
+    cls->free_list = obj;
+    ++cls->release_cnt;
+    pj_lock_release(slab->lock);
+}
+
+PJ_DEF(pj_status_t) pj_slab_get_stat(pj_slab_t *slab, pj_slab_stat *stat)
+{
+    unsigned i;
+
+    PJ_ASSERT_RETURN(slab && stat, PJ_EINVAL);
+
+    pj_bzero(stat, sizeof(*stat));
+
+#if PJ_SLAB_CACHE_SIZE
+    /* Collect the counters of the caches first, so that the cache
+     * mutex is not taken while holding the slab lock.
+     */
+    for (i=0; i<slab->cache_cnt; ++i) {
+        struct slab_cache *cache = &slab->cache[i];
+        unsigned j;
+
+        pj_mutex_lock(cache->mutex);
+        for (j=0; j<slab->class_cnt; ++j) {
+            stat->cls[j].alloc_cnt += cache->alloc_cnt[j];
+            stat->cls[j].used_cnt += cache->alloc_cnt[j] -
+                                     cache->release_cnt[j];
+        }
+        pj_mutex_unlock(cache->mutex);
+    }
+#endif
+
+    pj_lock_acquire(slab->lock);
+    stat->class_cnt = slab->class_cnt;
+    stat->oversize_cnt = slab->oversize_cnt;
+    for (i=0; i<slab->class_cnt; ++i) {
+        const struct slab_class *cls = &slab->cls[i];
+
+        stat->cls[i].obj_size = cls->obj_size;
+        stat->cls[i].chunk_cnt = cls->chunk_cnt;
+        stat->cls[i].obj_cnt = cls->obj_cnt;
+        stat->cls[i].alloc_cnt += cls->alloc_cnt;
+        stat->cls[i].used_cnt += cls->alloc_cnt - cls->release_cnt;
+    }
+    pj_lock_release(slab->lock);
+
+    return PJ_SUCCESS;
+}
+
+PJ_DEF(void) pj_slab_dump(pj_slab_t *slab)
+{
+#if PJ_LOG_MAX_LEVEL >= 3
+    pj_slab_stat stat;
+    unsigned i;
+
+    if (pj_slab_get_stat(slab, &stat) != PJ_SUCCESS)
+        return;
+
+    PJ_LOG(3,(slab->obj_name, "Dumping slab, %u classes, %u oversize "
+              "allocations:", stat.class_cnt, stat.oversize_cnt));
+    for (i=0; i<stat.class_cnt; ++i) {
+        const pj_slab_class_stat *cs = &stat.cls[i];
+
+        PJ_LOG(3,(slab->obj_name, "  %5lu bytes: %u/%u used, %u chunks, "
+                  "%u allocs", (unsigned long)cs->obj_size, cs->used_cnt,
+                  cs->obj_cnt, cs->chunk_cnt, cs->alloc_cnt));
+    }
+#else
+    PJ_UNUSED_ARG(slab);
+#endif
+}
+
+PJ_DEF(pj_status_t) pj_slab_destroy(pj_slab_t *slab)
+{
+    PJ_ASSERT_RETURN(slab, PJ_EINVAL);
+
+    PJ_LOG(5,(slab->obj_name, "Slab destroyed"));
+
+#if PJ_SLAB_CACHE_SIZE
+    cache_destroy(slab);
+#endif
+    pj_lock_destroy(slab->lock);
+    pj_pool_release(slab->pool);
+
+    return PJ_SUCCESS;
+}
+
+
+/*
+ * Slab pool factory.
+ */
+static void* spf_block_alloc(pj_pool_factory *f, pj_size_t size)
+{
+    pj_slab_pool_factory *spf = (pj_slab_pool_factory*)f;
+
+    /* Blocks that fit in a class must come from the slab, since
+     * spf_block_free() decides where to return a block by its size.
+     */
+    if (find_class(spf->slab, size) >= 0)
+        return pj_slab_alloc(spf->slab, size);
+
+    pj_slab_alloc(spf->slab, size);     /* count the oversize request */
+    return (*spf->parent->policy.block_alloc)(spf->parent, size);
+}
+
+static void spf_block_free(pj_pool_factory *f, void *mem, pj_size_t size)
+{
+    pj_slab_pool_factory *spf = (pj_slab_pool_factory*)f;
+
+    if (find_class(spf->slab, size) >= 0)
+        pj_slab_free(spf->slab, mem, size);
+    else
+        (*spf->parent->policy.block_free)(spf->parent, mem, size);
+}
+
+static pj_pool_t* spf_create_pool(pj_pool_factory *f,
+                                  const char *name,
+                                  pj_size_t initial_size,
+                                  pj_size_t increment_sz,
+                                  pj_pool_callback *callback)
+{
+#if PJ_HAS_POOL_ALT_API
+    pj_slab_pool_factory *spf = (pj_slab_pool_factory*)f;
+    return (*spf->parent->create_pool)(spf->parent, name, initial_size,
+                                       increment_sz, callback);
+#else
+    return pj_pool_create_int(f, name, initial_size, increment_sz, callback);
+#endif
+}
+
+static void spf_release_pool(pj_pool_factory *f, pj_pool_t *pool)
+{
+#if PJ_HAS_POOL_ALT_API
+    pj_slab_pool_factory *spf = (pj_slab_pool_factory*)f;
+    (*spf->parent->release_pool)(spf->parent, pool);
+#else
+    PJ_UNUSED_ARG(f);
+    pj_pool_destroy_int(pool);
+#endif
+}
+
+static void spf_dump_status(pj_pool_factory *f, pj_bool_t detail)
+{
+    pj_slab_pool_factory *spf = (pj_slab_pool_factory*)f;
+
+    PJ_UNUSED_ARG(detail);
+    pj_slab_dump(spf->slab);
+}
+
+PJ_DEF(void) pj_slab_pool_factory_init(pj_slab_pool_factory *spf,
+                                       pj_slab_t *slab,
+                                       pj_pool_factory *parent)
+{
+    PJ_ASSERT_ON_FAIL(spf && slab && parent, return);
+
+    pj_bzero(spf, sizeof(*spf));
+    spf->slab = slab;
+    spf->parent = parent;
+
+    pj_memcpy(&spf->factory.policy, &parent->policy,
+              sizeof(pj_pool_factory_policy));
+    spf->factory.policy.block_alloc = &spf_block_alloc;
+    spf->factory.policy.block_free = &spf_block_free;
+    spf->factory.create_pool = &spf_create_pool;
+    spf->factory.release_pool = &spf_release_pool;
+    spf->factory.dump_status = &spf_dump_status;
+}
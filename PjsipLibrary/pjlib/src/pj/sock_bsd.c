@@ -16,6 +16,9 @@
  * along with this program; if not, write to the Free Software
  * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA 
  */
+#ifndef _GNU_SOURCE
+#   define _GNU_SOURCE      /* for recvmmsg() and sendmmsg() */
+#endif
 #include <pj/sock.h>
 #include <pj/os.h>
 #include <pj/assert.h>
@@ -166,6 +169,11 @@ const pj_uint16_t PJ_SO_RCVBUF  = SO_RCVBUF;
 const pj_uint16_t PJ_SO_SNDBUF  = SO_SNDBUF;
 const pj_uint16_t PJ_TCP_NODELAY= TCP_NODELAY;
 const pj_uint16_t PJ_SO_REUSEADDR= SO_REUSEADDR;
+#ifdef SO_REUSEPORT
+const pj_uint16_t PJ_SO_REUSEPORT = SO_REUSEPORT;
+#else
+const pj_uint16_t PJ_SO_REUSEPORT = 0xFFFF;
+#endif
 #ifdef SO_NOSIGPIPE
 const pj_uint16_t PJ_SO_NOSIGPIPE = SO_NOSIGPIPE;
 #else
@@ -794,6 +802,132 @@ PJ_DEF(pj_status_t) pj_sock_recvfrom(pj_sock_t sock,
     }
 }
 
+#if PJ_SOCK_HAS_MMSG
+/* Number of datagrams per recvmmsg() call (limits stack usage) */
+#define MMSG_CHUNK      16
+
+/*
+ * Receive several datagrams.
+ */
+PJ_DEF(pj_status_t) pj_sock_recvmmsg(pj_sock_t sock,
+                                     pj_sock_mmsg msgs[],
+                                     unsigned *count,
+                                     unsigned flags)
+{
+    struct mmsghdr hdr[MMSG_CHUNK];
+    struct iovec iov[MMSG_CHUNK];
+    unsigned total = 0;
+
+    PJ_CHECK_STACK();
+    PJ_ASSERT_RETURN(msgs && count && *count, PJ_EINVAL);
+
+    while (total < *count) {
+        unsigned i, cnt = *count - total;
+        int rc;
+
+        if (cnt > MMSG_CHUNK)
+            cnt = MMSG_CHUNK;
+
+        pj_bzero(hdr, cnt * sizeof(hdr[0]));
+        for (i = 0; i < cnt; ++i) {
+            pj_sock_mmsg *m = &msgs[total + i];
+
+            iov[i].iov_base = m->buf;
+            iov[i].iov_len = m->size;
+            hdr[i].msg_hdr.msg_name = &m->addr;
+            hdr[i].msg_hdr.msg_namelen = sizeof(m->addr);
+            hdr[i].msg_hdr.msg_iov = &iov[i];
+            hdr[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        /* Only the very first datagram may block */
+        rc = recvmmsg(sock, hdr, cnt,
+                      flags | (total ? MSG_DONTWAIT : MSG_WAITFORONE), NULL);
+        if (rc <= 0) {
+            pj_status_t status;
+
+            if (total)
+                break;
+            status = pj_get_native_netos_error();
+            *count = 0;
+            return rc == 0 ? PJ_EEOF : PJ_RETURN_OS_ERROR(status);
+        }
+
+        for (i = 0; i < (unsigned)rc; ++i) {
+            pj_sock_mmsg *m = &msgs[total + i];
+
+            m->len = hdr[i].msg_len;
+            m->addr_len = hdr[i].msg_hdr.msg_namelen;
+            PJ_SOCKADDR_RESET_LEN(&m->addr);
+        }
+
+        total += rc;
+        if ((unsigned)rc < cnt)
+            break;
+    }
+
+    *count = total;
+    return PJ_SUCCESS;
+}
+
+/*
+ * Send several datagrams.
+ */
+PJ_DEF(pj_status_t) pj_sock_sendmmsg(pj_sock_t sock,
+                                     pj_sock_mmsg msgs[],
+                                     unsigned *count,
+                                     unsigned flags)
+{
+    struct mmsghdr hdr[MMSG_CHUNK];
+    struct iovec iov[MMSG_CHUNK];
+    unsigned total = 0;
+
+    PJ_CHECK_STACK();
+    PJ_ASSERT_RETURN(msgs && count && *count, PJ_EINVAL);
+
+    while (total < *count) {
+        unsigned i, cnt = *count - total;
+        int rc;
+
+        if (cnt > MMSG_CHUNK)
+            cnt = MMSG_CHUNK;
+
+        pj_bzero(hdr, cnt * sizeof(hdr[0]));
+        for (i = 0; i < cnt; ++i) {
+            pj_sock_mmsg *m = &msgs[total + i];
+
+            iov[i].iov_base = m->buf;
+            iov[i].iov_len = m->size;
+            hdr[i].msg_hdr.msg_name = &m->addr;
+            hdr[i].msg_hdr.msg_namelen = m->addr_len;
+            hdr[i].msg_hdr.msg_iov = &iov[i];
+            hdr[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        rc = sendmmsg(sock, hdr, cnt, flags);
+        if (rc <= 0) {
+            pj_status_t status;
+
+            if (total)
+                break;
+            status = pj_get_native_netos_error();
+            *count = 0;
+            return PJ_RETURN_OS_ERROR(status);
+        }
+
+        for (i = 0; i < (unsigned)rc; ++i)
+            msgs[total + i].len = hdr[i].msg_len;
+
+        total += rc;
+        if ((unsigned)rc < cnt)
+            break;
+    }
+
+    *count = total;
+    return PJ_SUCCESS;
+}
+#endif  /* PJ_SOCK_HAS_MMSG */
+
 /*
  * Get socket option.
  */
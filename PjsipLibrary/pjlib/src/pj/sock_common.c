@@ -1142,6 +1142,56 @@ PJ_DEF(pj_status_t) pj_sock_bind_random(  pj_sock_t sockfd,
 }
 
 
+#if !PJ_SOCK_HAS_MMSG
+/*
+ * Receive several datagrams. Without recvmmsg() only one datagram is
+ * received per call.
+ */
+PJ_DEF(pj_status_t) pj_sock_recvmmsg(pj_sock_t sockfd,
+                                     pj_sock_mmsg msgs[],
+                                     unsigned *count,
+                                     unsigned flags)
+{
+    pj_status_t status;
+
+    PJ_CHECK_STACK();
+    PJ_ASSERT_RETURN(msgs && count && *count, PJ_EINVAL);
+
+    msgs[0].len = (pj_ssize_t)msgs[0].size;
+    msgs[0].addr_len = sizeof(msgs[0].addr);
+    status = pj_sock_recvfrom(sockfd, msgs[0].buf, &msgs[0].len, flags,
+                              &msgs[0].addr, &msgs[0].addr_len);
+    *count = (status == PJ_SUCCESS) ? 1 : 0;
+    return status;
+}
+
+/*
+ * Send several datagrams, one sendto() call per datagram.
+ */
+PJ_DEF(pj_status_t) pj_sock_sendmmsg(pj_sock_t sockfd,
+                                     pj_sock_mmsg msgs[],
+                                     unsigned *count,
+                                     unsigned flags)
+{
+    unsigned i;
+    pj_status_t status = PJ_SUCCESS;
+
+    PJ_CHECK_STACK();
+    PJ_ASSERT_RETURN(msgs && count && *count, PJ_EINVAL);
+
+    for (i = 0; i < *count; ++i) {
+        msgs[i].len = (pj_ssize_t)msgs[i].size;
+        status = pj_sock_sendto(sockfd, msgs[i].buf, &msgs[i].len, flags,
+                                &msgs[i].addr, msgs[i].addr_len);
+        if (status != PJ_SUCCESS)
+            break;
+    }
+
+    *count = i;
+    return (i > 0) ? PJ_SUCCESS : status;
+}
+#endif
+
 /*
  * Adjust socket send/receive buffer size.
  */
@@ -1524,6 +1574,11 @@ PJ_DEF(pj_uint16_t) pj_SO_REUSEADDR(void)
     return PJ_SO_REUSEADDR;
 }
 
+PJ_DEF(pj_uint16_t) pj_SO_REUSEPORT(void)
+{
+    return PJ_SO_REUSEPORT;
+}
+
 PJ_DEF(pj_uint16_t) pj_SO_NOSIGPIPE(void)
 {
     return PJ_SO_NOSIGPIPE;
@@ -268,6 +268,50 @@ static void ssl_close_sockets(pj_ssl_sock_t *ssock)
 }
 #endif
 
+/* Handshake statistics of all secure sockets, protected by
+ * pj_enter_critical_section().
+ */
+static struct handshake_stat_t
+{
+    pj_ssl_sock_handshake_stat  stat;
+    pj_uint64_t                 full_total_msec;
+    pj_uint64_t                 resumed_total_msec;
+} hs_stat;
+
+/* Record handshake duration and result */
+static void update_handshake_stat(pj_ssl_sock_t *ssock, pj_status_t status)
+{
+    pj_timestamp now;
+
+    /* Handshake may fail before it is started, e.g: in creating SSL */
+    if (ssock->handshake_start.u64) {
+        pj_get_timestamp(&now);
+        ssock->handshake_msec = pj_elapsed_msec(&ssock->handshake_start,
+                                                &now);
+    }
+
+    pj_enter_critical_section();
+    if (status != PJ_SUCCESS) {
+        ++hs_stat.stat.failed_cnt;
+    } else if (ssock->session_reused) {
+        ++hs_stat.stat.resumed_cnt;
+        hs_stat.resumed_total_msec += ssock->handshake_msec;
+        if (ssock->handshake_msec > hs_stat.stat.resumed_max_msec)
+            hs_stat.stat.resumed_max_msec = ssock->handshake_msec;
+    } else {
+        ++hs_stat.stat.full_cnt;
+        hs_stat.full_total_msec += ssock->handshake_msec;
+        if (ssock->handshake_msec > hs_stat.stat.full_max_msec)
+            hs_stat.stat.full_max_msec = ssock->handshake_msec;
+    }
+    pj_leave_critical_section();
+
+    PJ_LOG(5,(ssock->pool->obj_name, "%s handshake %s in %u ms",
+              (ssock->session_reused? "Resumed" : "Full"),
+              (status == PJ_SUCCESS? "completed" : "failed"),
+              ssock->handshake_msec));
+}
+
 /* When handshake completed:
  * - notify application
  * - if handshake failed, reset SSL state
@@ -290,6 +334,8 @@ static pj_bool_t on_handshake_complete(pj_ssl_sock_t *ssock,
         ssock->timer.id = TIMER_NONE;
     }
 
+    update_handshake_stat(ssock, status);
+
     /* Update certificates info on successful handshake */
     if (status == PJ_SUCCESS)
         ssl_update_certs_info(ssock);
@@ -693,6 +739,263 @@ pj_status_t pj_ssl_sock_ossl_test_send_buf(pj_pool_t *pool)
 }
 #endif
 
+/*
+ *******************************************************************
+ * Handshake offload.
+ *******************************************************************
+ */
+
+/* Maximum input buffered while a handshake step is running */
+#define HS_BUF_MAX_SIZE     (128 * 1024)
+
+#if PJ_HAS_THREADS
+
+static struct hs_offload_t
+{
+    pj_caching_pool      cp;
+    pj_pool_t           *pool;
+    pj_work_queue       *wq;
+} hs_offload;
+
+/* Buffer input received while a handshake step is running. Must be called
+ * with circ_buf_input_mutex held.
+ */
+static pj_status_t hs_buf_append(pj_ssl_sock_t *ssock, const void *data,
+                                 pj_size_t size)
+{
+    if (ssock->hs_buf_len + size > ssock->hs_buf_size) {
+        pj_size_t new_size = ssock->hs_buf_size? ssock->hs_buf_size * 2 :
+                                                 ssock->param.read_buffer_size;
+        pj_uint8_t *new_buf;
+
+        while (new_size < ssock->hs_buf_len + size)
+            new_size *= 2;
+        if (new_size > HS_BUF_MAX_SIZE)
+            return PJ_ETOOBIG;
+
+        new_buf = (pj_uint8_t*)pj_pool_alloc(ssock->pool, new_size);
+        if (ssock->hs_buf_len)
+            pj_memcpy(new_buf, ssock->hs_buf, ssock->hs_buf_len);
+        ssock->hs_buf = new_buf;
+        ssock->hs_buf_size = new_size;
+    }
+
+    pj_memcpy(ssock->hs_buf + ssock->hs_buf_len, data, size);
+    ssock->hs_buf_len += size;
+    return PJ_SUCCESS;
+}
+
+/* Pass the buffered input to the SSL backend. Must be called with
+ * circ_buf_input_mutex held.
+ */
+static pj_status_t hs_buf_flush(pj_ssl_sock_t *ssock)
+{
+    pj_status_t status = PJ_SUCCESS;
+
+    if (ssock->hs_buf_len) {
+        status = io_write(ssock, &ssock->circ_buf_input, ssock->hs_buf,
+                          ssock->hs_buf_len);
+        ssock->hs_buf_len = 0;
+    }
+    return status;
+}
+
+/* Run handshake steps of a socket until there is nothing more to do */
+static void hs_run_job(pj_ssl_sock_t *ssock)
+{
+    pj_time_val delay = {0, 0};
+    pj_status_t status;
+
+    for (;;) {
+        pj_lock_acquire(ssock->circ_buf_input_mutex);
+        status = hs_buf_flush(ssock);
+        ssock->hs_again = PJ_FALSE;
+        pj_lock_release(ssock->circ_buf_input_mutex);
+
+        if (ssock->is_closing || ssock->ssl_state != SSL_STATE_HANDSHAKING)
+            status = PJ_ECANCELLED;
+        else if (status == PJ_SUCCESS)
+            status = ssl_do_handshake(ssock);
+
+        pj_lock_acquire(ssock->circ_buf_input_mutex);
+        if (status == PJ_EPENDING && (ssock->hs_again || ssock->hs_buf_len)) {
+            pj_lock_release(ssock->circ_buf_input_mutex);
+            continue;
+        }
+
+        /* Input received after the handshake is completed */
+        if (status == PJ_SUCCESS)
+            status = hs_buf_flush(ssock);
+
+        ssock->hs_busy = PJ_FALSE;
+        pj_lock_release(ssock->circ_buf_input_mutex);
+        break;
+    }
+
+    if (status == PJ_EPENDING || status == PJ_ECANCELLED)
+        return;
+
+    /* Complete the handshake on the timer thread, which normally also
+     * polls the ioqueue, as the application callback is called.
+     */
+    ssock->hs_status = status;
+    if (pj_timer_heap_schedule_w_grp_lock(ssock->param.timer_heap,
+                                          &ssock->hs_timer, &delay,
+                                          TIMER_HANDSHAKE_OFFLOAD,
+                                          ssock->param.grp_lock) !=
+        PJ_SUCCESS)
+    {
+        /* Complete it here then, holding the group lock as the socket
+         * may be closed by another thread meanwhile.
+         */
+        ssock->hs_timer.id = TIMER_NONE;
+        pj_grp_lock_acquire(ssock->param.grp_lock);
+        if (!ssock->is_closing)
+            on_handshake_complete(ssock, status);
+        pj_grp_lock_release(ssock->param.grp_lock);
+    }
+}
+
+/* Run a handshake step on one of the work queue threads */
+static void hs_job_cb(pj_work_job *job, pj_status_t status)
+{
+    pj_ssl_sock_t *ssock = (pj_ssl_sock_t*)job->user_data;
+
+    if (status == PJ_SUCCESS) {
+        hs_run_job(ssock);
+    } else {
+        /* Discarded at shutdown */
+        pj_lock_acquire(ssock->circ_buf_input_mutex);
+        ssock->hs_busy = PJ_FALSE;
+        pj_lock_release(ssock->circ_buf_input_mutex);
+    }
+
+    /* Release the reference taken when the step was queued */
+    pj_grp_lock_dec_ref(ssock->param.grp_lock);
+}
+
+static void hs_offload_shutdown(void)
+{
+    if (!hs_offload.pool)
+        return;
+
+    pj_work_queue_destroy(hs_offload.wq);
+    pj_pool_release(hs_offload.pool);
+    pj_caching_pool_destroy(&hs_offload.cp);
+    pj_bzero(&hs_offload, sizeof(hs_offload));
+}
+
+static pj_status_t hs_offload_init(void)
+{
+    pj_status_t status;
+
+    pj_bzero(&hs_offload, sizeof(hs_offload));
+
+    pj_caching_pool_init(&hs_offload.cp, NULL, 0);
+    hs_offload.pool = pj_pool_create(&hs_offload.cp.factory, "sslhs%p",
+                                     1000, 1000, NULL);
+    if (!hs_offload.pool) {
+        pj_caching_pool_destroy(&hs_offload.cp);
+        return PJ_ENOMEM;
+    }
+
+    status = pj_work_queue_create(hs_offload.pool, "sslhs%p",
+                                  PJ_SSL_SOCK_HANDSHAKE_THREAD_CNT,
+                                  &hs_offload.wq);
+    if (status != PJ_SUCCESS) {
+        PJ_PERROR(2,(THIS_FILE, status,
+                     "Error starting SSL handshake threads"));
+        pj_pool_release(hs_offload.pool);
+        pj_caching_pool_destroy(&hs_offload.cp);
+        pj_bzero(&hs_offload, sizeof(hs_offload));
+        return status;
+    }
+
+    pj_atexit(&hs_offload_shutdown);
+    return PJ_SUCCESS;
+}
+
+/* Queue a handshake step to the worker threads. Returns PJ_EPENDING if the
+ * step is queued or another one is already queued or running.
+ */
+static pj_status_t hs_offload_step(pj_ssl_sock_t *ssock)
+{
+    pj_status_t status = PJ_SUCCESS;
+
+    pj_lock_acquire(ssock->circ_buf_input_mutex);
+    if (ssock->hs_busy) {
+        ssock->hs_again = PJ_TRUE;
+        pj_lock_release(ssock->circ_buf_input_mutex);
+        return PJ_EPENDING;
+    }
+
+    pj_enter_critical_section();
+    if (!hs_offload.pool)
+        status = hs_offload_init();
+    pj_leave_critical_section();
+    if (status != PJ_SUCCESS) {
+        pj_lock_release(ssock->circ_buf_input_mutex);
+        return status;
+    }
+
+    ssock->hs_busy = PJ_TRUE;
+    pj_lock_release(ssock->circ_buf_input_mutex);
+
+    /* Keep the socket alive until the step is done */
+    pj_grp_lock_add_ref(ssock->param.grp_lock);
+    pj_work_job_init(&ssock->hs_job, &hs_job_cb, ssock);
+
+    status = pj_work_queue_post(hs_offload.wq, &ssock->hs_job);
+    if (status != PJ_SUCCESS) {
+        pj_lock_acquire(ssock->circ_buf_input_mutex);
+        ssock->hs_busy = PJ_FALSE;
+        pj_lock_release(ssock->circ_buf_input_mutex);
+        pj_grp_lock_dec_ref(ssock->param.grp_lock);
+        return status;
+    }
+
+    return PJ_EPENDING;
+}
+
+#endif  /* PJ_HAS_THREADS */
+
+/* Run a handshake step after receiving or sending handshake data, either
+ * directly or on the handshake worker threads.
+ */
+static pj_status_t handshake_step(pj_ssl_sock_t *ssock)
+{
+#if PJ_HAS_THREADS
+    if (ssock->param.handshake_offload && ssock->param.grp_lock &&
+        ssock->param.timer_heap)
+    {
+        return hs_offload_step(ssock);
+    }
+#endif
+    return ssl_do_handshake(ssock);
+}
+
+/* Pass received data to the SSL backend, or buffer it while a handshake
+ * step is running on the worker threads.
+ */
+static pj_status_t handshake_input(pj_ssl_sock_t *ssock, void *data,
+                                   pj_size_t size)
+{
+    pj_status_t status;
+
+    if (ssock->circ_buf_input_mutex)
+        pj_lock_acquire(ssock->circ_buf_input_mutex);
+#if PJ_HAS_THREADS
+    if (ssock->hs_busy)
+        status = hs_buf_append(ssock, data, size);
+    else
+#endif
+        status = io_write(ssock, &ssock->circ_buf_input, data, size);
+    if (ssock->circ_buf_input_mutex)
+        pj_lock_release(ssock->circ_buf_input_mutex);
+
+    return status;
+}
+
 static void on_timer(pj_timer_heap_t *th, struct pj_timer_entry *te)
 {
     pj_ssl_sock_t *ssock = (pj_ssl_sock_t*)te->user_data;
@@ -712,6 +1015,10 @@ static void on_timer(pj_timer_heap_t *th, struct pj_timer_entry *te)
     case TIMER_CLOSE:
         pj_ssl_sock_close(ssock);
         break;
+    case TIMER_HANDSHAKE_OFFLOAD:
+        if (!ssock->is_closing)
+            on_handshake_complete(ssock, ssock->hs_status);
+        break;
     default:
         pj_assert(!"Unknown timer");
         break;
@@ -774,11 +1081,7 @@ static pj_bool_t ssock_on_data_read (pj_ssl_sock_t *ssock,
         pj_status_t status_;
 
         /* Consume the whole data */
-        if (ssock->circ_buf_input_mutex)
-            pj_lock_acquire(ssock->circ_buf_input_mutex);
-        status_ = io_write(ssock,&ssock->circ_buf_input, data, size);
-        if (ssock->circ_buf_input_mutex)
-            pj_lock_release(ssock->circ_buf_input_mutex);
+        status_ = handshake_input(ssock, data, size);
         if (status_ != PJ_SUCCESS) {
             status = status_;
             goto on_error;
@@ -790,7 +1093,7 @@ static pj_bool_t ssock_on_data_read (pj_ssl_sock_t *ssock,
         pj_bool_t ret = PJ_TRUE;
 
         if (status == PJ_SUCCESS)
-            status = ssl_do_handshake(ssock);
+            status = handshake_step(ssock);
 
         /* Not pending is either success or failed */
         if (status != PJ_EPENDING)
@@ -923,7 +1226,7 @@ static pj_bool_t ssock_on_data_sent (pj_ssl_sock_t *ssock,
         /* Initial handshaking */
         pj_status_t status;
         
-        status = ssl_do_handshake(ssock);
+        status = handshake_step(ssock);
         /* Not pending is either success or failed */
         if (status != PJ_EPENDING)
             return on_handshake_complete(ssock, status);
@@ -1169,6 +1472,7 @@ static pj_bool_t ssock_on_accept_complete (pj_ssl_sock_t *ssock_parent,
     }
 
     /* Start SSL handshake */
+    pj_get_timestamp(&ssock->handshake_start);
     ssock->ssl_state = SSL_STATE_HANDSHAKING;
     ssl_set_state(ssock, PJ_TRUE);
     status = ssl_do_handshake(ssock);
@@ -1247,6 +1551,7 @@ static pj_bool_t ssock_on_connect_complete (pj_ssl_sock_t *ssock,
     ssl_set_peer_name(ssock);
 
     /* Start SSL handshake */
+    pj_get_timestamp(&ssock->handshake_start);
     ssock->ssl_state = SSL_STATE_HANDSHAKING;
     ssl_set_state(ssock, PJ_FALSE);
 
@@ -1483,6 +1788,7 @@ PJ_DEF(pj_status_t) pj_ssl_sock_create (pj_pool_t *pool,
     pj_list_init(&ssock->write_pending_empty);
     pj_list_init(&ssock->send_pending);
     pj_timer_entry_init(&ssock->timer, 0, ssock, &on_timer);
+    pj_timer_entry_init(&ssock->hs_timer, 0, ssock, &on_timer);
     pj_ioqueue_op_key_init(&ssock->handshake_op_key,
                            sizeof(pj_ioqueue_op_key_t));
     pj_ioqueue_op_key_init(&ssock->shutdown_op_key,
@@ -1542,6 +1848,10 @@ PJ_DEF(pj_status_t) pj_ssl_sock_close(pj_ssl_sock_t *ssock)
         pj_timer_heap_cancel(ssock->param.timer_heap, &ssock->timer);
         ssock->timer.id = TIMER_NONE;
     }
+    if (ssock->param.timer_heap) {
+        pj_timer_heap_cancel_if_active(ssock->param.timer_heap,
+                                       &ssock->hs_timer, TIMER_NONE);
+    }
 
     ssl_reset_sock_state(ssock);
 
@@ -1623,6 +1933,10 @@ PJ_DEF(pj_status_t) pj_ssl_sock_get_info (pj_ssl_sock_t *ssock,
     /* Group lock */
     info->grp_lock = ssock->param.grp_lock;
 
+    /* Session resumption and handshake duration */
+    info->session_reused = ssock->session_reused;
+    info->handshake_msec = ssock->handshake_msec;
+
     /* Native SSL object */
 #if defined(PJ_HAS_SSL_SOCK) && PJ_HAS_SSL_SOCK != 0 && \
     (PJ_SSL_SOCK_IMP == PJ_SSL_SOCK_IMP_OPENSSL)
@@ -2255,6 +2569,7 @@ PJ_DEF(pj_status_t) pj_ssl_sock_renegotiate(pj_ssl_sock_t *ssock)
     if (ssock->ssl_state != SSL_STATE_ESTABLISHED) 
         return PJ_EINVALIDOP;
 
+    pj_get_timestamp(&ssock->handshake_start);
     status = ssl_renegotiate(ssock);
     if (status == PJ_SUCCESS) {
         status = ssl_do_handshake(ssock);
@@ -2263,6 +2578,42 @@ PJ_DEF(pj_status_t) pj_ssl_sock_renegotiate(pj_ssl_sock_t *ssock)
     return status;
 }
 
+
+/*
+ * Get handshake statistics.
+ */
+PJ_DEF(pj_status_t)
+pj_ssl_sock_get_handshake_stat(pj_ssl_sock_handshake_stat *stat)
+{
+    PJ_ASSERT_RETURN(stat, PJ_EINVAL);
+
+    pj_enter_critical_section();
+    pj_memcpy(stat, &hs_stat.stat, sizeof(*stat));
+    if (stat->full_cnt) {
+        stat->full_avg_msec = (unsigned)
+                              (hs_stat.full_total_msec / stat->full_cnt);
+    }
+    if (stat->resumed_cnt) {
+        stat->resumed_avg_msec = (unsigned)
+                                 (hs_stat.resumed_total_msec /
+                                  stat->resumed_cnt);
+    }
+    pj_leave_critical_section();
+
+    return PJ_SUCCESS;
+}
+
+
+/*
+ * Reset handshake statistics.
+ */
+PJ_DEF(void) pj_ssl_sock_reset_handshake_stat(void)
+{
+    pj_enter_critical_section();
+    pj_bzero(&hs_stat, sizeof(hs_stat));
+    pj_leave_critical_section();
+}
+
 static void wipe_buf(pj_str_t *buf)
 {
     volatile char *p = buf->ptr;
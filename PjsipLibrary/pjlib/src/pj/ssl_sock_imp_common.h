@@ -21,6 +21,7 @@
 
 #include <pj/activesock.h>
 #include <pj/timer.h>
+#include <pj/work_queue.h>
 
 /*
  * SSL/TLS state enumeration.
@@ -39,7 +40,8 @@ enum timer_id
 {
     TIMER_NONE,
     TIMER_HANDSHAKE_TIMEOUT,
-    TIMER_CLOSE
+    TIMER_CLOSE,
+    TIMER_HANDSHAKE_OFFLOAD
 };
 
 /*
@@ -113,6 +115,9 @@ struct pj_ssl_sock_t
     pj_timer_entry        timer;
     pj_status_t           verify_status;
     pj_status_t           handshake_status;
+    pj_timestamp          handshake_start;
+    unsigned              handshake_msec;
+    pj_bool_t             session_reused;
 
     pj_bool_t             is_closing;
     unsigned long         last_err;
@@ -142,6 +147,16 @@ struct pj_ssl_sock_t
     circ_buf_t            circ_buf_input;
     pj_lock_t            *circ_buf_input_mutex;
 
+    /* Handshake offload, protected by circ_buf_input_mutex */
+    pj_work_job           hs_job;       /* queued to the handshake threads */
+    pj_bool_t             hs_busy;      /* step is queued or running       */
+    pj_bool_t             hs_again;     /* another step has been requested */
+    pj_status_t           hs_status;    /* result of the last step         */
+    pj_timer_entry        hs_timer;     /* to complete on the timer thread */
+    pj_uint8_t           *hs_buf;       /* input received while busy       */
+    pj_size_t             hs_buf_len;
+    pj_size_t             hs_buf_size;
+
     circ_buf_t            circ_buf_output;
     pj_lock_t            *circ_buf_output_mutex;
 };
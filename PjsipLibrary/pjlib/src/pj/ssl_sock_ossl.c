@@ -19,6 +19,7 @@
 #include <pj/activesock.h>
 #include <pj/compat/socket.h>
 #include <pj/assert.h>
+#include <pj/ctype.h>
 #include <pj/errno.h>
 #include <pj/file_access.h>
 #include <pj/list.h>
@@ -63,9 +64,6 @@
 /* Specify whether server supports session reuse using session ID. */
 #define SERVER_SUPPORT_SESSION_REUSE 1
 
-/* Specify whether server should disable session tickets. */
-#define SERVER_DISABLE_SESSION_TICKETS 1
-
 /* Each server application must set its own session id context,
  * which is used to distinguish the contexts and is stored in
  * exported sessions.
@@ -74,9 +72,18 @@
 #       define SERVER_SESSION_ID_CONTEXT 999
 #endif
 
-/* Server session timeout duration. Default is 300 sec. */
+/* Server session timeout duration, when pj_ssl_sock_param.session_timeout
+ * is not set. Default is 300 sec.
+ */
 #define SERVER_SESSION_TIMEOUT 300
 
+/* Server session cache size, shared by all sockets accepted by the same
+ * listener.
+ */
+#ifndef SERVER_SESSION_CACHE_SIZE
+#       define SERVER_SESSION_CACHE_SIZE 1024
+#endif
+
 #if defined(LIBRESSL_VERSION_NUMBER)
 #       define USING_LIBRESSL 1
 #else
@@ -95,6 +102,14 @@
 #      define USING_BORINGSSL 0
 #endif
 
+/* Client session cache needs the session API of OpenSSL 1.1.0. */
+#if PJ_SSL_SOCK_SESSION_CACHE_SIZE > 0 && !USING_LIBRESSL && \
+    OPENSSL_VERSION_NUMBER >= 0x10100000L
+#       define CLIENT_SESSION_CACHE 1
+#else
+#       define CLIENT_SESSION_CACHE 0
+#endif
+
 #if !USING_LIBRESSL && !defined(OPENSSL_NO_EC) \
         && OPENSSL_VERSION_NUMBER >= 0x1000200fL
 
@@ -230,6 +245,7 @@ typedef struct ossl_sock_t
     SSL                  *ossl_ssl;
     BIO                  *ossl_rbio;
     BIO                  *ossl_wbio;
+    char                 *sess_key;     /* Client session cache key     */
 } ossl_sock_t;
 
 
@@ -907,6 +923,259 @@ static void shutdown_openssl(void)
     PJ_UNUSED_ARG(openssl_init_count);
 }
 
+#if CLIENT_SESSION_CACHE
+
+/* Client session cache key length: "server_name|address:port|identity",
+ * where identity is the hex SHA-256 digest of the client credentials and
+ * trust settings (see client_sess_identity()).
+ */
+#define CLIENT_SESS_ID_LEN      64
+#define CLIENT_SESS_KEY_LEN     (PJ_MAX_HOSTNAME + PJ_INET6_ADDRSTRLEN + 10 + \
+                                 CLIENT_SESS_ID_LEN + 1)
+
+/* Client session cache entry */
+typedef struct client_sess_t
+{
+    char                 key[CLIENT_SESS_KEY_LEN];
+    SSL_SESSION         *sess;
+    pj_uint32_t          last_used;
+} client_sess_t;
+
+/* Client session cache, protected by pj_enter_critical_section(). */
+static client_sess_t     client_sess[PJ_SSL_SOCK_SESSION_CACHE_SIZE];
+static pj_uint32_t       client_sess_clock;
+static pj_bool_t         client_sess_atexit;
+
+/* Free all cached client sessions, called by pj_shutdown(). */
+static void client_sess_clear(void)
+{
+    unsigned i;
+
+    pj_enter_critical_section();
+    for (i = 0; i < PJ_ARRAY_SIZE(client_sess); ++i) {
+        if (client_sess[i].sess)
+            SSL_SESSION_free(client_sess[i].sess);
+    }
+    pj_bzero(client_sess, sizeof(client_sess));
+    client_sess_atexit = PJ_FALSE;
+    pj_leave_critical_section();
+}
+
+/* Find cache entry. Must be called inside critical section. */
+static client_sess_t *client_sess_find(const char *key)
+{
+    unsigned i;
+
+    for (i = 0; i < PJ_ARRAY_SIZE(client_sess); ++i) {
+        if (client_sess[i].sess && pj_ansi_strcmp(client_sess[i].key,
+                                                  key) == 0)
+        {
+            return &client_sess[i];
+        }
+    }
+    return NULL;
+}
+
+/* New client session callback, to store the session in the cache. Only
+ * sessions of servers whose certificate was verified successfully are
+ * stored, as certificate verification is skipped when a session is
+ * resumed. For TLSv1.3, this is called when the server sends a ticket
+ * after the handshake.
+ */
+static int client_sess_new_cb(SSL *ossl_ssl, SSL_SESSION *sess)
+{
+    pj_ssl_sock_t *ssock;
+    ossl_sock_t *ossock;
+    client_sess_t *entry;
+    unsigned i;
+
+    ssock = SSL_get_ex_data(ossl_ssl, sslsock_idx);
+    if (!ssock)
+        return 0;
+
+    ossock = (ossl_sock_t *)ssock;
+    if (!ossock->sess_key || ssock->verify_status != PJ_SSL_CERT_ESUCCESS)
+        return 0;
+
+#if OPENSSL_VERSION_NUMBER >= 0x1010100fL
+    if (!SSL_SESSION_is_resumable(sess))
+        return 0;
+#endif
+
+    pj_enter_critical_section();
+
+    /* Replace the session of the same server, or the least recently used
+     * one.
+     */
+    entry = client_sess_find(ossock->sess_key);
+    if (!entry) {
+        entry = &client_sess[0];
+        for (i = 1; i < PJ_ARRAY_SIZE(client_sess) && entry->sess; ++i) {
+            if (!client_sess[i].sess ||
+                client_sess[i].last_used < entry->last_used)
+            {
+                entry = &client_sess[i];
+            }
+        }
+        pj_ansi_strxcpy(entry->key, ossock->sess_key, sizeof(entry->key));
+    }
+    if (entry->sess)
+        SSL_SESSION_free(entry->sess);
+    entry->sess = sess;
+    entry->last_used = ++client_sess_clock;
+
+    if (!client_sess_atexit) {
+        pj_atexit(&client_sess_clear);
+        client_sess_atexit = PJ_TRUE;
+    }
+
+    pj_leave_critical_section();
+
+    PJ_LOG(5,(ssock->pool->obj_name, "TLS session of %s is cached",
+              ossock->sess_key));
+
+    /* We keep the reference */
+    return 1;
+}
+
+/* Add a length prefixed value to the identity digest */
+static void client_sess_digest(EVP_MD_CTX *md_ctx, const void *data,
+                               pj_size_t len)
+{
+    pj_uint32_t n = (pj_uint32_t)len;
+
+    EVP_DigestUpdate(md_ctx, &n, sizeof(n));
+    if (len)
+        EVP_DigestUpdate(md_ctx, data, len);
+}
+
+/* Get the digest of what a resumed session would skip or reuse from the
+ * earlier connection: the client certificate that authenticated us, and
+ * the CA certificates and verification settings that the server
+ * certificate was checked with. Sockets with a different identity must
+ * not resume each other's sessions. Returns PJ_FALSE on error.
+ */
+static pj_bool_t client_sess_identity(pj_ssl_sock_t *ssock,
+                                      char id[CLIENT_SESS_ID_LEN + 1])
+{
+    ossl_sock_t *ossock = (ossl_sock_t *)ssock;
+    pj_ssl_cert_t *cert = ssock->cert;
+    EVP_MD_CTX *md_ctx;
+    X509 *x509;
+    unsigned char md[EVP_MAX_MD_SIZE];
+    unsigned md_len = 0, i;
+    unsigned char x509_md[EVP_MAX_MD_SIZE];
+    unsigned x509_md_len = 0;
+    int verify_mode;
+    pj_bool_t ok;
+
+    md_ctx = EVP_MD_CTX_new();
+    if (!md_ctx)
+        return PJ_FALSE;
+
+    ok = EVP_DigestInit_ex(md_ctx, EVP_sha256(), NULL);
+
+    /* Our certificate, as loaded in the SSL instance */
+    x509 = SSL_get_certificate(ossock->ossl_ssl);
+    if (x509 && !X509_digest(x509, EVP_sha256(), x509_md, &x509_md_len))
+        ok = PJ_FALSE;
+    client_sess_digest(md_ctx, x509_md, x509_md_len);
+
+    /* Trust settings */
+    if (cert) {
+        client_sess_digest(md_ctx, cert->CA_file.ptr, cert->CA_file.slen);
+        client_sess_digest(md_ctx, cert->CA_path.ptr, cert->CA_path.slen);
+        client_sess_digest(md_ctx, cert->CA_buf.ptr, cert->CA_buf.slen);
+    } else {
+        client_sess_digest(md_ctx, NULL, 0);
+        client_sess_digest(md_ctx, NULL, 0);
+        client_sess_digest(md_ctx, NULL, 0);
+    }
+    verify_mode = SSL_get_verify_mode(ossock->ossl_ssl);
+    client_sess_digest(md_ctx, &verify_mode, sizeof(verify_mode));
+    client_sess_digest(md_ctx, &ssock->param.verify_peer,
+                       sizeof(ssock->param.verify_peer));
+    client_sess_digest(md_ctx, &ssock->param.cb.on_verify_cb,
+                       sizeof(ssock->param.cb.on_verify_cb));
+
+    if (ok && !EVP_DigestFinal_ex(md_ctx, md, &md_len))
+        ok = PJ_FALSE;
+    EVP_MD_CTX_free(md_ctx);
+
+    if (!ok || md_len * 2 > CLIENT_SESS_ID_LEN)
+        return PJ_FALSE;
+
+    for (i = 0; i < md_len; ++i)
+        pj_val_to_hex_digit(md[i], id + i * 2);
+    id[md_len * 2] = '\0';
+
+    return PJ_TRUE;
+}
+
+/* Set the cached session of the server, if any, to resume it */
+static void client_sess_resume(pj_ssl_sock_t *ssock)
+{
+    ossl_sock_t *ossock = (ossl_sock_t *)ssock;
+    client_sess_t *entry;
+    SSL_SESSION *sess = NULL;
+    pj_time_val now;
+
+    if (!ossock->sess_key) {
+        char addr[PJ_INET6_ADDRSTRLEN+10];
+        char id[CLIENT_SESS_ID_LEN + 1];
+
+        /* Don't cache anything if the identity is unknown */
+        if (!client_sess_identity(ssock, id))
+            return;
+
+        pj_sockaddr_print(&ssock->rem_addr, addr, sizeof(addr), 3);
+        ossock->sess_key = (char *)pj_pool_alloc(ssock->pool,
+                                                 CLIENT_SESS_KEY_LEN);
+        pj_ansi_snprintf(ossock->sess_key, CLIENT_SESS_KEY_LEN, "%.*s|%s|%s",
+                         (int)ssock->param.server_name.slen,
+                         ssock->param.server_name.ptr, addr, id);
+    }
+
+    pj_gettimeofday(&now);
+
+    pj_enter_critical_section();
+    entry = client_sess_find(ossock->sess_key);
+    if (entry) {
+        sess = entry->sess;
+        if ((long)(SSL_SESSION_get_time(sess) +
+                   SSL_SESSION_get_timeout(sess)) <= now.sec)
+        {
+            /* Expired */
+            entry->sess = NULL;
+            SSL_SESSION_free(sess);
+            sess = NULL;
+#ifdef TLS1_3_VERSION
+        } else if (SSL_SESSION_get_protocol_version(sess) ==
+                   TLS1_3_VERSION)
+        {
+            /* TLSv1.3 tickets should only be used once, the server sends
+             * a new one after the handshake.
+             */
+            entry->sess = NULL;
+#endif
+        } else {
+            SSL_SESSION_up_ref(sess);
+            entry->last_used = ++client_sess_clock;
+        }
+    }
+    pj_leave_critical_section();
+
+    if (sess) {
+        if (!SSL_set_session(ossock->ossl_ssl, sess)) {
+            PJ_LOG(4,(ssock->pool->obj_name, "Failed to set cached TLS "
+                      "session of %s", ossock->sess_key));
+        }
+        SSL_SESSION_free(sess);
+    }
+}
+
+#endif  /* CLIENT_SESSION_CACHE */
+
 /* SSL password callback. */
 static int password_cb(char *buf, int num, int rwflag, void *user_data)
 {
@@ -1222,23 +1491,34 @@ static pj_status_t init_ossl_ctx(pj_ssl_sock_t *ssock)
     if (ssock->is_server) {
         unsigned int sid_ctx = SERVER_SESSION_ID_CONTEXT;
 
-#if SERVER_DISABLE_SESSION_TICKETS
-        /* Disable session tickets for TLSv1.2 and below. */
-        ssl_opt |= SSL_OP_NO_TICKET;
+        if (!ssock->param.enable_session_tickets) {
+            /* Disable session tickets for TLSv1.2 and below. */
+            ssl_opt |= SSL_OP_NO_TICKET;
 #ifdef SSL_CTX_set_num_tickets
-        /* Set the number of TLSv1.3 session tickets issued to 0. */
-        SSL_CTX_set_num_tickets(ctx, 0);
-#endif
-
+            /* Set the number of TLSv1.3 session tickets issued to 0. */
+            SSL_CTX_set_num_tickets(ctx, 0);
 #endif
+        }
 
-        SSL_CTX_set_timeout(ctx, SERVER_SESSION_TIMEOUT);
+        SSL_CTX_set_timeout(ctx, ssock->param.session_timeout?
+                                 ssock->param.session_timeout:
+                                 SERVER_SESSION_TIMEOUT);
+        SSL_CTX_sess_set_cache_size(ctx, SERVER_SESSION_CACHE_SIZE);
         if (!SSL_CTX_set_session_id_context(ctx,
                  (const unsigned char *)&sid_ctx, sizeof(sid_ctx)))
         {
             PJ_LOG(1, (THIS_FILE, "Warning! Unable to set server session id "
                                   "context. Session reuse will not work."));
         }
+#if CLIENT_SESSION_CACHE
+    } else if (ssock->param.enable_session_reuse) {
+        /* Client sessions are kept in our own cache, as each client
+         * socket has its own context.
+         */
+        SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_CLIENT |
+                                            SSL_SESS_CACHE_NO_INTERNAL_STORE);
+        SSL_CTX_sess_set_new_cb(ctx, &client_sess_new_cb);
+#endif
     }
 
 #ifdef SSL_OP_NO_RENEGOTIATION
@@ -1667,6 +1947,14 @@ static pj_status_t ssl_create(pj_ssl_sock_t *ssock)
 
     SSL_set_verify(ossock->ossl_ssl, mode, &verify_cb);
 
+#if CLIENT_SESSION_CACHE
+    /* Resume the session of an earlier connection to the same server with
+     * the same identity and trust settings.
+     */
+    if (!ssock->is_server && ssock->param.enable_session_reuse)
+        client_sess_resume(ssock);
+#endif
+
     /* Set curve list */
     status = set_curves_list(ssock);
     if (status != PJ_SUCCESS)
@@ -2403,6 +2691,11 @@ static pj_status_t ssl_do_handshake(pj_ssl_sock_t *ssock)
     /* Check if handshake has been completed */
     if (SSL_is_init_finished(ossock->ossl_ssl)) {
 
+        if (ssock->ssl_state != SSL_STATE_ESTABLISHED) {
+            ssock->session_reused = SSL_session_reused(ossock->ossl_ssl)?
+                                    PJ_TRUE: PJ_FALSE;
+        }
+
 #if OPENSSL_VERSION_NUMBER >= 0x10100000L
         if (ssock->is_server && ssock->ssl_state != SSL_STATE_ESTABLISHED) {
             enum {BUF_SIZE = 64};
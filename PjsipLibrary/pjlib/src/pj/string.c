@@ -29,6 +29,491 @@
 #  include <pj/string_i.h>
 #endif
 
+#if PJ_STRING_USE_SIMD
+#   if defined(__SSE2__) || defined(_M_X64) || \
+       (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#       include <emmintrin.h>
+#       define STR_HAS_SSE2     1
+#       if (defined(__GNUC__) && !defined(__INTEL_COMPILER) && \
+            (__GNUC__ >= 5 || defined(__clang__))) && \
+           (defined(__x86_64__) || defined(__i386__))
+#           include <immintrin.h>
+#           define STR_HAS_AVX2 1
+#       endif
+#   elif defined(__aarch64__) || defined(_M_ARM64)
+#       include <arm_neon.h>
+#       define STR_HAS_NEON     1
+#   endif
+#endif
+
+/* glibc already has vectorized strncasecmp() for x86, which is as fast
+ * as ours, so there it's used directly.
+ */
+#ifndef STR_LIBC_HAS_SIMD_STRNICMP
+#   if defined(__GLIBC__) && (defined(__x86_64__) || defined(__i386__))
+#       define STR_LIBC_HAS_SIMD_STRNICMP   1
+#   else
+#       define STR_LIBC_HAS_SIMD_STRNICMP   0
+#   endif
+#endif
+
+#ifndef STR_HAS_SSE2
+#   define STR_HAS_SSE2         0
+#endif
+#ifndef STR_HAS_AVX2
+#   define STR_HAS_AVX2         0
+#endif
+#ifndef STR_HAS_NEON
+#   define STR_HAS_NEON         0
+#endif
+
+
+/*
+ * Vectorized case-insensitive comparison and substring search.
+ *
+ * The vector code only decides the easy parts: which leading blocks of
+ * two strings are equal (ignoring ASCII case) and contain no NUL, and at
+ * which positions a substring may start. Everything else, i.e. the block
+ * where the strings differ and the verification of substring matches,
+ * is done with pj_ansi_strnicmp()/pj_ansi_strncmp() as before, so the
+ * results are exactly those of the scalar code.
+ */
+
+/* Number of leading bytes of s1 and s2 (at most len) known to be equal
+ * ignoring ASCII case, with no NUL in them.
+ */
+typedef pj_size_t str_icmp_prefix(const char *s1, const char *s2,
+                                  pj_size_t len);
+
+/* Find the first of the candidate positions [0, *cnt) of s where sub may
+ * match, checking the first byte and byte m-1 of sub. Returns the first
+ * position which matches, or -1, and sets *cnt to the number of positions
+ * that have been checked.
+ */
+typedef pj_ssize_t str_find(const char *s, pj_size_t *cnt,
+                            const pj_str_t *sub, pj_size_t m,
+                            pj_bool_t icase);
+
+typedef struct str_simd_imp
+{
+    const char          *name;
+    str_icmp_prefix     *icmp_prefix;
+    str_find            *find;
+} str_simd_imp;
+
+/* Check that sub matches at s, the same way as the scalar code does. */
+static pj_bool_t str_match(const char *s, const pj_str_t *sub,
+                           pj_bool_t icase)
+{
+    if (icase)
+        return pj_ansi_strnicmp(s, sub->ptr, sub->slen)==0;
+    else
+        return pj_ansi_strncmp(s, sub->ptr, sub->slen)==0;
+}
+
+#if PJ_STRING_USE_SIMD
+
+#if defined(__GNUC__)
+#   define STR_CTZ(x)   ((unsigned)__builtin_ctzll(x))
+#else
+static unsigned str_ctz(pj_uint64_t x)
+{
+    unsigned n = 0;
+    while ((x & 1) == 0) {
+        x >>= 1;
+        ++n;
+    }
+    return n;
+}
+#   define STR_CTZ(x)   str_ctz(x)
+#endif
+
+#define SWAR_LSBS       ((((pj_uint64_t)0x01010101) << 32) | 0x01010101)
+#define SWAR_MSBS       (SWAR_LSBS << 7)
+
+/* Convert the ASCII upper case letters in the word to lower case. */
+static pj_uint64_t swar_fold(pj_uint64_t w)
+{
+    pj_uint64_t low = w & ~SWAR_MSBS;
+    pj_uint64_t ge_a = low + SWAR_LSBS * (0x80 - 'A');
+    pj_uint64_t gt_z = low + SWAR_LSBS * (0x80 - 'Z' - 1);
+
+    return w | ((ge_a & ~gt_z & ~w & SWAR_MSBS) >> 2);
+}
+
+static pj_bool_t swar_icmp_word(const char *s1, const char *s2)
+{
+    pj_uint64_t w1, w2;
+
+    pj_memcpy(&w1, s1, 8);
+    pj_memcpy(&w2, s2, 8);
+    return swar_fold(w1) == swar_fold(w2) &&
+           ((w1 - SWAR_LSBS) & ~w1 & SWAR_MSBS) == 0;
+}
+
+static pj_size_t swar_icmp_prefix(const char *s1, const char *s2,
+                                  pj_size_t len)
+{
+    pj_size_t i;
+
+    for (i=0; i+8 <= len; i+=8) {
+        if (!swar_icmp_word(s1+i, s2+i))
+            return i;
+    }
+
+    /* The last partial word, overlapping the bytes already checked */
+    if (i < len && len >= 8 && swar_icmp_word(s1+len-8, s2+len-8))
+        i = len;
+
+    return i;
+}
+
+#if STR_HAS_SSE2
+/* Mask of the ASCII upper case letters in the vector, with 0x20 in each
+ * such byte. Bytes above 0x7F are negative, so the signed comparison
+ * does not take them as letters.
+ */
+static __m128i sse2_upper(__m128i v)
+{
+    __m128i ge_a = _mm_cmpgt_epi8(v, _mm_set1_epi8('A' - 1));
+    __m128i le_z = _mm_cmplt_epi8(v, _mm_set1_epi8('Z' + 1));
+    return _mm_and_si128(_mm_and_si128(ge_a, le_z), _mm_set1_epi8(0x20));
+}
+
+static pj_bool_t sse2_icmp_block(const char *s1, const char *s2)
+{
+    __m128i v1 = _mm_loadu_si128((const __m128i*)s1);
+    __m128i v2 = _mm_loadu_si128((const __m128i*)s2);
+    __m128i f1 = _mm_or_si128(v1, sse2_upper(v1));
+    __m128i f2 = _mm_or_si128(v2, sse2_upper(v2));
+    __m128i ok = _mm_andnot_si128(_mm_cmpeq_epi8(v1, _mm_setzero_si128()),
+                                  _mm_cmpeq_epi8(f1, f2));
+    return _mm_movemask_epi8(ok) == 0xFFFF;
+}
+
+static pj_size_t sse2_icmp_prefix(const char *s1, const char *s2,
+                                  pj_size_t len)
+{
+    pj_size_t i;
+
+    if (len < 16)
+        return swar_icmp_prefix(s1, s2, len);
+
+    for (i=0; i+16 <= len; i+=16) {
+        if (!sse2_icmp_block(s1+i, s2+i))
+            return i;
+    }
+
+    /* The last partial block, overlapping the bytes already checked */
+    if (i < len && sse2_icmp_block(s1+len-16, s2+len-16))
+        i = len;
+
+    return i;
+}
+
+static pj_ssize_t sse2_find(const char *s, pj_size_t *cnt,
+                            const pj_str_t *sub, pj_size_t m,
+                            pj_bool_t icase)
+{
+    const __m128i fold = _mm_set1_epi8(icase ? 0x20 : 0);
+    const __m128i first = _mm_or_si128(_mm_set1_epi8(sub->ptr[0]), fold);
+    const __m128i last = _mm_or_si128(_mm_set1_epi8(sub->ptr[m-1]), fold);
+    pj_size_t i;
+
+    for (i=0; i+16 <= *cnt; i+=16) {
+        __m128i bf = _mm_loadu_si128((const __m128i*)(s+i));
+        __m128i bl = _mm_loadu_si128((const __m128i*)(s+i+m-1));
+        unsigned mask;
+
+        bf = _mm_cmpeq_epi8(_mm_or_si128(bf, fold), first);
+        bl = _mm_cmpeq_epi8(_mm_or_si128(bl, fold), last);
+        mask = (unsigned)_mm_movemask_epi8(_mm_and_si128(bf, bl));
+        while (mask) {
+            unsigned bit = STR_CTZ(mask);
+            if (str_match(s+i+bit, sub, icase))
+                return (pj_ssize_t)(i+bit);
+            mask &= mask - 1;
+        }
+    }
+    *cnt = i;
+    return -1;
+}
+
+static const str_simd_imp imp_sse2 =
+{
+    "sse2", &sse2_icmp_prefix, &sse2_find
+};
+#endif  /* STR_HAS_SSE2 */
+
+#if STR_HAS_AVX2
+#define AVX2_FUNC   __attribute__((target("avx2")))
+
+AVX2_FUNC static __m256i avx2_upper(__m256i v)
+{
+    __m256i ge_a = _mm256_cmpgt_epi8(v, _mm256_set1_epi8('A' - 1));
+    __m256i le_z = _mm256_cmpgt_epi8(_mm256_set1_epi8('Z' + 1), v);
+    return _mm256_and_si256(_mm256_and_si256(ge_a, le_z),
+                            _mm256_set1_epi8(0x20));
+}
+
+AVX2_FUNC static pj_bool_t avx2_icmp_block(const char *s1, const char *s2)
+{
+    __m256i v1 = _mm256_loadu_si256((const __m256i*)s1);
+    __m256i v2 = _mm256_loadu_si256((const __m256i*)s2);
+    __m256i f1 = _mm256_or_si256(v1, avx2_upper(v1));
+    __m256i f2 = _mm256_or_si256(v2, avx2_upper(v2));
+    __m256i ok = _mm256_andnot_si256(_mm256_cmpeq_epi8(v1,
+                                                   _mm256_setzero_si256()),
+                                     _mm256_cmpeq_epi8(f1, f2));
+    return (unsigned)_mm256_movemask_epi8(ok) == 0xFFFFFFFF;
+}
+
+AVX2_FUNC static pj_size_t avx2_icmp_prefix(const char *s1, const char *s2,
+                                            pj_size_t len)
+{
+    pj_size_t i;
+
+    if (len < 32)
+        return sse2_icmp_prefix(s1, s2, len);
+
+    for (i=0; i+32 <= len; i+=32) {
+        if (!avx2_icmp_block(s1+i, s2+i))
+            return i;
+    }
+
+    /* The last partial block, overlapping the bytes already checked */
+    if (i < len && avx2_icmp_block(s1+len-32, s2+len-32))
+        i = len;
+
+    return i;
+}
+
+AVX2_FUNC static pj_ssize_t avx2_find(const char *s, pj_size_t *cnt,
+                                      const pj_str_t *sub, pj_size_t m,
+                                      pj_bool_t icase)
+{
+    const __m256i fold = _mm256_set1_epi8(icase ? 0x20 : 0);
+    const __m256i first = _mm256_or_si256(_mm256_set1_epi8(sub->ptr[0]),
+                                          fold);
+    const __m256i last = _mm256_or_si256(_mm256_set1_epi8(sub->ptr[m-1]),
+                                         fold);
+    pj_size_t i, rest;
+    pj_ssize_t pos;
+
+    for (i=0; i+32 <= *cnt; i+=32) {
+        __m256i bf = _mm256_loadu_si256((const __m256i*)(s+i));
+        __m256i bl = _mm256_loadu_si256((const __m256i*)(s+i+m-1));
+        unsigned mask;
+
+        bf = _mm256_cmpeq_epi8(_mm256_or_si256(bf, fold), first);
+        bl = _mm256_cmpeq_epi8(_mm256_or_si256(bl, fold), last);
+        mask = (unsigned)_mm256_movemask_epi8(_mm256_and_si256(bf, bl));
+        while (mask) {
+            unsigned bit = STR_CTZ(mask);
+            if (str_match(s+i+bit, sub, icase))
+                return (pj_ssize_t)(i+bit);
+            mask &= mask - 1;
+        }
+    }
+
+    /* Remaining positions with 16 bytes vectors */
+    _mm256_zeroupper();
+    rest = *cnt - i;
+    pos = sse2_find(s+i, &rest, sub, m, icase);
+    *cnt = i + rest;
+    return pos < 0 ? pos : (pj_ssize_t)i + pos;
+}
+
+static const str_simd_imp imp_avx2 =
+{
+    "avx2", &avx2_icmp_prefix, &avx2_find
+};
+#endif  /* STR_HAS_AVX2 */
+
+#if STR_HAS_NEON
+/* Convert the movemask-like result of byte comparison (0x00 or 0xFF per
+ * byte) to 4 bits per byte.
+ */
+static pj_uint64_t neon_mask(uint8x16_t v)
+{
+    uint8x8_t n = vshrn_n_u16(vreinterpretq_u16_u8(v), 4);
+    return vget_lane_u64(vreinterpret_u64_u8(n), 0);
+}
+
+static uint8x16_t neon_fold(uint8x16_t v)
+{
+    uint8x16_t upper = vandq_u8(vcgeq_u8(v, vdupq_n_u8('A')),
+                                vcleq_u8(v, vdupq_n_u8('Z')));
+    return vorrq_u8(v, vandq_u8(upper, vdupq_n_u8(0x20)));
+}
+
+static pj_bool_t neon_icmp_block(const char *s1, const char *s2)
+{
+    uint8x16_t v1 = vld1q_u8((const pj_uint8_t*)s1);
+    uint8x16_t v2 = vld1q_u8((const pj_uint8_t*)s2);
+    uint8x16_t ok = vbicq_u8(vceqq_u8(neon_fold(v1), neon_fold(v2)),
+                             vceqzq_u8(v1));
+    return vminvq_u8(ok) == 0xFF;
+}
+
+static pj_size_t neon_icmp_prefix(const char *s1, const char *s2,
+                                  pj_size_t len)
+{
+    pj_size_t i;
+
+    if (len < 16)
+        return swar_icmp_prefix(s1, s2, len);
+
+    for (i=0; i+16 <= len; i+=16) {
+        if (!neon_icmp_block(s1+i, s2+i))
+            return i;
+    }
+
+    /* The last partial block, overlapping the bytes already checked */
+    if (i < len && neon_icmp_block(s1+len-16, s2+len-16))
+        i = len;
+
+    return i;
+}
+
+static pj_ssize_t neon_find(const char *s, pj_size_t *cnt,
+                            const pj_str_t *sub, pj_size_t m,
+                            pj_bool_t icase)
+{
+    const uint8x16_t fold = vdupq_n_u8(icase ? 0x20 : 0);
+    const uint8x16_t first = vorrq_u8(vdupq_n_u8((pj_uint8_t)sub->ptr[0]),
+                                      fold);
+    const uint8x16_t last = vorrq_u8(vdupq_n_u8((pj_uint8_t)sub->ptr[m-1]),
+                                     fold);
+    pj_size_t i;
+
+    for (i=0; i+16 <= *cnt; i+=16) {
+        uint8x16_t bf = vld1q_u8((const pj_uint8_t*)s+i);
+        uint8x16_t bl = vld1q_u8((const pj_uint8_t*)s+i+m-1);
+        pj_uint64_t mask;
+
+        bf = vceqq_u8(vorrq_u8(bf, fold), first);
+        bl = vceqq_u8(vorrq_u8(bl, fold), last);
+        mask = neon_mask(vandq_u8(bf, bl)) & 0x8888888888888888ULL;
+        while (mask) {
+            unsigned bit = STR_CTZ(mask) >> 2;
+            if (str_match(s+i+bit, sub, icase))
+                return (pj_ssize_t)(i+bit);
+            mask &= mask - 1;
+        }
+    }
+    *cnt = i;
+    return -1;
+}
+
+static const str_simd_imp imp_neon =
+{
+    "neon", &neon_icmp_prefix, &neon_find
+};
+#endif  /* STR_HAS_NEON */
+
+static const str_simd_imp imp_swar =
+{
+    "swar", &swar_icmp_prefix, NULL
+};
+
+static const str_simd_imp *str_imp;
+
+/* Select the implementation for the CPU we are running on. */
+static const str_simd_imp *get_str_imp(void)
+{
+    const str_simd_imp *imp = str_imp;
+
+    if (imp)
+        return imp;
+
+    imp = &imp_swar;
+#if STR_HAS_SSE2
+    imp = &imp_sse2;
+#endif
+#if STR_HAS_AVX2
+    if (__builtin_cpu_supports("avx2"))
+        imp = &imp_avx2;
+#endif
+#if STR_HAS_NEON
+    imp = &imp_neon;
+#endif
+
+    /* Setting the pointer more than once is harmless */
+    str_imp = imp;
+    return imp;
+}
+
+#endif  /* PJ_STRING_USE_SIMD */
+
+PJ_DEF(int) pj_ansi_strnicmp_fast(const char *s1, const char *s2,
+                                  pj_size_t len)
+{
+    pj_size_t i = 0;
+
+#if PJ_STRING_USE_SIMD && !STR_LIBC_HAS_SIMD_STRNICMP
+    if (len >= 8)
+        i = get_str_imp()->icmp_prefix(s1, s2, len);
+#endif
+
+    return i == len ? 0 : pj_ansi_strnicmp(s1+i, s2+i, len-i);
+}
+
+/* Substring search for pj_strstr() and pj_stristr() */
+static char *find_substr(const pj_str_t *str, const pj_str_t *substr,
+                         pj_bool_t icase)
+{
+    const char *s = str->ptr;
+    pj_size_t cnt, i, m;
+    int first;
+
+    /* Number of positions where substr may start */
+    cnt = str->slen - substr->slen + 1;
+
+    /* Effective length of substr: the comparison functions stop at NUL,
+     * so bytes after the first NUL never take part in the match.
+     */
+    for (m=0; m<(pj_size_t)substr->slen && substr->ptr[m]; ++m)
+        ;
+    if (m < (pj_size_t)substr->slen)
+        ++m;
+
+    i = 0;
+#if PJ_STRING_USE_SIMD
+    if (m > 1) {
+        const str_simd_imp *imp = get_str_imp();
+        if (imp->find) {
+            pj_ssize_t pos;
+
+            i = cnt;
+            pos = (*imp->find)(s, &i, substr, m, icase);
+            if (pos >= 0)
+                return (char*)s + pos;
+        }
+    }
+#endif
+
+    /* Remaining positions */
+    first = (pj_uint8_t)substr->ptr[0];
+    if (!icase) {
+        while (i < cnt) {
+            const char *p = (const char*)pj_memchr(s+i, first, cnt-i);
+            if (!p)
+                break;
+            if (str_match(p, substr, icase))
+                return (char*)p;
+            i = p - s + 1;
+        }
+    } else {
+        first = pj_tolower(first);
+        for (; i < cnt; ++i) {
+            if (pj_tolower(s[i]) == first && str_match(s+i, substr, icase))
+                return (char*)s+i;
+        }
+    }
+    return NULL;
+}
+
 
 PJ_DEF(pj_ssize_t) pj_strspn(const pj_str_t *str, const pj_str_t *set_char)
 {
@@ -145,8 +630,6 @@ PJ_DEF(pj_ssize_t) pj_strtok2(const pj_str_t *str, const char *delim,
 
 PJ_DEF(char*) pj_strstr(const pj_str_t *str, const pj_str_t *substr)
 {
-    const char *s, *ends;
-
     PJ_ASSERT_RETURN(str->slen >= 0 && substr->slen >= 0, NULL);
 
     /* Check if the string is empty */
@@ -158,20 +641,15 @@ PJ_DEF(char*) pj_strstr(const pj_str_t *str, const pj_str_t *substr)
         return (char*)str->ptr;
     }
 
-    s = str->ptr;
-    ends = str->ptr + str->slen - substr->slen;
-    for (; s<=ends; ++s) {
-        if (pj_ansi_strncmp(s, substr->ptr, substr->slen)==0)
-            return (char*)s;
-    }
-    return NULL;
+    if (str->slen < substr->slen)
+        return NULL;
+
+    return find_substr(str, substr, PJ_FALSE);
 }
 
 
 PJ_DEF(char*) pj_stristr(const pj_str_t *str, const pj_str_t *substr)
 {
-    const char *s, *ends;
-
     PJ_ASSERT_RETURN(str->slen >= 0 && substr->slen >= 0, NULL);
 
     /* Check if the string is empty */
@@ -183,13 +661,10 @@ PJ_DEF(char*) pj_stristr(const pj_str_t *str, const pj_str_t *substr)
         return (char*)str->ptr;
     }
 
-    s = str->ptr;
-    ends = str->ptr + str->slen - substr->slen;
-    for (; s<=ends; ++s) {
-        if (pj_ansi_strnicmp(s, substr->ptr, substr->slen)==0)
-            return (char*)s;
-    }
-    return NULL;
+    if (str->slen < substr->slen)
+        return NULL;
+
+    return find_substr(str, substr, PJ_TRUE);
 }
 
 
@@ -45,6 +45,19 @@
 
 #define DEFAULT_MAX_TIMED_OUT_PER_POLL  (64)
 
+/* Timing wheel geometry: WHEEL_LEVELS levels of WHEEL_SIZE slots each,
+ * covering 2^(WHEEL_BITS*WHEEL_LEVELS) ticks (about 124 days with 10 msec
+ * resolution). Entries further than that are parked in the last level and
+ * re-placed when that slot is cascaded. The extra slot after the levels is
+ * the list of entries which have expired but not been polled yet.
+ */
+#define WHEEL_BITS      6
+#define WHEEL_SIZE      (1 << WHEEL_BITS)
+#define WHEEL_MASK      (WHEEL_SIZE - 1)
+#define WHEEL_LEVELS    5
+#define WHEEL_MAX_TICKS ((pj_uint_t)1 << (WHEEL_BITS * WHEEL_LEVELS))
+#define WHEEL_DUE       (WHEEL_LEVELS * WHEEL_SIZE)
+
 /* Enable this to raise assertion in order to catch bug of timer entry
  * which has been deallocated without being cancelled. If disabled,
  * the timer heap will simply remove the destroyed entry (and print log)
@@ -181,6 +194,37 @@ struct pj_timer_heap_t
     /** Callback to be called when a timer expires. */
     pj_timer_heap_callback *callback;
 
+    /** The timer heap implementation. */
+    pj_timer_heap_type type;
+
+    /*
+     * The following are only used by the timing wheel. For the wheel,
+     * <heap> and <timer_ids> are indexed by timer id, i.e: an active entry
+     * with timer id <i> is at <heap[i]> and has <timer_ids[i]> == i, so
+     * that the freelist and cancel() work the same way as for the heap.
+     */
+
+    /** Tick granularity, in msec. */
+    unsigned wheel_res;
+
+    /** The tick count reference, in msec. */
+    pj_uint_t wheel_base;
+
+    /** The next tick to be processed. */
+    pj_uint_t wheel_cur;
+
+    /** Number of entries in each level, plus the due list. */
+    pj_size_t wheel_cnt[WHEEL_LEVELS + 1];
+
+    /** Timer id of the first entry in each slot, or zero if empty. */
+    pj_timer_id_t wheel_slots[WHEEL_DUE + 1];
+
+    /** Circular doubly linked lists of the slots, indexed by timer id. */
+    pj_timer_id_t *wheel_next;
+    pj_timer_id_t *wheel_prev;
+
+    /** The slot where each entry resides, indexed by timer id. */
+    unsigned *wheel_slot_of;
 };
 
 
@@ -299,6 +343,226 @@ static void reheap_up( pj_timer_heap_t *ht, pj_timer_entry_dup *moved_node,
 }
 
 
+static pj_uint_t wheel_msec(const pj_time_val *t)
+{
+    return (pj_uint_t)t->sec * 1000 + t->msec;
+}
+
+/* Get the first tick at or after the specified time. */
+static pj_uint_t wheel_expire_tick(pj_timer_heap_t *ht, const pj_time_val *t)
+{
+    pj_uint_t msec = wheel_msec(t);
+
+    if (msec <= ht->wheel_base)
+        return 0;
+    return (msec - ht->wheel_base + ht->wheel_res - 1) / ht->wheel_res;
+}
+
+static void wheel_link(pj_timer_heap_t *ht, unsigned slot, pj_timer_id_t id)
+{
+    pj_timer_id_t head = ht->wheel_slots[slot];
+
+    // Append to the tail of the circular list.
+    if (head == 0) {
+        ht->wheel_next[id] = ht->wheel_prev[id] = id;
+        ht->wheel_slots[slot] = id;
+    } else {
+        pj_timer_id_t tail = ht->wheel_prev[head];
+
+        ht->wheel_next[tail] = id;
+        ht->wheel_prev[id] = tail;
+        ht->wheel_next[id] = head;
+        ht->wheel_prev[head] = id;
+    }
+    ht->wheel_slot_of[id] = slot;
+    ht->wheel_cnt[slot >> WHEEL_BITS]++;
+}
+
+static void wheel_unlink(pj_timer_heap_t *ht, pj_timer_id_t id)
+{
+    unsigned slot = ht->wheel_slot_of[id];
+
+    if (ht->wheel_next[id] == id) {
+        ht->wheel_slots[slot] = 0;
+    } else {
+        ht->wheel_next[ht->wheel_prev[id]] = ht->wheel_next[id];
+        ht->wheel_prev[ht->wheel_next[id]] = ht->wheel_prev[id];
+        if (ht->wheel_slots[slot] == id)
+            ht->wheel_slots[slot] = ht->wheel_next[id];
+    }
+    ht->wheel_cnt[slot >> WHEEL_BITS]--;
+}
+
+/* Put the entry in the slot matching its expiration, relative to the
+ * current tick. Entries whose tick has been processed go to the due list.
+ */
+static void wheel_place(pj_timer_heap_t *ht, pj_timer_id_t id)
+{
+    pj_uint_t expires = wheel_expire_tick(ht, &ht->heap[id]->_timer_value);
+    pj_uint_t delta;
+    unsigned level;
+
+    if (expires < ht->wheel_cur) {
+        wheel_link(ht, WHEEL_DUE, id);
+        return;
+    }
+
+    delta = expires - ht->wheel_cur;
+    if (delta >= WHEEL_MAX_TICKS) {
+        delta = WHEEL_MAX_TICKS - 1;
+        expires = ht->wheel_cur + delta;
+    }
+
+    level = 0;
+    while (delta >= ((pj_uint_t)1 << (WHEEL_BITS * (level + 1))))
+        ++level;
+
+    wheel_link(ht, (level << WHEEL_BITS) +
+               (unsigned)((expires >> (WHEEL_BITS * level)) & WHEEL_MASK),
+               id);
+}
+
+/* Move all entries in the slot to the due list (for level zero) or
+ * re-place them in the lower levels.
+ */
+static void wheel_cascade(pj_timer_heap_t *ht, unsigned slot)
+{
+    pj_timer_id_t id = ht->wheel_slots[slot];
+    pj_timer_id_t tail;
+
+    if (id == 0)
+        return;
+
+    tail = ht->wheel_prev[id];
+    for (;;) {
+        pj_timer_id_t next = ht->wheel_next[id];
+
+        wheel_unlink(ht, id);
+        if (slot < WHEEL_SIZE)
+            wheel_link(ht, WHEEL_DUE, id);
+        else
+            wheel_place(ht, id);
+
+        if (id == tail)
+            break;
+        id = next;
+    }
+}
+
+/* Process all ticks up to the specified time. */
+static void wheel_advance(pj_timer_heap_t *ht, const pj_time_val *now)
+{
+    pj_uint_t now_tick;
+
+    if (wheel_msec(now) < ht->wheel_base)
+        return;
+    now_tick = (wheel_msec(now) - ht->wheel_base) / ht->wheel_res;
+
+    while (ht->wheel_cur <= now_tick) {
+        unsigned idx = (unsigned)(ht->wheel_cur & WHEEL_MASK);
+        unsigned level;
+
+        if (ht->cur_size == ht->wheel_cnt[WHEEL_LEVELS]) {
+            // Nothing left in the wheel, just jump to the current tick.
+            ht->wheel_cur = now_tick + 1;
+            break;
+        }
+
+        if (idx != 0 && ht->wheel_cnt[0] == 0) {
+            // Nothing to expire until the next cascade.
+            ht->wheel_cur = (ht->wheel_cur | WHEEL_MASK) + 1;
+            if (ht->wheel_cur > now_tick + 1)
+                ht->wheel_cur = now_tick + 1;
+            continue;
+        }
+
+        // Cascade the upper levels each time a lower level wraps around.
+        for (level = 1; idx == 0 && level < WHEEL_LEVELS; ++level) {
+            idx = (unsigned)((ht->wheel_cur >> (WHEEL_BITS * level)) &
+                             WHEEL_MASK);
+            wheel_cascade(ht, (level << WHEEL_BITS) + idx);
+        }
+
+        wheel_cascade(ht, (unsigned)(ht->wheel_cur & WHEEL_MASK));
+        ht->wheel_cur++;
+    }
+}
+
+/* Get the time of the earliest tick which will expire or cascade entries. */
+static void wheel_earliest(pj_timer_heap_t *ht, pj_time_val *timeval)
+{
+    pj_uint_t tick = 0;
+    pj_uint_t msec;
+    pj_bool_t found = PJ_FALSE;
+    unsigned level;
+
+    if (ht->wheel_slots[WHEEL_DUE]) {
+        *timeval = ht->heap[ht->wheel_slots[WHEEL_DUE]]->_timer_value;
+        return;
+    }
+
+    for (level = 0; level < WHEEL_LEVELS; ++level) {
+        unsigned shift = WHEEL_BITS * level;
+        pj_uint_t pos = ht->wheel_cur >> shift;
+        unsigned i;
+
+        if (ht->wheel_cnt[level] == 0)
+            continue;
+
+        // Slots of the upper levels are processed on the first tick
+        // which is a multiple of the level span.
+        if (ht->wheel_cur & (((pj_uint_t)1 << shift) - 1))
+            ++pos;
+
+        for (i = 0; i < WHEEL_SIZE; ++i) {
+            unsigned slot = (level << WHEEL_BITS) +
+                            (unsigned)((pos + i) & WHEEL_MASK);
+            if (ht->wheel_slots[slot]) {
+                if (!found || ((pos + i) << shift) < tick) {
+                    tick = (pos + i) << shift;
+                    found = PJ_TRUE;
+                }
+                break;
+            }
+        }
+    }
+
+    pj_assert(found);
+    msec = ht->wheel_base + tick * ht->wheel_res;
+    timeval->sec = (long)(msec / 1000);
+    timeval->msec = (long)(msec % 1000);
+}
+
+static void get_earliest_time(pj_timer_heap_t *ht, pj_time_val *timeval)
+{
+    if (ht->type == PJ_TIMER_HEAP_TYPE_WHEEL)
+        wheel_earliest(ht, timeval);
+    else
+        *timeval = ht->heap[0]->_timer_value;
+}
+
+/* Get the slot of the earliest entry if it has expired. */
+static pj_bool_t get_expired_slot(pj_timer_heap_t *ht,
+                                  const pj_time_val *now,
+                                  pj_timer_id_t *slot)
+{
+    if (ht->type == PJ_TIMER_HEAP_TYPE_WHEEL) {
+        wheel_advance(ht, now);
+        *slot = ht->wheel_slots[WHEEL_DUE];
+        return (*slot != 0);
+    }
+
+    if (!ht->cur_size)
+        return PJ_FALSE;
+
+#if PJ_TIMER_USE_LINKED_LIST
+    *slot = ht->timer_ids[GET_FIELD(ht->head_list.next, _timer_id)];
+#else
+    *slot = 0;
+#endif
+    return PJ_TIME_VAL_LTE(ht->heap[*slot]->_timer_value, *now);
+}
+
 static pj_timer_entry_dup * remove_node( pj_timer_heap_t *ht, size_t slot)
 {
     pj_timer_entry_dup *removed_node = ht->heap[slot];
@@ -334,6 +598,13 @@ static pj_timer_entry_dup * remove_node( pj_timer_heap_t *ht, size_t slot)
     GET_ENTRY(removed_node)->_timer_id = -1;
     GET_FIELD(removed_node, _timer_id) = -1;
 
+    if (ht->type == PJ_TIMER_HEAP_TYPE_WHEEL) {
+        // For the wheel, the slot is the timer id.
+        wheel_unlink(ht, (pj_timer_id_t)slot);
+        ht->heap[slot] = NULL;
+        return removed_node;
+    }
+
 #if !PJ_TIMER_USE_LINKED_LIST
     // Only try to reheapify if we're not deleting the last entry.
 
@@ -371,6 +642,7 @@ static pj_status_t grow_heap(pj_timer_heap_t *ht)
     size_t new_size = ht->max_size * 2;
 #if PJ_TIMER_USE_COPY
     pj_timer_entry_dup *new_timer_dups = 0;
+    pj_size_t n;
 #endif
     pj_timer_id_t *new_timer_ids;
     pj_size_t i;
@@ -402,8 +674,15 @@ static pj_status_t grow_heap(pj_timer_heap_t *ht)
 
     memcpy(new_timer_dups, ht->timer_dups,
            ht->max_size * sizeof(pj_timer_entry_dup));
-    for (i = 0; i < ht->cur_size; i++) {
-        int idx = (int)(ht->heap[i] - ht->timer_dups);
+    // The wheel's heap array is sparse, indexed by timer id.
+    n = (ht->type == PJ_TIMER_HEAP_TYPE_WHEEL ? ht->max_size : ht->cur_size);
+    for (i = 0; i < n; i++) {
+        int idx;
+
+        if (!ht->heap[i])
+            continue;
+
+        idx = (int)(ht->heap[i] - ht->timer_dups);
         // Point to the address in the new array
         pj_assert(idx >= 0 && idx < (int)ht->max_size);
         new_heap[i] = &new_timer_dups[idx];
@@ -439,6 +718,30 @@ static pj_status_t grow_heap(pj_timer_heap_t *ht)
     //delete [] timer_ids_;
     ht->timer_ids = new_timer_ids;
 
+    if (ht->type == PJ_TIMER_HEAP_TYPE_WHEEL) {
+        pj_timer_id_t *new_next, *new_prev;
+        unsigned *new_slot_of;
+
+        new_next = (pj_timer_id_t*)
+                   pj_pool_alloc(ht->pool, new_size * sizeof(pj_timer_id_t));
+        new_prev = (pj_timer_id_t*)
+                   pj_pool_alloc(ht->pool, new_size * sizeof(pj_timer_id_t));
+        new_slot_of = (unsigned*)
+                      pj_pool_alloc(ht->pool, new_size * sizeof(unsigned));
+        if (!new_next || !new_prev || !new_slot_of)
+            return PJ_ENOMEM;
+
+        memcpy(new_next, ht->wheel_next,
+               ht->max_size * sizeof(pj_timer_id_t));
+        memcpy(new_prev, ht->wheel_prev,
+               ht->max_size * sizeof(pj_timer_id_t));
+        memcpy(new_slot_of, ht->wheel_slot_of,
+               ht->max_size * sizeof(unsigned));
+        ht->wheel_next = new_next;
+        ht->wheel_prev = new_prev;
+        ht->wheel_slot_of = new_slot_of;
+    }
+
     // And add the new elements to the end of the "freelist".
     for (i = ht->max_size; i < new_size; i++)
         ht->timer_ids[i] = -((pj_timer_id_t) (i + 1));
@@ -478,6 +781,13 @@ static pj_status_t insert_node(pj_timer_heap_t *ht,
 
     timer_copy->_timer_value = *future_time;
 
+    if (ht->type == PJ_TIMER_HEAP_TYPE_WHEEL) {
+        copy_node(ht, new_node->_timer_id, timer_copy);
+        wheel_place(ht, new_node->_timer_id);
+        ht->cur_size++;
+        return PJ_SUCCESS;
+    }
+
 #if !PJ_TIMER_USE_LINKED_LIST
     reheap_up(ht, timer_copy, ht->cur_size, HEAP_PARENT(ht->cur_size));
 #else
@@ -581,6 +891,13 @@ PJ_DEF(pj_size_t) pj_timer_heap_mem_size(pj_size_t count)
            132;
 }
 
+PJ_DEF(void) pj_timer_heap_cfg_default(pj_timer_heap_cfg *cfg)
+{
+    pj_bzero(cfg, sizeof(*cfg));
+    cfg->type = PJ_TIMER_HEAP_DEFAULT_TYPE;
+    cfg->wheel_resolution = PJ_TIMER_WHEEL_RESOLUTION;
+}
+
 /*
  * Create a new timer heap.
  */
@@ -588,11 +905,29 @@ PJ_DEF(pj_status_t) pj_timer_heap_create( pj_pool_t *pool,
                                           pj_size_t size,
                                           pj_timer_heap_t **p_heap)
 {
+    return pj_timer_heap_create2(pool, size, NULL, p_heap);
+}
+
+PJ_DEF(pj_status_t) pj_timer_heap_create2( pj_pool_t *pool,
+                                           pj_size_t size,
+                                           const pj_timer_heap_cfg *cfg,
+                                           pj_timer_heap_t **p_heap)
+{
+    pj_timer_heap_cfg dflt_cfg;
     pj_timer_heap_t *ht;
     pj_size_t i;
 
     PJ_ASSERT_RETURN(pool && p_heap, PJ_EINVAL);
 
+    if (!cfg) {
+        pj_timer_heap_cfg_default(&dflt_cfg);
+        cfg = &dflt_cfg;
+    }
+    PJ_ASSERT_RETURN(cfg->type == PJ_TIMER_HEAP_TYPE_HEAP ||
+                     cfg->type == PJ_TIMER_HEAP_TYPE_WHEEL, PJ_EINVAL);
+    PJ_ASSERT_RETURN(cfg->type != PJ_TIMER_HEAP_TYPE_WHEEL ||
+                     cfg->wheel_resolution > 0, PJ_EINVAL);
+
     *p_heap = NULL;
 
     /* Magic? */
@@ -609,6 +944,7 @@ PJ_DEF(pj_status_t) pj_timer_heap_create( pj_pool_t *pool,
     ht->max_entries_per_poll = DEFAULT_MAX_TIMED_OUT_PER_POLL;
     ht->timer_ids_freelist = 1;
     ht->pool = pool;
+    ht->type = cfg->type;
 
     /* Lock. */
     ht->lock = NULL;
@@ -644,6 +980,24 @@ PJ_DEF(pj_status_t) pj_timer_heap_create( pj_pool_t *pool,
     pj_list_init(&ht->head_list);
 #endif
 
+    if (ht->type == PJ_TIMER_HEAP_TYPE_WHEEL) {
+        pj_time_val now;
+
+        ht->wheel_next = (pj_timer_id_t*)
+                         pj_pool_alloc(pool, sizeof(pj_timer_id_t) * size);
+        ht->wheel_prev = (pj_timer_id_t*)
+                         pj_pool_alloc(pool, sizeof(pj_timer_id_t) * size);
+        ht->wheel_slot_of = (unsigned*)
+                            pj_pool_alloc(pool, sizeof(unsigned) * size);
+        if (!ht->wheel_next || !ht->wheel_prev || !ht->wheel_slot_of)
+            return PJ_ENOMEM;
+
+        pj_gettickcount(&now);
+        ht->wheel_res = cfg->wheel_resolution;
+        ht->wheel_base = wheel_msec(&now);
+        ht->wheel_cur = 0;
+    }
+
     *p_heap = ht;
     return PJ_SUCCESS;
 }
@@ -856,7 +1210,6 @@ PJ_DEF(unsigned) pj_timer_heap_poll( pj_timer_heap_t *ht,
                                      pj_time_val *next_delay )
 {
     pj_time_val now;
-    pj_time_val min_time_node = {0,0};
     unsigned count;
     pj_timer_id_t slot = 0;
 
@@ -872,16 +1225,8 @@ PJ_DEF(unsigned) pj_timer_heap_poll( pj_timer_heap_t *ht,
     count = 0;
     pj_gettickcount(&now);
 
-    if (ht->cur_size) {
-#if PJ_TIMER_USE_LINKED_LIST
-        slot = ht->timer_ids[GET_FIELD(ht->head_list.next, _timer_id)];
-#endif
-        min_time_node = ht->heap[slot]->_timer_value;
-    }
-
-    while ( ht->cur_size && 
-            PJ_TIME_VAL_LTE(min_time_node, now) &&
-            count < ht->max_entries_per_poll ) 
+    while ( count < ht->max_entries_per_poll &&
+            get_expired_slot(ht, &now, &slot) )
     {
         pj_timer_entry_dup *node = remove_node(ht, slot);
         pj_timer_entry *entry = GET_ENTRY(node);
@@ -930,16 +1275,12 @@ PJ_DEF(unsigned) pj_timer_heap_poll( pj_timer_heap_t *ht,
         ///push_freelist(ht, node_timer_id);
 
         if (ht->cur_size) {
-#if PJ_TIMER_USE_LINKED_LIST
-            slot = ht->timer_ids[GET_FIELD(ht->head_list.next, _timer_id)];
-#endif
-            min_time_node = ht->heap[slot]->_timer_value;
             /* Update now */
             pj_gettickcount(&now);
         }
     }
     if (ht->cur_size && next_delay) {
-        *next_delay = ht->heap[0]->_timer_value;
+        get_earliest_time(ht, next_delay);
         if (count > 0)
             pj_gettickcount(&now);
         PJ_TIME_VAL_SUB(*next_delay, now);
@@ -968,13 +1309,30 @@ PJ_DEF(pj_status_t) pj_timer_heap_earliest_time( pj_timer_heap_t * ht,
         return PJ_ENOTFOUND;
 
     lock_timer_heap(ht);
-    *timeval = ht->heap[0]->_timer_value;
+    get_earliest_time(ht, timeval);
     unlock_timer_heap(ht);
 
     return PJ_SUCCESS;
 }
 
 #if PJ_TIMER_DEBUG
+static void dump_entry(pj_timer_entry_dup *e, const pj_time_val *now)
+{
+    pj_time_val delta;
+
+    if (PJ_TIME_VAL_LTE(e->_timer_value, *now))
+        delta.sec = delta.msec = 0;
+    else {
+        delta = e->_timer_value;
+        PJ_TIME_VAL_SUB(delta, *now);
+    }
+
+    PJ_LOG(3,(THIS_FILE, "    %d\t%d\t%d.%03d\t%s:%d",
+              GET_FIELD(e, _timer_id), GET_FIELD(e, id),
+              (int)delta.sec, (int)delta.msec,
+              e->src_file, e->src_line));
+}
+
 PJ_DEF(void) pj_timer_heap_dump(pj_timer_heap_t *ht)
 {
     lock_timer_heap(ht);
@@ -986,9 +1344,8 @@ PJ_DEF(void) pj_timer_heap_dump(pj_timer_heap_t *ht)
     if (ht->cur_size) {
 #if PJ_TIMER_USE_LINKED_LIST
         pj_timer_entry_dup *tmp_dup;
-#else
-        unsigned i;
 #endif
+        pj_size_t i;
         pj_time_val now;
 
         PJ_LOG(3,(THIS_FILE, "  Entries: "));
@@ -997,30 +1354,24 @@ PJ_DEF(void) pj_timer_heap_dump(pj_timer_heap_t *ht)
 
         pj_gettickcount(&now);
 
+        if (ht->type == PJ_TIMER_HEAP_TYPE_WHEEL) {
+            /* The wheel's heap array is sparse, indexed by timer id. */
+            for (i=0; i<ht->max_size; ++i) {
+                if (ht->heap[i])
+                    dump_entry(ht->heap[i], &now);
+            }
+        } else {
 #if !PJ_TIMER_USE_LINKED_LIST
-        for (i=0; i<(unsigned)ht->cur_size; ++i)
-        {
-            pj_timer_entry_dup *e = ht->heap[i];
+            for (i=0; i<ht->cur_size; ++i)
+                dump_entry(ht->heap[i], &now);
 #else
-        for (tmp_dup = ht->head_list.next; tmp_dup != &ht->head_list;
-             tmp_dup = tmp_dup->next)
-        {
-            pj_timer_entry_dup *e = tmp_dup;
-#endif
-
-            pj_time_val delta;
-
-            if (PJ_TIME_VAL_LTE(e->_timer_value, now))
-                delta.sec = delta.msec = 0;
-            else {
-                delta = e->_timer_value;
-                PJ_TIME_VAL_SUB(delta, now);
+            PJ_UNUSED_ARG(i);
+            for (tmp_dup = ht->head_list.next; tmp_dup != &ht->head_list;
+                 tmp_dup = tmp_dup->next)
+            {
+                dump_entry(tmp_dup, &now);
             }
-
-            PJ_LOG(3,(THIS_FILE, "    %d\t%d\t%d.%03d\t%s:%d",
-                      GET_FIELD(e, _timer_id), GET_FIELD(e, id),
-                      (int)delta.sec, (int)delta.msec,
-                      e->src_file, e->src_line));
+#endif
         }
     }
 
@@ -0,0 +1,481 @@
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include <pj/trace.h>
+#include <pj/assert.h>
+#include <pj/errno.h>
+#include <pj/file_io.h>
+#include <pj/os.h>
+#include <pj/pool.h>
+#include <pj/string.h>
+#include <pj/compat/stdarg.h>
+
+#define MAX_EVENTS      0x1000000U
+#define FILE_BUF_SIZE   16384
+
+PJ_DEF_DATA(int) pj_trace_enabled;
+
+/* One recorded event */
+typedef struct trace_rec
+{
+    pj_uint64_t      ts;
+    const char      *cat;
+    const char      *name;
+    pj_int32_t       arg;
+    pj_uint8_t       type;
+} trace_rec;
+
+/* Event buffer of one thread. Only the owner thread writes the records
+ * and the head, which counts the events ever written to the buffer. The
+ * base is the head when tracing was last started, and is only used by the
+ * export, so starting again does not touch what the owner writes.
+ */
+typedef struct trace_buf
+{
+    unsigned         head;
+    unsigned         base;
+    unsigned         id;
+    char             name[PJ_MAX_OBJ_NAME];
+    trace_rec       *rec;
+} trace_buf;
+
+/* The buffers are allocated from a private pool factory and are only
+ * released by pj_shutdown(), since a thread which has passed the enabled
+ * check may still be writing to its buffer after tracing is stopped.
+ */
+static struct trace_state
+{
+    pj_caching_pool  cp;
+    pj_pool_factory *pf;
+    pj_pool_t       *pool;
+    long             tls_id;
+    unsigned         capacity;
+    unsigned         mask;
+    pj_timestamp     start;
+    unsigned         dropped;
+    unsigned         buf_cnt;
+    trace_buf       *buf[PJ_TRACE_MAX_THREADS];
+} tr;
+
+/* Assigned to the threads that could not get a buffer */
+static trace_buf full_buf;
+
+#if PJ_ATOMIC_USE_INTRINSICS
+#   define LOAD_HEAD(p)         __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#   define STORE_HEAD(p, v)     __atomic_store_n(p, v, __ATOMIC_RELEASE)
+#   define READ_FENCE()         __atomic_thread_fence(__ATOMIC_ACQUIRE)
+#   define INC_DROPPED()        __atomic_fetch_add(&tr.dropped, 1, \
+                                                   __ATOMIC_RELAXED)
+#else
+/* Without atomics the export is only reliable after pj_trace_stop() */
+#   define LOAD_HEAD(p)         (*(volatile unsigned*)(p))
+#   define STORE_HEAD(p, v)     (*(volatile unsigned*)(p) = (v))
+#   define READ_FENCE()
+#   define INC_DROPPED()        (++tr.dropped)
+#endif
+
+
+/* Called by pj_shutdown(), when no other thread is running any more */
+static void trace_cleanup(void)
+{
+    pj_trace_enabled = 0;
+
+    if (tr.pool) {
+        pj_thread_local_free(tr.tls_id);
+        pj_pool_release(tr.pool);
+        pj_caching_pool_destroy(&tr.cp);
+    }
+    pj_bzero(&tr, sizeof(tr));
+}
+
+PJ_DEF(pj_status_t) pj_trace_start(pj_pool_factory *pf,
+                                   unsigned max_events)
+{
+    unsigned i;
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(pf && max_events, PJ_EINVAL);
+    PJ_ASSERT_RETURN(max_events <= MAX_EVENTS, PJ_ETOOBIG);
+
+    if (tr.pool == NULL) {
+        unsigned cap;
+
+        for (cap = 1; cap < max_events; cap <<= 1)
+            ;
+
+        status = pj_thread_local_alloc(&tr.tls_id);
+        if (status != PJ_SUCCESS)
+            return status;
+
+        pj_caching_pool_init(&tr.cp, NULL, 0);
+        tr.pool = pj_pool_create(&tr.cp.factory, "trace", 1000, 1000, NULL);
+        if (tr.pool == NULL) {
+            pj_caching_pool_destroy(&tr.cp);
+            pj_thread_local_free(tr.tls_id);
+            return PJ_ENOMEM;
+        }
+
+        tr.capacity = cap;
+        tr.mask = cap - 1;
+        tr.buf_cnt = 0;
+        pj_atexit(&trace_cleanup);
+    }
+    tr.pf = pf;
+
+    /* Leave out the events of the previous run */
+    pj_enter_critical_section();
+    for (i=0; i<tr.buf_cnt; ++i)
+        tr.buf[i]->base = LOAD_HEAD(&tr.buf[i]->head);
+    pj_leave_critical_section();
+    tr.dropped = 0;
+
+    pj_get_timestamp(&tr.start);
+    pj_trace_enabled = 1;
+
+    return PJ_SUCCESS;
+}
+
+PJ_DEF(void) pj_trace_stop(void)
+{
+    pj_trace_enabled = 0;
+}
+
+PJ_DEF(void) pj_trace_shutdown(void)
+{
+    /* The buffers are kept until pj_shutdown(), see trace_state */
+    pj_trace_enabled = 0;
+}
+
+/* Create the buffer of the calling thread */
+static trace_buf *create_thread_buf(void)
+{
+    trace_buf *tb = NULL;
+    const char *name = NULL;
+    unsigned i;
+
+    pj_enter_critical_section();
+
+    if (tr.pool && tr.buf_cnt < PJ_TRACE_MAX_THREADS) {
+        tb = PJ_POOL_ZALLOC_T(tr.pool, trace_buf);
+        if (tb) {
+            tb->rec = (trace_rec*)
+                      pj_pool_calloc(tr.pool, tr.capacity, sizeof(trace_rec));
+        }
+        if (tb && tb->rec) {
+            tb->id = tr.buf_cnt + 1;
+            tr.buf[tr.buf_cnt++] = tb;
+        } else {
+            tb = NULL;
+        }
+    }
+
+    pj_leave_critical_section();
+
+    if (tb == NULL) {
+        pj_thread_local_set(tr.tls_id, &full_buf);
+        return NULL;
+    }
+
+    /* Keep the name safe to be written in the JSON string */
+    if (pj_thread_is_registered())
+        name = pj_thread_get_name(pj_thread_this());
+    if (name) {
+        for (i=0; name[i] && i<sizeof(tb->name)-1; ++i) {
+            char c = name[i];
+            tb->name[i] = (c=='"' || c=='\\' || (unsigned char)c < 0x20) ?
+                          '_' : c;
+        }
+        tb->name[i] = '\0';
+    } else {
+        pj_ansi_snprintf(tb->name, sizeof(tb->name), "thread%u", tb->id);
+    }
+
+    pj_thread_local_set(tr.tls_id, tb);
+    return tb;
+}
+
+PJ_DEF(void) pj_trace_event(pj_trace_event_type type,
+                            const char *cat,
+                            const char *name,
+                            int arg)
+{
+    trace_buf *tb;
+    trace_rec *r;
+    pj_timestamp ts;
+    unsigned head;
+
+    if (!pj_trace_enabled)
+        return;
+
+    tb = (trace_buf*) pj_thread_local_get(tr.tls_id);
+    if (tb == NULL) {
+        tb = create_thread_buf();
+    }
+    if (tb == NULL || tb == &full_buf) {
+        INC_DROPPED();
+        return;
+    }
+
+    pj_get_timestamp(&ts);
+
+    head = tb->head;
+    r = &tb->rec[head & tr.mask];
+    r->ts = ts.u64;
+    r->cat = cat;
+    r->name = name;
+    r->arg = arg;
+    r->type = (pj_uint8_t)type;
+
+    STORE_HEAD(&tb->head, head + 1);
+}
+
+PJ_DEF(unsigned) pj_trace_get_dropped(void)
+{
+    return tr.dropped;
+}
+
+
+/* Output of the exporter: a memory buffer, flushed to the file when
+ * exporting to a file.
+ */
+typedef struct trace_out
+{
+    char            *buf;
+    pj_size_t        size;
+    pj_size_t        len;
+    pj_oshandle_t    fd;
+    pj_status_t      status;
+} trace_out;
+
+static pj_bool_t out_flush(trace_out *out)
+{
+    pj_ssize_t n = (pj_ssize_t)out->len;
+
+    if (out->fd == NULL || out->len == 0)
+        return PJ_TRUE;
+
+    out->status = pj_file_write(out->fd, out->buf, &n);
+    if (out->status != PJ_SUCCESS)
+        return PJ_FALSE;
+
+    out->len = 0;
+    return PJ_TRUE;
+}
+
+static pj_bool_t out_append(trace_out *out, const char *fmt, ...)
+{
+    va_list arg;
+    int n;
+
+    va_start(arg, fmt);
+    n = pj_ansi_vsnprintf(out->buf + out->len, out->size - out->len,
+                          fmt, arg);
+    va_end(arg);
+
+    if (n >= 0 && (pj_size_t)n >= out->size - out->len && out->fd &&
+        out_flush(out))
+    {
+        va_start(arg, fmt);
+        n = pj_ansi_vsnprintf(out->buf, out->size, fmt, arg);
+        va_end(arg);
+    }
+
+    if (n < 0 || (pj_size_t)n >= out->size - out->len) {
+        if (out->status == PJ_SUCCESS)
+            out->status = PJ_ETOOSMALL;
+        return PJ_FALSE;
+    }
+
+    out->len += n;
+    return PJ_TRUE;
+}
+
+/* Copy the events of the buffer which are not overwritten by the owner
+ * thread while copying. Returns the number of events in rec.
+ */
+static unsigned snapshot(const trace_buf *tb, trace_rec *rec)
+{
+    unsigned head, head2, lo, idx, first, cnt, over;
+
+    head = LOAD_HEAD(&tb->head);
+    cnt = head - tb->base;
+    if (cnt > tr.capacity)
+        cnt = tr.capacity;
+    lo = head - cnt;
+
+    idx = lo & tr.mask;
+    first = tr.capacity - idx;
+    if (first > cnt)
+        first = cnt;
+    pj_memcpy(rec, &tb->rec[idx], first * sizeof(trace_rec));
+    if (cnt > first)
+        pj_memcpy(rec + first, tb->rec, (cnt - first) * sizeof(trace_rec));
+
+    /* While tracing is running, the record of event head2 may be half
+     * written already, and those before it up to one capacity back are
+     * intact.
+     */
+    READ_FENCE();
+    head2 = LOAD_HEAD(&tb->head);
+    if (pj_trace_enabled)
+        ++head2;
+    if (head2 - lo > tr.capacity) {
+        over = head2 - lo - tr.capacity;
+        if (over >= cnt)
+            return 0;
+        cnt -= over;
+        pj_memmove(rec, rec + over, cnt * sizeof(trace_rec));
+    }
+    return cnt;
+}
+
+/* Convert timestamp to nanoseconds since the start of tracing */
+static pj_uint64_t ts_to_nsec(pj_uint64_t ts, pj_uint64_t freq)
+{
+    pj_uint64_t diff;
+
+    if (ts <= tr.start.u64 || freq == 0)
+        return 0;
+
+    diff = ts - tr.start.u64;
+    return (diff / freq) * 1000000000 + (diff % freq) * 1000000000 / freq;
+}
+
+static pj_status_t export_events(trace_out *out)
+{
+    static const char *ph[] = { "B", "E", "i" };
+    trace_buf *buf[PJ_TRACE_MAX_THREADS];
+    unsigned buf_cnt, i, j, cnt;
+    pj_timestamp freq;
+    pj_pool_t *pool;
+    trace_rec *rec;
+    pj_bool_t ok;
+
+    PJ_ASSERT_RETURN(tr.pool, PJ_EINVALIDOP);
+
+    pj_enter_critical_section();
+    buf_cnt = tr.buf_cnt;
+    pj_memcpy(buf, tr.buf, buf_cnt * sizeof(trace_buf*));
+    pj_leave_critical_section();
+
+    pool = pj_pool_create(tr.pf, "trace_exp", 1000, 1000, NULL);
+    if (!pool)
+        return PJ_ENOMEM;
+    rec = (trace_rec*) pj_pool_alloc(pool, tr.capacity * sizeof(trace_rec));
+    if (!rec) {
+        pj_pool_release(pool);
+        return PJ_ENOMEM;
+    }
+
+    pj_get_timestamp_freq(&freq);
+
+    ok = out_append(out, "{\"traceEvents\":[");
+
+    for (i=0; ok && i<buf_cnt; ++i) {
+        ok = out_append(out,
+                        "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+                        "\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+                        (i ? "," : ""), buf[i]->id, buf[i]->name);
+    }
+
+    for (i=0; ok && i<buf_cnt; ++i) {
+        cnt = snapshot(buf[i], rec);
+
+        for (j=0; ok && j<cnt; ++j) {
+            const trace_rec *r = &rec[j];
+            pj_uint64_t nsec = ts_to_nsec(r->ts, freq.u64);
+
+            /* Skip the events written by a thread which was still
+             * recording when tracing was stopped and started again.
+             */
+            if (r->type > PJ_TRACE_EV_INSTANT || r->ts < tr.start.u64)
+                continue;
+
+            ok = out_append(out,
+                            ",{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"%s\","
+                            "\"ts\":%" PJ_INT64_FMT "u.%03u,"
+                            "\"pid\":1,\"tid\":%u",
+                            r->name, r->cat, ph[r->type],
+                            nsec / 1000, (unsigned)(nsec % 1000),
+                            buf[i]->id);
+            if (ok && r->type == PJ_TRACE_EV_INSTANT) {
+                ok = out_append(out, ",\"s\":\"t\",\"args\":{\"v\":%d}",
+                                r->arg);
+            }
+            if (ok)
+                ok = out_append(out, "}");
+        }
+    }
+
+    if (ok)
+        ok = out_append(out, "],\"displayTimeUnit\":\"ms\"}");
+
+    pj_pool_release(pool);
+
+    return ok ? PJ_SUCCESS : out->status;
+}
+
+PJ_DEF(pj_ssize_t) pj_trace_export(char *buf, pj_size_t size)
+{
+    trace_out out;
+
+    PJ_ASSERT_RETURN(buf && size, -1);
+
+    pj_bzero(&out, sizeof(out));
+    out.buf = buf;
+    out.size = size;
+
+    if (export_events(&out) != PJ_SUCCESS)
+        return -1;
+
+    return (pj_ssize_t)out.len;
+}
+
+PJ_DEF(pj_status_t) pj_trace_export_file(const char *path)
+{
+    trace_out out;
+    pj_pool_t *pool;
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(path, PJ_EINVAL);
+    PJ_ASSERT_RETURN(tr.pool, PJ_EINVALIDOP);
+
+    pool = pj_pool_create(tr.pf, "trace_file", FILE_BUF_SIZE + 1000, 1000,
+                          NULL);
+    if (!pool)
+        return PJ_ENOMEM;
+
+    pj_bzero(&out, sizeof(out));
+    out.size = FILE_BUF_SIZE;
+    out.buf = (char*) pj_pool_alloc(pool, out.size);
+
+    status = pj_file_open(pool, path, PJ_O_WRONLY, &out.fd);
+    if (status != PJ_SUCCESS) {
+        pj_pool_release(pool);
+        return status;
+    }
+
+    status = export_events(&out);
+    if (status == PJ_SUCCESS && !out_flush(&out))
+        status = out.status;
+
+    pj_file_close(out.fd);
+    pj_pool_release(pool);
+
+    return status;
+}
@@ -0,0 +1,226 @@
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include <pj/work_queue.h>
+#include <pj/assert.h>
+#include <pj/errno.h>
+#include <pj/os.h>
+#include <pj/pool.h>
+
+PJ_DEF(void) pj_work_job_init(pj_work_job *job, pj_work_job_cb *cb,
+                              void *user_data)
+{
+    pj_list_init(job);
+    job->cb = cb;
+    job->user_data = user_data;
+    job->queued = PJ_FALSE;
+}
+
+#if PJ_HAS_THREADS
+
+struct pj_work_queue
+{
+    pj_mutex_t          *mutex;
+    pj_sem_t            *sem;
+    pj_thread_t        **thread;
+    unsigned             thread_cnt;
+    pj_bool_t            quit;
+    pj_work_job          pending;
+};
+
+static int worker_thread(void *arg)
+{
+    pj_work_queue *wq = (pj_work_queue*)arg;
+
+    for (;;) {
+        pj_work_job *job;
+
+        pj_sem_wait(wq->sem);
+
+        pj_mutex_lock(wq->mutex);
+        if (wq->quit) {
+            pj_mutex_unlock(wq->mutex);
+            break;
+        }
+        /* The job may have been cancelled after it was posted */
+        if (pj_list_empty(&wq->pending)) {
+            pj_mutex_unlock(wq->mutex);
+            continue;
+        }
+        job = wq->pending.next;
+        pj_list_erase(job);
+        job->queued = PJ_FALSE;
+        pj_mutex_unlock(wq->mutex);
+
+        (*job->cb)(job, PJ_SUCCESS);
+    }
+
+    return 0;
+}
+
+PJ_DEF(pj_status_t) pj_work_queue_create(pj_pool_t *pool,
+                                         const char *name,
+                                         unsigned thread_cnt,
+                                         pj_work_queue **p_wq)
+{
+    pj_work_queue *wq;
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(pool && thread_cnt && p_wq, PJ_EINVAL);
+
+    wq = PJ_POOL_ZALLOC_T(pool, pj_work_queue);
+    pj_list_init(&wq->pending);
+    wq->thread = (pj_thread_t**)
+                 pj_pool_calloc(pool, thread_cnt, sizeof(pj_thread_t*));
+
+    status = pj_mutex_create_simple(pool, name, &wq->mutex);
+    if (status != PJ_SUCCESS)
+        goto on_error;
+
+    status = pj_sem_create(pool, name, 0, 0x7FFFFFFF, &wq->sem);
+    if (status != PJ_SUCCESS)
+        goto on_error;
+
+    for (; wq->thread_cnt < thread_cnt; ++wq->thread_cnt) {
+        status = pj_thread_create(pool, name, &worker_thread, wq, 0, 0,
+                                  &wq->thread[wq->thread_cnt]);
+        if (status != PJ_SUCCESS)
+            goto on_error;
+    }
+
+    *p_wq = wq;
+    return PJ_SUCCESS;
+
+on_error:
+    pj_work_queue_destroy(wq);
+    return status;
+}
+
+PJ_DEF(pj_status_t) pj_work_queue_post(pj_work_queue *wq, pj_work_job *job)
+{
+    PJ_ASSERT_RETURN(wq && job && job->cb, PJ_EINVAL);
+
+    pj_mutex_lock(wq->mutex);
+    if (wq->quit) {
+        pj_mutex_unlock(wq->mutex);
+        return PJ_EINVALIDOP;
+    }
+    if (job->queued) {
+        pj_mutex_unlock(wq->mutex);
+        return PJ_EBUSY;
+    }
+    job->queued = PJ_TRUE;
+    pj_list_push_back(&wq->pending, job);
+    pj_mutex_unlock(wq->mutex);
+
+    pj_sem_post(wq->sem);
+    return PJ_SUCCESS;
+}
+
+PJ_DEF(pj_status_t) pj_work_queue_cancel(pj_work_queue *wq,
+                                         pj_work_job *job)
+{
+    pj_status_t status = PJ_ENOTFOUND;
+
+    PJ_ASSERT_RETURN(wq && job, PJ_EINVAL);
+
+    pj_mutex_lock(wq->mutex);
+    if (job->queued) {
+        pj_list_erase(job);
+        job->queued = PJ_FALSE;
+        status = PJ_SUCCESS;
+    }
+    pj_mutex_unlock(wq->mutex);
+
+    return status;
+}
+
+PJ_DEF(void) pj_work_queue_destroy(pj_work_queue *wq)
+{
+    unsigned i;
+
+    PJ_ASSERT_ON_FAIL(wq, return);
+
+    if (wq->sem) {
+        pj_mutex_lock(wq->mutex);
+        wq->quit = PJ_TRUE;
+        pj_mutex_unlock(wq->mutex);
+
+        for (i=0; i<wq->thread_cnt; ++i)
+            pj_sem_post(wq->sem);
+
+        for (i=0; i<wq->thread_cnt; ++i) {
+            pj_thread_join(wq->thread[i]);
+            pj_thread_destroy(wq->thread[i]);
+        }
+        wq->thread_cnt = 0;
+
+        /* No worker is left, so the queue can be used without the mutex */
+        while (!pj_list_empty(&wq->pending)) {
+            pj_work_job *job = wq->pending.next;
+
+            pj_list_erase(job);
+            job->queued = PJ_FALSE;
+            (*job->cb)(job, PJ_ECANCELLED);
+        }
+
+        pj_sem_destroy(wq->sem);
+        wq->sem = NULL;
+    }
+
+    if (wq->mutex) {
+        pj_mutex_destroy(wq->mutex);
+        wq->mutex = NULL;
+    }
+}
+
+#else   /* PJ_HAS_THREADS */
+
+PJ_DEF(pj_status_t) pj_work_queue_create(pj_pool_t *pool,
+                                         const char *name,
+                                         unsigned thread_cnt,
+                                         pj_work_queue **p_wq)
+{
+    PJ_UNUSED_ARG(pool);
+    PJ_UNUSED_ARG(name);
+    PJ_UNUSED_ARG(thread_cnt);
+    PJ_UNUSED_ARG(p_wq);
+    return PJ_ENOTSUP;
+}
+
+PJ_DEF(pj_status_t) pj_work_queue_post(pj_work_queue *wq, pj_work_job *job)
+{
+    PJ_UNUSED_ARG(wq);
+    PJ_UNUSED_ARG(job);
+    return PJ_EINVALIDOP;
+}
+
+PJ_DEF(pj_status_t) pj_work_queue_cancel(pj_work_queue *wq,
+                                         pj_work_job *job)
+{
+    PJ_UNUSED_ARG(wq);
+    PJ_UNUSED_ARG(job);
+    return PJ_ENOTFOUND;
+}
+
+PJ_DEF(void) pj_work_queue_destroy(pj_work_queue *wq)
+{
+    PJ_UNUSED_ARG(wq);
+}
+
+#endif  /* PJ_HAS_THREADS */
@@ -491,6 +491,169 @@ on_return:
 
 
 
+/*******************************************************************
+ * UDP batch receive test: send a burst of packets and make sure all of
+ * them are delivered, in order, by on_data_recvfrom_batch().
+ */
+#define BATCH_CNT       8
+#define BATCH_PKT_CNT   64
+
+struct udp_batch_srv
+{
+    unsigned             rx_cnt;
+    unsigned             cb_cnt;
+    unsigned             max_batch;
+    pj_bool_t            bad;
+};
+
+static pj_bool_t udp_batch_on_data_recvfrom(pj_activesock_t *asock,
+                                            void *data,
+                                            pj_size_t size,
+                                            const pj_sockaddr_t *src_addr,
+                                            int addr_len,
+                                            pj_status_t status)
+{
+    PJ_UNUSED_ARG(asock);
+    PJ_UNUSED_ARG(data);
+    PJ_UNUSED_ARG(size);
+    PJ_UNUSED_ARG(src_addr);
+    PJ_UNUSED_ARG(addr_len);
+    udp_echo_err("batch recvfrom() callback", status);
+    return PJ_TRUE;
+}
+
+static pj_bool_t udp_batch_on_data_recvfrom_batch(pj_activesock_t *asock,
+                                                  const pj_sock_mmsg pkts[],
+                                                  unsigned count)
+{
+    struct udp_batch_srv *srv;
+    unsigned i;
+
+    srv = (struct udp_batch_srv*) pj_activesock_get_user_data(asock);
+    srv->cb_cnt++;
+    if (count > srv->max_batch)
+        srv->max_batch = count;
+
+    for (i=0; i<count; ++i) {
+        pj_uint32_t seq;
+
+        if (pkts[i].len != sizeof(seq) || pkts[i].addr_len <= 0) {
+            srv->bad = PJ_TRUE;
+            continue;
+        }
+        pj_memcpy(&seq, pkts[i].buf, sizeof(seq));
+        if (seq != srv->rx_cnt)
+            srv->bad = PJ_TRUE;
+        srv->rx_cnt++;
+    }
+
+    return PJ_TRUE;
+}
+
+static int udp_batch_test(void)
+{
+    pj_ioqueue_t *ioqueue = NULL;
+    pj_pool_t *pool = NULL;
+    pj_activesock_t *asock = NULL;
+    pj_sock_t sock = PJ_INVALID_SOCKET;
+    struct udp_batch_srv srv;
+    pj_activesock_cb cb;
+    pj_sockaddr addr;
+    pj_str_t loopback;
+    pj_uint32_t seq;
+    pj_time_val timeout;
+    unsigned i;
+    int ret = 0;
+    pj_status_t status;
+
+    pj_bzero(&srv, sizeof(srv));
+
+    pool = pj_pool_create(mem, "batch", 512, 512, NULL);
+    if (!pool)
+        return -200;
+
+    status = pj_ioqueue_create(pool, 4, &ioqueue);
+    if (status != PJ_SUCCESS) {
+        ret = -210;
+        goto on_return;
+    }
+
+    pj_bzero(&cb, sizeof(cb));
+    cb.on_data_recvfrom = &udp_batch_on_data_recvfrom;
+    cb.on_data_recvfrom_batch = &udp_batch_on_data_recvfrom_batch;
+
+    pj_sockaddr_in_init(&addr.ipv4, NULL, 0);
+    status = pj_activesock_create_udp(pool, &addr, NULL, ioqueue, &cb,
+                                      &srv, &asock, &addr);
+    if (status != PJ_SUCCESS) {
+        ret = -220;
+        goto on_return;
+    }
+
+    status = pj_activesock_start_recvfrom_batch(asock, pool, 32,
+                                                BATCH_CNT, 0);
+    if (status != PJ_SUCCESS) {
+        ret = -230;
+        goto on_return;
+    }
+
+    status = pj_sock_socket(pj_AF_INET(), pj_SOCK_DGRAM(), 0, &sock);
+    if (status != PJ_SUCCESS) {
+        ret = -240;
+        goto on_return;
+    }
+
+    loopback = pj_str("127.0.0.1");
+    pj_sockaddr_in_set_str_addr(&addr.ipv4, &loopback);
+
+    /* Queue the whole burst in the socket before polling */
+    for (seq=0; seq<BATCH_PKT_CNT; ++seq) {
+        pj_ssize_t sent = sizeof(seq);
+
+        status = pj_sock_sendto(sock, &seq, &sent, 0, &addr,
+                                pj_sockaddr_get_len(&addr));
+        if (status != PJ_SUCCESS) {
+            ret = -250;
+            goto on_return;
+        }
+    }
+
+    for (i=0; i<100 && srv.rx_cnt<BATCH_PKT_CNT; ++i) {
+        timeout.sec = 0; timeout.msec = 10;
+        pj_ioqueue_poll(ioqueue, &timeout);
+    }
+
+    PJ_LOG(3,("", "...%d packets in %d callbacks (max %d per callback)",
+              srv.rx_cnt, srv.cb_cnt, srv.max_batch));
+
+    if (srv.rx_cnt != BATCH_PKT_CNT || srv.bad) {
+        ret = -260;
+        goto on_return;
+    }
+    if (srv.max_batch > BATCH_CNT) {
+        ret = -270;
+        goto on_return;
+    }
+#if PJ_SOCK_HAS_MMSG
+    if (srv.max_batch < 2) {
+        ret = -280;
+        goto on_return;
+    }
+#endif
+
+on_return:
+    if (sock != PJ_INVALID_SOCKET)
+        pj_sock_close(sock);
+    if (asock)
+        pj_activesock_close(asock);
+    if (ioqueue)
+        pj_ioqueue_destroy(ioqueue);
+    if (pool)
+        pj_pool_release(pool);
+    return ret;
+}
+
+
 int activesock_test(void)
 {
     int ret;
@@ -500,6 +663,11 @@ int activesock_test(void)
     if (ret != 0)
         return ret;
 
+    PJ_LOG(3,("", "..udp batch receive test"));
+    ret = udp_batch_test();
+    if (ret != 0)
+        return ret;
+
     PJ_LOG(3,("", "..tcp perf test"));
     ret = tcp_perf_test();
     if (ret != 0)
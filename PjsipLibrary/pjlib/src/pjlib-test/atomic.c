@@ -35,6 +35,10 @@
  *  - pj_atomic_set()
  *  - pj_atomic_destroy()
  *
+ * When threads are available, the test also checks that concurrent
+ * increments are not lost and benchmarks pj_atomic_inc() against a
+ * mutex protected counter with 1, 4 and 16 threads.
+ *
  *
  * This file is <b>pjlib-test/atomic.c</b>
  *
@@ -44,6 +48,140 @@
 
 #if INCLUDE_ATOMIC_TEST
 
+#define THIS_FILE       "atomic.c"
+
+#if PJ_HAS_THREADS
+
+#define ATOMIC_PERF_OPS     2000000
+#define ATOMIC_MAX_THREADS  16
+
+struct atomic_perf_arg
+{
+    pj_atomic_t     *atomic_var;
+    pj_mutex_t      *mutex;
+    long            *counter;
+    unsigned         ops;
+};
+
+static int atomic_perf_thread(void *p)
+{
+    struct atomic_perf_arg *arg = (struct atomic_perf_arg*)p;
+    unsigned i;
+
+    if (arg->atomic_var) {
+        for (i = 0; i < arg->ops; ++i)
+            pj_atomic_inc(arg->atomic_var);
+    } else {
+        for (i = 0; i < arg->ops; ++i) {
+            pj_mutex_lock(arg->mutex);
+            ++(*arg->counter);
+            pj_mutex_unlock(arg->mutex);
+        }
+    }
+    return 0;
+}
+
+/* Run ATOMIC_PERF_OPS increments split over thread_cnt threads, either
+ * on an atomic variable or on a mutex protected counter.
+ */
+static int atomic_perf_run(pj_pool_t *pool, unsigned thread_cnt,
+                           pj_bool_t use_atomic)
+{
+    pj_thread_t *thread[ATOMIC_MAX_THREADS];
+    struct atomic_perf_arg arg;
+    pj_timestamp t1, t2;
+    pj_uint32_t msec;
+    long counter = 0;
+    long total;
+    unsigned i;
+    pj_status_t rc;
+
+    pj_bzero(&arg, sizeof(arg));
+    arg.ops = ATOMIC_PERF_OPS / thread_cnt;
+    total = (long)(arg.ops * thread_cnt);
+
+    if (use_atomic) {
+        rc = pj_atomic_create(pool, 0, &arg.atomic_var);
+    } else {
+        rc = pj_mutex_create_simple(pool, "atmperf", &arg.mutex);
+        arg.counter = &counter;
+    }
+    if (rc != PJ_SUCCESS)
+        return -200;
+
+    pj_get_timestamp(&t1);
+
+    for (i = 0; i < thread_cnt; ++i) {
+        rc = pj_thread_create(pool, "atmperf", &atomic_perf_thread, &arg,
+                              0, 0, &thread[i]);
+        if (rc != PJ_SUCCESS) {
+            app_perror("...error: unable to create thread", rc);
+            return -210;
+        }
+    }
+
+    for (i = 0; i < thread_cnt; ++i) {
+        pj_thread_join(thread[i]);
+        pj_thread_destroy(thread[i]);
+    }
+
+    pj_get_timestamp(&t2);
+    msec = pj_elapsed_msec(&t1, &t2);
+    if (msec == 0)
+        msec = 1;
+
+    if (use_atomic) {
+        counter = pj_atomic_get(arg.atomic_var);
+        pj_atomic_destroy(arg.atomic_var);
+    } else {
+        pj_mutex_destroy(arg.mutex);
+    }
+
+    if (counter != total) {
+        PJ_LOG(3,(THIS_FILE, "...error: counter is %ld, expecting %ld",
+                  counter, total));
+        return -220;
+    }
+
+    PJ_LOG(3,(THIS_FILE, "....%-6s %2u thread(s): %9lu ops/sec",
+              (use_atomic ? "atomic" : "mutex"), thread_cnt,
+              (unsigned long)((pj_uint64_t)total * 1000 / msec)));
+    return 0;
+}
+
+static int atomic_perf_test(void)
+{
+    static const unsigned thread_cnt[] = { 1, 4, ATOMIC_MAX_THREADS };
+    pj_pool_t *pool;
+    unsigned i;
+    int rc = 0;
+
+    pool = pj_pool_create(mem, "atmperf", 4000, 4000, NULL);
+    if (!pool)
+        return -100;
+
+    PJ_LOG(3,(THIS_FILE, "...benchmarking %d increments (%s)",
+              ATOMIC_PERF_OPS,
+              (PJ_ATOMIC_USE_INTRINSICS ? "lock-free" : "mutex based")));
+
+    for (i = 0; i < PJ_ARRAY_SIZE(thread_cnt); ++i) {
+        rc = atomic_perf_run(pool, thread_cnt[i], PJ_TRUE);
+        if (rc != 0)
+            break;
+
+#if WITH_BENCHMARK
+        rc = atomic_perf_run(pool, thread_cnt[i], PJ_FALSE);
+        if (rc != 0)
+            break;
+#endif
+    }
+
+    pj_pool_release(pool);
+    return rc;
+}
+
+#endif  /* PJ_HAS_THREADS */
+
 int atomic_test(void)
 {
     pj_pool_t *pool;
@@ -95,6 +233,12 @@ int atomic_test(void)
 
     pj_pool_release(pool);
 
+#if PJ_HAS_THREADS
+    rc = atomic_perf_test();
+    if (rc != 0)
+        return rc;
+#endif
+
     return 0;
 }
 
@@ -20,20 +20,27 @@
 #include <pj/rand.h>
 #include <pj/log.h>
 #include <pj/pool.h>
+#include <pj/string.h>
+#include <pj/ctype.h>
+#include <pj/os.h>
 #include "test.h"
 
 #if INCLUDE_HASH_TEST
 
+#define THIS_FILE   "hash_test.c"
 #define HASH_COUNT  31
 
-static int hash_test_with_key(pj_pool_t *pool, unsigned char key)
+typedef pj_hash_table_t* (*hash_create_func)(pj_pool_t *pool, unsigned size);
+
+static int hash_test_with_key(pj_pool_t *pool, hash_create_func create,
+                              unsigned char key)
 {
     pj_hash_table_t *ht;
     unsigned value = 0x12345;
     pj_hash_iterator_t it_buf, *it;
     unsigned *entry;
 
-    ht = pj_hash_create(pool, HASH_COUNT);
+    ht = (*create)(pool, HASH_COUNT);
     if (!ht)
         return -10;
 
@@ -82,7 +89,7 @@ static int hash_test_with_key(pj_pool_t *pool, unsigned char key)
 }
 
 
-static int hash_collision_test(pj_pool_t *pool)
+static int hash_collision_test(pj_pool_t *pool, hash_create_func create)
 {
     enum {
         COUNT = HASH_COUNT * 4
@@ -92,7 +99,7 @@ static int hash_collision_test(pj_pool_t *pool)
     unsigned char *values;
     unsigned i;
 
-    ht = pj_hash_create(pool, HASH_COUNT);
+    ht = (*create)(pool, HASH_COUNT);
     if (!ht)
         return -200;
 
@@ -129,33 +136,370 @@ static int hash_collision_test(pj_pool_t *pool)
 }
 
 
+/* Grow, delete and reinsert entries of an open addressing table, with
+ * case insensitive keys.
+ */
+static int hash_oa_test(pj_pool_t *pool)
+{
+    enum {
+        COUNT = 1000
+    };
+    pj_hash_table_t *ht;
+    pj_hash_iterator_t it_buf, *it;
+    char (*keys)[16];
+    unsigned *values;
+    unsigned i, round;
+
+    ht = pj_hash_create_oa(pool, 8);
+    if (!ht)
+        return -300;
+
+    keys = (char(*)[16]) pj_pool_alloc(pool, COUNT * sizeof(keys[0]));
+    values = (unsigned*) pj_pool_alloc(pool, COUNT * sizeof(unsigned));
+
+    for (i=0; i<COUNT; ++i) {
+        pj_ansi_snprintf(keys[i], sizeof(keys[i]), "Key-%u", i);
+        values[i] = i;
+    }
+
+    /* Delete and reinsert to leave deleted slots behind */
+    for (round=0; round<3; ++round) {
+        for (i=0; i<COUNT; ++i) {
+            pj_hash_set_lower(NULL, ht, keys[i], PJ_HASH_KEY_STRING, 0,
+                              &values[i]);
+        }
+
+        if (pj_hash_count(ht) != COUNT)
+            return -310;
+
+        for (i=0; i<COUNT; ++i) {
+            char upper[16];
+            pj_str_t s;
+            pj_uint32_t hval;
+            unsigned *entry;
+
+            pj_ansi_strxcpy(upper, keys[i], sizeof(upper));
+            upper[0] = 'k'; upper[1] = 'E'; upper[2] = 'Y';
+            s = pj_str(upper);
+            hval = pj_hash_calc_tolower(0, NULL, &s);
+
+            entry = (unsigned*) pj_hash_get_lower(ht, upper,
+                                                  (unsigned)s.slen, &hval);
+            if (!entry || *entry != i)
+                return -320;
+
+            if (pj_hash_get(ht, upper, (unsigned)s.slen, NULL) != NULL)
+                return -330;
+        }
+
+        for (i=(round & 1); i<COUNT; i+=2) {
+            pj_hash_set_lower(NULL, ht, keys[i], PJ_HASH_KEY_STRING, 0,
+                              NULL);
+        }
+
+        if (pj_hash_count(ht) != COUNT/2)
+            return -340;
+
+        for (i=0; i<COUNT; ++i) {
+            void *entry = pj_hash_get_lower(ht, keys[i], PJ_HASH_KEY_STRING,
+                                            NULL);
+            if ((entry != NULL) != ((i & 1) != (round & 1)))
+                return -350;
+        }
+    }
+
+    /* Remove everything while iterating */
+    i = 0;
+    it = pj_hash_first(ht, &it_buf);
+    while (it) {
+        unsigned *entry = (unsigned*) pj_hash_this(ht, it);
+        pj_hash_set_lower(NULL, ht, keys[*entry], PJ_HASH_KEY_STRING, 0,
+                          NULL);
+        it = pj_hash_next(ht, it);
+        ++i;
+    }
+
+    if (i != COUNT/2 || pj_hash_count(ht) != 0)
+        return -360;
+
+    return 0;
+}
+
+
+/* Insert and erase entries for a long time with a small number of live
+ * entries, which leaves many deleted slots behind. The memory used by the
+ * table must not grow.
+ */
+static int hash_oa_churn_test(unsigned live)
+{
+    enum {
+        KEYS = 1000,
+        OPS = 200000
+    };
+    pj_pool_t *pool;
+    pj_hash_table_t *ht;
+    char (*keys)[16];
+    pj_size_t used = 0;
+    unsigned i;
+    int rc = 0;
+
+    PJ_LOG(3, ("", "...churn test with %u entries", live));
+
+    pool = pj_pool_create(mem, "hashchurn", 4000, 4000, NULL);
+    if (!pool)
+        return -400;
+
+    keys = (char(*)[16]) pj_pool_alloc(pool, KEYS * sizeof(keys[0]));
+    for (i=0; i<KEYS; ++i)
+        pj_ansi_snprintf(keys[i], sizeof(keys[i]), "churn-%u", i);
+
+    ht = pj_hash_create_oa(pool, 8);
+    if (!ht) {
+        pj_pool_release(pool);
+        return -410;
+    }
+
+    for (i=0; i<OPS; ++i) {
+        /* Keep "live" entries: add key i and remove key i-live */
+        pj_hash_set(NULL, ht, keys[i % KEYS], PJ_HASH_KEY_STRING, 0,
+                    keys[i % KEYS]);
+        if (i >= live) {
+            pj_hash_set(NULL, ht, keys[(i - live) % KEYS],
+                        PJ_HASH_KEY_STRING, 0, NULL);
+        }
+
+        if (pj_hash_count(ht) != (i >= live ? live : i+1)) {
+            rc = -420;
+            break;
+        }
+
+        /* Allow the table to reach its size first */
+        if (i == OPS / 10)
+            used = pj_pool_get_used_size(pool);
+    }
+
+    if (rc == 0 && pj_pool_get_used_size(pool) != used) {
+        PJ_LOG(3, ("", "...error: pool grew from %lu to %lu bytes",
+                   (unsigned long)used,
+                   (unsigned long)pj_pool_get_used_size(pool)));
+        rc = -430;
+    }
+
+    for (i=OPS-live; rc == 0 && i<OPS; ++i) {
+        if (pj_hash_get(ht, keys[i % KEYS], PJ_HASH_KEY_STRING,
+                        NULL) != keys[i % KEYS])
+        {
+            rc = -440;
+        }
+    }
+
+    pj_pool_release(pool);
+    return rc;
+}
+
+
+/* Fill buffer with random mixed case key characters */
+static void fill_key(char *buf, unsigned len)
+{
+    static const char chars[] = "abcdefghijklmnopqrstuvwxyz"
+                                "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+                                "0123456789.-_@$[]`{}~\x80\xC0\xDA\xFF";
+    unsigned i;
+
+    for (i=0; i<len; ++i)
+        buf[i] = chars[pj_rand() % (sizeof(chars)-1)];
+}
+
+/* Check that the lower case hash agrees with the hash of the lower case
+ * key, for all key lengths and alignments.
+ */
+static int hash_calc_test(void)
+{
+    char key[80], lower[80], result[80];
+    unsigned len, off, i;
+
+    for (len=0; len<=64; ++len) {
+        for (off=0; off<8; ++off) {
+            pj_str_t s;
+            pj_uint32_t h1, h2;
+
+            fill_key(key+off, len);
+            for (i=0; i<len; ++i) {
+                char c = key[off+i];
+                lower[i] = (c >= 'A' && c <= 'Z') ? (char)pj_tolower(c) : c;
+            }
+            pj_memset(result, 0x55, sizeof(result));
+
+            s.ptr = key+off;
+            s.slen = len;
+            h1 = pj_hash_calc_tolower(0, result+off, &s);
+            h2 = pj_hash_calc(0, lower, len);
+            if (h1 != h2) {
+                PJ_LOG(3,(THIS_FILE, "...error: lower case hash mismatch, "
+                          "len=%u", len));
+                return -400;
+            }
+            if (pj_memcmp(result+off, lower, len) != 0 ||
+                result[off+len] != 0x55)
+            {
+                PJ_LOG(3,(THIS_FILE, "...error: wrong lower case result, "
+                          "len=%u", len));
+                return -410;
+            }
+            if (pj_hash_calc_tolower(0, NULL, &s) != h1) {
+                PJ_LOG(3,(THIS_FILE, "...error: hash depends on result"));
+                return -420;
+            }
+
+            /* Same key at a different alignment */
+            pj_memcpy(result, key+off, len);
+            if (pj_hash_calc(0, result, len) != pj_hash_calc(0, key+off, len))
+            {
+                PJ_LOG(3,(THIS_FILE, "...error: hash depends on alignment"));
+                return -430;
+            }
+        }
+    }
+
+    /* Null terminated key */
+    fill_key(key, 40);
+    key[40] = '\0';
+    if (pj_hash_calc(0, key, PJ_HASH_KEY_STRING) != pj_hash_calc(0, key, 40))
+        return -440;
+
+    return 0;
+}
+
+/* Reference: classic byte at a time hash */
+static pj_uint32_t hash_mult33(pj_uint32_t hval, const char *key,
+                               unsigned len)
+{
+    const pj_uint8_t *p = (const pj_uint8_t*)key, *end = p + len;
+
+    for ( ; p!=end; ++p)
+        hval = hval * 33 + *p;
+    return hval;
+}
+
+/* Benchmark hashing of keys of typical SIP lengths: tags (8-16),
+ * Call-ID (36), transaction key (50-70, branch + method + role) and
+ * long Call-ID with host part.
+ */
+static int hash_perf_test(void)
+{
+    enum { LOOP = 100000, KEYS = 16 };
+    static const unsigned lens[] = { 8, 16, 36, 64, 128 };
+    char (*keys)[128];
+    volatile pj_uint32_t sink = 0;
+    pj_pool_t *pool;
+    unsigned i, j, k;
+
+    pool = pj_pool_create(mem, NULL, 4000, 4000, NULL);
+    if (!pool)
+        return -500;
+    keys = (char(*)[128]) pj_pool_alloc(pool, KEYS * sizeof(keys[0]));
+
+    PJ_LOG(3,(THIS_FILE, "...benchmarking hash functions (ns/key):"));
+    PJ_LOG(3,(THIS_FILE, "....keylen  hash*33  pj_hash_calc  "
+                         "pj_hash_calc_tolower"));
+
+    for (i=0; i<PJ_ARRAY_SIZE(lens); ++i) {
+        pj_timestamp t0, t1, t2, t3;
+        pj_uint32_t h = 0;
+        unsigned cnt = LOOP * KEYS;
+
+        for (k=0; k<KEYS; ++k)
+            fill_key(keys[k], lens[i]);
+
+        pj_get_timestamp(&t0);
+        for (j=0; j<LOOP; ++j) {
+            for (k=0; k<KEYS; ++k)
+                h += hash_mult33(0, keys[k], lens[i]);
+        }
+        pj_get_timestamp(&t1);
+        for (j=0; j<LOOP; ++j) {
+            for (k=0; k<KEYS; ++k)
+                h += pj_hash_calc(0, keys[k], lens[i]);
+        }
+        pj_get_timestamp(&t2);
+        for (j=0; j<LOOP; ++j) {
+            for (k=0; k<KEYS; ++k) {
+                pj_str_t s;
+                s.ptr = keys[k];
+                s.slen = lens[i];
+                h += pj_hash_calc_tolower(0, NULL, &s);
+            }
+        }
+        pj_get_timestamp(&t3);
+        sink += h;
+
+        PJ_LOG(3,(THIS_FILE, "....%6u  %7u  %12u  %20u", lens[i],
+                  (unsigned)(pj_elapsed_nanosec(&t0, &t1) / cnt),
+                  (unsigned)(pj_elapsed_nanosec(&t1, &t2) / cnt),
+                  (unsigned)(pj_elapsed_nanosec(&t2, &t3) / cnt)));
+    }
+
+    PJ_UNUSED_ARG(sink);
+    pj_pool_release(pool);
+    return 0;
+}
+
 /*
  * Hash table test.
  */
 int hash_test(void)
 {
+    static const hash_create_func create[] =
+    {
+        &pj_hash_create,
+        &pj_hash_create_oa
+    };
+    static const unsigned churn_live[] = { 13, 27, 55 };
     pj_pool_t *pool = pj_pool_create(mem, "hash", 512, 512, NULL);
     int rc;
-    unsigned i;
+    unsigned i, j;
+
+    for (j=0; j<PJ_ARRAY_SIZE(create); ++j) {
+        /* Test to fill in each row in the table */
+        for (i=0; i<=HASH_COUNT; ++i) {
+            rc = hash_test_with_key(pool, create[j], (unsigned char)i);
+            if (rc != 0) {
+                pj_pool_release(pool);
+                return rc;
+            }
+        }
 
-    /* Test to fill in each row in the table */
-    for (i=0; i<=HASH_COUNT; ++i) {
-        rc = hash_test_with_key(pool, (unsigned char)i);
+        /* Collision test */
+        rc = hash_collision_test(pool, create[j]);
         if (rc != 0) {
             pj_pool_release(pool);
             return rc;
         }
     }
 
-    /* Collision test */
-    rc = hash_collision_test(pool);
+    /* Open addressing table growth and deletion */
+    rc = hash_oa_test(pool);
     if (rc != 0) {
         pj_pool_release(pool);
         return rc;
     }
 
     pj_pool_release(pool);
-    return 0;
+
+    /* Entry counts for which the table ends up rehashing at the same
+     * size, i.e. only to remove deleted slots.
+     */
+    for (i=0; i<PJ_ARRAY_SIZE(churn_live); ++i) {
+        rc = hash_oa_churn_test(churn_live[i]);
+        if (rc != 0)
+            return rc;
+    }
+
+    rc = hash_calc_test();
+    if (rc != 0)
+        return rc;
+
+    return hash_perf_test();
 }
 
 #endif  /* INCLUDE_HASH_TEST */
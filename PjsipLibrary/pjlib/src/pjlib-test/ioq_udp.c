@@ -184,6 +184,7 @@ static int compliance_test(const pj_ioqueue_cfg *cfg)
     ioque_name = pj_str((char*)pj_ioqueue_name());
     if (pj_strncmp(&ioque_name, pj_cstr(&ioqueue_type, "epoll"), 5) == 0 ||
         pj_strncmp(&ioque_name, pj_cstr(&ioqueue_type, "kqueue"), 6) == 0 ||
+        pj_strncmp(&ioque_name, pj_cstr(&ioqueue_type, "io_uring"), 8) == 0 ||
         pj_strncmp(&ioque_name, pj_cstr(&ioqueue_type, "iocp"), 4) == 0) {
       if (pj_ioqueue_get_os_handle(ioque) == NULL) {
         PJ_LOG(1,(
@@ -585,6 +586,216 @@ static int unregister_test(const pj_ioqueue_cfg *cfg)
 }
 
 
+/*
+ * unregister_pending_test()
+ * Unregister a socket with many reads pending, then send packets to its
+ * address. The read buffers must not be touched after pj_ioqueue_unregister()
+ * returns, since application may free them right away.
+ */
+static int unregister_pending_test(const pj_ioqueue_cfg *cfg)
+{
+    enum { CNT = 64, SIZE = 16 };
+    pj_pool_t *pool;
+    pj_ioqueue_t *ioqueue = NULL;
+    pj_ioqueue_key_t *key = NULL;
+    pj_sock_t ssock = PJ_INVALID_SOCKET, rsock = PJ_INVALID_SOCKET;
+    pj_ioqueue_op_key_t *opkey;
+    pj_ioqueue_callback cb;
+    pj_sockaddr_in addr;
+    unsigned packet_cnt = 0;
+    char *buf, sendbuf[SIZE];
+    pj_time_val timeout;
+    unsigned i;
+    int addr_len, rc = 0;
+    pj_status_t status;
+
+    PJ_LOG(3,(THIS_FILE,"...unregister with pending reads test"));
+
+    pool = pj_pool_create(mem, NULL, 4000, 4000, NULL);
+    if (!pool)
+        return -10;
+
+    opkey = (pj_ioqueue_op_key_t*)
+            pj_pool_calloc(pool, CNT, sizeof(pj_ioqueue_op_key_t));
+    buf = (char*) pj_pool_alloc(pool, CNT * SIZE);
+
+    status = pj_ioqueue_create2(pool, 4, cfg, &ioqueue);
+    if (status != PJ_SUCCESS) {
+        app_perror("...error in pj_ioqueue_create", status);
+        rc = -20; goto on_return;
+    }
+
+    if (pj_sock_socket(pj_AF_INET(), pj_SOCK_DGRAM(), 0, &ssock) ||
+        pj_sock_socket(pj_AF_INET(), pj_SOCK_DGRAM(), 0, &rsock))
+    {
+        rc = -30; goto on_return;
+    }
+
+    pj_sockaddr_in_init(&addr, NULL, 0);
+    addr.sin_addr.s_addr = pj_inet_addr2("127.0.0.1").s_addr;
+    addr_len = sizeof(addr);
+    if (pj_sock_bind(rsock, &addr, sizeof(addr)) ||
+        pj_sock_getsockname(rsock, &addr, &addr_len))
+    {
+        rc = -40; goto on_return;
+    }
+
+    pj_bzero(&cb, sizeof(cb));
+    cb.on_read_complete = &on_read_complete;
+    status = pj_ioqueue_register_sock(pool, ioqueue, rsock, &packet_cnt,
+                                      &cb, &key);
+    if (status != PJ_SUCCESS) {
+        app_perror("...error in pj_ioqueue_register_sock", status);
+        rc = -50; goto on_return;
+    }
+    rsock = PJ_INVALID_SOCKET;
+
+    for (i=0; i<CNT; ++i) {
+        pj_ssize_t bytes = SIZE;
+
+        pj_ioqueue_op_key_init(&opkey[i], sizeof(opkey[i]));
+        status = pj_ioqueue_recv(key, &opkey[i], buf + i * SIZE, &bytes, 0);
+        if (status != PJ_EPENDING) {
+            app_perror("...expecting PJ_EPENDING, but got this", status);
+            rc = -60; goto on_return;
+        }
+    }
+
+    pj_ioqueue_unregister(key);
+    key = NULL;
+
+    /* Application now owns the buffers again */
+    pj_memset(buf, 'x', CNT * SIZE);
+
+    pj_memset(sendbuf, 'y', sizeof(sendbuf));
+    for (i=0; i<CNT; ++i) {
+        pj_ssize_t bytes = sizeof(sendbuf);
+        pj_sock_sendto(ssock, sendbuf, &bytes, 0, &addr, sizeof(addr));
+    }
+
+    for (i=0; i<5; ++i) {
+        timeout.sec = 0; timeout.msec = 20;
+        pj_ioqueue_poll(ioqueue, &timeout);
+    }
+
+    if (packet_cnt != 0) {
+        PJ_LOG(3,(THIS_FILE, "...error: read completed after unregister"));
+        rc = -70; goto on_return;
+    }
+
+    for (i=0; i<CNT * SIZE; ++i) {
+        if (buf[i] != 'x') {
+            PJ_LOG(3,(THIS_FILE, "...error: buffer written after "
+                                 "unregister"));
+            rc = -80; goto on_return;
+        }
+    }
+
+on_return:
+    if (key)
+        pj_ioqueue_unregister(key);
+    if (rsock != PJ_INVALID_SOCKET)
+        pj_sock_close(rsock);
+    if (ssock != PJ_INVALID_SOCKET)
+        pj_sock_close(ssock);
+    if (ioqueue)
+        pj_ioqueue_destroy(ioqueue);
+    pj_pool_release(pool);
+    return rc;
+}
+
+/*
+ * sendto_batch_test()
+ * Send several packets with pj_ioqueue_sendto_batch() and make sure all
+ * of them arrive.
+ */
+static int sendto_batch_test(const pj_ioqueue_cfg *cfg)
+{
+    enum { CNT = 4 };
+    pj_pool_t *pool;
+    pj_ioqueue_t *ioqueue = NULL;
+    pj_ioqueue_key_t *key = NULL;
+    pj_sock_t ssock = PJ_INVALID_SOCKET, csock = PJ_INVALID_SOCKET;
+    pj_sockaddr_in addr;
+    pj_sock_mmsg msgs[CNT];
+    pj_uint32_t data[CNT];
+    unsigned i, cnt;
+    int addr_len, rc = 0;
+    pj_status_t status;
+
+    PJ_LOG(3,(THIS_FILE,"...sendto_batch test"));
+
+    pool = pj_pool_create(mem, NULL, 4000, 4000, NULL);
+    if (!pool)
+        return -10;
+
+    status = pj_ioqueue_create2(pool, 4, cfg, &ioqueue);
+    if (status != PJ_SUCCESS) {
+        app_perror("...error in pj_ioqueue_create", status);
+        rc = -20; goto on_return;
+    }
+
+    if (pj_sock_socket(pj_AF_INET(), pj_SOCK_DGRAM(), 0, &ssock) ||
+        pj_sock_socket(pj_AF_INET(), pj_SOCK_DGRAM(), 0, &csock))
+    {
+        rc = -30; goto on_return;
+    }
+
+    pj_sockaddr_in_init(&addr, NULL, 0);
+    addr.sin_addr.s_addr = pj_inet_addr2("127.0.0.1").s_addr;
+    addr_len = sizeof(addr);
+    if (pj_sock_bind(ssock, &addr, sizeof(addr)) ||
+        pj_sock_getsockname(ssock, &addr, &addr_len))
+    {
+        rc = -40; goto on_return;
+    }
+
+    status = pj_ioqueue_register_sock(pool, ioqueue, csock, NULL,
+                                      &test_cb, &key);
+    if (status != PJ_SUCCESS) {
+        app_perror("...error in pj_ioqueue_register_sock", status);
+        rc = -50; goto on_return;
+    }
+
+    for (i=0; i<CNT; ++i) {
+        data[i] = i;
+        msgs[i].buf = &data[i];
+        msgs[i].size = sizeof(data[i]);
+        pj_memcpy(&msgs[i].addr, &addr, sizeof(addr));
+        msgs[i].addr_len = sizeof(addr);
+    }
+
+    cnt = CNT;
+    status = pj_ioqueue_sendto_batch(key, msgs, &cnt, 0);
+    if (status != PJ_SUCCESS || cnt != CNT) {
+        app_perror("...error in pj_ioqueue_sendto_batch", status);
+        rc = -60; goto on_return;
+    }
+
+    for (i=0; i<CNT; ++i) {
+        pj_uint32_t rx;
+        pj_ssize_t len = sizeof(rx);
+
+        status = pj_sock_recv(ssock, &rx, &len, 0);
+        if (status != PJ_SUCCESS || len != sizeof(rx) || rx != i) {
+            PJ_LOG(3,(THIS_FILE, "...error: packet %u mismatch", i));
+            rc = -70; goto on_return;
+        }
+    }
+
+on_return:
+    if (key)
+        pj_ioqueue_unregister(key);
+    else if (csock != PJ_INVALID_SOCKET)
+        pj_sock_close(csock);
+    if (ssock != PJ_INVALID_SOCKET)
+        pj_sock_close(ssock);
+    if (ioqueue)
+        pj_ioqueue_destroy(ioqueue);
+    pj_pool_release(pool);
+    return rc;
+}
+
 /*
  * Testing with many handles.
  * This will just test registering PJ_IOQUEUE_MAX_HANDLES count
@@ -1192,6 +1403,14 @@ static int udp_ioqueue_test_imp(const pj_ioqueue_cfg *cfg)
     }
     PJ_LOG(3, (THIS_FILE, "....unregister test ok"));
 
+    if ((status=unregister_pending_test(cfg)) != 0) {
+        return status;
+    }
+
+    if ((status=sendto_batch_test(cfg)) != 0) {
+        return status;
+    }
+
     if ((status=many_handles_test(cfg)) != 0) {
         return status;
     }
@@ -201,6 +201,387 @@ static int semaphore_test(pj_pool_t *pool)
 #endif  /* PJ_HAS_SEMAPHORE */
 
 
+/*
+ * Reader/writer mutex and sequence lock tests.
+ */
+#define RW_THREAD_CNT       16
+#define RW_BENCH_MSEC       500
+
+/* The record protected by the locks. Writers keep b == ~a. */
+typedef struct rw_record
+{
+    pj_uint32_t     a;
+    pj_uint32_t     b;
+} rw_record;
+
+enum rw_lock_type
+{
+    RW_MUTEX,
+    RW_RWMUTEX,
+    RW_SEQLOCK
+};
+
+static struct rw_state
+{
+    enum rw_lock_type   type;
+    pj_mutex_t         *mutex;
+    pj_rwmutex_t       *rwmutex;
+    pj_seqlock_t       *seqlock;
+    rw_record           rec;
+    volatile int        quit;
+    volatile int        in_read;
+    int                 err;
+} rw;
+
+static void rw_read(rw_record *out)
+{
+    unsigned seq;
+
+    switch (rw.type) {
+    case RW_MUTEX:
+        pj_mutex_lock(rw.mutex);
+        *out = rw.rec;
+        pj_mutex_unlock(rw.mutex);
+        break;
+    case RW_RWMUTEX:
+        pj_rwmutex_lock_read(rw.rwmutex);
+        *out = rw.rec;
+        pj_rwmutex_unlock_read(rw.rwmutex);
+        break;
+    default:
+        do {
+            seq = pj_seqlock_read_begin(rw.seqlock);
+            *out = rw.rec;
+        } while (pj_seqlock_read_retry(rw.seqlock, seq));
+        break;
+    }
+}
+
+static void rw_write(pj_uint32_t val)
+{
+    switch (rw.type) {
+    case RW_MUTEX:
+        pj_mutex_lock(rw.mutex);
+        rw.rec.a = val;
+        rw.rec.b = ~val;
+        pj_mutex_unlock(rw.mutex);
+        break;
+    case RW_RWMUTEX:
+        pj_rwmutex_lock_write(rw.rwmutex);
+        rw.rec.a = val;
+        rw.rec.b = ~val;
+        pj_rwmutex_unlock_write(rw.rwmutex);
+        break;
+    default:
+        pj_seqlock_write_lock(rw.seqlock);
+        rw.rec.a = val;
+        rw.rec.b = ~val;
+        pj_seqlock_write_unlock(rw.seqlock);
+        break;
+    }
+}
+
+static int rw_reader_thread(void *arg)
+{
+    pj_uint32_t *cnt = (pj_uint32_t*)arg;
+    rw_record rec;
+
+    while (!rw.quit) {
+        rw_read(&rec);
+        if (rec.b != ~rec.a)
+            rw.err = 1;
+        ++(*cnt);
+    }
+    return 0;
+}
+
+static int rw_writer_thread(void *arg)
+{
+    pj_uint32_t val = 0;
+
+    PJ_UNUSED_ARG(arg);
+
+    while (!rw.quit) {
+        rw_write(++val);
+        pj_thread_sleep(1);
+    }
+    return 0;
+}
+
+/* Thread holding the read lock while the main thread also holds it */
+static int rw_shared_thread(void *arg)
+{
+    PJ_UNUSED_ARG(arg);
+
+    pj_rwmutex_lock_read(rw.rwmutex);
+    rw.in_read = 1;
+    while (!rw.quit)
+        pj_thread_sleep(10);
+    pj_rwmutex_unlock_read(rw.rwmutex);
+    return 0;
+}
+
+/* Run reader_cnt readers and one writer for RW_BENCH_MSEC, checking that
+ * readers never observe a partially written record.
+ */
+static int rw_run(pj_pool_t *pool, enum rw_lock_type type,
+                  unsigned reader_cnt, pj_bool_t verbose)
+{
+    static const char *type_names[] = { "mutex", "rwmutex", "seqlock" };
+    pj_thread_t *thread[RW_THREAD_CNT+1];
+    pj_uint32_t cnt[RW_THREAD_CNT];
+    pj_uint64_t total = 0;
+    unsigned i;
+    pj_status_t status;
+
+    rw.type = type;
+    rw.quit = 0;
+    rw.err = 0;
+    rw.rec.a = 0;
+    rw.rec.b = ~rw.rec.a;
+    pj_bzero(cnt, sizeof(cnt));
+
+    status = pj_thread_create(pool, "rw_w", &rw_writer_thread, NULL, 0, 0,
+                              &thread[reader_cnt]);
+    if (status != PJ_SUCCESS)
+        return -200;
+
+    for (i = 0; i < reader_cnt; ++i) {
+        status = pj_thread_create(pool, "rw_r", &rw_reader_thread, &cnt[i],
+                                  0, 0, &thread[i]);
+        if (status != PJ_SUCCESS)
+            return -210;
+    }
+
+    pj_thread_sleep(RW_BENCH_MSEC);
+    rw.quit = 1;
+
+    for (i = 0; i <= reader_cnt; ++i) {
+        pj_thread_join(thread[i]);
+        pj_thread_destroy(thread[i]);
+    }
+
+    if (rw.err) {
+        PJ_LOG(3,("", "...error: %s reader saw inconsistent record",
+                  type_names[type]));
+        return -220;
+    }
+
+    if (verbose) {
+        for (i = 0; i < reader_cnt; ++i)
+            total += cnt[i];
+        PJ_LOG(3,("", "....%-7s %2u reader(s): %10lu reads/sec",
+                  type_names[type], reader_cnt,
+                  (unsigned long)(total * 1000 / RW_BENCH_MSEC)));
+    }
+
+    return 0;
+}
+
+static int rwlock_test(pj_pool_t *pool)
+{
+    pj_thread_t *thread;
+    unsigned i;
+    int rc;
+    pj_status_t status;
+
+    PJ_LOG(3,("", "...testing reader/writer mutex and sequence lock"));
+
+    status = pj_mutex_create_simple(pool, NULL, &rw.mutex);
+    if (status != PJ_SUCCESS)
+        return -171;
+    status = pj_rwmutex_create(pool, NULL, &rw.rwmutex);
+    if (status != PJ_SUCCESS)
+        return -172;
+    status = pj_seqlock_create(pool, NULL, &rw.seqlock);
+    if (status != PJ_SUCCESS)
+        return -173;
+
+    /* Two readers must be able to hold the read lock at the same time */
+    rw.quit = 0;
+    rw.in_read = 0;
+    pj_rwmutex_lock_read(rw.rwmutex);
+    status = pj_thread_create(pool, "rw_s", &rw_shared_thread, NULL, 0, 0,
+                              &thread);
+    if (status != PJ_SUCCESS) {
+        pj_rwmutex_unlock_read(rw.rwmutex);
+        return -174;
+    }
+    for (i = 0; i < 100 && !rw.in_read; ++i)
+        pj_thread_sleep(10);
+    pj_rwmutex_unlock_read(rw.rwmutex);
+    rw.quit = 1;
+    pj_thread_join(thread);
+    pj_thread_destroy(thread);
+    if (!rw.in_read) {
+        PJ_LOG(3,("", "...error: read lock is not shared"));
+        return -175;
+    }
+
+    /* Readers must never see a half written record */
+    rc = rw_run(pool, RW_RWMUTEX, 4, PJ_FALSE);
+    if (rc == 0)
+        rc = rw_run(pool, RW_SEQLOCK, 4, PJ_FALSE);
+
+#if WITH_BENCHMARK
+    if (rc == 0) {
+        static const unsigned reader_cnt[] = { 1, 4, RW_THREAD_CNT };
+        unsigned type;
+
+        PJ_LOG(3,("", "...benchmarking read-mostly lock contention "
+                      "(one writer every msec)"));
+        for (i = 0; i < PJ_ARRAY_SIZE(reader_cnt) && rc == 0; ++i) {
+            for (type = RW_MUTEX; type <= RW_SEQLOCK && rc == 0; ++type)
+                rc = rw_run(pool, (enum rw_lock_type)type, reader_cnt[i],
+                            PJ_TRUE);
+        }
+    }
+#endif
+
+    pj_seqlock_destroy(rw.seqlock);
+    pj_rwmutex_destroy(rw.rwmutex);
+    pj_mutex_destroy(rw.mutex);
+
+    return rc;
+}
+
+
+#if PJ_LOCK_PROFILING && PJ_HAS_SEMAPHORE
+static pj_mutex_t *prof_mutex;
+static pj_sem_t *prof_sem;
+
+/* Hold the mutex for a while, so that the main thread has to wait */
+static int prof_holder_thread(void *arg)
+{
+    PJ_UNUSED_ARG(arg);
+
+    pj_mutex_lock(prof_mutex);
+    pj_sem_post(prof_sem);
+    pj_thread_sleep(20);
+    pj_mutex_unlock(prof_mutex);
+    return 0;
+}
+
+static const pj_lock_prof_stat *find_prof_stat(const pj_lock_prof_stat st[],
+                                               unsigned cnt,
+                                               const char *name)
+{
+    unsigned i;
+
+    for (i=0; i<cnt; ++i) {
+        if (pj_ansi_strcmp(st[i].name, name) == 0)
+            return &st[i];
+    }
+    return NULL;
+}
+
+static int lock_prof_test(pj_pool_t *pool)
+{
+    pj_mutex_t *other;
+    pj_pool_t *grp_pool;
+    pj_grp_lock_t *grp_lock;
+    pj_thread_t *thread;
+    pj_lock_prof_stat *st;
+    const pj_lock_prof_stat *mst, *gst;
+    unsigned cnt = PJ_LOCK_PROF_MAX_ENTRY;
+    char *buf;
+    pj_ssize_t len;
+    int rc = 0;
+
+    PJ_LOG(3,("", "...testing lock profiling"));
+
+    pj_lock_prof_reset();
+
+    /* Both mutexes are recorded as "lprof" */
+    if (pj_mutex_create_recursive(pool, "lprof0x1000", &prof_mutex) ||
+        pj_mutex_create_simple(pool, "lprof0x2000", &other) ||
+        pj_sem_create(pool, NULL, 0, 1, &prof_sem))
+    {
+        return -1000;
+    }
+
+    grp_pool = pj_pool_create(mem, "lprofgrp%p", 1000, 1000, NULL);
+    if (pj_grp_lock_create(grp_pool, NULL, &grp_lock) != PJ_SUCCESS)
+        return -1010;
+    pj_grp_lock_add_ref(grp_lock);
+
+    /* Contended acquisition */
+    if (pj_thread_create(pool, "lprof", &prof_holder_thread, NULL, 0, 0,
+                         &thread) != PJ_SUCCESS)
+    {
+        return -1020;
+    }
+    pj_sem_wait(prof_sem);
+    pj_mutex_lock(prof_mutex);
+    pj_mutex_unlock(prof_mutex);
+    pj_thread_join(thread);
+    pj_thread_destroy(thread);
+
+    /* Nested acquisition counts once */
+    pj_mutex_lock(prof_mutex);
+    pj_mutex_lock(prof_mutex);
+    pj_mutex_unlock(prof_mutex);
+    pj_mutex_unlock(prof_mutex);
+
+    pj_mutex_trylock(other);
+    pj_mutex_unlock(other);
+
+    pj_grp_lock_acquire(grp_lock);
+    pj_grp_lock_acquire(grp_lock);
+    pj_grp_lock_release(grp_lock);
+    pj_grp_lock_release(grp_lock);
+    pj_grp_lock_tryacquire(grp_lock);
+    pj_grp_lock_release(grp_lock);
+
+    st = (pj_lock_prof_stat*)
+         pj_pool_calloc(pool, cnt, sizeof(pj_lock_prof_stat));
+    pj_lock_prof_get_stat(st, &cnt);
+
+    mst = find_prof_stat(st, cnt, "lprof");
+    gst = find_prof_stat(st, cnt, "grp:lprofgrp");
+    if (!mst || !gst) {
+        PJ_LOG(3,("", "...error: lock profile record not found"));
+        rc = -1030;
+    } else if (mst->acq_cnt != 4 || mst->contended_cnt != 1 ||
+               mst->wait_max_nsec < 5000000 ||
+               mst->hold_max_nsec < 5000000 ||
+               mst->hold_hist[PJ_LOCK_PROF_HIST_CNT-1] != 0)
+    {
+        PJ_LOG(3,("", "...error: wrong mutex profile: acq=%u "
+                      "contended=%u wait_max=%u us hold_max=%u us",
+                  mst->acq_cnt, mst->contended_cnt,
+                  (unsigned)(mst->wait_max_nsec/1000),
+                  (unsigned)(mst->hold_max_nsec/1000)));
+        rc = -1040;
+    } else if (gst->acq_cnt != 2 || gst->contended_cnt != 0) {
+        PJ_LOG(3,("", "...error: wrong group lock profile: acq=%u "
+                      "contended=%u", gst->acq_cnt, gst->contended_cnt));
+        rc = -1050;
+    }
+
+    if (rc == 0) {
+        buf = (char*) pj_pool_alloc(pool, 16000);
+        len = pj_lock_prof_export(buf, 16000);
+        if (len <= 0 || !pj_ansi_strstr(buf, "{\"name\":\"lprof\",") ||
+            pj_lock_prof_export(buf, 20) != -1)
+        {
+            PJ_LOG(3,("", "...error: wrong lock profile export"));
+            rc = -1060;
+        }
+    }
+
+    if (rc == 0)
+        pj_lock_prof_dump(PJ_TRUE);
+
+    pj_grp_lock_dec_ref(grp_lock);
+    pj_sem_destroy(prof_sem);
+    pj_mutex_destroy(other);
+    pj_mutex_destroy(prof_mutex);
+    return rc;
+}
+#endif  /* PJ_LOCK_PROFILING && PJ_HAS_SEMAPHORE */
+
+
 int mutex_test(void)
 {
     pj_pool_t *pool;
@@ -222,6 +603,16 @@ int mutex_test(void)
         return rc;
 #endif
 
+    rc = rwlock_test(pool);
+    if (rc != 0)
+        return rc;
+
+#if PJ_LOCK_PROFILING && PJ_HAS_SEMAPHORE
+    rc = lock_prof_test(pool);
+    if (rc != 0)
+        return rc;
+#endif
+
     pj_pool_release(pool);
 
     return 0;
@@ -19,6 +19,8 @@
 #include "test.h"
 #include <pj/log.h>
 #include <pj/os.h>
+#include <pj/pool.h>
+#include <pj/string.h>
 #include <string.h>
 #include <stdio.h>
 
@@ -103,6 +105,192 @@ static void log_write(int level, const char *buffer, int len)
     //printf("%s", buffer);
 }
 
+#if PJ_HAS_THREADS
+#define ASYNC_THREADS   4
+#define ASYNC_MSGS      500
+
+static struct async_rx
+{
+    int         last_seq[ASYNC_THREADS + 1];
+    unsigned    lines;
+    unsigned    others;
+    unsigned    calls;
+    unsigned    dropped;
+    pj_bool_t   out_of_order;
+    pj_bool_t   bad_buffer;
+    unsigned    delay;
+} async_rx;
+
+/* Receives the messages "T<thread> S<seq>\n" from the log thread */
+static void async_log_write(int level, const char *buffer, int len)
+{
+    const char *p = buffer;
+
+    PJ_UNUSED_ARG(level);
+
+    ++async_rx.calls;
+    if (buffer[len] != '\0' || (int)strlen(buffer) != len)
+        async_rx.bad_buffer = PJ_TRUE;
+
+    while (*p) {
+        int t, seq;
+        unsigned n;
+
+        if (sscanf(p, "T%d S%d", &t, &seq) == 2 && t >= 0 &&
+            t <= ASYNC_THREADS)
+        {
+            if (seq <= async_rx.last_seq[t])
+                async_rx.out_of_order = PJ_TRUE;
+            async_rx.last_seq[t] = seq;
+            ++async_rx.lines;
+        } else if (sscanf(p, "<%u log messages dropped>", &n) == 1) {
+            async_rx.dropped += n;
+        } else {
+            ++async_rx.others;
+        }
+
+        p = strchr(p, '\n');
+        if (!p)
+            break;
+        ++p;
+    }
+
+    if (async_rx.delay)
+        pj_thread_sleep(async_rx.delay);
+}
+
+static void async_reset(void)
+{
+    unsigned i;
+
+    pj_bzero(&async_rx, sizeof(async_rx));
+    for (i=0; i<=ASYNC_THREADS; ++i)
+        async_rx.last_seq[i] = -1;
+}
+
+static int async_log_thread(void *arg)
+{
+    int t = (int)(pj_ssize_t)arg;
+    int i;
+
+    for (i=0; i<ASYNC_MSGS; ++i)
+        PJ_LOG(1,(THIS_FILE, "T%d S%d", t, i));
+    return 0;
+}
+
+static int async_log_test(void)
+{
+    pj_log_func *old_func = pj_log_get_log_func();
+    unsigned old_decor = pj_log_get_decor();
+    pj_log_async_param prm;
+    pj_log_async_stat stat;
+    pj_pool_t *pool;
+    pj_thread_t *thread[ASYNC_THREADS];
+    unsigned i, thread_cnt = 0;
+    int rc = 0;
+
+    PJ_LOG(3,(THIS_FILE, "...async log test"));
+
+    pool = pj_pool_create(mem, NULL, 4000, 4000, NULL);
+    if (!pool)
+        return 40;
+
+    pj_log_async_param_default(&prm);
+    prm.buf_size = 2 * PJ_LOG_MAX_SIZE;
+    prm.batch_size = 1000;
+
+    async_reset();
+    pj_log_set_log_func(&async_log_write);
+    pj_log_set_decor(PJ_LOG_HAS_NEWLINE);
+
+    if (pj_log_async_start(mem, &prm) != PJ_SUCCESS) {
+        rc = 41;
+        goto on_return;
+    }
+
+    /* Messages are written in order and in batches. The burst fits in the
+     * queue, which holds 64 of these messages, and the slow writer lets
+     * them pile up.
+     */
+    async_rx.delay = 10;
+    for (i=0; i<50; ++i)
+        PJ_LOG(1,(THIS_FILE, "T0 S%d", i));
+    pj_log_async_flush();
+    pj_log_async_get_stat(&stat);
+    if (async_rx.lines != 50 || async_rx.out_of_order ||
+        async_rx.bad_buffer || stat.queued != 50 || stat.written != 50 ||
+        stat.dropped != 0 || stat.write_cnt != async_rx.calls ||
+        stat.write_cnt >= 50 || stat.max_used == 0)
+    {
+        PJ_LOG(3,(THIS_FILE, "...error: lines=%u calls=%u queued=%u "
+                  "written=%u", async_rx.lines, async_rx.calls,
+                  stat.queued, stat.written));
+        rc = 42;
+        goto on_return;
+    }
+
+    /* Several threads with a slow writer: some messages are dropped, the
+     * rest arrive in order.
+     */
+    pj_log_async_stop();
+    async_reset();
+    async_rx.delay = 10;
+    if (pj_log_async_start(mem, &prm) != PJ_SUCCESS) {
+        rc = 43;
+        goto on_return;
+    }
+
+    for (thread_cnt=0; thread_cnt<ASYNC_THREADS; ++thread_cnt) {
+        if (pj_thread_create(pool, "asynclogt", &async_log_thread,
+                             (void*)(pj_ssize_t)(thread_cnt + 1), 0, 0,
+                             &thread[thread_cnt]) != PJ_SUCCESS)
+        {
+            rc = 44;
+            break;
+        }
+    }
+    for (i=0; i<thread_cnt; ++i) {
+        pj_thread_join(thread[i]);
+        pj_thread_destroy(thread[i]);
+    }
+    if (rc)
+        goto on_return;
+
+    /* Stopping writes everything that was queued */
+    pj_log_async_get_stat(&stat);
+    pj_log_async_stop();
+    async_rx.delay = 0;
+
+    if (stat.queued + stat.dropped < ASYNC_THREADS * ASYNC_MSGS ||
+        stat.dropped == 0 ||
+        async_rx.lines + async_rx.others != stat.queued ||
+        async_rx.dropped != stat.dropped || async_rx.out_of_order ||
+        async_rx.bad_buffer)
+    {
+        PJ_LOG(3,(THIS_FILE, "...error: lines=%u queued=%u dropped=%u "
+                  "reported=%u", async_rx.lines, stat.queued,
+                  stat.dropped, async_rx.dropped));
+        rc = 45;
+        goto on_return;
+    }
+
+    /* Written directly after stop */
+    i = async_rx.lines;
+    PJ_LOG(1,(THIS_FILE, "T0 S%d", 1000));
+    if (async_rx.lines != i + 1) {
+        rc = 46;
+        goto on_return;
+    }
+
+on_return:
+    pj_log_async_stop();
+    pj_log_set_log_func(old_func);
+    pj_log_set_decor(old_decor);
+    pj_pool_release(pool);
+    return rc;
+}
+#endif  /* PJ_HAS_THREADS */
+
 int log_test(void)
 {
     pj_log_func *old_func = pj_log_get_log_func();
@@ -226,7 +414,11 @@ int log_test(void)
     pj_log_set_log_func( old_func );
     pj_log_set_decor(old_decor);
 
+#if PJ_HAS_THREADS
+    return async_log_test();
+#else
     return 0;
+#endif
 }
 
 int os_test(void)
@@ -117,6 +117,178 @@ static int pool_test_malloc_free()
 
 #endif /* PJ_SYMBIAN */
 
+#if PJ_HAS_THREADS
+
+/* Multithreaded pool create/release benchmark, using a dedicated caching
+ * pool with non-zero max_capacity so that pools are actually recycled.
+ */
+#define MT_MAX_THREADS      16
+#define MT_POOL_CNT         16
+#define MT_TOTAL_POOLS      320000
+#define MT_MAX_CAPACITY     (4 * 1024 * 1024)
+
+static pj_caching_pool mt_cp;
+static int mt_err;
+static pj_atomic_t *mt_running;
+
+static int mt_pool_thread(void *arg)
+{
+    pj_pool_t *pool[MT_POOL_CNT];
+    unsigned loop = *(unsigned*)arg;
+    unsigned i, j;
+
+    for (i=0; i<loop; ++i) {
+        for (j=0; j<MT_POOL_CNT; ++j) {
+            pool[j] = pj_pool_create(&mt_cp.factory, "mt", 512 + j*512,
+                                     512, NULL);
+            if (!pool[j]) {
+                mt_err = 1;
+                while (j > 0)
+                    pj_pool_release(pool[--j]);
+                pj_atomic_dec(mt_running);
+                return -1;
+            }
+            pj_pool_alloc(pool[j], 700);
+        }
+        for (j=0; j<MT_POOL_CNT; ++j)
+            pj_pool_release(pool[j]);
+    }
+    pj_atomic_dec(mt_running);
+    return 0;
+}
+
+/* Release pools created by another thread */
+static int mt_release_thread(void *arg)
+{
+    pj_pool_t **pool = (pj_pool_t**)arg;
+    unsigned i;
+
+    for (i=0; i<MT_POOL_CNT; ++i)
+        pj_pool_release(pool[i]);
+    return 0;
+}
+
+static int pool_mt_run(pj_pool_t *pool, unsigned thread_cnt, pj_bool_t dump)
+{
+    pj_thread_t *thread[MT_MAX_THREADS];
+    unsigned loop = MT_TOTAL_POOLS / MT_POOL_CNT / thread_cnt;
+    pj_timestamp t1, t2;
+    pj_uint32_t msec;
+    unsigned i;
+    pj_status_t status;
+
+    mt_err = 0;
+    pj_atomic_set(mt_running, thread_cnt);
+    pj_get_timestamp(&t1);
+
+    for (i=0; i<thread_cnt; ++i) {
+        status = pj_thread_create(pool, "pool_mt", &mt_pool_thread, &loop,
+                                  0, 0, &thread[i]);
+        if (status != PJ_SUCCESS)
+            return -110;
+    }
+
+    /* Dumping the pools must not deadlock with the threads creating and
+     * releasing them.
+     */
+    if (dump) {
+        int log_level = pj_log_get_level();
+
+        pj_log_set_level(1);
+        while (pj_atomic_get(mt_running) > 0)
+            pj_pool_factory_dump(&mt_cp.factory, PJ_TRUE);
+        pj_log_set_level(log_level);
+    }
+
+    for (i=0; i<thread_cnt; ++i) {
+        pj_thread_join(thread[i]);
+        pj_thread_destroy(thread[i]);
+    }
+
+    pj_get_timestamp(&t2);
+    msec = pj_elapsed_msec(&t1, &t2);
+    if (msec == 0) msec = 1;
+
+    if (mt_err)
+        return -120;
+
+    PJ_LOG(3,(THIS_FILE, "..%2u thread(s): %8lu pool create+release/sec",
+              thread_cnt,
+              (unsigned long)((pj_uint64_t)loop * MT_POOL_CNT * thread_cnt *
+                              1000 / msec)));
+    return 0;
+}
+
+static int pool_mt_test(void)
+{
+    static const unsigned thread_cnt[] = { 1, 4, MT_MAX_THREADS };
+    pj_pool_t *pool, *mt_pool[MT_POOL_CNT];
+    pj_thread_t *thread;
+    unsigned i;
+    int rc = 0;
+
+    PJ_LOG(3,(THIS_FILE, "Benchmarking multithreaded caching pool "
+                         "(per-thread cache size %d)..",
+                         PJ_CACHING_POOL_TLS_CACHE_SIZE));
+
+    pool = pj_pool_create(mem, NULL, 4000, 4000, NULL);
+    if (!pool)
+        return -100;
+
+    if (pj_atomic_create(pool, 0, &mt_running) != PJ_SUCCESS) {
+        pj_pool_release(pool);
+        return -105;
+    }
+
+    pj_caching_pool_init(&mt_cp, NULL, MT_MAX_CAPACITY);
+
+    for (i=0; i<PJ_ARRAY_SIZE(thread_cnt) && rc==0; ++i)
+        rc = pool_mt_run(pool, thread_cnt[i], PJ_FALSE);
+
+    if (rc == 0)
+        rc = pool_mt_run(pool, 4, PJ_TRUE);
+
+    /* Pools may be released by a thread other than the creator */
+    for (i=0; i<MT_POOL_CNT && rc==0; ++i) {
+        mt_pool[i] = pj_pool_create(&mt_cp.factory, "mt", 1000, 1000, NULL);
+        if (!mt_pool[i]) {
+            while (i > 0)
+                pj_pool_release(mt_pool[--i]);
+            rc = -130;
+        }
+    }
+    if (rc == 0) {
+        if (pj_thread_create(pool, "pool_rel", &mt_release_thread, mt_pool,
+                             0, 0, &thread) != PJ_SUCCESS)
+        {
+            mt_release_thread(mt_pool);
+            rc = -140;
+        } else {
+            pj_thread_join(thread);
+            pj_thread_destroy(thread);
+        }
+    }
+
+    /* All pools must have been accounted back */
+    if (rc == 0 && mt_cp.used_count != 0) {
+        PJ_LOG(3,(THIS_FILE, "...error: used_count is %lu, expecting 0",
+                  (unsigned long)mt_cp.used_count));
+        rc = -150;
+    }
+    if (rc == 0 && mt_cp.capacity > MT_MAX_CAPACITY) {
+        PJ_LOG(3,(THIS_FILE, "...error: capacity %lu exceeds max_capacity",
+                  (unsigned long)mt_cp.capacity));
+        rc = -160;
+    }
+
+    pj_caching_pool_destroy(&mt_cp);
+    pj_atomic_destroy(mt_running);
+    pj_pool_release(pool);
+    return rc;
+}
+
+#endif  /* PJ_HAS_THREADS */
+
 int pool_perf_test()
 {
     unsigned i;
@@ -185,7 +357,12 @@ int pool_perf_test()
     PJ_LOG(3, (THIS_FILE, "..pool speedup over malloc best=%dx, worst=%dx", 
                           (int)(malloc_time/best),
                           (int)(malloc_time/worst)));
+
+#if PJ_HAS_THREADS
+    return pool_mt_test();
+#else
     return 0;
+#endif
 }
 
 
@@ -0,0 +1,275 @@
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include <pj/ringbuf.h>
+#include <pj/log.h>
+#include <pj/os.h>
+#include <pj/pool.h>
+#include <pj/string.h>
+#include "test.h"
+
+/**
+ * \page page_pjlib_ringbuf_test Test: Ring Buffer
+ *
+ * This file provides implementation of \b ringbuf_test(). It tests the
+ * single producer single consumer ring buffer, both from one thread and
+ * with a producer and a consumer thread.
+ *
+ * This file is <b>pjlib-test/ringbuf.c</b>
+ *
+ * \include pjlib-test/ringbuf.c
+ */
+
+#if INCLUDE_RINGBUF_TEST
+
+#define THIS_FILE   "ringbuf.c"
+#define MT_COUNT    1000000
+
+/* Element used by the tests: a sequence number with some payload */
+typedef struct elem_t
+{
+    pj_uint32_t     seq;
+    pj_uint32_t     check;
+    pj_uint16_t     samples[4];
+} elem_t;
+
+static void fill_elem(elem_t *e, pj_uint32_t seq)
+{
+    unsigned i;
+
+    e->seq = seq;
+    e->check = ~seq;
+    for (i=0; i<PJ_ARRAY_SIZE(e->samples); ++i)
+        e->samples[i] = (pj_uint16_t)(seq + i);
+}
+
+static pj_bool_t check_elem(const elem_t *e, pj_uint32_t seq)
+{
+    unsigned i;
+
+    if (e->seq != seq || e->check != ~seq)
+        return PJ_FALSE;
+    for (i=0; i<PJ_ARRAY_SIZE(e->samples); ++i) {
+        if (e->samples[i] != (pj_uint16_t)(seq + i))
+            return PJ_FALSE;
+    }
+    return PJ_TRUE;
+}
+
+/* Single threaded: capacity, full/empty, partial and wrapped copies */
+static int basic_test(pj_pool_t *pool)
+{
+    pj_ringbuf_t *rb;
+    elem_t buf[16];
+    pj_uint32_t wseq = 0, rseq = 0;
+    unsigned i, j, n;
+
+    PJ_LOG(3,(THIS_FILE, "...basic_test()"));
+
+    if (pj_ringbuf_create(pool, sizeof(elem_t), 5, &rb) != PJ_SUCCESS)
+        return -10;
+
+    if (pj_ringbuf_get_capacity(rb) != 8 ||
+        pj_ringbuf_write_avail(rb) != 8 ||
+        pj_ringbuf_read_avail(rb) != 0)
+    {
+        PJ_LOG(3,(THIS_FILE, "....error: wrong initial state"));
+        return -20;
+    }
+
+    if (pj_ringbuf_read(rb, buf, 1) != 0 || pj_ringbuf_skip(rb, 1) != 0) {
+        PJ_LOG(3,(THIS_FILE, "....error: read from empty buffer"));
+        return -30;
+    }
+
+    /* Writing more than the capacity writes only what fits */
+    for (i=0; i<10; ++i)
+        fill_elem(&buf[i], wseq + i);
+    n = pj_ringbuf_write(rb, buf, 10);
+    if (n != 8 || pj_ringbuf_write_avail(rb) != 0 ||
+        pj_ringbuf_write(rb, buf, 1) != 0)
+    {
+        PJ_LOG(3,(THIS_FILE, "....error: overfilled buffer"));
+        return -40;
+    }
+    wseq += n;
+
+    /* Different batch sizes, so the copies wrap at every offset */
+    for (i=0; i<200; ++i) {
+        unsigned rcnt = 1 + i % 7;
+        unsigned wcnt = 1 + (i * 3) % 7;
+
+        if (i % 5 == 0) {
+            n = pj_ringbuf_skip(rb, 1);
+            rseq += n;
+        }
+
+        n = pj_ringbuf_read(rb, buf, rcnt);
+        for (j=0; j<n; ++j) {
+            if (!check_elem(&buf[j], rseq + j)) {
+                PJ_LOG(3,(THIS_FILE, "....error: wrong element %u",
+                          rseq + j));
+                return -50;
+            }
+        }
+        rseq += n;
+
+        for (j=0; j<wcnt; ++j)
+            fill_elem(&buf[j], wseq + j);
+        n = pj_ringbuf_write(rb, buf, wcnt);
+        wseq += n;
+
+        if (pj_ringbuf_read_avail(rb) != wseq - rseq ||
+            pj_ringbuf_write_avail(rb) != 8 - (wseq - rseq))
+        {
+            PJ_LOG(3,(THIS_FILE, "....error: wrong available count"));
+            return -60;
+        }
+    }
+
+    pj_ringbuf_destroy(rb);
+    return 0;
+}
+
+#if PJ_HAS_THREADS
+static pj_ringbuf_t *mt_rb;
+static int mt_result;
+
+static int mt_producer(void *arg)
+{
+    elem_t buf[8];
+    pj_uint32_t seq = 0;
+    unsigned i, cnt = 1;
+
+    PJ_UNUSED_ARG(arg);
+
+    while (seq < MT_COUNT) {
+        unsigned n;
+
+        cnt = (cnt % PJ_ARRAY_SIZE(buf)) + 1;
+        if (cnt > MT_COUNT - seq)
+            cnt = MT_COUNT - seq;
+
+        for (i=0; i<cnt; ++i)
+            fill_elem(&buf[i], seq + i);
+
+        /* Resend what was not written */
+        i = 0;
+        while (i < cnt) {
+            n = pj_ringbuf_write(mt_rb, &buf[i], cnt - i);
+            if (n == 0)
+                pj_thread_sleep(0);
+            i += n;
+        }
+        seq += cnt;
+    }
+
+    return 0;
+}
+
+static int mt_test(void)
+{
+    pj_pool_t *pool;
+    pj_thread_t *thread;
+    pj_timestamp t0, t1;
+    elem_t buf[5];
+    pj_uint32_t seq = 0;
+    pj_uint32_t elapsed;
+    unsigned i, n;
+
+    PJ_LOG(3,(THIS_FILE, "...mt_test()"));
+
+    pool = pj_pool_create(mem, NULL, 4000, 4000, NULL);
+    if (!pool)
+        return -200;
+
+    if (pj_ringbuf_create(pool, sizeof(elem_t), 64, &mt_rb) != PJ_SUCCESS) {
+        pj_pool_release(pool);
+        return -205;
+    }
+
+    mt_result = 0;
+    pj_get_timestamp(&t0);
+
+    if (pj_thread_create(pool, "rb_prod", &mt_producer, NULL, 0, 0,
+                         &thread) != PJ_SUCCESS)
+    {
+        pj_pool_release(pool);
+        return -210;
+    }
+
+    while (seq < MT_COUNT) {
+        n = pj_ringbuf_read(mt_rb, buf, PJ_ARRAY_SIZE(buf));
+        if (n == 0) {
+            pj_thread_sleep(0);
+            continue;
+        }
+        /* Keep draining after an error so the producer can finish */
+        for (i=0; i<n && mt_result==0; ++i) {
+            if (!check_elem(&buf[i], seq + i)) {
+                PJ_LOG(3,(THIS_FILE, "....error: wrong element %u",
+                          seq + i));
+                mt_result = -220;
+            }
+        }
+        seq += n;
+    }
+
+    pj_thread_join(thread);
+    pj_thread_destroy(thread);
+
+    pj_get_timestamp(&t1);
+    elapsed = pj_elapsed_msec(&t0, &t1);
+    if (mt_result == 0) {
+        PJ_LOG(3,(THIS_FILE, "....%u elements passed in %u msec",
+                  MT_COUNT, elapsed));
+    }
+
+    pj_ringbuf_destroy(mt_rb);
+    pj_pool_release(pool);
+    return mt_result;
+}
+#endif  /* PJ_HAS_THREADS */
+
+int ringbuf_test(void)
+{
+    pj_pool_t *pool;
+    int rc;
+
+    pool = pj_pool_create(mem, NULL, 4000, 4000, NULL);
+    if (!pool)
+        return -1;
+
+    rc = basic_test(pool);
+    pj_pool_release(pool);
+    if (rc != 0)
+        return rc;
+
+#if PJ_HAS_THREADS
+    rc = mt_test();
+#endif
+
+    return rc;
+}
+
+#else
+/* To prevent warning about "translation unit is empty"
+ * when this test is disabled.
+ */
+int dummy_ringbuf_test;
+#endif  /* INCLUDE_RINGBUF_TEST */
@@ -0,0 +1,325 @@
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include <pj/slab.h>
+#include <pj/log.h>
+#include <pj/os.h>
+#include <pj/string.h>
+#include "test.h"
+
+/**
+ * \page page_pjlib_slab_test Test: Slab Allocator
+ *
+ * This file provides implementation of \b slab_test(). It tests the
+ * fixed-size object allocator and the slab pool factory.
+ *
+ * This file is <b>pjlib-test/slab.c</b>
+ *
+ * \include pjlib-test/slab.c
+ */
+
+#if INCLUDE_SLAB_TEST
+
+#define THIS_FILE   "slab.c"
+#define OBJ_CNT     200
+#define MT_THREADS  4
+#define MT_LOOP     20000
+
+static const pj_size_t class_sizes[] = { 512, 24, 100, 24 };
+
+/* Get number of objects in use over all classes */
+static unsigned get_used(pj_slab_t *slab)
+{
+    pj_slab_stat stat;
+    unsigned i, used = 0;
+
+    pj_slab_get_stat(slab, &stat);
+    for (i=0; i<stat.class_cnt; ++i)
+        used += stat.cls[i].used_cnt;
+    return used;
+}
+
+/* Allocate objects of various sizes and check that they don't overlap */
+static int alloc_test(pj_slab_t *slab)
+{
+    pj_uint8_t *obj[OBJ_CNT];
+    pj_size_t size[OBJ_CNT];
+    pj_slab_stat stat;
+    unsigned i, j;
+
+    PJ_LOG(3,(THIS_FILE, "...alloc_test()"));
+
+    pj_slab_get_stat(slab, &stat);
+    if (stat.class_cnt != 3 ||
+        stat.cls[0].obj_size < 24 || stat.cls[0].obj_size >= 100 ||
+        stat.cls[1].obj_size < 100 || stat.cls[1].obj_size >= 512 ||
+        stat.cls[2].obj_size < 512)
+    {
+        PJ_LOG(3,(THIS_FILE, "....error: wrong size classes"));
+        return -10;
+    }
+
+    for (i=0; i<OBJ_CNT; ++i) {
+        size[i] = 1 + (i * 37) % 512;
+        obj[i] = (pj_uint8_t*) pj_slab_alloc(slab, size[i]);
+        if (!obj[i]) {
+            PJ_LOG(3,(THIS_FILE, "....error: unable to allocate %lu bytes",
+                      (unsigned long)size[i]));
+            return -20;
+        }
+        pj_memset(obj[i], i & 0xFF, size[i]);
+    }
+
+    if (get_used(slab) != OBJ_CNT) {
+        PJ_LOG(3,(THIS_FILE, "....error: wrong used count %u",
+                  get_used(slab)));
+        return -30;
+    }
+
+    for (i=0; i<OBJ_CNT; ++i) {
+        for (j=0; j<size[i]; ++j) {
+            if (obj[i][j] != (i & 0xFF)) {
+                PJ_LOG(3,(THIS_FILE, "....error: object %u is corrupted",
+                          i));
+                return -40;
+            }
+        }
+    }
+
+    /* Freed objects should be reused */
+    pj_slab_free(slab, obj[0], size[0]);
+    if (pj_slab_alloc(slab, size[0]) != obj[0]) {
+        PJ_LOG(3,(THIS_FILE, "....error: freed object is not reused"));
+        return -45;
+    }
+
+    for (i=0; i<OBJ_CNT; ++i)
+        pj_slab_free(slab, obj[i], size[i]);
+
+    if (get_used(slab) != 0) {
+        PJ_LOG(3,(THIS_FILE, "....error: objects still in use after free"));
+        return -50;
+    }
+
+    /* Oversize allocation must fail and be counted */
+    if (pj_slab_alloc(slab, 4096) != NULL) {
+        PJ_LOG(3,(THIS_FILE, "....error: oversize allocation succeeded"));
+        return -60;
+    }
+    pj_slab_get_stat(slab, &stat);
+    if (stat.oversize_cnt != 1) {
+        PJ_LOG(3,(THIS_FILE, "....error: oversize allocation not counted"));
+        return -70;
+    }
+
+    return 0;
+}
+
+/* Pools created by slab pool factory */
+static int pool_factory_test(pj_slab_t *slab)
+{
+    pj_slab_pool_factory spf;
+    pj_pool_t *pool;
+    unsigned i;
+
+    PJ_LOG(3,(THIS_FILE, "...pool_factory_test()"));
+
+    pj_slab_pool_factory_init(&spf, slab, mem);
+
+    pool = pj_pool_create(&spf.factory, "slabpool", 512, 512, NULL);
+    if (!pool)
+        return -100;
+
+    if (get_used(slab) != 1) {
+        PJ_LOG(3,(THIS_FILE, "....error: pool is not allocated from slab"));
+        pj_pool_release(pool);
+        return -110;
+    }
+
+    /* Expand the pool with slab sized blocks */
+    for (i=0; i<8; ++i)
+        pj_pool_alloc(pool, 256);
+
+    if (get_used(slab) < 4) {
+        PJ_LOG(3,(THIS_FILE, "....error: pool blocks not from slab"));
+        pj_pool_release(pool);
+        return -120;
+    }
+
+    /* Large allocation must fall back to the parent factory */
+    if (!pj_pool_alloc(pool, 2000)) {
+        pj_pool_release(pool);
+        return -130;
+    }
+
+    pj_pool_release(pool);
+
+    if (get_used(slab) != 0) {
+        PJ_LOG(3,(THIS_FILE, "....error: pool blocks not returned to slab"));
+        return -140;
+    }
+
+    return 0;
+}
+
+#if PJ_HAS_THREADS
+static pj_slab_t *mt_slab;
+static pj_mutex_t *mt_mutex;
+
+/* Objects are freed in a different order, and some by another thread
+ * than the one that allocated them.
+ */
+static void *mt_handoff[MT_THREADS];
+static int mt_result[MT_THREADS];
+
+static int mt_slab_thread(void *arg)
+{
+    unsigned id = (unsigned)(pj_ssize_t)arg;
+    void *obj[8];
+    unsigned i, j;
+
+    for (i=0; i<MT_LOOP; ++i) {
+        void *prev;
+
+        for (j=0; j<PJ_ARRAY_SIZE(obj); ++j) {
+            obj[j] = pj_slab_alloc(mt_slab, 24 + j * 60);
+            if (!obj[j]) {
+                mt_result[id] = -1;
+                return -1;
+            }
+            *(unsigned*)obj[j] = id;
+        }
+        for (j=0; j<PJ_ARRAY_SIZE(obj); ++j) {
+            if (*(unsigned*)obj[j] != id) {
+                mt_result[id] = -2;
+                return -2;
+            }
+        }
+
+        /* Hand over one object to the next thread */
+        pj_mutex_lock(mt_mutex);
+        prev = mt_handoff[(id+1) % MT_THREADS];
+        mt_handoff[(id+1) % MT_THREADS] = obj[0];
+        pj_mutex_unlock(mt_mutex);
+        if (prev)
+            pj_slab_free(mt_slab, prev, 24);
+
+        for (j=PJ_ARRAY_SIZE(obj)-1; j>0; --j)
+            pj_slab_free(mt_slab, obj[j], 24 + j * 60);
+    }
+
+    return 0;
+}
+
+static int mt_test(void)
+{
+    pj_pool_t *pool;
+    pj_thread_t *thread[MT_THREADS];
+    unsigned i;
+    int rc = 0;
+
+    PJ_LOG(3,(THIS_FILE, "...mt_test()"));
+
+    pool = pj_pool_create(mem, NULL, 4000, 4000, NULL);
+    if (!pool)
+        return -200;
+
+    if (pj_mutex_create_simple(pool, NULL, &mt_mutex) != PJ_SUCCESS ||
+        pj_slab_create(mem, "mtslab", PJ_ARRAY_SIZE(class_sizes),
+                       class_sizes, 16, &mt_slab) != PJ_SUCCESS)
+    {
+        pj_pool_release(pool);
+        return -205;
+    }
+
+    pj_bzero(mt_handoff, sizeof(mt_handoff));
+    pj_bzero(mt_result, sizeof(mt_result));
+    for (i=0; i<MT_THREADS; ++i) {
+        if (pj_thread_create(pool, "slab_mt", &mt_slab_thread,
+                             (void*)(pj_ssize_t)i, 0, 0,
+                             &thread[i]) != PJ_SUCCESS)
+        {
+            rc = -210;
+            break;
+        }
+    }
+
+    while (i > 0) {
+        --i;
+        pj_thread_join(thread[i]);
+        if (mt_result[i] != 0 && rc == 0) {
+            PJ_LOG(3,(THIS_FILE, "....error: thread returned %d",
+                      mt_result[i]));
+            rc = -220;
+        }
+        pj_thread_destroy(thread[i]);
+    }
+
+    for (i=0; i<MT_THREADS; ++i) {
+        if (mt_handoff[i])
+            pj_slab_free(mt_slab, mt_handoff[i], 24);
+    }
+
+    if (rc == 0 && get_used(mt_slab) != 0) {
+        PJ_LOG(3,(THIS_FILE, "....error: %u objects leaked",
+                  get_used(mt_slab)));
+        rc = -230;
+    }
+
+    if (rc == 0)
+        pj_slab_dump(mt_slab);
+
+    pj_slab_destroy(mt_slab);
+    pj_mutex_destroy(mt_mutex);
+    pj_pool_release(pool);
+    return rc;
+}
+#endif  /* PJ_HAS_THREADS */
+
+int slab_test(void)
+{
+    pj_slab_t *slab;
+    int rc;
+
+    if (pj_slab_create(mem, NULL, PJ_ARRAY_SIZE(class_sizes), class_sizes,
+                       16, &slab) != PJ_SUCCESS)
+    {
+        return -1;
+    }
+
+    rc = alloc_test(slab);
+    if (rc == 0)
+        rc = pool_factory_test(slab);
+
+    pj_slab_destroy(slab);
+    if (rc != 0)
+        return rc;
+
+#if PJ_HAS_THREADS
+    rc = mt_test();
+#endif
+
+    return rc;
+}
+
+#else
+/* To prevent warning about "translation unit is empty"
+ * when this test is disabled.
+ */
+int dummy_slab_test;
+#endif  /* INCLUDE_SLAB_TEST */
@@ -54,6 +54,7 @@
  *  - pj_sock_listen()
  *  - pj_sock_accept()
  *  - pj_gethostbyname()
+ *  - pj_getaddrinfo_async()
  *
  *
  * This file is <b>pjlib-test/sock.c</b>
@@ -725,6 +726,101 @@ on_error:
     return retval;
 }
 
+static int mmsg_test(void)
+{
+    enum { CNT = 5 };
+    pj_sock_t cs = PJ_INVALID_SOCKET, ss = PJ_INVALID_SOCKET;
+    pj_sockaddr_in dstaddr;
+    pj_sock_mmsg msgs[CNT];
+    char txbuf[CNT][16], rxbuf[CNT][16];
+    unsigned i, cnt, total;
+    int addr_len;
+    pj_str_t s;
+    pj_status_t rc;
+    int retval = 0;
+
+    PJ_LOG(3,("test", "...mmsg_test()"));
+
+    rc = pj_sock_socket(pj_AF_INET(), pj_SOCK_DGRAM(), 0, &ss);
+    if (rc != 0) {
+        app_perror("...error: unable to create socket", rc);
+        return -700;
+    }
+
+    rc = pj_sock_socket(pj_AF_INET(), pj_SOCK_DGRAM(), 0, &cs);
+    if (rc != 0) {
+        retval = -710; goto on_error;
+    }
+
+    pj_sockaddr_in_init(&dstaddr, pj_cstr(&s, ADDRESS), 0);
+    if ((rc=pj_sock_bind(ss, &dstaddr, sizeof(dstaddr))) != 0) {
+        app_perror("...bind error udp:"ADDRESS, rc);
+        retval = -720; goto on_error;
+    }
+    addr_len = sizeof(dstaddr);
+    pj_sock_getsockname(ss, &dstaddr, &addr_len);
+
+    /* Send all packets with one call */
+    for (i=0; i<CNT; ++i) {
+        pj_ansi_snprintf(txbuf[i], sizeof(txbuf[i]), "mmsg %u", i);
+        msgs[i].buf = txbuf[i];
+        msgs[i].size = pj_ansi_strlen(txbuf[i]) + 1;
+        pj_memcpy(&msgs[i].addr, &dstaddr, sizeof(dstaddr));
+        msgs[i].addr_len = sizeof(dstaddr);
+    }
+    cnt = CNT;
+    rc = pj_sock_sendmmsg(cs, msgs, &cnt, 0);
+    if (rc != PJ_SUCCESS) {
+        app_perror("...sendmmsg error", rc);
+        retval = -730; goto on_error;
+    }
+#if PJ_SOCK_HAS_MMSG
+    if (cnt != CNT) {
+        retval = -740; goto on_error;
+    }
+#endif
+    for (i=cnt; i<CNT; ++i) {
+        pj_ssize_t len = msgs[i].size;
+        rc = pj_sock_sendto(cs, msgs[i].buf, &len, 0, &dstaddr,
+                            sizeof(dstaddr));
+        if (rc != PJ_SUCCESS) {
+            retval = -750; goto on_error;
+        }
+    }
+
+    /* Receive them back, with as few calls as possible */
+    for (i=0; i<CNT; ++i) {
+        msgs[i].buf = rxbuf[i];
+        msgs[i].size = sizeof(rxbuf[i]);
+    }
+    for (total=0; total<CNT; total+=cnt) {
+        cnt = CNT - total;
+        rc = pj_sock_recvmmsg(ss, &msgs[total], &cnt, 0);
+        if (rc != PJ_SUCCESS || cnt == 0) {
+            app_perror("...recvmmsg error", rc);
+            retval = -760; goto on_error;
+        }
+    }
+
+    for (i=0; i<CNT; ++i) {
+        if (msgs[i].len != (pj_ssize_t)pj_ansi_strlen(txbuf[i]) + 1 ||
+            pj_ansi_strcmp(rxbuf[i], txbuf[i]) != 0 ||
+            msgs[i].addr.addr.sa_family != pj_AF_INET())
+        {
+            PJ_LOG(3,("test", "...error: packet %u mismatch", i));
+            retval = -770; goto on_error;
+        }
+    }
+
+on_error:
+    if (cs != PJ_INVALID_SOCKET)
+        pj_sock_close(cs);
+    if (ss != PJ_INVALID_SOCKET)
+        pj_sock_close(ss);
+
+    return retval;
+}
+
 static int tcp_test(void)
 {
     pj_sock_t cs, ss;
@@ -780,6 +876,151 @@ static int gethostbyname_test(void)
         return 0;
 }
 
+/* Result of pj_getaddrinfo_async() */
+static struct gai_result
+{
+    volatile unsigned   called;
+    pj_status_t         status;
+    unsigned            count;
+    pj_sockaddr         addr;
+} gai_res;
+
+static void gai_cb(void *user_data, pj_status_t status, unsigned count,
+                   const pj_addrinfo ai[])
+{
+    struct gai_result *res = (struct gai_result*)user_data;
+
+    res->status = status;
+    res->count = count;
+    if (count)
+        pj_sockaddr_cp(&res->addr, &ai[0].ai_addr);
+    ++res->called;
+}
+
+/* Keeps a resolver thread in the callback while gai_block is set */
+static volatile int gai_block;
+static volatile unsigned gai_blocked;
+
+static void gai_block_cb(void *user_data, pj_status_t status, unsigned count,
+                         const pj_addrinfo ai[])
+{
+    unsigned i;
+
+    PJ_UNUSED_ARG(user_data);
+    PJ_UNUSED_ARG(status);
+    PJ_UNUSED_ARG(count);
+    PJ_UNUSED_ARG(ai);
+
+    ++gai_blocked;
+    for (i=0; i<1000 && gai_block; ++i)
+        pj_thread_sleep(10);
+}
+
+static pj_status_t gai_wait(const pj_str_t *name, pj_getaddrinfo_query **q)
+{
+    pj_status_t status;
+    unsigned i;
+
+    pj_bzero(&gai_res, sizeof(gai_res));
+    status = pj_getaddrinfo_async(pj_AF_INET(), name, 4, &gai_res, &gai_cb,
+                                  q);
+    if (status != PJ_SUCCESS)
+        return status;
+
+    for (i=0; i<1000 && !gai_res.called; ++i)
+        pj_thread_sleep(10);
+
+    return gai_res.called == 1 ? PJ_SUCCESS : PJ_ETIMEDOUT;
+}
+
+static int getaddrinfo_async_test(void)
+{
+    pj_str_t name;
+    pj_getaddrinfo_query *q;
+    pj_status_t status;
+    unsigned i;
+
+    PJ_LOG(3,("test", "...getaddrinfo_async_test()"));
+
+    /* An IP address is resolved before the function returns */
+    name = pj_str("127.0.0.1");
+    pj_bzero(&gai_res, sizeof(gai_res));
+    status = pj_getaddrinfo_async(pj_AF_INET(), &name, 4, &gai_res, &gai_cb,
+                                  &q);
+    if (status != PJ_SUCCESS || q != NULL || gai_res.called != 1 ||
+        gai_res.status != PJ_SUCCESS || gai_res.count != 1 ||
+        gai_res.addr.ipv4.sin_addr.s_addr != pj_htonl(0x7F000001))
+    {
+        return -21010;
+    }
+
+    /* The local host name is resolved by the resolver thread, then taken
+     * from the cache.
+     */
+    status = gai_wait(pj_gethostname(), &q);
+    if (status != PJ_SUCCESS)
+        return -21020;
+    if (gai_res.status == PJ_SUCCESS) {
+        pj_sockaddr addr;
+
+        pj_sockaddr_cp(&addr, &gai_res.addr);
+        pj_bzero(&gai_res, sizeof(gai_res));
+        status = pj_getaddrinfo_async(pj_AF_INET(), pj_gethostname(), 4,
+                                      &gai_res, &gai_cb, &q);
+        if (status != PJ_SUCCESS || q != NULL || gai_res.called != 1 ||
+            pj_sockaddr_cmp(&addr, &gai_res.addr) != 0)
+        {
+            return -21030;
+        }
+    }
+
+    /* Invalid host */
+    name = pj_str("an-invalid-host-name");
+    status = gai_wait(&name, &q);
+    if (status != PJ_SUCCESS || gai_res.status == PJ_SUCCESS ||
+        gai_res.count != 0)
+    {
+        return -21040;
+    }
+
+    /* A cancelled query does not call the callback. The resolver threads
+     * are kept busy so that the query is still queued when cancelled.
+     */
+    gai_block = 1;
+    gai_blocked = 0;
+    for (i=0; i<PJ_GETADDRINFO_ASYNC_THREAD_CNT; ++i) {
+        char buf[32];
+
+        pj_ansi_snprintf(buf, sizeof(buf), "blocker-%u-invalid-host", i);
+        name = pj_str(buf);
+        status = pj_getaddrinfo_async(pj_AF_INET(), &name, 4, NULL,
+                                      &gai_block_cb, NULL);
+        if (status != PJ_SUCCESS)
+            return -21050;
+    }
+    for (i=0; i<1000 && gai_blocked != PJ_GETADDRINFO_ASYNC_THREAD_CNT; ++i)
+        pj_thread_sleep(10);
+
+    name = pj_str("another-invalid-host-name");
+    pj_bzero(&gai_res, sizeof(gai_res));
+    status = pj_getaddrinfo_async(pj_AF_INET(), &name, 4, &gai_res, &gai_cb,
+                                  &q);
+    if (status != PJ_SUCCESS || q == NULL) {
+        gai_block = 0;
+        return -21060;
+    }
+    status = pj_getaddrinfo_cancel(q);
+    gai_block = 0;
+    if (status != PJ_SUCCESS)
+        return -21070;
+
+    pj_thread_sleep(100);
+    if (gai_res.called)
+        return -21080;
+
+    return 0;
+}
+
 #if 0
 #include "../pj/os_symbian.h"
 static int connect_test()
@@ -975,6 +1216,10 @@ int sock_test()
     if (rc != 0)
         return rc;
 
+    rc = getaddrinfo_async_test();
+    if (rc != 0)
+        return rc;
+
     rc = simple_sock_test();
     if (rc != 0)
         return rc;
@@ -987,6 +1232,10 @@ int sock_test()
     if (rc != 0)
         return rc;
 
+    rc = mmsg_test();
+    if (rc != 0)
+        return rc;
+
     rc = tcp_test();
     if (rc != 0)
         return rc;
@@ -848,6 +848,447 @@ on_return:
 }
 
 
+#if (PJ_SSL_SOCK_IMP == PJ_SSL_SOCK_IMP_OPENSSL)
+/* Connect two clients in sequence to the same listener, the second client
+ * should resume the session of the first one. With "identity", a client
+ * without our certificate connects in between, and must not resume the
+ * session of the first client.
+ */
+static int session_reuse_test(pj_ssl_sock_proto proto, pj_bool_t tickets,
+                              pj_bool_t offload, pj_bool_t identity)
+{
+    pj_pool_t *pool = NULL;
+    pj_ioqueue_t *ioqueue = NULL;
+    pj_timer_heap_t *timer = NULL;
+    pj_ssl_sock_t *ssock_serv = NULL;
+    pj_ssl_sock_param param;
+    struct test_state state_serv = { 0 };
+    pj_ssl_sock_handshake_stat stat;
+    pj_sockaddr addr, listen_addr;
+    pj_ssl_cert_t *cert = NULL, *ca_cert = NULL;
+    pj_str_t tmp_st;
+    unsigned i, cli_cnt = identity ? 3 : 2;
+    pj_status_t status;
+
+    pool = pj_pool_create(mem, "ssl_reuse", 256, 256, NULL);
+
+    /* Closed keys are only reused after a delay */
+    status = pj_ioqueue_create(pool, 16, &ioqueue);
+    if (status != PJ_SUCCESS)
+        goto on_return;
+
+    status = pj_timer_heap_create(pool, 4, &timer);
+    if (status != PJ_SUCCESS)
+        goto on_return;
+
+    pj_ssl_sock_param_default(&param);
+    param.cb.on_accept_complete2 = &ssl_on_accept_complete;
+    param.cb.on_connect_complete = &ssl_on_connect_complete;
+    param.cb.on_data_read = &ssl_on_data_read;
+    param.cb.on_data_sent = &ssl_on_data_sent;
+    param.ioqueue = ioqueue;
+    param.timer_heap = timer;
+    param.proto = proto;
+    param.enable_session_tickets = tickets;
+    param.handshake_offload = offload;
+
+    pj_sockaddr_init(PJ_AF_INET, &addr, pj_strset2(&tmp_st, "127.0.0.1"), 0);
+
+    /* === SERVER === */
+    param.user_data = &state_serv;
+    state_serv.pool = pool;
+    state_serv.echo = PJ_TRUE;
+    state_serv.is_server = PJ_TRUE;
+
+    /* Handshake offload needs group lock */
+    if (offload) {
+        status = pj_grp_lock_create(pool, NULL, &param.grp_lock);
+        if (status != PJ_SUCCESS)
+            goto on_return;
+    }
+
+    status = pj_ssl_sock_create(pool, &param, &ssock_serv);
+    if (status != PJ_SUCCESS)
+        goto on_return;
+
+    {
+        pj_str_t ca_file = pj_str(CERT_CA_FILE);
+        pj_str_t cert_file = pj_str(CERT_FILE);
+        pj_str_t privkey_file = pj_str(CERT_PRIVKEY_FILE);
+        pj_str_t privkey_pass = pj_str(CERT_PRIVKEY_PASS);
+
+        status = pj_ssl_cert_load_from_files(pool, &ca_file, &cert_file, 
+                                             &privkey_file, &privkey_pass,
+                                             &cert);
+        if (status != PJ_SUCCESS)
+            goto on_return;
+
+        status = pj_ssl_sock_set_certificate(ssock_serv, pool, cert);
+        if (status != PJ_SUCCESS)
+            goto on_return;
+
+        /* Same CA, but without client certificate */
+        tmp_st.slen = 0;
+        status = pj_ssl_cert_load_from_files(pool, &ca_file, &tmp_st,
+                                             &tmp_st, &tmp_st, &ca_cert);
+        if (status != PJ_SUCCESS)
+            goto on_return;
+    }
+
+    status = pj_ssl_sock_start_accept(ssock_serv, pool, &addr,
+                                      pj_sockaddr_get_len(&addr));
+    if (status != PJ_SUCCESS)
+        goto on_return;
+
+    {
+        pj_ssl_sock_info info;
+
+        pj_ssl_sock_get_info(ssock_serv, &info);
+        pj_sockaddr_cp(&listen_addr, &info.local_addr);
+    }
+
+    pj_ssl_sock_reset_handshake_stat();
+
+    /* === CLIENTS === */
+    for (i = 0; i < cli_cnt; ++i) {
+        struct test_state state_cli = { 0 };
+        pj_ssl_sock_t *ssock_cli = NULL;
+
+        param.user_data = &state_cli;
+        state_cli.pool = pool;
+        state_cli.check_echo = PJ_TRUE;
+        state_cli.send_str = "session reuse test";
+        state_cli.send_str_len = pj_ansi_strlen(state_cli.send_str);
+
+        if (offload) {
+            status = pj_grp_lock_create(pool, NULL, &param.grp_lock);
+            if (status != PJ_SUCCESS)
+                goto on_return;
+        }
+
+        status = pj_ssl_sock_create(pool, &param, &ssock_cli);
+        if (status != PJ_SUCCESS)
+            goto on_return;
+
+        status = pj_ssl_sock_set_certificate(ssock_cli, pool,
+                                             (identity && i == 1)?
+                                             ca_cert : cert);
+        if (status != PJ_SUCCESS) {
+            pj_ssl_sock_close(ssock_cli);
+            goto on_return;
+        }
+
+        status = pj_ssl_sock_start_connect(ssock_cli, pool, &addr,
+                                           &listen_addr,
+                                           pj_sockaddr_get_len(&addr));
+        if (status == PJ_SUCCESS) {
+            ssl_on_connect_complete(ssock_cli, PJ_SUCCESS);
+        } else if (status != PJ_EPENDING) {
+            pj_ssl_sock_close(ssock_cli);
+            goto on_return;
+        }
+
+        /* Handshake offload completes the handshake from the timer */
+        while (!state_cli.err && !state_cli.done) {
+            pj_time_val delay = {0, 10};
+            pj_ioqueue_poll(ioqueue, &delay);
+            pj_timer_heap_poll(timer, NULL);
+        }
+
+        {
+            pj_time_val delay = {0, 100};
+            while (pj_ioqueue_poll(ioqueue, &delay) > 0 ||
+                   pj_timer_heap_poll(timer, NULL) > 0);
+        }
+
+        if (state_cli.err) {
+            status = state_cli.err;
+            goto on_return;
+        }
+    }
+
+    /* Both sides of the first connection do a full handshake, both sides
+     * of the last one resume the session. The connection of the client
+     * with other identity is a full one.
+     */
+    pj_ssl_sock_get_handshake_stat(&stat);
+    PJ_LOG(3, ("", "...Handshakes: full=%u (avg %u ms), resumed=%u "
+               "(avg %u ms), failed=%u",
+               stat.full_cnt, stat.full_avg_msec, stat.resumed_cnt,
+               stat.resumed_avg_msec, stat.failed_cnt));
+    status = (stat.full_cnt == (identity? 4 : 2) && stat.resumed_cnt == 2 &&
+              stat.failed_cnt == 0)? PJ_SUCCESS : PJ_EBUG;
+
+on_return:
+    if (ssock_serv)
+        pj_ssl_sock_close(ssock_serv);
+    if (ioqueue)
+        pj_ioqueue_destroy(ioqueue);
+    if (timer)
+        pj_timer_heap_destroy(timer);
+    if (pool)
+        pj_pool_release(pool);
+
+    return status;
+}
+
+/* State of the UDP socket which is serviced during the handshakes */
+struct udp_state
+{
+    unsigned        rx_cnt;         /* packets received                     */
+    unsigned        rx_during_hs;   /* ... while handshakes were pending    */
+    unsigned        hs_cnt;         /* number of full handshakes expected   */
+    pj_timestamp    tx_ts;          /* time the last packet was sent        */
+    pj_uint32_t     max_msec;       /* max latency of the packets           */
+};
+
+static pj_bool_t udp_on_data_recvfrom(pj_activesock_t *asock,
+                                      void *data,
+                                      pj_size_t size,
+                                      const pj_sockaddr_t *src_addr,
+                                      int addr_len,
+                                      pj_status_t status)
+{
+    struct udp_state *st = (struct udp_state*)
+                           pj_activesock_get_user_data(asock);
+    pj_ssl_sock_handshake_stat stat;
+    pj_timestamp now;
+    pj_uint32_t msec;
+
+    PJ_UNUSED_ARG(data);
+    PJ_UNUSED_ARG(src_addr);
+    PJ_UNUSED_ARG(addr_len);
+
+    if (status != PJ_SUCCESS || size == 0)
+        return PJ_TRUE;
+
+    pj_get_timestamp(&now);
+    msec = pj_elapsed_msec(&st->tx_ts, &now);
+    if (msec > st->max_msec)
+        st->max_msec = msec;
+
+    pj_ssl_sock_get_handshake_stat(&stat);
+    if (stat.full_cnt < st->hs_cnt)
+        ++st->rx_during_hs;
+    ++st->rx_cnt;
+
+    return PJ_TRUE;
+}
+
+/* Run many handshakes on the worker threads, while the ioqueue keeps
+ * servicing the packets of another socket.
+ */
+static int handshake_offload_io_test(void)
+{
+    enum { CLI_CNT = 16 };
+    pj_pool_t *pool = NULL;
+    pj_ioqueue_t *ioqueue = NULL;
+    pj_timer_heap_t *timer = NULL;
+    pj_ssl_sock_t *ssock_serv = NULL;
+    pj_activesock_t *asock = NULL;
+    pj_sock_t usock = PJ_INVALID_SOCKET;
+    pj_activesock_cb asock_cb;
+    pj_ssl_sock_param param;
+    struct test_state state_serv = { 0 };
+    struct test_state *state_cli;
+    struct udp_state udp_st = { 0 };
+    pj_ssl_sock_handshake_stat stat;
+    pj_sockaddr addr, listen_addr, udp_addr;
+    pj_ssl_cert_t *cert = NULL;
+    pj_time_val timeout, now;
+    pj_str_t tmp_st;
+    unsigned i, tx_cnt = 0;
+    pj_status_t status;
+
+    pool = pj_pool_create(mem, "ssl_hs_io", 256, 256, NULL);
+    state_cli = (struct test_state*)
+                pj_pool_calloc(pool, CLI_CNT, sizeof(struct test_state));
+
+    status = pj_ioqueue_create(pool, CLI_CNT * 2 + 4, &ioqueue);
+    if (status != PJ_SUCCESS)
+        goto on_return;
+
+    status = pj_timer_heap_create(pool, CLI_CNT * 4 + 4, &timer);
+    if (status != PJ_SUCCESS)
+        goto on_return;
+
+    pj_sockaddr_init(PJ_AF_INET, &addr, pj_strset2(&tmp_st, "127.0.0.1"), 0);
+
+    /* The UDP socket and its peer */
+    pj_bzero(&asock_cb, sizeof(asock_cb));
+    asock_cb.on_data_recvfrom = &udp_on_data_recvfrom;
+    status = pj_activesock_create_udp(pool, &addr, NULL, ioqueue, &asock_cb,
+                                      &udp_st, &asock, &udp_addr);
+    if (status != PJ_SUCCESS)
+        goto on_return;
+
+    status = pj_activesock_start_recvfrom(asock, pool, 64, 0);
+    if (status != PJ_SUCCESS)
+        goto on_return;
+
+    status = pj_sock_socket(pj_AF_INET(), pj_SOCK_DGRAM(), 0, &usock);
+    if (status != PJ_SUCCESS)
+        goto on_return;
+
+    pj_ssl_sock_param_default(&param);
+    param.cb.on_accept_complete2 = &ssl_on_accept_complete;
+    param.cb.on_connect_complete = &ssl_on_connect_complete;
+    param.cb.on_data_read = &ssl_on_data_read;
+    param.cb.on_data_sent = &ssl_on_data_sent;
+    param.ioqueue = ioqueue;
+    param.timer_heap = timer;
+    param.proto = PJ_SSL_SOCK_PROTO_TLS1_2;
+    param.handshake_offload = PJ_TRUE;
+
+    /* === SERVER === */
+    param.user_data = &state_serv;
+    state_serv.pool = pool;
+    state_serv.echo = PJ_TRUE;
+    state_serv.is_server = PJ_TRUE;
+
+    status = pj_grp_lock_create(pool, NULL, &param.grp_lock);
+    if (status != PJ_SUCCESS)
+        goto on_return;
+
+    status = pj_ssl_sock_create(pool, &param, &ssock_serv);
+    if (status != PJ_SUCCESS)
+        goto on_return;
+
+    {
+        pj_str_t ca_file = pj_str(CERT_CA_FILE);
+        pj_str_t cert_file = pj_str(CERT_FILE);
+        pj_str_t privkey_file = pj_str(CERT_PRIVKEY_FILE);
+        pj_str_t privkey_pass = pj_str(CERT_PRIVKEY_PASS);
+
+        status = pj_ssl_cert_load_from_files(pool, &ca_file, &cert_file,
+                                             &privkey_file, &privkey_pass,
+                                             &cert);
+        if (status != PJ_SUCCESS)
+            goto on_return;
+
+        status = pj_ssl_sock_set_certificate(ssock_serv, pool, cert);
+        if (status != PJ_SUCCESS)
+            goto on_return;
+    }
+
+    status = pj_ssl_sock_start_accept(ssock_serv, pool, &addr,
+                                      pj_sockaddr_get_len(&addr));
+    if (status != PJ_SUCCESS)
+        goto on_return;
+
+    {
+        pj_ssl_sock_info info;
+
+        pj_ssl_sock_get_info(ssock_serv, &info);
+        pj_sockaddr_cp(&listen_addr, &info.local_addr);
+    }
+
+    pj_ssl_sock_reset_handshake_stat();
+    udp_st.hs_cnt = CLI_CNT * 2;
+
+    /* === CLIENTS === */
+    clients_num = CLI_CNT;
+    for (i = 0; i < CLI_CNT; ++i) {
+        pj_ssl_sock_t *ssock_cli = NULL;
+
+        param.user_data = &state_cli[i];
+        state_cli[i].pool = pool;
+        state_cli[i].check_echo = PJ_TRUE;
+        state_cli[i].send_str = "handshake offload test";
+        state_cli[i].send_str_len = pj_ansi_strlen(state_cli[i].send_str);
+
+        status = pj_grp_lock_create(pool, NULL, &param.grp_lock);
+        if (status != PJ_SUCCESS)
+            goto on_return;
+
+        status = pj_ssl_sock_create(pool, &param, &ssock_cli);
+        if (status != PJ_SUCCESS)
+            goto on_return;
+
+        status = pj_ssl_sock_start_connect(ssock_cli, pool, &addr,
+                                           &listen_addr,
+                                           pj_sockaddr_get_len(&addr));
+        if (status == PJ_SUCCESS) {
+            ssl_on_connect_complete(ssock_cli, PJ_SUCCESS);
+        } else if (status != PJ_EPENDING) {
+            pj_ssl_sock_close(ssock_cli);
+            goto on_return;
+        }
+    }
+
+    /* Send a packet on the UDP socket after each one is received, until
+     * all the handshakes are done.
+     */
+    pj_gettickcount(&timeout);
+    timeout.sec += 30;
+    status = PJ_SUCCESS;
+    while (clients_num > 0 && status == PJ_SUCCESS) {
+        pj_time_val delay = {0, 10};
+
+        if (udp_st.rx_cnt == tx_cnt) {
+            pj_ssize_t len = 4;
+
+            pj_get_timestamp(&udp_st.tx_ts);
+            status = pj_sock_sendto(usock, "ping", &len, 0, &udp_addr,
+                                    pj_sockaddr_get_len(&udp_addr));
+            ++tx_cnt;
+        }
+
+        pj_ioqueue_poll(ioqueue, &delay);
+        pj_timer_heap_poll(timer, NULL);
+
+        for (i = 0; i < CLI_CNT; ++i) {
+            if (state_cli[i].err != PJ_SUCCESS)
+                status = state_cli[i].err;
+        }
+
+        pj_gettickcount(&now);
+        if (PJ_TIME_VAL_GT(now, timeout))
+            status = PJ_ETIMEDOUT;
+    }
+
+    {
+        pj_time_val delay = {0, 100};
+        while (pj_ioqueue_poll(ioqueue, &delay) > 0 ||
+               pj_timer_heap_poll(timer, NULL) > 0);
+    }
+
+    if (status != PJ_SUCCESS)
+        goto on_return;
+
+    pj_ssl_sock_get_handshake_stat(&stat);
+    PJ_LOG(3, ("", "...Handshakes: full=%u (avg %u ms), failed=%u, "
+               "UDP packets: %u (%u during the handshakes, max %u ms)",
+               stat.full_cnt, stat.full_avg_msec, stat.failed_cnt,
+               udp_st.rx_cnt, udp_st.rx_during_hs, udp_st.max_msec));
+
+    if (stat.full_cnt != CLI_CNT * 2 || stat.failed_cnt != 0) {
+        status = PJ_EBUG;
+    } else if (udp_st.rx_during_hs == 0) {
+        PJ_LOG(3, ("", "...ERROR: UDP socket not serviced during the "
+                   "handshakes"));
+        status = PJ_EBUG;
+    }
+
+on_return:
+    if (ssock_serv)
+        pj_ssl_sock_close(ssock_serv);
+    if (asock)
+        pj_activesock_close(asock);
+    if (usock != PJ_INVALID_SOCKET)
+        pj_sock_close(usock);
+    if (ioqueue)
+        pj_ioqueue_destroy(ioqueue);
+    if (timer)
+        pj_timer_heap_destroy(timer);
+    if (pool)
+        pj_pool_release(pool);
+
+    return status;
+}
+#endif
+
+
 static pj_bool_t asock_on_data_read(pj_activesock_t *asock,
                                     void *data,
                                     pj_size_t size,
@@ -1710,6 +2151,55 @@ int ssl_sock_test(void)
         return ret;
 #endif
 
+#if (PJ_SSL_SOCK_IMP == PJ_SSL_SOCK_IMP_OPENSSL)
+    PJ_LOG(3,("", "..session reuse test w/ TLSv1.2 and session ID"));
+    ret = session_reuse_test(PJ_SSL_SOCK_PROTO_TLS1_2, PJ_FALSE, PJ_FALSE,
+                             PJ_FALSE);
+    if (ret != 0)
+        return ret;
+
+    PJ_LOG(3,("", "..session reuse test w/ TLSv1.2 and session ticket"));
+    ret = session_reuse_test(PJ_SSL_SOCK_PROTO_TLS1_2, PJ_TRUE, PJ_FALSE,
+                             PJ_FALSE);
+    if (ret != 0)
+        return ret;
+
+    PJ_LOG(3,("", "..session reuse test w/ TLSv1.3 and PSK"));
+    ret = session_reuse_test(PJ_SSL_SOCK_PROTO_TLS1_3, PJ_TRUE, PJ_FALSE,
+                             PJ_FALSE);
+    if (ret != 0)
+        return ret;
+
+    PJ_LOG(3,("", "..session reuse test w/ TLSv1.2 and handshake offload"));
+    ret = session_reuse_test(PJ_SSL_SOCK_PROTO_TLS1_2, PJ_FALSE, PJ_TRUE,
+                             PJ_FALSE);
+    if (ret != 0)
+        return ret;
+
+    PJ_LOG(3,("", "..session reuse test w/ TLSv1.3 and handshake offload"));
+    ret = session_reuse_test(PJ_SSL_SOCK_PROTO_TLS1_3, PJ_TRUE, PJ_TRUE,
+                             PJ_FALSE);
+    if (ret != 0)
+        return ret;
+
+    PJ_LOG(3,("", "..handshake offload test w/ I/O of other socket"));
+    ret = handshake_offload_io_test();
+    if (ret != 0)
+        return ret;
+
+    PJ_LOG(3,("", "..session reuse test w/ TLSv1.2 and other identity"));
+    ret = session_reuse_test(PJ_SSL_SOCK_PROTO_TLS1_2, PJ_FALSE, PJ_FALSE,
+                             PJ_TRUE);
+    if (ret != 0)
+        return ret;
+
+    PJ_LOG(3,("", "..session reuse test w/ TLSv1.3 and other identity"));
+    ret = session_reuse_test(PJ_SSL_SOCK_PROTO_TLS1_3, PJ_TRUE, PJ_FALSE,
+                             PJ_TRUE);
+    if (ret != 0)
+        return ret;
+#endif
+
 #if WITH_BENCHMARK
     PJ_LOG(3,("", "..performance test"));
     ret = perf_test(PJ_IOQUEUE_MAX_HANDLES/2 - 1, 0);
@@ -22,6 +22,8 @@
 #include <pj/pool.h>
 #include <pj/log.h>
 #include <pj/os.h>
+#include <pj/ctype.h>
+#include <pj/rand.h>
 #include "test.h"
 
 #define THIS_FILE       "string.c"
@@ -624,6 +626,209 @@ static int strxcat_test(void)
     return 0;
 }
 
+/* Reference implementations, as the string functions used to be */
+static int ref_stricmp(const pj_str_t *str1, const pj_str_t *str2)
+{
+    pj_size_t min = (str1->slen < str2->slen)? str1->slen : str2->slen;
+    int res;
+
+    if (str1->slen <= 0)
+        return str2->slen<=0 ? 0 : -1;
+    else if (str2->slen <= 0)
+        return 1;
+
+    res = pj_ansi_strnicmp(str1->ptr, str2->ptr, min);
+    if (res != 0)
+        return res;
+    return (str1->slen < str2->slen) ? -1 :
+            (str1->slen == str2->slen ? 0 : 1);
+}
+
+static char *ref_strstr(const pj_str_t *str, const pj_str_t *substr,
+                        pj_bool_t icase)
+{
+    const char *s, *ends;
+
+    if (str->slen <= 0)
+        return NULL;
+    if (substr->slen <= 0)
+        return (char*)str->ptr;
+
+    s = str->ptr;
+    ends = str->ptr + str->slen - substr->slen;
+    for (; s<=ends; ++s) {
+        if (icase && pj_ansi_strnicmp(s, substr->ptr, substr->slen)==0)
+            return (char*)s;
+        if (!icase && pj_ansi_strncmp(s, substr->ptr, substr->slen)==0)
+            return (char*)s;
+    }
+    return NULL;
+}
+
+/* Randomize the case of some letters, and sometimes change a character
+ * or insert a NUL.
+ */
+static void mutate(char *dst, const char *src, pj_size_t len)
+{
+    static const char others[] = "aZ.\x80\xC1\xE1@[`{";
+    pj_size_t i;
+
+    for (i=0; i<len; ++i) {
+        char c = src[i];
+        if (pj_isalpha(c) && (pj_rand() & 1))
+            c = (char)(pj_isupper(c) ? pj_tolower(c) : pj_toupper(c));
+        dst[i] = c;
+    }
+    if (len && (pj_rand() % 4) == 0)
+        dst[pj_rand() % len] = others[pj_rand() % (sizeof(others)-1)];
+    if (len && (pj_rand() % 8) == 0)
+        dst[pj_rand() % len] = '\0';
+}
+
+/* Compare the vectorized pj_stricmp(), pj_strstr() and pj_stristr() with
+ * the scalar reference on random strings of all lengths and alignments.
+ */
+static int simd_test(void)
+{
+    enum { MAX_LEN = 100, ROUND = 20 };
+    static const char chars[] = "abcdefghijklmnopqrstuvwxyz"
+                                "ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789"
+                                ";=.-_~\x80\xC1\xE1@[`{";
+    char buf1[MAX_LEN+16], buf2[MAX_LEN+16];
+    unsigned len, off, round, i;
+
+    for (len=0; len<=MAX_LEN; ++len) {
+        for (round=0; round<ROUND; ++round) {
+            pj_str_t s1, s2, sub;
+            char *r1, *r2;
+            int cmp1, cmp2;
+
+            off = round % 16;
+            for (i=0; i<len; ++i)
+                buf1[off+i] = chars[pj_rand() % (sizeof(chars)-1)];
+            mutate(buf2, buf1+off, len);
+
+            s1.ptr = buf1+off;
+            s1.slen = len;
+            s2.ptr = buf2;
+            s2.slen = len - (round==0 && len ? 1 : 0);
+
+            cmp1 = pj_stricmp(&s1, &s2);
+            cmp2 = ref_stricmp(&s1, &s2);
+            if ((cmp1 < 0) != (cmp2 < 0) || (cmp1 > 0) != (cmp2 > 0)) {
+                PJ_LOG(3,(THIS_FILE, "...error: pj_stricmp() returns %d, "
+                          "expecting %d (len=%u)", cmp1, cmp2, len));
+                return -800;
+            }
+
+            /* Substring taken from a mutated copy of the string */
+            if (len) {
+                pj_size_t start = pj_rand() % len;
+                sub.ptr = buf2 + start;
+                sub.slen = 1 + pj_rand() % (len - start);
+            } else {
+                sub.ptr = buf2;
+                sub.slen = 0;
+            }
+
+            r1 = pj_strstr(&s1, &sub);
+            r2 = ref_strstr(&s1, &sub, PJ_FALSE);
+            if (r1 != r2) {
+                PJ_LOG(3,(THIS_FILE, "...error: pj_strstr() mismatch "
+                          "(len=%u)", len));
+                return -810;
+            }
+
+            r1 = pj_stristr(&s1, &sub);
+            r2 = ref_strstr(&s1, &sub, PJ_TRUE);
+            if (r1 != r2) {
+                PJ_LOG(3,(THIS_FILE, "...error: pj_stristr() mismatch "
+                          "(len=%u)", len));
+                return -820;
+            }
+        }
+    }
+
+    return 0;
+}
+
+/* Benchmark caseless comparison and substring search on SIP header
+ * values, against the scalar reference.
+ */
+static int string_perf_test(void)
+{
+    enum { LOOP = 20000 };
+    static char *hdr[] =
+    {
+        "SIP/2.0/UDP 192.168.100.25:5060;rport;branch=z9hG4bKPj8f3a2c6e"
+            "-7d41-4b2e-9c55-1f0e6a3d2b71",
+        "<sip:alice.smith@atlanta.example.com:5060;transport=tcp>"
+            ";tag=9fxced76sl",
+        "a84b4c76e66710@pc33.atlanta.example.com",
+        "application/sdp",
+        "INVITE, ACK, CANCEL, BYE, OPTIONS, REGISTER, SUBSCRIBE, NOTIFY, "
+            "REFER, MESSAGE, INFO, PRACK, UPDATE",
+    };
+    static char *needle[] =
+    {
+        "branch=z9hG4bK", "transport=tcp", "@pc33", "sdp", "update"
+    };
+    pj_str_t s1_buf[PJ_ARRAY_SIZE(hdr)], s2[PJ_ARRAY_SIZE(hdr)];
+    pj_str_t sub[PJ_ARRAY_SIZE(hdr)];
+    /* Volatile, so that the compiler can't move the calls out of the loop */
+    pj_str_t * volatile s1 = s1_buf;
+    char copy[PJ_ARRAY_SIZE(hdr)][160];
+    pj_timestamp t0, t1;
+    pj_uint32_t elapsed[6];
+    volatile int sink = 0;
+    unsigned i, j, k, bytes = 0;
+
+    for (i=0; i<PJ_ARRAY_SIZE(hdr); ++i) {
+        s1[i] = pj_str(hdr[i]);
+        pj_ansi_strxcpy(copy[i], hdr[i], sizeof(copy[i]));
+        for (j=0; j<s1[i].slen; ++j)
+            copy[i][j] = (char)pj_toupper(copy[i][j]);
+        s2[i] = pj_str(copy[i]);
+        sub[i] = pj_str(needle[i]);
+        bytes += (unsigned)s1[i].slen;
+    }
+
+    for (k=0; k<6; ++k) {
+        pj_get_timestamp(&t0);
+        for (j=0; j<LOOP; ++j) {
+            for (i=0; i<PJ_ARRAY_SIZE(hdr); ++i) {
+                switch (k) {
+                case 0: sink += ref_stricmp(&s1[i], &s2[i]); break;
+                case 1: sink += pj_stricmp(&s1[i], &s2[i]); break;
+                case 2: sink += (ref_strstr(&s1[i], &sub[i], 0) != NULL);
+                        break;
+                case 3: sink += (pj_strstr(&s1[i], &sub[i]) != NULL); break;
+                case 4: sink += (ref_strstr(&s1[i], &sub[i], 1) != NULL);
+                        break;
+                case 5: sink += (pj_stristr(&s1[i], &sub[i]) != NULL); break;
+                }
+            }
+        }
+        pj_get_timestamp(&t1);
+        elapsed[k] = pj_elapsed_usec(&t0, &t1);
+        if (elapsed[k] == 0)
+            elapsed[k] = 1;
+    }
+
+    PJ_UNUSED_ARG(sink);
+
+    PJ_LOG(3,(THIS_FILE, "  SIP header strings throughput (MB/s): "));
+    for (k=0; k<6; k+=2) {
+        static const char *name[] = { "stricmp", "strstr ", "stristr" };
+        PJ_LOG(3,(THIS_FILE, "    %s: scalar=%5u  pjlib=%5u",
+                  name[k/2],
+                  (unsigned)((pj_uint64_t)bytes * LOOP / elapsed[k]),
+                  (unsigned)((pj_uint64_t)bytes * LOOP / elapsed[k+1])));
+    }
+
+    return 0;
+}
+
 int string_test(void)
 {
     const pj_str_t hello_world = { HELLO_WORLD, HELLO_WORLD_LEN };
@@ -760,6 +965,15 @@ int string_test(void)
     if (i != 0)
         return i;
 
+    /* Vectorized caseless comparison and search test. */
+    i = simd_test();
+    if (i != 0)
+        return i;
+
+    i = string_perf_test();
+    if (i != 0)
+        return i;
+
     /* strxcpy test */
     i = strxcpy_test();
     if (i != 0)
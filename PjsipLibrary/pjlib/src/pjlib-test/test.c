@@ -109,6 +109,10 @@ int test_inner(void)
     DO_TEST( pool_perf_test() );
 #endif
 
+#if INCLUDE_SLAB_TEST
+    DO_TEST( slab_test() );
+#endif
+
 #if INCLUDE_STRING_TEST
     DO_TEST( string_test() );
 #endif
@@ -117,6 +121,10 @@ int test_inner(void)
     DO_TEST( fifobuf_test() );
 #endif
 
+#if INCLUDE_RINGBUF_TEST
+    DO_TEST( ringbuf_test() );
+#endif
+
 #if INCLUDE_RBTREE_TEST
     DO_TEST( rbtree_test() );
 #endif
@@ -149,6 +157,10 @@ int test_inner(void)
     DO_TEST( thread_test() );
 #endif
 
+#if INCLUDE_TRACE_TEST
+    DO_TEST( trace_test() );
+#endif
+
 #if INCLUDE_SOCK_TEST
     DO_TEST( sock_test() );
 #endif
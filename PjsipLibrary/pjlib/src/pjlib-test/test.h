@@ -47,6 +47,8 @@
 #define INCLUDE_HASH_TEST           GROUP_DATA_STRUCTURE
 #define INCLUDE_POOL_TEST           GROUP_LIBC
 #define INCLUDE_POOL_PERF_TEST      (GROUP_LIBC && WITH_BENCHMARK)
+#define INCLUDE_SLAB_TEST           GROUP_LIBC
+#define INCLUDE_RINGBUF_TEST        GROUP_DATA_STRUCTURE
 #define INCLUDE_STRING_TEST         GROUP_DATA_STRUCTURE
 #define INCLUDE_FIFOBUF_TEST        GROUP_DATA_STRUCTURE
 #define INCLUDE_RBTREE_TEST         GROUP_DATA_STRUCTURE
@@ -56,6 +58,7 @@
 #define INCLUDE_SLEEP_TEST          GROUP_OS
 #define INCLUDE_OS_TEST             GROUP_OS
 #define INCLUDE_THREAD_TEST         (PJ_HAS_THREADS && GROUP_OS)
+#define INCLUDE_TRACE_TEST          GROUP_OS
 #define INCLUDE_SOCK_TEST           GROUP_NETWORK
 #define INCLUDE_SOCK_PERF_TEST      (GROUP_NETWORK && WITH_BENCHMARK)
 #define INCLUDE_SELECT_TEST         GROUP_NETWORK
@@ -91,6 +94,8 @@ extern int log_test(void);
 extern int os_test(void);
 extern int pool_test(void);
 extern int pool_perf_test(void);
+extern int slab_test(void);
+extern int ringbuf_test(void);
 extern int string_test(void);
 extern int fifobuf_test(void);
 extern int timer_test(void);
@@ -99,6 +104,7 @@ extern int atomic_test(void);
 extern int mutex_test(void);
 extern int sleep_test(void);
 extern int thread_test(void);
+extern int trace_test(void);
 extern int sock_test(void);
 extern int sock_perf_test(void);
 extern int select_test(void);
@@ -142,6 +142,13 @@ static int simple_thread(const char *title, unsigned flags)
         return -1010;
     }
 
+    /* Pinning to CPU 0 must either work or be reported as unsupported */
+    rc = pj_thread_set_affinity(thread, 0);
+    if (rc != PJ_SUCCESS && rc != PJ_ENOTSUP) {
+        app_perror("...error: unable to set thread affinity", rc);
+        return -1012;
+    }
+
     TRACE__((THIS_FILE, "    Main thread waiting.."));
     pj_thread_sleep(1500);
     TRACE__((THIS_FILE, "    Main thread resuming.."));
@@ -50,7 +50,12 @@ static void timer_callback(pj_timer_heap_t *ht, pj_timer_entry *e)
     PJ_UNUSED_ARG(e);
 }
 
-static int test_timer_heap(void)
+static const char *get_heap_type_name(pj_timer_heap_type type)
+{
+    return (type == PJ_TIMER_HEAP_TYPE_WHEEL ? "wheel" : "heap");
+}
+
+static int test_timer_heap(const pj_timer_heap_cfg *cfg)
 {
     int i, j;
     pj_timer_entry *entry;
@@ -62,7 +67,7 @@ static int test_timer_heap(void)
     pj_size_t size;
     unsigned count;
 
-    PJ_LOG(3,("test", "...Basic test"));
+    PJ_LOG(3,("test", "...Basic test (%s)", get_heap_type_name(cfg->type)));
 
     size = pj_timer_heap_mem_size(MAX_COUNT)+MAX_COUNT*sizeof(pj_timer_entry);
     pool = pj_pool_create( mem, NULL, size, 4000, NULL);
@@ -79,7 +84,7 @@ static int test_timer_heap(void)
     for (i=0; i<MAX_COUNT; ++i) {
         entry[i].cb = &timer_callback;
     }
-    status = pj_timer_heap_create(pool, MAX_COUNT, &timer);
+    status = pj_timer_heap_create2(pool, MAX_COUNT, cfg, &timer);
     if (status != PJ_SUCCESS) {
         app_perror("...error: unable to create timer heap", status);
         return -30;
@@ -469,7 +474,7 @@ static int cancel_worker(void *arg)
 }
 #endif
 
-static int timer_stress_test(void)
+static int timer_stress_test(const pj_timer_heap_cfg *cfg)
 {
     unsigned count = 0, n_sched = 0, n_cancel = 0, n_poll = 0;
     int i;
@@ -492,7 +497,7 @@ static int timer_stress_test(void)
     pj_time_val delay = {0};
 #endif
 
-    PJ_LOG(3,("test", "...Stress test"));
+    PJ_LOG(3,("test", "...Stress test (%s)", get_heap_type_name(cfg->type)));
 
     pj_gettimeofday(&now);
     pj_srand(now.sec);
@@ -508,7 +513,7 @@ static int timer_stress_test(void)
      * Initially we only create a fraction of what's required,
      * to test the timer heap growth algorithm.
      */
-    status = pj_timer_heap_create(pool, ST_ENTRY_COUNT/64, &timer);
+    status = pj_timer_heap_create2(pool, ST_ENTRY_COUNT/64, cfg, &timer);
     if (status != PJ_SUCCESS) {
         app_perror("...error: unable to create timer heap", status);
         err = -20;
@@ -953,15 +958,157 @@ static int timer_bench_test(void)
     return err;
 }
 
+/* Compare the binary heap and the timing wheel, for each entry count:
+ * schedule all entries with random delays, cancel all of them, then
+ * schedule all of them to expire immediately and poll until empty.
+ */
+static int timer_cmp_bench(pj_timer_heap_type type, unsigned count,
+                           pj_timestamp freq)
+{
+    pj_pool_t *pool;
+    pj_timer_heap_t *timer;
+    pj_timer_heap_cfg cfg;
+    pj_timer_entry *entries;
+    pj_timestamp t1, t2;
+    pj_time_val delay;
+    char sched_str[64], cancel_str[64], poll_str[64];
+    unsigned rate[3];
+    unsigned i, polled;
+    pj_status_t status;
+    int err = 0;
+
+    pool = pj_pool_create( mem, NULL, 4000, 4000, NULL);
+    if (!pool)
+        return -10;
+
+    pj_timer_heap_cfg_default(&cfg);
+    cfg.type = type;
+    status = pj_timer_heap_create2(pool, count, &cfg, &timer);
+    if (status != PJ_SUCCESS) {
+        app_perror("...error: unable to create timer heap", status);
+        err = -20;
+        goto on_return;
+    }
+    pj_timer_heap_set_max_timed_out_per_poll(timer, count);
+
+    entries = (pj_timer_entry*)pj_pool_calloc(pool, count, sizeof(*entries));
+    if (!entries) {
+        err = -30;
+        goto on_return;
+    }
+    for (i = 0; i < count; ++i)
+        pj_timer_entry_init(&entries[i], 0, NULL, &dummy_callback);
+
+    /* Schedule */
+    pj_get_timestamp(&t1);
+    for (i = 0; i < count; ++i) {
+        delay.sec = 1 + pj_rand() % 32;
+        delay.msec = pj_rand() % 1000;
+        status = pj_timer_heap_schedule(timer, &entries[i], &delay);
+        if (status != PJ_SUCCESS) {
+            app_perror("...error: unable to schedule timer entry", status);
+            err = -40;
+            goto on_return;
+        }
+    }
+    pj_get_timestamp(&t2);
+    pj_sub_timestamp(&t2, &t1);
+    rate[0] = (unsigned)(freq.u64 * count / (t2.u64 ? t2.u64 : 1));
+
+    /* Cancel */
+    pj_get_timestamp(&t1);
+    for (i = 0; i < count; ++i) {
+        if (pj_timer_heap_cancel(timer, &entries[i]) != 1) {
+            PJ_LOG(3,("test", "...error: unable to cancel timer entry"));
+            err = -50;
+            goto on_return;
+        }
+    }
+    pj_get_timestamp(&t2);
+    pj_sub_timestamp(&t2, &t1);
+    rate[1] = (unsigned)(freq.u64 * count / (t2.u64 ? t2.u64 : 1));
+
+    /* Expire */
+    delay.sec = delay.msec = 0;
+    for (i = 0; i < count; ++i) {
+        status = pj_timer_heap_schedule(timer, &entries[i], &delay);
+        if (status != PJ_SUCCESS) {
+            err = -60;
+            goto on_return;
+        }
+    }
+    pj_thread_sleep(PJ_TIMER_WHEEL_RESOLUTION * 2);
+
+    polled = 0;
+    pj_get_timestamp(&t1);
+    while (pj_timer_heap_count(timer) > 0)
+        polled += pj_timer_heap_poll(timer, NULL);
+    pj_get_timestamp(&t2);
+    pj_sub_timestamp(&t2, &t1);
+    rate[2] = (unsigned)(freq.u64 * polled / (t2.u64 ? t2.u64 : 1));
+
+    get_format_num(count, sched_str);
+    PJ_LOG(3,(THIS_FILE, "    %s, %s entries:", get_heap_type_name(type),
+              sched_str));
+    get_format_num(rate[0], sched_str);
+    get_format_num(rate[1], cancel_str);
+    get_format_num(rate[2], poll_str);
+    PJ_LOG(3,(THIS_FILE, "      schedule %s, cancel %s, expire %s ent/sec",
+              sched_str, cancel_str, poll_str));
+
+    pj_timer_heap_destroy(timer);
+
+on_return:
+    pj_pool_release(pool);
+    return err;
+}
+
+static int timer_cmp_bench_test(void)
+{
+    static const unsigned counts[] = { 1000, 100000, 1000000 };
+    pj_timestamp freq;
+    unsigned i;
+    int rc;
+
+    PJ_LOG(3,("test", "...Heap vs wheel benchmark"));
+
+    if (pj_get_timestamp_freq(&freq) != PJ_SUCCESS)
+        return -300;
+
+    for (i = 0; i < PJ_ARRAY_SIZE(counts); ++i) {
+        rc = timer_cmp_bench(PJ_TIMER_HEAP_TYPE_HEAP, counts[i], freq);
+        if (rc != 0)
+            return rc;
+        rc = timer_cmp_bench(PJ_TIMER_HEAP_TYPE_WHEEL, counts[i], freq);
+        if (rc != 0)
+            return rc;
+    }
+    return 0;
+}
+
 int timer_test()
 {
+    pj_timer_heap_cfg cfg;
     int rc;
 
-    rc = test_timer_heap();
+    pj_timer_heap_cfg_default(&cfg);
+    cfg.type = PJ_TIMER_HEAP_TYPE_HEAP;
+
+    rc = test_timer_heap(&cfg);
+    if (rc != 0)
+        return rc;
+
+    rc = timer_stress_test(&cfg);
     if (rc != 0)
         return rc;
 
-    rc = timer_stress_test();
+    cfg.type = PJ_TIMER_HEAP_TYPE_WHEEL;
+
+    rc = test_timer_heap(&cfg);
+    if (rc != 0)
+        return rc;
+
+    rc = timer_stress_test(&cfg);
     if (rc != 0)
         return rc;
 
@@ -969,9 +1116,14 @@ int timer_test()
     rc = timer_bench_test();
     if (rc != 0)
         return rc;
+
+    rc = timer_cmp_bench_test();
+    if (rc != 0)
+        return rc;
 #else
     /* Avoid unused warning */
     PJ_UNUSED_ARG(timer_bench_test);
+    PJ_UNUSED_ARG(timer_cmp_bench_test);
 #endif
 
     return 0;
@@ -0,0 +1,248 @@
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include <pj/trace.h>
+#include <pj/log.h>
+#include <pj/os.h>
+#include <pj/pool.h>
+#include <pj/string.h>
+#include "test.h"
+
+/**
+ * \page page_pjlib_trace_test Test: Event Tracing
+ *
+ * This file provides implementation of \b trace_test(). It records events
+ * from one and from several threads and checks the exported Chrome trace
+ * JSON.
+ *
+ * This file is <b>pjlib-test/trace.c</b>
+ *
+ * \include pjlib-test/trace.c
+ */
+
+#if INCLUDE_TRACE_TEST
+
+#define THIS_FILE       "trace.c"
+#define CAPACITY        16
+#define BUF_SIZE        32000
+#define MT_THREADS      4
+
+static char json[BUF_SIZE];
+static pj_bool_t thread_quit_flag;
+
+static unsigned count_str(const char *s, const char *what)
+{
+    unsigned cnt = 0;
+    pj_size_t len = pj_ansi_strlen(what);
+
+    while ((s = pj_ansi_strstr(s, what)) != NULL) {
+        ++cnt;
+        s += len;
+    }
+    return cnt;
+}
+
+/* Single thread: event types, overwriting, stop and buffer too small */
+static int basic_test(void)
+{
+    pj_ssize_t len;
+    char arg[32];
+    int i;
+
+    PJ_LOG(3,(THIS_FILE, "...basic_test()"));
+
+    if (pj_trace_start(mem, CAPACITY) != PJ_SUCCESS)
+        return -10;
+
+    PJ_TRACE_BEGIN("test", "outer");
+    PJ_TRACE_BEGIN("test", "inner");
+    PJ_TRACE_INSTANT("test", "mark", 7);
+    PJ_TRACE_END("test", "inner");
+    PJ_TRACE_END("test", "outer");
+
+    len = pj_trace_export(json, sizeof(json));
+    if (len <= 0 || (pj_size_t)len != pj_ansi_strlen(json)) {
+        PJ_LOG(3,(THIS_FILE, "....error: export failed"));
+        return -20;
+    }
+
+    if (pj_ansi_strncmp(json, "{\"traceEvents\":[", 16) != 0 ||
+        json[len-1] != '}' ||
+        count_str(json, "\"ph\":\"B\"") != 2 ||
+        count_str(json, "\"ph\":\"E\"") != 2 ||
+        count_str(json, "\"ph\":\"i\"") != 1 ||
+        count_str(json, "\"ph\":\"M\"") < 1 ||
+        count_str(json, "\"args\":{\"v\":7}") != 1 ||
+        count_str(json, "\"name\":\"outer\",\"cat\":\"test\"") != 2)
+    {
+        PJ_LOG(3,(THIS_FILE, "....error: unexpected export: %s", json));
+        return -30;
+    }
+
+    /* Only the latest events are kept */
+    for (i=0; i<100; ++i)
+        PJ_TRACE_INSTANT("test", "seq", i);
+
+    /* Nothing is recorded while stopped */
+    pj_trace_stop();
+    PJ_TRACE_INSTANT("test", "stopped", 1);
+
+    len = pj_trace_export(json, sizeof(json));
+    if (len <= 0 || count_str(json, "\"ph\":\"i\"") != CAPACITY) {
+        PJ_LOG(3,(THIS_FILE, "....error: wrong number of events"));
+        return -40;
+    }
+    pj_ansi_snprintf(arg, sizeof(arg), "{\"v\":%d}", 100 - CAPACITY);
+    if (!pj_ansi_strstr(json, arg) || pj_ansi_strstr(json, "{\"v\":83}") ||
+        !pj_ansi_strstr(json, "{\"v\":99}"))
+    {
+        PJ_LOG(3,(THIS_FILE, "....error: wrong events kept"));
+        return -50;
+    }
+
+    if (pj_ansi_strstr(json, "stopped")) {
+        PJ_LOG(3,(THIS_FILE, "....error: event recorded while stopped"));
+        return -60;
+    }
+
+    if (pj_trace_export(json, 40) != -1) {
+        PJ_LOG(3,(THIS_FILE, "....error: expecting buffer too small"));
+        return -70;
+    }
+
+    /* Restart clears the events */
+    if (pj_trace_start(mem, CAPACITY) != PJ_SUCCESS)
+        return -80;
+    len = pj_trace_export(json, sizeof(json));
+    if (len <= 0 || count_str(json, "\"ph\":\"i\"") != 0) {
+        PJ_LOG(3,(THIS_FILE, "....error: events not cleared"));
+        return -90;
+    }
+
+    pj_trace_shutdown();
+    return 0;
+}
+
+#if PJ_HAS_THREADS
+static int mt_worker(void *arg)
+{
+    int i;
+
+    PJ_UNUSED_ARG(arg);
+
+    for (i=0; !thread_quit_flag; ++i) {
+        PJ_TRACE_BEGIN("test", "work");
+        PJ_TRACE_INSTANT("test", "step", i);
+        PJ_TRACE_END("test", "work");
+    }
+    return 0;
+}
+
+/* Export and restart while other threads are recording */
+static int mt_test(void)
+{
+    pj_pool_t *pool;
+    pj_thread_t *thread[MT_THREADS];
+    pj_ssize_t len;
+    unsigned i, thread_cnt;
+    int rc = 0;
+
+    PJ_LOG(3,(THIS_FILE, "...mt_test()"));
+
+    pool = pj_pool_create(mem, NULL, 4000, 4000, NULL);
+    if (!pool)
+        return -200;
+
+    if (pj_trace_start(mem, CAPACITY) != PJ_SUCCESS) {
+        pj_pool_release(pool);
+        return -205;
+    }
+
+    thread_quit_flag = 0;
+
+    for (thread_cnt=0; thread_cnt<MT_THREADS; ++thread_cnt) {
+        if (pj_thread_create(pool, "tr_worker", &mt_worker, NULL, 0, 0,
+                             &thread[thread_cnt]) != PJ_SUCCESS)
+        {
+            rc = -210;
+            break;
+        }
+    }
+
+    if (rc == 0) {
+        for (i=0; i<20 && rc==0; ++i) {
+            len = pj_trace_export(json, sizeof(json));
+            if (len <= 0 || json[len-1] != '}' ||
+                count_str(json, "\"ph\":\"i\"") > MT_THREADS * CAPACITY)
+            {
+                PJ_LOG(3,(THIS_FILE, "....error: bad export while running"));
+                rc = -220;
+            }
+            /* Restart while the threads are recording */
+            if (i == 10 && pj_trace_start(mem, CAPACITY) != PJ_SUCCESS)
+                rc = -225;
+            pj_thread_sleep(1);
+        }
+    }
+
+    thread_quit_flag = 1;
+
+    for (i=0; i<thread_cnt; ++i) {
+        pj_thread_join(thread[i]);
+        pj_thread_destroy(thread[i]);
+    }
+
+    if (rc == 0) {
+        len = pj_trace_export(json, sizeof(json));
+        if (len <= 0 || count_str(json, "\"name\":\"tr_worker\"") < 1 ||
+            count_str(json, "\"ph\":\"i\"") < MT_THREADS * (CAPACITY / 3))
+        {
+            PJ_LOG(3,(THIS_FILE, "....error: wrong final export"));
+            rc = -230;
+        }
+    }
+
+    pj_trace_shutdown();
+    pj_pool_release(pool);
+    return rc;
+}
+#endif  /* PJ_HAS_THREADS */
+
+int trace_test(void)
+{
+    int rc;
+
+    rc = basic_test();
+    if (rc != 0) {
+        pj_trace_shutdown();
+        return rc;
+    }
+
+#if PJ_HAS_THREADS
+    rc = mt_test();
+#endif
+
+    return rc;
+}
+
+#else
+/* To prevent warning about "translation unit is empty"
+ * when this test is disabled.
+ */
+int dummy_trace_test;
+#endif  /* INCLUDE_TRACE_TEST */
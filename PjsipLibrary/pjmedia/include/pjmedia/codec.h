@@ -28,7 +28,9 @@
 #include <pjmedia/port.h>
 #include <pj/errno.h>
 #include <pj/list.h>
+#include <pj/os.h>
 #include <pj/pool.h>
+#include <pj/trace.h>
 
 PJ_BEGIN_DECL
 
@@ -719,8 +721,17 @@ typedef struct pjmedia_codec_mgr
     /** Codec manager pool. */
     pj_pool_t                   *pool;
 
-    /** Codec manager mutex. */
-    pj_mutex_t                  *mutex;
+    /**
+     * Codec manager reader/writer mutex. Codec lookups take the read lock,
+     * codec factory registration and priority/parameter updates take the
+     * write lock.
+     *
+     * Note: this used to be a pj_mutex_t. The type change is an API and
+     * ABI change: code that locks this field directly must now use the
+     * pj_rwmutex_*() functions, and code built against the old headers
+     * must be rebuilt.
+     */
+    pj_rwmutex_t                *mutex;
 
     /** List of codec factories registered to codec manager. */
     pjmedia_codec_factory        factory_list;
@@ -1091,7 +1102,12 @@ PJ_INLINE(pj_status_t) pjmedia_codec_encode(
                                         unsigned out_size, 
                                         struct pjmedia_frame *output )
 {
-    return (*codec->op->encode)(codec, input, out_size, output);
+    pj_status_t status;
+
+    PJ_TRACE_BEGIN("codec", "encode");
+    status = (*codec->op->encode)(codec, input, out_size, output);
+    PJ_TRACE_END("codec", "encode");
+    return status;
 }
 
 
@@ -1116,7 +1132,12 @@ PJ_INLINE(pj_status_t) pjmedia_codec_decode(
                                         unsigned out_size, 
                                         struct pjmedia_frame *output )
 {
-    return (*codec->op->decode)(codec, input, out_size, output);
+    pj_status_t status;
+
+    PJ_TRACE_BEGIN("codec", "decode");
+    status = (*codec->op->decode)(codec, input, out_size, output);
+    PJ_TRACE_END("codec", "decode");
+    return status;
 }
 
 
@@ -167,6 +167,23 @@
 #   endif
 #endif
 
+/**
+ * Make the sound ports call the downstream port (e.g. the conference
+ * bridge) from a media thread, as if #PJMEDIA_SND_PORT_MEDIA_THREAD was
+ * given to every sound port with PCM format. The audio device callbacks
+ * then never take a lock. This adds up to two frames of playback latency.
+ * Use #PJMEDIA_SND_PORT_NO_MEDIA_THREAD to turn it off for one sound port.
+ *
+ * Default: 1 when threads are available
+ */
+#ifndef PJMEDIA_SND_PORT_USE_MEDIA_THREAD
+#   if defined(PJ_HAS_THREADS) && PJ_HAS_THREADS!=0
+#       define PJMEDIA_SND_PORT_USE_MEDIA_THREAD    1
+#   else
+#       define PJMEDIA_SND_PORT_USE_MEDIA_THREAD    0
+#   endif
+#endif
+
 
 /*
  * Types of WSOLA backend algorithm.
@@ -643,6 +660,23 @@
 #   define PJMEDIA_STREAM_CHECK_RTP_PT          1
 #endif
 
+/**
+ * Maximum number of RTP packets that the audio stream collects during one
+ * put_frame() before sending them with one
+ * #pjmedia_transport_send_rtp_batch() call. A put_frame() yields several
+ * packets when the encoder ptime is shorter than the stream ptime (for
+ * example, 20 ms conference frames sent as 10 ms packets); otherwise there
+ * is only one packet and nothing is batched. Batching is per stream, the
+ * packets of different streams (e.g. the legs of a conference, each with
+ * its own transport) are still sent separately. Set to 1 to send each
+ * packet separately.
+ *
+ * Default: 4
+ */
+#ifndef PJMEDIA_STREAM_TX_BATCH
+#   define PJMEDIA_STREAM_TX_BATCH              4
+#endif
+
 /**
  * Reserve some space for application extra data, e.g: SRTP auth tag,
  * in RTP payload, so the total payload length will not exceed the MTU.
@@ -1225,6 +1259,19 @@
 #endif
 
 
+/**
+ * Maximum number of RTP packets that the UDP media transport drains from
+ * the socket with a single #pj_sock_recvmmsg() call. Each UDP media
+ * transport reserves (this value - 1) additional PJMEDIA_MAX_MRU sized
+ * buffers for the drained packets. Set to 1 to disable batched receive.
+ *
+ * Default: 4
+ */
+#ifndef PJMEDIA_TRANSPORT_UDP_RECV_BATCH
+#   define PJMEDIA_TRANSPORT_UDP_RECV_BATCH         4
+#endif
+
+
 /**
  * Transport info (pjmedia_transport_info) contains a socket info and list
  * of transport specific info, since transports can be chained together 
@@ -1703,6 +1750,18 @@
 #   define PJMEDIA_VID_STREAM_CHECK_RTP_PT      PJMEDIA_STREAM_CHECK_RTP_PT
 #endif
 
+/**
+ * Maximum number of RTP packets of one video frame that the video stream
+ * collects before sending them with one #pjmedia_transport_send_rtp_batch()
+ * call. Packets collected so far are also sent before the stream sleeps
+ * for send rate control. Set to 1 to send each packet separately.
+ *
+ * Default: 16
+ */
+#ifndef PJMEDIA_VID_STREAM_TX_BATCH
+#   define PJMEDIA_VID_STREAM_TX_BATCH          16
+#endif
+
 /**
  * @}
  */
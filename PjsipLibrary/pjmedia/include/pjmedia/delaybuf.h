@@ -71,7 +71,22 @@ typedef enum pjmedia_delay_buf_flag
      * Use simple FIFO mechanism for the delay buffer, i.e.
      * without WSOLA for expanding and shrinking audio samples.
      */
-    PJMEDIA_DELAY_BUF_SIMPLE_FIFO = 1
+    PJMEDIA_DELAY_BUF_SIMPLE_FIFO = 1,
+
+    /**
+     * Use a lock-free simple FIFO (this implies
+     * PJMEDIA_DELAY_BUF_SIMPLE_FIFO). The samples are kept in a
+     * #pj_ringbuf_t, so #pjmedia_delay_buf_put() and
+     * #pjmedia_delay_buf_get() never block, which makes the buffer safe
+     * to use from audio device callbacks. The buffer must then have a
+     * single producer thread calling #pjmedia_delay_buf_put() and a
+     * single consumer thread calling #pjmedia_delay_buf_get(). The
+     * eldest samples over the maximum delay are dropped by the consumer
+     * (if the consumer stalls for too long, the producer drops the new
+     * frame instead), and #pjmedia_delay_buf_reset() only takes effect
+     * on the next #pjmedia_delay_buf_get().
+     */
+    PJMEDIA_DELAY_BUF_LOCK_FREE = 2
 
 } pjmedia_delay_buf_flag;
 
@@ -212,6 +212,33 @@ PJ_DECL(pj_status_t) pjmedia_endpt_get_flag(pjmedia_endpt *endpt,
 PJ_DECL(pj_ioqueue_t*) pjmedia_endpt_get_ioqueue(pjmedia_endpt *endpt);
 
 
+/**
+ * Add an ioqueue to spread the media sockets on. Media transports
+ * created afterwards will be registered to the endpoint's ioqueue and the
+ * added ioqueues in round-robin fashion. The media endpoint does not poll
+ * nor destroy the added ioqueue, application must do it.
+ *
+ * @param endpt         The media endpoint instance.
+ * @param ioqueue       The ioqueue.
+ *
+ * @return              PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjmedia_endpt_add_ioqueue(pjmedia_endpt *endpt,
+                                              pj_ioqueue_t *ioqueue);
+
+
+/**
+ * Get the ioqueue to register a new media socket to. This returns the
+ * endpoint's ioqueue, unless ioqueues have been added with
+ * #pjmedia_endpt_add_ioqueue().
+ *
+ * @param endpt         The media endpoint instance.
+ *
+ * @return              The ioqueue instance.
+ */
+PJ_DECL(pj_ioqueue_t*) pjmedia_endpt_next_ioqueue(pjmedia_endpt *endpt);
+
+
 /**
  * Get the number of worker threads on the media endpoint
  *
@@ -71,7 +71,25 @@ enum pjmedia_snd_port_option
     /** 
      * Don't start the audio device when creating a sound port.
      */    
-    PJMEDIA_SND_PORT_NO_AUTO_START = 1
+    PJMEDIA_SND_PORT_NO_AUTO_START = 1,
+
+    /**
+     * Call the downstream port (e.g. the conference bridge) and the
+     * software echo canceller from a separate media thread instead of
+     * from the audio device callbacks. The callbacks then only exchange
+     * frames and their timestamps with the media thread through lock-free
+     * ring buffers (see #pj_ringbuf_t), so they never block on the locks
+     * taken by the downstream port. This adds up to two frames of
+     * playback latency. It only applies to PCM formats, and it is the
+     * default when #PJMEDIA_SND_PORT_USE_MEDIA_THREAD is enabled.
+     */
+    PJMEDIA_SND_PORT_MEDIA_THREAD = 2,
+
+    /**
+     * Call the downstream port from the audio device callbacks, even when
+     * #PJMEDIA_SND_PORT_USE_MEDIA_THREAD is enabled.
+     */
+    PJMEDIA_SND_PORT_NO_MEDIA_THREAD = 4
 };
 
 /**
@@ -457,6 +457,20 @@ struct pjmedia_transport_op
      */
     pj_status_t (*attach2)(pjmedia_transport *tp,
                            pjmedia_transport_attach_param *att_param);
+
+    /**
+     * This function is called to send several RTP packets of one stream
+     * at once, e.g. the packets of one video frame. All packets go to the
+     * same remote RTP address. Transports may leave this NULL, in which
+     * case <tt>send_rtp()</tt> will be called for each packet.
+     *
+     * Application should call #pjmedia_transport_send_rtp_batch() instead
+     * of calling this function directly.
+     */
+    pj_status_t (*send_rtp_batch)(pjmedia_transport *tp,
+                                  const void *pkt[],
+                                  const pj_size_t size[],
+                                  unsigned count);
 };
 
 
@@ -873,6 +887,42 @@ PJ_INLINE(pj_status_t) pjmedia_transport_send_rtp(pjmedia_transport *tp,
 }
 
 
+/**
+ * Send several RTP packets with the specified media transport. If the
+ * transport implements <tt>send_rtp_batch()</tt>, the packets may be
+ * sent with a single system call (see #pj_ioqueue_sendto_batch()),
+ * otherwise this calls <tt>send_rtp()</tt> for each packet. The packets
+ * will be delivered to the destination address specified in
+ * #pjmedia_transport_attach().
+ *
+ * @param tp        The media transport.
+ * @param pkt       Array of packets to send.
+ * @param size      Array of packet sizes.
+ * @param count     Number of packets.
+ *
+ * @return          PJ_SUCCESS if all packets have been sent (or queued),
+ *                  or the error code of the last failure.
+ */
+PJ_INLINE(pj_status_t) pjmedia_transport_send_rtp_batch(pjmedia_transport *tp,
+                                                        const void *pkt[],
+                                                        const pj_size_t size[],
+                                                        unsigned count)
+{
+    pj_status_t status = PJ_SUCCESS;
+    unsigned i;
+
+    if (tp->op->send_rtp_batch)
+        return (*tp->op->send_rtp_batch)(tp, pkt, size, count);
+
+    for (i = 0; i < count; ++i) {
+        pj_status_t st = (*tp->op->send_rtp)(tp, pkt[i], size[i]);
+        if (st != PJ_SUCCESS)
+            status = st;
+    }
+    return status;
+}
+
+
 /**
  * Send RTCP packet with the specified media transport. This is just a simple
  * wrapper which calls <tt>send_rtcp()</tt> member of the transport. The 
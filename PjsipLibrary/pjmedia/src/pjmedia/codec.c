@@ -180,8 +180,10 @@ PJ_DEF(pj_status_t) pjmedia_codec_mgr_init (pjmedia_codec_mgr *mgr,
     /* Create pool */
     mgr->pool = pj_pool_create(mgr->pf, "codec-mgr", 256, 256, NULL);
 
-    /* Create mutex */
-    status = pj_mutex_create_recursive(mgr->pool, "codec-mgr", &mgr->mutex);
+    /* Create reader/writer mutex. Lookups only need read access, so they
+     * can run concurrently.
+     */
+    status = pj_rwmutex_create(mgr->pool, "codec-mgr", &mgr->mutex);
     if (status != PJ_SUCCESS)
         return status;
 
@@ -232,7 +234,7 @@ PJ_DEF(pj_status_t) pjmedia_codec_mgr_destroy (pjmedia_codec_mgr *mgr)
 
     /* Destroy mutex */
     if (mgr->mutex)
-        pj_mutex_destroy(mgr->mutex);
+        pj_rwmutex_destroy(mgr->mutex);
 
     /* Release pool */
     if (mgr->pool)
@@ -273,11 +275,11 @@ PJ_DEF(pj_status_t) pjmedia_codec_mgr_register_factory( pjmedia_codec_mgr *mgr,
     if (status != PJ_SUCCESS)
         return status;
 
-    pj_mutex_lock(mgr->mutex);
+    pj_rwmutex_lock_write(mgr->mutex);
 
     /* Check codec count */
     if (count + mgr->codec_cnt > PJ_ARRAY_SIZE(mgr->codec_desc)) {
-        pj_mutex_unlock(mgr->mutex);
+        pj_rwmutex_unlock_write(mgr->mutex);
         return PJ_ETOOMANY;
     }
 
@@ -320,7 +322,7 @@ PJ_DEF(pj_status_t) pjmedia_codec_mgr_register_factory( pjmedia_codec_mgr *mgr,
     /* Add factory to the list */
     pj_list_push_back(&mgr->factory_list, factory);
 
-    pj_mutex_unlock(mgr->mutex);
+    pj_rwmutex_unlock_write(mgr->mutex);
 
     return PJ_SUCCESS;
 }
@@ -336,11 +338,11 @@ PJ_DEF(pj_status_t) pjmedia_codec_mgr_unregister_factory(
     unsigned i;
     PJ_ASSERT_RETURN(mgr && factory, PJ_EINVAL);
 
-    pj_mutex_lock(mgr->mutex);
+    pj_rwmutex_lock_write(mgr->mutex);
 
     /* Factory must be registered. */
     if (pj_list_find_node(&mgr->factory_list, factory) != factory) {
-        pj_mutex_unlock(mgr->mutex);
+        pj_rwmutex_unlock_write(mgr->mutex);
         return PJ_ENOTFOUND;
     }
 
@@ -387,7 +389,7 @@ PJ_DEF(pj_status_t) pjmedia_codec_mgr_unregister_factory(
         }
     }
 
-    pj_mutex_unlock(mgr->mutex);
+    pj_rwmutex_unlock_write(mgr->mutex);
 
     return PJ_SUCCESS;
 }
@@ -405,7 +407,7 @@ PJ_DEF(pj_status_t) pjmedia_codec_mgr_enum_codecs(pjmedia_codec_mgr *mgr,
 
     PJ_ASSERT_RETURN(mgr && count && codecs, PJ_EINVAL);
 
-    pj_mutex_lock(mgr->mutex);
+    pj_rwmutex_lock_read(mgr->mutex);
 
     if (*count > mgr->codec_cnt)
         *count = mgr->codec_cnt;
@@ -421,7 +423,7 @@ PJ_DEF(pj_status_t) pjmedia_codec_mgr_enum_codecs(pjmedia_codec_mgr *mgr,
             prio[i] = mgr->codec_desc[i].prio;
     }
 
-    pj_mutex_unlock(mgr->mutex);
+    pj_rwmutex_unlock_read(mgr->mutex);
 
     return PJ_SUCCESS;
 }
@@ -438,18 +440,18 @@ PJ_DEF(pj_status_t) pjmedia_codec_mgr_get_codec_info( pjmedia_codec_mgr *mgr,
 
     PJ_ASSERT_RETURN(mgr && p_info && pt < 96, PJ_EINVAL);
 
-    pj_mutex_lock(mgr->mutex);
+    pj_rwmutex_lock_read(mgr->mutex);
 
     for (i=0; i<mgr->codec_cnt; ++i) {
         if (mgr->codec_desc[i].info.pt == pt) {
             *p_info = &mgr->codec_desc[i].info;
 
-            pj_mutex_unlock(mgr->mutex);
+            pj_rwmutex_unlock_read(mgr->mutex);
             return PJ_SUCCESS;
         }
     }
 
-    pj_mutex_unlock(mgr->mutex);
+    pj_rwmutex_unlock_read(mgr->mutex);
 
     return PJMEDIA_CODEC_EUNSUP;
 }
@@ -497,7 +499,7 @@ PJ_DEF(pj_status_t) pjmedia_codec_mgr_find_codecs_by_id( pjmedia_codec_mgr *mgr,
 
     PJ_ASSERT_RETURN(mgr && codec_id && count && *count, PJ_EINVAL);
 
-    pj_mutex_lock(mgr->mutex);
+    pj_rwmutex_lock_read(mgr->mutex);
 
     for (i=0; i<mgr->codec_cnt; ++i) {
 
@@ -519,7 +521,7 @@ PJ_DEF(pj_status_t) pjmedia_codec_mgr_find_codecs_by_id( pjmedia_codec_mgr *mgr,
 
     }
 
-    pj_mutex_unlock(mgr->mutex);
+    pj_rwmutex_unlock_read(mgr->mutex);
 
     *count = found;
 
@@ -584,7 +586,7 @@ PJ_DEF(pj_status_t) pjmedia_codec_mgr_set_codec_priority(
 
     PJ_ASSERT_RETURN(mgr && codec_id, PJ_EINVAL);
 
-    pj_mutex_lock(mgr->mutex);
+    pj_rwmutex_lock_write(mgr->mutex);
 
     /* Update the priorities of affected codecs */
     for (i=0; i<mgr->codec_cnt; ++i) 
@@ -599,14 +601,14 @@ PJ_DEF(pj_status_t) pjmedia_codec_mgr_set_codec_priority(
     }
 
     if (!found) {
-        pj_mutex_unlock(mgr->mutex);
+        pj_rwmutex_unlock_write(mgr->mutex);
         return PJ_ENOTFOUND;
     }
 
     /* Re-sort codecs */
     sort_codecs(mgr);
 
-    pj_mutex_unlock(mgr->mutex);
+    pj_rwmutex_unlock_write(mgr->mutex);
 
     return PJ_SUCCESS;
 }
@@ -626,7 +628,7 @@ PJ_DEF(pj_status_t) pjmedia_codec_mgr_alloc_codec(pjmedia_codec_mgr *mgr,
 
     *p_codec = NULL;
 
-    pj_mutex_lock(mgr->mutex);
+    pj_rwmutex_lock_read(mgr->mutex);
 
     factory = mgr->factory_list.next;
     while (factory != &mgr->factory_list) {
@@ -635,7 +637,7 @@ PJ_DEF(pj_status_t) pjmedia_codec_mgr_alloc_codec(pjmedia_codec_mgr *mgr,
 
             status = (*factory->op->alloc_codec)(factory, info, p_codec);
             if (status == PJ_SUCCESS) {
-                pj_mutex_unlock(mgr->mutex);
+                pj_rwmutex_unlock_read(mgr->mutex);
                 return PJ_SUCCESS;
             }
 
@@ -644,7 +646,7 @@ PJ_DEF(pj_status_t) pjmedia_codec_mgr_alloc_codec(pjmedia_codec_mgr *mgr,
         factory = factory->next;
     }
 
-    pj_mutex_unlock(mgr->mutex);
+    pj_rwmutex_unlock_read(mgr->mutex);
 
     return PJMEDIA_CODEC_EUNSUP;
 }
@@ -668,7 +670,7 @@ PJ_DEF(pj_status_t) pjmedia_codec_mgr_get_default_param( pjmedia_codec_mgr *mgr,
     if (!pjmedia_codec_info_to_id(info, (char*)&codec_id, sizeof(codec_id)))
         return PJ_EINVAL;
 
-    pj_mutex_lock(mgr->mutex);
+    pj_rwmutex_lock_read(mgr->mutex);
 
     /* First, lookup default param in codec desc */
     for (i=0; i < mgr->codec_cnt; ++i) {
@@ -684,7 +686,7 @@ PJ_DEF(pj_status_t) pjmedia_codec_mgr_get_default_param( pjmedia_codec_mgr *mgr,
         pj_memcpy(param, codec_desc->param->param, 
                   sizeof(pjmedia_codec_param));
 
-        pj_mutex_unlock(mgr->mutex);
+        pj_rwmutex_unlock_read(mgr->mutex);
         return PJ_SUCCESS;
     }
 
@@ -700,7 +702,7 @@ PJ_DEF(pj_status_t) pjmedia_codec_mgr_get_default_param( pjmedia_codec_mgr *mgr,
                 if (param->info.max_bps < param->info.avg_bps)
                     param->info.max_bps = param->info.avg_bps;
 
-                pj_mutex_unlock(mgr->mutex);
+                pj_rwmutex_unlock_read(mgr->mutex);
                 return PJ_SUCCESS;
             }
 
@@ -709,7 +711,7 @@ PJ_DEF(pj_status_t) pjmedia_codec_mgr_get_default_param( pjmedia_codec_mgr *mgr,
         factory = factory->next;
     }
 
-    pj_mutex_unlock(mgr->mutex);
+    pj_rwmutex_unlock_read(mgr->mutex);
 
 
     return PJMEDIA_CODEC_EUNSUP;
@@ -735,7 +737,7 @@ PJ_DEF(pj_status_t) pjmedia_codec_mgr_set_default_param(
     if (!pjmedia_codec_info_to_id(info, (char*)&codec_id, sizeof(codec_id)))
         return PJ_EINVAL;
 
-    pj_mutex_lock(mgr->mutex);
+    pj_rwmutex_lock_write(mgr->mutex);
 
     /* Lookup codec desc */
     for (i=0; i < mgr->codec_cnt; ++i) {
@@ -747,7 +749,7 @@ PJ_DEF(pj_status_t) pjmedia_codec_mgr_set_default_param(
 
     /* Codec not found */
     if (!codec_desc) {
-        pj_mutex_unlock(mgr->mutex);
+        pj_rwmutex_unlock_write(mgr->mutex);
         return PJMEDIA_CODEC_EUNSUP;
     }
 
@@ -764,7 +766,7 @@ PJ_DEF(pj_status_t) pjmedia_codec_mgr_set_default_param(
      * default setting, just return PJ_SUCCESS.
      */
     if (NULL == param) {
-        pj_mutex_unlock(mgr->mutex);
+        pj_rwmutex_unlock_write(mgr->mutex);
         if (old_pool)
             pj_pool_release(old_pool);
         return PJ_SUCCESS;
@@ -779,11 +781,11 @@ PJ_DEF(pj_status_t) pjmedia_codec_mgr_set_default_param(
     /* Update codec param */
     p->param = pjmedia_codec_param_clone(pool, param);
     if (!p->param) {
-        pj_mutex_unlock(mgr->mutex);
+        pj_rwmutex_unlock_write(mgr->mutex);
         return PJ_EINVAL;
     }
 
-    pj_mutex_unlock(mgr->mutex);
+    pj_rwmutex_unlock_write(mgr->mutex);
 
     if (old_pool)
         pj_pool_release(old_pool);
@@ -814,14 +816,14 @@ pj_status_t pjmedia_codec_mgr_get_dyn_codecs(pjmedia_codec_mgr* mgr,
         return PJ_EINVAL;;
     }
 
-    pj_mutex_lock(mgr->mutex);
+    pj_rwmutex_lock_read(mgr->mutex);
 
     if (mgr->dyn_codecs_cnt < (unsigned)*count)
         *count = (pj_int8_t)mgr->dyn_codecs_cnt;
 
     pj_memcpy(dyn_codecs, mgr->dyn_codecs, *count * sizeof(pj_str_t));
 
-    pj_mutex_unlock(mgr->mutex);
+    pj_rwmutex_unlock_read(mgr->mutex);
 
     return PJ_SUCCESS;
 }
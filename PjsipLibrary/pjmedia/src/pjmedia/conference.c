@@ -30,6 +30,7 @@
 #include <pj/log.h>
 #include <pj/pool.h>
 #include <pj/string.h>
+#include <pj/trace.h>
 
 #if !defined(PJMEDIA_CONF_USE_SWITCH_BOARD) || PJMEDIA_CONF_USE_SWITCH_BOARD==0
 
@@ -1959,6 +1960,7 @@ static pj_status_t get_frame(pjmedia_port *this_port,
     pj_int16_t *p_in;
     
     TRACE_((THIS_FILE, "- clock -"));
+    PJ_TRACE_BEGIN("conf", "tick");
 
     /* Check that correct size is specified. */
     pj_assert(frame->size == conf->samples_per_frame *
@@ -2272,6 +2274,7 @@ static pj_status_t get_frame(pjmedia_port *this_port,
         fwrite(frame->buf, frame->size, 1, fhnd_rec);
 #endif
 
+    PJ_TRACE_END("conf", "tick");
     return PJ_SUCCESS;
 }
 
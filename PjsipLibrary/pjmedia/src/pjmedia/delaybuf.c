@@ -26,7 +26,9 @@
 #include <pj/lock.h>
 #include <pj/log.h>
 #include <pj/math.h>
+#include <pj/os.h>
 #include <pj/pool.h>
+#include <pj/ringbuf.h>
 
 
 #if 0
@@ -82,6 +84,11 @@ struct pjmedia_delay_buf
 
     /* Drift handler */
     pjmedia_wsola   *wsola;             /**< Drift handler                   */
+
+    /* Lock-free FIFO */
+    pj_ringbuf_t    *ring;              /**< Samples, when lock-free         */
+    pj_atomic_t     *reset_req;         /**< Reset requested, applied by the
+                                             consumer                        */
 };
 
 
@@ -118,6 +125,26 @@ PJ_DEF(pj_status_t) pjmedia_delay_buf_create( pj_pool_t *pool,
     b->eff_cnt = b->max_cnt >> 1;
     b->recalc_timer = RECALC_TIME;
 
+    if (options & PJMEDIA_DELAY_BUF_LOCK_FREE) {
+        /* Leave one frame of room above the maximum delay, which the
+         * consumer trims, so the producer can always write.
+         */
+        status = pj_ringbuf_create(pool, sizeof(pj_int16_t),
+                                   b->max_cnt + samples_per_frame,
+                                   &b->ring);
+        if (status != PJ_SUCCESS)
+            return status;
+
+        status = pj_atomic_create(pool, 0, &b->reset_req);
+        if (status != PJ_SUCCESS)
+            return status;
+
+        PJ_LOG(5, (b->obj_name, "Using lock-free FIFO delay buffer."));
+
+        *p_b = b;
+        return PJ_SUCCESS;
+    }
+
     /* Create circular buffer */
     status = pjmedia_circ_buf_create(pool, b->max_cnt, &b->circ_buf);
     if (status != PJ_SUCCESS)
@@ -153,6 +180,12 @@ PJ_DEF(pj_status_t) pjmedia_delay_buf_destroy(pjmedia_delay_buf *b)
 
     PJ_ASSERT_RETURN(b, PJ_EINVAL);
 
+    if (b->ring) {
+        pj_atomic_destroy(b->reset_req);
+        b->reset_req = NULL;
+        return pj_ringbuf_destroy(b->ring);
+    }
+
     pj_lock_acquire(b->lock);
 
     if (b->wsola) {
@@ -259,6 +292,59 @@ static void update(pjmedia_delay_buf *b, enum OP op)
     }
 }
 
+/* Lock-free put, called by the producer only */
+static pj_status_t ring_put(pjmedia_delay_buf *b, const pj_int16_t frame[])
+{
+    if (pj_ringbuf_write_avail(b->ring) < b->samples_per_frame) {
+        /* The consumer has not trimmed the buffer for a while */
+        TRACE__((b->obj_name, "Buffer full, dropping new frame"));
+        return PJ_ETOOMANY;
+    }
+
+    pj_ringbuf_write(b->ring, frame, b->samples_per_frame);
+    return PJ_SUCCESS;
+}
+
+/* Lock-free get, called by the consumer only */
+static pj_status_t ring_get(pjmedia_delay_buf *b, pj_int16_t frame[])
+{
+    unsigned buf_len;
+
+    buf_len = pj_ringbuf_read_avail(b->ring);
+
+    if (pj_atomic_get(b->reset_req)) {
+        pj_atomic_set(b->reset_req, 0);
+        pj_ringbuf_skip(b->ring, buf_len);
+        buf_len = 0;
+    }
+
+    /* Drop the eldest samples above the maximum delay */
+    if (buf_len > b->max_cnt) {
+        unsigned erase_cnt = buf_len - b->max_cnt;
+
+        pj_ringbuf_skip(b->ring, erase_cnt);
+        buf_len -= erase_cnt;
+
+        PJ_LOG(4,(b->obj_name,"Dropping %d eldest samples, buf_cnt=%d",
+                  erase_cnt, buf_len));
+    }
+
+    /* Starvation checking */
+    if (buf_len < b->samples_per_frame) {
+        PJ_LOG(4,(b->obj_name,"Underflow, buf_cnt=%d, will generate 1 frame",
+                  buf_len));
+
+        /* Give all what delay buffer has, then pad with zeroes */
+        pj_ringbuf_read(b->ring, frame, buf_len);
+        pjmedia_zero_samples(&frame[buf_len],
+                             b->samples_per_frame - buf_len);
+        return PJ_SUCCESS;
+    }
+
+    pj_ringbuf_read(b->ring, frame, b->samples_per_frame);
+    return PJ_SUCCESS;
+}
+
 PJ_DEF(pj_status_t) pjmedia_delay_buf_put(pjmedia_delay_buf *b,
                                            pj_int16_t frame[])
 {
@@ -266,6 +352,9 @@ PJ_DEF(pj_status_t) pjmedia_delay_buf_put(pjmedia_delay_buf *b,
 
     PJ_ASSERT_RETURN(b && frame, PJ_EINVAL);
 
+    if (b->ring)
+        return ring_put(b, frame);
+
     pj_lock_acquire(b->lock);
 
     if (b->wsola) {
@@ -324,6 +413,9 @@ PJ_DEF(pj_status_t) pjmedia_delay_buf_get( pjmedia_delay_buf *b,
 
     PJ_ASSERT_RETURN(b && frame, PJ_EINVAL);
 
+    if (b->ring)
+        return ring_get(b, frame);
+
     pj_lock_acquire(b->lock);
 
     if (b->wsola)
@@ -383,6 +475,13 @@ PJ_DEF(pj_status_t) pjmedia_delay_buf_reset(pjmedia_delay_buf *b)
 {
     PJ_ASSERT_RETURN(b, PJ_EINVAL);
 
+    if (b->ring) {
+        /* The consumer empties the buffer on its next get() */
+        pj_atomic_set(b->reset_req, 1);
+        PJ_LOG(5,(b->obj_name,"Delay buffer reset requested"));
+        return PJ_SUCCESS;
+    }
+
     pj_lock_acquire(b->lock);
 
     b->recalc_timer = RECALC_TIME;
@@ -87,6 +87,15 @@ struct pjmedia_endpt
     /** Do we own the ioqueue? */
     pj_bool_t             own_ioqueue;
 
+    /** Additional ioqueues registered by application. */
+    pj_ioqueue_t         *ext_ioqueue[MAX_THREADS];
+
+    /** Number of additional ioqueues. */
+    unsigned              ext_ioqueue_cnt;
+
+    /** Round-robin counter for selecting the ioqueue for new sockets. */
+    pj_atomic_t          *next_ioqueue;
+
     /** Number of threads. */
     unsigned              thread_cnt;
 
@@ -230,6 +239,11 @@ PJ_DEF(pj_status_t) pjmedia_endpt_destroy2 (pjmedia_endpt *endpt)
         endpt->ioqueue = NULL;
     }
 
+    if (endpt->next_ioqueue) {
+        pj_atomic_destroy(endpt->next_ioqueue);
+        endpt->next_ioqueue = NULL;
+    }
+
     endpt->pf = NULL;
 
     pjmedia_codec_mgr_destroy(&endpt->codec_mgr);
@@ -290,6 +304,44 @@ PJ_DEF(pj_ioqueue_t*) pjmedia_endpt_get_ioqueue(pjmedia_endpt *endpt)
     return endpt->ioqueue;
 }
 
+/**
+ * Add an ioqueue for the media sockets.
+ */
+PJ_DEF(pj_status_t) pjmedia_endpt_add_ioqueue(pjmedia_endpt *endpt,
+                                              pj_ioqueue_t *ioqueue)
+{
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(endpt && ioqueue, PJ_EINVAL);
+    PJ_ASSERT_RETURN(endpt->ext_ioqueue_cnt < MAX_THREADS, PJ_ETOOMANY);
+
+    if (endpt->next_ioqueue == NULL) {
+        status = pj_atomic_create(endpt->pool, 0, &endpt->next_ioqueue);
+        if (status != PJ_SUCCESS)
+            return status;
+    }
+
+    endpt->ext_ioqueue[endpt->ext_ioqueue_cnt++] = ioqueue;
+    return PJ_SUCCESS;
+}
+
+/**
+ * Get the ioqueue for a new media socket.
+ */
+PJ_DEF(pj_ioqueue_t*) pjmedia_endpt_next_ioqueue(pjmedia_endpt *endpt)
+{
+    unsigned idx;
+
+    PJ_ASSERT_RETURN(endpt, NULL);
+
+    if (endpt->ext_ioqueue_cnt == 0)
+        return endpt->ioqueue;
+
+    idx = (unsigned)pj_atomic_inc_and_get(endpt->next_ioqueue) %
+          (endpt->ext_ioqueue_cnt + 1);
+    return idx ? endpt->ext_ioqueue[idx-1] : endpt->ioqueue;
+}
+
 /**
  * Get the number of worker threads in media endpoint.
  */
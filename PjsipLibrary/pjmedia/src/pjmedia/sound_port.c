@@ -23,12 +23,18 @@
 #include <pjmedia/errno.h>
 #include <pj/assert.h>
 #include <pj/log.h>
+#include <pj/os.h>
 #include <pj/rand.h>
+#include <pj/ringbuf.h>
 #include <pj/string.h>      /* pj_memset() */
 
 #define AEC_TAIL            128     /* default AEC length in ms */
 #define AEC_SUSPEND_LIMIT   5       /* seconds of no activity   */
 
+/* With PJMEDIA_SND_PORT_MEDIA_THREAD */
+#define MT_PLAY_FRAMES      2       /* frames queued for playback */
+#define MT_RING_FRAMES      8       /* ring buffer size, in frames */
+
 #define THIS_FILE           "sound_port.c"
 
 //#define TEST_OVERFLOW_UNDERFLOW
@@ -65,21 +71,39 @@ struct pjmedia_snd_port
     void                *user_data;
     pjmedia_aud_play_cb  on_play_frame;
     pjmedia_aud_rec_cb   on_rec_frame;
+
+    /* media thread, with PJMEDIA_SND_PORT_MEDIA_THREAD */
+    pj_thread_t         *mt_thread;
+    pj_sem_t            *mt_sem;
+    pj_bool_t            mt_quit;
+    pj_ringbuf_t        *mt_play_rb;
+    pj_ringbuf_t        *mt_play_ts_rb;
+    pj_ringbuf_t        *mt_rec_rb;
+    pj_ringbuf_t        *mt_rec_ts_rb;
+    unsigned             mt_frame_size;
+    void                *mt_buf;
+    pj_uint32_t          mt_play_cnt;
 };
 
+/* A frame from the media thread played by the device, with its device
+ * timestamp.
+ */
+typedef struct mt_play_ts
+{
+    pj_uint32_t          idx;
+    pj_timestamp         ts;
+} mt_play_ts;
+
 /*
- * The callback called by sound player when it needs more samples to be
- * played.
+ * Get a frame to be played from the downstream port, and feed it to the
+ * echo canceller.
  */
-static pj_status_t play_cb(void *user_data, pjmedia_frame *frame)
+static void get_play_frame(pjmedia_snd_port *snd_port, pjmedia_frame *frame)
 {
-    pjmedia_snd_port *snd_port = (pjmedia_snd_port*) user_data;
     pjmedia_port *port;
     const unsigned required_size = (unsigned)frame->size;
     pj_status_t status;
 
-    pjmedia_clock_src_update(&snd_port->play_clocksrc, &frame->timestamp);
-
     port = snd_port->port;
     if (port == NULL)
         goto no_frame;
@@ -104,11 +128,7 @@ static pj_status_t play_cb(void *user_data, pjmedia_frame *frame)
         pjmedia_echo_playback(snd_port->ec_state, (pj_int16_t*)frame->buf);
     }
 
-    /* Invoke preview callback */
-    if (snd_port->on_play_frame)
-        (*snd_port->on_play_frame)(snd_port->user_data, frame);
-
-    return PJ_SUCCESS;
+    return;
 
 no_frame:
     frame->type = PJMEDIA_FRAME_TYPE_AUDIO;
@@ -126,6 +146,40 @@ no_frame:
             pjmedia_echo_playback(snd_port->ec_state, (pj_int16_t*)frame->buf);
         }
     }
+}
+
+
+/*
+ * Cancel echo from a captured frame and pass it to the downstream port.
+ */
+static void put_rec_frame(pjmedia_snd_port *snd_port, pjmedia_frame *frame)
+{
+    pjmedia_port *port;
+
+    port = snd_port->port;
+    if (port == NULL)
+        return;
+
+    /* Cancel echo */
+    if (snd_port->ec_state && !snd_port->ec_suspended) {
+        pjmedia_echo_capture(snd_port->ec_state, (pj_int16_t*) frame->buf, 0);
+    }
+
+    pjmedia_port_put_frame(port, frame);
+}
+
+
+/*
+ * The callback called by sound player when it needs more samples to be
+ * played.
+ */
+static pj_status_t play_cb(void *user_data, pjmedia_frame *frame)
+{
+    pjmedia_snd_port *snd_port = (pjmedia_snd_port*) user_data;
+
+    pjmedia_clock_src_update(&snd_port->play_clocksrc, &frame->timestamp);
+
+    get_play_frame(snd_port, frame);
 
     /* Invoke preview callback */
     if (snd_port->on_play_frame)
@@ -142,7 +196,6 @@ no_frame:
 static pj_status_t rec_cb(void *user_data, pjmedia_frame *frame)
 {
     pjmedia_snd_port *snd_port = (pjmedia_snd_port*) user_data;
-    pjmedia_port *port;
 
     pjmedia_clock_src_update(&snd_port->cap_clocksrc, &frame->timestamp);
 
@@ -150,21 +203,253 @@ static pj_status_t rec_cb(void *user_data, pjmedia_frame *frame)
     if (snd_port->on_rec_frame)
         (*snd_port->on_rec_frame)(snd_port->user_data, frame);
 
-    port = snd_port->port;
-    if (port == NULL)
-        return PJ_SUCCESS;
+    put_rec_frame(snd_port, frame);
 
-    /* Cancel echo */
-    if (snd_port->ec_state && !snd_port->ec_suspended) {
-        pjmedia_echo_capture(snd_port->ec_state, (pj_int16_t*) frame->buf, 0);
+    return PJ_SUCCESS;
+}
+
+
+/*
+ * The callback called by sound player when it needs more samples to be
+ * played. This version is for PJMEDIA_SND_PORT_MEDIA_THREAD, it takes
+ * the frame prepared by the media thread and never blocks.
+ */
+static pj_status_t play_cb_mt(void *user_data, pjmedia_frame *frame)
+{
+    pjmedia_snd_port *snd_port = (pjmedia_snd_port*) user_data;
+
+    pjmedia_clock_src_update(&snd_port->play_clocksrc, &frame->timestamp);
+
+    pj_assert(frame->size == snd_port->mt_frame_size);
+
+    if (pj_ringbuf_read_avail(snd_port->mt_play_rb) > 0) {
+        mt_play_ts played;
+
+        /* Tell the media thread when this frame is played. This is done
+         * before the frame is taken, so the media thread has it when it
+         * sees the free slot. It is dropped if the media thread is lagging.
+         */
+        played.idx = snd_port->mt_play_cnt++;
+        played.ts = frame->timestamp;
+        pj_ringbuf_write(snd_port->mt_play_ts_rb, &played, 1);
+
+        pj_ringbuf_read(snd_port->mt_play_rb, frame->buf, 1);
+    } else {
+        /* Play silence if the media thread is lagging */
+        pj_bzero(frame->buf, frame->size);
     }
+    frame->type = PJMEDIA_FRAME_TYPE_AUDIO;
 
-    pjmedia_port_put_frame(port, frame);
+    /* Wake up the media thread to prepare the next frame */
+    pj_sem_post(snd_port->mt_sem);
+
+    /* Invoke preview callback */
+    if (snd_port->on_play_frame)
+        (*snd_port->on_play_frame)(snd_port->user_data, frame);
+
+    return PJ_SUCCESS;
+}
 
 
+/*
+ * The callback called by sound recorder when it has finished capturing a
+ * frame. This version is for PJMEDIA_SND_PORT_MEDIA_THREAD, it queues the
+ * frame for the media thread and never blocks.
+ */
+static pj_status_t rec_cb_mt(void *user_data, pjmedia_frame *frame)
+{
+    pjmedia_snd_port *snd_port = (pjmedia_snd_port*) user_data;
+
+    pjmedia_clock_src_update(&snd_port->cap_clocksrc, &frame->timestamp);
+
+    /* Invoke preview callback */
+    if (snd_port->on_rec_frame)
+        (*snd_port->on_rec_frame)(snd_port->user_data, frame);
+
+    pj_assert(frame->size == snd_port->mt_frame_size);
+
+    /* The frame is dropped if the media thread is lagging. Both rings have
+     * the same size, and the timestamp is written first so that it is
+     * there when the media thread sees the frame.
+     */
+    if (pj_ringbuf_write_avail(snd_port->mt_rec_rb) > 0) {
+        pj_ringbuf_write(snd_port->mt_rec_ts_rb, &frame->timestamp, 1);
+        pj_ringbuf_write(snd_port->mt_rec_rb, frame->buf, 1);
+    }
+    pj_sem_post(snd_port->mt_sem);
+
     return PJ_SUCCESS;
 }
 
+
+/*
+ * Media thread, with PJMEDIA_SND_PORT_MEDIA_THREAD. It passes captured
+ * frames downstream and keeps MT_PLAY_FRAMES frames queued for playback.
+ * Captured frames keep the timestamp given by the device. Frames to be
+ * played get the timestamp the device will give them, counted from the
+ * last frame the device has played.
+ */
+static int media_thread(void *arg)
+{
+    pjmedia_snd_port *snd_port = (pjmedia_snd_port*) arg;
+    pjmedia_frame frame;
+    mt_play_ts played[MT_RING_FRAMES];
+    mt_play_ts last;
+    pj_uint32_t play_idx;
+    unsigned ts_inc, cnt;
+    int max;
+
+    /* Run at the priority of the audio device threads, if possible */
+    max = pj_thread_get_prio_max(pj_thread_this());
+    if (max > 0)
+        pj_thread_set_prio(pj_thread_this(), max);
+
+    ts_inc = snd_port->samples_per_frame / snd_port->channel_count;
+
+    /* Until the device has played a frame, count from zero */
+    play_idx = 0;
+    last.idx = 0;
+    last.ts.u64 = 0;
+
+    while (!snd_port->mt_quit) {
+        /* Captured frames */
+        while (snd_port->mt_rec_rb &&
+               pj_ringbuf_read(snd_port->mt_rec_rb, snd_port->mt_buf, 1))
+        {
+            pj_bzero(&frame, sizeof(frame));
+            frame.type = PJMEDIA_FRAME_TYPE_AUDIO;
+            frame.buf = snd_port->mt_buf;
+            frame.size = snd_port->mt_frame_size;
+            pj_ringbuf_read(snd_port->mt_rec_ts_rb, &frame.timestamp, 1);
+
+            put_rec_frame(snd_port, &frame);
+        }
+
+        if (snd_port->mt_play_rb == NULL) {
+            pj_sem_wait(snd_port->mt_sem);
+            continue;
+        }
+
+        /* Frames to be played */
+        while (pj_ringbuf_get_capacity(snd_port->mt_play_rb) -
+               pj_ringbuf_write_avail(snd_port->mt_play_rb) < MT_PLAY_FRAMES)
+        {
+            /* The last frame played by the device */
+            cnt = pj_ringbuf_read(snd_port->mt_play_ts_rb, played,
+                                  PJ_ARRAY_SIZE(played));
+            if (cnt > 0)
+                last = played[cnt-1];
+
+            pj_bzero(&frame, sizeof(frame));
+            frame.type = PJMEDIA_FRAME_TYPE_AUDIO;
+            frame.buf = snd_port->mt_buf;
+            frame.size = snd_port->mt_frame_size;
+            frame.timestamp.u64 = last.ts.u64 +
+                                  (pj_uint64_t)(play_idx - last.idx) * ts_inc;
+
+            get_play_frame(snd_port, &frame);
+            pj_ringbuf_write(snd_port->mt_play_rb, snd_port->mt_buf, 1);
+            ++play_idx;
+        }
+
+        pj_sem_wait(snd_port->mt_sem);
+    }
+
+    return 0;
+}
+
+
+/*
+ * Stop the media thread and release its resources. This is called after
+ * the audio stream is destroyed.
+ */
+static void destroy_media_thread(pjmedia_snd_port *snd_port)
+{
+    if (snd_port->mt_thread) {
+        snd_port->mt_quit = PJ_TRUE;
+        pj_sem_post(snd_port->mt_sem);
+        pj_thread_join(snd_port->mt_thread);
+        pj_thread_destroy(snd_port->mt_thread);
+        snd_port->mt_thread = NULL;
+    }
+    if (snd_port->mt_sem) {
+        pj_sem_destroy(snd_port->mt_sem);
+        snd_port->mt_sem = NULL;
+    }
+    if (snd_port->mt_play_rb) {
+        pj_ringbuf_destroy(snd_port->mt_play_rb);
+        snd_port->mt_play_rb = NULL;
+    }
+    if (snd_port->mt_play_ts_rb) {
+        pj_ringbuf_destroy(snd_port->mt_play_ts_rb);
+        snd_port->mt_play_ts_rb = NULL;
+    }
+    if (snd_port->mt_rec_rb) {
+        pj_ringbuf_destroy(snd_port->mt_rec_rb);
+        snd_port->mt_rec_rb = NULL;
+    }
+    if (snd_port->mt_rec_ts_rb) {
+        pj_ringbuf_destroy(snd_port->mt_rec_ts_rb);
+        snd_port->mt_rec_ts_rb = NULL;
+    }
+}
+
+
+/*
+ * Create the media thread and its ring buffers. This is done once per
+ * sound port, before the audio stream is created.
+ */
+static pj_status_t create_media_thread(pj_pool_t *pool,
+                                       pjmedia_snd_port *snd_port)
+{
+    pj_status_t status;
+
+    snd_port->mt_frame_size = snd_port->samples_per_frame *
+                              snd_port->bits_per_sample / 8;
+    snd_port->mt_buf = pj_pool_alloc(pool, snd_port->mt_frame_size);
+
+    if (snd_port->dir & PJMEDIA_DIR_PLAYBACK) {
+        status = pj_ringbuf_create(pool, snd_port->mt_frame_size,
+                                   MT_RING_FRAMES, &snd_port->mt_play_rb);
+        if (status != PJ_SUCCESS)
+            goto on_error;
+
+        status = pj_ringbuf_create(pool, sizeof(mt_play_ts),
+                                   MT_RING_FRAMES, &snd_port->mt_play_ts_rb);
+        if (status != PJ_SUCCESS)
+            goto on_error;
+    }
+
+    if (snd_port->dir & PJMEDIA_DIR_CAPTURE) {
+        status = pj_ringbuf_create(pool, snd_port->mt_frame_size,
+                                   MT_RING_FRAMES, &snd_port->mt_rec_rb);
+        if (status != PJ_SUCCESS)
+            goto on_error;
+
+        status = pj_ringbuf_create(pool, sizeof(pj_timestamp),
+                                   MT_RING_FRAMES, &snd_port->mt_rec_ts_rb);
+        if (status != PJ_SUCCESS)
+            goto on_error;
+    }
+
+    status = pj_sem_create(pool, "snd_mt%p", 0, 2 * MT_RING_FRAMES,
+                           &snd_port->mt_sem);
+    if (status != PJ_SUCCESS)
+        goto on_error;
+
+    snd_port->mt_quit = PJ_FALSE;
+    status = pj_thread_create(pool, "snd_mt%p", &media_thread, snd_port,
+                              0, 0, &snd_port->mt_thread);
+    if (status != PJ_SUCCESS)
+        goto on_error;
+
+    return PJ_SUCCESS;
+
+on_error:
+    destroy_media_thread(snd_port);
+    return status;
+}
+
 /*
  * The callback called by sound player when it needs more samples to be
  * played. This version is for non-PCM data.
@@ -280,7 +565,10 @@ static pj_status_t start_sound_device( pj_pool_t *pool,
     }
 
     /* Use different callback if format is not PCM */
-    if (snd_port->aud_param.ext_fmt.id == PJMEDIA_FORMAT_L16) {
+    if (snd_port->mt_thread) {
+        snd_rec_cb = &rec_cb_mt;
+        snd_play_cb = &play_cb_mt;
+    } else if (snd_port->aud_param.ext_fmt.id == PJMEDIA_FORMAT_L16) {
         snd_rec_cb = &rec_cb;
         snd_play_cb = &play_cb;
     } else {
@@ -356,6 +644,9 @@ static pj_status_t stop_sound_device( pjmedia_snd_port *snd_port )
         snd_port->aud_stream = NULL;
     }
 
+    /* No more callbacks, so the media thread can go */
+    destroy_media_thread(snd_port);
+
     /* Destroy AEC */
     if (snd_port->ec_state) {
         pjmedia_echo_destroy(snd_port->ec_state);
@@ -508,6 +799,10 @@ PJ_DEF(pj_status_t) pjmedia_snd_port_create2(pj_pool_t *pool,
     snd_port->bits_per_sample = prm->base.bits_per_sample;
     pj_memcpy(&snd_port->aud_param, &prm->base, sizeof(snd_port->aud_param));
     snd_port->options = prm->options;
+    if (snd_port->options & PJMEDIA_SND_PORT_NO_MEDIA_THREAD)
+        snd_port->options &= ~PJMEDIA_SND_PORT_MEDIA_THREAD;
+    else if (PJMEDIA_SND_PORT_USE_MEDIA_THREAD)
+        snd_port->options |= PJMEDIA_SND_PORT_MEDIA_THREAD;
     snd_port->prm_ec_options = prm->ec_options;
     snd_port->user_data = prm->user_data;
     snd_port->on_play_frame = prm->on_play_frame;
@@ -520,6 +815,19 @@ PJ_DEF(pj_status_t) pjmedia_snd_port_create2(pj_pool_t *pool,
     pjmedia_clock_src_init(&snd_port->play_clocksrc, PJMEDIA_TYPE_AUDIO,
                            snd_port->clock_rate, ptime_usec);
     
+    /* The media thread lives as long as the port, and it must be running
+     * before the audio callbacks are called.
+     */
+    if ((snd_port->options & PJMEDIA_SND_PORT_MEDIA_THREAD) &&
+        snd_port->aud_param.ext_fmt.id == PJMEDIA_FORMAT_L16)
+    {
+        status = create_media_thread(pool, snd_port);
+        if (status != PJ_SUCCESS) {
+            pjmedia_snd_port_destroy(snd_port);
+            return status;
+        }
+    }
+
     /* Start sound device immediately.
      * If there's no port connected, the sound callback will return
      * empty signal.
@@ -33,6 +33,7 @@
 #include <pj/rand.h>
 #include <pj/sock_select.h>
 #include <pj/string.h>      /* memcpy() */
+#include <pj/trace.h>
 
 
 #define THIS_FILE                       "stream.c"
@@ -137,6 +138,13 @@ struct pjmedia_stream
     unsigned                 enc_buf_pos;   /**< First position in buf.     */
     unsigned                 enc_buf_count; /**< Number of samples in the
                                                  encoding buffer.           */
+    char                    *tx_batch_buf;  /**< Copies of the RTP packets
+                                                 of one put_frame(), when
+                                                 enc_buf is used. Otherwise
+                                                 it's NULL.                 */
+    const void              *tx_batch_pkt[PJMEDIA_STREAM_TX_BATCH];
+    pj_size_t                tx_batch_size[PJMEDIA_STREAM_TX_BATCH];
+    unsigned                 tx_batch_cnt;  /**< Number of queued packets.  */
 
     pj_int16_t              *dec_buf;       /**< Decoding buffer.           */
     unsigned                 dec_buf_size;  /**< Decoding buffer size, in
@@ -548,6 +556,8 @@ static pj_status_t get_frame( pjmedia_port *port, pjmedia_frame *frame)
         return PJ_SUCCESS;
     }
 
+    PJ_TRACE_BEGIN("stream", "get_frame");
+
     /* Repeat get frame from the jitter buffer and decode the frame
      * until we have enough frames according to codec's ptime.
      */
@@ -821,6 +831,7 @@ static pj_status_t get_frame( pjmedia_port *port, pjmedia_frame *frame)
         frame->timestamp.u64 = 0;
     }
 
+    PJ_TRACE_END("stream", "get_frame");
     return PJ_SUCCESS;
 }
 
@@ -1328,6 +1339,77 @@ static void rebuffer(pjmedia_stream *stream,
 }
 
 
+/*
+ * Send the RTP packets queued by queue_rtp().
+ */
+static void flush_rtp(pjmedia_stream *stream)
+{
+    const pjmedia_rtp_hdr *hdr;
+    unsigned i, cnt;
+    pj_status_t status;
+
+    cnt = stream->tx_batch_cnt;
+    if (cnt == 0)
+        return;
+
+    PJ_TRACE_BEGIN("stream", "tx_rtp_batch");
+    status = pjmedia_transport_send_rtp_batch(stream->transport,
+                                              stream->tx_batch_pkt,
+                                              stream->tx_batch_size,
+                                              cnt);
+    PJ_TRACE_END("stream", "tx_rtp_batch");
+    stream->tx_batch_cnt = 0;
+
+    if (status != PJ_SUCCESS) {
+        if (stream->rtp_tx_err_cnt++ == 0) {
+            LOGERR_((stream->port.info.name.ptr, status, "Error sending RTP"));
+        }
+        if (stream->rtp_tx_err_cnt > SEND_ERR_COUNT_TO_REPORT) {
+            stream->rtp_tx_err_cnt = 0;
+        }
+        return;
+    }
+
+    /* Update stat. The queued packets only have the fixed RTP header, as
+     * in put_frame_imp().
+     */
+    for (i = 0; i < cnt; ++i) {
+        pjmedia_rtcp_tx_rtp(&stream->rtcp,
+                            (unsigned)(stream->tx_batch_size[i] -
+                                       sizeof(pjmedia_rtp_hdr)));
+    }
+    hdr = (const pjmedia_rtp_hdr*) stream->tx_batch_pkt[cnt-1];
+    stream->rtcp.stat.rtp_tx_last_ts = pj_ntohl(hdr->ts);
+    stream->rtcp.stat.rtp_tx_last_seq = pj_ntohs(hdr->seq);
+
+#if defined(PJMEDIA_STREAM_ENABLE_KA) && PJMEDIA_STREAM_ENABLE_KA!=0
+    /* Update time of last sending packet. */
+    pj_gettimeofday(&stream->last_frm_ts_sent);
+#endif
+}
+
+
+/*
+ * Queue a copy of the RTP packet, to be sent by flush_rtp() together with
+ * the other packets of the same put_frame().
+ */
+static void queue_rtp(pjmedia_stream *stream, const void *pkt,
+                      pj_size_t size)
+{
+    char *buf;
+
+    if (stream->tx_batch_cnt == PJMEDIA_STREAM_TX_BATCH)
+        flush_rtp(stream);
+
+    buf = stream->tx_batch_buf +
+          stream->tx_batch_cnt * stream->enc->out_pkt_size;
+    pj_memcpy(buf, pkt, size);
+    stream->tx_batch_pkt[stream->tx_batch_cnt] = buf;
+    stream->tx_batch_size[stream->tx_batch_cnt] = size;
+    ++stream->tx_batch_cnt;
+}
+
+
 /**
  * put_frame_imp()
  */
@@ -1576,10 +1658,23 @@ static pj_status_t put_frame_imp( pjmedia_port *port,
 
     stream->is_streaming = PJ_TRUE;
 
+    /* Queue the RTP packet when put_frame() sends the packets of the whole
+     * frame in one batch. It is counted in the stat by flush_rtp(), once
+     * it has been sent.
+     */
+    if (stream->tx_batch_buf) {
+        queue_rtp(stream, channel->out_pkt,
+                  frame_out.size + sizeof(pjmedia_rtp_hdr));
+        return PJ_SUCCESS;
+    }
+
     /* Send the RTP packet to the transport. */
-    status = pjmedia_transport_send_rtp(stream->transport, channel->out_pkt,
+    PJ_TRACE_BEGIN("stream", "tx_rtp");
+    status = pjmedia_transport_send_rtp(stream->transport,
+                                        channel->out_pkt,
                                         frame_out.size +
                                             sizeof(pjmedia_rtp_hdr));
+    PJ_TRACE_END("stream", "tx_rtp");
 
     if (status != PJ_SUCCESS) {
         if (stream->rtp_tx_err_cnt++ == 0) {
@@ -1708,6 +1803,9 @@ static pj_status_t put_frame( pjmedia_port *port,
             }
         }
 
+        /* Send the packets of this frame */
+        flush_rtp(stream);
+
         return status;
 
     } else {
@@ -1895,6 +1993,8 @@ static void on_rx_rtp( pjmedia_tp_cb_param *param)
     if (bytes_read < (pj_ssize_t) sizeof(pjmedia_rtp_hdr))
         return;
 
+    PJ_TRACE_INSTANT("stream", "rx_rtp", bytes_read);
+
     /* Update RTP and RTCP session. */
     status = pjmedia_rtp_decode_rtp(&channel->rtp, pkt, (int)bytes_read,
                                     &hdr, &payload, &payloadlen);
@@ -2205,6 +2305,7 @@ static void on_rx_rtp( pjmedia_tp_cb_param *param)
 #endif
 
         /* Put each frame to jitter buffer. */
+        PJ_TRACE_BEGIN("stream", "jb_put");
         for (i=0; i<count; ++i) {
             unsigned ext_seq;
             pj_bool_t discarded;
@@ -2215,6 +2316,7 @@ static void on_rx_rtp( pjmedia_tp_cb_param *param)
             if (discarded)
                 pkt_discarded = PJ_TRUE;
         }
+        PJ_TRACE_END("stream", "jb_put");
 
 #if TRACE_JB
         trace_jb_put(stream, hdr, payloadlen, count);
@@ -2836,6 +2938,15 @@ PJ_DEF(pj_status_t) pjmedia_stream_create( pjmedia_endpt *endpt,
     if (status != PJ_SUCCESS)
         goto err_cleanup;
 
+    /* When the encoder ptime is shorter, one put_frame() yields several
+     * RTP packets, send them in one batch.
+     */
+    if (stream->enc_buf && PJMEDIA_STREAM_TX_BATCH > 1) {
+        stream->tx_batch_buf = (char*)
+                               pj_pool_alloc(pool, PJMEDIA_STREAM_TX_BATCH *
+                                                   stream->enc->out_pkt_size);
+    }
+
 
     /* Init RTCP session: */
 
@@ -22,6 +22,7 @@
 #include <pj/assert.h>
 #include <pj/errno.h>
 #include <pj/ioqueue.h>
+#include <pj/lock.h>
 #include <pj/log.h>
 #include <pj/pool.h>
 #include <pj/rand.h>
@@ -40,6 +41,9 @@
 /* Maximum pending write operations */
 #define MAX_PENDING 4
 
+/* Maximum packets per pj_ioqueue_sendto_batch() in send_rtp_batch() */
+#define SEND_BATCH  16
+
 #if 1
 #  define TRACE_(expr)
 #else
@@ -69,6 +73,10 @@ struct transport_udp
     pj_sockaddr         rem_rtp_addr;   /**< Remote RTP address             */
     pj_sockaddr         rem_rtcp_addr;  /**< Remote RTCP address            */
     int                 addr_len;       /**< Length of addresses.           */
+    pj_seqlock_t       *addr_lock;      /**< Protects the remote addresses,
+                                             which the receive callbacks
+                                             may switch while the media
+                                             thread is sending.             */
     void  (*rtp_cb)(    void*,          /**< To report incoming RTP.        */
                         void*,
                         pj_ssize_t);
@@ -90,6 +98,15 @@ struct transport_udp
     pj_sockaddr         rtp_src_addr;   /**< Actual packet src addr.        */
     int                 rtp_addrlen;    /**< Address length.                */
     char                rtp_pkt[RTP_LEN];/**< Incoming RTP packet buffer    */
+#if PJMEDIA_TRANSPORT_UDP_RECV_BATCH > 1
+    pj_sock_mmsg        rtp_batch[PJMEDIA_TRANSPORT_UDP_RECV_BATCH];
+                                        /**< Drained RTP packets.           */
+    unsigned            rtp_batch_cnt;  /**< Number of drained packets.     */
+    unsigned            rtp_batch_pos;  /**< Next drained packet.           */
+    pj_bool_t           rtp_batch_drained;/**< Socket found empty?          */
+    char                rtp_batch_buf[PJMEDIA_TRANSPORT_UDP_RECV_BATCH-1]
+                                     [RTP_LEN];/**< Drained packet buffers  */
+#endif
 
     pj_bool_t           enable_rtcp_mux;/**< Enable RTP & RTCP multiplexing?*/
     pj_bool_t           use_rtcp_mux;   /**< Use RTP & RTCP multiplexing?   */
@@ -141,6 +158,10 @@ static void        transport_detach   (pjmedia_transport *tp,
 static pj_status_t transport_send_rtp( pjmedia_transport *tp,
                                        const void *pkt,
                                        pj_size_t size);
+static pj_status_t transport_send_rtp_batch(pjmedia_transport *tp,
+                                            const void *pkt[],
+                                            const pj_size_t size[],
+                                            unsigned count);
 static pj_status_t transport_send_rtcp(pjmedia_transport *tp,
                                        const void *pkt,
                                        pj_size_t size);
@@ -186,7 +207,8 @@ static pjmedia_transport_op transport_udp_op =
     &transport_media_stop,
     &transport_simulate_lost,
     &transport_destroy,
-    &transport_attach2
+    &transport_attach2,
+    &transport_send_rtp_batch
 };
 
 static const pj_str_t STR_RTCP_MUX      = { "rtcp-mux", 8 };
@@ -307,7 +329,7 @@ PJ_DEF(pj_status_t) pjmedia_transport_udp_attach( pjmedia_endpt *endpt,
     PJ_ASSERT_RETURN(endpt && si && p_tp, PJ_EINVAL);
 
     /* Get ioqueue instance */
-    ioqueue = pjmedia_endpt_get_ioqueue(endpt);
+    ioqueue = pjmedia_endpt_next_ioqueue(endpt);
 
     if (name==NULL)
         name = "udp%p";
@@ -359,6 +381,11 @@ PJ_DEF(pj_status_t) pjmedia_transport_udp_attach( pjmedia_endpt *endpt,
     pj_grp_lock_add_handler(grp_lock, pool, tp, &transport_on_destroy);
     tp->base.grp_lock = grp_lock;
 
+    /* Create the remote address lock */
+    status = pj_seqlock_create(pool, NULL, &tp->addr_lock);
+    if (status != PJ_SUCCESS)
+        goto on_error;
+
     /* Setup RTP socket with the ioqueue */
     pj_bzero(&rtp_cb, sizeof(rtp_cb));
     rtp_cb.on_read_complete = &on_rx_rtp;
@@ -443,6 +470,10 @@ static void transport_on_destroy(void *arg)
     struct transport_udp *udp = (struct transport_udp*) arg;
 
     PJ_LOG(4, (udp->base.name, "UDP media transport destroyed"));
+    if (udp->addr_lock) {
+        pj_seqlock_destroy(udp->addr_lock);
+        udp->addr_lock = NULL;
+    }
     pj_pool_safe_release(&udp->pool);
 }
 
@@ -490,9 +521,28 @@ static pj_status_t transport_destroy(pjmedia_transport *tp)
     return PJ_SUCCESS;
 }
 
+/* Get a copy of the remote RTP or RTCP address, returns the address
+ * length.
+ */
+static int get_rem_addr(struct transport_udp *udp, pj_bool_t rtcp,
+                        pj_sockaddr *addr)
+{
+    unsigned seq;
+    int addr_len;
+
+    do {
+        seq = pj_seqlock_read_begin(udp->addr_lock);
+        pj_memcpy(addr, (rtcp ? &udp->rem_rtcp_addr : &udp->rem_rtp_addr),
+                  sizeof(pj_sockaddr));
+        addr_len = udp->addr_len;
+    } while (pj_seqlock_read_retry(udp->addr_lock, seq));
+
+    return addr_len;
+}
+
 /* Call RTP cb. */
-static void call_rtp_cb(struct transport_udp *udp, pj_ssize_t bytes_read, 
-                        pj_bool_t *rem_switch)
+static void call_rtp_cb(struct transport_udp *udp, void *pkt,
+                        pj_ssize_t bytes_read, pj_bool_t *rem_switch)
 {
     void (*cb)(void*,void*,pj_ssize_t);
     void (*cb2)(pjmedia_tp_cb_param*);
@@ -506,7 +556,7 @@ static void call_rtp_cb(struct transport_udp *udp, pj_ssize_t bytes_read,
         pjmedia_tp_cb_param param;
 
         param.user_data = user_data;
-        param.pkt = udp->rtp_pkt;
+        param.pkt = pkt;
         param.size = bytes_read;
         param.src_addr = &udp->rtp_src_addr;
         param.rem_switch = PJ_FALSE;
@@ -514,7 +564,7 @@ static void call_rtp_cb(struct transport_udp *udp, pj_ssize_t bytes_read,
         if (rem_switch)
             *rem_switch = param.rem_switch;
     } else if (cb) {
-        (*cb)(user_data, udp->rtp_pkt, bytes_read);
+        (*cb)(user_data, pkt, bytes_read);
     }
 }
 
@@ -531,6 +581,67 @@ static void call_rtcp_cb(struct transport_udp *udp, pj_ssize_t bytes_read)
         (*cb)(user_data, udp->rtcp_pkt, bytes_read);
 }
 
+#if PJMEDIA_TRANSPORT_UDP_RECV_BATCH > 1
+/* Get the next RTP packet drained by recvmmsg(), draining the socket
+ * first if there is none left. The packet is left in the buffer it was
+ * received into. Returns PJ_FALSE if there is no packet, in which case
+ * drained tells if the socket is empty.
+ */
+static pj_bool_t rtp_batch_next(struct transport_udp *udp,
+                                void **pkt,
+                                pj_ssize_t *bytes_read,
+                                pj_bool_t *drained)
+{
+    pj_sock_mmsg *m;
+
+    *drained = PJ_FALSE;
+
+    if (udp->rtp_batch_pos >= udp->rtp_batch_cnt) {
+        unsigned i, cnt = PJMEDIA_TRANSPORT_UDP_RECV_BATCH;
+        pj_status_t status;
+
+        if (udp->rtp_batch_drained) {
+            udp->rtp_batch_drained = PJ_FALSE;
+            *drained = PJ_TRUE;
+            return PJ_FALSE;
+        }
+
+        /* The first packet goes directly into rtp_pkt */
+        udp->rtp_batch[0].buf = udp->rtp_pkt;
+        udp->rtp_batch[0].size = sizeof(udp->rtp_pkt);
+        for (i = 1; i < cnt; ++i) {
+            udp->rtp_batch[i].buf = udp->rtp_batch_buf[i-1];
+            udp->rtp_batch[i].size = sizeof(udp->rtp_batch_buf[i-1]);
+        }
+
+        udp->rtp_batch_cnt = udp->rtp_batch_pos = 0;
+        status = pj_sock_recvmmsg(udp->rtp_sock, udp->rtp_batch, &cnt, 0);
+        if (status != PJ_SUCCESS) {
+            *drained = (status == PJ_STATUS_FROM_OS(PJ_BLOCKING_ERROR_VAL));
+            return PJ_FALSE;
+        }
+        udp->rtp_batch_cnt = cnt;
+        udp->rtp_batch_drained = (cnt < PJMEDIA_TRANSPORT_UDP_RECV_BATCH);
+    }
+
+    m = &udp->rtp_batch[udp->rtp_batch_pos];
+    *pkt = m->buf;
+    pj_sockaddr_cp(&udp->rtp_src_addr, &m->addr);
+    udp->rtp_addrlen = m->addr_len;
+    *bytes_read = m->len;
+    ++udp->rtp_batch_pos;
+
+    return PJ_TRUE;
+}
+
+/* Discard drained RTP packets */
+static void rtp_batch_reset(struct transport_udp *udp)
+{
+    udp->rtp_batch_cnt = udp->rtp_batch_pos = 0;
+    udp->rtp_batch_drained = PJ_FALSE;
+}
+#endif
+
 /* Notification from ioqueue about incoming RTP packet */
 static void on_rx_rtp(pj_ioqueue_key_t *key,
                       pj_ioqueue_op_key_t *op_key,
@@ -542,10 +653,12 @@ static void on_rx_rtp(pj_ioqueue_key_t *key,
     pj_bool_t transport_restarted = PJ_FALSE;
     unsigned num_err = 0;
     pj_status_t last_err = PJ_SUCCESS;
+    void *pkt;
 
     PJ_UNUSED_ARG(op_key);
 
     udp = (struct transport_udp*) pj_ioqueue_get_user_data(key);
+    pkt = udp->rtp_pkt;
 
     if (-bytes_read == PJ_ECANCELLED) {
         TRACE_((udp->base.name, "on_rx_rtp(): got PJ_ECANCELLED"));
@@ -559,13 +672,14 @@ static void on_rx_rtp(pj_ioqueue_key_t *key,
         status = transport_restart(PJ_TRUE, udp);
         if (status != PJ_SUCCESS) {
             bytes_read = -PJ_ESOCKETSTOP;
-            call_rtp_cb(udp, bytes_read, NULL);
+            call_rtp_cb(udp, udp->rtp_pkt, bytes_read, NULL);
         }
         return;
     }
 
     do {
         pj_bool_t discard = PJ_FALSE;
+        pj_uint32_t flags = 0;
 
         /* Simulate packet lost on RX direction */
         if (udp->rx_drop_pct) {
@@ -581,7 +695,7 @@ static void on_rx_rtp(pj_ioqueue_key_t *key,
         if (!discard && 
             (-bytes_read != PJ_STATUS_FROM_OS(PJ_BLOCKING_ERROR_VAL))) 
         {
-            call_rtp_cb(udp, bytes_read, &rem_switch);
+            call_rtp_cb(udp, pkt, bytes_read, &rem_switch);
         }
 
         /* Transport may be destroyed from the callback! */
@@ -594,15 +708,13 @@ static void on_rx_rtp(pj_ioqueue_key_t *key,
             (udp->options & PJMEDIA_UDP_NO_SRC_ADDR_CHECKING)==0)
         {
             char addr_text[PJ_INET6_ADDRSTRLEN+10];
+            pj_bool_t rtcp_predicted = PJ_FALSE;
+
+            pj_seqlock_write_lock(udp->addr_lock);
 
             /* Set remote RTP address to source address */
             pj_sockaddr_cp(&udp->rem_rtp_addr, &udp->rtp_src_addr);
 
-            PJ_LOG(4,(udp->base.name,
-                      "Remote RTP address switched to %s",
-                      pj_sockaddr_print(&udp->rtp_src_addr, addr_text,
-                                        sizeof(addr_text), 3)));
-
             if (udp->use_rtcp_mux) {
                 pj_sockaddr_cp(&udp->rem_rtcp_addr, &udp->rem_rtp_addr);
                 pj_sockaddr_cp(&udp->rtcp_src_addr, &udp->rem_rtcp_addr);
@@ -618,7 +730,17 @@ static void on_rx_rtp(pj_ioqueue_key_t *key,
                 pj_sockaddr_set_port(&udp->rem_rtcp_addr, port);
 
                 pj_sockaddr_cp(&udp->rtcp_src_addr, &udp->rem_rtcp_addr);
+                rtcp_predicted = PJ_TRUE;
+            }
+
+            pj_seqlock_write_unlock(udp->addr_lock);
 
+            PJ_LOG(4,(udp->base.name,
+                      "Remote RTP address switched to %s",
+                      pj_sockaddr_print(&udp->rtp_src_addr, addr_text,
+                                        sizeof(addr_text), 3)));
+
+            if (rtcp_predicted) {
                 PJ_LOG(4,(udp->base.name,
                           "Remote RTCP address switched to predicted"
                           " address %s",
@@ -628,10 +750,27 @@ static void on_rx_rtp(pj_ioqueue_key_t *key,
         }
 #endif
 
+#if PJMEDIA_TRANSPORT_UDP_RECV_BATCH > 1
+        /* Take the next packet from the socket with recvmmsg(), or from
+         * the packets drained by the previous recvmmsg() call.
+         */
+        {
+            pj_bool_t drained;
+
+            if (rtp_batch_next(udp, &pkt, &bytes_read, &drained)) {
+                status = PJ_SUCCESS;
+                continue;
+            }
+            if (drained)
+                flags = PJ_IOQUEUE_ALWAYS_ASYNC;
+        }
+#endif
+
+        pkt = udp->rtp_pkt;
         bytes_read = sizeof(udp->rtp_pkt);
         udp->rtp_addrlen = sizeof(udp->rtp_src_addr);
         status = pj_ioqueue_recvfrom(udp->rtp_key, &udp->rtp_read_op,
-                                     udp->rtp_pkt, &bytes_read, 0,
+                                     udp->rtp_pkt, &bytes_read, flags,
                                      &udp->rtp_src_addr,
                                      &udp->rtp_addrlen);
 
@@ -639,7 +778,7 @@ static void on_rx_rtp(pj_ioqueue_key_t *key,
             if (transport_restarted && last_err == status) {
                 /* Still the same error after restart */
                 bytes_read = -PJ_ESOCKETSTOP;
-                call_rtp_cb(udp, bytes_read, NULL);
+                call_rtp_cb(udp, udp->rtp_pkt, bytes_read, NULL);
                 break;
             } else if (PJMEDIA_IGNORE_RECV_ERR_CNT) {
                 if (last_err == status) {
@@ -655,7 +794,7 @@ static void on_rx_rtp(pj_ioqueue_key_t *key,
                     status = transport_restart(PJ_TRUE, udp);               
                     if (status != PJ_SUCCESS) {
                         bytes_read = -PJ_ESOCKETSTOP;
-                        call_rtp_cb(udp, bytes_read, NULL);
+                        call_rtp_cb(udp, udp->rtp_pkt, bytes_read, NULL);
                         break;
                     }
                     transport_restarted = PJ_TRUE;
@@ -736,7 +875,10 @@ static void on_rx_rtcp(pj_ioqueue_key_t *key,
         if (bytes_read>0 &&
             (udp->options & PJMEDIA_UDP_NO_SRC_ADDR_CHECKING)==0)
         {
-            if (pj_sockaddr_cmp(&udp->rem_rtcp_addr, &udp->rtcp_src_addr) == 0) {
+            pj_sockaddr rem_rtcp_addr;
+
+            get_rem_addr(udp, PJ_TRUE, &rem_rtcp_addr);
+            if (pj_sockaddr_cmp(&rem_rtcp_addr, &udp->rtcp_src_addr) == 0) {
                 /* Still receiving from rem_rtcp_addr, don't switch */
                 udp->rtcp_src_cnt = 0;
             } else {
@@ -746,8 +888,10 @@ static void on_rx_rtcp(pj_ioqueue_key_t *key,
                     char addr_text[PJ_INET6_ADDRSTRLEN+10];
 
                     udp->rtcp_src_cnt = 0;
+                    pj_seqlock_write_lock(udp->addr_lock);
                     pj_memcpy(&udp->rem_rtcp_addr, &udp->rtcp_src_addr,
                               sizeof(pj_sockaddr));
+                    pj_seqlock_write_unlock(udp->addr_lock);
 
                     PJ_LOG(4,(udp->base.name,
                               "Remote RTCP address switched to %s",
@@ -884,10 +1028,7 @@ static pj_status_t tp_attach          (pjmedia_transport *tp,
     }
     rem_addr_len = pj_sockaddr_get_len(&remote_addr);
 
-    /* Copy remote RTP address */
-    pj_memcpy(&udp->rem_rtp_addr, &remote_addr, rem_addr_len);
-
-    /* Copy remote RTP address, if one is specified. */
+    /* Get remote RTCP address, if one is specified. */
     rtcp_addr = (const pj_sockaddr*) rem_rtcp;
     if (rtcp_addr && pj_sockaddr_has_addr(rtcp_addr)) {
         status = pj_sockaddr_synthesize(sock_addr.addr.sa_family,
@@ -896,26 +1037,29 @@ static pj_status_t tp_attach          (pjmedia_transport *tp,
             pj_perror(3, tp->name, status, "Failed to synthesize the correct"
                                            "IP address for RTCP");
         }
-        pj_memcpy(&udp->rem_rtcp_addr, &remote_rtcp, rem_addr_len);
 
     } else {
         unsigned rtcp_port;
 
         /* Otherwise guess the RTCP address from the RTP address */
-        pj_memcpy(&udp->rem_rtcp_addr, &udp->rem_rtp_addr, rem_addr_len);
-        rtcp_port = pj_sockaddr_get_port(&udp->rem_rtp_addr) + 1;
-        pj_sockaddr_set_port(&udp->rem_rtcp_addr, (pj_uint16_t)rtcp_port);
+        pj_memcpy(&remote_rtcp, &remote_addr, rem_addr_len);
+        rtcp_port = pj_sockaddr_get_port(&remote_addr) + 1;
+        pj_sockaddr_set_port(&remote_rtcp, (pj_uint16_t)rtcp_port);
     }
 
+    /* Copy remote RTP and RTCP addresses */
+    pj_seqlock_write_lock(udp->addr_lock);
+    pj_memcpy(&udp->rem_rtp_addr, &remote_addr, rem_addr_len);
+    pj_memcpy(&udp->rem_rtcp_addr, &remote_rtcp, rem_addr_len);
+    udp->addr_len = rem_addr_len;
+    pj_seqlock_write_unlock(udp->addr_lock);
+
     /* Save the callbacks */
     udp->rtp_cb = rtp_cb;
     udp->rtp_cb2 = rtp_cb2;
     udp->rtcp_cb = rtcp_cb;
     udp->user_data = user_data;
 
-    /* Save address length */
-    udp->addr_len = rem_addr_len;
-
     /* Last, mark transport as attached */
     //udp->attached = PJ_TRUE;
 
@@ -1064,6 +1208,8 @@ static pj_status_t transport_send_rtp( pjmedia_transport *tp,
                                        pj_size_t size)
 {
     struct transport_udp *udp = (struct transport_udp*)tp;
+    pj_sockaddr rem_addr;
+    int addr_len;
     pj_ssize_t sent;
     unsigned id;
     struct pending_write *pw;
@@ -1105,12 +1251,13 @@ static pj_status_t transport_send_rtp( pjmedia_transport *tp,
      */
     pj_memcpy(pw->buffer, pkt, size);
 
+    addr_len = get_rem_addr(udp, PJ_FALSE, &rem_addr);
+
     sent = size;
     status = pj_ioqueue_sendto( udp->rtp_key, 
                                 &udp->rtp_pending_write[id].op_key,
                                 pw->buffer, &sent, 0,
-                                &udp->rem_rtp_addr, 
-                                udp->addr_len);
+                                &rem_addr, addr_len);
 
     if (status != PJ_EPENDING) {
         /* Send operation has completed immediately. Clear the flag. */
@@ -1126,6 +1273,70 @@ static pj_status_t transport_send_rtp( pjmedia_transport *tp,
     return status;
 }
 
+/* Called by application to send several RTP packets */
+static pj_status_t transport_send_rtp_batch(pjmedia_transport *tp,
+                                            const void *pkt[],
+                                            const pj_size_t size[],
+                                            unsigned count)
+{
+    struct transport_udp *udp = (struct transport_udp*)tp;
+    pj_sock_mmsg msgs[SEND_BATCH];
+    pj_sockaddr rem_addr;
+    int addr_len;
+    unsigned i, cnt, done = 0;
+    pj_status_t status = PJ_SUCCESS;
+
+    PJ_ASSERT_RETURN(pkt && size, PJ_EINVAL);
+
+    /* Check that the sizes are supported, before anything is sent */
+    for (i = 0; i < count; ++i) {
+        PJ_ASSERT_RETURN(size[i] <= PJMEDIA_MAX_MTU, PJ_ETOOBIG);
+    }
+
+    if (!udp->started) {
+        return PJ_SUCCESS;
+    }
+
+    addr_len = get_rem_addr(udp, PJ_FALSE, &rem_addr);
+
+    /* Packet lost simulation is done per packet by transport_send_rtp() */
+    while (done < count && !udp->tx_drop_pct) {
+        unsigned req;
+
+        req = cnt = PJ_MIN(count - done, SEND_BATCH);
+        for (i = 0; i < cnt; ++i) {
+            msgs[i].buf = (void*)pkt[done+i];
+            msgs[i].size = size[done+i];
+            pj_memcpy(&msgs[i].addr, &rem_addr, addr_len);
+            msgs[i].addr_len = addr_len;
+        }
+
+        /* Packets are sent directly from the caller's buffers, so they
+         * don't need to be copied to the pending write buffers.
+         */
+        if (pj_ioqueue_sendto_batch(udp->rtp_key, msgs, &cnt, 0)
+                != PJ_SUCCESS)
+        {
+            break;
+        }
+
+        done += cnt;
+        if (cnt < req)
+            break;
+    }
+
+    /* Send the rest (if any) one by one, queueing them in the ioqueue
+     * when the socket buffer is full.
+     */
+    for (; done < count; ++done) {
+        pj_status_t st = transport_send_rtp(tp, pkt[done], size[done]);
+        if (st != PJ_SUCCESS)
+            status = st;
+    }
+
+    return status;
+}
+
 /* Called by application to send RTCP packet */
 static pj_status_t transport_send_rtcp(pjmedia_transport *tp,
                                        const void *pkt,
@@ -1143,6 +1354,7 @@ static pj_status_t transport_send_rtcp2(pjmedia_transport *tp,
                                         pj_size_t size)
 {
     struct transport_udp *udp = (struct transport_udp*)tp;
+    pj_sockaddr rem_addr;
     pj_ssize_t sent;
     pj_status_t status;
 
@@ -1153,8 +1365,8 @@ static pj_status_t transport_send_rtcp2(pjmedia_transport *tp,
     }
 
     if (addr == NULL) {
-        addr = &udp->rem_rtcp_addr;
-        addr_len = udp->addr_len;
+        addr_len = get_rem_addr(udp, PJ_TRUE, &rem_addr);
+        addr = &rem_addr;
     }
 
     sent = size;
@@ -1296,6 +1508,9 @@ static pj_status_t transport_media_start(pjmedia_transport *tp,
         pj_ioqueue_op_key_init(&udp->rtp_pending_write[i].op_key, 
                                sizeof(udp->rtp_pending_write[i].op_key));
     }
+#if PJMEDIA_TRANSPORT_UDP_RECV_BATCH > 1
+    rtp_batch_reset(udp);
+#endif
 
     pj_ioqueue_op_key_init(&udp->rtcp_read_op, sizeof(udp->rtcp_read_op));
     pj_ioqueue_op_key_init(&udp->rtcp_write_op, sizeof(udp->rtcp_write_op));
@@ -1474,6 +1689,9 @@ static pj_status_t transport_restart(pj_bool_t is_rtp,
         goto on_error;
 
     if (is_rtp) {
+#if PJMEDIA_TRANSPORT_UDP_RECV_BATCH > 1
+        rtp_batch_reset(udp);
+#endif
         size = sizeof(udp->rtp_pkt);
         status = pj_ioqueue_recvfrom(udp->rtp_key, &udp->rtp_read_op,
                                      udp->rtp_pkt, &size, 
@@ -186,6 +186,11 @@ struct pjmedia_vid_stream
     int                      last_dec_seq;  /**< Last decoded sequence.     */
     pj_uint32_t              rtp_tx_err_cnt;/**< The number of RTP
                                                  send() error               */
+    char                    *tx_batch_buf;  /**< Copies of the RTP packets
+                                                 of the frame being sent.   */
+    const void              *tx_batch_pkt[PJMEDIA_VID_STREAM_TX_BATCH];
+    pj_size_t                tx_batch_size[PJMEDIA_VID_STREAM_TX_BATCH];
+    unsigned                 tx_batch_cnt;  /**< Number of queued packets.  */
     pj_uint32_t              rtcp_tx_err_cnt;/**< The number of RTCP
                                                   send() error              */
 
@@ -1074,6 +1079,87 @@ static void on_rx_rtcp( void *data,
     pjmedia_rtcp_rx_rtcp(&stream->rtcp, pkt, bytes_read);
 }
 
+/*
+ * Send the RTP packets queued by send_rtp().
+ */
+static void flush_rtp(pjmedia_vid_stream *stream)
+{
+    unsigned i, cnt;
+    pj_status_t status;
+
+    cnt = stream->tx_batch_cnt;
+    if (cnt == 0)
+        return;
+
+    status = pjmedia_transport_send_rtp_batch(stream->transport,
+                                              stream->tx_batch_pkt,
+                                              stream->tx_batch_size,
+                                              cnt);
+    stream->tx_batch_cnt = 0;
+
+    if (status != PJ_SUCCESS) {
+        if (stream->rtp_tx_err_cnt++ == 0) {
+            LOGERR_((stream->enc->port.info.name.ptr, status,
+                     "Error sending RTP"));
+        }
+        if (stream->rtp_tx_err_cnt > SEND_ERR_COUNT_TO_REPORT) {
+            stream->rtp_tx_err_cnt = 0;
+        }
+        return;
+    }
+
+    /* Update stat, the packets only have the fixed RTP header */
+    for (i = 0; i < cnt; ++i) {
+        pjmedia_rtcp_tx_rtp(&stream->rtcp,
+                            (unsigned)(stream->tx_batch_size[i] -
+                                       sizeof(pjmedia_rtp_hdr)));
+    }
+}
+
+/*
+ * Queue a copy of the RTP packet, to be sent by flush_rtp() together with
+ * the other packets of the frame. Packets are sent immediately when
+ * batching is disabled. Either way, the packet is counted in the RTCP
+ * stat once it has been sent.
+ */
+static void send_rtp(pjmedia_vid_stream *stream, const void *pkt,
+                     pj_size_t size)
+{
+    char *buf;
+
+    if (!stream->tx_batch_buf || size > PJMEDIA_MAX_MTU) {
+        pj_status_t status;
+
+        /* Keep the packet order */
+        flush_rtp(stream);
+
+        status = pjmedia_transport_send_rtp(stream->transport, pkt, size);
+        if (status != PJ_SUCCESS) {
+            if (stream->rtp_tx_err_cnt++ == 0) {
+                LOGERR_((stream->enc->port.info.name.ptr, status,
+                         "Error sending RTP"));
+            }
+            if (stream->rtp_tx_err_cnt > SEND_ERR_COUNT_TO_REPORT) {
+                stream->rtp_tx_err_cnt = 0;
+            }
+            return;
+        }
+
+        pjmedia_rtcp_tx_rtp(&stream->rtcp,
+                            (unsigned)(size - sizeof(pjmedia_rtp_hdr)));
+        return;
+    }
+
+    if (stream->tx_batch_cnt == PJMEDIA_VID_STREAM_TX_BATCH)
+        flush_rtp(stream);
+
+    buf = stream->tx_batch_buf + stream->tx_batch_cnt * PJMEDIA_MAX_MTU;
+    pj_memcpy(buf, pkt, size);
+    stream->tx_batch_pkt[stream->tx_batch_cnt] = buf;
+    stream->tx_batch_size[stream->tx_batch_cnt] = size;
+    ++stream->tx_batch_cnt;
+}
+
 static pj_status_t put_frame(pjmedia_port *port,
                              pjmedia_frame *frame)
 {
@@ -1214,6 +1300,7 @@ static pj_status_t put_frame(pjmedia_port *port,
         if (status != PJ_SUCCESS) {
             LOGERR_((channel->port.info.name.ptr, status,
                     "RTP encode_rtp() error"));
+            flush_rtp(stream);
             return status;
         }
 
@@ -1224,21 +1311,11 @@ static pj_status_t put_frame(pjmedia_port *port,
             /* Copy RTP header to the beginning of packet */
             pj_memcpy(channel->buf, rtphdr, sizeof(pjmedia_rtp_hdr));
 
-            /* Send the RTP packet to the transport. */
-            status = pjmedia_transport_send_rtp(stream->transport,
-                                                (char*)channel->buf,
-                                                frame_out.size +
-                                                    sizeof(pjmedia_rtp_hdr));
-            if (status != PJ_SUCCESS) {
-                if (stream->rtp_tx_err_cnt++ == 0) {
-                    LOGERR_((channel->port.info.name.ptr, status,
-                             "Error sending RTP"));
-                }
-                if (stream->rtp_tx_err_cnt > SEND_ERR_COUNT_TO_REPORT) {
-                    stream->rtp_tx_err_cnt = 0;
-                }
-            }
-            pjmedia_rtcp_tx_rtp(&stream->rtcp, (unsigned)frame_out.size);
+            /* Send the RTP packet to the transport, packets of the
+             * frame are sent in batches.
+             */
+            send_rtp(stream, channel->buf,
+                     frame_out.size + sizeof(pjmedia_rtp_hdr));
             total_sent += frame_out.size;
             pkt_cnt++;
         }
@@ -1282,11 +1359,16 @@ static pj_status_t put_frame(pjmedia_port *port,
                 if (ms_sleep > 10)
                     ms_sleep = 10;
 
+                /* Send what we have before pausing */
+                flush_rtp(stream);
                 pj_thread_sleep(ms_sleep);
             }
         }
     }
 
+    /* Send the rest of the frame */
+    flush_rtp(stream);
+
 #if TRACE_RC
     /* Trace log for rate control */
     {
@@ -1934,6 +2016,14 @@ PJ_DEF(pj_status_t) pjmedia_vid_stream_create(
     if (status != PJ_SUCCESS)
         goto err_cleanup;
 
+    /* Create buffer for sending the packets of a frame in batches */
+    if (PJMEDIA_VID_STREAM_TX_BATCH > 1) {
+        stream->tx_batch_buf = (char*)
+                               pj_pool_alloc(pool,
+                                             PJMEDIA_VID_STREAM_TX_BATCH *
+                                             PJMEDIA_MAX_MTU);
+    }
+
     /* Create temporary buffer for immediate decoding */
     stream->dec_max_size = vfd_dec->size.w * vfd_dec->size.h * 4;
     stream->dec_frame.buf = pj_pool_alloc(pool, stream->dec_max_size);
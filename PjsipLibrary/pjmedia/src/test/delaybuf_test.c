@@ -0,0 +1,246 @@
+/* 
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA 
+ */
+#include "test.h"
+
+#define THIS_FILE           "delaybuf_test.c"
+
+#define CLOCK_RATE          8000
+#define SPF                 80          /* 10 ms frames                 */
+#define MAX_DELAY           100         /* ms                           */
+#define MAX_FRAMES          (MAX_DELAY * CLOCK_RATE / 1000 / SPF)
+#define MT_FRAMES           20000       /* frames passed between threads */
+
+/* Producer/consumer state */
+struct mt_state
+{
+    pjmedia_delay_buf  *b;
+    pj_atomic_t        *consumed;       /* frames seen by the consumer  */
+    pj_bool_t           quit;
+    int                 err;
+};
+
+static void fill_frame(pj_int16_t frame[], int val)
+{
+    unsigned i;
+
+    for (i = 0; i < SPF; ++i)
+        frame[i] = (pj_int16_t)val;
+}
+
+/* Return the value of the frame, or -1 if the samples differ */
+static int frame_value(const pj_int16_t frame[])
+{
+    unsigned i;
+
+    for (i = 1; i < SPF; ++i) {
+        if (frame[i] != frame[0])
+            return -1;
+    }
+    return frame[0];
+}
+
+/* FIFO order, overflow and reset, on one thread */
+static int basic_test(pj_pool_t *pool, unsigned options)
+{
+    pjmedia_delay_buf *b;
+    pj_int16_t frame[SPF];
+    pj_status_t status;
+    int i, rc = 0;
+
+    status = pjmedia_delay_buf_create(pool, "db_basic", CLOCK_RATE, SPF, 1,
+                                      MAX_DELAY, options, &b);
+    if (status != PJ_SUCCESS) {
+        app_perror(status, "  error creating delay buffer");
+        return -10;
+    }
+
+    /* Frames come out in order, then silence */
+    for (i = 1; i <= 2; ++i) {
+        fill_frame(frame, i);
+        pjmedia_delay_buf_put(b, frame);
+    }
+    for (i = 1; i <= 3; ++i) {
+        pjmedia_delay_buf_get(b, frame);
+        if (frame_value(frame) != (i <= 2 ? i : 0)) {
+            PJ_LOG(3,(THIS_FILE, "  error: got %d, expecting %d",
+                      frame_value(frame), (i <= 2 ? i : 0)));
+            rc = -20;
+            goto on_return;
+        }
+    }
+
+    /* The eldest frames over the maximum delay are dropped */
+    for (i = 1; i <= MAX_FRAMES + 2; ++i) {
+        fill_frame(frame, i);
+        pjmedia_delay_buf_put(b, frame);
+    }
+    pjmedia_delay_buf_get(b, frame);
+    if (frame_value(frame) != 3) {
+        PJ_LOG(3,(THIS_FILE, "  error: got %d after overflow, expecting 3",
+                  frame_value(frame)));
+        rc = -30;
+        goto on_return;
+    }
+
+    /* Reset empties the buffer */
+    pjmedia_delay_buf_reset(b);
+    pjmedia_delay_buf_get(b, frame);
+    if (frame_value(frame) != 0) {
+        PJ_LOG(3,(THIS_FILE, "  error: got %d after reset",
+                  frame_value(frame)));
+        rc = -40;
+        goto on_return;
+    }
+
+on_return:
+    pjmedia_delay_buf_destroy(b);
+    return rc;
+}
+
+static int producer_thread(void *arg)
+{
+    struct mt_state *st = (struct mt_state*)arg;
+    pj_int16_t frame[SPF];
+    int i;
+
+    for (i = 1; i <= MT_FRAMES && !st->quit; ++i) {
+        /* Stay below the maximum delay, so no frame is dropped */
+        while (i - pj_atomic_get(st->consumed) > MAX_FRAMES / 2 &&
+               !st->quit)
+        {
+            pj_thread_sleep(0);
+        }
+
+        fill_frame(frame, i);
+        if (pjmedia_delay_buf_put(st->b, frame) != PJ_SUCCESS) {
+            st->err = -110;
+            break;
+        }
+    }
+
+    return 0;
+}
+
+/* One producer and one consumer thread. The consumer must get every
+ * frame, in order and whole, or silence when the producer is late.
+ */
+static int mt_test(pj_pool_t *pool, unsigned options)
+{
+    struct mt_state st;
+    pj_thread_t *thread = NULL;
+    pj_int16_t frame[SPF];
+    pj_time_val timeout, now;
+    pj_status_t status;
+    int last = 0, val;
+    unsigned silent = 0;
+    int rc = 0;
+
+    pj_bzero(&st, sizeof(st));
+
+    status = pjmedia_delay_buf_create(pool, "db_mt", CLOCK_RATE, SPF, 1,
+                                      MAX_DELAY, options, &st.b);
+    if (status != PJ_SUCCESS) {
+        app_perror(status, "  error creating delay buffer");
+        return -100;
+    }
+
+    status = pj_atomic_create(pool, 0, &st.consumed);
+    if (status != PJ_SUCCESS) {
+        rc = -105;
+        goto on_return;
+    }
+
+    status = pj_thread_create(pool, "db_prod", &producer_thread, &st,
+                              0, 0, &thread);
+    if (status != PJ_SUCCESS) {
+        app_perror(status, "  error creating thread");
+        rc = -110;
+        goto on_return;
+    }
+
+    pj_gettickcount(&timeout);
+    timeout.sec += 30;
+
+    while (last < MT_FRAMES && st.err == 0) {
+        pjmedia_delay_buf_get(st.b, frame);
+
+        val = frame_value(frame);
+        if (val == 0) {
+            ++silent;
+            pj_thread_sleep(0);
+        } else if (val == last + 1) {
+            last = val;
+            pj_atomic_set(st.consumed, last);
+        } else {
+            PJ_LOG(3,(THIS_FILE, "  error: got %d after %d", val, last));
+            rc = -120;
+            break;
+        }
+
+        pj_gettickcount(&now);
+        if (PJ_TIME_VAL_GT(now, timeout)) {
+            PJ_LOG(3,(THIS_FILE, "  error: timed out after frame %d", last));
+            rc = -130;
+            break;
+        }
+    }
+
+    if (rc == 0 && st.err != 0)
+        rc = st.err;
+
+    PJ_LOG(3,(THIS_FILE, "  %d frames, %u silent", last, silent));
+
+on_return:
+    if (thread) {
+        st.quit = PJ_TRUE;
+        pj_thread_join(thread);
+        pj_thread_destroy(thread);
+    }
+    if (st.consumed)
+        pj_atomic_destroy(st.consumed);
+    pjmedia_delay_buf_destroy(st.b);
+    return rc;
+}
+
+int delaybuf_test(void)
+{
+    static const struct {
+        const char *name;
+        unsigned    options;
+    } modes[] = {
+        { "simple FIFO", PJMEDIA_DELAY_BUF_SIMPLE_FIFO },
+        { "lock-free FIFO", PJMEDIA_DELAY_BUF_LOCK_FREE }
+    };
+    pj_pool_t *pool;
+    unsigned i;
+    int rc = 0;
+
+    pool = pj_pool_create(mem, "delaybuf", 4000, 4000, NULL);
+
+    for (i = 0; i < PJ_ARRAY_SIZE(modes) && rc == 0; ++i) {
+        PJ_LOG(3,(THIS_FILE, " %s", modes[i].name));
+
+        rc = basic_test(pool, modes[i].options);
+        if (rc == 0)
+            rc = mt_test(pool, modes[i].options);
+    }
+
+    pj_pool_release(pool);
+    return rc;
+}
@@ -0,0 +1,490 @@
+/* 
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA 
+ */
+#include "test.h"
+#include <pjmedia-audiodev/audiodev.h>
+#include <pjmedia-audiodev/audiodev_imp.h>
+
+#define THIS_FILE           "snd_port_test.c"
+
+/*
+ * The sound port is run on a test audio device, whose callbacks are called
+ * by the test itself. Captured frames carry their number, and the
+ * downstream port numbers the frames it gives for playback, so the test
+ * can check the order and the timestamps of the frames on both sides,
+ * with and without the media thread.
+ */
+
+#define CLOCK_RATE          8000
+#define SPF                 160
+#define FRAME_CNT           100
+#define HOLD_CNT            4           /* callbacks while port is busy */
+#define BASE_TS             1000000     /* device timestamp of frame 0  */
+#define WAIT_MSEC           2000
+
+/* Test audio device */
+struct test_dev_stream
+{
+    pjmedia_aud_stream   base;
+    pjmedia_aud_param    param;
+    pjmedia_aud_rec_cb   rec_cb;
+    pjmedia_aud_play_cb  play_cb;
+    void                *user_data;
+};
+
+/* Downstream port */
+struct test_port
+{
+    pjmedia_port         base;
+    pj_mutex_t          *mutex;
+    pj_thread_t         *dev_thread;    /* thread calling the callbacks  */
+    unsigned             on_dev_thread; /* calls made on that thread     */
+
+    unsigned             get_cnt;       /* frames given for playback     */
+    pj_timestamp         get_ts[FRAME_CNT + HOLD_CNT + 8];
+    pj_bool_t            get_synced[FRAME_CNT + HOLD_CNT + 8];
+
+    unsigned             put_cnt;       /* captured frames received      */
+    unsigned             put_err;       /* ... with wrong number or ts   */
+};
+
+static pjmedia_aud_dev_factory test_factory;
+static struct test_dev_stream test_strm;
+static struct test_port tport;
+static unsigned real_played;            /* numbered frames played        */
+
+
+static pj_status_t dev_factory_init(pjmedia_aud_dev_factory *f)
+{
+    PJ_UNUSED_ARG(f);
+    return PJ_SUCCESS;
+}
+
+static pj_status_t dev_factory_destroy(pjmedia_aud_dev_factory *f)
+{
+    PJ_UNUSED_ARG(f);
+    return PJ_SUCCESS;
+}
+
+static unsigned dev_factory_get_dev_count(pjmedia_aud_dev_factory *f)
+{
+    PJ_UNUSED_ARG(f);
+    return 1;
+}
+
+static pj_status_t dev_factory_get_dev_info(pjmedia_aud_dev_factory *f,
+                                            unsigned index,
+                                            pjmedia_aud_dev_info *info)
+{
+    PJ_UNUSED_ARG(f);
+    PJ_ASSERT_RETURN(index == 0, PJMEDIA_EAUD_INVDEV);
+
+    pj_bzero(info, sizeof(*info));
+    pj_ansi_strxcpy(info->name, "test device", sizeof(info->name));
+    pj_ansi_strxcpy(info->driver, "test", sizeof(info->driver));
+    info->input_count = 1;
+    info->output_count = 1;
+    info->default_samples_per_sec = CLOCK_RATE;
+
+    return PJ_SUCCESS;
+}
+
+static pj_status_t dev_factory_default_param(pjmedia_aud_dev_factory *f,
+                                             unsigned index,
+                                             pjmedia_aud_param *param)
+{
+    PJ_UNUSED_ARG(f);
+    PJ_ASSERT_RETURN(index == 0, PJMEDIA_EAUD_INVDEV);
+
+    pj_bzero(param, sizeof(*param));
+    param->dir = PJMEDIA_DIR_CAPTURE_PLAYBACK;
+    param->rec_id = index;
+    param->play_id = index;
+    param->clock_rate = CLOCK_RATE;
+    param->channel_count = 1;
+    param->samples_per_frame = SPF;
+    param->bits_per_sample = 16;
+
+    return PJ_SUCCESS;
+}
+
+static pj_status_t dev_stream_get_param(pjmedia_aud_stream *s,
+                                        pjmedia_aud_param *param)
+{
+    pj_memcpy(param, &((struct test_dev_stream*)s)->param, sizeof(*param));
+    return PJ_SUCCESS;
+}
+
+static pj_status_t dev_stream_get_cap(pjmedia_aud_stream *s,
+                                      pjmedia_aud_dev_cap cap,
+                                      void *value)
+{
+    PJ_UNUSED_ARG(s);
+    PJ_UNUSED_ARG(cap);
+    PJ_UNUSED_ARG(value);
+    return PJMEDIA_EAUD_INVCAP;
+}
+
+static pj_status_t dev_stream_set_cap(pjmedia_aud_stream *s,
+                                      pjmedia_aud_dev_cap cap,
+                                      const void *value)
+{
+    PJ_UNUSED_ARG(s);
+    PJ_UNUSED_ARG(cap);
+    PJ_UNUSED_ARG(value);
+    return PJMEDIA_EAUD_INVCAP;
+}
+
+static pj_status_t dev_stream_start_stop(pjmedia_aud_stream *s)
+{
+    PJ_UNUSED_ARG(s);
+    return PJ_SUCCESS;
+}
+
+static pj_status_t dev_stream_destroy(pjmedia_aud_stream *s)
+{
+    ((struct test_dev_stream*)s)->rec_cb = NULL;
+    ((struct test_dev_stream*)s)->play_cb = NULL;
+    return PJ_SUCCESS;
+}
+
+static pjmedia_aud_stream_op dev_stream_op =
+{
+    &dev_stream_get_param,
+    &dev_stream_get_cap,
+    &dev_stream_set_cap,
+    &dev_stream_start_stop,
+    &dev_stream_start_stop,
+    &dev_stream_destroy
+};
+
+static pj_status_t dev_factory_create_stream(pjmedia_aud_dev_factory *f,
+                                             const pjmedia_aud_param *param,
+                                             pjmedia_aud_rec_cb rec_cb,
+                                             pjmedia_aud_play_cb play_cb,
+                                             void *user_data,
+                                             pjmedia_aud_stream **p_strm)
+{
+    PJ_UNUSED_ARG(f);
+
+    pj_bzero(&test_strm, sizeof(test_strm));
+    pj_memcpy(&test_strm.param, param, sizeof(*param));
+    test_strm.rec_cb = rec_cb;
+    test_strm.play_cb = play_cb;
+    test_strm.user_data = user_data;
+    test_strm.base.op = &dev_stream_op;
+
+    *p_strm = &test_strm.base;
+    return PJ_SUCCESS;
+}
+
+static pj_status_t dev_factory_refresh(pjmedia_aud_dev_factory *f)
+{
+    PJ_UNUSED_ARG(f);
+    return PJ_SUCCESS;
+}
+
+static pjmedia_aud_dev_factory_op dev_factory_op =
+{
+    &dev_factory_init,
+    &dev_factory_destroy,
+    &dev_factory_get_dev_count,
+    &dev_factory_get_dev_info,
+    &dev_factory_default_param,
+    &dev_factory_create_stream,
+    &dev_factory_refresh
+};
+
+static pjmedia_aud_dev_factory* test_factory_create(pj_pool_factory *pf)
+{
+    PJ_UNUSED_ARG(pf);
+
+    test_factory.op = &dev_factory_op;
+    return &test_factory;
+}
+
+
+/* Downstream port, numbers the frames to be played */
+static pj_status_t port_get_frame(pjmedia_port *this_port,
+                                  pjmedia_frame *frame)
+{
+    pj_int16_t *samples = (pj_int16_t*)frame->buf;
+    unsigned i;
+
+    PJ_UNUSED_ARG(this_port);
+
+    pj_mutex_lock(tport.mutex);
+
+    if (pj_thread_this() == tport.dev_thread)
+        ++tport.on_dev_thread;
+
+    if (tport.get_cnt < PJ_ARRAY_SIZE(tport.get_ts)) {
+        /* Frames prepared before the device has played one can't know
+         * the device timestamp yet.
+         */
+        tport.get_ts[tport.get_cnt] = frame->timestamp;
+        tport.get_synced[tport.get_cnt] = (real_played > 0);
+        ++tport.get_cnt;
+    }
+
+    for (i = 0; i < SPF; ++i)
+        samples[i] = (pj_int16_t)tport.get_cnt;
+    frame->type = PJMEDIA_FRAME_TYPE_AUDIO;
+    frame->size = SPF * 2;
+
+    pj_mutex_unlock(tport.mutex);
+
+    return PJ_SUCCESS;
+}
+
+/* Downstream port, checks the captured frames */
+static pj_status_t port_put_frame(pjmedia_port *this_port,
+                                  pjmedia_frame *frame)
+{
+    const pj_int16_t *samples = (const pj_int16_t*)frame->buf;
+
+    PJ_UNUSED_ARG(this_port);
+
+    pj_mutex_lock(tport.mutex);
+
+    if (pj_thread_this() == tport.dev_thread)
+        ++tport.on_dev_thread;
+
+    if (samples[0] != (pj_int16_t)(tport.put_cnt + 1) ||
+        frame->timestamp.u64 != BASE_TS + (pj_uint64_t)tport.put_cnt * SPF)
+    {
+        PJ_LOG(3,(THIS_FILE, "   error: captured frame %u is %d, ts %u",
+                  tport.put_cnt + 1, samples[0],
+                  (unsigned)(frame->timestamp.u64 - BASE_TS)));
+        ++tport.put_err;
+    }
+    ++tport.put_cnt;
+
+    pj_mutex_unlock(tport.mutex);
+
+    return PJ_SUCCESS;
+}
+
+/* Wait until *cnt reaches min */
+static pj_status_t wait_cnt(const unsigned *cnt, unsigned min)
+{
+    unsigned i;
+
+    for (i = 0; i < WAIT_MSEC && *(volatile const unsigned*)cnt < min; ++i)
+        pj_thread_sleep(1);
+
+    return (*cnt < min) ? PJ_ETIMEDOUT : PJ_SUCCESS;
+}
+
+/* Act as the audio device for one frame: capture frame i, then play */
+static int dev_frame(unsigned i, pj_bool_t media_thread, pj_bool_t hold)
+{
+    pj_int16_t buf[SPF];
+    pjmedia_frame frame;
+    unsigned k;
+
+    pj_bzero(&frame, sizeof(frame));
+    frame.type = PJMEDIA_FRAME_TYPE_AUDIO;
+    frame.buf = buf;
+    frame.size = sizeof(buf);
+    frame.timestamp.u64 = BASE_TS + (pj_uint64_t)i * SPF;
+
+    for (k = 0; k < SPF; ++k)
+        buf[k] = (pj_int16_t)(i + 1);
+    (*test_strm.rec_cb)(test_strm.user_data, &frame);
+
+    /* With the media thread, give it the time to handle the captured
+     * frame and to queue the next frame to play, like a device would.
+     */
+    if (media_thread && !hold) {
+        if (wait_cnt(&tport.put_cnt, i + 1) != PJ_SUCCESS) {
+            PJ_LOG(3,(THIS_FILE, "   error: frame %u not captured", i+1));
+            return -10;
+        }
+        if (real_played)
+            wait_cnt(&tport.get_cnt, real_played + 1);
+        else
+            pj_thread_sleep(10);
+    }
+
+    pj_bzero(buf, sizeof(buf));
+    (*test_strm.play_cb)(test_strm.user_data, &frame);
+
+    /* Silence, while the media thread catches up */
+    k = (pj_uint16_t)buf[0];
+    if (k == 0)
+        return 0;
+
+    if (k != real_played + 1) {
+        PJ_LOG(3,(THIS_FILE, "   error: played frame %u after %u",
+                  k, real_played));
+        return -20;
+    }
+    real_played = k;
+
+    if ((!media_thread || tport.get_synced[k-1]) &&
+        tport.get_ts[k-1].u64 != frame.timestamp.u64)
+    {
+        PJ_LOG(3,(THIS_FILE, "   error: frame %u played at ts %u, "
+                  "expecting %u", k,
+                  (unsigned)(frame.timestamp.u64 - BASE_TS),
+                  (unsigned)(tport.get_ts[k-1].u64 - BASE_TS)));
+        return -30;
+    }
+
+    return 0;
+}
+
+static int run_test(pjmedia_aud_dev_index dev_id, pj_bool_t media_thread)
+{
+    pj_pool_t *pool;
+    pjmedia_snd_port_param prm;
+    pjmedia_snd_port *snd_port = NULL;
+    pj_str_t name = pj_str("test");
+    unsigned i, checked;
+    pj_status_t status;
+    int rc = 0;
+
+    PJ_LOG(3,(THIS_FILE, "  %s", (media_thread ? "with media thread" :
+                                  "without media thread")));
+
+    pool = pj_pool_create(mem, "sndport", 4000, 4000, NULL);
+
+    pj_bzero(&tport, sizeof(tport));
+    real_played = 0;
+    tport.dev_thread = pj_thread_this();
+    pjmedia_port_info_init(&tport.base.info, &name, 0x54455354, CLOCK_RATE,
+                           1, 16, SPF);
+    tport.base.get_frame = &port_get_frame;
+    tport.base.put_frame = &port_put_frame;
+
+    status = pj_mutex_create_simple(pool, "sndport", &tport.mutex);
+    if (status != PJ_SUCCESS) {
+        rc = -100;
+        goto on_return;
+    }
+
+    pjmedia_snd_port_param_default(&prm);
+    status = pjmedia_aud_dev_default_param(dev_id, &prm.base);
+    if (status != PJ_SUCCESS) {
+        app_perror(status, "   error getting device param");
+        rc = -110;
+        goto on_return;
+    }
+    prm.options = media_thread ? PJMEDIA_SND_PORT_MEDIA_THREAD :
+                                 PJMEDIA_SND_PORT_NO_MEDIA_THREAD;
+
+    status = pjmedia_snd_port_create2(pool, &prm, &snd_port);
+    if (status != PJ_SUCCESS) {
+        app_perror(status, "   error creating sound port");
+        rc = -120;
+        goto on_return;
+    }
+
+    status = pjmedia_snd_port_connect(snd_port, &tport.base);
+    if (status != PJ_SUCCESS) {
+        rc = -130;
+        goto on_return;
+    }
+
+    for (i = 0; i < FRAME_CNT && rc == 0; ++i)
+        rc = dev_frame(i, media_thread, PJ_FALSE);
+    if (rc != 0)
+        goto on_return;
+
+    /* The media thread runs the downstream port, so the callbacks never
+     * wait for it, even when its lock is held.
+     */
+    if (media_thread) {
+        pj_mutex_lock(tport.mutex);
+        for (i = FRAME_CNT; i < FRAME_CNT + HOLD_CNT && rc == 0; ++i)
+            rc = dev_frame(i, media_thread, PJ_TRUE);
+        pj_mutex_unlock(tport.mutex);
+        if (rc != 0)
+            goto on_return;
+
+        if (wait_cnt(&tport.put_cnt, FRAME_CNT + HOLD_CNT) != PJ_SUCCESS) {
+            PJ_LOG(3,(THIS_FILE, "   error: captured frames lost"));
+            rc = -140;
+            goto on_return;
+        }
+
+        if (tport.on_dev_thread != 0) {
+            PJ_LOG(3,(THIS_FILE, "   error: downstream port called by the "
+                      "audio callbacks"));
+            rc = -150;
+            goto on_return;
+        }
+    }
+
+    if (tport.put_err) {
+        rc = -160;
+        goto on_return;
+    }
+
+    /* Most of the frames must have had their timestamp checked */
+    for (i = 0, checked = 0; i < real_played; ++i) {
+        if (!media_thread || tport.get_synced[i])
+            ++checked;
+    }
+    if (checked < FRAME_CNT * 9 / 10) {
+        PJ_LOG(3,(THIS_FILE, "   error: only %u of %u played frames "
+                  "checked", checked, real_played));
+        rc = -170;
+        goto on_return;
+    }
+
+on_return:
+    if (snd_port)
+        pjmedia_snd_port_destroy(snd_port);
+    if (tport.mutex)
+        pj_mutex_destroy(tport.mutex);
+    pj_pool_release(pool);
+    return rc;
+}
+
+int snd_port_test(void)
+{
+    pjmedia_aud_dev_index dev_id;
+    pj_status_t status;
+    int rc;
+
+    status = pjmedia_aud_subsys_init(mem);
+    if (status != PJ_SUCCESS) {
+        app_perror(status, "  error initializing audio subsystem");
+        return -1;
+    }
+
+    status = pjmedia_aud_register_factory(&test_factory_create);
+    if (status == PJ_SUCCESS)
+        status = pjmedia_aud_dev_lookup("test", "test device", &dev_id);
+    if (status != PJ_SUCCESS) {
+        app_perror(status, "  error registering test device");
+        pjmedia_aud_subsys_shutdown();
+        return -2;
+    }
+
+    rc = run_test(dev_id, PJ_FALSE);
+    if (rc == 0)
+        rc = run_test(dev_id, PJ_TRUE);
+
+    pjmedia_aud_unregister_factory(&test_factory_create);
+    pjmedia_aud_subsys_shutdown();
+
+    return rc;
+}
@@ -98,6 +98,12 @@ int test_main(void)
 #if HAS_JBUF_TEST
     DO_TEST(jbuf_main());
 #endif
+#if HAS_DELAYBUF_TEST
+    DO_TEST(delaybuf_test());
+#endif
+#if HAS_SND_PORT_TEST
+    DO_TEST(snd_port_test());
+#endif
 #if HAS_MIPS_TEST
     DO_TEST(mips_test());
 #endif
@@ -35,6 +35,8 @@
 #endif
 #define HAS_SDP_NEG_TEST        1
 #define HAS_JBUF_TEST           1
+#define HAS_DELAYBUF_TEST       1
+#define HAS_SND_PORT_TEST       1
 #define HAS_MIPS_TEST           WITH_BENCHMARK
 #define HAS_CODEC_VECTOR_TEST   1
 
@@ -42,6 +44,8 @@ int session_test(void);
 int rtp_test(void);
 int sdp_test(void);
 int jbuf_main(void);
+int delaybuf_test(void);
+int snd_port_test(void);
 int sdp_neg_test(void);
 int mips_test(void);
 int codec_test_vectors(void);
@@ -831,6 +831,60 @@ on_return:
 }
 
 
+/*
+ * Resolution failure without DNS resolver: the failure must be reported
+ * once, either by on_status() or, when the failed result is cached, by
+ * the return value of pj_stun_sock_start().
+ */
+static int resolve_fail_test(pj_stun_config *cfg)
+{
+    struct stun_client *client;
+    pj_str_t srv_name = pj_str("stun.invalid");
+    pj_time_val timeout, t;
+    unsigned i, report_cnt;
+    pj_status_t status;
+    int ret = 0;
+
+    PJ_LOG(3,(THIS_FILE, "  resolve failure test"));
+
+    /* The second start finds the failure in the cache */
+    for (i=0; i<2 && ret==0; ++i) {
+        status = create_client(cfg, &client, PJ_FALSE, PJ_FALSE);
+        if (status != PJ_SUCCESS)
+            return -700;
+
+        status = pj_stun_sock_start(client->sock, &srv_name, PJ_STUN_PORT,
+                                    NULL);
+
+        /* Wait for the callback, or make sure that it is not called */
+        pj_gettimeofday(&timeout);
+        timeout.sec += (status == PJ_SUCCESS) ? 60 : 1;
+        do {
+            handle_events(cfg, 100);
+            pj_gettimeofday(&t);
+        } while (client->on_status_cnt==0 && PJ_TIME_VAL_LT(t, timeout));
+
+        report_cnt = client->on_status_cnt + (status != PJ_SUCCESS);
+        if (report_cnt != 1) {
+            PJ_LOG(3,(THIS_FILE, "    error: failure reported %d times",
+                      report_cnt));
+            ret = -710;
+        } else if (client->on_status_cnt &&
+                   (client->last_op != PJ_STUN_SOCK_DNS_OP ||
+                    client->last_status == PJ_SUCCESS))
+        {
+            PJ_LOG(3,(THIS_FILE, "    error: expecting failed DNS operation"));
+            ret = -720;
+        }
+
+        destroy_client(client);
+        handle_events(cfg, 100);
+    }
+
+    return ret;
+}
+
+
 #define DO_TEST(expr)       \
             capture_pjlib_state(&stun_cfg, &pjlib_state); \
             ret = expr; \
@@ -875,6 +929,8 @@ int stun_sock_test(void)
 
     DO_TEST(keep_alive_test(&stun_cfg, USE_IPV6));
 
+    DO_TEST(resolve_fail_test(&stun_cfg));
+
 on_return:
     if (timer_heap) pj_timer_heap_destroy(timer_heap);
     if (ioqueue) pj_ioqueue_destroy(ioqueue);
@@ -56,6 +56,9 @@ struct pj_stun_sock
     pj_sockaddr          mapped_addr;   /* Our public address       */
 
     pj_dns_srv_async_query *q;          /* Pending DNS query        */
+    pj_getaddrinfo_query *gai_q;        /* Pending getaddrinfo()    */
+    pj_bool_t            gai_starting;  /* Starting gai_q           */
+    pj_uint16_t          srv_port;      /* Server port for gai_q    */
     pj_sock_t            sock_fd;       /* Socket descriptor        */
     pj_activesock_t     *active_sock;   /* Active socket object     */
     pj_ioqueue_op_key_t  send_key;      /* Default send key for app */
@@ -97,6 +100,12 @@ static void dns_srv_resolver_cb(void *user_data,
                                 pj_status_t status,
                                 const pj_dns_srv_record *rec);
 
+/* getaddrinfo() callback */
+static void gai_resolver_cb(void *user_data,
+                            pj_status_t status,
+                            unsigned count,
+                            const pj_addrinfo ai[]);
+
 /* Start sending STUN Binding request */
 static pj_status_t get_mapped_addr(pj_stun_sock *stun_sock);
 
@@ -443,26 +452,35 @@ PJ_DEF(pj_status_t) pj_stun_sock_start( pj_stun_sock *stun_sock,
             }
         }
 
-    } else {
+    } else if (status != PJ_SUCCESS) {
+        /* Without DNS resolver, resolve the host name in the background
+         * so the calling thread is not blocked by the system resolver.
+         */
+        pj_assert(stun_sock->gai_q == NULL);
 
-        if (status != PJ_SUCCESS) {
-            pj_addrinfo ai;
-            unsigned cnt = 1;
+        stun_sock->srv_port = default_port;
+        stun_sock->last_err = PJ_SUCCESS;
 
-            status = pj_getaddrinfo(stun_sock->af, domain, &cnt, &ai);
-            if (cnt == 0)
-                status = PJ_EAFNOTSUP;
+        /* Add reference while the query is pending */
+        pj_grp_lock_add_ref(stun_sock->grp_lock);
 
-            if (status != PJ_SUCCESS) {
-                PJ_PERROR(4,(stun_sock->obj_name, status,
-                             "Failed in pj_getaddrinfo()"));
-                pj_grp_lock_release(stun_sock->grp_lock);
-                return status;
-            }
-
-            pj_sockaddr_cp(&stun_sock->srv_addr, &ai.ai_addr);
+        stun_sock->gai_starting = PJ_TRUE;
+        status = pj_getaddrinfo_async(stun_sock->af, domain, 1, stun_sock,
+                                      &gai_resolver_cb, &stun_sock->gai_q);
+        stun_sock->gai_starting = PJ_FALSE;
+        if (status != PJ_SUCCESS) {
+            pj_grp_lock_dec_ref(stun_sock->grp_lock);
+            PJ_PERROR(4,(stun_sock->obj_name, status,
+                         "Failed in pj_getaddrinfo_async()"));
+        } else {
+            /* The callback may have been called here when the result is
+             * cached. A failure is then only reported by the return value.
+             */
+            status = stun_sock->last_err;
         }
 
+    } else {
+
         pj_sockaddr_set_port(&stun_sock->srv_addr, (pj_uint16_t)default_port);
 
         /* Start sending Binding request */
@@ -517,6 +535,14 @@ PJ_DEF(pj_status_t) pj_stun_sock_destroy(pj_stun_sock *stun_sock)
     pj_timer_heap_cancel_if_active(stun_sock->stun_cfg.timer_heap,
                                    &stun_sock->ka_timer, 0);
 
+    /* If the callback is running, it will release the reference */
+    if (stun_sock->gai_q &&
+        pj_getaddrinfo_cancel(stun_sock->gai_q) == PJ_SUCCESS)
+    {
+        stun_sock->gai_q = NULL;
+        pj_grp_lock_dec_ref(stun_sock->grp_lock);
+    }
+
     if (stun_sock->active_sock != NULL) {
         stun_sock->sock_fd = PJ_INVALID_SOCKET;
         pj_activesock_close(stun_sock->active_sock);
@@ -615,6 +641,46 @@ static void dns_srv_resolver_cb(void *user_data,
 }
 
 
+/* Callback to be called by pj_getaddrinfo_async() */
+static void gai_resolver_cb(void *user_data,
+                            pj_status_t status,
+                            unsigned count,
+                            const pj_addrinfo ai[])
+{
+    pj_stun_sock *stun_sock = (pj_stun_sock*) user_data;
+
+    pj_grp_lock_acquire(stun_sock->grp_lock);
+
+    /* Clear query */
+    stun_sock->gai_q = NULL;
+
+    if (stun_sock->is_destroying) {
+        pj_grp_lock_release(stun_sock->grp_lock);
+        pj_grp_lock_dec_ref(stun_sock->grp_lock);
+        return;
+    }
+
+    if (status == PJ_SUCCESS && count == 0)
+        status = PJ_EAFNOTSUP;
+
+    /* Handle error */
+    if (status != PJ_SUCCESS) {
+        PJ_PERROR(4,(stun_sock->obj_name, status,
+                     "Failed in pj_getaddrinfo_async()"));
+        stun_sock->last_err = status;
+        if (!stun_sock->gai_starting)
+            sess_fail(stun_sock, PJ_STUN_SOCK_DNS_OP, status);
+    } else {
+        /* Set the address and start sending Binding request */
+        pj_sockaddr_cp(&stun_sock->srv_addr, &ai[0].ai_addr);
+        pj_sockaddr_set_port(&stun_sock->srv_addr, stun_sock->srv_port);
+        stun_sock->last_err = get_mapped_addr(stun_sock);
+    }
+
+    pj_grp_lock_release(stun_sock->grp_lock);
+    pj_grp_lock_dec_ref(stun_sock->grp_lock);
+}
+
 /* Start sending STUN Binding request */
 static pj_status_t get_mapped_addr(pj_stun_sock *stun_sock)
 {
@@ -136,6 +136,7 @@ struct pj_turn_session
     pj_timer_entry       timer;
 
     pj_uint16_t          default_port;
+    pj_getaddrinfo_query *gai_q;
 
     pj_uint16_t          af;
     pj_turn_tp_type      conn_type;
@@ -191,6 +192,10 @@ static pj_status_t stun_on_rx_indication(pj_stun_session *sess,
 static void dns_srv_resolver_cb(void *user_data,
                                 pj_status_t status,
                                 const pj_dns_srv_record *rec);
+static void gai_resolver_cb(void *user_data,
+                            pj_status_t status,
+                            unsigned count,
+                            const pj_addrinfo ai[]);
 static struct ch_t *lookup_ch_by_addr(pj_turn_session *sess,
                                       const pj_sockaddr_t *addr,
                                       unsigned addr_len,
@@ -354,6 +359,13 @@ static void do_destroy(pj_turn_session *sess)
 
     sess->is_destroying = PJ_TRUE;
     pj_timer_heap_cancel_if_active(sess->timer_heap, &sess->timer, TIMER_NONE);
+
+    /* If the callback is running, it will release the reference */
+    if (sess->gai_q && pj_getaddrinfo_cancel(sess->gai_q) == PJ_SUCCESS) {
+        sess->gai_q = NULL;
+        pj_grp_lock_dec_ref(sess->grp_lock);
+    }
+
     pj_stun_session_destroy(sess->stun);
 
     pj_grp_lock_dec_ref(sess->grp_lock);
@@ -657,11 +669,9 @@ PJ_DEF(pj_status_t) pj_turn_session_set_server( pj_turn_session *sess,
         }
 
     } else {
-        /* Resolver is not specified, resolve with standard gethostbyname().
-         * The default_port MUST be specified in this case.
+        /* Resolver is not specified, resolve with getaddrinfo() in the
+         * background. The default_port MUST be specified in this case.
          */
-        pj_addrinfo *ai;
-        unsigned i, cnt;
 
         /* Default port must be specified */
         PJ_ASSERT_ON_FAIL(default_port>0 && default_port<65536, 
@@ -669,10 +679,6 @@ PJ_DEF(pj_status_t) pj_turn_session_set_server( pj_turn_session *sess,
         
         sess->default_port = (pj_uint16_t)default_port;
 
-        cnt = PJ_TURN_MAX_DNS_SRV_CNT;
-        ai = (pj_addrinfo*)
-             pj_pool_calloc(sess->pool, cnt, sizeof(pj_addrinfo));
-
         PJ_LOG(5,(sess->obj_name, "Resolving %.*s with DNS A",
                   (int)domain->slen, domain->ptr));
         set_state(sess, PJ_TURN_STATE_RESOLVING);
@@ -683,23 +689,22 @@ PJ_DEF(pj_status_t) pj_turn_session_set_server( pj_turn_session *sess,
             goto on_return;
         }
 
-        status = pj_getaddrinfo(sess->af, domain, &cnt, ai);
-        if (status != PJ_SUCCESS)
-            goto on_return;
+        /* Add reference before async resolution */
+        pj_grp_lock_add_ref(sess->grp_lock);
 
-        sess->srv_addr_cnt = (pj_uint16_t)cnt;
-        sess->srv_addr_list = (pj_sockaddr*)
-                              pj_pool_calloc(sess->pool, cnt, 
-                                             sizeof(pj_sockaddr));
-        for (i=0; i<cnt; ++i) {
-            pj_sockaddr *addr = &sess->srv_addr_list[i];
-            pj_memcpy(addr, &ai[i].ai_addr, sizeof(pj_sockaddr));
-            addr->addr.sa_family = sess->af;
-            pj_sockaddr_set_port(addr, sess->default_port);
-        }
+        pj_assert(sess->gai_q == NULL);
 
-        sess->srv_addr = &sess->srv_addr_list[0];
-        set_state(sess, PJ_TURN_STATE_RESOLVED);
+        /* The callback is called here when domain is an IP address or
+         * the result is cached.
+         */
+        status = pj_getaddrinfo_async(sess->af, domain,
+                                      PJ_TURN_MAX_DNS_SRV_CNT, sess,
+                                      &gai_resolver_cb, &sess->gai_q);
+        if (status != PJ_SUCCESS) {
+            set_state(sess, PJ_TURN_STATE_NULL);
+            pj_grp_lock_dec_ref(sess->grp_lock);
+            goto on_return;
+        }
     }
 
 on_return:
@@ -2029,6 +2034,70 @@ static void dns_srv_resolver_cb(void *user_data,
 }
 
 
+/*
+ * Callback on getaddrinfo() resolution, when there is no DNS resolver.
+ */
+static void gai_resolver_cb(void *user_data,
+                            pj_status_t status,
+                            unsigned count,
+                            const pj_addrinfo ai[])
+{
+    pj_turn_session *sess = (pj_turn_session*) user_data;
+    unsigned i;
+
+    pj_grp_lock_acquire(sess->grp_lock);
+
+    /* Clear query */
+    sess->gai_q = NULL;
+
+    if (sess->is_destroying) {
+        pj_grp_lock_release(sess->grp_lock);
+        pj_grp_lock_dec_ref(sess->grp_lock);
+        return;
+    }
+
+    if (status == PJ_SUCCESS && count == 0)
+        status = PJ_ERESOLVE;
+
+    /* Check failure */
+    if (status != PJ_SUCCESS || sess->pending_destroy) {
+        set_state(sess, PJ_TURN_STATE_DESTROYING);
+        sess_shutdown(sess, status);
+        pj_grp_lock_release(sess->grp_lock);
+        pj_grp_lock_dec_ref(sess->grp_lock);
+        return;
+    }
+
+    sess->srv_addr_cnt = (pj_uint16_t)count;
+    sess->srv_addr_list = (pj_sockaddr*)
+                          pj_pool_calloc(sess->pool, count, 
+                                         sizeof(pj_sockaddr));
+    for (i=0; i<count; ++i) {
+        pj_sockaddr *addr = &sess->srv_addr_list[i];
+        pj_memcpy(addr, &ai[i].ai_addr, sizeof(pj_sockaddr));
+        addr->addr.sa_family = sess->af;
+        pj_sockaddr_set_port(addr, sess->default_port);
+    }
+
+    /* Set current server */
+    sess->srv_addr = &sess->srv_addr_list[0];
+
+    /* Set state to PJ_TURN_STATE_RESOLVED */
+    set_state(sess, PJ_TURN_STATE_RESOLVED);
+
+    /* Run pending allocation */
+    if (sess->pending_alloc) {
+        pj_status_t status2;
+        status2 = pj_turn_session_alloc(sess, NULL);
+        if (status2 != PJ_SUCCESS)
+            on_session_fail(sess, PJ_STUN_ALLOCATE_METHOD, status2, NULL);
+    }
+
+    pj_grp_lock_release(sess->grp_lock);
+    pj_grp_lock_dec_ref(sess->grp_lock);
+}
+
+
 /*
  * Lookup peer descriptor from its address.
  */
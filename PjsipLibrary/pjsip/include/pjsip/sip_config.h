@@ -275,6 +275,31 @@ typedef struct pjsip_cfg_t
 
     } tls;
 
+    /** Server resolution settings */
+    struct {
+        /**
+         * Number of seconds the addresses of a resolved target are kept
+         * in the SIP resolver, so that subsequent #pjsip_resolve() calls
+         * for the same host, port and transport complete immediately.
+         * The entries are not tied to the DNS record TTL, and the SRV
+         * load-balancing selection is reused for the cache lifetime,
+         * so keep this short. If the value is zero, the cache is disabled.
+         *
+         * Default is PJSIP_RESOLVE_CACHE_TTL.
+         */
+        unsigned cache_ttl;
+
+        /**
+         * Address family to put first when interleaving the IPv4 and
+         * IPv6 addresses of a resolved target: 4, 6, or zero to keep
+         * the order returned by the DNS resolver.
+         *
+         * Default is PJSIP_RESOLVE_PREFERRED_AF.
+         */
+        int preferred_af;
+
+    } resolve;
+
 } pjsip_cfg_t;
 
 
@@ -507,6 +532,33 @@ PJ_INLINE(pjsip_cfg_t*) pjsip_cfg(void)
 #endif
 
 
+/**
+ * Maximum number of packets that the UDP transport drains from the socket
+ * with a single #pj_sock_recvmmsg() call when a packet arrives. Packets
+ * are received directly into rdata. Each pending receive operation starts
+ * with only its own rdata, and creates extra rdata (each with its own
+ * pool) as recvmmsg() finds more packets waiting, up to (this value - 1)
+ * of them. Set to 1 to disable batched receive.
+ *
+ * Default is 8.
+ */
+#ifndef PJSIP_UDP_RECV_BATCH
+#   define PJSIP_UDP_RECV_BATCH         8
+#endif
+
+
+/**
+ * Maximum number of sockets that a UDP transport can open on its bound
+ * address with SO_REUSEPORT. See \a shard_cnt field of
+ * pjsip_udp_transport_cfg.
+ *
+ * Default is 16.
+ */
+#ifndef PJSIP_UDP_MAX_SHARD_CNT
+#   define PJSIP_UDP_MAX_SHARD_CNT      16
+#endif
+
+
 /**
  * Encode SIP headers in their short forms to reduce size. By default,
  * SIP headers in outgoing messages will be encoded in their full names. 
@@ -637,6 +689,31 @@ PJ_INLINE(pjsip_cfg_t*) pjsip_cfg(void)
 #endif
 
 
+/**
+ * Maximum number of ioqueues that an endpoint can have. See
+ * #pjsip_endpt_set_ioqueue_cnt().
+ *
+ * Default: 16
+ */
+#ifndef PJSIP_ENDPT_MAX_IOQUEUE
+#   define PJSIP_ENDPT_MAX_IOQUEUE      16
+#endif
+
+
+/**
+ * When the endpoint has more than one ioqueue and they are all polled by
+ * #pjsip_endpt_handle_events2(), this is the maximum time, in msec, to
+ * wait on one ioqueue before moving on to the next one. It bounds the
+ * extra latency of events arriving on an ioqueue while another one is
+ * being waited on.
+ *
+ * Default: 10
+ */
+#ifndef PJSIP_ENDPT_POLL_SLICE
+#   define PJSIP_ENDPT_POLL_SLICE       10
+#endif
+
+
 /**
  * Max entries to process in timer heap per poll. 
  * 
@@ -894,6 +971,61 @@ PJ_INLINE(pjsip_cfg_t*) pjsip_cfg(void)
 #endif
 
 
+/**
+ * Specify whether #pjsip_resolve() should send the fallback DNS A/AAAA
+ * queries for the domain together with the DNS SRV query, instead of
+ * waiting for the SRV resolution to fail first. This saves one DNS
+ * round-trip for domains without SRV records.
+ *
+ * Default: 1 (enabled)
+ */
+#ifndef PJSIP_RESOLVE_PARALLEL_FALLBACK
+#   define PJSIP_RESOLVE_PARALLEL_FALLBACK      1
+#endif
+
+
+/**
+ * Specify the address family to put first when a target resolves to
+ * both IPv4 and IPv6 addresses. Valid values are 4 (IPv4 first) and
+ * 6 (IPv6 first). The addresses of each target are then interleaved
+ * between the two families (as in RFC 8305 section 4), so that the
+ * fail-over to the next address also tries the other family. Zero
+ * keeps the addresses in the order the DNS resolver returned them.
+ *
+ * This option can also be controlled at run-time by the
+ * \a preferred_af setting in pjsip_cfg_t.
+ *
+ * Default: 0 (keep the resolver's order)
+ */
+#ifndef PJSIP_RESOLVE_PREFERRED_AF
+#   define PJSIP_RESOLVE_PREFERRED_AF           0
+#endif
+
+
+/**
+ * Default lifetime of the resolved targets cache in the SIP resolver,
+ * in seconds. Zero disables the cache.
+ *
+ * @see pjsip_cfg_t.resolve.cache_ttl
+ *
+ * Default: 0 (disabled)
+ */
+#ifndef PJSIP_RESOLVE_CACHE_TTL
+#   define PJSIP_RESOLVE_CACHE_TTL              0
+#endif
+
+
+/**
+ * Maximum number of resolved targets kept in the SIP resolver cache. Each
+ * entry takes about the size of #pjsip_server_addresses.
+ *
+ * Default: 16
+ */
+#ifndef PJSIP_RESOLVE_CACHE_SIZE
+#   define PJSIP_RESOLVE_CACHE_SIZE             16
+#endif
+
+
 /**
  * Enable TLS SIP transport support. For most systems this means that
  * OpenSSL must be installed.
@@ -1012,6 +1144,36 @@ PJ_INLINE(pjsip_cfg_t*) pjsip_cfg(void)
 #   define PJSIP_POOL_INC_TDATA         4000
 #endif
 
+/**
+ * Allocate the pools of transmit data buffers and transactions from a
+ * slab allocator owned by the endpoint (see pj_slab_create()), rather
+ * than from the endpoint's pool factory. The memory blocks of these pools
+ * which match the pool sizes above (#PJSIP_POOL_LEN_TDATA,
+ * #PJSIP_POOL_INC_TDATA, #PJSIP_POOL_TSX_LEN and #PJSIP_POOL_TSX_INC) are
+ * then recycled through per-thread caches of fixed-size objects, and only
+ * larger blocks, needed when a message overflows the pool, are allocated
+ * with the pool factory policy.
+ *
+ * Note that memory held by the slab is not accounted in the pool factory
+ * capacity and is only returned when the endpoint is destroyed.
+ *
+ * Default: 0
+ */
+#ifndef PJSIP_POOL_USE_SLAB
+#   define PJSIP_POOL_USE_SLAB          0
+#endif
+
+/**
+ * Number of objects allocated at once by the endpoint's slab when one of
+ * its size classes runs out of free objects. Only used when
+ * #PJSIP_POOL_USE_SLAB is enabled.
+ *
+ * Default: 32
+ */
+#ifndef PJSIP_POOL_SLAB_CHUNK_CNT
+#   define PJSIP_POOL_SLAB_CHUNK_CNT    32
+#endif
+
 /**
  * Initial memory size for UA layer
  */
@@ -138,6 +138,29 @@ PJ_DECL(pj_status_t) pjsip_endpt_handle_events2(pjsip_endpoint *endpt,
                                                 const pj_time_val *max_timeout,
                                                 unsigned *count);
 
+/**
+ * Handle timer events and the network events of one of the endpoint's
+ * ioqueues. When the endpoint has more than one ioqueue (see
+ * #pjsip_endpt_set_ioqueue_cnt()), application would normally dedicate
+ * one polling thread for each ioqueue and call this function from it,
+ * while #pjsip_endpt_handle_events2() polls all ioqueues in turn, waiting
+ * at most PJSIP_ENDPT_POLL_SLICE msec on each before moving to the next,
+ * which adds up to that much latency per ioqueue.
+ *
+ * @param endpt         The endpoint.
+ * @param ioq_index     Index of the ioqueue to poll.
+ * @param max_timeout   Maximum time to wait for events, or NULL to wait forever
+ *                      until event is received.
+ * @param count         Optional argument to receive the number of events that
+ *                      have been handled by the function.
+ *
+ * @return              PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjsip_endpt_handle_events3(pjsip_endpoint *endpt,
+                                                unsigned ioq_index,
+                                                const pj_time_val *max_timeout,
+                                                unsigned *count);
+
 /**
  * Schedule timer to endpoint's timer heap. Application must poll the endpoint
  * periodically (by calling #pjsip_endpt_handle_events) to ensure that the
@@ -342,6 +365,25 @@ PJ_DECL(pj_pool_t*) pjsip_endpt_create_pool( pjsip_endpoint *endpt,
                                              pj_size_t initial,
                                              pj_size_t increment );
 
+/**
+ * Create pool for a short lived object, such as a transmit data buffer or
+ * a transaction. When #PJSIP_POOL_USE_SLAB is enabled, the memory blocks
+ * of the pool are allocated from the endpoint's slab allocator if they
+ * fit in one of its size classes, otherwise this function behaves like
+ * #pjsip_endpt_create_pool(). The pool is released with
+ * #pjsip_endpt_release_pool() as usual.
+ *
+ * @param endpt         The SIP endpoint.
+ * @param pool_name     Name to be assigned to the pool.
+ * @param initial       The initial size of the pool.
+ * @param increment     The resize size.
+ * @return              Memory pool, or NULL on failure.
+ */
+PJ_DECL(pj_pool_t*) pjsip_endpt_create_slab_pool( pjsip_endpoint *endpt,
+                                                  const char *pool_name,
+                                                  pj_size_t initial,
+                                                  pj_size_t increment );
+
 /**
  * Return back pool to endpoint to be released back to the pool factory.
  * This function, like all other endpoint functions, is thread safe.
@@ -491,6 +533,73 @@ PJ_DECL(pjsip_tpmgr*) pjsip_endpt_get_tpmgr(pjsip_endpoint *endpt);
  */
 PJ_DECL(pj_ioqueue_t*) pjsip_endpt_get_ioqueue(pjsip_endpoint *endpt);
 
+/**
+ * Create additional ioqueues, so that sockets can be spread among several
+ * ioqueues each polled by its own thread (with
+ * #pjsip_endpt_handle_events3()), instead of having all polling threads
+ * wait on the same ioqueue. The ioqueue returned by
+ * #pjsip_endpt_get_ioqueue() is the first of them. Transports created
+ * afterwards will be assigned to the ioqueues in round-robin fashion.
+ * The assignment doesn't follow calls: the SIP transport of a call and
+ * its media transports (when they use #pjsip_endpt_next_ioqueue() too)
+ * will usually end up on different ioqueues.
+ *
+ * This should be called before any transport is created and before
+ * any thread polls the endpoint. The number of ioqueues can only be
+ * increased.
+ *
+ * @param endpt     The endpoint.
+ * @param cnt       The total number of ioqueues, up to
+ *                  PJSIP_ENDPT_MAX_IOQUEUE.
+ *
+ * @return          PJ_SUCCESS on success, or the appropriate error code.
+ */
+PJ_DECL(pj_status_t) pjsip_endpt_set_ioqueue_cnt(pjsip_endpoint *endpt,
+                                                 unsigned cnt);
+
+/**
+ * Get the number of ioqueues of the endpoint.
+ *
+ * @param endpt     The endpoint.
+ *
+ * @return          The number of ioqueues.
+ */
+PJ_DECL(unsigned) pjsip_endpt_get_ioqueue_cnt(pjsip_endpoint *endpt);
+
+/**
+ * Get the ioqueue instance at the specified index.
+ *
+ * @param endpt     The endpoint.
+ * @param index     The ioqueue index, starting from zero.
+ *
+ * @return          The ioqueue, or NULL if the index is invalid.
+ */
+PJ_DECL(pj_ioqueue_t*) pjsip_endpt_get_ioqueue2(pjsip_endpoint *endpt,
+                                                unsigned index);
+
+/**
+ * Get the ioqueue to register a new socket to. The ioqueues are returned
+ * in round-robin fashion.
+ *
+ * @param endpt     The endpoint.
+ *
+ * @return          The ioqueue.
+ */
+PJ_DECL(pj_ioqueue_t*) pjsip_endpt_next_ioqueue(pjsip_endpoint *endpt);
+
+/**
+ * Get the number of network events that have been handled on the
+ * specified ioqueue.
+ *
+ * @param endpt     The endpoint.
+ * @param index     The ioqueue index, starting from zero.
+ *
+ * @return          The number of events.
+ */
+PJ_DECL(pj_atomic_value_t) pjsip_endpt_get_ioqueue_event_cnt(
+                                                    pjsip_endpoint *endpt,
+                                                    unsigned index);
+
 /**
  * Find a SIP transport suitable for sending SIP message to the specified
  * address. If transport selector ("sel") is set, then the function will
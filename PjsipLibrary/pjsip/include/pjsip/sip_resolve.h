@@ -114,6 +114,15 @@ PJ_BEGIN_DECL
  *    of the servers with DNS A (or AAAA) resolution.
  *  - When multiple DNS SRV records are returned, parallel DNS A (or AAAA)
  *    queries will be issued simultaneously.
+ *  - The fallback DNS A (and AAAA) queries for the domain are sent together
+ *    with the DNS SRV query (see #PJSIP_RESOLVE_PARALLEL_FALLBACK), so
+ *    domains without SRV records are resolved in a single round-trip.
+ *  - When a target has both IPv4 and IPv6 addresses, the address families
+ *    can be interleaved, starting with the family set by
+ *    #PJSIP_RESOLVE_PREFERRED_AF (by default the resolver's order is kept).
+ *  - Resolved targets can be cached in the SIP resolver for a short time
+ *    (see pjsip_cfg_t.resolve.cache_ttl), so that repeated resolution of
+ *    the same host, port and transport completes immediately.
  *  - The PJLIB-UTIL DNS resolver provides additional functionality such as
  *    response caching, query aggregation, parallel nameservers, fallback
  *    nameserver, etc., which will be described below.
@@ -398,6 +398,34 @@ typedef struct pjsip_tls_setting
      */
     pj_bool_t enable_renegotiation;
 
+    /**
+     * Specify if outgoing connections should resume the TLS session of an
+     * earlier connection to the same server, to avoid a full handshake when
+     * reconnecting. See \a enable_session_reuse in #pj_ssl_sock_param.
+     *
+     * Default: PJ_TRUE
+     */
+    pj_bool_t enable_session_reuse;
+
+    /**
+     * Specify if the listener should issue session tickets, so clients can
+     * resume their sessions without the server session cache. See
+     * \a enable_session_tickets in #pj_ssl_sock_param.
+     *
+     * Default: PJ_FALSE
+     */
+    pj_bool_t enable_session_tickets;
+
+    /**
+     * Specify if the TLS handshake steps should run on the SSL socket
+     * handshake worker threads instead of the transport worker thread, so
+     * that a burst of TLS connections does not block SIP processing. See
+     * \a handshake_offload in #pj_ssl_sock_param.
+     *
+     * Default: PJ_FALSE
+     */
+    pj_bool_t handshake_offload;
+
     /**
      * Callback to be called when a accept operation of the TLS listener fails.
      *
@@ -454,6 +482,7 @@ PJ_INLINE(void) pjsip_tls_setting_default(pjsip_tls_setting *tls_opt)
     tls_opt->sockopt_ignore_error = PJ_TRUE;
     tls_opt->proto = PJSIP_SSL_DEFAULT_PROTO;
     tls_opt->enable_renegotiation = PJ_TRUE;
+    tls_opt->enable_session_reuse = PJ_TRUE;
     tls_opt->initial_timeout = PJSIP_TRANSPORT_SERVER_IDLE_TIME_FIRST;
 }
 
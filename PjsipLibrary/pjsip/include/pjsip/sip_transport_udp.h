@@ -94,6 +94,26 @@ typedef struct pjsip_udp_transport_cfg
      */
     unsigned            async_cnt;
 
+    /**
+     * Number of sockets to open on the bound address. When this is more
+     * than one, the transport opens that many sockets with SO_REUSEPORT
+     * set, so the kernel spreads incoming packets across them, each socket
+     * with \a async_cnt pending reads. The first socket is registered to
+     * the endpoint's main ioqueue. If the endpoint has several ioqueues
+     * (see #pjsip_endpt_set_ioqueue_cnt()), the other sockets are spread
+     * among them, otherwise they are all registered to the main ioqueue,
+     * so the packets are processed in parallel by the threads which poll
+     * the endpoint. They are still presented as one transport, and
+     * outgoing messages are sent using the first socket.
+     *
+     * Sharded transports cannot be paused or restarted with
+     * PJSIP_UDP_TRANSPORT_DESTROY_SOCKET option. The setting is only
+     * supported on platforms that have SO_REUSEPORT.
+     *
+     * Default: 1
+     */
+    unsigned            shard_cnt;
+
     /**
      * QoS traffic type to be set on this transport. When application wants
      * to apply QoS tagging to the transport, it's preferable to set this
@@ -2165,6 +2165,26 @@ typedef struct pjsua_config
      */
     unsigned        thread_cnt;
 
+    /**
+     * Number of ioqueues of the SIP endpoint, see
+     * #pjsip_endpt_set_ioqueue_cnt(). When this is more than one, each
+     * worker thread polls its own ioqueue and is pinned to a CPU core (where
+     * supported, wrapping around when there are more ioqueues than cores),
+     * and the SIP transports are spread among the ioqueues, as are the
+     * media transports unless the media has its own ioqueue (see
+     * \a has_ioqueue in #pjsua_media_config). The number of worker
+     * threads is raised to match if needed, and this value is limited by
+     * the maximum number of worker threads.
+     *
+     * Note that the SIP transport and the media transports are assigned
+     * to the ioqueues independently, so the SIP signaling and the RTP of
+     * the same call are generally handled by different ioqueues (and
+     * cores). Only the load is spread, not the calls.
+     *
+     * Default: 1
+     */
+    unsigned        ioqueue_cnt;
+
     /**
      * Number of nameservers. If no name server is configured, the SIP SRV
      * resolution would be disabled, and domain will be resolved with
@@ -653,6 +653,16 @@ struct UaConfig : public PersistentObject
      */
     unsigned            threadCnt;
 
+    /**
+     * Number of ioqueues of the SIP endpoint. When this is more than one,
+     * each worker thread polls its own ioqueue and is pinned to a CPU core,
+     * and the SIP and media sockets are spread among the ioqueues. See
+     * pjsua_config.ioqueue_cnt for details.
+     *
+     * Default: 1
+     */
+    unsigned            ioqueueCnt;
+
     /**
      * When this flag is non-zero, all callbacks that come from thread
      * other than main thread will be posted to the main thread and
@@ -64,6 +64,12 @@ pjsip_cfg_t pjsip_sip_cfg_var =
     /* TLS transport settings */
     {
         PJSIP_TLS_KEEP_ALIVE_INTERVAL
+    },
+
+    /* Server resolution settings */
+    {
+        PJSIP_RESOLVE_CACHE_TTL,
+        PJSIP_RESOLVE_PREFERRED_AF
     }
 };
 
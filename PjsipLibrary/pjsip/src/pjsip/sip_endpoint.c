@@ -34,6 +34,7 @@
 #include <pj/errno.h>
 #include <pj/lock.h>
 #include <pj/math.h>
+#include <pj/slab.h>
 
 #define PJSIP_EX_NO_MEMORY  pj_NO_MEMORY_EXCEPTION()
 #define THIS_FILE           "sip_endpoint.c"
@@ -63,6 +64,14 @@ struct pjsip_endpoint
     /** Pool factory. */
     pj_pool_factory     *pf;
 
+#if PJSIP_POOL_USE_SLAB
+    /** Slab for transmit data buffer and transaction pools. */
+    pj_slab_t           *slab;
+
+    /** Pool factory allocating from the slab. */
+    pj_slab_pool_factory slab_pf;
+#endif
+
     /** Name. */
     pj_str_t             name;
 
@@ -72,8 +81,17 @@ struct pjsip_endpoint
     /** Transport manager. */
     pjsip_tpmgr         *transport_mgr;
 
-    /** Ioqueue. */
-    pj_ioqueue_t        *ioqueue;
+    /** Ioqueues, the first one is the main ioqueue. */
+    pj_ioqueue_t        *ioqueue[PJSIP_ENDPT_MAX_IOQUEUE];
+
+    /** Number of ioqueues. */
+    unsigned             ioqueue_cnt;
+
+    /** Index of the ioqueue to be returned by pjsip_endpt_next_ioqueue() */
+    unsigned             ioqueue_next;
+
+    /** Number of events that have been handled on each ioqueue. */
+    pj_atomic_t         *ioqueue_events[PJSIP_ENDPT_MAX_IOQUEUE];
 
     /** Last ioqueue err */
     pj_status_t          ioq_last_err;
@@ -506,10 +524,34 @@ PJ_DEF(pj_status_t) pjsip_endpt_create(pj_pool_factory *pf,
                                              PJSIP_MAX_TIMED_OUT_ENTRIES);
 
     /* Create ioqueue. */
-    status = pj_ioqueue_create( endpt->pool, PJSIP_MAX_TRANSPORTS, &endpt->ioqueue);
+    status = pj_ioqueue_create( endpt->pool, PJSIP_MAX_TRANSPORTS,
+                                &endpt->ioqueue[0]);
+    if (status != PJ_SUCCESS) {
+        goto on_error;
+    }
+    status = pj_atomic_create(endpt->pool, 0, &endpt->ioqueue_events[0]);
     if (status != PJ_SUCCESS) {
         goto on_error;
     }
+    endpt->ioqueue_cnt = 1;
+
+#if PJSIP_POOL_USE_SLAB
+    /* Create slab for short lived pools. */
+    {
+        static const pj_size_t slab_sizes[] = {
+            PJSIP_POOL_LEN_TDATA, PJSIP_POOL_INC_TDATA,
+            PJSIP_POOL_TSX_LEN, PJSIP_POOL_TSX_INC
+        };
+
+        status = pj_slab_create(pf, "slab%p", PJ_ARRAY_SIZE(slab_sizes),
+                                slab_sizes, PJSIP_POOL_SLAB_CHUNK_CNT,
+                                &endpt->slab);
+        if (status != PJ_SUCCESS)
+            goto on_error;
+
+        pj_slab_pool_factory_init(&endpt->slab_pf, endpt->slab, pf);
+    }
+#endif
 
     /* Create transport manager. */
     status = pjsip_tpmgr_create( endpt->pool, endpt,
@@ -549,9 +591,13 @@ on_error:
         pjsip_tpmgr_destroy(endpt->transport_mgr);
         endpt->transport_mgr = NULL;
     }
-    if (endpt->ioqueue) {
-        pj_ioqueue_destroy(endpt->ioqueue);
-        endpt->ioqueue = NULL;
+    if (endpt->ioqueue_events[0]) {
+        pj_atomic_destroy(endpt->ioqueue_events[0]);
+        endpt->ioqueue_events[0] = NULL;
+    }
+    if (endpt->ioqueue[0]) {
+        pj_ioqueue_destroy(endpt->ioqueue[0]);
+        endpt->ioqueue[0] = NULL;
     }
     if (endpt->timer_heap) {
         pj_timer_heap_destroy(endpt->timer_heap);
@@ -566,6 +612,12 @@ on_error:
         pj_rwmutex_destroy(endpt->mod_mutex);
         endpt->mod_mutex = NULL;
     }
+#if PJSIP_POOL_USE_SLAB
+    if (endpt->slab) {
+        pj_slab_destroy(endpt->slab);
+        endpt->slab = NULL;
+    }
+#endif
     pj_pool_release( endpt->pool );
 
     PJ_PERROR(4, (THIS_FILE, status, "Error creating endpoint"));
@@ -579,6 +631,7 @@ PJ_DEF(void) pjsip_endpt_destroy(pjsip_endpoint *endpt)
 {
     pjsip_module *mod;
     exit_cb *ecb;
+    unsigned i;
 
     PJ_LOG(5, (THIS_FILE, "Destroying endpoint instance.."));
 
@@ -606,8 +659,11 @@ PJ_DEF(void) pjsip_endpt_destroy(pjsip_endpoint *endpt)
     /* Shutdown and destroy all transports. */
     pjsip_tpmgr_destroy(endpt->transport_mgr);
 
-    /* Destroy ioqueue */
-    pj_ioqueue_destroy(endpt->ioqueue);
+    /* Destroy ioqueues */
+    for (i=0; i<endpt->ioqueue_cnt; ++i) {
+        pj_ioqueue_destroy(endpt->ioqueue[i]);
+        pj_atomic_destroy(endpt->ioqueue_events[i]);
+    }
 
     /* Destroy timer heap */
 #if PJ_TIMER_DEBUG
@@ -631,6 +687,11 @@ PJ_DEF(void) pjsip_endpt_destroy(pjsip_endpoint *endpt)
     /* Delete module's mutex */
     pj_rwmutex_destroy(endpt->mod_mutex);
 
+#if PJSIP_POOL_USE_SLAB
+    /* Destroy slab, all pools allocated from it must have been released. */
+    pj_slab_destroy(endpt->slab);
+#endif
+
     /* Finally destroy pool. */
     pj_pool_release(endpt->pool);
 
@@ -677,6 +738,29 @@ PJ_DEF(pj_pool_t*) pjsip_endpt_create_pool( pjsip_endpoint *endpt,
     return pool;
 }
 
+/*
+ * Create pool for short lived objects.
+ */
+PJ_DEF(pj_pool_t*) pjsip_endpt_create_slab_pool( pjsip_endpoint *endpt,
+                                                 const char *pool_name,
+                                                 pj_size_t initial,
+                                                 pj_size_t increment )
+{
+#if PJSIP_POOL_USE_SLAB
+    pj_pool_t *pool;
+
+    pool = pj_pool_create( &endpt->slab_pf.factory, pool_name,
+                           initial, increment, &pool_callback);
+    if (!pool) {
+        PJ_LOG(4, (THIS_FILE, "Unable to create pool %s!", pool_name));
+    }
+
+    return pool;
+#else
+    return pjsip_endpt_create_pool(endpt, pool_name, initial, increment);
+#endif
+}
+
 /*
  * Return back pool to endpoint's pool manager to be either destroyed or
  * recycled.
@@ -697,14 +781,45 @@ PJ_DEF(void) pjsip_endpt_release_pool( pjsip_endpoint *endpt, pj_pool_t *pool )
 }
 
 
-PJ_DEF(pj_status_t) pjsip_endpt_handle_events2(pjsip_endpoint *endpt,
-                                               const pj_time_val *max_timeout,
-                                               unsigned *p_count)
+/*
+ * Poll the specified ioqueue, repeating while we have immediate events.
+ * Returns the number of events, or -1 on error.
+ */
+static int poll_ioqueue(pjsip_endpoint *endpt, unsigned index,
+                        pj_time_val *timeout)
+{
+    unsigned net_event_count = 0;
+    int c;
+
+    do {
+        c = pj_ioqueue_poll( endpt->ioqueue[index], timeout);
+        if (c <= 0)
+            break;
+
+        net_event_count += c;
+        timeout->sec = timeout->msec = 0;
+    } while (net_event_count < PJSIP_MAX_NET_EVENTS);
+
+    if (net_event_count)
+        pj_atomic_add(endpt->ioqueue_events[index], net_event_count);
+
+    return (c < 0) ? -1 : (int)net_event_count;
+}
+
+/*
+ * Poll the timer heap and the specified ioqueue, or all ioqueues if
+ * ioq_index is negative.
+ */
+static pj_status_t handle_events(pjsip_endpoint *endpt,
+                                 int ioq_index,
+                                 const pj_time_val *max_timeout,
+                                 unsigned *p_count)
 {
     enum { MAX_TIMEOUT_ON_ERR = 10 };
     /* timeout is 'out' var. This just to make compiler happy. */
     pj_time_val timeout = { 0, 0};
     unsigned count = 0, net_event_count = 0;
+    unsigned i;
     int c;
 
     PJ_LOG(6, (THIS_FILE, "pjsip_endpt_handle_events()"));
@@ -741,25 +856,67 @@ PJ_DEF(pj_status_t) pjsip_endpt_handle_events2(pjsip_endpoint *endpt,
      *   the ioqueue often enough, the send() completion will not be
      *   reported in timely manner.
      */
-    do {
-        c = pj_ioqueue_poll( endpt->ioqueue, &timeout);
-        if (c < 0) {
-            pj_status_t err = pj_get_netos_error();
+    if (ioq_index < 0 && endpt->ioqueue_cnt > 1) {
+        /* Polling all ioqueues: wait on each ioqueue in turn for at most
+         * PJSIP_ENDPT_POLL_SLICE msec, until some events are handled or
+         * the timeout elapses, so that events arriving on an ioqueue are
+         * not held back while we block on another one.
+         */
+        pj_time_val start, elapsed;
+
+        pj_gettickcount(&start);
+        for (;;) {
+            for (i=0; i<endpt->ioqueue_cnt; ++i) {
+                pj_time_val wait = { 0, 0 };
+
+                if (net_event_count == 0) {
+                    pj_gettickcount(&elapsed);
+                    PJ_TIME_VAL_SUB(elapsed, start);
+                    if (PJ_TIME_VAL_LT(elapsed, timeout)) {
+                        wait = timeout;
+                        PJ_TIME_VAL_SUB(wait, elapsed);
+                        if (wait.sec > 0 || wait.msec > PJSIP_ENDPT_POLL_SLICE)
+                        {
+                            wait.sec = 0;
+                            wait.msec = PJSIP_ENDPT_POLL_SLICE;
+                        }
+                    }
+                }
+
+                c = poll_ioqueue(endpt, i, &wait);
+                if (c < 0)
+                    break;
+                net_event_count += c;
+            }
+
+            if (c < 0 || net_event_count)
+                break;
+
+            pj_gettickcount(&elapsed);
+            PJ_TIME_VAL_SUB(elapsed, start);
+            if (PJ_TIME_VAL_GTE(elapsed, timeout))
+                break;
+        }
+        if (c > 0)
+            c = 0;
+    } else {
+        if (ioq_index < 0)
+            ioq_index = 0;
+        c = poll_ioqueue(endpt, ioq_index, &timeout);
+    }
+
+    if (c < 0) {
+        pj_status_t err = pj_get_netos_error();
 #if PJSIP_HANDLE_EVENTS_HAS_SLEEP_ON_ERR
-            unsigned msec = PJ_TIME_VAL_MSEC(timeout);
-            pj_thread_sleep(PJ_MIN(msec, MAX_TIMEOUT_ON_ERR));
+        unsigned msec = PJ_TIME_VAL_MSEC(timeout);
+        pj_thread_sleep(PJ_MIN(msec, MAX_TIMEOUT_ON_ERR));
 #endif
 
-            if (p_count)
-                *p_count = count;
-            return err;
-        } else if (c == 0) {
-            break;
-        } else {
-            net_event_count += c;
-            timeout.sec = timeout.msec = 0;
-        }
-    } while (c > 0 && net_event_count < PJSIP_MAX_NET_EVENTS);
+        if (p_count)
+            *p_count = count;
+        return err;
+    }
+    net_event_count += c;
 
     count += net_event_count;
     if (p_count)
@@ -768,6 +925,25 @@ PJ_DEF(pj_status_t) pjsip_endpt_handle_events2(pjsip_endpoint *endpt,
     return PJ_SUCCESS;
 }
 
+PJ_DEF(pj_status_t) pjsip_endpt_handle_events2(pjsip_endpoint *endpt,
+                                               const pj_time_val *max_timeout,
+                                               unsigned *p_count)
+{
+    return handle_events(endpt, -1, max_timeout, p_count);
+}
+
+/*
+ * Handle events of one ioqueue.
+ */
+PJ_DEF(pj_status_t) pjsip_endpt_handle_events3(pjsip_endpoint *endpt,
+                                               unsigned ioq_index,
+                                               const pj_time_val *max_timeout,
+                                               unsigned *p_count)
+{
+    PJ_ASSERT_RETURN(endpt && ioq_index < endpt->ioqueue_cnt, PJ_EINVAL);
+    return handle_events(endpt, (int)ioq_index, max_timeout, p_count);
+}
+
 /*
  * Handle events.
  */
@@ -1157,7 +1333,7 @@ PJ_DEF(pj_status_t) pjsip_endpt_create_resolver(pjsip_endpoint *endpt,
 #if PJSIP_HAS_RESOLVER
     PJ_ASSERT_RETURN(endpt && p_resv, PJ_EINVAL);
     return pj_dns_resolver_create( endpt->pf, NULL, 0, endpt->timer_heap,
-                                   endpt->ioqueue, p_resv);
+                                   endpt->ioqueue[0], p_resv);
 #else
     PJ_UNUSED_ARG(endpt);
     PJ_UNUSED_ARG(p_resv);
@@ -1218,7 +1394,96 @@ PJ_DEF(pjsip_tpmgr*) pjsip_endpt_get_tpmgr(pjsip_endpoint *endpt)
  */
 PJ_DEF(pj_ioqueue_t*) pjsip_endpt_get_ioqueue(pjsip_endpoint *endpt)
 {
-    return endpt->ioqueue;
+    return endpt->ioqueue[0];
+}
+
+/*
+ * Create additional ioqueues.
+ */
+PJ_DEF(pj_status_t) pjsip_endpt_set_ioqueue_cnt(pjsip_endpoint *endpt,
+                                                unsigned cnt)
+{
+    pj_status_t status = PJ_SUCCESS;
+
+    PJ_ASSERT_RETURN(endpt && cnt > 0, PJ_EINVAL);
+    PJ_ASSERT_RETURN(cnt <= PJSIP_ENDPT_MAX_IOQUEUE, PJ_ETOOMANY);
+
+    pj_mutex_lock(endpt->mutex);
+
+    if (cnt < endpt->ioqueue_cnt) {
+        pj_mutex_unlock(endpt->mutex);
+        return PJ_EINVALIDOP;
+    }
+
+    while (endpt->ioqueue_cnt < cnt) {
+        unsigned i = endpt->ioqueue_cnt;
+
+        status = pj_ioqueue_create(endpt->pool, PJSIP_MAX_TRANSPORTS,
+                                   &endpt->ioqueue[i]);
+        if (status != PJ_SUCCESS)
+            break;
+
+        status = pj_atomic_create(endpt->pool, 0, &endpt->ioqueue_events[i]);
+        if (status != PJ_SUCCESS) {
+            pj_ioqueue_destroy(endpt->ioqueue[i]);
+            endpt->ioqueue[i] = NULL;
+            break;
+        }
+
+        ++endpt->ioqueue_cnt;
+    }
+
+    pj_mutex_unlock(endpt->mutex);
+
+    PJ_LOG(4, (THIS_FILE, "Endpoint has %d ioqueue(s)", endpt->ioqueue_cnt));
+    return status;
+}
+
+/*
+ * Get number of ioqueues.
+ */
+PJ_DEF(unsigned) pjsip_endpt_get_ioqueue_cnt(pjsip_endpoint *endpt)
+{
+    return endpt->ioqueue_cnt;
+}
+
+/*
+ * Get ioqueue by index.
+ */
+PJ_DEF(pj_ioqueue_t*) pjsip_endpt_get_ioqueue2(pjsip_endpoint *endpt,
+                                               unsigned index)
+{
+    PJ_ASSERT_RETURN(endpt && index < endpt->ioqueue_cnt, NULL);
+    return endpt->ioqueue[index];
+}
+
+/*
+ * Get ioqueue for a new socket, in round-robin fashion.
+ */
+PJ_DEF(pj_ioqueue_t*) pjsip_endpt_next_ioqueue(pjsip_endpoint *endpt)
+{
+    pj_ioqueue_t *ioqueue;
+
+    if (endpt->ioqueue_cnt == 1)
+        return endpt->ioqueue[0];
+
+    pj_mutex_lock(endpt->mutex);
+    ioqueue = endpt->ioqueue[endpt->ioqueue_next];
+    endpt->ioqueue_next = (endpt->ioqueue_next + 1) % endpt->ioqueue_cnt;
+    pj_mutex_unlock(endpt->mutex);
+
+    return ioqueue;
+}
+
+/*
+ * Get number of events handled on an ioqueue.
+ */
+PJ_DEF(pj_atomic_value_t) pjsip_endpt_get_ioqueue_event_cnt(
+                                                    pjsip_endpoint *endpt,
+                                                    unsigned index)
+{
+    PJ_ASSERT_RETURN(endpt && index < endpt->ioqueue_cnt, 0);
+    return pj_atomic_get(endpt->ioqueue_events[index]);
 }
 
 /*
@@ -1316,6 +1581,11 @@ PJ_DEF(void) pjsip_endpt_dump( pjsip_endpoint *endpt, pj_bool_t detail )
     /* Dumping pool factory. */
     pj_pool_factory_dump(endpt->pf, detail);
 
+#if PJSIP_POOL_USE_SLAB
+    /* Slab for transmit data buffers and transactions. */
+    pj_slab_dump(endpt->slab);
+#endif
+
     /* Pool health. */
     PJ_LOG(3, (THIS_FILE," Endpoint pool capacity=%lu, used_size=%lu",
                (unsigned long)pj_pool_get_capacity(endpt->pool),
@@ -1332,6 +1602,16 @@ PJ_DEF(void) pjsip_endpt_dump( pjsip_endpoint *endpt, pj_bool_t detail )
      */
     pjsip_tpmgr_dump_transports( endpt->transport_mgr );
 
+    /* Ioqueues. */
+    {
+        unsigned i;
+
+        for (i=0; i<endpt->ioqueue_cnt; ++i) {
+            PJ_LOG(3,(THIS_FILE, " Ioqueue %d has handled %ld events", i,
+                      (long)pj_atomic_get(endpt->ioqueue_events[i])));
+        }
+    }
+
     /* Timer. */
 #if PJ_TIMER_DEBUG
     pj_timer_heap_dump(endpt->timer_heap);
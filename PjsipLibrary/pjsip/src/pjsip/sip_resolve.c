@@ -26,6 +26,7 @@
 #include <pj/assert.h>
 #include <pj/ctype.h>
 #include <pj/log.h>
+#include <pj/os.h>
 #include <pj/pool.h>
 #include <pj/rand.h>
 #include <pj/string.h>
@@ -45,6 +46,7 @@ struct naptr_target
 struct query
 {
     char                    *objname;
+    pjsip_resolver_t        *resolver;
 
     pj_dns_type              query_type;
     void                    *token;
@@ -69,14 +71,49 @@ struct query
 };
 
 
+/* Host resolution with pj_getaddrinfo_async(), used when there is no
+ * DNS resolver.
+ */
+struct gai_query
+{
+    pjsip_host_info          target;
+    pjsip_transport_type_e   type;
+    void                    *token;
+    pjsip_resolver_callback *cb;
+};
+
+
+/* Resolved target in the SIP resolver cache */
+struct target_cache
+{
+    pj_str_t                 host;
+    char                     host_buf[PJ_MAX_HOSTNAME];
+    int                      port;
+    pjsip_transport_type_e   type;
+    unsigned                 flag;
+    pj_time_val              expiry;
+    pjsip_server_addresses   server;
+};
+
+
 struct pjsip_resolver_t
 {
     pj_dns_resolver *res;
     pj_grp_lock_t   *grp_lock;
     pjsip_ext_resolver *ext_res;
+
+    /* Resolved targets cache, created on first use */
+    pj_pool_factory *pf;
+    pj_pool_t       *cache_pool;
+    unsigned         cache_cnt;
+    struct target_cache *cache;
 };
 
 
+static void gai_callback(void *user_data,
+                         pj_status_t status,
+                         unsigned count,
+                         const pj_addrinfo ai[]);
 static void srv_resolver_cb(void *user_data,
                             pj_status_t status,
                             const pj_dns_srv_record *rec);
@@ -107,6 +144,8 @@ PJ_DEF(pj_status_t) pjsip_resolver_create( pj_pool_t *pool,
 
     pj_grp_lock_add_ref(resolver->grp_lock);
 
+    resolver->pf = pool->factory;
+
     *p_res = resolver;
 
     return PJ_SUCCESS;
@@ -172,6 +211,13 @@ PJ_DEF(void) pjsip_resolver_destroy(pjsip_resolver_t *resolver)
         resolver->res = NULL;
     }
 
+    if (resolver->cache_pool) {
+        pj_pool_release(resolver->cache_pool);
+        resolver->cache_pool = NULL;
+        resolver->cache = NULL;
+        resolver->cache_cnt = 0;
+    }
+
     if (resolver->grp_lock) {
         pj_grp_lock_dec_ref(resolver->grp_lock);
         resolver->grp_lock = NULL;
@@ -201,6 +247,274 @@ static int get_ip_addr_ver(const pj_str_t *host)
 }
 
 
+/*
+ * Set the port, transport type and length of resolved addresses.
+ */
+static void set_server_entries(const pjsip_host_info *target,
+                               pjsip_transport_type_e type,
+                               pjsip_server_addresses *svr_addr)
+{
+    char addr_str[PJ_INET6_ADDRSTRLEN+10];
+    pj_uint16_t srv_port;
+    unsigned i;
+
+    for (i = 0; i < svr_addr->count; i++) {
+        /* After address resolution, update IPv6 bitflag in
+         * transport type.
+         */
+        if (svr_addr->entry[i].addr.addr.sa_family == pj_AF_INET6()) {
+            type |= PJSIP_TRANSPORT_IPV6;
+        } else {
+            type &= ~PJSIP_TRANSPORT_IPV6;
+        }
+
+        /* Set the port number */
+        if (target->addr.port == 0) {
+           srv_port = (pj_uint16_t)
+                      pjsip_transport_get_default_port_for_type(type);
+        } else {
+           srv_port = (pj_uint16_t)target->addr.port;
+        }
+        pj_sockaddr_set_port(&svr_addr->entry[i].addr, srv_port);
+
+        PJ_LOG(5,(THIS_FILE, 
+                  "Target '%.*s:%d' type=%s resolved to "
+                  "'%s' type=%s (%s)",
+                  (int)target->addr.host.slen,
+                  target->addr.host.ptr,
+                  target->addr.port,
+                  pjsip_transport_get_type_name(target->type),
+                  pj_sockaddr_print(&svr_addr->entry[i].addr, addr_str,
+                                    sizeof(addr_str), 3),
+                  pjsip_transport_get_type_name(type),
+                  pjsip_transport_get_type_desc(type)));
+
+        svr_addr->entry[i].priority = 0;
+        svr_addr->entry[i].weight = 0;
+        svr_addr->entry[i].type = type;
+        svr_addr->entry[i].addr_len = 
+                            pj_sockaddr_get_len(&svr_addr->entry[i].addr);
+    }
+}
+
+
+#if PJSIP_HAS_RESOLVER
+
+/*
+ * Find the cache entry of the target. Resolver lock must be held.
+ */
+static struct target_cache *find_target(pjsip_resolver_t *resolver,
+                                        const pjsip_host_info *target)
+{
+    unsigned i;
+
+    for (i = 0; i < resolver->cache_cnt; ++i) {
+        struct target_cache *tc = &resolver->cache[i];
+
+        if (tc->port == target->addr.port && tc->type == target->type &&
+            tc->flag == target->flag &&
+            pj_stricmp(&tc->host, &target->addr.host) == 0)
+        {
+            return tc;
+        }
+    }
+
+    return NULL;
+}
+
+
+/*
+ * Get the addresses of the target from the cache, if it's not expired.
+ */
+static pj_bool_t get_cached_target(pjsip_resolver_t *resolver,
+                                   const pjsip_host_info *target,
+                                   pjsip_server_addresses *svr_addr)
+{
+    struct target_cache *tc;
+    pj_time_val now;
+    pj_bool_t found = PJ_FALSE;
+
+    if (pjsip_cfg()->resolve.cache_ttl == 0)
+        return PJ_FALSE;
+
+    pj_gettickcount(&now);
+
+    pj_grp_lock_acquire(resolver->grp_lock);
+
+    tc = find_target(resolver, target);
+    if (tc && PJ_TIME_VAL_GT(tc->expiry, now)) {
+        pj_memcpy(svr_addr, &tc->server, sizeof(*svr_addr));
+        found = PJ_TRUE;
+    }
+
+    pj_grp_lock_release(resolver->grp_lock);
+
+    return found;
+}
+
+
+/*
+ * Save the addresses of the target in the cache.
+ */
+static void cache_target(pjsip_resolver_t *resolver,
+                         const pjsip_host_info *target,
+                         const pjsip_server_addresses *svr_addr)
+{
+    unsigned ttl = pjsip_cfg()->resolve.cache_ttl;
+    struct target_cache *tc;
+    pj_time_val now;
+
+    if (ttl == 0 || svr_addr->count == 0 ||
+        target->addr.host.slen >= PJ_MAX_HOSTNAME)
+    {
+        return;
+    }
+
+    pj_gettickcount(&now);
+
+    pj_grp_lock_acquire(resolver->grp_lock);
+
+    if (!resolver->cache_pool) {
+        resolver->cache_pool = pj_pool_create(resolver->pf, "sipres%p",
+                                              512, 512, NULL);
+        if (!resolver->cache_pool) {
+            pj_grp_lock_release(resolver->grp_lock);
+            return;
+        }
+        resolver->cache = (struct target_cache*)
+                          pj_pool_calloc(resolver->cache_pool,
+                                         PJSIP_RESOLVE_CACHE_SIZE,
+                                         sizeof(struct target_cache));
+    }
+
+    tc = find_target(resolver, target);
+    if (!tc) {
+        if (resolver->cache_cnt < PJSIP_RESOLVE_CACHE_SIZE) {
+            tc = &resolver->cache[resolver->cache_cnt++];
+        } else {
+            unsigned i;
+
+            /* Replace the entry which expires first */
+            tc = &resolver->cache[0];
+            for (i = 1; i < resolver->cache_cnt; ++i) {
+                if (PJ_TIME_VAL_LT(resolver->cache[i].expiry, tc->expiry))
+                    tc = &resolver->cache[i];
+            }
+        }
+
+        tc->host.ptr = tc->host_buf;
+        pj_strncpy(&tc->host, &target->addr.host, sizeof(tc->host_buf));
+        tc->port = target->addr.port;
+        tc->type = target->type;
+        tc->flag = target->flag;
+    }
+
+    tc->expiry = now;
+    tc->expiry.sec += ttl;
+    pj_memcpy(&tc->server, svr_addr, sizeof(*svr_addr));
+
+    pj_grp_lock_release(resolver->grp_lock);
+}
+
+
+/*
+ * Reorder the addresses in [start, end) so that the address families
+ * alternate, starting with the preferred family in pjsip_cfg(), while
+ * keeping the order of the addresses within each family.
+ */
+static void interleave_addr_family(pjsip_server_addresses *svr_addr,
+                                   unsigned start, unsigned end)
+{
+    pjsip_server_address_record tmp[PJSIP_MAX_RESOLVED_ADDRESSES];
+    unsigned next[2] = { 0, 0 };
+    unsigned i, cnt, turn = 0;
+    int pref_af;
+
+    if (end - start < 2)
+        return;
+
+    switch (pjsip_cfg()->resolve.preferred_af) {
+    case 4:
+        pref_af = pj_AF_INET();
+        break;
+    case 6:
+        pref_af = pj_AF_INET6();
+        break;
+    default:
+        return;
+    }
+    cnt = end - start;
+    pj_memcpy(tmp, &svr_addr->entry[start], cnt * sizeof(tmp[0]));
+
+    for (i = 0; i < cnt; ++i) {
+        unsigned f;
+
+        /* Move each cursor to the next address of its family, where
+         * cursor 0 is for the preferred family.
+         */
+        for (f = 0; f < 2; ++f) {
+            while (next[f] < cnt &&
+                   (tmp[next[f]].addr.addr.sa_family == pref_af) != (f == 0))
+            {
+                ++next[f];
+            }
+        }
+
+        if (next[turn] >= cnt)
+            turn = !turn;
+
+        pj_memcpy(&svr_addr->entry[start + i], &tmp[next[turn]],
+                  sizeof(tmp[0]));
+        ++next[turn];
+        turn = !turn;
+    }
+}
+
+#endif  /* PJSIP_HAS_RESOLVER */
+
+
+/*
+ * This callback is called when target is resolved with getaddrinfo().
+ */
+static void gai_callback(void *user_data,
+                         pj_status_t status,
+                         unsigned count,
+                         const pj_addrinfo ai[])
+{
+    struct gai_query *gq = (struct gai_query*) user_data;
+    pjsip_server_addresses svr_addr;
+    unsigned i;
+
+    if (status == PJ_SUCCESS && count == 0)
+        status = PJ_ERESOLVE;
+
+    if (status != PJ_SUCCESS) {
+        PJ_PERROR(4,(THIS_FILE, status,
+                     "Failed to resolve '%.*s'",
+                     (int)gq->target.addr.host.slen,
+                     gq->target.addr.host.ptr));
+
+        /* "Normalize" error to PJ_ERESOLVE. This is a special error
+         * because it will be translated to SIP status 502 by
+         * sip_transaction.c
+         */
+        (*gq->cb)(PJ_ERESOLVE, gq->token, NULL);
+        return;
+    }
+
+    if (count > PJSIP_MAX_RESOLVED_ADDRESSES)
+        count = PJSIP_MAX_RESOLVED_ADDRESSES;
+
+    svr_addr.count = count;
+    for (i = 0; i < count; i++) {
+        pj_sockaddr_cp(&svr_addr.entry[i].addr, &ai[i].ai_addr);
+    }
+    set_server_entries(&gq->target, gq->type, &svr_addr);
+
+    (*gq->cb)(PJ_SUCCESS, gq->token, &svr_addr);
+}
+
+
 /*
  * This is the main function for performing server resolution.
  */
@@ -279,14 +593,11 @@ PJ_DEF(void) pjsip_resolve( pjsip_resolver_t *resolver,
     }
 
 
-    /* If target is an IP address, or if resolver is not configured, 
-     * we can just finish the resolution now using pj_gethostbyname()
+    /* If target is an IP address, we can just finish the resolution now.
+     * If resolver is not configured, resolve it with getaddrinfo() in
+     * the background.
      */
     if (ip_addr_ver || resolver->res == NULL) {
-        char addr_str[PJ_INET6_ADDRSTRLEN+10];
-        pj_uint16_t srv_port;
-        unsigned i;
-
         if (ip_addr_ver != 0) {
             /* Target is an IP address, no need to resolve */
             svr_addr.count = 1;
@@ -326,8 +637,7 @@ PJ_DEF(void) pjsip_resolve( pjsip_resolver_t *resolver,
                              &svr_addr.entry[0].addr.ipv6.sin6_addr);
             }
         } else {
-            pj_addrinfo ai[PJSIP_MAX_RESOLVED_ADDRESSES];
-            unsigned count;
+            struct gai_query *gq;
 
             PJ_LOG(5,(THIS_FILE,
                       "DNS resolver not available, target '%.*s:%d' type=%s "
@@ -337,63 +647,27 @@ PJ_DEF(void) pjsip_resolve( pjsip_resolver_t *resolver,
                       target->addr.port,
                       pjsip_transport_get_type_name(target->type)));
 
-            /* Resolve */
-            count = PJSIP_MAX_RESOLVED_ADDRESSES;
-            status = pj_getaddrinfo(af, &target->addr.host, &count, ai);
-            if (status != PJ_SUCCESS) {
-                /* "Normalize" error to PJ_ERESOLVE. This is a special error
-                 * because it will be translated to SIP status 502 by
-                 * sip_transaction.c
-                 */
-                status = PJ_ERESOLVE;
-                goto on_error;
-            }
-
-            svr_addr.count = count;
-            for (i = 0; i < count; i++) {
-                pj_sockaddr_cp(&svr_addr.entry[i].addr, &ai[i].ai_addr);
-            }
-        }
+            gq = PJ_POOL_ZALLOC_T(pool, struct gai_query);
+            gq->target = *target;
+            pj_strdup(pool, &gq->target.addr.host, &target->addr.host);
+            gq->type = type;
+            gq->token = token;
+            gq->cb = cb;
 
-        for (i = 0; i < svr_addr.count; i++) {
-            /* After address resolution, update IPv6 bitflag in
-             * transport type.
+            /* The callback may be called before this function returns,
+             * when the result is cached.
              */
-            af = svr_addr.entry[i].addr.addr.sa_family;
-            if (af == pj_AF_INET6()) {
-                type |= PJSIP_TRANSPORT_IPV6;
-            } else {
-                type &= ~PJSIP_TRANSPORT_IPV6;
-            }
-
-            /* Set the port number */
-            if (target->addr.port == 0) {
-               srv_port = (pj_uint16_t)
-                          pjsip_transport_get_default_port_for_type(type);
-            } else {
-               srv_port = (pj_uint16_t)target->addr.port;
-            }
-            pj_sockaddr_set_port(&svr_addr.entry[i].addr, srv_port);
+            status = pj_getaddrinfo_async(af, &target->addr.host,
+                                          PJSIP_MAX_RESOLVED_ADDRESSES,
+                                          gq, &gai_callback, NULL);
+            if (status != PJ_SUCCESS)
+                goto on_error;
 
-            PJ_LOG(5,(THIS_FILE, 
-                      "Target '%.*s:%d' type=%s resolved to "
-                      "'%s' type=%s (%s)",
-                      (int)target->addr.host.slen,
-                      target->addr.host.ptr,
-                      target->addr.port,
-                      pjsip_transport_get_type_name(target->type),
-                      pj_sockaddr_print(&svr_addr.entry[i].addr, addr_str,
-                                        sizeof(addr_str), 3),
-                      pjsip_transport_get_type_name(type),
-                      pjsip_transport_get_type_desc(type)));
-
-            svr_addr.entry[i].priority = 0;
-            svr_addr.entry[i].weight = 0;
-            svr_addr.entry[i].type = type;
-            svr_addr.entry[i].addr_len = 
-                                pj_sockaddr_get_len(&svr_addr.entry[i].addr);
+            return;
         }
 
+        set_server_entries(target, type, &svr_addr);
+
         /* Call the callback. */
         (*cb)(status, token, &svr_addr);
 
@@ -404,9 +678,23 @@ PJ_DEF(void) pjsip_resolve( pjsip_resolver_t *resolver,
     /* Target is not an IP address so we need to resolve it. */
 #if PJSIP_HAS_RESOLVER
 
+    /* The target may have been resolved recently */
+    if (get_cached_target(resolver, target, &svr_addr)) {
+        PJ_LOG(5,(THIS_FILE,
+                  "Target '%.*s:%d' type=%s resolved from cache",
+                  (int)target->addr.host.slen,
+                  target->addr.host.ptr,
+                  target->addr.port,
+                  pjsip_transport_get_type_name(target->type)));
+
+        (*cb)(PJ_SUCCESS, token, &svr_addr);
+        return;
+    }
+
     /* Build the query state */
     query = PJ_POOL_ZALLOC_T(pool, struct query);
     query->objname = THIS_FILE;
+    query->resolver = resolver;
     query->token = token;
     query->cb = cb;
     query->grp_lock = resolver->grp_lock;
@@ -477,6 +765,10 @@ PJ_DEF(void) pjsip_resolve( pjsip_resolver_t *resolver,
         else /* af == pj_AF_INET() */
             opt = PJ_DNS_SRV_FALLBACK_A;
 
+#if PJSIP_RESOLVE_PARALLEL_FALLBACK
+        opt |= PJ_DNS_SRV_PARALLEL_FALLBACK;
+#endif
+
         status = pj_dns_srv_resolve(&query->naptr[0].name,
                                     &query->naptr[0].res_type,
                                     query->req.def_port, pool, resolver->res,
@@ -591,9 +883,11 @@ static void dns_a_callback(void *user_data,
 
     /* Call the callback if all DNS queries have been completed */
     if (query->object == NULL && query->object6 == NULL) {
-        if (srv->count > 0)
+        if (srv->count > 0) {
+            interleave_addr_family(srv, 0, srv->count);
+            cache_target(query->resolver, &query->req.target, srv);
             (*query->cb)(PJ_SUCCESS, query->token, &query->server);
-        else
+        } else
             (*query->cb)(query->last_error, query->token, NULL);
     }
 
@@ -654,9 +948,11 @@ static void dns_aaaa_callback(void *user_data,
 
     /* Call the callback if all DNS queries have been completed */
     if (query->object == NULL && query->object6 == NULL) {
-        if (srv->count > 0)
+        if (srv->count > 0) {
+            interleave_addr_family(srv, 0, srv->count);
+            cache_target(query->resolver, &query->req.target, srv);
             (*query->cb)(PJ_SUCCESS, query->token, &query->server);
-        else
+        } else
             (*query->cb)(query->last_error, query->token, NULL);
     }
 
@@ -686,6 +982,7 @@ static void srv_resolver_cb(void *user_data,
     srv.count = 0;
     for (i=0; i<rec->count; ++i) {
         const pj_dns_addr_record *s = &rec->entry[i].server;
+        unsigned start = srv.count;
         unsigned j;
 
         for (j = 0; j < s->addr_count &&
@@ -710,8 +1007,12 @@ static void srv_resolver_cb(void *user_data,
 
             ++srv.count;
         }
+
+        interleave_addr_family(&srv, start, srv.count);
     }
 
+    cache_target(query->resolver, &query->req.target, &srv);
+
     /* Call the callback */
     (*query->cb)(PJ_SUCCESS, query->token, &srv);
 }
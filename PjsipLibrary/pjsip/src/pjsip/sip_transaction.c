@@ -31,6 +31,7 @@
 #include <pj/assert.h>
 #include <pj/guid.h>
 #include <pj/log.h>
+#include <pj/trace.h>
 
 #define THIS_FILE   "sip_transaction.c"
 
@@ -529,8 +530,8 @@ PJ_DEF(pj_status_t) pjsip_tsx_layer_init_module(pjsip_endpoint *endpt)
 
 
     /* Create hash table. */
-    mod_tsx_layer.htable = pj_hash_create( pool, pjsip_cfg()->tsx.max_count );
-    mod_tsx_layer.htable2 = pj_hash_create(pool, pjsip_cfg()->tsx.max_count);
+    mod_tsx_layer.htable = pj_hash_create_oa(pool, pjsip_cfg()->tsx.max_count);
+    mod_tsx_layer.htable2 = pj_hash_create_oa(pool,pjsip_cfg()->tsx.max_count);
     if (!mod_tsx_layer.htable || !mod_tsx_layer.htable2) {
         pjsip_endpt_release_pool(endpt, pool);
         return PJ_ENOMEM;
@@ -1154,8 +1155,9 @@ static pj_status_t tsx_create( pjsip_module *tsx_user,
     pjsip_transaction *tsx;
     pj_status_t status;
 
-    pool = pjsip_endpt_create_pool( mod_tsx_layer.endpt, "tsx", 
-                                    PJSIP_POOL_TSX_LEN, PJSIP_POOL_TSX_INC );
+    pool = pjsip_endpt_create_slab_pool( mod_tsx_layer.endpt, "tsx",
+                                         PJSIP_POOL_TSX_LEN,
+                                         PJSIP_POOL_TSX_INC );
     if (!pool)
         return PJ_ENOMEM;
 
@@ -1401,6 +1403,7 @@ static void tsx_set_state( pjsip_transaction *tsx,
                state_str[tsx->state], state_str[state], 
                pjsip_event_str(event_src_type)));
     pj_log_push_indent();
+    PJ_TRACE_INSTANT("sip", "tsx_state", state);
 
     /* Change state. */
     tsx->state = state;
@@ -484,9 +484,9 @@ PJ_DEF(pj_status_t) pjsip_tx_data_create( pjsip_tpmgr *mgr,
 
     PJ_ASSERT_RETURN(mgr && p_tdata, PJ_EINVAL);
 
-    pool = pjsip_endpt_create_pool( mgr->endpt, "tdta%p",
-                                    PJSIP_POOL_LEN_TDATA,
-                                    PJSIP_POOL_INC_TDATA );
+    pool = pjsip_endpt_create_slab_pool( mgr->endpt, "tdta%p",
+                                         PJSIP_POOL_LEN_TDATA,
+                                         PJSIP_POOL_INC_TDATA );
     if (!pool)
         return PJ_ENOMEM;
 
@@ -706,7 +706,8 @@ static pj_status_t tcp_create( struct tcp_listener *listener,
     tcp_callback.on_data_sent = &on_data_sent;
     tcp_callback.on_connect_complete = &on_connect_complete;
 
-    ioqueue = pjsip_endpt_get_ioqueue(listener->endpt);
+    /* Spread the connections among the endpoint's ioqueues */
+    ioqueue = pjsip_endpt_next_ioqueue(listener->endpt);
     status = pj_activesock_create(pool, sock, pj_SOCK_STREAM(), &asock_cfg,
                                   ioqueue, &tcp_callback, tcp, &tcp->asock);
     if (status != PJ_SUCCESS) {
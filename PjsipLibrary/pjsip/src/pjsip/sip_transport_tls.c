@@ -341,6 +341,9 @@ static void set_ssock_param(pj_ssl_sock_param *ssock_param,
 
     ssock_param->enable_renegotiation =
                                     listener->tls_setting.enable_renegotiation;
+    ssock_param->enable_session_tickets =
+                                    listener->tls_setting.enable_session_tickets;
+    ssock_param->handshake_offload = listener->tls_setting.handshake_offload;
     /* Copy the sockopt */
     if (listener->tls_setting.sockopt_params.cnt > 0) {
         pj_memcpy(&ssock_param->sockopt_params, 
@@ -1237,7 +1240,7 @@ static pj_status_t lis_create_transport(pjsip_tpfactory *factory,
     if (listener->tls_setting.on_verify_cb)
         ssock_param.cb.on_verify_cb = &on_verify_cb;
     ssock_param.async_cnt = 1;
-    ssock_param.ioqueue = pjsip_endpt_get_ioqueue(listener->endpt);
+    ssock_param.ioqueue = pjsip_endpt_next_ioqueue(listener->endpt);
     ssock_param.timer_heap = pjsip_endpt_get_timer_heap(listener->endpt);
     ssock_param.server_name = remote_name;
     ssock_param.timeout = listener->tls_setting.timeout;
@@ -1264,6 +1267,8 @@ static pj_status_t lis_create_transport(pjsip_tpfactory *factory,
                                      listener->tls_setting.sockopt_ignore_error;
 
     ssock_param.enable_renegotiation = listener->tls_setting.enable_renegotiation;
+    ssock_param.enable_session_reuse = listener->tls_setting.enable_session_reuse;
+    ssock_param.handshake_offload = listener->tls_setting.handshake_offload;
     /* Copy the sockopt */
     if (listener->tls_setting.sockopt_params.cnt > 0) {
         pj_memcpy(&ssock_param.sockopt_params, 
@@ -65,17 +65,50 @@
 #endif
 
 
+#if PJSIP_UDP_RECV_BATCH > 1
+/* Packets drained from the socket by pj_sock_recvmmsg() for one pending
+ * read. The packets are received directly into rdata: the first one into
+ * the rdata of the pending read, the others into the extra rdata in
+ * rdata[1..cap-1], which are created as the traffic requires.
+ */
+struct udp_batch
+{
+    pj_sock_mmsg        msg[PJSIP_UDP_RECV_BATCH];
+    pjsip_rx_data      *rdata[PJSIP_UDP_RECV_BATCH];
+    unsigned            cap;
+    unsigned            cnt;
+    unsigned            pos;
+    pj_bool_t           drained;
+};
+#endif
+
+/* Additional socket bound to the transport address with SO_REUSEPORT.
+ * It is registered to one of the endpoint's ioqueues, so it is polled by
+ * the same threads that poll the endpoint.
+ */
+struct udp_shard
+{
+    pj_sock_t           sock;
+    pj_ioqueue_key_t   *key;
+};
+
 /* Struct udp_transport "inherits" struct pjsip_transport */
 struct udp_transport
 {
     pjsip_transport     base;
     pj_sock_t           sock;
     pj_ioqueue_key_t   *key;
+    unsigned            async_cnt;
+    unsigned            shard_cnt;
+    struct udp_shard   *shard;  /* shard_cnt-1 entries, for shard 1..N-1 */
     int                 rdata_cnt;
     pjsip_rx_data     **rdata;
     int                 is_closing;
     pj_bool_t           is_paused;
     int                 read_loop_spin;
+#if PJSIP_UDP_RECV_BATCH > 1
+    struct udp_batch   *batch;
+#endif
 
     /* Group lock to be used by UDP transport and ioqueue key */
     pj_grp_lock_t      *grp_lock;
@@ -83,17 +116,14 @@ struct udp_transport
 
 
 /*
- * Initialize transport's receive buffer from the specified pool.
+ * Create receive buffer from the specified pool.
  */
-static void init_rdata(struct udp_transport *tp, unsigned rdata_index,
-                       pj_pool_t *pool, pjsip_rx_data **p_rdata)
+static pjsip_rx_data *alloc_rdata(struct udp_transport *tp,
+                                  unsigned rdata_index,
+                                  pj_pool_t *pool)
 {
     pjsip_rx_data *rdata;
 
-    /* Reset pool. */
-    //note: already done by caller
-    //pj_pool_reset(pool);
-
     rdata = PJ_POOL_ZALLOC_T(pool, pjsip_rx_data);
 
     /* Init tp_info part. */
@@ -104,6 +134,23 @@ static void init_rdata(struct udp_transport *tp, unsigned rdata_index,
     pj_ioqueue_op_key_init(&rdata->tp_info.op_key.op_key, 
                            sizeof(pj_ioqueue_op_key_t));
 
+    return rdata;
+}
+
+/*
+ * Initialize transport's receive buffer from the specified pool.
+ */
+static void init_rdata(struct udp_transport *tp, unsigned rdata_index,
+                       pj_pool_t *pool, pjsip_rx_data **p_rdata)
+{
+    pjsip_rx_data *rdata;
+
+    /* Reset pool. */
+    //note: already done by caller
+    //pj_pool_reset(pool);
+
+    rdata = alloc_rdata(tp, rdata_index, pool);
+
     tp->rdata[rdata_index] = rdata;
 
     if (p_rdata)
@@ -111,6 +158,126 @@ static void init_rdata(struct udp_transport *tp, unsigned rdata_index,
 }
 
 
+/*
+ * Get the socket and ioqueue key that the specified rdata reads from.
+ * The first async_cnt rdata belong to the main socket, the next async_cnt
+ * to the first additional socket, and so on.
+ */
+static void get_rdata_sock(struct udp_transport *tp, unsigned rdata_index,
+                           pj_sock_t *p_sock, pj_ioqueue_key_t **p_key)
+{
+    unsigned shard = rdata_index / tp->async_cnt;
+
+    if (shard == 0) {
+        if (p_sock) *p_sock = tp->sock;
+        if (p_key) *p_key = tp->key;
+    } else {
+        if (p_sock) *p_sock = tp->shard[shard-1].sock;
+        if (p_key) *p_key = tp->shard[shard-1].key;
+    }
+}
+
+
+#if PJSIP_UDP_RECV_BATCH > 1
+/*
+ * Create more extra rdata for the batch of the specified pending read,
+ * doubling the number of packets that the next recvmmsg() can drain.
+ */
+static void udp_batch_grow(struct udp_transport *tp, unsigned rdata_index)
+{
+    struct udp_batch *b = &tp->batch[rdata_index];
+    unsigned cap = b->cap * 2;
+
+    if (cap > PJSIP_UDP_RECV_BATCH)
+        cap = PJSIP_UDP_RECV_BATCH;
+
+    while (b->cap < cap) {
+        pj_pool_t *pool;
+
+        pool = pjsip_endpt_create_pool(tp->base.endpt, "rtd%p",
+                                       PJSIP_POOL_RDATA_LEN,
+                                       PJSIP_POOL_RDATA_INC);
+        if (!pool)
+            break;
+
+        b->rdata[b->cap++] = alloc_rdata(tp, rdata_index, pool);
+    }
+}
+
+/*
+ * Get the next drained packet, draining the socket with recvmmsg() first
+ * if there is none left (and can_read is set). The packet is not copied:
+ * if it was received into an extra rdata, that rdata takes the place of
+ * *p_rdata as the rdata of the pending read. Returns PJ_FALSE if no packet
+ * is available; drained is set if the socket has been found empty, so the
+ * caller can read asynchronously.
+ */
+static pj_bool_t udp_batch_next(struct udp_transport *tp,
+                                pjsip_rx_data **p_rdata,
+                                pj_bool_t can_read,
+                                pj_ssize_t *bytes_read,
+                                pj_bool_t *drained)
+{
+    pjsip_rx_data *rdata = *p_rdata;
+    unsigned rdata_index = (unsigned)(unsigned long)(pj_ssize_t)
+                           rdata->tp_info.tp_data;
+    struct udp_batch *b = &tp->batch[rdata_index];
+    pj_sock_mmsg *m;
+    pj_sock_t sock;
+
+    *drained = PJ_FALSE;
+
+    if (b->pos >= b->cnt) {
+        unsigned i, cnt = b->cap;
+        pj_status_t status;
+
+        if (b->drained) {
+            b->drained = PJ_FALSE;
+            *drained = PJ_TRUE;
+            return PJ_FALSE;
+        }
+        if (!can_read)
+            return PJ_FALSE;
+
+        b->rdata[0] = rdata;
+        for (i=0; i<b->cap; ++i) {
+            b->msg[i].buf = b->rdata[i]->pkt_info.packet;
+            b->msg[i].size = sizeof(b->rdata[i]->pkt_info.packet);
+        }
+        b->cnt = b->pos = 0;
+        get_rdata_sock(tp, rdata_index, &sock, NULL);
+        status = pj_sock_recvmmsg(sock, b->msg, &cnt, 0);
+        if (status != PJ_SUCCESS) {
+            *drained = (status == PJ_STATUS_FROM_OS(OSERR_EWOULDBLOCK));
+            return PJ_FALSE;
+        }
+        b->cnt = cnt;
+        b->drained = (cnt < b->cap);
+
+        /* All buffers are used, the socket may have more packets */
+        if (cnt == b->cap && b->cap < PJSIP_UDP_RECV_BATCH)
+            udp_batch_grow(tp, rdata_index);
+    }
+
+    m = &b->msg[b->pos];
+    if (b->pos > 0) {
+        /* Swap the rdata holding the packet with the (already reset)
+         * rdata of the pending read.
+         */
+        rdata = b->rdata[b->pos];
+        b->rdata[b->pos] = *p_rdata;
+        tp->rdata[rdata_index] = rdata;
+        *p_rdata = rdata;
+    }
+    pj_sockaddr_cp(&rdata->pkt_info.src_addr, &m->addr);
+    rdata->pkt_info.src_addr_len = m->addr_len;
+    *bytes_read = m->len;
+    ++b->pos;
+
+    return PJ_TRUE;
+}
+#endif
+
 /*
  * udp_on_read_complete()
  *
@@ -254,6 +421,24 @@ static void udp_on_read_complete( pj_ioqueue_key_t *key,
         if (tp->is_paused)
             break;
 
+#if PJSIP_UDP_RECV_BATCH > 1
+        /* Take the next packet from the socket with recvmmsg(), or from
+         * the packets drained by the previous recvmmsg() call.
+         */
+        {
+            pj_bool_t drained;
+
+            if (udp_batch_next(tp, &rdata, i < MAX_IMMEDIATE_PACKET,
+                               &bytes_read, &drained))
+            {
+                op_key = &rdata->tp_info.op_key.op_key;
+                continue;
+            }
+            if (drained)
+                flags = PJ_IOQUEUE_ALWAYS_ASYNC;
+        }
+#endif
+
         /* Read next packet. */
         bytes_read = sizeof(rdata->pkt_info.packet);
         rdata->pkt_info.src_addr_len = sizeof(rdata->pkt_info.src_addr);
@@ -423,6 +608,16 @@ static void udp_on_destroy(void *arg)
         pj_pool_release(tp->rdata[i]->tp_info.pool);
     }
 
+#if PJSIP_UDP_RECV_BATCH > 1
+    /* Destroy extra rdata of batched receive */
+    for (i=0; tp->batch && i<tp->rdata_cnt; ++i) {
+        unsigned j;
+
+        for (j=1; j<tp->batch[i].cap; ++j)
+            pj_pool_release(tp->batch[i].rdata[j]->tp_info.pool);
+    }
+#endif
+
     /* Destroy reference counter. */
     if (tp->base.ref_cnt)
         pj_atomic_destroy(tp->base.ref_cnt);
@@ -476,6 +671,19 @@ static pj_status_t udp_destroy( pjsip_transport *transport )
         }
     }
 
+    /* Close the additional sockets */
+    for (i=1; i<(int)tp->shard_cnt; ++i) {
+        struct udp_shard *sh = &tp->shard[i-1];
+
+        if (sh->key) {
+            pj_ioqueue_unregister(sh->key);
+            sh->key = NULL;
+        } else if (sh->sock != PJ_INVALID_SOCKET) {
+            pj_sock_close(sh->sock);
+        }
+        sh->sock = PJ_INVALID_SOCKET;
+    }
+
     /* Must poll ioqueue because IOCP calls the callback when socket
      * is closed. We poll the ioqueue until all pending callbacks 
      * have been called.
@@ -524,9 +732,10 @@ static pj_status_t udp_shutdown(pjsip_transport *transport)
 }
 
 
-/* Create socket */
+/* Create socket, optionally with SO_REUSEPORT set before binding */
 static pj_status_t create_socket(int af, const pj_sockaddr_t *local_a,
-                                 int addr_len, pj_sock_t *p_sock)
+                                 int addr_len, pj_bool_t reuse_port,
+                                 pj_sock_t *p_sock)
 {
     pj_sock_t sock;
     pj_sockaddr_in tmp_addr;
@@ -550,6 +759,17 @@ static pj_status_t create_socket(int af, const pj_sockaddr_t *local_a,
         }
     }
 
+    if (reuse_port) {
+        int enabled = 1;
+
+        status = pj_sock_setsockopt(sock, pj_SOL_SOCKET(), pj_SO_REUSEPORT(),
+                                    &enabled, sizeof(enabled));
+        if (status != PJ_SUCCESS) {
+            pj_sock_close(sock);
+            return status;
+        }
+    }
+
     status = pj_sock_bind(sock, local_a, addr_len);
     if (status != PJ_SUCCESS) {
         pj_sock_close(sock);
@@ -731,6 +951,35 @@ static pj_status_t register_to_ioqueue(struct udp_transport *tp)
                                      tp->grp_lock, tp, &ioqueue_cb, &tp->key);
 }
 
+/* Register the additional sockets to the endpoint's ioqueues. If the
+ * endpoint has several ioqueues, the sockets are spread among them.
+ */
+static pj_status_t start_shards(struct udp_transport *tp)
+{
+    pj_ioqueue_callback ioqueue_cb;
+    unsigned ioq_cnt = pjsip_endpt_get_ioqueue_cnt(tp->base.endpt);
+    unsigned i;
+    pj_status_t status;
+
+    pj_memset(&ioqueue_cb, 0, sizeof(ioqueue_cb));
+    ioqueue_cb.on_read_complete = &udp_on_read_complete;
+    ioqueue_cb.on_write_complete = &udp_on_write_complete;
+
+    for (i=1; i<tp->shard_cnt; ++i) {
+        struct udp_shard *sh = &tp->shard[i-1];
+        pj_ioqueue_t *ioqueue;
+
+        ioqueue = pjsip_endpt_get_ioqueue2(tp->base.endpt, i % ioq_cnt);
+        status = pj_ioqueue_register_sock2(tp->base.pool, ioqueue,
+                                           sh->sock, tp->grp_lock, tp,
+                                           &ioqueue_cb, &sh->key);
+        if (status != PJ_SUCCESS)
+            return status;
+    }
+
+    return PJ_SUCCESS;
+}
+
 /* Start ioqueue asynchronous reading to all rdata */
 static pj_status_t start_async_read(struct udp_transport *tp)
 {
@@ -739,11 +988,19 @@ static pj_status_t start_async_read(struct udp_transport *tp)
 
     /* Start reading the ioqueue. */
     for (i=0; i<tp->rdata_cnt; ++i) {
+        pj_ioqueue_key_t *key;
         pj_ssize_t size;
 
+#if PJSIP_UDP_RECV_BATCH > 1
+        /* Discard packets left over from before the transport is paused */
+        tp->batch[i].cnt = tp->batch[i].pos = 0;
+        tp->batch[i].drained = PJ_FALSE;
+#endif
+
         size = sizeof(tp->rdata[i]->pkt_info.packet);
         tp->rdata[i]->pkt_info.src_addr_len = sizeof(tp->rdata[i]->pkt_info.src_addr);
-        status = pj_ioqueue_recvfrom(tp->key, 
+        get_rdata_sock(tp, i, NULL, &key);
+        status = pj_ioqueue_recvfrom(key, 
                                      &tp->rdata[i]->tp_info.op_key.op_key,
                                      tp->rdata[i]->pkt_info.packet,
                                      &size, PJ_IOQUEUE_ALWAYS_ASYNC,
@@ -751,7 +1008,7 @@ static pj_status_t start_async_read(struct udp_transport *tp)
                                      &tp->rdata[i]->pkt_info.src_addr_len);
         if (status == PJ_SUCCESS) {
             pj_assert(!"Shouldn't happen because PJ_IOQUEUE_ALWAYS_ASYNC!");
-            udp_on_read_complete(tp->key, &tp->rdata[i]->tp_info.op_key.op_key,
+            udp_on_read_complete(key, &tp->rdata[i]->tp_info.op_key.op_key,
                                  size);
         } else if (status != PJ_EPENDING) {
             /* Error! */
@@ -771,6 +1028,8 @@ static pj_status_t start_async_read(struct udp_transport *tp)
 static pj_status_t transport_attach( pjsip_endpoint *endpt,
                                      pjsip_transport_type_e type,
                                      pj_sock_t sock,
+                                     const pj_sock_t shard_sock[],
+                                     unsigned shard_cnt,
                                      const pjsip_host_port *a_name,
                                      unsigned async_cnt,
                                      pjsip_transport **p_transport)
@@ -783,6 +1042,7 @@ static pj_status_t transport_attach( pjsip_endpoint *endpt,
 
     PJ_ASSERT_RETURN(endpt && sock!=PJ_INVALID_SOCKET && a_name && async_cnt>0,
                      PJ_EINVAL);
+    PJ_ASSERT_RETURN(shard_cnt>0 && (shard_cnt==1 || shard_sock), PJ_EINVAL);
 
     /* Object name. */
     if (type & PJSIP_TRANSPORT_IPV6) {
@@ -814,6 +1074,16 @@ static pj_status_t transport_attach( pjsip_endpoint *endpt,
 
     pj_memcpy(tp->base.obj_name, pool->obj_name, PJ_MAX_OBJ_NAME);
 
+    /* Take over the additional sockets */
+    tp->async_cnt = async_cnt;
+    tp->shard_cnt = shard_cnt;
+    if (shard_cnt > 1) {
+        tp->shard = (struct udp_shard*)
+                    pj_pool_calloc(pool, shard_cnt-1, sizeof(struct udp_shard));
+        for (i=1; i<shard_cnt; ++i)
+            tp->shard[i-1].sock = shard_sock[i-1];
+    }
+
     /* Init reference counter. */
     status = pj_atomic_create(pool, 0, &tp->base.ref_cnt);
     if (status != PJ_SUCCESS)
@@ -871,6 +1141,11 @@ static pj_status_t transport_attach( pjsip_endpoint *endpt,
     if (status != PJ_SUCCESS)
         goto on_error;
 
+    /* Register the additional sockets */
+    status = start_shards(tp);
+    if (status != PJ_SUCCESS)
+        goto on_error;
+
     /* Set functions. */
     tp->base.send_msg = &udp_send_msg;
     tp->base.do_shutdown = &udp_shutdown;
@@ -888,12 +1163,12 @@ static pj_status_t transport_attach( pjsip_endpoint *endpt,
      */
     pjsip_transport_add_ref(&tp->base);
 
-    /* Create rdata and put it in the array. */
+    /* Create rdata and put it in the array, async_cnt for each socket. */
     tp->rdata_cnt = 0;
     tp->rdata = (pjsip_rx_data**)
-                pj_pool_calloc(tp->base.pool, async_cnt, 
+                pj_pool_calloc(tp->base.pool, async_cnt * shard_cnt, 
                                sizeof(pjsip_rx_data*));
-    for (i=0; i<async_cnt; ++i) {
+    for (i=0; i<async_cnt * shard_cnt; ++i) {
         pj_pool_t *rdata_pool = pjsip_endpt_create_pool(endpt, "rtd%p", 
                                                         PJSIP_POOL_RDATA_LEN,
                                                         PJSIP_POOL_RDATA_INC);
@@ -907,6 +1182,17 @@ static pj_status_t transport_attach( pjsip_endpoint *endpt,
         tp->rdata_cnt++;
     }
 
+#if PJSIP_UDP_RECV_BATCH > 1
+    /* Init batched receive. Extra rdata are only created once recvmmsg()
+     * finds more than one packet in the socket.
+     */
+    tp->batch = (struct udp_batch*)
+                pj_pool_calloc(tp->base.pool, async_cnt * shard_cnt,
+                               sizeof(struct udp_batch));
+    for (i=0; i<async_cnt * shard_cnt; ++i)
+        tp->batch[i].cap = 1;
+#endif
+
     /* Start reading the ioqueue. */
     status = start_async_read(tp);
     if (status != PJ_SUCCESS) {
@@ -941,8 +1227,8 @@ PJ_DEF(pj_status_t) pjsip_udp_transport_attach( pjsip_endpoint *endpt,
                                                 unsigned async_cnt,
                                                 pjsip_transport **p_transport)
 {
-    return transport_attach(endpt, PJSIP_TRANSPORT_UDP, sock, a_name,
-                            async_cnt, p_transport);
+    return transport_attach(endpt, PJSIP_TRANSPORT_UDP, sock, NULL, 1,
+                            a_name, async_cnt, p_transport);
 }
 
 PJ_DEF(pj_status_t) pjsip_udp_transport_attach2( pjsip_endpoint *endpt,
@@ -952,7 +1238,7 @@ PJ_DEF(pj_status_t) pjsip_udp_transport_attach2( pjsip_endpoint *endpt,
                                                  unsigned async_cnt,
                                                  pjsip_transport **p_transport)
 {
-    return transport_attach(endpt, type, sock, a_name,
+    return transport_attach(endpt, type, sock, NULL, 1, a_name,
                             async_cnt, p_transport);
 }
 
@@ -967,6 +1253,7 @@ PJ_DEF(void) pjsip_udp_transport_cfg_default(pjsip_udp_transport_cfg *cfg,
     cfg->af = af;
     pj_sockaddr_init(cfg->af, &cfg->bind_addr, NULL, 0);
     cfg->async_cnt = 1;
+    cfg->shard_cnt = 1;
 }
 
 
@@ -981,14 +1268,21 @@ PJ_DEF(pj_status_t) pjsip_udp_transport_start2(
                                         pjsip_transport **p_transport)
 {
     pj_sock_t sock;
+    pj_sock_t shard_sock[PJSIP_UDP_MAX_SHARD_CNT];
+    unsigned shard_cnt = cfg->shard_cnt ? cfg->shard_cnt : 1;
     pj_status_t status;
     pjsip_host_port addr_name;
     char addr_buf[PJ_INET6_ADDRSTRLEN];
     pjsip_transport_type_e transport_type;
     pj_uint16_t af;
     int addr_len;
+    unsigned i;
 
     PJ_ASSERT_RETURN(endpt && cfg && cfg->async_cnt, PJ_EINVAL);
+    PJ_ASSERT_RETURN(shard_cnt <= PJSIP_UDP_MAX_SHARD_CNT, PJ_ETOOMANY);
+
+    if (shard_cnt > 1 && pj_SO_REUSEPORT() == 0xFFFF)
+        return PJ_ENOTSUP;
 
     if (cfg->bind_addr.addr.sa_family == pj_AF_INET()) {
         af = pj_AF_INET();
@@ -1000,7 +1294,8 @@ PJ_DEF(pj_status_t) pjsip_udp_transport_start2(
         addr_len = sizeof(pj_sockaddr_in6);
     }
 
-    status = create_socket(af, &cfg->bind_addr, addr_len, &sock);
+    status = create_socket(af, &cfg->bind_addr, addr_len, (shard_cnt > 1),
+                           &sock);
     if (status != PJ_SUCCESS)
         return status;
 
@@ -1012,6 +1307,38 @@ PJ_DEF(pj_status_t) pjsip_udp_transport_start2(
     if (cfg->sockopt_params.cnt)
         pj_sock_setsockopt_params(sock, &cfg->sockopt_params);
 
+    /* Create the additional sockets on the address that the first socket
+     * is actually bound to (the port may have been chosen by the OS).
+     */
+    if (shard_cnt > 1) {
+        pj_sockaddr bound_addr;
+        int bound_len = sizeof(bound_addr);
+
+        status = pj_sock_getsockname(sock, &bound_addr, &bound_len);
+        if (status != PJ_SUCCESS) {
+            pj_sock_close(sock);
+            return status;
+        }
+
+        for (i=1; i<shard_cnt; ++i) {
+            pj_sock_t *ssock = &shard_sock[i-1];
+
+            status = create_socket(af, &bound_addr, bound_len, PJ_TRUE,
+                                   ssock);
+            if (status != PJ_SUCCESS) {
+                while (--i > 0)
+                    pj_sock_close(shard_sock[i-1]);
+                pj_sock_close(sock);
+                return status;
+            }
+
+            pj_sock_apply_qos2(*ssock, cfg->qos_type, &cfg->qos_params,
+                               2, THIS_FILE, "SIP UDP transport");
+            if (cfg->sockopt_params.cnt)
+                pj_sock_setsockopt_params(*ssock, &cfg->sockopt_params);
+        }
+    }
+
     if (cfg->addr_name.host.slen == 0) {
         /* Address name is not specified.
          * Build a name based on bound address.
@@ -1019,6 +1346,8 @@ PJ_DEF(pj_status_t) pjsip_udp_transport_start2(
         status = get_published_name(sock, addr_buf, sizeof(addr_buf),
                                     &addr_name);
         if (status != PJ_SUCCESS) {
+            for (i=1; i<shard_cnt; ++i)
+                pj_sock_close(shard_sock[i-1]);
             pj_sock_close(sock);
             return status;
         }
@@ -1026,9 +1355,9 @@ PJ_DEF(pj_status_t) pjsip_udp_transport_start2(
         addr_name = cfg->addr_name;
     }
 
-    return pjsip_udp_transport_attach2(endpt, transport_type, sock,
-                                       &addr_name, cfg->async_cnt,
-                                       p_transport);
+    return transport_attach(endpt, transport_type, sock, shard_sock,
+                            shard_cnt, &addr_name, cfg->async_cnt,
+                            p_transport);
 }
 
 /*
@@ -1111,6 +1440,10 @@ PJ_DEF(pj_status_t) pjsip_udp_transport_pause(pjsip_transport *transport,
     /* Transport must not have been paused */
     PJ_ASSERT_RETURN(tp->is_paused==0, PJ_EINVALIDOP);
 
+    /* The additional sockets of sharded transport can't be replaced */
+    if (tp->shard_cnt > 1 && (option & PJSIP_UDP_TRANSPORT_DESTROY_SOCKET))
+        return PJ_ENOTSUP;
+
     /* Set transport to paused first, so that when the read callback is 
      * called by pj_ioqueue_post_completion() it will not try to
      * re-register the rdata.
@@ -1119,7 +1452,10 @@ PJ_DEF(pj_status_t) pjsip_udp_transport_pause(pjsip_transport *transport,
 
     /* Cancel the ioqueue operation. */
     for (i=0; i<(unsigned)tp->rdata_cnt; ++i) {
-        pj_ioqueue_post_completion(tp->key, 
+        pj_ioqueue_key_t *key;
+
+        get_rdata_sock(tp, i, NULL, &key);
+        pj_ioqueue_post_completion(key, 
                                    &tp->rdata[i]->tp_info.op_key.op_key, -1);
     }
 
@@ -1183,6 +1519,10 @@ PJ_DEF(pj_status_t) pjsip_udp_transport_restart2(pjsip_transport *transport,
 
     tp = (struct udp_transport*) transport;
 
+    /* The additional sockets of sharded transport can't be replaced */
+    if (tp->shard_cnt > 1 && (option & PJSIP_UDP_TRANSPORT_DESTROY_SOCKET))
+        return PJ_ENOTSUP;
+
     /* Pause the transport first, so that any active read loop spin will
      * quit as soon as possible.
      */
@@ -1212,7 +1552,7 @@ PJ_DEF(pj_status_t) pjsip_udp_transport_restart2(pjsip_transport *transport,
         if (sock == PJ_INVALID_SOCKET) {
             status = create_socket(local?local->addr.sa_family:pj_AF_UNSPEC(), 
                                    local, local?pj_sockaddr_get_len(local):0, 
-                                   &sock);
+                                   PJ_FALSE, &sock);
             if (status != PJ_SUCCESS)
                 return status;
         }
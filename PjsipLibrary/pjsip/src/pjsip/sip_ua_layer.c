@@ -124,7 +124,7 @@ static pj_status_t mod_ua_load(pjsip_endpoint *endpt)
     if (status != PJ_SUCCESS)
         return status;
 
-    mod_ua.dlg_table = pj_hash_create(mod_ua.pool, PJSIP_MAX_DIALOG_COUNT);
+    mod_ua.dlg_table = pj_hash_create_oa(mod_ua.pool, PJSIP_MAX_DIALOG_COUNT);
     if (mod_ua.dlg_table == NULL)
         return PJ_ENOMEM;
 
@@ -105,6 +105,7 @@ PJ_DEF(void) pjsua_config_default(pjsua_config *cfg)
 
     cfg->max_calls = PJSUA_MAX_CALLS;
     cfg->thread_cnt = PJSUA_SEPARATE_WORKER_FOR_TIMER? 2 : 1;
+    cfg->ioqueue_cnt = 1;
     cfg->nat_type_in_sdp = 1;
     cfg->stun_ignore_failure = PJ_TRUE;
     cfg->force_lr = PJ_TRUE;
@@ -798,17 +799,31 @@ PJ_DEF(pj_status_t) pjsua_reconfigure_logging(const pjsua_logging_config *cfg)
  * PJSUA Base API.
  */
 
-/* Worker thread function. */
+/* Worker thread function. The argument is the index of the ioqueue to
+ * poll, when the endpoint has more than one.
+ */
 static int worker_thread(void *arg)
 {
     enum { TIMEOUT = 10 };
-
-    PJ_UNUSED_ARG(arg);
+    unsigned ioq_index = (unsigned)(pj_ssize_t)arg;
 
     while (!pjsua_var.thread_quit_flag) {
         int count;
 
-        count = pjsua_handle_events(TIMEOUT);
+        if (pjsua_var.ua_cfg.ioqueue_cnt > 1) {
+            pj_time_val tv = {0, TIMEOUT};
+            unsigned cnt;
+
+            if (pjsip_endpt_handle_events3(pjsua_var.endpt, ioq_index,
+                                           &tv, &cnt) == PJ_SUCCESS)
+            {
+                count = cnt;
+            } else {
+                count = -1;
+            }
+        } else {
+            count = pjsua_handle_events(TIMEOUT);
+        }
         if (count < 0)
             pj_thread_sleep(TIMEOUT);
     }
@@ -843,14 +858,13 @@ static int worker_thread_timer(void *arg)
     return 0;
 }
 
-/* Ioqueue worker thread function. */
+/* Ioqueue worker thread function. The argument is the ioqueue index. */
 static int worker_thread_ioqueue(void *arg)
 {
     pj_ioqueue_t *ioq;
 
-    PJ_UNUSED_ARG(arg);
-
-    ioq = pjsip_endpt_get_ioqueue(pjsua_var.endpt);
+    ioq = pjsip_endpt_get_ioqueue2(pjsua_var.endpt,
+                                   (unsigned)(pj_ssize_t)arg);
     while (!pjsua_var.thread_quit_flag) {
         pj_time_val timeout = {0, 100};
         pj_ioqueue_poll(ioq, &timeout);
@@ -1247,6 +1261,24 @@ PJ_DEF(pj_status_t) pjsua_init( const pjsua_config *ua_cfg,
     }
 #endif
 
+    /* Create the additional ioqueues before any transport is created */
+    if (pjsua_var.ua_cfg.ioqueue_cnt > 1) {
+        unsigned max_cnt = PJ_ARRAY_SIZE(pjsua_var.thread);
+
+#if PJSUA_SEPARATE_WORKER_FOR_TIMER
+        --max_cnt;
+#endif
+        if (pjsua_var.ua_cfg.ioqueue_cnt > max_cnt)
+            pjsua_var.ua_cfg.ioqueue_cnt = max_cnt;
+
+        status = pjsip_endpt_set_ioqueue_cnt(pjsua_var.endpt,
+                                             pjsua_var.ua_cfg.ioqueue_cnt);
+        if (status != PJ_SUCCESS) {
+            pjsua_perror(THIS_FILE, "Error creating ioqueues", status);
+            goto on_error;
+        }
+    }
+
     /* Initialize PJSUA media subsystem */
     status = pjsua_media_subsys_init(media_cfg);
     if (status != PJ_SUCCESS)
@@ -1304,29 +1336,55 @@ PJ_DEF(pj_status_t) pjsua_init( const pjsua_config *ua_cfg,
 #if PJSUA_SEPARATE_WORKER_FOR_TIMER
         if (pjsua_var.ua_cfg.thread_cnt < 2)
             pjsua_var.ua_cfg.thread_cnt = 2;
+        if (pjsua_var.ua_cfg.thread_cnt < pjsua_var.ua_cfg.ioqueue_cnt + 1)
+            pjsua_var.ua_cfg.thread_cnt = pjsua_var.ua_cfg.ioqueue_cnt + 1;
+#else
+        /* Need at least one worker thread for each ioqueue */
+        if (pjsua_var.ua_cfg.thread_cnt < pjsua_var.ua_cfg.ioqueue_cnt)
+            pjsua_var.ua_cfg.thread_cnt = pjsua_var.ua_cfg.ioqueue_cnt;
 #endif
 
         for (ii=0; ii<pjsua_var.ua_cfg.thread_cnt; ++ii) {
             char tname[16];
+            unsigned ioq_cnt = pjsip_endpt_get_ioqueue_cnt(pjsua_var.endpt);
+            unsigned cpu_cnt = pj_get_cpu_count();
+            int ioq_index;
             
             pj_ansi_snprintf(tname, sizeof(tname), "pjsua_%d", ii);
 
 #if PJSUA_SEPARATE_WORKER_FOR_TIMER
             if (ii == 0) {
+                ioq_index = -1;
                 status = pj_thread_create(pjsua_var.pool, tname,
                                           &worker_thread_timer,
                                           NULL, 0, 0, &pjsua_var.thread[ii]);
             } else {
+                ioq_index = (ii-1) % ioq_cnt;
                 status = pj_thread_create(pjsua_var.pool, tname,
                                           &worker_thread_ioqueue,
-                                          NULL, 0, 0, &pjsua_var.thread[ii]);
+                                          (void*)(pj_ssize_t)ioq_index,
+                                          0, 0, &pjsua_var.thread[ii]);
             }
 #else
+            ioq_index = ii % ioq_cnt;
             status = pj_thread_create(pjsua_var.pool, tname, &worker_thread,
-                                      NULL, 0, 0, &pjsua_var.thread[ii]);
+                                      (void*)(pj_ssize_t)ioq_index,
+                                      0, 0, &pjsua_var.thread[ii]);
 #endif
             if (status != PJ_SUCCESS)
                 goto on_error;
+
+            /* Keep each ioqueue's events on one core, wrapping around
+             * when there are more ioqueues than cores.
+             */
+            if (ioq_cnt > 1 && cpu_cnt > 1 && ioq_index >= 0) {
+                status = pj_thread_set_affinity(pjsua_var.thread[ii],
+                                                ioq_index % cpu_cnt);
+                if (status != PJ_SUCCESS) {
+                    PJ_PERROR(4,(THIS_FILE, status,
+                                 "Unable to set affinity of %s", tname));
+                }
+            }
         }
         PJ_LOG(4,(THIS_FILE, "%d SIP worker threads created", 
                   pjsua_var.ua_cfg.thread_cnt));
@@ -2134,6 +2192,12 @@ PJ_DEF(pj_status_t) pjsua_destroy2(unsigned flags)
         pjsua_var.timer_mutex = NULL;
     }
 
+    /* Stop the asynchronous logging, if application has started it, as
+     * its queue may have been allocated from our pool factory and its
+     * thread may write to our log file, which are both destroyed below.
+     */
+    pj_log_async_stop();
+
     /* Destroy pools and pool factory. */
     if (pjsua_var.timer_pool) {
         pj_pool_release(pjsua_var.timer_pool);
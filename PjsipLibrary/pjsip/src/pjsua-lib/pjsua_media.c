@@ -51,6 +51,7 @@ static void pjsua_media_config_dup(pj_pool_t *pool,
  */
 pj_status_t pjsua_media_subsys_init(const pjsua_media_config *cfg)
 {
+    unsigned i;
     pj_status_t status;
 
     pj_log_push_indent();
@@ -96,6 +97,15 @@ pj_status_t pjsua_media_subsys_init(const pjsua_media_config *cfg)
         goto on_error;
     }
 
+    /* Spread the media sockets among the SIP endpoint's ioqueues too */
+    if (!pjsua_var.media_cfg.has_ioqueue) {
+        for (i=1; i<pjsip_endpt_get_ioqueue_cnt(pjsua_var.endpt); ++i) {
+            pjmedia_endpt_add_ioqueue(pjsua_var.med_endpt,
+                                      pjsip_endpt_get_ioqueue2(pjsua_var.endpt,
+                                                               i));
+        }
+    }
+
     status = pjsua_aud_subsys_init();
     if (status != PJ_SUCCESS)
         goto on_error;
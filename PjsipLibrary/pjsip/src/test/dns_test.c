@@ -320,6 +320,152 @@ static void add_dns_entries(pj_dns_resolver *resv)
 }
 
 
+/*
+ * Replace the DNS A record of the name in the resolver cache.
+ */
+static void set_a_record(pj_dns_resolver *resv, char *name, char *addr)
+{
+    pj_dns_parsed_packet pkt;
+    pj_dns_parsed_query q;
+    pj_dns_parsed_rr ans[1];
+    pj_str_t tmp;
+
+    pj_bzero(&pkt, sizeof(pkt));
+    pj_bzero(&ans, sizeof(ans));
+    pkt.hdr.flags = PJ_DNS_SET_QR(1);
+    pkt.hdr.qdcount = 1;
+    pkt.hdr.anscount = 1;
+    pkt.q = &q;
+    pkt.ans = ans;
+
+    ans[0].name = pj_str(name);
+    ans[0].type = PJ_DNS_TYPE_A;
+    ans[0].dnsclass = PJ_DNS_CLASS_IN;
+    ans[0].ttl = 3600;
+    ans[0].rdata.a.ip_addr = pj_inet_addr(pj_cstr(&tmp, addr));
+
+    q.name = ans[0].name;
+    q.type = ans[0].type;
+    q.dnsclass = ans[0].dnsclass;
+
+    pj_dns_resolver_add_entry( resv, &pkt, PJ_FALSE);
+}
+
+
+#if defined(PJ_HAS_IPV6) && PJ_HAS_IPV6
+/*
+ * Add two DNS A and two DNS AAAA records for the name.
+ */
+static void set_dual_stack_records(pj_dns_resolver *resv, char *name)
+{
+    pj_dns_parsed_packet pkt;
+    pj_dns_parsed_query q;
+    pj_dns_parsed_rr ans[2];
+    pj_str_t tmp;
+    unsigned i;
+
+    pj_bzero(&pkt, sizeof(pkt));
+    pj_bzero(&ans, sizeof(ans));
+    pkt.hdr.flags = PJ_DNS_SET_QR(1);
+    pkt.hdr.qdcount = 1;
+    pkt.hdr.anscount = 2;
+    pkt.q = &q;
+    pkt.ans = ans;
+
+    for (i=0; i<2; ++i) {
+        ans[i].name = pj_str(name);
+        ans[i].type = PJ_DNS_TYPE_A;
+        ans[i].dnsclass = PJ_DNS_CLASS_IN;
+        ans[i].ttl = 3600;
+    }
+    ans[0].rdata.a.ip_addr = pj_inet_addr(pj_cstr(&tmp, "10.0.0.1"));
+    ans[1].rdata.a.ip_addr = pj_inet_addr(pj_cstr(&tmp, "10.0.0.2"));
+
+    q.name = ans[0].name;
+    q.type = PJ_DNS_TYPE_A;
+    q.dnsclass = PJ_DNS_CLASS_IN;
+    pj_dns_resolver_add_entry( resv, &pkt, PJ_FALSE);
+
+    for (i=0; i<2; ++i)
+        ans[i].type = PJ_DNS_TYPE_AAAA;
+    pj_inet_pton(pj_AF_INET6(), pj_cstr(&tmp, "fd00::1"),
+                 &ans[0].rdata.aaaa.ip_addr);
+    pj_inet_pton(pj_AF_INET6(), pj_cstr(&tmp, "fd00::2"),
+                 &ans[1].rdata.aaaa.ip_addr);
+
+    q.type = PJ_DNS_TYPE_AAAA;
+    pj_dns_resolver_add_entry( resv, &pkt, PJ_FALSE);
+}
+
+/*
+ * Resolve the dual stack target with the specified preferred address
+ * family, and check the order of the address families in the result,
+ * e.g. "6464" for IPv6, IPv4, IPv6, IPv4.
+ */
+static int test_af_order(pj_pool_t *pool, char *name, int preferred_af,
+                         const char *order)
+{
+    pjsip_host_info dest;
+    struct result result;
+    int saved_af = pjsip_cfg()->resolve.preferred_af;
+    unsigned i;
+
+    PJ_LOG(3,(THIS_FILE, " test_af_order(): preferred_af=%d, expecting %s",
+              preferred_af, order));
+
+    dest.type = PJSIP_TRANSPORT_UNSPECIFIED;
+    dest.flag = pjsip_transport_get_flag_from_type(PJSIP_TRANSPORT_UDP);
+    dest.addr.host = pj_str(name);
+    dest.addr.port = 5060;
+
+    result.status = 0x12345678;
+
+    pjsip_cfg()->resolve.preferred_af = preferred_af;
+    pjsip_endpt_resolve(endpt, pool, &dest, &result, &cb);
+    while (result.status == 0x12345678) {
+        pj_time_val timeout = { 1, 0 };
+        pjsip_endpt_handle_events(endpt, &timeout);
+    }
+    pjsip_cfg()->resolve.preferred_af = saved_af;
+
+    if (result.status != PJ_SUCCESS) {
+        app_perror("  pjsip_endpt_resolve() error", result.status);
+        return 10;
+    }
+
+    if (result.servers.count != pj_ansi_strlen(order)) {
+        PJ_LOG(3,(THIS_FILE, "  test_af_order() error 20: result count "
+                  "mismatch (%d)", result.servers.count));
+        return 20;
+    }
+
+    for (i=0; i<result.servers.count; ++i) {
+        int af = (order[i] == '6') ? pj_AF_INET6() : pj_AF_INET();
+
+        if (result.servers.entry[i].addr.addr.sa_family != af) {
+            PJ_LOG(3,(THIS_FILE, "  test_af_order() error 30: wrong address "
+                      "family at %d", i));
+            return 30;
+        }
+    }
+
+    /* Each family must keep its own order */
+    for (i=2; i<result.servers.count; ++i) {
+        if (pj_sockaddr_cmp(&result.servers.entry[i].addr,
+                            &result.servers.entry[i-2].addr) <= 0 &&
+            result.servers.entry[i].addr.addr.sa_family ==
+            result.servers.entry[i-2].addr.addr.sa_family)
+        {
+            PJ_LOG(3,(THIS_FILE, "  test_af_order() error 40: address "
+                      "order changed within a family"));
+            return 40;
+        }
+    }
+
+    return PJ_SUCCESS;
+}
+#endif  /* PJ_HAS_IPV6 */
+
 /*
  * Perform server resolution where the results are expected to
  * come in strict order.
@@ -633,11 +779,73 @@ int resolve_test(void)
     if (round_robin_test(pool) != 0)
         return -170;
 
-    /* Timeout test */
+    /* Resolved target cache test */
+    {
+        pjsip_server_addresses ref;
+        unsigned cache_ttl = pjsip_cfg()->resolve.cache_ttl;
+
+        pjsip_cfg()->resolve.cache_ttl = 60;
+
+        create_ref(&ref, PJSIP_TRANSPORT_UDP, "6.6.6.6", 5070);
+        status = test_resolve("target cache (first resolution)", pool, PJSIP_TRANSPORT_UNSPECIFIED, "sip06.domain.com", 5070, &ref);
+        if (status == PJ_SUCCESS) {
+            /* The SIP resolver should not see the DNS change */
+            set_a_record(resv, "sip06.domain.com", "8.8.8.8");
+            status = test_resolve("target cache (cached)", pool, PJSIP_TRANSPORT_UNSPECIFIED, "sip06.domain.com", 5070, &ref);
+        }
+        if (status == PJ_SUCCESS) {
+            pjsip_cfg()->resolve.cache_ttl = 0;
+            create_ref(&ref, PJSIP_TRANSPORT_UDP, "8.8.8.8", 5070);
+            status = test_resolve("target cache (disabled)", pool, PJSIP_TRANSPORT_UNSPECIFIED, "sip06.domain.com", 5070, &ref);
+        }
+
+        pjsip_cfg()->resolve.cache_ttl = cache_ttl;
+        set_a_record(resv, "sip06.domain.com", "6.6.6.6");
+        if (status != PJ_SUCCESS)
+            return -175;
+    }
+
+#if defined(PJ_HAS_IPV6) && PJ_HAS_IPV6
+    /* Address family interleaving test */
     {
+        set_dual_stack_records(resv, "dual.domain.com");
+        if (test_af_order(pool, "dual.domain.com", 0, "4466") != 0)
+            return -180;
+        if (test_af_order(pool, "dual.domain.com", 6, "6464") != 0)
+            return -181;
+        if (test_af_order(pool, "dual.domain.com", 4, "4646") != 0)
+            return -182;
+    }
+#endif
+
+    /* Timeout test. With PJSIP_RESOLVE_PARALLEL_FALLBACK, the fallback
+     * A/AAAA queries are sent with the SRV query, so the resolution
+     * fails when the SRV query times out instead of some time after.
+     */
+    {
+        pj_dns_settings st;
+        pj_time_val t0, t1;
+        unsigned msec;
+
+        pj_gettickcount(&t0);
         status = test_resolve("timeout test", pool, PJSIP_TRANSPORT_UNSPECIFIED, "an.invalid.address", 0, NULL);
         if (status == PJ_SUCCESS)
             return -150;
+        pj_gettickcount(&t1);
+
+        PJ_TIME_VAL_SUB(t1, t0);
+        msec = PJ_TIME_VAL_MSEC(t1);
+        pj_dns_resolver_get_settings(resv, &st);
+        PJ_LOG(3,(THIS_FILE, " ..timeout after %u ms (query timeout is "
+                  "%u ms)", msec, st.qretr_delay * (st.qretr_count + 1)));
+
+#if PJSIP_RESOLVE_PARALLEL_FALLBACK
+        if (msec > st.qretr_delay * (st.qretr_count + 1)) {
+            PJ_LOG(3,(THIS_FILE, " ..error: fallback queries were not sent "
+                      "in parallel"));
+            return -190;
+        }
+#endif
     }
 
     return 0;
@@ -924,6 +924,72 @@ static int msg_benchmark(unsigned *p_detect, unsigned *p_parse,
     *p_print = (unsigned)avg_print;
     return status;
 }
+
+/* Parse a message with long header values, such as tokens or application
+ * data in extension headers, where the scanner spends most of the time in
+ * long runs of characters rather than in short tokens.
+ */
+static int long_hdr_benchmark(unsigned *p_parse, unsigned *p_len)
+{
+    enum { SHORT_VAL = 80, LONG_VAL = 1000 };
+    static char msgbuf[2048];
+    pj_pool_t *pool;
+    pjsip_msg *msg;
+    pjsip_parser_err_report err_list;
+    pj_timestamp zero, t1, t2, total;
+    pj_highprec_t usec;
+    pj_size_t len;
+    int i, loop;
+
+    len = pj_ansi_snprintf(msgbuf, sizeof(msgbuf),
+                           "INVITE sip:user@foo SIP/2.0\r\n"
+                           "From: <sip:joe@bar>;tag=1234567890\r\n"
+                           "To: <sip:user@foo>\r\n"
+                           "Call-ID: 12345678901234567890@bar\r\n"
+                           "CSeq: 123456 INVITE\r\n"
+                           "Via: SIP/2.0/UDP 10.2.1.1;branch=z9hG4bK1\r\n"
+                           "Content-Length: 0\r\n");
+    len += pj_ansi_snprintf(msgbuf+len, sizeof(msgbuf)-len, "Subject: ");
+    for (i=0; i<SHORT_VAL; ++i)
+        msgbuf[len++] = (char)('a' + i % 26);
+    len += pj_ansi_snprintf(msgbuf+len, sizeof(msgbuf)-len,
+                            "\r\nX-Long-Header: ");
+    for (i=0; i<LONG_VAL; ++i)
+        msgbuf[len++] = (char)('A' + i % 26);
+    len += pj_ansi_snprintf(msgbuf+len, sizeof(msgbuf)-len, "\r\n\r\n");
+
+    zero.u64 = total.u64 = 0;
+    for (loop=0; loop<LOOP; ++loop) {
+        pool = pjsip_endpt_create_pool(endpt, NULL, POOL_SIZE, POOL_SIZE);
+
+        pj_get_timestamp(&t1);
+        pj_list_init(&err_list);
+        msg = pjsip_parse_msg(pool, msgbuf, len, &err_list);
+        pj_get_timestamp(&t2);
+
+        pjsip_endpt_release_pool(endpt, pool);
+
+        if (msg == NULL) {
+            PJ_LOG(3,(THIS_FILE, "   error: long header message not parsed"));
+            return -40;
+        }
+
+        pj_sub_timestamp(&t2, &t1);
+        pj_add_timestamp(&total, &t2);
+    }
+
+    usec = pj_elapsed_usec(&zero, &total);
+    if (usec == 0)
+        usec = 1;
+    *p_parse = (unsigned)(LOOP * (pj_highprec_t)1000000 / usec);
+    *p_len = (unsigned)len;
+
+    PJ_LOG(3,(THIS_FILE,
+              "    %d messages of %u bytes with long headers parsed in "
+              "%u usec (avg=%u msg parsing/sec)",
+              LOOP, *p_len, (unsigned)usec, *p_parse));
+    return 0;
+}
 #endif  /* INCLUDE_BENCHMARKS */
 
 /*****************************************************************************/
@@ -2083,6 +2149,19 @@ int msg_test(void)
                 "SIP messages printed per second). "
                 "The value is derived from msg-print-per-sec above.");
 
+    /* Parsing of long header values */
+    PJ_LOG(3,(THIS_FILE, "  benchmarking long headers.."));
+    status = long_hdr_benchmark(&max, &avg_len);
+    if (status != PJ_SUCCESS)
+        return status;
+
+    pj_ansi_snprintf(desc, sizeof(desc),
+                          "Number of SIP messages with long header values "
+                          "can be <b>parsed</b> by <tt>pjsip_parse_msg()</tt> "
+                          "per second (message length is %d bytes)",
+                          avg_len);
+    report_ival("msg-long-hdr-parse-per-sec", max, "msg/sec", desc);
+
 #endif  /* INCLUDE_BENCHMARKS */
 
     return PJ_SUCCESS;
@@ -106,6 +106,337 @@ static pj_status_t multi_transport_test(pjsip_transport *tp[], unsigned num_tp)
     return PJ_SUCCESS;
 }
 
+/*
+ * Sharded UDP transport test: messages sent from many source sockets must
+ * all be received, whichever socket of the transport they arrive at.
+ */
+#define SHARD_CALL_ID   "shard-test-call-id"
+
+static pj_atomic_t *shard_rx_cnt;
+
+static pj_bool_t shard_on_rx_request(pjsip_rx_data *rdata)
+{
+    if (pj_strcmp2(&rdata->msg_info.cid->id, SHARD_CALL_ID) == 0) {
+        pj_atomic_inc(shard_rx_cnt);
+        return PJ_TRUE;
+    }
+    return PJ_FALSE;
+}
+
+static pjsip_module shard_module =
+{
+    NULL, NULL,                         /* prev and next        */
+    { "Shard-Test", 10},                /* Name.                */
+    -1,                                 /* Id                   */
+    PJSIP_MOD_PRIORITY_TSX_LAYER-1,     /* Priority             */
+    NULL,                               /* load()               */
+    NULL,                               /* start()              */
+    NULL,                               /* stop()               */
+    NULL,                               /* unload()             */
+    &shard_on_rx_request,               /* on_rx_request()      */
+    NULL,                               /* on_rx_response()     */
+    NULL,                               /* on_tsx_state()       */
+};
+
+/* Send one request from each socket and wait until all are received */
+static int shard_send_recv(pj_sock_t sock[], unsigned sock_cnt,
+                           const pj_sockaddr_in *dst_addr)
+{
+    pj_time_val stop_time, now;
+    unsigned i;
+
+    pj_atomic_set(shard_rx_cnt, 0);
+
+    for (i=0; i<sock_cnt; ++i) {
+        char msg[512];
+        pj_ssize_t len;
+        pj_status_t status;
+
+        len = pj_ansi_snprintf(msg, sizeof(msg),
+                               "OPTIONS sip:shard@127.0.0.1 SIP/2.0\r\n"
+                               "Via: SIP/2.0/UDP 127.0.0.1:5060"
+                               ";branch=z9hG4bKshard%u\r\n"
+                               "From: <sip:a@127.0.0.1>;tag=1\r\n"
+                               "To: <sip:shard@127.0.0.1>\r\n"
+                               "Call-ID: " SHARD_CALL_ID "\r\n"
+                               "CSeq: %u OPTIONS\r\n"
+                               "Content-Length: 0\r\n\r\n",
+                               i, i+1);
+        status = pj_sock_sendto(sock[i], msg, &len, 0, dst_addr,
+                                sizeof(*dst_addr));
+        if (status != PJ_SUCCESS) {
+            app_perror("   Error: sendto", status);
+            return -310;
+        }
+    }
+
+    pj_gettimeofday(&stop_time);
+    stop_time.sec += 2;
+    do {
+        pj_time_val timeout = {0, 10};
+
+        pjsip_endpt_handle_events(endpt, &timeout);
+        pj_gettimeofday(&now);
+    } while (pj_atomic_get(shard_rx_cnt) < (pj_atomic_value_t)sock_cnt &&
+             PJ_TIME_VAL_LT(now, stop_time));
+
+    if (pj_atomic_get(shard_rx_cnt) != (pj_atomic_value_t)sock_cnt) {
+        PJ_LOG(3,(THIS_FILE, "   error: only %ld of %u messages received",
+                  (long)pj_atomic_get(shard_rx_cnt), sock_cnt));
+        return -320;
+    }
+
+    return 0;
+}
+
+static int shard_test(void)
+{
+    enum { SHARD_CNT = 4, SRC_CNT = 16 };
+    pjsip_udp_transport_cfg cfg;
+    pjsip_transport *udp_tp = NULL;
+    pj_pool_t *pool;
+    pj_sock_t sock[SRC_CNT];
+    pj_sockaddr_in dst_addr;
+    pj_str_t s;
+    unsigned i;
+    pj_status_t status;
+    int rc = 0;
+
+    if (pj_SO_REUSEPORT() == 0xFFFF) {
+        PJ_LOG(3,(THIS_FILE, "   SO_REUSEPORT is not supported, skipping "
+                  "sharded transport test"));
+        return 0;
+    }
+
+    PJ_LOG(3,(THIS_FILE, "   sharded UDP transport test"));
+
+    for (i=0; i<SRC_CNT; ++i)
+        sock[i] = PJ_INVALID_SOCKET;
+
+    pool = pjsip_endpt_create_pool(endpt, "shard", 512, 512);
+    status = pj_atomic_create(pool, 0, &shard_rx_cnt);
+    if (status != PJ_SUCCESS) {
+        pjsip_endpt_release_pool(endpt, pool);
+        return -210;
+    }
+
+    status = pjsip_endpt_register_module(endpt, &shard_module);
+    if (status != PJ_SUCCESS) {
+        app_perror("   Error: unable to register module", status);
+        rc = -220; goto on_return;
+    }
+
+    /* Let the OS choose the port, the other sockets must follow it */
+    pjsip_udp_transport_cfg_default(&cfg, pj_AF_INET());
+    pj_sockaddr_init(pj_AF_INET(), &cfg.bind_addr, pj_cstr(&s, "127.0.0.1"),
+                     0);
+    cfg.shard_cnt = SHARD_CNT;
+    status = pjsip_udp_transport_start2(endpt, &cfg, &udp_tp);
+    if (status != PJ_SUCCESS) {
+        app_perror("   Error: unable to start sharded UDP transport", status);
+        rc = -230; goto on_return;
+    }
+
+    if (pj_atomic_get(udp_tp->ref_cnt) != 1) {
+        rc = -240; goto on_return;
+    }
+
+    /* Replacing the socket is not supported */
+    if (pjsip_udp_transport_pause(udp_tp, PJSIP_UDP_TRANSPORT_DESTROY_SOCKET)
+        != PJ_ENOTSUP)
+    {
+        rc = -250; goto on_return;
+    }
+
+    for (i=0; i<SRC_CNT; ++i) {
+        status = pj_sock_socket(pj_AF_INET(), pj_SOCK_DGRAM(), 0, &sock[i]);
+        if (status != PJ_SUCCESS) {
+            rc = -260; goto on_return;
+        }
+    }
+
+    pj_sockaddr_in_init(&dst_addr, pj_cstr(&s, "127.0.0.1"),
+                        (pj_uint16_t)udp_tp->local_name.port);
+
+    rc = shard_send_recv(sock, SRC_CNT, &dst_addr);
+    if (rc != 0)
+        goto on_return;
+
+    /* All sockets must resume reading after pause and restart */
+    status = pjsip_udp_transport_pause(udp_tp,
+                                       PJSIP_UDP_TRANSPORT_KEEP_SOCKET);
+    if (status != PJ_SUCCESS) {
+        rc = -270; goto on_return;
+    }
+    status = pjsip_udp_transport_restart2(udp_tp,
+                                          PJSIP_UDP_TRANSPORT_KEEP_SOCKET,
+                                          PJ_INVALID_SOCKET, NULL, NULL);
+    if (status != PJ_SUCCESS) {
+        rc = -280; goto on_return;
+    }
+
+    rc = shard_send_recv(sock, SRC_CNT, &dst_addr);
+
+on_return:
+    for (i=0; i<SRC_CNT; ++i) {
+        if (sock[i] != PJ_INVALID_SOCKET)
+            pj_sock_close(sock[i]);
+    }
+    if (udp_tp) {
+        pjsip_transport_dec_ref(udp_tp);
+        status = pjsip_transport_destroy(udp_tp);
+        if (status != PJ_SUCCESS && rc == 0)
+            rc = -290;
+    }
+    if (shard_module.id != -1)
+        pjsip_endpt_unregister_module(endpt, &shard_module);
+    pj_atomic_destroy(shard_rx_cnt);
+    pjsip_endpt_release_pool(endpt, pool);
+    return rc;
+}
+
+/*
+ * Multiple ioqueue test: a packet arriving on an ioqueue other than the
+ * first while pjsip_endpt_handle_events2() is waiting must be handled
+ * within the poll slice, not after the whole timeout.
+ */
+static pj_timestamp ioq_send_ts, ioq_recv_ts;
+static pj_bool_t ioq_received;
+
+static void ioq_on_read_complete(pj_ioqueue_key_t *key,
+                                 pj_ioqueue_op_key_t *op_key,
+                                 pj_ssize_t bytes_read)
+{
+    PJ_UNUSED_ARG(key);
+    PJ_UNUSED_ARG(op_key);
+
+    if (bytes_read > 0 && !ioq_received) {
+        pj_get_timestamp(&ioq_recv_ts);
+        ioq_received = PJ_TRUE;
+    }
+}
+
+static int ioq_send_thread(void *arg)
+{
+    pj_sock_t sock = PJ_INVALID_SOCKET;
+    pj_ssize_t len = 4;
+
+    /* Give the main thread time to block in the poll */
+    pj_thread_sleep(100);
+
+    if (pj_sock_socket(pj_AF_INET(), pj_SOCK_DGRAM(), 0, &sock)
+        == PJ_SUCCESS)
+    {
+        pj_get_timestamp(&ioq_send_ts);
+        pj_sock_sendto(sock, "ping", &len, 0, arg, sizeof(pj_sockaddr_in));
+        pj_sock_close(sock);
+    }
+    return 0;
+}
+
+static int multi_ioqueue_test(void)
+{
+    enum { MAX_DELAY_MSEC = 100 };
+    pj_pool_t *pool;
+    pj_sock_t sock = PJ_INVALID_SOCKET;
+    pj_ioqueue_key_t *key = NULL;
+    pj_ioqueue_op_key_t op_key;
+    pj_ioqueue_callback cb;
+    pj_thread_t *thread = NULL;
+    pj_sockaddr_in addr;
+    int addr_len;
+    char buf[16];
+    pj_ssize_t len;
+    pj_time_val stop_time, now;
+    pj_str_t s;
+    unsigned delay;
+    pj_status_t status;
+    int rc = 0;
+
+    PJ_LOG(3,(THIS_FILE, "   multiple ioqueue test"));
+
+    if (pjsip_endpt_get_ioqueue_cnt(endpt) < 2) {
+        status = pjsip_endpt_set_ioqueue_cnt(endpt, 2);
+        if (status != PJ_SUCCESS) {
+            app_perror("   Error: unable to set ioqueue count", status);
+            return -410;
+        }
+    }
+
+    pool = pjsip_endpt_create_pool(endpt, "ioqtest", 512, 512);
+    ioq_received = PJ_FALSE;
+
+    pj_sockaddr_in_init(&addr, pj_cstr(&s, "127.0.0.1"), 0);
+    status = pj_sock_socket(pj_AF_INET(), pj_SOCK_DGRAM(), 0, &sock);
+    if (status == PJ_SUCCESS)
+        status = pj_sock_bind(sock, &addr, sizeof(addr));
+    addr_len = sizeof(addr);
+    if (status == PJ_SUCCESS)
+        status = pj_sock_getsockname(sock, &addr, &addr_len);
+    if (status != PJ_SUCCESS) {
+        app_perror("   Error: unable to create socket", status);
+        rc = -420; goto on_return;
+    }
+
+    pj_bzero(&cb, sizeof(cb));
+    cb.on_read_complete = &ioq_on_read_complete;
+    status = pj_ioqueue_register_sock(pool, pjsip_endpt_get_ioqueue2(endpt, 1),
+                                      sock, NULL, &cb, &key);
+    if (status != PJ_SUCCESS) {
+        app_perror("   Error: unable to register socket", status);
+        rc = -430; goto on_return;
+    }
+
+    pj_ioqueue_op_key_init(&op_key, sizeof(op_key));
+    len = sizeof(buf);
+    status = pj_ioqueue_recv(key, &op_key, buf, &len, 0);
+    if (status != PJ_EPENDING) {
+        app_perror("   Error: unexpected recv status", status);
+        rc = -440; goto on_return;
+    }
+
+    status = pj_thread_create(pool, "ioqtest", &ioq_send_thread, &addr,
+                              0, 0, &thread);
+    if (status != PJ_SUCCESS) {
+        rc = -450; goto on_return;
+    }
+
+    pj_gettimeofday(&stop_time);
+    stop_time.sec += 5;
+    do {
+        pj_time_val timeout = { 2, 0 };
+
+        pjsip_endpt_handle_events2(endpt, &timeout, NULL);
+        pj_gettimeofday(&now);
+    } while (!ioq_received && PJ_TIME_VAL_LT(now, stop_time));
+
+    pj_thread_join(thread);
+
+    if (!ioq_received) {
+        PJ_LOG(3,(THIS_FILE, "   error: packet not received"));
+        rc = -460; goto on_return;
+    }
+
+    delay = pj_elapsed_msec(&ioq_send_ts, &ioq_recv_ts);
+    PJ_LOG(3,(THIS_FILE, "   packet on second ioqueue handled after %u ms",
+              delay));
+    if (delay > MAX_DELAY_MSEC) {
+        PJ_LOG(3,(THIS_FILE, "   error: delay exceeds %d ms",
+                  MAX_DELAY_MSEC));
+        rc = -470;
+    }
+
+on_return:
+    if (thread)
+        pj_thread_destroy(thread);
+    if (key)
+        pj_ioqueue_unregister(key);
+    else if (sock != PJ_INVALID_SOCKET)
+        pj_sock_close(sock);
+    pjsip_endpt_release_pool(endpt, pool);
+    return rc;
+}
+
 /*
  * UDP transport test.
  */
@@ -154,6 +485,16 @@ int transport_udp_test(void)
     if (pkt_lost != 0)
         PJ_LOG(3,(THIS_FILE, "   note: %d packet(s) was lost", pkt_lost));
 
+    /* Sharded transport test. */
+    status = shard_test();
+    if (status != 0)
+        return status;
+
+    /* Multiple ioqueue test. */
+    status = multi_ioqueue_test();
+    if (status != 0)
+        return status;
+
     for (i = 0; i < NUM_TP; ++i) {
         udp_tp = tp[i];
 